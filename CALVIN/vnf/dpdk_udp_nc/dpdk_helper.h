@@ -12,6 +12,8 @@
 #ifndef DPDK_HELPER_H
 #define DPDK_HELPER_H
 
+#include <stdint.h>
+
 /**
  * @brief Make a deep copy of a mbuf
  *
@@ -29,11 +31,46 @@ struct rte_mbuf *mbuf_udp_deep_copy(struct rte_mbuf *m,
 /**
  * @brief Recalculate IP and UDP checksum
  *
+ * Reads the whole UDP payload. Use the incremental updates below if only
+ * header fields changed.
+ *
  * @param iph
  * @param udph
  */
 void recalc_cksum(struct ipv4_hdr *iph, struct udp_hdr *udph);
 
+/**
+ * @brief Update a checksum for a changed 16-bit word (RFC 1624, Eqn. 3)
+ *
+ * All values are used as they are in the packet (network byte order).
+ *
+ * @param cksum
+ * @param old
+ * @param now
+ *
+ * @return The new checksum
+ */
+static inline uint16_t cksum_replace16(uint16_t cksum, uint16_t old,
+				       uint16_t now)
+{
+	uint32_t sum = (uint16_t)~cksum + (uint32_t)(uint16_t)~old + now;
+
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	return (uint16_t)~sum;
+}
+
+/**
+ * @brief Update a checksum for a changed 32-bit field, e.g. an IPv4 address
+ */
+static inline uint16_t cksum_replace32(uint16_t cksum, uint32_t old,
+				       uint32_t now)
+{
+	cksum = cksum_replace16(cksum, (uint16_t)old, (uint16_t)now);
+	return cksum_replace16(cksum, (uint16_t)(old >> 16),
+			       (uint16_t)(now >> 16));
+}
+
 /**
  * @brief Print in mbuf encapsulated UDP segment in hex format
  *
@@ -80,6 +80,7 @@
 #include <rte_udp.h>
 
 /*#include "kni.h"*/
+#include "dpdk_helper.h"
 #include "ncmbuf.h"
 
 #ifndef DEBUG
@@ -263,13 +264,29 @@ void nc_udp(int coder_type, struct rte_mbuf* m, uint16_t portid);
  *  Function Implementations  *
  ******************************/
 
-static inline __attribute__((always_inline)) void recalc_cksum_inline(
-    struct ipv4_hdr* iph, struct udp_hdr* udph)
+/**
+ * @brief Replace an IPv4 address and update the IP and UDP checksums
+ *        incrementally (RFC 1624), the payload is not read.
+ */
+static inline __attribute__((always_inline)) void replace_addr_inline(
+    struct ipv4_hdr* iph, struct udp_hdr* udph, void* field,
+    const uint32_t* addr)
 {
-        udph->dgram_cksum = 0;
-        iph->hdr_checksum = 0;
-        udph->dgram_cksum = rte_ipv4_udptcp_cksum(iph, udph);
-        iph->hdr_checksum = rte_ipv4_cksum(iph);
+        uint32_t old;
+        uint32_t now;
+
+        rte_memcpy(&old, field, sizeof(uint32_t));
+        rte_memcpy(&now, addr, sizeof(uint32_t));
+        iph->hdr_checksum = cksum_replace32(iph->hdr_checksum, old, now);
+        /* The addresses are in the UDP pseudo header, 0 means no checksum. */
+        if (udph->dgram_cksum != 0) {
+                udph->dgram_cksum
+                    = cksum_replace32(udph->dgram_cksum, old, now);
+                if (udph->dgram_cksum == 0) {
+                        udph->dgram_cksum = 0xffff;
+                }
+        }
+        rte_memcpy(field, &now, sizeof(uint32_t));
 }
 
 /**
@@ -427,15 +444,16 @@ static inline void mod_ip_addr(uint16_t nb_rx, struct rte_mbuf* pkts_burst[],
                 }
                 iph = rte_pktmbuf_mtod_offset(
                     pkts_burst[i], struct ipv4_hdr*, ETHER_HDR_LEN);
+                in_iphdr_len = (iph->version_ihl & 0x0F) * 32 / 8;
+                udph = (struct udp_hdr*)((char*)iph + in_iphdr_len);
                 if (src_addr != NULL) {
-                        rte_memcpy(&iph->src_addr, src_addr, sizeof(uint32_t));
+                        replace_addr_inline(
+                            iph, udph, &iph->src_addr, src_addr);
                 }
                 if (dst_addr != NULL) {
-                        rte_memcpy(&iph->dst_addr, dst_addr, sizeof(uint32_t));
+                        replace_addr_inline(
+                            iph, udph, &iph->dst_addr, dst_addr);
                 }
-                in_iphdr_len = (iph->version_ihl & 0x0F) * 32 / 8;
-                udph = (struct udp_hdr*)((char*)iph + in_iphdr_len);
-                recalc_cksum_inline(iph, udph);
         }
 }
 
@@ -30,13 +30,21 @@
 
 #define RTE_LOGTYPE_NCMBUF RTE_LOGTYPE_USER1
 
-static inline __attribute__((always_inline)) void recalc_cksum_inline(
-    struct ipv4_hdr* iph, struct udp_hdr* udph)
+/**
+ * @brief Update the checksums after the UDP payload and the length fields
+ *        changed. Only the total length of the IP header changed, so its
+ *        checksum is updated incrementally (RFC 1624). The UDP checksum covers
+ *        the new payload and is recomputed.
+ *
+ * @param old_ip_len: Old total length in network byte order.
+ */
+static inline __attribute__((always_inline)) void update_cksum_inline(
+    struct ipv4_hdr* iph, struct udp_hdr* udph, uint16_t old_ip_len)
 {
+        iph->hdr_checksum = cksum_replace16(
+            iph->hdr_checksum, old_ip_len, iph->total_length);
         udph->dgram_cksum = 0;
-        iph->hdr_checksum = 0;
         udph->dgram_cksum = rte_ipv4_udptcp_cksum(iph, udph);
-        iph->hdr_checksum = rte_ipv4_cksum(iph);
 }
 
 void check_mbuf_size(
@@ -63,6 +71,7 @@ uint8_t encode_udp_data(struct nck_encoder* enc, struct rte_mbuf* m_in,
         uint16_t in_data_len;
         uint16_t in_iphdr_len;
         uint16_t num_coded = 0;
+        uint16_t old_ip_len;
         struct ipv4_hdr* iph;
         struct udp_hdr* udph;
         uint8_t* pt_data;
@@ -139,9 +148,10 @@ uint8_t encode_udp_data(struct nck_encoder* enc, struct rte_mbuf* m_in,
                         rte_pktmbuf_append(m_in, (skb.len - in_data_len));
                         udph->dgram_len
                             = rte_cpu_to_be_16(skb.len + UDP_HDR_LEN);
+                        old_ip_len = iph->total_length;
                         iph->total_length = rte_cpu_to_be_16(
                             skb.len + UDP_HDR_LEN + in_iphdr_len);
-                        recalc_cksum_inline(iph, udph);
+                        update_cksum_inline(iph, udph, old_ip_len);
                         iph->src_addr = src_addr;
                         if (likely(put_rxq != NULL)) {
                                 (*put_rxq)(m_in, portid);
@@ -166,9 +176,10 @@ uint8_t encode_udp_data(struct nck_encoder* enc, struct rte_mbuf* m_in,
                         rte_pktmbuf_append(m_out, (skb.len - in_data_len));
                         udph->dgram_len
                             = rte_cpu_to_be_16(skb.len + UDP_HDR_LEN);
+                        old_ip_len = iph->total_length;
                         iph->total_length = rte_cpu_to_be_16(
                             skb.len + UDP_HDR_LEN + in_iphdr_len);
-                        recalc_cksum_inline(iph, udph);
+                        update_cksum_inline(iph, udph, old_ip_len);
                         iph->src_addr = src_addr;
                         if (likely(put_rxq != NULL)) {
                                 (*put_rxq)(m_out, portid);
@@ -215,6 +226,7 @@ uint8_t recode_udp_data(struct nck_recoder* rec, struct rte_mbuf* m_in,
         struct udp_hdr* udph;
         uint16_t in_data_len;
         uint16_t num_recoded = 0;
+        uint16_t old_ip_len;
         struct rte_mbuf* m_out = NULL;
         uint8_t* pt_data;
 
@@ -260,10 +272,11 @@ uint8_t recode_udp_data(struct nck_recoder* rec, struct rte_mbuf* m_in,
                 rte_pktmbuf_append(m_out, (skb.len - in_data_len));
 
                 udph->dgram_len = rte_cpu_to_be_16(skb.len + UDP_HDR_LEN);
+                old_ip_len = iph->total_length;
                 iph->total_length
                     = rte_cpu_to_be_16(rte_be_to_cpu_16(iph->total_length)
                         + (skb.len - in_data_len));
-                recalc_cksum_inline(iph, udph);
+                update_cksum_inline(iph, udph, old_ip_len);
                 (*put_rxq)(m_out, portid);
         }
         rte_pktmbuf_free(m_in);
@@ -281,6 +294,7 @@ uint8_t decode_udp_data(struct nck_decoder* dec, struct rte_mbuf* m_in,
         uint16_t in_data_len;
         uint16_t in_iphdr_len;
         uint16_t num_decoded = 0;
+        uint16_t old_ip_len;
         struct ipv4_hdr* iph;
         struct udp_hdr* udph;
         uint8_t* pt_data;
@@ -336,9 +350,10 @@ uint8_t decode_udp_data(struct nck_decoder* dec, struct rte_mbuf* m_in,
                         rte_pktmbuf_trim(m_in, (in_data_len - skb.len));
                         udph->dgram_len
                             = rte_cpu_to_be_16(skb.len + UDP_HDR_LEN);
+                        old_ip_len = iph->total_length;
                         iph->total_length = rte_cpu_to_be_16(
                             skb.len + UDP_HDR_LEN + in_iphdr_len);
-                        recalc_cksum_inline(iph, udph);
+                        update_cksum_inline(iph, udph, old_ip_len);
                         iph->src_addr = src_addr;
                         (*put_rxq)(m_in, portid);
                 } else {
@@ -358,9 +373,10 @@ uint8_t decode_udp_data(struct nck_decoder* dec, struct rte_mbuf* m_in,
                         rte_pktmbuf_trim(m_out, (in_data_len - skb.len));
                         udph->dgram_len
                             = rte_cpu_to_be_16(skb.len + UDP_HDR_LEN);
+                        old_ip_len = iph->total_length;
                         iph->total_length = rte_cpu_to_be_16(
                             skb.len + UDP_HDR_LEN + in_iphdr_len);
-                        recalc_cksum_inline(iph, udph);
+                        update_cksum_inline(iph, udph, old_ip_len);
                         iph->src_addr = src_addr;
                         (*put_rxq)(m_out, portid);
                 }
@@ -374,6 +390,33 @@ uint8_t decode_udp_data(struct nck_decoder* dec, struct rte_mbuf* m_in,
         return 0;
 }
 
+/* MARK: Key and IV are hard-coded currently */
+#if defined(AES256) && (AES256 == 1)
+static const uint8_t aes_key[32] = { 0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71,
+        0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81, 0x1f, 0x35, 0x2c,
+        0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf,
+        0xf4 };
+
+#elif defined(AES192) && (AES192 == 1)
+static const uint8_t aes_key[24] = { 0x8e, 0x73, 0xb0, 0xf7, 0xda, 0x0e, 0x64,
+        0x52, 0xc8, 0x10, 0xf3, 0x2b, 0x80, 0x90, 0x79, 0xe5, 0x62, 0xf8, 0xea,
+        0xd2, 0x52, 0x2c, 0x6b, 0x7b };
+
+#elif defined(AES128) && (AES128 == 1)
+static const uint8_t aes_key[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2,
+        0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+#endif
+static const uint8_t aes_iv[16] = { 0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6,
+        0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff };
+
+/* Round keys of aes_key, expanded once before main(). */
+static struct AES_ctx aes_key_ctx;
+
+static void __attribute__((constructor)) init_aes_key_ctx(void)
+{
+        AES_init_ctx(&aes_key_ctx, aes_key);
+}
+
 uint8_t aes_ctr_xcrypt_udp_data(struct rte_mbuf* m_in, uint16_t portid,
     void (*put_rxq)(struct rte_mbuf*, uint16_t))
 {
@@ -385,25 +428,6 @@ uint8_t aes_ctr_xcrypt_udp_data(struct rte_mbuf* m_in, uint16_t portid,
         uint32_t src_addr;
         struct AES_ctx ctx;
 
-/* MARK: Key and IV are hard-coded currently */
-#if defined(AES256) && (AES256 == 1)
-        static uint8_t key[32] = { 0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71,
-                0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81, 0x1f,
-                0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10,
-                0xa3, 0x09, 0x14, 0xdf, 0xf4 };
-
-#elif defined(AES192) && (AES192 == 1)
-        uint8_t key[24] = { 0x8e, 0x73, 0xb0, 0xf7, 0xda, 0x0e, 0x64, 0x52,
-                0xc8, 0x10, 0xf3, 0x2b, 0x80, 0x90, 0x79, 0xe5, 0x62, 0xf8,
-                0xea, 0xd2, 0x52, 0x2c, 0x6b, 0x7b };
-
-#elif defined(AES128) && (AES128 == 1)
-        uint8_t key[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
-                0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
-#endif
-        static uint8_t iv[16] = { 0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6,
-                0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff };
-
         iph = rte_pktmbuf_mtod_offset(m_in, struct ipv4_hdr*, ETHER_HDR_LEN);
         src_addr = iph->src_addr;
         in_iphdr_len = (iph->version_ihl & 0x0F) * 32 / 8;
@@ -411,10 +435,16 @@ uint8_t aes_ctr_xcrypt_udp_data(struct rte_mbuf* m_in, uint16_t portid,
         in_data_len = rte_be_to_cpu_16(udph->dgram_len) - UDP_HDR_LEN;
         pt_data = (uint8_t*)(udph) + UDP_HDR_LEN;
 
-        AES_init_ctx_iv(&ctx, key, iv);
+        /* The CTR mode advances the IV in the context, so each packet starts
+         * from a copy of the round keys. */
+        ctx = aes_key_ctx;
+        AES_ctx_set_iv(&ctx, aes_iv);
         AES_CTR_xcrypt_buffer(&ctx, pt_data, in_data_len);
 
-        recalc_cksum_inline(iph, udph);
+        /* The IP header is not changed, only the UDP checksum covers the
+         * encrypted payload. */
+        udph->dgram_cksum = 0;
+        udph->dgram_cksum = rte_ipv4_udptcp_cksum(iph, udph);
         iph->src_addr = src_addr;
 
         if (put_rxq != NULL) {
@@ -0,0 +1,390 @@
+/*
+ * aead_bench.c
+ *
+ * About: Packet rate of authenticated encryption of UDP payloads, AES-GCM with
+ *        the GCM processor (see ffpp/gcm.h) compared to AES-CBC with the
+ *        multi-buffer ffpp_crypto_encrypt_mvec() and a separate
+ *        HMAC-SHA256-128 (OpenSSL).
+ *
+ *        Each iteration takes a burst of packets, encrypts and authenticates
+ *        them, verifies and decrypts them again and puts them back. The GCM
+ *        processors gather the packets of several bursts until their batch is
+ *        full. The CBC mode keeps the HMAC tags outside of the packets.
+ *
+ * Usage: aead_bench [EAL options] -- -m MODE [-a IMPL] [-s SIZE]
+ *        [-b BURST] [-B BATCH] [-i ITERATIONS]
+ *        MODE: gcm or cbc_hmac
+ *        IMPL: sw, aesni or vaes, default: the one selected at startup
+ *        SIZE: Frame size in bytes, default: 1500
+ *        BATCH: Batch size of the GCM processors, default: 32
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// The HMAC_CTX API is available in OpenSSL 1.1.1 and deprecated in 3.0.
+#define OPENSSL_API_COMPAT 0x10101000L
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_ring.h>
+#include <rte_udp.h>
+
+#include <ffpp/aes.h>
+#include <ffpp/collections.h>
+#include <ffpp/crypto.h>
+#include <ffpp/gcm.h>
+#include <ffpp/memory.h>
+
+#define MAX_BURST 256
+#define HMAC_TAG_LEN 16
+#define PAYLOAD_OFFSET                                                         \
+	(RTE_ETHER_HDR_LEN + sizeof(struct rte_ipv4_hdr) +                     \
+	 sizeof(struct rte_udp_hdr))
+// Packets in the benchmark, enough for a burst and the full batches of both
+// GCM processors.
+#define NB_PKTS (MAX_BURST + 2 * FFPP_GCM_BATCH_MAX)
+#define RING_SIZE 1024
+
+static bool gcm = true;
+static uint16_t size = 1500;
+static uint16_t burst = 64;
+static uint16_t batch_size = FFPP_GCM_BATCH_DEFAULT;
+static uint32_t nb_iterations = 100000;
+
+static const uint8_t key[AES_KEYLEN] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae,
+					 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88,
+					 0x09, 0xcf, 0x4f, 0x3c };
+static const uint8_t salt[FFPP_GCM_SALT_LEN] = { 0xca, 0xfe, 0xba, 0xbe };
+
+struct cbc_hmac {
+	struct ffpp_crypto_session *s;
+	HMAC_CTX *mac;
+	uint64_t seqs[MAX_BURST];
+	uint8_t tags[MAX_BURST][HMAC_TAG_LEN];
+	uint64_t auth_failed;
+};
+
+struct gcm_pair {
+	struct ffpp_gcm *enc;
+	struct ffpp_gcm *dec;
+	struct ffpp_mvec mid;
+	struct ffpp_mvec out;
+};
+
+static void usage(void)
+{
+	printf("Usage: aead_bench [EAL options] -- -m gcm|cbc_hmac "
+	       "[-a sw|aesni|vaes] [-s SIZE] [-b BURST] [-B BATCH] "
+	       "[-i ITERATIONS]\n");
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int opt = 0;
+	int i;
+
+	while ((opt = getopt(argc, argv, "m:a:s:b:B:i:h")) != -1) {
+		switch (opt) {
+		case 'm':
+			if (strcmp(optarg, "gcm") == 0) {
+				gcm = true;
+			} else if (strcmp(optarg, "cbc_hmac") == 0) {
+				gcm = false;
+			} else {
+				usage();
+				rte_exit(EXIT_FAILURE, "Unknown mode!\n");
+			}
+			break;
+		case 'a':
+			for (i = 0; i < AES_IMPL_MAX; ++i) {
+				if (strcmp(optarg, AES_impl_name(i)) == 0) {
+					break;
+				}
+			}
+			if (i == AES_IMPL_MAX || AES_set_impl(i) != 0) {
+				rte_exit(EXIT_FAILURE,
+					 "Implementation %s is not "
+					 "supported!\n",
+					 optarg);
+			}
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 'b':
+			burst = atoi(optarg);
+			break;
+		case 'B':
+			batch_size = atoi(optarg);
+			break;
+		case 'i':
+			nb_iterations = atoi(optarg);
+			break;
+		default:
+			usage();
+			rte_exit(EXIT_FAILURE, "Can not parse arguments!\n");
+		}
+	}
+	if (size <= PAYLOAD_OFFSET || size > RTE_ETHER_MAX_LEN ||
+	    burst == 0 || burst > MAX_BURST || batch_size == 0 ||
+	    batch_size > FFPP_GCM_BATCH_MAX || nb_iterations == 0) {
+		usage();
+		rte_exit(EXIT_FAILURE, "Invalid arguments!\n");
+	}
+}
+
+static void build_udp(struct rte_mbuf *m)
+{
+	struct rte_ether_hdr *eth;
+	struct rte_ipv4_hdr *ip;
+	struct rte_udp_hdr *udp;
+	uint8_t *data;
+	uint16_t i;
+
+	data = (uint8_t *)rte_pktmbuf_append(m, size);
+	if (data == NULL) {
+		rte_exit(EXIT_FAILURE, "The mbufs are too small.\n");
+	}
+	for (i = 0; i < size; ++i) {
+		data[i] = (uint8_t)i;
+	}
+	eth = (struct rte_ether_hdr *)data;
+	eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+	ip = (struct rte_ipv4_hdr *)(eth + 1);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = rte_cpu_to_be_16(size - RTE_ETHER_HDR_LEN);
+	ip->next_proto_id = IPPROTO_UDP;
+	udp = (struct rte_udp_hdr *)(ip + 1);
+	udp->dgram_len = rte_cpu_to_be_16(size - RTE_ETHER_HDR_LEN -
+					  sizeof(struct rte_ipv4_hdr));
+}
+
+static void hmac(HMAC_CTX *mac, const uint8_t *data, size_t len, uint8_t *tag)
+{
+	uint8_t out[EVP_MAX_MD_SIZE];
+	unsigned int out_len;
+
+	// The key and the digest of the context are reused.
+	if (HMAC_Init_ex(mac, NULL, 0, NULL, NULL) != 1 ||
+	    HMAC_Update(mac, data, len) != 1 ||
+	    HMAC_Final(mac, out, &out_len) != 1) {
+		rte_exit(EXIT_FAILURE, "HMAC failed.\n");
+	}
+	memcpy(tag, out, HMAC_TAG_LEN);
+}
+
+static void run_cbc_hmac(struct cbc_hmac *ch, struct ffpp_mvec *vec)
+{
+	uint8_t tag[HMAC_TAG_LEN];
+	struct rte_mbuf *m;
+	uint8_t *payload;
+	uint16_t i;
+
+	// Encrypt-then-MAC.
+	ffpp_crypto_encrypt_mvec(ch->s, vec, PAYLOAD_OFFSET, ch->seqs);
+	FFPP_MVEC_FOREACH(vec, i, m)
+	{
+		hmac(ch->mac,
+		     rte_pktmbuf_mtod_offset(m, uint8_t *, PAYLOAD_OFFSET),
+		     size - PAYLOAD_OFFSET, ch->tags[i]);
+	}
+	FFPP_MVEC_FOREACH(vec, i, m)
+	{
+		payload = rte_pktmbuf_mtod_offset(m, uint8_t *,
+						  PAYLOAD_OFFSET);
+		hmac(ch->mac, payload, size - PAYLOAD_OFFSET, tag);
+		if (CRYPTO_memcmp(tag, ch->tags[i], HMAC_TAG_LEN) != 0) {
+			ch->auth_failed += 1;
+			continue;
+		}
+		ffpp_crypto_decrypt(ch->s, payload, size - PAYLOAD_OFFSET,
+				    ch->seqs[i]);
+	}
+}
+
+static void run_gcm(struct gcm_pair *gp, struct ffpp_mvec *vec)
+{
+	ffpp_gcm_process(gp->enc, 0, vec, &gp->mid);
+	ffpp_gcm_process(gp->dec, 0, &gp->mid, &gp->out);
+	// Hand the decrypted packets to the caller.
+	memcpy(vec->head + vec->len, gp->out.head,
+	       gp->out.len * sizeof(gp->out.head[0]));
+	vec->len += gp->out.len;
+	gp->out.len = 0;
+}
+
+static void run_once(struct rte_ring *ring, struct ffpp_mvec *vec,
+		     struct gcm_pair *gp, struct cbc_hmac *ch)
+{
+	vec->len = rte_ring_sc_dequeue_burst(ring, (void **)vec->head, burst,
+					     NULL);
+	if (gcm) {
+		run_gcm(gp, vec);
+	} else {
+		run_cbc_hmac(ch, vec);
+	}
+	rte_ring_sp_enqueue_burst(ring, (void **)vec->head, vec->len, NULL);
+	vec->len = 0;
+}
+
+static struct ffpp_gcm *create_gcm(const char *name, enum ffpp_crypto_dir dir)
+{
+	struct ffpp_gcm_config cfg;
+	struct ffpp_gcm *g;
+
+	memset(&cfg, 0, sizeof(cfg));
+	snprintf(cfg.name, sizeof(cfg.name), "%s", name);
+	cfg.socket_id = rte_socket_id();
+	cfg.nb_parts = 1;
+	cfg.offset = PAYLOAD_OFFSET;
+	cfg.batch_size = batch_size;
+	cfg.dir = dir;
+	memcpy(cfg.key, key, sizeof(cfg.key));
+	memcpy(cfg.salt, salt, sizeof(cfg.salt));
+	g = ffpp_gcm_create(&cfg);
+	if (g == NULL) {
+		rte_exit(EXIT_FAILURE, "Can not create the GCM processor.\n");
+	}
+	return g;
+}
+
+static void init_cbc_hmac(struct cbc_hmac *ch, struct ffpp_crypto **c)
+{
+	struct ffpp_crypto_session_params params;
+	struct ffpp_crypto_config cfg;
+	int ret;
+
+	memset(&cfg, 0, sizeof(cfg));
+	snprintf(cfg.name, sizeof(cfg.name), "aead_bench");
+	cfg.socket_id = rte_socket_id();
+	cfg.nb_parts = 1;
+	cfg.max_sessions = 1;
+	cfg.max_flows = 64;
+	cfg.offset = PAYLOAD_OFFSET;
+	*c = ffpp_crypto_create(&cfg);
+	if (*c == NULL) {
+		rte_exit(EXIT_FAILURE, "Can not create the crypto context.\n");
+	}
+	memset(&params, 0, sizeof(params));
+	params.algo = FFPP_CRYPTO_AES_CBC;
+	memcpy(params.key, key, sizeof(params.key));
+	ret = ffpp_crypto_session_create(*c, &params);
+	if (ret < 0) {
+		rte_exit(EXIT_FAILURE, "Can not create the session.\n");
+	}
+	ch->s = ffpp_crypto_session_get(*c, 0, ret);
+
+	ch->mac = HMAC_CTX_new();
+	if (ch->mac == NULL ||
+	    HMAC_Init_ex(ch->mac, key, sizeof(key), EVP_sha256(), NULL) != 1) {
+		rte_exit(EXIT_FAILURE, "Can not create the HMAC context.\n");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct rte_mbuf *pkts[NB_PKTS];
+	static struct cbc_hmac ch;
+	struct ffpp_crypto *c = NULL;
+	struct ffpp_gcm_stats stats;
+	struct rte_mempool *pool;
+	struct rte_ring *ring;
+	uint64_t start, cycles;
+	uint64_t auth_failed;
+	struct gcm_pair gp;
+	struct ffpp_mvec vec;
+	uint32_t i;
+	int ret;
+
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	argc -= ret;
+	argv += ret;
+	parse_args(argc, argv);
+
+	pool = ffpp_init_mempool("aead_bench", 2 * NB_PKTS - 1,
+				 RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	ring = rte_ring_create("aead_bench", RING_SIZE, rte_socket_id(),
+			       RING_F_SP_ENQ | RING_F_SC_DEQ);
+	if (pool == NULL || ring == NULL ||
+	    rte_pktmbuf_alloc_bulk(pool, pkts, NB_PKTS) != 0) {
+		rte_exit(EXIT_FAILURE, "Can not allocate the mbufs.\n");
+	}
+	for (i = 0; i < NB_PKTS; ++i) {
+		build_udp(pkts[i]);
+	}
+	rte_ring_sp_enqueue_bulk(ring, (void **)pkts, NB_PKTS, NULL);
+	// Room for a burst and the packets of a full batch.
+	ffpp_mvec_init(&vec, MAX_BURST + FFPP_GCM_BATCH_MAX);
+
+	memset(&gp, 0, sizeof(gp));
+	if (gcm) {
+		gp.enc = create_gcm("aead_bench_enc", FFPP_CRYPTO_ENCRYPT);
+		gp.dec = create_gcm("aead_bench_dec", FFPP_CRYPTO_DECRYPT);
+		ffpp_mvec_init(&gp.mid, MAX_BURST + FFPP_GCM_BATCH_MAX);
+		ffpp_mvec_init(&gp.out, MAX_BURST + FFPP_GCM_BATCH_MAX);
+	} else {
+		init_cbc_hmac(&ch, &c);
+	}
+
+	// Warm up the caches and the branch predictors.
+	for (i = 0; i < nb_iterations / 10 + 1; ++i) {
+		run_once(ring, &vec, &gp, &ch);
+	}
+	start = rte_rdtsc_precise();
+	for (i = 0; i < nb_iterations; ++i) {
+		run_once(ring, &vec, &gp, &ch);
+	}
+	cycles = rte_rdtsc_precise() - start;
+
+	auth_failed = ch.auth_failed;
+	if (gcm) {
+		ffpp_gcm_get_stats(gp.dec, 0, &stats);
+		auth_failed = stats.auth_failed;
+	}
+	if (auth_failed != 0) {
+		rte_exit(EXIT_FAILURE,
+			 "%" PRIu64 " packets were not authentic.\n",
+			 auth_failed);
+	}
+
+	printf("impl,mode,size,burst,batch,iterations,cycles_per_pkt,mpps\n");
+	printf("%s,%s,%u,%u,%u,%u,%.1f,%.3f\n", AES_impl_name(AES_get_impl()),
+	       gcm ? "gcm" : "cbc_hmac", size, burst, gcm ? batch_size : 0,
+	       nb_iterations, (double)cycles / ((double)burst * nb_iterations),
+	       (double)burst * nb_iterations * rte_get_tsc_hz() / cycles /
+		       1e6);
+
+	if (gcm) {
+		ffpp_gcm_free(gp.enc);
+		ffpp_gcm_free(gp.dec);
+		ffpp_mvec_free(&gp.mid);
+		ffpp_mvec_free(&gp.out);
+	} else {
+		HMAC_CTX_free(ch.mac);
+		ffpp_crypto_free(c);
+	}
+	while (rte_ring_sc_dequeue(ring, (void **)&pkts[0]) == 0) {
+		rte_pktmbuf_free(pkts[0]);
+	}
+	ffpp_mvec_free(&vec);
+	rte_ring_free(ring);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * aes_bench.c
+ *
+ * About: Throughput of the AES modes of ffpp/aes.h in cycles per byte, for
+ *        each implementation (see AES_set_impl()).
+ *
+ *        Like in the MuNF examples, the buffer is encrypted in place and the
+ *        key expansion is not measured. The buffer stays in the L1/L2 cache,
+ *        so the numbers are the upper bound of the cipher itself.
+ *
+ * Usage: aes_bench [EAL options] -- -m MODE [-a IMPL] [-s SIZE]
+ *        [-i ITERATIONS]
+ *        MODE: ecb_enc, ecb_dec, cbc_enc, cbc_dec or ctr
+ *        IMPL: sw, aesni or vaes, default: the one selected at startup
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_malloc.h>
+
+#include <ffpp/aes.h>
+
+#define MAX_SIZE (1U << 20)
+
+enum aes_mode {
+	MODE_ECB_ENC,
+	MODE_ECB_DEC,
+	MODE_CBC_ENC,
+	MODE_CBC_DEC,
+	MODE_CTR,
+};
+static const char *mode_names[] = { "ecb_enc", "ecb_dec", "cbc_enc", "cbc_dec",
+				    "ctr" };
+
+static enum aes_mode mode = MODE_CBC_ENC;
+static uint32_t size = 1500;
+static uint32_t nb_iterations = 100000;
+
+static const uint8_t aes_key[AES_KEYLEN] = { 0x2b, 0x7e, 0x15, 0x16,
+					     0x28, 0xae, 0xd2, 0xa6,
+					     0xab, 0xf7, 0x15, 0x88,
+					     0x09, 0xcf, 0x4f, 0x3c };
+static const uint8_t aes_iv[AES_BLOCKLEN] = { 0x00, 0x01, 0x02, 0x03,
+					      0x04, 0x05, 0x06, 0x07,
+					      0x08, 0x09, 0x0a, 0x0b,
+					      0x0c, 0x0d, 0x0e, 0x0f };
+
+static void usage(void)
+{
+	printf("Usage: aes_bench [EAL options] -- -m "
+	       "ecb_enc|ecb_dec|cbc_enc|cbc_dec|ctr [-a sw|aesni|vaes] "
+	       "[-s SIZE] [-i ITERATIONS]\n");
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int opt = 0;
+	int i;
+
+	while ((opt = getopt(argc, argv, "m:a:s:i:h")) != -1) {
+		switch (opt) {
+		case 'm':
+			for (i = 0; i < (int)RTE_DIM(mode_names); ++i) {
+				if (strcmp(optarg, mode_names[i]) == 0) {
+					mode = i;
+					break;
+				}
+			}
+			if (i == (int)RTE_DIM(mode_names)) {
+				usage();
+				rte_exit(EXIT_FAILURE, "Unknown mode!\n");
+			}
+			break;
+		case 'a':
+			for (i = 0; i < AES_IMPL_MAX; ++i) {
+				if (strcmp(optarg, AES_impl_name(i)) == 0) {
+					break;
+				}
+			}
+			if (i == AES_IMPL_MAX || AES_set_impl(i) != 0) {
+				rte_exit(EXIT_FAILURE,
+					 "Implementation %s is not "
+					 "supported!\n",
+					 optarg);
+			}
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 'i':
+			nb_iterations = atoi(optarg);
+			break;
+		default:
+			usage();
+			rte_exit(EXIT_FAILURE, "Can not parse arguments!\n");
+		}
+	}
+	if (size == 0 || size > MAX_SIZE || size % AES_BLOCKLEN != 0 ||
+	    nb_iterations == 0) {
+		usage();
+		rte_exit(EXIT_FAILURE, "Invalid arguments!\n");
+	}
+}
+
+static void run_once(struct AES_ctx *ctx, uint8_t *buf)
+{
+	uint32_t off;
+
+	switch (mode) {
+	case MODE_ECB_ENC:
+		for (off = 0; off < size; off += AES_BLOCKLEN) {
+			AES_ECB_encrypt(ctx, buf + off);
+		}
+		break;
+	case MODE_ECB_DEC:
+		for (off = 0; off < size; off += AES_BLOCKLEN) {
+			AES_ECB_decrypt(ctx, buf + off);
+		}
+		break;
+	case MODE_CBC_ENC:
+		AES_ctx_set_iv(ctx, aes_iv);
+		AES_CBC_encrypt_buffer(ctx, buf, size);
+		break;
+	case MODE_CBC_DEC:
+		AES_ctx_set_iv(ctx, aes_iv);
+		AES_CBC_decrypt_buffer(ctx, buf, size);
+		break;
+	case MODE_CTR:
+		AES_ctx_set_iv(ctx, aes_iv);
+		AES_CTR_xcrypt_buffer(ctx, buf, size);
+		break;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct AES_ctx ctx;
+	uint64_t start, cycles;
+	uint8_t *buf;
+	uint32_t i;
+	int ret;
+
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	argc -= ret;
+	argv += ret;
+	parse_args(argc, argv);
+
+	buf = rte_zmalloc("aes_bench", size, RTE_CACHE_LINE_SIZE);
+	if (buf == NULL) {
+		rte_exit(EXIT_FAILURE, "Can not allocate the buffer.\n");
+	}
+	for (i = 0; i < size; ++i) {
+		buf[i] = (uint8_t)i;
+	}
+	AES_init_ctx_iv(&ctx, aes_key, aes_iv);
+
+	// Warm up the caches and the branch predictors.
+	for (i = 0; i < nb_iterations / 10 + 1; ++i) {
+		run_once(&ctx, buf);
+	}
+	start = rte_rdtsc_precise();
+	for (i = 0; i < nb_iterations; ++i) {
+		run_once(&ctx, buf);
+	}
+	cycles = rte_rdtsc_precise() - start;
+
+	printf("impl,mode,size,iterations,cycles_per_byte,gbps\n");
+	printf("%s,%s,%u,%u,%.3f,%.3f\n", AES_impl_name(AES_get_impl()),
+	       mode_names[mode], size, nb_iterations,
+	       (double)cycles / ((double)size * nb_iterations),
+	       (double)size * nb_iterations * 8 * rte_get_tsc_hz() / cycles /
+		       1e9);
+
+	rte_free(buf);
+	rte_eal_cleanup();
+	return 0;
+}
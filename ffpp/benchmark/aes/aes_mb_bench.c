@@ -0,0 +1,226 @@
+/*
+ * aes_mb_bench.c
+ *
+ * About: Packet rate of CBC encryption of a burst with one crypto session
+ *        (see ffpp/crypto.h), packet by packet with ffpp_crypto_encrypt() or
+ *        interleaved with the multi-buffer ffpp_crypto_encrypt_mvec().
+ *
+ *        The UDP payload of each packet is encrypted in place, the burst is
+ *        reused for all iterations and stays in the cache.
+ *
+ * Usage: aes_mb_bench [EAL options] -- -m MODE [-a IMPL] [-s SIZE]
+ *        [-b BURST] [-i ITERATIONS]
+ *        MODE: single or multi
+ *        IMPL: sw, aesni or vaes, default: the one selected at startup
+ *        SIZE: Frame size in bytes, default: 1500
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_udp.h>
+
+#include <ffpp/aes.h>
+#include <ffpp/collections.h>
+#include <ffpp/crypto.h>
+#include <ffpp/memory.h>
+
+#define MAX_BURST 256
+#define PAYLOAD_OFFSET                                                         \
+	(RTE_ETHER_HDR_LEN + sizeof(struct rte_ipv4_hdr) +                     \
+	 sizeof(struct rte_udp_hdr))
+
+static bool multi = true;
+static uint16_t size = 1500;
+static uint16_t burst = 64;
+static uint32_t nb_iterations = 100000;
+
+static const struct ffpp_crypto_session_params params = {
+	.algo = FFPP_CRYPTO_AES_CBC,
+	.key = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7,
+		 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c },
+	.salt = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09,
+		  0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f },
+};
+
+static void usage(void)
+{
+	printf("Usage: aes_mb_bench [EAL options] -- -m single|multi "
+	       "[-a sw|aesni|vaes] [-s SIZE] [-b BURST] [-i ITERATIONS]\n");
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int opt = 0;
+	int i;
+
+	while ((opt = getopt(argc, argv, "m:a:s:b:i:h")) != -1) {
+		switch (opt) {
+		case 'm':
+			if (strcmp(optarg, "single") == 0) {
+				multi = false;
+			} else if (strcmp(optarg, "multi") == 0) {
+				multi = true;
+			} else {
+				usage();
+				rte_exit(EXIT_FAILURE, "Unknown mode!\n");
+			}
+			break;
+		case 'a':
+			for (i = 0; i < AES_IMPL_MAX; ++i) {
+				if (strcmp(optarg, AES_impl_name(i)) == 0) {
+					break;
+				}
+			}
+			if (i == AES_IMPL_MAX || AES_set_impl(i) != 0) {
+				rte_exit(EXIT_FAILURE,
+					 "Implementation %s is not "
+					 "supported!\n",
+					 optarg);
+			}
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 'b':
+			burst = atoi(optarg);
+			break;
+		case 'i':
+			nb_iterations = atoi(optarg);
+			break;
+		default:
+			usage();
+			rte_exit(EXIT_FAILURE, "Can not parse arguments!\n");
+		}
+	}
+	if (size <= PAYLOAD_OFFSET || size > RTE_ETHER_MAX_LEN ||
+	    burst == 0 || burst > MAX_BURST || nb_iterations == 0) {
+		usage();
+		rte_exit(EXIT_FAILURE, "Invalid arguments!\n");
+	}
+}
+
+static void build_udp(struct rte_mbuf *m)
+{
+	struct rte_ether_hdr *eth;
+	struct rte_ipv4_hdr *ip;
+	uint8_t *data;
+	uint16_t i;
+
+	data = (uint8_t *)rte_pktmbuf_append(m, size);
+	if (data == NULL) {
+		rte_exit(EXIT_FAILURE, "The mbufs are too small.\n");
+	}
+	for (i = 0; i < size; ++i) {
+		data[i] = (uint8_t)i;
+	}
+	eth = (struct rte_ether_hdr *)data;
+	eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+	ip = (struct rte_ipv4_hdr *)(eth + 1);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = rte_cpu_to_be_16(size - RTE_ETHER_HDR_LEN);
+	ip->next_proto_id = IPPROTO_UDP;
+}
+
+static void run_once(struct ffpp_crypto_session *s, struct ffpp_mvec *vec,
+		     uint64_t *seqs)
+{
+	struct rte_mbuf *m;
+	uint16_t i;
+
+	if (multi) {
+		ffpp_crypto_encrypt_mvec(s, vec, PAYLOAD_OFFSET, seqs);
+		return;
+	}
+	FFPP_MVEC_FOREACH(vec, i, m)
+	{
+		ffpp_crypto_encrypt(s,
+				    rte_pktmbuf_mtod_offset(m, uint8_t *,
+							    PAYLOAD_OFFSET),
+				    size - PAYLOAD_OFFSET, &seqs[i]);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct rte_mbuf *pkts[MAX_BURST];
+	struct ffpp_crypto_config cfg;
+	struct ffpp_crypto_session *s;
+	uint64_t seqs[MAX_BURST];
+	struct rte_mempool *pool;
+	struct ffpp_crypto *c;
+	uint64_t start, cycles;
+	struct ffpp_mvec vec;
+	uint32_t i;
+	int ret;
+
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	argc -= ret;
+	argv += ret;
+	parse_args(argc, argv);
+
+	pool = ffpp_init_mempool("aes_mb_bench", 2 * MAX_BURST - 1,
+				 RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	if (pool == NULL || rte_pktmbuf_alloc_bulk(pool, pkts, burst) != 0) {
+		rte_exit(EXIT_FAILURE, "Can not allocate the mbufs.\n");
+	}
+	for (i = 0; i < burst; ++i) {
+		build_udp(pkts[i]);
+	}
+	ffpp_mvec_init(&vec, burst);
+	ffpp_mvec_set_mbufs(&vec, pkts, burst);
+
+	memset(&cfg, 0, sizeof(cfg));
+	snprintf(cfg.name, sizeof(cfg.name), "aes_mb_bench");
+	cfg.socket_id = rte_socket_id();
+	cfg.nb_parts = 1;
+	cfg.max_sessions = 1;
+	cfg.max_flows = 64;
+	cfg.offset = PAYLOAD_OFFSET;
+	c = ffpp_crypto_create(&cfg);
+	if (c == NULL) {
+		rte_exit(EXIT_FAILURE, "Can not create the crypto context.\n");
+	}
+	ret = ffpp_crypto_session_create(c, &params);
+	if (ret < 0) {
+		rte_exit(EXIT_FAILURE, "Can not create the session.\n");
+	}
+	s = ffpp_crypto_session_get(c, 0, ret);
+
+	// Warm up the caches and the branch predictors.
+	for (i = 0; i < nb_iterations / 10 + 1; ++i) {
+		run_once(s, &vec, seqs);
+	}
+	start = rte_rdtsc_precise();
+	for (i = 0; i < nb_iterations; ++i) {
+		run_once(s, &vec, seqs);
+	}
+	cycles = rte_rdtsc_precise() - start;
+
+	printf("impl,mode,size,burst,iterations,cycles_per_pkt,mpps\n");
+	printf("%s,%s,%u,%u,%u,%.1f,%.3f\n", AES_impl_name(AES_get_impl()),
+	       multi ? "multi" : "single", size, burst, nb_iterations,
+	       (double)cycles / ((double)burst * nb_iterations),
+	       (double)burst * nb_iterations * rte_get_tsc_hz() / cycles /
+		       1e6);
+
+	ffpp_crypto_free(c);
+	ffpp_mvec_free_mbufs(&vec);
+	ffpp_mvec_free(&vec);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
@@ -0,0 +1,27 @@
+#!/bin/bash
+#
+# About: Run the AEAD benchmark (AES-GCM processor vs. multi-buffer AES-CBC with HMAC-SHA256) for the accelerated
+# implementations and 64, 512 and 1500 bytes frames and collect the results in one CSV file. Implementations that the
+# CPU does not support have no rows.
+#
+# Build the benchmark first: meson build && ninja -C build
+#
+
+set -e
+
+LCORES=${LCORES:-"0"}
+ITERATIONS=${ITERATIONS:-100000}
+BURST=${BURST:-32}
+BATCH=${BATCH:-32}
+RESULT=${RESULT:-/tmp/aead_bench.csv}
+
+echo "impl,mode,size,burst,batch,iterations,cycles_per_pkt,mpps" >"$RESULT"
+for impl in aesni vaes; do
+    for mode in gcm cbc_hmac; do
+        for size in 64 512 1500; do
+            ./build/aead_bench -l "$LCORES" --no-pci --in-memory --log-level=3 -- \
+                -a "$impl" -m "$mode" -s "$size" -b "$BURST" -B "$BATCH" -i "$ITERATIONS" | tail -n 1 >>"$RESULT"
+        done
+    done
+done
+cat "$RESULT"
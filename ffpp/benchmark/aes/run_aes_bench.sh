@@ -0,0 +1,29 @@
+#!/bin/bash
+#
+# About: Run the AES benchmark for all modes, implementations and buffer sizes and collect the results in one CSV
+# file. Implementations that the CPU does not support have no rows.
+#
+# Build the benchmark first: meson build && ninja -C build
+#
+
+set -e
+
+LCORES=${LCORES:-"0"}
+ITERATIONS=${ITERATIONS:-100000}
+SW_ITERATIONS=${SW_ITERATIONS:-1000}
+RESULT=${RESULT:-/tmp/aes_bench.csv}
+
+echo "impl,mode,size,iterations,cycles_per_byte,gbps" >"$RESULT"
+for impl in sw aesni vaes; do
+    iterations=$ITERATIONS
+    if [[ "$impl" == "sw" ]]; then
+        iterations=$SW_ITERATIONS
+    fi
+    for mode in ecb_enc ecb_dec cbc_enc cbc_dec ctr; do
+        for size in 64 1504 16384; do
+            ./build/aes_bench -l "$LCORES" --no-pci --in-memory --log-level=3 -- \
+                -a "$impl" -m "$mode" -s "$size" -i "$iterations" | tail -n 1 >>"$RESULT"
+        done
+    done
+done
+cat "$RESULT"
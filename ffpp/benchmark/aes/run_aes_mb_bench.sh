@@ -0,0 +1,30 @@
+#!/bin/bash
+#
+# About: Run the multi-buffer CBC benchmark for all implementations, both modes and 64, 512 and 1500 bytes frames and
+# collect the results in one CSV file. Implementations that the CPU does not support have no rows.
+#
+# Build the benchmark first: meson build && ninja -C build
+#
+
+set -e
+
+LCORES=${LCORES:-"0"}
+ITERATIONS=${ITERATIONS:-100000}
+SW_ITERATIONS=${SW_ITERATIONS:-1000}
+BURST=${BURST:-64}
+RESULT=${RESULT:-/tmp/aes_mb_bench.csv}
+
+echo "impl,mode,size,burst,iterations,cycles_per_pkt,mpps" >"$RESULT"
+for impl in sw aesni vaes; do
+    iterations=$ITERATIONS
+    if [[ "$impl" == "sw" ]]; then
+        iterations=$SW_ITERATIONS
+    fi
+    for mode in single multi; do
+        for size in 64 512 1500; do
+            ./build/aes_mb_bench -l "$LCORES" --no-pci --in-memory --log-level=3 -- \
+                -a "$impl" -m "$mode" -s "$size" -b "$BURST" -i "$iterations" | tail -n 1 >>"$RESULT"
+        done
+    done
+done
+cat "$RESULT"
@@ -0,0 +1,90 @@
+#!/bin/bash
+#
+# About: Compare the AF_XDP backed ffpp port with the XDP redirect forwarder (kern/xdp_fwd) on veth pairs.
+#
+# Run on the host after "./benchmark-local.py setup" in ffpp/util. Start a constant traffic profile in the pktgen
+# container (e.g. ../trex/stl_traffic_models.py) before running this script.
+# The forwarding rate is measured with the RX counter of pktgen-in, so all modes are measured at the same point.
+#
+
+set -e
+
+DURATION=10
+QUEUES=1
+WARMUP=3
+MODES="xdp_fwd af_xdp af_xdp_busy_poll af_xdp_copy"
+
+while getopts "d:q:m:h" opt; do
+    case $opt in
+    d) DURATION=$OPTARG ;;
+    q) QUEUES=$OPTARG ;;
+    m) MODES=$OPTARG ;;
+    *)
+        echo "Usage: $0 [-d duration_s] [-q queues] [-m \"modes\"]"
+        echo "Available modes: xdp_fwd af_xdp af_xdp_busy_poll af_xdp_copy"
+        exit 1
+        ;;
+    esac
+done
+
+read_mac() {
+    docker exec "$1" cat "/sys/class/net/$2/address"
+}
+
+pktgen_rx() {
+    docker exec pktgen cat /sys/class/net/pktgen-in/statistics/rx_packets
+}
+
+PKTGEN_OUT_MAC=$(read_mac pktgen pktgen-out)
+PKTGEN_IN_MAC=$(read_mac pktgen pktgen-in)
+VNF_OUT_MAC=$(read_mac vnf0 vnf-out)
+
+cleanup_vnf() {
+    docker exec vnf0 pkill -INT -f ffpp_af_xdp_fwd || true
+    sleep 1
+    docker exec vnf0 xdp-loader unload vnf-in || true
+    docker exec vnf0 xdp-loader unload vnf-out || true
+    docker exec vnf0 rm -rf /sys/fs/bpf/vnf-in
+    for i in vnf-in vnf-out; do
+        docker exec vnf0 sh -c "echo 0 > /sys/class/net/$i/napi_defer_hard_irqs"
+        docker exec vnf0 sh -c "echo 0 > /sys/class/net/$i/gro_flush_timeout"
+    done
+}
+
+start_mode() {
+    case $1 in
+    xdp_fwd)
+        docker exec -w /ffpp/kern/xdp_fwd vnf0 ./xdp_fwd_loader vnf-in
+        docker exec -w /ffpp/kern/xdp_fwd vnf0 ./xdp_fwd_user -i vnf-in -r vnf-out \
+            -s "$PKTGEN_OUT_MAC" -d "$PKTGEN_IN_MAC" -w "$VNF_OUT_MAC"
+        # The egress veth needs a XDP program to receive redirected frames.
+        docker exec -w /ffpp/kern/xdp_pass vnf0 xdp-loader load -m native vnf-out ./xdp_pass_kern.o
+        ;;
+    af_xdp)
+        docker exec -d -w /ffpp/user/examples/af_xdp_fwd vnf0 ./run.sh -q "$QUEUES" -m auto -b 0
+        ;;
+    af_xdp_busy_poll)
+        for i in vnf-in vnf-out; do
+            docker exec vnf0 sh -c "echo 2 > /sys/class/net/$i/napi_defer_hard_irqs"
+            docker exec vnf0 sh -c "echo 200000 > /sys/class/net/$i/gro_flush_timeout"
+        done
+        docker exec -d -w /ffpp/user/examples/af_xdp_fwd vnf0 ./run.sh -q "$QUEUES" -m auto -b 64
+        ;;
+    af_xdp_copy)
+        docker exec -d -w /ffpp/user/examples/af_xdp_fwd vnf0 ./run.sh -q "$QUEUES" -m copy -b 0
+        ;;
+    esac
+}
+
+echo "mode,queues,duration_s,rx_packets,mpps"
+for mode in $MODES; do
+    cleanup_vnf >/dev/null 2>&1
+    start_mode "$mode" >/dev/null
+    sleep $WARMUP
+    start=$(pktgen_rx)
+    sleep "$DURATION"
+    end=$(pktgen_rx)
+    rx=$((end - start))
+    echo "$mode,$QUEUES,$DURATION,$rx,$(echo "scale=3; $rx / $DURATION / 1000000" | bc)"
+done
+cleanup_vnf >/dev/null 2>&1
@@ -0,0 +1,366 @@
+/*
+ * cls_lookup.c
+ *
+ * About: Lookup cost of the ffpp classifier (see classifier.h) with 1K, 100K
+ *        or 1M rules of one type:
+ *        exact: 5-tuple rules, the source address is the rule index.
+ *        lpm: IPv4 /24 destination prefixes.
+ *        lpm6: IPv6 /48 destination prefixes below 2001:d00::/24.
+ *
+ *        The main lcore classifies a fixed set of packets that all match a
+ *        rule, burst by burst, and reports a quiescent state after each burst.
+ *        With -u, the first worker lcore adds and deletes rules that no packet
+ *        matches as fast as possible meanwhile, to measure the lookup cost
+ *        under concurrent RCU updates.
+ *
+ * Usage: cls_lookup [EAL options] -- -t exact|lpm|lpm6 [-r RULES] [-b BURST]
+ *        [-i ITERATIONS] [-u]
+ */
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_udp.h>
+
+#include <ffpp/classifier.h>
+#include <ffpp/collections.h>
+#include <ffpp/config.h>
+#include <ffpp/memory.h>
+
+#define NB_PKTS 4096
+#define NB_MBUFS 8191
+#define MAX_BURST 256
+#define FRAME_SIZE 128
+#define NB_UPDATE_RULES 64
+// Spread the packets over the rules.
+#define RULE_STRIDE 7919
+
+enum rule_type { RULE_EXACT, RULE_LPM, RULE_LPM6 };
+static const char *type_names[] = { "exact", "lpm", "lpm6" };
+
+static volatile bool force_quit = false;
+static volatile bool stop_updater = false;
+
+static enum rule_type rule_type = RULE_EXACT;
+static uint32_t nb_rules = 1000;
+static uint16_t burst_size = 32;
+static uint32_t nb_iterations = 10000;
+static bool with_updater = false;
+
+static struct ffpp_classifier *cls;
+static uint64_t nb_updates;
+static uint64_t update_cycles;
+
+static void signal_handler(int signum)
+{
+	if (signum == SIGINT || signum == SIGTERM) {
+		force_quit = true;
+	}
+}
+
+static void exact_key(uint32_t i, uint8_t first_octet,
+		      struct ffpp_cls_5tuple *key)
+{
+	memset(key, 0, sizeof(*key));
+	key->src_addr = rte_cpu_to_be_32(RTE_IPV4(first_octet, 0, 0, 0) + i);
+	key->dst_addr = RTE_BE32(RTE_IPV4(192, 168, 0, 2));
+	key->src_port = RTE_BE16(5000);
+	key->dst_port = RTE_BE16(5001);
+	key->proto = IPPROTO_UDP;
+}
+
+/* The /24 prefixes start at 16.0.0.0, 1M of them end before 32.0.0.0. */
+static uint32_t lpm_prefix(uint32_t i)
+{
+	return RTE_IPV4(16, 0, 0, 0) + (i << 8);
+}
+
+/* The rules share the first 24 bits to keep the number of tbl8 groups low. */
+static void lpm6_prefix(uint32_t i, uint8_t second_byte,
+			uint8_t ip[RTE_LPM6_IPV6_ADDR_SIZE])
+{
+	memset(ip, 0, RTE_LPM6_IPV6_ADDR_SIZE);
+	ip[0] = 0x20;
+	ip[1] = second_byte;
+	ip[2] = 0x0d;
+	ip[3] = i >> 16;
+	ip[4] = i >> 8;
+	ip[5] = i;
+}
+
+static int add_rule(uint32_t i, bool updater)
+{
+	struct ffpp_cls_5tuple key;
+	uint8_t ip6[RTE_LPM6_IPV6_ADDR_SIZE];
+	uint32_t action = i % FFPP_CLS_ACTION_MAX;
+
+	switch (rule_type) {
+	case RULE_EXACT:
+		exact_key(i, updater ? 11 : 10, &key);
+		return ffpp_cls_add_exact(cls, &key, action);
+	case RULE_LPM:
+		return ffpp_cls_add_lpm(
+			cls, updater ? RTE_IPV4(200, 0, i, 0) : lpm_prefix(i),
+			24, action);
+	default:
+		lpm6_prefix(i, updater ? 0x02 : 0x01, ip6);
+		return ffpp_cls_add_lpm6(cls, ip6, 48, action);
+	}
+}
+
+static int del_rule(uint32_t i)
+{
+	struct ffpp_cls_5tuple key;
+	uint8_t ip6[RTE_LPM6_IPV6_ADDR_SIZE];
+
+	switch (rule_type) {
+	case RULE_EXACT:
+		exact_key(i, 11, &key);
+		return ffpp_cls_del_exact(cls, &key);
+	case RULE_LPM:
+		return ffpp_cls_del_lpm(cls, RTE_IPV4(200, 0, i, 0), 24);
+	default:
+		lpm6_prefix(i, 0x02, ip6);
+		return ffpp_cls_del_lpm6(cls, ip6, 48);
+	}
+}
+
+/* Add and delete NB_UPDATE_RULES rules until the lookups are done. */
+static int updater_loop(void *arg)
+{
+	uint64_t start = rte_rdtsc();
+	uint32_t i;
+
+	RTE_SET_USED(arg);
+	while (!stop_updater) {
+		for (i = 0; i < NB_UPDATE_RULES; ++i) {
+			if (add_rule(i, true) < 0) {
+				RTE_LOG(ERR, FFPP,
+					"Can not add an update rule.\n");
+				return -1;
+			}
+		}
+		for (i = 0; i < NB_UPDATE_RULES; ++i) {
+			del_rule(i);
+		}
+		nb_updates += 2 * NB_UPDATE_RULES;
+	}
+	update_cycles = rte_rdtsc() - start;
+	return 0;
+}
+
+static void build_pkt(struct rte_mbuf *m, uint32_t rule)
+{
+	struct rte_ether_hdr *eth;
+	struct rte_ipv4_hdr *ip;
+	struct rte_ipv6_hdr *ip6;
+	struct rte_udp_hdr *udp;
+
+	eth = (struct rte_ether_hdr *)rte_pktmbuf_append(m, FRAME_SIZE);
+	memset(eth, 0, FRAME_SIZE);
+	if (rule_type == RULE_LPM6) {
+		eth->ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV6);
+		ip6 = (struct rte_ipv6_hdr *)(eth + 1);
+		ip6->vtc_flow = RTE_BE32(6 << 28);
+		ip6->proto = IPPROTO_UDP;
+		ip6->hop_limits = 64;
+		lpm6_prefix(rule, 0x01, ip6->dst_addr);
+		ip6->dst_addr[15] = 1;
+		return;
+	}
+
+	eth->ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV4);
+	ip = (struct rte_ipv4_hdr *)(eth + 1);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = rte_cpu_to_be_16(FRAME_SIZE - RTE_ETHER_HDR_LEN);
+	ip->time_to_live = 64;
+	ip->next_proto_id = IPPROTO_UDP;
+	if (rule_type == RULE_EXACT) {
+		ip->src_addr =
+			rte_cpu_to_be_32(RTE_IPV4(10, 0, 0, 0) + rule);
+		ip->dst_addr = RTE_BE32(RTE_IPV4(192, 168, 0, 2));
+	} else {
+		ip->src_addr = RTE_BE32(RTE_IPV4(192, 168, 0, 1));
+		ip->dst_addr = rte_cpu_to_be_32(lpm_prefix(rule) | 1);
+	}
+	udp = (struct rte_udp_hdr *)(ip + 1);
+	udp->src_port = RTE_BE16(5000);
+	udp->dst_port = RTE_BE16(5001);
+}
+
+static void usage(void)
+{
+	printf("Usage: cls_lookup [EAL options] -- -t exact|lpm|lpm6 "
+	       "[-r RULES] [-b BURST] [-i ITERATIONS] [-u]\n");
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int opt = 0;
+	int i;
+
+	while ((opt = getopt(argc, argv, "t:r:b:i:uh")) != -1) {
+		switch (opt) {
+		case 't':
+			for (i = 0; i < 3; ++i) {
+				if (strcmp(optarg, type_names[i]) == 0) {
+					rule_type = i;
+					break;
+				}
+			}
+			if (i == 3) {
+				usage();
+				rte_exit(EXIT_FAILURE, "Unknown rule type!\n");
+			}
+			break;
+		case 'r':
+			nb_rules = atoi(optarg);
+			break;
+		case 'b':
+			burst_size = atoi(optarg);
+			break;
+		case 'i':
+			nb_iterations = atoi(optarg);
+			break;
+		case 'u':
+			with_updater = true;
+			break;
+		default:
+			usage();
+			rte_exit(EXIT_FAILURE, "Can not parse arguments!\n");
+		}
+	}
+	// The LPM prefixes must stay below 80.0.0.0.
+	if (nb_rules == 0 || nb_rules > (1U << 22) || burst_size == 0 ||
+	    burst_size > MAX_BURST || NB_PKTS % burst_size != 0 ||
+	    nb_iterations == 0) {
+		usage();
+		rte_exit(EXIT_FAILURE, "Invalid arguments!\n");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct ffpp_cls_config cfg;
+	struct ffpp_mvec vecs[NB_PKTS];
+	struct rte_mbuf *pkts[NB_PKTS];
+	uint32_t actions[MAX_BURST];
+	struct rte_mempool *pool;
+	unsigned int lcore_id, updater_lcore;
+	uint64_t start, cycles, nb_lookups = 0, nb_match = 0;
+	uint16_t nb_vecs;
+	uint32_t i, it;
+	int ret;
+
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	argc -= ret;
+	argv += ret;
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+	parse_args(argc, argv);
+	lcore_id = rte_lcore_id();
+
+	memset(&cfg, 0, sizeof(cfg));
+	snprintf(cfg.name, sizeof(cfg.name), "cls_%s", type_names[rule_type]);
+	cfg.socket_id = rte_socket_id();
+	switch (rule_type) {
+	case RULE_EXACT:
+		cfg.max_exact_rules = nb_rules + NB_UPDATE_RULES;
+		break;
+	case RULE_LPM:
+		cfg.max_lpm_rules = nb_rules + NB_UPDATE_RULES;
+		break;
+	default:
+		cfg.max_lpm6_rules = nb_rules + NB_UPDATE_RULES;
+	}
+	cls = ffpp_cls_create(&cfg);
+	if (cls == NULL) {
+		rte_exit(EXIT_FAILURE, "Can not create the classifier.\n");
+	}
+	// No reader is registered yet, LPM6 updates do not block.
+	for (i = 0; i < nb_rules; ++i) {
+		if (add_rule(i, false) < 0) {
+			rte_exit(EXIT_FAILURE, "Can not add rule %u.\n", i);
+		}
+	}
+
+	pool = ffpp_init_mempool("cls_lookup", NB_MBUFS,
+				 RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	if (pool == NULL || rte_pktmbuf_alloc_bulk(pool, pkts, NB_PKTS) < 0) {
+		rte_exit(EXIT_FAILURE, "Can not allocate the packets.\n");
+	}
+	for (i = 0; i < NB_PKTS; ++i) {
+		build_pkt(pkts[i], (uint64_t)i * RULE_STRIDE % nb_rules);
+	}
+	nb_vecs = NB_PKTS / burst_size;
+	for (i = 0; i < nb_vecs; ++i) {
+		ffpp_mvec_init(&vecs[i], burst_size);
+		ffpp_mvec_set_mbufs(&vecs[i], &pkts[i * burst_size],
+				    burst_size);
+	}
+
+	if (ffpp_cls_reader_register(cls, lcore_id) < 0) {
+		rte_exit(EXIT_FAILURE, "Can not register the reader.\n");
+	}
+	updater_lcore = rte_get_next_lcore(lcore_id, 1, 0);
+	if (with_updater) {
+		if (updater_lcore >= RTE_MAX_LCORE) {
+			rte_exit(EXIT_FAILURE,
+				 "A worker lcore is required for -u.\n");
+		}
+		rte_eal_remote_launch(updater_loop, NULL, updater_lcore);
+	}
+
+	start = rte_rdtsc();
+	for (it = 0; it < nb_iterations && !force_quit; ++it) {
+		for (i = 0; i < nb_vecs; ++i) {
+			nb_match += ffpp_cls_lookup(cls, &vecs[i], actions);
+			ffpp_cls_quiescent(cls, lcore_id);
+		}
+		nb_lookups += NB_PKTS;
+	}
+	cycles = rte_rdtsc() - start;
+
+	// The updater may wait for this reader in a LPM6 update.
+	ffpp_cls_reader_unregister(cls, lcore_id);
+	stop_updater = true;
+	if (with_updater) {
+		rte_eal_wait_lcore(updater_lcore);
+	}
+	if (nb_match != nb_lookups) {
+		RTE_LOG(WARNING, FFPP, "%lu of %lu packets matched a rule.\n",
+			nb_match, nb_lookups);
+	}
+
+	printf("type,rules,burst,updater,pkts,cycles_per_pkt,mpps,"
+	       "updates_per_s\n");
+	printf("%s,%u,%u,%d,%lu,%.2f,%.3f,%.0f\n", type_names[rule_type],
+	       nb_rules, burst_size, with_updater, nb_lookups,
+	       (double)cycles / nb_lookups,
+	       (double)nb_lookups * rte_get_tsc_hz() / cycles / 1e6,
+	       update_cycles ? (double)nb_updates * rte_get_tsc_hz() /
+				       update_cycles :
+				     0.0);
+
+	for (i = 0; i < nb_vecs; ++i) {
+		ffpp_mvec_free(&vecs[i]);
+	}
+	rte_pktmbuf_free_bulk(pkts, NB_PKTS);
+	rte_mempool_free(pool);
+	ffpp_cls_free(cls);
+	rte_eal_cleanup();
+	return 0;
+}
@@ -0,0 +1,25 @@
+#!/bin/bash
+#
+# About: Run the classifier lookup benchmark with 1K, 100K and 1M rules of every type, without and with a concurrent
+# updater, and collect the results in one CSV file.
+#
+# Build the benchmark first: meson build && ninja -C build
+#
+
+set -e
+
+LCORES=${LCORES:-"0-1"}
+BURST=${BURST:-32}
+ITERATIONS=${ITERATIONS:-2000}
+RESULT=${RESULT:-/tmp/cls_lookup.csv}
+
+echo "type,rules,burst,updater,pkts,cycles_per_pkt,mpps,updates_per_s" >"$RESULT"
+for type in exact lpm lpm6; do
+    for rules in 1000 100000 1000000; do
+        for updater in "" "-u"; do
+            ./build/cls_lookup -l "$LCORES" --no-pci --in-memory --log-level=3 -- \
+                -t "$type" -r "$rules" -b "$BURST" -i "$ITERATIONS" $updater | tail -n 1 >>"$RESULT"
+        done
+    done
+done
+cat "$RESULT"
@@ -0,0 +1,375 @@
+/*
+ * cryptodev_bench.c
+ *
+ * About: Packet rate of CBC encryption on the worker lcores, inline with the
+ *        crypto sessions (see ffpp/crypto.h) or offloaded to a cryptodev (see
+ *        ffpp/cryptodev.h).
+ *
+ *        Each worker encrypts the UDP payload of its own packets in place. In
+ *        the cryptodev mode, each worker uses its own queue pair and has
+ *        DEPTH bursts of packets: each iteration enqueues at most one burst
+ *        and dequeues at most one burst, which is enqueued again.
+ *
+ * Usage: cryptodev_bench [EAL options] -- -m MODE [-d VDEV] [-s SIZE]
+ *        [-b BURST] [-q DEPTH] [-i ITERATIONS]
+ *        MODE: inline or cryptodev
+ *        VDEV: Cryptodev, created if it is not probed by the EAL,
+ *              default: crypto_aesni_mb
+ *        SIZE: Frame size in bytes, default: 1500
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rte_bus_vdev.h>
+#include <rte_cryptodev.h>
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_udp.h>
+
+#include <ffpp/collections.h>
+#include <ffpp/crypto.h>
+#include <ffpp/cryptodev.h>
+#include <ffpp/memory.h>
+
+#define MAX_BURST 256
+#define MAX_DEPTH 16
+#define PAYLOAD_OFFSET                                                         \
+	(RTE_ETHER_HDR_LEN + sizeof(struct rte_ipv4_hdr) +                     \
+	 sizeof(struct rte_udp_hdr))
+
+struct worker {
+	uint16_t part; /**< Partition or queue pair */
+	struct rte_mempool *pool;
+	uint64_t pkts;
+	uint64_t cycles;
+} __rte_cache_aligned;
+
+static bool offload = false;
+static const char *vdev = "crypto_aesni_mb";
+static uint16_t size = 1500;
+static uint16_t burst = 64;
+static uint16_t depth = 4;
+static uint32_t nb_iterations = 100000;
+
+static struct ffpp_crypto *crypto;
+static struct ffpp_cryptodev *cdev;
+static int session_id;
+static struct worker workers[RTE_MAX_LCORE];
+
+static const struct ffpp_crypto_session_params params = {
+	.algo = FFPP_CRYPTO_AES_CBC,
+	.key = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7,
+		 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c },
+	.salt = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09,
+		  0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f },
+};
+
+static void usage(void)
+{
+	printf("Usage: cryptodev_bench [EAL options] -- -m inline|cryptodev "
+	       "[-d VDEV] [-s SIZE] [-b BURST] [-q DEPTH] [-i ITERATIONS]\n");
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int opt = 0;
+
+	while ((opt = getopt(argc, argv, "m:d:s:b:q:i:h")) != -1) {
+		switch (opt) {
+		case 'm':
+			if (strcmp(optarg, "inline") == 0) {
+				offload = false;
+			} else if (strcmp(optarg, "cryptodev") == 0) {
+				offload = true;
+			} else {
+				usage();
+				rte_exit(EXIT_FAILURE, "Unknown mode!\n");
+			}
+			break;
+		case 'd':
+			vdev = optarg;
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 'b':
+			burst = atoi(optarg);
+			break;
+		case 'q':
+			depth = atoi(optarg);
+			break;
+		case 'i':
+			nb_iterations = atoi(optarg);
+			break;
+		default:
+			usage();
+			rte_exit(EXIT_FAILURE, "Can not parse arguments!\n");
+		}
+	}
+	if (size <= PAYLOAD_OFFSET || size > RTE_ETHER_MAX_LEN ||
+	    burst == 0 || burst > MAX_BURST || depth == 0 ||
+	    depth > MAX_DEPTH || nb_iterations == 0) {
+		usage();
+		rte_exit(EXIT_FAILURE, "Invalid arguments!\n");
+	}
+}
+
+static void build_udp(struct rte_mbuf *m)
+{
+	struct rte_ether_hdr *eth;
+	struct rte_ipv4_hdr *ip;
+	uint8_t *data;
+	uint16_t i;
+
+	data = (uint8_t *)rte_pktmbuf_append(m, size);
+	if (data == NULL) {
+		rte_exit(EXIT_FAILURE, "The mbufs are too small.\n");
+	}
+	for (i = 0; i < size; ++i) {
+		data[i] = (uint8_t)i;
+	}
+	eth = (struct rte_ether_hdr *)data;
+	eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+	ip = (struct rte_ipv4_hdr *)(eth + 1);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = rte_cpu_to_be_16(size - RTE_ETHER_HDR_LEN);
+	ip->next_proto_id = IPPROTO_UDP;
+}
+
+static void alloc_pkts(struct worker *w, struct ffpp_mvec *vec, uint16_t n)
+{
+	uint16_t i;
+
+	if (ffpp_mvec_init(vec, n) != 0 ||
+	    rte_pktmbuf_alloc_bulk(w->pool, vec->head, n) != 0) {
+		rte_exit(EXIT_FAILURE, "Can not allocate the mbufs.\n");
+	}
+	vec->len = n;
+	for (i = 0; i < n; ++i) {
+		build_udp(vec->head[i]);
+	}
+}
+
+static void run_inline(struct worker *w)
+{
+	struct ffpp_crypto_session *s;
+	uint64_t seqs[MAX_BURST];
+	struct ffpp_mvec vec;
+	uint64_t start;
+	uint32_t i;
+
+	alloc_pkts(w, &vec, burst);
+	s = ffpp_crypto_session_get(crypto, w->part, session_id);
+	start = rte_rdtsc_precise();
+	for (i = 0; i < nb_iterations; ++i) {
+		w->pkts += ffpp_crypto_encrypt_mvec(s, &vec, PAYLOAD_OFFSET,
+						    seqs);
+	}
+	w->cycles = rte_rdtsc_precise() - start;
+	ffpp_mvec_free_mbufs(&vec);
+	ffpp_mvec_free(&vec);
+}
+
+/* Move all packets of src to the end of dst. */
+static void move_pkts(struct ffpp_mvec *dst, struct ffpp_mvec *src)
+{
+	memcpy(dst->head + dst->len, src->head, src->len * sizeof(*src->head));
+	dst->len += src->len;
+	src->len = 0;
+}
+
+static void run_offload(struct worker *w)
+{
+	uint64_t target = (uint64_t)nb_iterations * burst;
+	struct rte_mbuf *pkts[MAX_BURST];
+	struct ffpp_cryptodev_stats stats;
+	struct ffpp_mvec idle, io;
+	uint64_t start;
+	uint16_t n;
+
+	// The idle vector holds the packets that are not inflight, the io
+	// vector at most one burst.
+	alloc_pkts(w, &idle, depth * burst);
+	io.len = 0;
+	io.capacity = burst;
+	io.socket_id = rte_socket_id();
+	io.head = pkts;
+	if (ffpp_cryptodev_reader_register(cdev, w->part) != 0) {
+		rte_exit(EXIT_FAILURE, "Can not register the queue pair.\n");
+	}
+	start = rte_rdtsc_precise();
+	while (w->pkts < target) {
+		n = RTE_MIN(idle.len, burst);
+		idle.len -= n;
+		memcpy(pkts, idle.head + idle.len, n * sizeof(*pkts));
+		io.len = n;
+		// The packets that are not enqueued stay in io, so the dequeue
+		// appends at most a burst minus them.
+		ffpp_cryptodev_enqueue(cdev, w->part, session_id, &io, NULL);
+		w->pkts += ffpp_cryptodev_dequeue(cdev, w->part, &io, NULL);
+		move_pkts(&idle, &io);
+		ffpp_cryptodev_quiescent(cdev, w->part);
+	}
+	w->cycles = rte_rdtsc_precise() - start;
+	ffpp_cryptodev_reader_unregister(cdev, w->part);
+
+	ffpp_cryptodev_get_stats(cdev, w->part, &stats);
+	while (stats.inflight > 0) {
+		ffpp_cryptodev_dequeue(cdev, w->part, &io, NULL);
+		move_pkts(&idle, &io);
+		ffpp_cryptodev_get_stats(cdev, w->part, &stats);
+	}
+	ffpp_mvec_free_mbufs(&idle);
+	ffpp_mvec_free(&idle);
+}
+
+static int worker_loop(void *arg)
+{
+	struct worker *w = arg;
+
+	if (offload) {
+		run_offload(w);
+	} else {
+		run_inline(w);
+	}
+	return 0;
+}
+
+static void setup_inline(uint16_t nb_workers)
+{
+	struct ffpp_crypto_config cfg;
+
+	memset(&cfg, 0, sizeof(cfg));
+	snprintf(cfg.name, sizeof(cfg.name), "cryptodev_bench");
+	cfg.socket_id = rte_socket_id();
+	cfg.nb_parts = nb_workers;
+	cfg.max_sessions = 1;
+	cfg.max_flows = 64;
+	cfg.offset = PAYLOAD_OFFSET;
+	crypto = ffpp_crypto_create(&cfg);
+	if (crypto == NULL) {
+		rte_exit(EXIT_FAILURE, "Can not create the crypto context.\n");
+	}
+	session_id = ffpp_crypto_session_create(crypto, &params);
+}
+
+static void setup_offload(uint16_t nb_workers)
+{
+	struct ffpp_cryptodev_config cfg;
+	char args[64];
+	int dev_id;
+
+	dev_id = rte_cryptodev_get_dev_id(vdev);
+	if (dev_id < 0) {
+		snprintf(args, sizeof(args), "max_nb_queue_pairs=%u",
+			 nb_workers);
+		if (rte_vdev_init(vdev, args) != 0) {
+			rte_exit(EXIT_FAILURE, "Can not create %s.\n", vdev);
+		}
+		dev_id = rte_cryptodev_get_dev_id(vdev);
+	}
+
+	memset(&cfg, 0, sizeof(cfg));
+	snprintf(cfg.name, sizeof(cfg.name), "cryptodev_bench");
+	cfg.dev_id = dev_id;
+	cfg.socket_id = rte_socket_id();
+	cfg.nb_qps = nb_workers;
+	cfg.max_sessions = 1;
+	cfg.offset = PAYLOAD_OFFSET;
+	cdev = ffpp_cryptodev_create(&cfg);
+	if (cdev == NULL) {
+		rte_exit(EXIT_FAILURE, "Can not create the cryptodev: %s\n",
+			 rte_strerror(rte_errno));
+	}
+	session_id = ffpp_cryptodev_session_create(cdev, &params,
+						   FFPP_CRYPTO_ENCRYPT);
+}
+
+int main(int argc, char *argv[])
+{
+	char name[RTE_MEMPOOL_NAMESIZE];
+	uint64_t pkts = 0, cycles = 0;
+	uint16_t nb_workers, part;
+	unsigned int lcore_id;
+	struct worker *w;
+	int ret;
+
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	argc -= ret;
+	argv += ret;
+	parse_args(argc, argv);
+
+	nb_workers = rte_lcore_count() - 1;
+	if (nb_workers < 1) {
+		rte_exit(EXIT_FAILURE,
+			 "At least one worker lcore is required.\n");
+	}
+	if (offload) {
+		setup_offload(nb_workers);
+	} else {
+		setup_inline(nb_workers);
+	}
+	if (session_id < 0) {
+		rte_exit(EXIT_FAILURE, "Can not create the session.\n");
+	}
+
+	part = 0;
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		w = &workers[lcore_id];
+		w->part = part++;
+		snprintf(name, sizeof(name), "cryptodev_bench_%u", lcore_id);
+		w->pool = ffpp_init_mempool(name, 2 * MAX_DEPTH * MAX_BURST - 1,
+					    RTE_MBUF_DEFAULT_BUF_SIZE,
+					    rte_lcore_to_socket_id(lcore_id));
+		if (w->pool == NULL) {
+			rte_exit(EXIT_FAILURE,
+				 "Can not init the memory pool.\n");
+		}
+		if (offload) {
+			ffpp_cryptodev_set_qp_lcore(cdev, w->part, lcore_id);
+		}
+	}
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		rte_eal_remote_launch(worker_loop, &workers[lcore_id],
+				      lcore_id);
+	}
+	rte_eal_mp_wait_lcore();
+
+	// The rate of all workers over the time of the slowest one.
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		pkts += workers[lcore_id].pkts;
+		cycles = RTE_MAX(cycles, workers[lcore_id].cycles);
+	}
+	printf("mode,device,workers,size,burst,depth,iterations,"
+	       "cycles_per_pkt,mpps\n");
+	printf("%s,%s,%u,%u,%u,%u,%u,%.1f,%.3f\n",
+	       offload ? "cryptodev" : "inline", offload ? vdev : "-",
+	       nb_workers, size, burst, offload ? depth : 0, nb_iterations,
+	       (double)cycles * nb_workers / pkts,
+	       (double)pkts * rte_get_tsc_hz() / cycles / 1e6);
+
+	ffpp_cryptodev_free(cdev);
+	ffpp_crypto_free(crypto);
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		rte_mempool_free(workers[lcore_id].pool);
+	}
+	rte_eal_cleanup();
+	return 0;
+}
@@ -0,0 +1,31 @@
+#!/bin/bash
+#
+# About: Run the cryptodev benchmark inline and with the software cryptodevs for 64, 512 and 1500 bytes frames and collect
+# the results in one CSV file. Cryptodevs that the DPDK build does not include have no rows.
+#
+# Build the benchmark first: meson build && ninja -C build
+#
+
+LCORES=${LCORES:-"0-2"}
+ITERATIONS=${ITERATIONS:-100000}
+BURST=${BURST:-64}
+DEPTH=${DEPTH:-4}
+VDEVS=${VDEVS:-"crypto_aesni_mb crypto_openssl"}
+RESULT=${RESULT:-/tmp/cryptodev_bench.csv}
+
+# Only the CSV row of a successful run is appended, a failed run returns its status.
+run() {
+    local out
+    out=$(./build/cryptodev_bench -l "$LCORES" --no-pci --in-memory --log-level=3 -- \
+        -s "$size" -b "$BURST" -q "$DEPTH" -i "$ITERATIONS" "$@") || return
+    tail -n 1 <<<"$out" >>"$RESULT"
+}
+
+echo "mode,device,workers,size,burst,depth,iterations,cycles_per_pkt,mpps" >"$RESULT"
+for size in 64 512 1500; do
+    run -m inline
+    for vdev in $VDEVS; do
+        run -m cryptodev -d "$vdev" || echo "Skip $vdev"
+    done
+done
+cat "$RESULT"
@@ -3,14 +3,14 @@
  */
 
 #include <chrono>
-#include <fstream>
-#include <iomanip>
+#include <cstdio>
 #include <iostream>
 #include <thread>
 #include <vector>
 
 #include <argparse.hpp>
 #include <ffpp/bpf_helpers_user.h>
+#include <ffpp/histogram.h>
 
 using namespace std;
 
@@ -89,32 +89,33 @@ int main(int argc, char *argv[])
 		     << endl;
 	}
 
-	vector<double> monitor_latencies;
+	// Latencies in nanoseconds, printed in microseconds.
+	static struct ffpp_hist monitor_latencies;
+	ffpp_hist_init(&monitor_latencies);
 	for (auto r = 0; r < test_rounds; r++) {
 		auto t1 = chrono::high_resolution_clock::now();
 		stats_poll(xdp_stats_map_fds);
 		auto t2 = chrono::high_resolution_clock::now();
 
 		auto duration =
-			chrono::duration_cast<std::chrono::microseconds>(t2 -
-									 t1)
+			chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1)
 				.count();
-		monitor_latencies.push_back(duration);
+		ffpp_hist_record(&monitor_latencies, duration);
 	}
 
-	fstream csv_file;
 	string csv_file_name =
 		"./monitor_latencies_" + to_string(veth_num) + ".csv";
-	csv_file.open(csv_file_name, fstream::out | fstream::app);
-	cout << fixed << setprecision(17) << endl;
-	csv_file << fixed << setprecision(17) << endl;
-
-	for (auto t : monitor_latencies) {
-		csv_file << t << ",";
+	FILE *csv_file = fopen(csv_file_name.c_str(), "a");
+	if (csv_file == NULL) {
+		cerr << "Can not open " << csv_file_name << endl;
+		return -1;
 	}
-
-	csv_file << endl;
-	csv_file.close();
+	// Format: veth_num,count,mean,min,p50,p99,p999,max
+	ffpp_hist_print(csv_file, to_string(veth_num).c_str(),
+			&monitor_latencies, 1000000000ULL);
+	ffpp_hist_print(stdout, to_string(veth_num).c_str(),
+			&monitor_latencies, 1000000000ULL);
+	fclose(csv_file);
 
 	return 0;
 }
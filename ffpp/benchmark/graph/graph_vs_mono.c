@@ -0,0 +1,446 @@
+/*
+ * graph_vs_mono.c
+ *
+ * About: Throughput of the processing loop of mp_munf_mono (RX burst, process
+ *        the burst, TX burst) and of the same VNF declared as ffpp graph (see
+ *        graph.h).
+ *
+ *        The functions are the ones of mp_munf_mono:
+ *        0: Update the source MAC address.
+ *        1: XOR the first 1500 bytes twice and update the source MAC address.
+ *        2: AES-CBC encryption and decryption of the first 1500 bytes and
+ *           update the source MAC address.
+ *
+ *        A ring-backed port with one queue per worker lcore is used, so no NIC
+ *        or traffic generator is needed. The main lcore keeps a fixed number
+ *        of packets in flight: the packets collected from the TX rings are
+ *        injected into the RX rings again. In mono mode, every worker lcore
+ *        runs the loop on its own queue. In graph mode, one graph is created
+ *        per worker lcore.
+ *
+ * Usage: graph_vs_mono [EAL options] -- -m mono|graph [-f FUNC] [-d SECONDS]
+ *        [-n INFLIGHT] [-z FRAME_SIZE]
+ */
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_eth_ring.h>
+#include <rte_ethdev.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_ring.h>
+#include <rte_udp.h>
+
+#include <ffpp/aes.h>
+#include <ffpp/collections.h>
+#include <ffpp/config.h>
+#include <ffpp/device.h>
+#include <ffpp/graph.h>
+#include <ffpp/memory.h>
+#include <ffpp/packet_processors.h>
+
+// The same as mp_munf_mono.
+#define BURST_SIZE 64
+#define PROC_LEN 1500
+#define RING_SIZE 4096
+#define NB_MBUFS 16383
+
+static volatile bool force_quit = false;
+static volatile bool stop_workers = false;
+
+static bool graph_mode = false;
+static int func_num = 0;
+static uint32_t duration_s = 10;
+static uint32_t nb_inflight = 2048;
+static uint16_t frame_size = PROC_LEN;
+
+static uint16_t nb_queues;
+static uint16_t port_id;
+static struct rte_ring *rx_rings[FFPP_MAX_QUEUES_PER_PORT];
+static struct rte_ring *tx_rings[FFPP_MAX_QUEUES_PER_PORT];
+static struct rte_ether_addr tx_port_addr;
+
+static uint8_t aes_key[] = { 0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe,
+			     0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+			     0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7,
+			     0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4 };
+static uint8_t aes_iv[] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+			    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+
+static void signal_handler(int signum)
+{
+	if (signum == SIGINT || signum == SIGTERM) {
+		force_quit = true;
+	}
+}
+
+static uint16_t l2_xor(struct ffpp_mvec *vec, void *arg)
+{
+	const uint8_t xor_val = 17;
+	struct rte_mbuf *m;
+	uint8_t *data;
+	uint16_t i, j;
+
+	RTE_SET_USED(arg);
+	FFPP_MVEC_FOREACH(vec, i, m)
+	{
+		rte_prefetch0(rte_pktmbuf_mtod(m, void *));
+		data = rte_pktmbuf_mtod(m, uint8_t *);
+		for (j = 0; j < PROC_LEN; ++j) {
+			*(data + j) ^= xor_val;
+		}
+	}
+	return vec->len;
+}
+
+static void l2_aes(struct ffpp_mvec *vec)
+{
+	struct AES_ctx aes_ctx;
+	struct rte_mbuf *m;
+	uint8_t *data;
+	uint16_t i;
+
+	FFPP_MVEC_FOREACH(vec, i, m)
+	{
+		rte_prefetch0(rte_pktmbuf_mtod(m, void *));
+		data = rte_pktmbuf_mtod(m, uint8_t *);
+		AES_init_ctx_iv(&aes_ctx, aes_key, aes_iv);
+		AES_CBC_encrypt_buffer(&aes_ctx, data, PROC_LEN);
+		AES_init_ctx_iv(&aes_ctx, aes_key, aes_iv);
+		AES_CBC_decrypt_buffer(&aes_ctx, data, PROC_LEN);
+	}
+}
+
+/* run_mainloop() of mp_munf_mono on the queue given by arg. */
+static int mono_loop(void *arg)
+{
+	uint16_t queue_id = (uint16_t)(uintptr_t)arg;
+	struct rte_mbuf *pkt_burst[BURST_SIZE];
+	struct ffpp_mvec vec;
+	uint16_t nb_rx, nb_tx;
+
+	if (ffpp_mvec_init(&vec, BURST_SIZE) < 0) {
+		return -1;
+	}
+	while (!stop_workers) {
+		nb_rx = rte_eth_rx_burst(port_id, queue_id, pkt_burst,
+					 BURST_SIZE);
+		if (nb_rx == 0) {
+			continue;
+		}
+		ffpp_mvec_set_mbufs(&vec, pkt_burst, nb_rx);
+
+		switch (func_num) {
+		case 0:
+			ffpp_pp_update_dl_src(&vec, &tx_port_addr);
+			break;
+		case 1:
+			l2_xor(&vec, NULL);
+			l2_xor(&vec, NULL);
+			ffpp_pp_update_dl_src(&vec, &tx_port_addr);
+			break;
+		default:
+			l2_aes(&vec);
+			ffpp_pp_update_dl_src(&vec, &tx_port_addr);
+		}
+
+		nb_tx = rte_eth_tx_burst(port_id, queue_id, pkt_burst, nb_rx);
+		if (nb_tx < nb_rx) {
+			rte_pktmbuf_free_bulk(&pkt_burst[nb_tx], nb_rx - nb_tx);
+		}
+	}
+	ffpp_mvec_free(&vec);
+	return 0;
+}
+
+static struct ffpp_graph_vnf *create_vnf(void)
+{
+	struct ffpp_graph_config cfg;
+	struct ffpp_graph_node_conf *n;
+
+	memset(&cfg, 0, sizeof(cfg));
+	snprintf(cfg.name, sizeof(cfg.name), "mono_f%d", func_num);
+	cfg.nb_ports = 1;
+	cfg.port_ids[0] = port_id;
+	cfg.tx_port_map[0] = 0;
+	cfg.nb_rx_queues = nb_queues;
+	cfg.nb_tx_queues = nb_queues;
+	cfg.burst_size = BURST_SIZE;
+
+	n = cfg.nodes;
+	switch (func_num) {
+	case 0:
+		break;
+	case 1:
+		n->type = FFPP_GRAPH_NODE_HANDLER;
+		n->handler.func = l2_xor;
+		n++;
+		n->type = FFPP_GRAPH_NODE_HANDLER;
+		n->handler.func = l2_xor;
+		n++;
+		break;
+	default:
+		n->type = FFPP_GRAPH_NODE_AES;
+		memcpy(n->aes.key, aes_key, AES_KEYLEN);
+		memcpy(n->aes.iv, aes_iv, AES_BLOCKLEN);
+		n->aes.offset = 0;
+		n->aes.len = PROC_LEN;
+		n++;
+	}
+	n->type = FFPP_GRAPH_NODE_UPDATE_DL_SRC;
+	rte_ether_addr_copy(&tx_port_addr, &n->dl_src);
+	n++;
+	cfg.nb_nodes = n - cfg.nodes;
+
+	return ffpp_graph_vnf_create(&cfg);
+}
+
+static void build_pkt(struct rte_mbuf *m)
+{
+	struct rte_ether_hdr *eth;
+	struct rte_ipv4_hdr *ip;
+	struct rte_udp_hdr *udp;
+
+	eth = (struct rte_ether_hdr *)rte_pktmbuf_append(m, frame_size);
+	memset(eth, 0, frame_size);
+	eth->ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV4);
+	ip = (struct rte_ipv4_hdr *)(eth + 1);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = rte_cpu_to_be_16(frame_size - RTE_ETHER_HDR_LEN);
+	ip->time_to_live = 64;
+	ip->next_proto_id = IPPROTO_UDP;
+	ip->src_addr = RTE_BE32(RTE_IPV4(192, 168, 0, 1));
+	ip->dst_addr = RTE_BE32(RTE_IPV4(192, 168, 0, 2));
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+	udp = (struct rte_udp_hdr *)(ip + 1);
+	udp->src_port = RTE_BE16(5000);
+	udp->dst_port = RTE_BE16(5001);
+	udp->dgram_len = rte_cpu_to_be_16(frame_size - RTE_ETHER_HDR_LEN -
+					  sizeof(struct rte_ipv4_hdr));
+	m->port = port_id;
+}
+
+/**
+ * Inject nb_inflight packets and recycle them for duration_s. Return the
+ * number of packets that went through the VNF.
+ */
+static uint64_t run_traffic(struct rte_mempool *pool, uint64_t *cycles)
+{
+	struct rte_mbuf *pkts[BURST_SIZE];
+	uint64_t forwarded = 0;
+	uint64_t start, end;
+	unsigned int n, sent;
+	uint32_t i;
+	uint16_t q;
+
+	for (i = 0; i < nb_inflight; ++i) {
+		struct rte_mbuf *m = rte_pktmbuf_alloc(pool);
+		if (m == NULL) {
+			rte_exit(EXIT_FAILURE, "Can not allocate the packets.\n");
+		}
+		build_pkt(m);
+		if (rte_ring_sp_enqueue(rx_rings[i % nb_queues], m) < 0) {
+			rte_pktmbuf_free(m);
+		}
+	}
+
+	start = rte_rdtsc();
+	end = start + duration_s * rte_get_tsc_hz();
+	while (rte_rdtsc() < end && !force_quit) {
+		for (q = 0; q < nb_queues; ++q) {
+			n = rte_ring_sc_dequeue_burst(tx_rings[q], (void **)pkts,
+						      BURST_SIZE, NULL);
+			if (n == 0) {
+				continue;
+			}
+			forwarded += n;
+			sent = rte_ring_sp_enqueue_burst(rx_rings[q],
+							 (void **)pkts, n, NULL);
+			if (sent < n) {
+				rte_pktmbuf_free_bulk(&pkts[sent], n - sent);
+			}
+		}
+	}
+	*cycles = rte_rdtsc() - start;
+	return forwarded;
+}
+
+static void drain_rings(void)
+{
+	struct rte_mbuf *pkts[BURST_SIZE];
+	unsigned int n;
+	uint16_t q;
+
+	for (q = 0; q < nb_queues; ++q) {
+		while ((n = rte_ring_sc_dequeue_burst(rx_rings[q], (void **)pkts,
+						      BURST_SIZE, NULL)) > 0) {
+			rte_pktmbuf_free_bulk(pkts, n);
+		}
+		while ((n = rte_ring_sc_dequeue_burst(tx_rings[q], (void **)pkts,
+						      BURST_SIZE, NULL)) > 0) {
+			rte_pktmbuf_free_bulk(pkts, n);
+		}
+	}
+}
+
+static uint16_t init_ring_port(struct rte_mempool *pool)
+{
+	char name[RTE_RING_NAMESIZE];
+	struct ffpp_dpdk_device_config cfg;
+	int ret;
+	uint16_t q;
+
+	for (q = 0; q < nb_queues; ++q) {
+		snprintf(name, sizeof(name), "gvm_rx_%u", q);
+		rx_rings[q] = rte_ring_create(name, RING_SIZE, rte_socket_id(),
+					      RING_F_SP_ENQ | RING_F_SC_DEQ);
+		snprintf(name, sizeof(name), "gvm_tx_%u", q);
+		tx_rings[q] = rte_ring_create(name, RING_SIZE, rte_socket_id(),
+					      RING_F_SP_ENQ | RING_F_SC_DEQ);
+		if (rx_rings[q] == NULL || tx_rings[q] == NULL) {
+			rte_exit(EXIT_FAILURE, "Can not create the rings.\n");
+		}
+	}
+	ret = rte_eth_from_rings("gvm_ring_port", rx_rings, nb_queues,
+				 tx_rings, nb_queues, rte_socket_id());
+	if (ret < 0) {
+		rte_exit(EXIT_FAILURE, "Can not create the ring port.\n");
+	}
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.port_id = ret;
+	cfg.pool = &pool;
+	cfg.rx_queues = nb_queues;
+	cfg.tx_queues = nb_queues;
+	cfg.rx_descs = RING_SIZE;
+	cfg.tx_descs = RING_SIZE;
+	cfg.disable_offloads = 1;
+	ffpp_dpdk_init_device(&cfg);
+	return ret;
+}
+
+static void usage(void)
+{
+	printf("Usage: graph_vs_mono [EAL options] -- -m mono|graph [-f FUNC] "
+	       "[-d SECONDS] [-n INFLIGHT] [-z FRAME_SIZE]\n");
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int opt = 0;
+
+	while ((opt = getopt(argc, argv, "m:f:d:n:z:h")) != -1) {
+		switch (opt) {
+		case 'm':
+			graph_mode = strcmp(optarg, "graph") == 0;
+			break;
+		case 'f':
+			func_num = atoi(optarg);
+			break;
+		case 'd':
+			duration_s = atoi(optarg);
+			break;
+		case 'n':
+			nb_inflight = atoi(optarg);
+			break;
+		case 'z':
+			frame_size = atoi(optarg);
+			break;
+		default:
+			usage();
+			rte_exit(EXIT_FAILURE, "Can not parse arguments!\n");
+		}
+	}
+	if (func_num < 0 || func_num > 2 || duration_s == 0 ||
+	    nb_inflight == 0 || nb_inflight >= NB_MBUFS ||
+	    frame_size < PROC_LEN || frame_size > RTE_MBUF_DEFAULT_DATAROOM) {
+		usage();
+		rte_exit(EXIT_FAILURE, "Invalid arguments!\n");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct ffpp_graph_vnf *vnf = NULL;
+	struct ffpp_graph_stats stats;
+	struct rte_mempool *pool;
+	unsigned int lcore_id;
+	uint64_t forwarded, cycles;
+	int ret;
+
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	argc -= ret;
+	argv += ret;
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+	parse_args(argc, argv);
+
+	nb_queues = rte_lcore_count() - 1;
+	if (nb_queues < 1 || nb_queues > FFPP_MAX_QUEUES_PER_PORT) {
+		rte_exit(EXIT_FAILURE, "1 to %d worker lcores are required.\n",
+			 FFPP_MAX_QUEUES_PER_PORT);
+	}
+	pool = ffpp_init_mempool("graph_vs_mono", NB_MBUFS,
+				 RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	if (pool == NULL) {
+		rte_exit(EXIT_FAILURE, "Can not init the memory pool.\n");
+	}
+	port_id = init_ring_port(pool);
+	ret = rte_eth_macaddr_get(port_id, &tx_port_addr);
+	if (ret < 0) {
+		rte_exit(EXIT_FAILURE, "Cannot get the MAC address.\n");
+	}
+
+	if (graph_mode) {
+		vnf = create_vnf();
+		if (vnf == NULL || ffpp_graph_vnf_launch(vnf) < 0) {
+			rte_exit(EXIT_FAILURE, "Can not run the graphs.\n");
+		}
+	} else {
+		uint16_t q = 0;
+		RTE_LCORE_FOREACH_WORKER(lcore_id)
+		{
+			rte_eal_remote_launch(mono_loop, (void *)(uintptr_t)q,
+					      lcore_id);
+			q++;
+		}
+	}
+
+	forwarded = run_traffic(pool, &cycles);
+
+	if (graph_mode) {
+		ffpp_graph_vnf_stop(vnf);
+		ffpp_graph_vnf_print_stats(vnf);
+		if (ffpp_graph_vnf_get_stats(vnf, &stats) == 0) {
+			printf("Graph stats: rx %lu, tx %lu, dropped %lu\n",
+			       stats.rx_pkts, stats.tx_pkts, stats.dropped);
+		}
+		ffpp_graph_vnf_destroy(vnf);
+	} else {
+		stop_workers = true;
+		rte_eal_mp_wait_lcore();
+	}
+	drain_rings();
+
+	printf("mode,func,lcores,frame_size,pkts,mpps,cycles_per_pkt\n");
+	printf("%s,%d,%u,%u,%lu,%.3f,%.1f\n", graph_mode ? "graph" : "mono",
+	       func_num, nb_queues, frame_size, forwarded,
+	       (double)forwarded * rte_get_tsc_hz() / cycles / 1e6,
+	       forwarded == 0 ? 0.0 :
+				(double)cycles * nb_queues / forwarded);
+
+	ffpp_dpdk_cleanup_devices();
+	rte_eal_cleanup();
+	return 0;
+}
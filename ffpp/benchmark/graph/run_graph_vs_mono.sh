@@ -0,0 +1,22 @@
+#!/bin/bash
+#
+# About: Compare the mp_munf_mono loop with the same VNF as ffpp graph for all functions and collect the throughput in
+# one CSV file.
+#
+# Build the benchmark first: meson build && ninja -C build
+#
+
+set -e
+
+LCORES=${LCORES:-"0-2"}
+DURATION=${DURATION:-10}
+RESULT=${RESULT:-/tmp/graph_vs_mono.csv}
+
+echo "mode,func,lcores,frame_size,pkts,mpps,cycles_per_pkt" >"$RESULT"
+for func in 0 1 2; do
+    for mode in mono graph; do
+        ./build/graph_vs_mono -l "$LCORES" --no-pci --in-memory --log-level=3 -- \
+            -m "$mode" -f "$func" -d "$DURATION" | tail -n 1 >>"$RESULT"
+    done
+done
+cat "$RESULT"
@@ -0,0 +1,240 @@
+/*
+ * meter_bench.c
+ *
+ * About: Per packet cost of the ffpp meter (see meter.h) with many flows.
+ *        police: srTCM policing, red packets would be dropped and yellow ones
+ *        re-marked.
+ *        shape: shaping with a trTCM profile.
+ *
+ *        Each packet of a pass belongs to another flow, so every burst
+ *        touches the state of new flows. The profile rate is high enough that
+ *        all packets conform and the bursts do not change between passes. The
+ *        flows are inserted by a warm-up pass that is not measured.
+ *
+ * Usage: meter_bench [EAL options] -- -m police|shape [-f FLOWS] [-b BURST]
+ *        [-i ITERATIONS]
+ */
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_udp.h>
+
+#include <ffpp/collections.h>
+#include <ffpp/config.h>
+#include <ffpp/memory.h>
+#include <ffpp/meter.h>
+
+#define MAX_FLOWS (1U << 16)
+#define NB_MBUFS (2 * MAX_FLOWS - 1)
+#define MBUF_SIZE (RTE_PKTMBUF_HEADROOM + 256)
+#define MAX_BURST 256
+#define FRAME_SIZE 128
+// Spread the flows over the packets.
+#define FLOW_STRIDE 7919
+
+enum meter_mode { MODE_POLICE, MODE_SHAPE };
+static const char *mode_names[] = { "police", "shape" };
+
+static volatile bool force_quit = false;
+
+static enum meter_mode mode = MODE_POLICE;
+static uint32_t nb_flows = MAX_FLOWS;
+static uint16_t burst_size = 32;
+static uint32_t nb_iterations = 1000;
+
+static void signal_handler(int signum)
+{
+	if (signum == SIGINT || signum == SIGTERM) {
+		force_quit = true;
+	}
+}
+
+static void build_pkt(struct rte_mbuf *m, uint32_t flow)
+{
+	struct rte_ether_hdr *eth;
+	struct rte_ipv4_hdr *ip;
+	struct rte_udp_hdr *udp;
+
+	eth = (struct rte_ether_hdr *)rte_pktmbuf_append(m, FRAME_SIZE);
+	memset(eth, 0, FRAME_SIZE);
+	eth->ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV4);
+	ip = (struct rte_ipv4_hdr *)(eth + 1);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = rte_cpu_to_be_16(FRAME_SIZE - RTE_ETHER_HDR_LEN);
+	ip->time_to_live = 64;
+	ip->next_proto_id = IPPROTO_UDP;
+	ip->src_addr = rte_cpu_to_be_32(RTE_IPV4(10, 0, 0, 0) + flow);
+	ip->dst_addr = RTE_BE32(RTE_IPV4(192, 168, 0, 2));
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+	udp = (struct rte_udp_hdr *)(ip + 1);
+	udp->src_port = RTE_BE16(5000);
+	udp->dst_port = RTE_BE16(5001);
+}
+
+static void usage(void)
+{
+	printf("Usage: meter_bench [EAL options] -- -m police|shape "
+	       "[-f FLOWS] [-b BURST] [-i ITERATIONS]\n");
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int opt = 0;
+	int i;
+
+	while ((opt = getopt(argc, argv, "m:f:b:i:h")) != -1) {
+		switch (opt) {
+		case 'm':
+			for (i = 0; i < 2; ++i) {
+				if (strcmp(optarg, mode_names[i]) == 0) {
+					mode = i;
+					break;
+				}
+			}
+			if (i == 2) {
+				usage();
+				rte_exit(EXIT_FAILURE, "Unknown mode!\n");
+			}
+			break;
+		case 'f':
+			nb_flows = atoi(optarg);
+			break;
+		case 'b':
+			burst_size = atoi(optarg);
+			break;
+		case 'i':
+			nb_iterations = atoi(optarg);
+			break;
+		default:
+			usage();
+			rte_exit(EXIT_FAILURE, "Can not parse arguments!\n");
+		}
+	}
+	if (nb_flows == 0 || nb_flows > MAX_FLOWS || burst_size == 0 ||
+	    burst_size > MAX_BURST || MAX_FLOWS % burst_size != 0 ||
+	    nb_iterations == 0) {
+		usage();
+		rte_exit(EXIT_FAILURE, "Invalid arguments!\n");
+	}
+}
+
+static void run_pass(struct ffpp_meter *mtr, struct ffpp_mvec *vecs,
+		     uint32_t nb_vecs)
+{
+	uint32_t i;
+
+	for (i = 0; i < nb_vecs; ++i) {
+		if (mode == MODE_POLICE) {
+			ffpp_meter_police(mtr, 0, &vecs[i], NULL);
+		} else {
+			ffpp_meter_shape(mtr, 0, &vecs[i]);
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static struct ffpp_mvec vecs[MAX_FLOWS];
+	static struct rte_mbuf *pkts[MAX_FLOWS];
+	struct ffpp_meter_config cfg;
+	struct ffpp_meter_stats stats;
+	struct ffpp_meter *mtr;
+	struct rte_mempool *pool;
+	uint64_t start, cycles, nb_pkts = 0;
+	uint32_t i, it, nb_vecs;
+	int ret;
+
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	argc -= ret;
+	argv += ret;
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+	parse_args(argc, argv);
+
+	memset(&cfg, 0, sizeof(cfg));
+	snprintf(cfg.name, sizeof(cfg.name), "meter_%s", mode_names[mode]);
+	cfg.socket_id = rte_socket_id();
+	cfg.nb_parts = 1;
+	cfg.max_flows = 2 * nb_flows;
+	cfg.nb_profiles = 1;
+	// 10 GB/s per flow, all packets conform.
+	if (mode == MODE_POLICE) {
+		cfg.algo = FFPP_METER_SRTCM;
+		cfg.srtcm[0].cir = 10ULL * 1000 * 1000 * 1000;
+		cfg.srtcm[0].cbs = 1 << 20;
+		cfg.srtcm[0].ebs = 1 << 20;
+	} else {
+		cfg.algo = FFPP_METER_TRTCM;
+		cfg.trtcm[0].cir = 10ULL * 1000 * 1000 * 1000;
+		cfg.trtcm[0].pir = cfg.trtcm[0].cir;
+		cfg.trtcm[0].cbs = 1 << 20;
+		cfg.trtcm[0].pbs = 1 << 20;
+	}
+	cfg.actions[RTE_COLOR_YELLOW] = FFPP_METER_MARK;
+	cfg.actions[RTE_COLOR_RED] = FFPP_METER_DROP;
+	mtr = ffpp_meter_create(&cfg);
+	if (mtr == NULL) {
+		rte_exit(EXIT_FAILURE, "Can not create the meter.\n");
+	}
+
+	pool = ffpp_init_mempool("meter_bench", NB_MBUFS, MBUF_SIZE,
+				 rte_socket_id());
+	if (pool == NULL ||
+	    rte_pktmbuf_alloc_bulk(pool, pkts, MAX_FLOWS) < 0) {
+		rte_exit(EXIT_FAILURE, "Can not allocate the packets.\n");
+	}
+	for (i = 0; i < MAX_FLOWS; ++i) {
+		build_pkt(pkts[i], (uint64_t)i * FLOW_STRIDE % nb_flows);
+	}
+	nb_vecs = MAX_FLOWS / burst_size;
+	for (i = 0; i < nb_vecs; ++i) {
+		ffpp_mvec_init(&vecs[i], burst_size);
+		ffpp_mvec_set_mbufs(&vecs[i], &pkts[i * burst_size],
+				    burst_size);
+	}
+
+	run_pass(mtr, vecs, nb_vecs);
+	start = rte_rdtsc();
+	for (it = 0; it < nb_iterations && !force_quit; ++it) {
+		run_pass(mtr, vecs, nb_vecs);
+		nb_pkts += MAX_FLOWS;
+	}
+	cycles = rte_rdtsc() - start;
+
+	ffpp_meter_get_stats(mtr, 0, &stats);
+	if (stats.nb_flows != nb_flows || stats.untracked != 0 ||
+	    stats.dropped != 0 || stats.shaped != 0) {
+		RTE_LOG(WARNING, FFPP,
+			"flows: %u, untracked: %lu, dropped: %lu, "
+			"shaped: %lu\n",
+			stats.nb_flows, stats.untracked, stats.dropped,
+			stats.shaped);
+	}
+
+	printf("mode,flows,burst,pkts,cycles_per_pkt,mpps\n");
+	printf("%s,%u,%u,%lu,%.2f,%.3f\n", mode_names[mode], nb_flows,
+	       burst_size, nb_pkts, (double)cycles / nb_pkts,
+	       (double)nb_pkts * rte_get_tsc_hz() / cycles / 1e6);
+
+	for (i = 0; i < nb_vecs; ++i) {
+		ffpp_mvec_free(&vecs[i]);
+	}
+	rte_pktmbuf_free_bulk(pkts, MAX_FLOWS);
+	rte_mempool_free(pool);
+	ffpp_meter_free(mtr);
+	rte_eal_cleanup();
+	return 0;
+}
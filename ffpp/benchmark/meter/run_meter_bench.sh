@@ -0,0 +1,23 @@
+#!/bin/bash
+#
+# About: Run the meter benchmark for policing and shaping with 1K, 16K and 64K flows and collect the results in one
+# CSV file. The target is above 10 Mpps per core with 64K flows.
+#
+# Build the benchmark first: meson build && ninja -C build
+#
+
+set -e
+
+LCORES=${LCORES:-"0"}
+BURST=${BURST:-32}
+ITERATIONS=${ITERATIONS:-1000}
+RESULT=${RESULT:-/tmp/meter_bench.csv}
+
+echo "mode,flows,burst,pkts,cycles_per_pkt,mpps" >"$RESULT"
+for mode in police shape; do
+    for flows in 1024 16384 65536; do
+        ./build/meter_bench -l "$LCORES" --no-pci --in-memory --log-level=3 -- \
+            -m "$mode" -f "$flows" -b "$BURST" -i "$ITERATIONS" | tail -n 1 >>"$RESULT"
+    done
+done
+cat "$RESULT"
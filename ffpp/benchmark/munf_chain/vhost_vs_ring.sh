@@ -0,0 +1,52 @@
+#!/bin/bash
+#
+# About: Compare the vhost-user/virtio-user chaining with the rte_ring multi-process path between two MuNFs.
+#
+# The head receives synthetic 64B packets from net_null and forwards them to the tail, the tail reports the
+# received rate every second. Run inside the ffpp-dev container (or two containers sharing /tmp for vhost).
+#
+
+set -e
+
+DURATION=10
+QUEUES=1
+CHAIN_DIR=/ffpp/user/examples/munf_chain
+RESULT_DIR=${RESULT_DIR:-/tmp/munf_chain_results}
+
+while getopts "d:q:h" opt; do
+    case $opt in
+    d) DURATION=$OPTARG ;;
+    q) QUEUES=$OPTARG ;;
+    *)
+        echo "Usage: $0 [-d duration_s] [-q queues]"
+        exit 1
+        ;;
+    esac
+done
+
+# lcores of the head and the tail: one main lcore plus one worker per queue.
+export HEAD_LCORES="1-$((QUEUES + 1))"
+export TAIL_LCORES="$((QUEUES + 2))-$((2 * QUEUES + 2))"
+
+mkdir -p "$RESULT_DIR"
+cd "$CHAIN_DIR"
+
+run_pair() {
+    local transport=$1
+    local extra=$2
+    local name=$3
+    rm -f /tmp/munf_chain.sock
+    ./run.sh head "$transport" -q "$QUEUES" >"$RESULT_DIR/head_$name.log" 2>&1 &
+    local head_pid=$!
+    sleep 3
+    ./run.sh tail "$transport" -q "$QUEUES" -d "$DURATION" $extra 2>"$RESULT_DIR/tail_$name.log" |
+        grep -E '^[0-9]+,' >"$RESULT_DIR/$name.csv" || true
+    kill -INT $head_pid
+    wait $head_pid || true
+    awk -F, -v n="$name" '{ s += $2; c++ } END { if (c > 0) printf "%s,%.3f\n", n, s / c }' "$RESULT_DIR/$name.csv"
+}
+
+echo "transport,avg_mpps"
+run_pair ring "" "ring"
+run_pair vhost "" "vhost_mrg_rxbuf"
+run_pair vhost "-n" "vhost_no_mrg_rxbuf"
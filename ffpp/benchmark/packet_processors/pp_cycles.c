@@ -0,0 +1,281 @@
+/*
+ * pp_cycles.c
+ *
+ * About: Cycles per packet of the burst processors in packet_processors.h,
+ *        the default (SIMD if the library is compiled with SSE4.1/AVX2) and
+ *        the scalar implementation.
+ *
+ *        A set of UDP packets is processed in bursts. Before each round the
+ *        headers are restored from a template, which is not measured. Use a
+ *        number of packets larger than the L2 cache to include memory stalls.
+ *
+ * Usage: pp_cycles [EAL options] -- [-n PACKETS] [-r ROUNDS] [-b BURST]
+ *        [-z FRAME_SIZE]
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_udp.h>
+
+#include <ffpp/collections.h>
+#include <ffpp/memory.h>
+#include <ffpp/packet_processors.h>
+
+#define TEMPLATE_LEN 64
+
+static uint32_t nb_pkts = 8192;
+static uint32_t nb_rounds = 200;
+static uint16_t burst_size = 32;
+static uint16_t frame_size = 64;
+
+static struct rte_mbuf **pkts;
+static uint8_t template_untagged[TEMPLATE_LEN];
+static uint8_t template_tagged[TEMPLATE_LEN];
+
+static const struct rte_ether_addr dl_src = { { 0x02, 0, 0, 0, 0, 0x01 } };
+static const struct rte_ether_addr dl_dst = { { 0x02, 0, 0, 0, 0, 0x02 } };
+static const struct ffpp_pp_nat nat = {
+	.src_addr = RTE_BE32(RTE_IPV4(10, 0, 0, 1)),
+	.dst_addr = RTE_BE32(RTE_IPV4(10, 0, 0, 2)),
+	.src_port = RTE_BE16(1234),
+	.dst_port = RTE_BE16(80),
+	.flags = FFPP_PP_NAT_SRC_ADDR | FFPP_PP_NAT_DST_ADDR |
+		 FFPP_PP_NAT_SRC_PORT | FFPP_PP_NAT_DST_PORT,
+};
+
+typedef void (*pp_func_t)(struct ffpp_mvec *vec);
+
+struct pp_bench {
+	const char *name;
+	pp_func_t simd;
+	pp_func_t scalar;
+	bool tagged; /**< Input packets have a VLAN tag */
+};
+
+static void rewrite_dl(struct ffpp_mvec *vec)
+{
+	ffpp_pp_rewrite_dl(vec, &dl_src, &dl_dst);
+}
+
+static void rewrite_dl_scalar(struct ffpp_mvec *vec)
+{
+	ffpp_pp_rewrite_dl_scalar(vec, &dl_src, &dl_dst);
+}
+
+static void vlan_push(struct ffpp_mvec *vec)
+{
+	ffpp_pp_vlan_push(vec, 42);
+}
+
+static void vlan_push_scalar(struct ffpp_mvec *vec)
+{
+	ffpp_pp_vlan_push_scalar(vec, 42);
+}
+
+static void vlan_pop(struct ffpp_mvec *vec)
+{
+	ffpp_pp_vlan_pop(vec);
+}
+
+static void vlan_pop_scalar(struct ffpp_mvec *vec)
+{
+	ffpp_pp_vlan_pop_scalar(vec);
+}
+
+static void dec_ttl(struct ffpp_mvec *vec)
+{
+	ffpp_pp_dec_ttl(vec);
+}
+
+static void dec_ttl_scalar(struct ffpp_mvec *vec)
+{
+	ffpp_pp_dec_ttl_scalar(vec);
+}
+
+static void mark_dscp(struct ffpp_mvec *vec)
+{
+	ffpp_pp_mark_dscp(vec, 46);
+}
+
+static void mark_dscp_scalar(struct ffpp_mvec *vec)
+{
+	ffpp_pp_mark_dscp_scalar(vec, 46);
+}
+
+static void nat_rewrite(struct ffpp_mvec *vec)
+{
+	ffpp_pp_nat_rewrite(vec, &nat);
+}
+
+static const struct pp_bench benches[] = {
+	{ "rewrite_dl", rewrite_dl, rewrite_dl_scalar, false },
+	{ "swap_dl", ffpp_pp_swap_dl, ffpp_pp_swap_dl_scalar, false },
+	{ "vlan_push", vlan_push, vlan_push_scalar, false },
+	{ "vlan_pop", vlan_pop, vlan_pop_scalar, true },
+	{ "dec_ttl", dec_ttl, dec_ttl_scalar, false },
+	{ "mark_dscp", mark_dscp, mark_dscp_scalar, false },
+	{ "nat_rewrite", nat_rewrite, NULL, false },
+};
+
+static void build_template(uint8_t *t, bool tagged)
+{
+	struct rte_ether_hdr *eth = (struct rte_ether_hdr *)t;
+	struct rte_ipv4_hdr *ip;
+	struct rte_udp_hdr *udp;
+	uint16_t l3_off = RTE_ETHER_HDR_LEN;
+
+	memset(t, 0, TEMPLATE_LEN);
+	rte_ether_addr_copy(&dl_dst, &eth->d_addr);
+	rte_ether_addr_copy(&dl_src, &eth->s_addr);
+	if (tagged) {
+		eth->ether_type = RTE_BE16(RTE_ETHER_TYPE_VLAN);
+		((struct rte_vlan_hdr *)(eth + 1))->vlan_tci = RTE_BE16(42);
+		((struct rte_vlan_hdr *)(eth + 1))->eth_proto =
+			RTE_BE16(RTE_ETHER_TYPE_IPV4);
+		l3_off += sizeof(struct rte_vlan_hdr);
+	} else {
+		eth->ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV4);
+	}
+	ip = (struct rte_ipv4_hdr *)(t + l3_off);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = rte_cpu_to_be_16(frame_size - l3_off);
+	ip->time_to_live = 64;
+	ip->next_proto_id = IPPROTO_UDP;
+	ip->src_addr = RTE_BE32(RTE_IPV4(192, 168, 0, 1));
+	ip->dst_addr = RTE_BE32(RTE_IPV4(192, 168, 0, 2));
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+	udp = (struct rte_udp_hdr *)(ip + 1);
+	udp->src_port = RTE_BE16(5000);
+	udp->dst_port = RTE_BE16(5001);
+	udp->dgram_len = rte_cpu_to_be_16(frame_size - l3_off -
+					  sizeof(struct rte_ipv4_hdr));
+	udp->dgram_cksum = RTE_BE16(0x1234);
+}
+
+static void reset_pkts(bool tagged)
+{
+	const uint8_t *t = tagged ? template_tagged : template_untagged;
+	struct rte_mbuf *m;
+	uint32_t i;
+
+	for (i = 0; i < nb_pkts; ++i) {
+		m = pkts[i];
+		m->data_off = RTE_PKTMBUF_HEADROOM;
+		m->data_len = frame_size;
+		m->pkt_len = frame_size;
+		memcpy(rte_pktmbuf_mtod(m, void *), t, TEMPLATE_LEN);
+	}
+}
+
+static double run(pp_func_t func, bool tagged)
+{
+	struct ffpp_mvec vec;
+	uint64_t cycles = 0;
+	uint64_t start;
+	uint32_t r, i;
+
+	for (r = 0; r < nb_rounds; ++r) {
+		reset_pkts(tagged);
+		start = rte_rdtsc_precise();
+		for (i = 0; i + burst_size <= nb_pkts; i += burst_size) {
+			vec.head = pkts + i;
+			vec.len = burst_size;
+			vec.capacity = burst_size;
+			func(&vec);
+		}
+		cycles += rte_rdtsc_precise() - start;
+	}
+	return (double)cycles /
+	       ((double)nb_rounds * (nb_pkts - nb_pkts % burst_size));
+}
+
+static void usage(void)
+{
+	printf("Usage: pp_cycles [EAL options] -- [-n PACKETS] [-r ROUNDS] "
+	       "[-b BURST] [-z FRAME_SIZE]\n");
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int opt = 0;
+
+	while ((opt = getopt(argc, argv, "n:r:b:z:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			nb_pkts = atoi(optarg);
+			break;
+		case 'r':
+			nb_rounds = atoi(optarg);
+			break;
+		case 'b':
+			burst_size = atoi(optarg);
+			break;
+		case 'z':
+			frame_size = atoi(optarg);
+			break;
+		default:
+			usage();
+			rte_exit(EXIT_FAILURE, "Can not parse arguments!\n");
+		}
+	}
+	if (nb_rounds == 0 || burst_size == 0 || nb_pkts < burst_size ||
+	    frame_size < TEMPLATE_LEN ||
+	    frame_size > RTE_MBUF_DEFAULT_DATAROOM) {
+		usage();
+		rte_exit(EXIT_FAILURE, "Invalid arguments!\n");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct rte_mempool *pool;
+	size_t b;
+	int ret;
+
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	argc -= ret;
+	argv += ret;
+	parse_args(argc, argv);
+
+	pool = ffpp_init_mempool("pp_cycles", nb_pkts,
+				 RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	if (pool == NULL) {
+		rte_exit(EXIT_FAILURE, "Can not init the memory pool.\n");
+	}
+	pkts = malloc(sizeof(struct rte_mbuf *) * nb_pkts);
+	if (pkts == NULL ||
+	    rte_pktmbuf_alloc_bulk(pool, pkts, nb_pkts) != 0) {
+		rte_exit(EXIT_FAILURE, "Can not allocate the packets.\n");
+	}
+	build_template(template_untagged, false);
+	build_template(template_tagged, true);
+
+	printf("processor,impl,burst,frame_size,cycles_per_pkt\n");
+	for (b = 0; b < RTE_DIM(benches); ++b) {
+		printf("%s,default,%u,%u,%.2f\n", benches[b].name, burst_size,
+		       frame_size, run(benches[b].simd, benches[b].tagged));
+		if (benches[b].scalar == NULL) {
+			continue;
+		}
+		printf("%s,scalar,%u,%u,%.2f\n", benches[b].name, burst_size,
+		       frame_size, run(benches[b].scalar, benches[b].tagged));
+	}
+
+	rte_pktmbuf_free_bulk(pkts, nb_pkts);
+	free(pkts);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
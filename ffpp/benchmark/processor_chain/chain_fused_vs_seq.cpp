@@ -0,0 +1,204 @@
+/*
+ * chain_fused_vs_seq.cpp
+ *
+ * About: Cycles per packet of fused processor chains (ffpp::chain) with 1 to
+ *        6 stages, compared with running the same stages one after another
+ *        over the whole burst (chain::run_sequential()).
+ *
+ *        The stages are added in the order ParseEth, RewriteMac, DecTTL,
+ *        MarkDscp, SwapMac and Ipv4Cksum. Before each round the headers are
+ *        restored from a template, which is not measured. Use a number of
+ *        packets larger than the L2 cache to include memory stalls.
+ *
+ * Usage: chain_fused_vs_seq [EAL options] -- [-n PACKETS] [-r ROUNDS]
+ *        [-b BURST] [-z FRAME_SIZE]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <tuple>
+#include <utility>
+
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_udp.h>
+
+#include <ffpp/chain.hpp>
+#include <ffpp/collections.h>
+#include <ffpp/memory.h>
+
+static constexpr uint16_t template_len = 64;
+
+static uint32_t nb_pkts = 8192;
+static uint32_t nb_rounds = 200;
+static uint16_t burst_size = 32;
+static uint16_t frame_size = 64;
+
+static struct rte_mbuf **pkts;
+static uint8_t pkt_template[template_len];
+
+static const struct rte_ether_addr dl_src = { { 0x02, 0, 0, 0, 0, 0x01 } };
+static const struct rte_ether_addr dl_dst = { { 0x02, 0, 0, 0, 0, 0x02 } };
+
+using all_stages = std::tuple<ffpp::ParseEth, ffpp::RewriteMac, ffpp::DecTTL,
+			      ffpp::MarkDscp, ffpp::SwapMac, ffpp::Ipv4Cksum>;
+
+static const all_stages stages(ffpp::ParseEth(),
+			       ffpp::RewriteMac(dl_src, dl_dst),
+			       ffpp::DecTTL(), ffpp::MarkDscp(46),
+			       ffpp::SwapMac(), ffpp::Ipv4Cksum());
+
+template <std::size_t... I>
+static auto make_chain(std::index_sequence<I...>)
+{
+	return ffpp::chain<std::tuple_element_t<I, all_stages>...>(
+		std::get<I>(stages)...);
+}
+
+static void build_template(void)
+{
+	auto eth = reinterpret_cast<struct rte_ether_hdr *>(pkt_template);
+	auto ip = reinterpret_cast<struct rte_ipv4_hdr *>(eth + 1);
+	auto udp = reinterpret_cast<struct rte_udp_hdr *>(ip + 1);
+
+	memset(pkt_template, 0, template_len);
+	eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = rte_cpu_to_be_16(frame_size - RTE_ETHER_HDR_LEN);
+	ip->time_to_live = 64;
+	ip->next_proto_id = IPPROTO_UDP;
+	ip->src_addr = rte_cpu_to_be_32(RTE_IPV4(192, 168, 0, 1));
+	ip->dst_addr = rte_cpu_to_be_32(RTE_IPV4(192, 168, 0, 2));
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+	udp->src_port = rte_cpu_to_be_16(5000);
+	udp->dst_port = rte_cpu_to_be_16(5001);
+	udp->dgram_len = rte_cpu_to_be_16(frame_size - RTE_ETHER_HDR_LEN -
+					  sizeof(struct rte_ipv4_hdr));
+}
+
+static void reset_pkts(void)
+{
+	for (uint32_t i = 0; i < nb_pkts; ++i) {
+		struct rte_mbuf *m = pkts[i];
+		m->data_off = RTE_PKTMBUF_HEADROOM;
+		m->data_len = frame_size;
+		m->pkt_len = frame_size;
+		memcpy(rte_pktmbuf_mtod(m, void *), pkt_template, template_len);
+	}
+}
+
+template <typename Func> static double run(Func func)
+{
+	struct ffpp_mvec vec;
+	uint64_t cycles = 0;
+
+	for (uint32_t r = 0; r < nb_rounds; ++r) {
+		reset_pkts();
+		uint64_t start = rte_rdtsc_precise();
+		for (uint32_t i = 0; i + burst_size <= nb_pkts;
+		     i += burst_size) {
+			vec.head = pkts + i;
+			vec.len = burst_size;
+			vec.capacity = burst_size;
+			func(&vec);
+		}
+		cycles += rte_rdtsc_precise() - start;
+	}
+	return static_cast<double>(cycles) /
+	       (static_cast<double>(nb_rounds) *
+		(nb_pkts - nb_pkts % burst_size));
+}
+
+template <std::size_t N> static void bench(void)
+{
+	auto c = make_chain(std::make_index_sequence<N>{});
+	double fused = run([&c](struct ffpp_mvec *vec) { c(vec); });
+	double seq =
+		run([&c](struct ffpp_mvec *vec) { c.run_sequential(vec); });
+
+	printf("%zu,%u,%u,%.2f,%.2f,%.3f\n", N, burst_size, frame_size, fused,
+	       seq, seq / fused);
+}
+
+template <std::size_t... N> static void bench_all(std::index_sequence<N...>)
+{
+	(bench<N + 1>(), ...);
+}
+
+static void usage(void)
+{
+	printf("Usage: chain_fused_vs_seq [EAL options] -- [-n PACKETS] "
+	       "[-r ROUNDS] [-b BURST] [-z FRAME_SIZE]\n");
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int opt = 0;
+
+	while ((opt = getopt(argc, argv, "n:r:b:z:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			nb_pkts = atoi(optarg);
+			break;
+		case 'r':
+			nb_rounds = atoi(optarg);
+			break;
+		case 'b':
+			burst_size = atoi(optarg);
+			break;
+		case 'z':
+			frame_size = atoi(optarg);
+			break;
+		default:
+			usage();
+			rte_exit(EXIT_FAILURE, "Can not parse arguments!\n");
+		}
+	}
+	if (nb_rounds == 0 || burst_size == 0 || nb_pkts < burst_size ||
+	    frame_size < template_len ||
+	    frame_size > RTE_MBUF_DEFAULT_DATAROOM) {
+		usage();
+		rte_exit(EXIT_FAILURE, "Invalid arguments!\n");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	argc -= ret;
+	argv += ret;
+	parse_args(argc, argv);
+
+	struct rte_mempool *pool =
+		ffpp_init_mempool("chain_bench", nb_pkts,
+				  RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	if (pool == NULL) {
+		rte_exit(EXIT_FAILURE, "Can not init the memory pool.\n");
+	}
+	pkts = static_cast<struct rte_mbuf **>(
+		malloc(sizeof(struct rte_mbuf *) * nb_pkts));
+	if (pkts == NULL ||
+	    rte_pktmbuf_alloc_bulk(pool, pkts, nb_pkts) != 0) {
+		rte_exit(EXIT_FAILURE, "Can not allocate the packets.\n");
+	}
+	build_template();
+
+	printf("stages,burst,frame_size,fused_cycles_per_pkt,"
+	       "seq_cycles_per_pkt,speedup\n");
+	bench_all(std::make_index_sequence<std::tuple_size_v<all_stages>>{});
+
+	rte_pktmbuf_free_bulk(pkts, nb_pkts);
+	free(pkts);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
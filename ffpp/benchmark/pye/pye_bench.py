@@ -0,0 +1,27 @@
+#! /usr/bin/env python3
+# -*- coding: utf-8 -*-
+# vim:fenc=utf-8
+
+"""
+APU handlers of pye_pool_bench, see ffpp/pye.h.
+"""
+
+MOD_ADLER = 65521
+
+
+def apu_noop(payloads, lengths):
+    """Keep all packets unchanged, measures the overhead of a call."""
+
+
+def apu_adler32(payloads, lengths):
+    """Replace the last 4 bytes of each payload with the Adler-32 checksum of
+    the other bytes, computed in pure Python to keep the GIL busy."""
+    for i, payload in enumerate(payloads):
+        end = lengths[i] - 4
+        if end < 0:
+            continue
+        a, b = 1, 0
+        for byte in payload[:end]:
+            a = (a + byte) % MOD_ADLER
+            b = (b + a) % MOD_ADLER
+        payload[end : end + 4] = ((b << 16) | a).to_bytes(4, "big")
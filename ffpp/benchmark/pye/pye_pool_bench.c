@@ -0,0 +1,334 @@
+/*
+ * pye_pool_bench.c
+ *
+ * About: Packet rate of the Python slow path (see ffpp/pye.h) with a
+ *        compute-heavy handler, inline on the lcore with
+ *        ffpp_pye_process_apu() or with a pool of worker processes.
+ *
+ *        Inline, the lcore takes a burst of packets from a ring, processes it
+ *        and puts it back. With a pool, the lcore keeps all slots outstanding:
+ *        it submits the packets of the ring and puts the collected packets
+ *        back, so the workers never wait for the lcore.
+ *
+ * Usage: pye_pool_bench [EAL options] -- -p MODULE_PATH [-m MODE] [-f FUNC]
+ *        [-w WORKERS] [-c CPUS] [-s SIZE] [-b BATCH] [-S SLOTS] [-n PACKETS]
+ *        MODULE_PATH: Directory of pye_bench.py
+ *        MODE: inline or pool, default: pool
+ *        FUNC: Handler in pye_bench.py, default: apu_adler32
+ *        CPUS: CPUs of the workers, e.g. 2-5,8, default: the CPUs without
+ *              the lcores
+ *        SIZE: Frame size in bytes, default: 256
+ *        BATCH: Burst size inline, batch size of the pool, default: 32
+ *        SLOTS: Outstanding batches of the pool, default: 64
+ */
+
+// Python.h (included by pye.h) must be included before the system headers.
+#include <ffpp/pye.h>
+
+#include <inttypes.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_errno.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_ring.h>
+#include <rte_udp.h>
+
+#include <ffpp/collections.h>
+#include <ffpp/memory.h>
+
+#define PAYLOAD_OFFSET                                                         \
+	(RTE_ETHER_HDR_LEN + sizeof(struct rte_ipv4_hdr) +                     \
+	 sizeof(struct rte_udp_hdr))
+// Holds all packets, a vector holds at most UINT16_MAX.
+#define RING_SIZE 65536
+
+static const char *module_path = NULL;
+static const char *func_name = "apu_adler32";
+static bool pool_mode = true;
+static uint16_t nb_workers = 1;
+static cpu_set_t worker_cpus;
+static bool has_worker_cpus = false;
+static uint16_t size = 256;
+static uint16_t batch_size = 32;
+static uint16_t nb_slots = 64;
+static uint32_t nb_packets = 100000;
+
+static void usage(void)
+{
+	printf("Usage: pye_pool_bench [EAL options] -- -p MODULE_PATH "
+	       "[-m inline|pool] [-f FUNC] [-w WORKERS] [-c CPUS] [-s SIZE] "
+	       "[-b BATCH] [-S SLOTS] [-n PACKETS]\n");
+}
+
+/* Parse a CPU list like 2-5,8, return -1 if it is invalid or empty. */
+static int parse_cpus(const char *list, cpu_set_t *cpus)
+{
+	unsigned long first, last;
+	char *end;
+
+	CPU_ZERO(cpus);
+	for (;;) {
+		first = strtoul(list, &end, 10);
+		last = first;
+		if (end == list) {
+			return -1;
+		}
+		if (*end == '-') {
+			list = end + 1;
+			last = strtoul(list, &end, 10);
+			if (end == list || last < first) {
+				return -1;
+			}
+		}
+		if (last >= CPU_SETSIZE) {
+			return -1;
+		}
+		for (; first <= last; ++first) {
+			CPU_SET(first, cpus);
+		}
+		if (*end == '\0') {
+			return 0;
+		}
+		if (*end != ',') {
+			return -1;
+		}
+		list = end + 1;
+	}
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int opt = 0;
+
+	while ((opt = getopt(argc, argv, "p:m:f:w:c:s:b:S:n:h")) != -1) {
+		switch (opt) {
+		case 'p':
+			module_path = optarg;
+			break;
+		case 'm':
+			if (strcmp(optarg, "inline") == 0) {
+				pool_mode = false;
+			} else if (strcmp(optarg, "pool") == 0) {
+				pool_mode = true;
+			} else {
+				usage();
+				rte_exit(EXIT_FAILURE, "Unknown mode!\n");
+			}
+			break;
+		case 'f':
+			func_name = optarg;
+			break;
+		case 'w':
+			nb_workers = atoi(optarg);
+			break;
+		case 'c':
+			if (parse_cpus(optarg, &worker_cpus) != 0) {
+				usage();
+				rte_exit(EXIT_FAILURE, "Invalid CPU list!\n");
+			}
+			has_worker_cpus = true;
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 'b':
+			batch_size = atoi(optarg);
+			break;
+		case 'S':
+			nb_slots = atoi(optarg);
+			break;
+		case 'n':
+			nb_packets = atoi(optarg);
+			break;
+		default:
+			usage();
+			rte_exit(EXIT_FAILURE, "Can not parse arguments!\n");
+		}
+	}
+	if (module_path == NULL || size <= PAYLOAD_OFFSET ||
+	    size > RTE_ETHER_MAX_LEN || nb_workers == 0 ||
+	    nb_workers > FFPP_PYE_WORKERS_MAX || batch_size == 0 ||
+	    batch_size > FFPP_PYE_BATCH_MAX || nb_slots == 0 ||
+	    (uint32_t)(nb_slots + 1) * batch_size > UINT16_MAX ||
+	    nb_packets == 0) {
+		usage();
+		rte_exit(EXIT_FAILURE, "Invalid arguments!\n");
+	}
+}
+
+static void build_udp(struct rte_mbuf *m)
+{
+	struct rte_ether_hdr *eth;
+	struct rte_ipv4_hdr *ip;
+	struct rte_udp_hdr *udp;
+	uint8_t *data;
+	uint16_t i;
+
+	data = (uint8_t *)rte_pktmbuf_append(m, size);
+	if (data == NULL) {
+		rte_exit(EXIT_FAILURE, "The mbufs are too small.\n");
+	}
+	for (i = 0; i < size; ++i) {
+		data[i] = (uint8_t)i;
+	}
+	eth = (struct rte_ether_hdr *)data;
+	eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+	ip = (struct rte_ipv4_hdr *)(eth + 1);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = rte_cpu_to_be_16(size - RTE_ETHER_HDR_LEN);
+	ip->next_proto_id = IPPROTO_UDP;
+	udp = (struct rte_udp_hdr *)(ip + 1);
+	udp->dgram_len = rte_cpu_to_be_16(size - RTE_ETHER_HDR_LEN -
+					  sizeof(struct rte_ipv4_hdr));
+}
+
+static uint64_t run_inline(struct rte_ring *ring, struct ffpp_mvec *vec)
+{
+	uint64_t nb_done = 0;
+	int ret;
+
+	while (nb_done < nb_packets) {
+		vec->len = rte_ring_sc_dequeue_burst(ring, (void **)vec->head,
+						     batch_size, NULL);
+		ret = ffpp_pye_process_apu(vec, PAYLOAD_OFFSET);
+		if (ret < 0) {
+			rte_exit(EXIT_FAILURE, "The handler failed.\n");
+		}
+		nb_done += ret;
+		rte_ring_sp_enqueue_burst(ring, (void **)vec->head, vec->len,
+					  NULL);
+	}
+	return nb_done;
+}
+
+static uint64_t run_pool(struct ffpp_pye_pool *pool, struct rte_ring *ring,
+			 struct ffpp_mvec *vec, struct ffpp_mvec *out)
+{
+	struct ffpp_pye_pool_stats stats;
+	uint64_t nb_done = 0;
+
+	while (nb_done < nb_packets) {
+		// Fill the free slots.
+		ffpp_pye_pool_get_stats(pool, &stats);
+		vec->len = rte_ring_sc_dequeue_burst(
+			ring, (void **)vec->head,
+			(nb_slots - stats.outstanding) * batch_size, NULL);
+		ffpp_pye_pool_submit(pool, vec);
+		out->len = 0;
+		nb_done += ffpp_pye_pool_collect(pool, out);
+		rte_ring_sp_enqueue_burst(ring, (void **)out->head, out->len,
+					  NULL);
+	}
+	ffpp_pye_pool_get_stats(pool, &stats);
+	if (stats.failed != 0 || stats.dropped != 0) {
+		rte_exit(EXIT_FAILURE, "The handler failed or dropped.\n");
+	}
+	return nb_done;
+}
+
+int main(int argc, char *argv[])
+{
+	struct ffpp_pye_pool_config cfg;
+	struct ffpp_pye_pool *pool = NULL;
+	struct rte_mempool *mp;
+	struct rte_mbuf **pkts;
+	struct rte_ring *ring;
+	uint64_t start, cycles;
+	struct ffpp_mvec vec;
+	struct ffpp_mvec out;
+	uint64_t nb_done;
+	uint32_t nb_pkts;
+	uint32_t i;
+	int ret;
+
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	argc -= ret;
+	argv += ret;
+	parse_args(argc, argv);
+
+	// Enough packets to keep all slots outstanding, the mempool is
+	// created before the workers are forked.
+	nb_pkts = (uint32_t)nb_slots * batch_size + batch_size;
+	mp = ffpp_init_mempool("pye_pool_bench", 2 * nb_pkts - 1,
+			       RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	ring = rte_ring_create("pye_pool_bench", RING_SIZE, rte_socket_id(),
+			       RING_F_SP_ENQ | RING_F_SC_DEQ);
+	pkts = calloc(nb_pkts, sizeof(*pkts));
+	if (mp == NULL || ring == NULL || pkts == NULL ||
+	    rte_pktmbuf_alloc_bulk(mp, pkts, nb_pkts) != 0) {
+		rte_exit(EXIT_FAILURE, "Can not allocate the mbufs.\n");
+	}
+	for (i = 0; i < nb_pkts; ++i) {
+		build_udp(pkts[i]);
+	}
+	rte_ring_sp_enqueue_bulk(ring, (void **)pkts, nb_pkts, NULL);
+	ffpp_mvec_init(&vec, nb_pkts);
+	ffpp_mvec_init(&out, nb_pkts);
+
+	if (ffpp_pye_init("pye_pool_bench", module_path) != 0) {
+		rte_exit(EXIT_FAILURE, "Can not start the interpreter.\n");
+	}
+	if (pool_mode) {
+		memset(&cfg, 0, sizeof(cfg));
+		snprintf(cfg.name, sizeof(cfg.name), "pye_pool_bench");
+		cfg.socket_id = rte_socket_id();
+		cfg.nb_workers = nb_workers;
+		cfg.nb_slots = nb_slots;
+		cfg.batch_size = batch_size;
+		cfg.offset = PAYLOAD_OFFSET;
+		cfg.module_name = "pye_bench";
+		cfg.func_name = func_name;
+		cfg.cpuset = has_worker_cpus ? &worker_cpus : NULL;
+		pool = ffpp_pye_pool_create(&cfg);
+		if (pool == NULL) {
+			rte_exit(EXIT_FAILURE, "Can not create the pool: %s\n",
+				 rte_strerror(rte_errno));
+		}
+	} else if (ffpp_pye_set_apu_handler("pye_bench", func_name) != 0) {
+		rte_exit(EXIT_FAILURE, "Can not import the handler.\n");
+	}
+
+	start = rte_rdtsc_precise();
+	if (pool_mode) {
+		nb_done = run_pool(pool, ring, &vec, &out);
+	} else {
+		nb_done = run_inline(ring, &vec);
+	}
+	cycles = rte_rdtsc_precise() - start;
+
+	printf("mode,func,workers,size,batch,slots,packets,cycles_per_pkt,"
+	       "kpps\n");
+	printf("%s,%s,%u,%u,%u,%u,%" PRIu64 ",%.1f,%.3f\n",
+	       pool_mode ? "pool" : "inline", func_name,
+	       pool_mode ? nb_workers : 0, size, batch_size,
+	       pool_mode ? nb_slots : 0, nb_done, (double)cycles / nb_done,
+	       (double)nb_done * rte_get_tsc_hz() / cycles / 1e3);
+
+	// The outstanding packets are freed with the pool.
+	ffpp_pye_pool_free(pool);
+	ffpp_pye_cleanup();
+	while (rte_ring_sc_dequeue(ring, (void **)&pkts[0]) == 0) {
+		rte_pktmbuf_free(pkts[0]);
+	}
+	ffpp_mvec_free(&vec);
+	ffpp_mvec_free(&out);
+	free(pkts);
+	rte_ring_free(ring);
+	rte_mempool_free(mp);
+	rte_eal_cleanup();
+	return 0;
+}
@@ -0,0 +1,31 @@
+#!/bin/bash
+#
+# About: Run the Python slow path benchmark with the compute-heavy Adler-32 handler, once inline on the lcore and
+# with a worker pool of 1 to N processes, and collect the results in one CSV file. Each worker needs its own core
+# to scale, so N should not exceed the cores in WORKER_CPUS (all cores but the lcores by default).
+#
+# Build the benchmark first: meson build && ninja -C build
+#
+
+set -e
+
+LCORES=${LCORES:-"0"}
+WORKER_CPUS=${WORKER_CPUS:-"1-$(($(nproc) - 1))"}
+WORKERS=${WORKERS:-"1 2 4 8"}
+SIZE=${SIZE:-256}
+BATCH=${BATCH:-32}
+SLOTS=${SLOTS:-64}
+PACKETS=${PACKETS:-100000}
+FUNC=${FUNC:-apu_adler32}
+RESULT=${RESULT:-/tmp/pye_pool_bench.csv}
+MODULE_PATH=$(dirname "$(realpath "$0")")
+
+echo "mode,func,workers,size,batch,slots,packets,cycles_per_pkt,kpps" >"$RESULT"
+./build/pye_pool_bench -l "$LCORES" --no-pci --in-memory --log-level=3 -- \
+    -p "$MODULE_PATH" -f "$FUNC" -m inline -s "$SIZE" -b "$BATCH" -n "$PACKETS" | tail -n 1 >>"$RESULT"
+for workers in $WORKERS; do
+    ./build/pye_pool_bench -l "$LCORES" --no-pci --in-memory --log-level=3 -- \
+        -p "$MODULE_PATH" -f "$FUNC" -m pool -w "$workers" -c "$WORKER_CPUS" -s "$SIZE" -b "$BATCH" -S "$SLOTS" \
+        -n "$PACKETS" | tail -n 1 >>"$RESULT"
+done
+cat "$RESULT"
@@ -0,0 +1,23 @@
+#!/bin/bash
+#
+# About: Sweep the RSS skew for the run-to-completion and the work-stealing mode of the worker runtime and collect
+# the tail latencies in one CSV file.
+#
+# Build the benchmark first: meson build && ninja -C build
+#
+
+set -e
+
+LCORES=${LCORES:-"0-4"}
+RATE_KPPS=${RATE_KPPS:-200}
+PACKETS=${PACKETS:-1000000}
+RESULT=${RESULT:-/tmp/ws_skew_latency.csv}
+
+echo "mode,skew,rate_kpps,frame_size,received,lost,stolen_batches,p50_us,p99_us,p999_us,max_us" >"$RESULT"
+for skew in 0.25 0.5 0.75 0.9; do
+    for mode in rtc steal; do
+        ./build/ws_skew_latency -l "$LCORES" --no-pci --in-memory --log-level=3 -- \
+            -m "$mode" -r "$RATE_KPPS" -s "$skew" -n "$PACKETS" | tail -n 1 >>"$RESULT"
+    done
+done
+cat "$RESULT"
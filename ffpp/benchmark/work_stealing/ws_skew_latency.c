@@ -0,0 +1,340 @@
+/*
+ * ws_skew_latency.c
+ *
+ * About: Latency of a CPU-heavy MuNF (AES-CBC encryption and decryption of
+ *        each packet, like run_l2_aes of mp_munf_mono) under skewed RSS, with
+ *        the run-to-completion and the work-stealing mode of the ffpp worker
+ *        runtime.
+ *
+ *        A ring-backed port is used, so no NIC or traffic generator is
+ *        needed: the main lcore injects timestamped packets into the RX rings
+ *        at a fixed rate, a fraction SKEW of them into queue 0 and the rest
+ *        uniformly into the others, and collects them from the TX rings. Both
+ *        modes process the packets on the same number of worker lcores N,
+ *        with one RX queue per processing lcore: the work-stealing mode needs
+ *        one more lcore for TX, the run-to-completion mode leaves it idle. So
+ *        N is the number of worker lcores minus one.
+ *
+ * Usage: ws_skew_latency [EAL options] -- -m rtc|steal [-r RATE_KPPS]
+ *        [-s SKEW] [-n PACKETS] [-z FRAME_SIZE]
+ */
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_eth_ring.h>
+#include <rte_ethdev.h>
+#include <rte_ether.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mbuf_dyn.h>
+#include <rte_random.h>
+#include <rte_ring.h>
+
+#include <ffpp/aes.h>
+#include <ffpp/collections.h>
+#include <ffpp/config.h>
+#include <ffpp/device.h>
+#include <ffpp/histogram.h>
+#include <ffpp/memory.h>
+#include <ffpp/task.h>
+
+#define GEN_BURST 8
+#define COLLECT_BURST 32
+#define RING_SIZE 4096
+#define NB_MBUFS 65535
+#define DRAIN_TIMEOUT_S 2
+
+static volatile bool force_quit = false;
+
+static enum ffpp_worker_mode mode = FFPP_WORKER_MODE_RTC;
+static uint32_t rate_kpps = 200;
+static double skew = 0.75;
+static uint32_t nb_pkts = 1000000;
+static uint16_t frame_size = 1500;
+
+static uint16_t nb_queues;
+static uint16_t port_id;
+static struct rte_ring *rx_rings[FFPP_MAX_QUEUES_PER_PORT];
+static struct rte_ring *tx_rings[FFPP_MAX_QUEUES_PER_PORT];
+static int ts_offset;
+
+static const uint8_t aes_key[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae,
+				     0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88,
+				     0x09, 0xcf, 0x4f, 0x3c };
+static const uint8_t aes_iv[16] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+				    0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+				    0x0c, 0x0d, 0x0e, 0x0f };
+
+static void signal_handler(int signum)
+{
+	if (signum == SIGINT || signum == SIGTERM) {
+		force_quit = true;
+	}
+}
+
+static inline uint64_t *pkt_ts(struct rte_mbuf *m)
+{
+	return RTE_MBUF_DYNFIELD(m, ts_offset, uint64_t *);
+}
+
+static uint16_t aes_handler(struct ffpp_mvec *vec, void *arg)
+{
+	struct AES_ctx aes_ctx;
+	struct rte_mbuf *m;
+	uint8_t *data;
+	uint32_t len;
+	uint16_t i;
+
+	RTE_SET_USED(arg);
+	FFPP_MVEC_FOREACH(vec, i, m)
+	{
+		data = rte_pktmbuf_mtod_offset(m, uint8_t *, RTE_ETHER_HDR_LEN);
+		len = RTE_ALIGN_FLOOR(
+			rte_pktmbuf_data_len(m) - RTE_ETHER_HDR_LEN,
+			AES_BLOCKLEN);
+		AES_init_ctx_iv(&aes_ctx, aes_key, aes_iv);
+		AES_CBC_encrypt_buffer(&aes_ctx, data, len);
+		AES_init_ctx_iv(&aes_ctx, aes_key, aes_iv);
+		AES_CBC_decrypt_buffer(&aes_ctx, data, len);
+	}
+	return vec->len;
+}
+
+static inline uint16_t pick_queue(void)
+{
+	if (nb_queues == 1 || rte_rand() % 10000 < (uint64_t)(skew * 10000)) {
+		return 0;
+	}
+	return 1 + rte_rand() % (nb_queues - 1);
+}
+
+static uint32_t collect(struct ffpp_hist *latencies, uint32_t received)
+{
+	struct rte_mbuf *pkts[COLLECT_BURST];
+	uint64_t now;
+	unsigned int n, i;
+	uint16_t q;
+
+	for (q = 0; q < nb_queues; ++q) {
+		n = rte_ring_sc_dequeue_burst(tx_rings[q], (void **)pkts,
+					      COLLECT_BURST, NULL);
+		if (n == 0) {
+			continue;
+		}
+		now = rte_rdtsc();
+		for (i = 0; i < n; ++i) {
+			ffpp_hist_record(latencies, now - *pkt_ts(pkts[i]));
+		}
+		received += n;
+		rte_pktmbuf_free_bulk(pkts, n);
+	}
+	return received;
+}
+
+/**
+ * Inject nb_pkts packets at rate_kpps and collect them. Return the number of
+ * received packets, lost counts the packets dropped at the RX rings.
+ */
+static uint32_t run_traffic(struct rte_mempool *pool,
+			    struct ffpp_hist *latencies, uint32_t *lost)
+{
+	const uint64_t tsc_hz = rte_get_tsc_hz();
+	const uint64_t interval_tsc =
+		tsc_hz * GEN_BURST / ((uint64_t)rate_kpps * 1000);
+	struct rte_mbuf *pkts[GEN_BURST];
+	uint64_t next_tsc, deadline;
+	uint32_t sent = 0;
+	uint32_t received = 0;
+	uint16_t i;
+
+	next_tsc = rte_rdtsc();
+	while (sent < nb_pkts && !force_quit) {
+		if (rte_rdtsc() >= next_tsc &&
+		    rte_pktmbuf_alloc_bulk(pool, pkts, GEN_BURST) == 0) {
+			for (i = 0; i < GEN_BURST; ++i) {
+				rte_pktmbuf_append(pkts[i], frame_size);
+				pkts[i]->port = port_id;
+				*pkt_ts(pkts[i]) = rte_rdtsc();
+				if (rte_ring_sp_enqueue(rx_rings[pick_queue()],
+							pkts[i]) < 0) {
+					rte_pktmbuf_free(pkts[i]);
+					(*lost)++;
+				}
+			}
+			sent += GEN_BURST;
+			next_tsc += interval_tsc;
+		}
+		received = collect(latencies, received);
+	}
+
+	deadline = rte_rdtsc() + DRAIN_TIMEOUT_S * tsc_hz;
+	while (received + *lost < sent && rte_rdtsc() < deadline) {
+		received = collect(latencies, received);
+	}
+	return received;
+}
+
+static double quantile_us(const struct ffpp_hist *latencies, double q)
+{
+	return (double)ffpp_hist_quantile(latencies, q) * 1e6 /
+	       rte_get_tsc_hz();
+}
+
+static uint16_t init_ring_port(struct rte_mempool *pool)
+{
+	char name[RTE_RING_NAMESIZE];
+	struct ffpp_dpdk_device_config cfg;
+	int ret;
+	uint16_t q;
+
+	for (q = 0; q < nb_queues; ++q) {
+		snprintf(name, sizeof(name), "ws_rx_%u", q);
+		rx_rings[q] = rte_ring_create(name, RING_SIZE, rte_socket_id(),
+					      RING_F_SP_ENQ | RING_F_SC_DEQ);
+		snprintf(name, sizeof(name), "ws_tx_%u", q);
+		tx_rings[q] = rte_ring_create(name, RING_SIZE, rte_socket_id(),
+					      RING_F_SP_ENQ | RING_F_SC_DEQ);
+		if (rx_rings[q] == NULL || tx_rings[q] == NULL) {
+			rte_exit(EXIT_FAILURE, "Can not create the rings.\n");
+		}
+	}
+	ret = rte_eth_from_rings("ws_ring_port", rx_rings, nb_queues, tx_rings,
+				 nb_queues, rte_socket_id());
+	if (ret < 0) {
+		rte_exit(EXIT_FAILURE, "Can not create the ring port.\n");
+	}
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.port_id = ret;
+	cfg.pool = &pool;
+	cfg.rx_queues = nb_queues;
+	cfg.tx_queues = nb_queues;
+	cfg.rx_descs = RING_SIZE;
+	cfg.tx_descs = RING_SIZE;
+	cfg.disable_offloads = 1;
+	ffpp_dpdk_init_device(&cfg);
+	return ret;
+}
+
+static void usage(void)
+{
+	printf("Usage: ws_skew_latency [EAL options] -- -m rtc|steal "
+	       "[-r RATE_KPPS] [-s SKEW] [-n PACKETS] [-z FRAME_SIZE]\n");
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int opt = 0;
+
+	while ((opt = getopt(argc, argv, "m:r:s:n:z:h")) != -1) {
+		switch (opt) {
+		case 'm':
+			mode = strcmp(optarg, "steal") == 0 ?
+					     FFPP_WORKER_MODE_STEAL :
+					     FFPP_WORKER_MODE_RTC;
+			break;
+		case 'r':
+			rate_kpps = atoi(optarg);
+			break;
+		case 's':
+			skew = atof(optarg);
+			break;
+		case 'n':
+			nb_pkts = atoi(optarg);
+			break;
+		case 'z':
+			frame_size = atoi(optarg);
+			break;
+		default:
+			usage();
+			rte_exit(EXIT_FAILURE, "Can not parse arguments!\n");
+		}
+	}
+	if (rate_kpps == 0 || skew < 0.0 || skew > 1.0 ||
+	    frame_size < RTE_ETHER_MIN_LEN ||
+	    frame_size > RTE_MBUF_DEFAULT_DATAROOM) {
+		usage();
+		rte_exit(EXIT_FAILURE, "Invalid arguments!\n");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct ffpp_worker_config cfg;
+	struct ffpp_worker_runtime *rt;
+	struct ffpp_worker_stats total;
+	struct rte_mempool *pool;
+	struct ffpp_hist latencies;
+	uint32_t received, lost = 0;
+	int ret;
+
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	argc -= ret;
+	argv += ret;
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+	parse_args(argc, argv);
+
+	// The main lcore and the TX lcore of the work-stealing mode are not
+	// processing lcores.
+	nb_queues = rte_lcore_count() - 2;
+	if (rte_lcore_count() < 4 || nb_queues > FFPP_MAX_QUEUES_PER_PORT) {
+		rte_exit(EXIT_FAILURE, "3 to %d worker lcores are required.\n",
+			 FFPP_MAX_QUEUES_PER_PORT + 1);
+	}
+	if (rte_mbuf_dyn_rx_timestamp_register(&ts_offset, NULL) < 0) {
+		rte_exit(EXIT_FAILURE, "Can not register the timestamp.\n");
+	}
+
+	pool = ffpp_init_mempool("ws_skew", NB_MBUFS, RTE_MBUF_DEFAULT_BUF_SIZE,
+				 rte_socket_id());
+	if (pool == NULL) {
+		rte_exit(EXIT_FAILURE, "Can not init the memory pool.\n");
+	}
+	ffpp_hist_init(&latencies);
+	port_id = init_ring_port(pool);
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.mode = mode;
+	cfg.nb_ports = 1;
+	cfg.port_ids[0] = port_id;
+	cfg.tx_port_map[0] = 0;
+	cfg.nb_rx_queues = nb_queues;
+	cfg.nb_tx_queues = nb_queues;
+	cfg.nb_stages = 1;
+	cfg.handlers[0] = aes_handler;
+	rt = ffpp_workers_create(&cfg);
+	if (rt == NULL) {
+		rte_exit(EXIT_FAILURE, "Can not create the workers.\n");
+	}
+	ffpp_workers_launch(rt);
+
+	received = run_traffic(pool, &latencies, &lost);
+
+	ffpp_workers_stop(rt);
+	ffpp_workers_wait(rt);
+	ffpp_workers_get_stats(rt, &total);
+	ffpp_workers_print_stats(rt);
+
+	printf("mode,skew,rate_kpps,frame_size,received,lost,stolen_batches,"
+	       "p50_us,p99_us,p999_us,max_us\n");
+	printf("%s,%.2f,%u,%u,%u,%u,%lu,%.2f,%.2f,%.2f,%.2f\n",
+	       mode == FFPP_WORKER_MODE_STEAL ? "steal" : "rtc", skew,
+	       rate_kpps, frame_size, received, lost, total.stolen_batches,
+	       quantile_us(&latencies, 0.5), quantile_us(&latencies, 0.99),
+	       quantile_us(&latencies, 0.999), quantile_us(&latencies, 1.0));
+
+	ffpp_workers_destroy(rt);
+	ffpp_dpdk_cleanup_devices();
+	rte_eal_cleanup();
+	return 0;
+}
@@ -5,11 +5,15 @@
  * CPU frequency is suited for the most busy CNF
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <sched.h>
 #include <signal.h>
 
 #include <locale.h>
@@ -30,6 +34,7 @@
 #include <ffpp/scaling_defines_user.h>
 #include <ffpp/general_helpers_user.h>
 #include <ffpp/global_stats_user.h>
+#include <ffpp/logger.h>
 
 // Supress prints
 // #define RELEASE 1
@@ -38,12 +43,9 @@
 #endif
 
 static volatile bool force_quit;
+// Cycle counters of the VNFs, if they run on a ffpp workers runtime.
+static struct ffpp_cycle_stats *cycle_stats;
 
-double g_csv_pps_mult[NUM_VNFS][TOTAL_VALS];
-double g_csv_ts[TOTAL_VALS];
-double g_csv_iat_mult[NUM_VNFS][TOTAL_VALS];
-double g_csv_cpu_util_mult[NUM_VNFS][TOTAL_VALS];
-unsigned int g_csv_freq[TOTAL_VALS];
 unsigned int g_csv_num_val = 0;
 int g_csv_num_round = 0;
 int g_csv_empty_cnt = 0;
@@ -52,6 +54,31 @@ int g_csv_empty_cnt_threshold =
 bool g_csv_saved_stream = false;
 
 const char *pin_basedir = "/sys/fs/bpf";
+// Relative to the working directory, the second argument overrides it.
+const char *log_path_default = "2_vnf_manager.ffpplog";
+
+// One record per VNF and interval, sessions are separated by the round.
+struct vnf_record {
+	double ts;
+	double pps;
+	double iat;
+	double cpu_util;
+	uint32_t freq;
+	uint32_t vnf;
+	uint32_t round;
+};
+
+static const struct ffpp_log_field vnf_fields[] = {
+	FFPP_LOG_FIELD(FFPP_LOG_F64, struct vnf_record, ts),
+	FFPP_LOG_FIELD(FFPP_LOG_F64, struct vnf_record, pps),
+	FFPP_LOG_FIELD(FFPP_LOG_F64, struct vnf_record, iat),
+	FFPP_LOG_FIELD(FFPP_LOG_F64, struct vnf_record, cpu_util),
+	FFPP_LOG_FIELD(FFPP_LOG_U32, struct vnf_record, freq),
+	FFPP_LOG_FIELD(FFPP_LOG_U32, struct vnf_record, vnf),
+	FFPP_LOG_FIELD(FFPP_LOG_U32, struct vnf_record, round),
+};
+
+static struct ffpp_log_producer *vnf_log;
 
 static void signal_handler(int signum)
 {
@@ -154,28 +181,31 @@ collect_global_stats(struct freq_info *f, struct measurement *m,
 		     int num_vnfs)
 {
 	int i;
-	g_csv_ts[g_csv_num_val] = get_time_of_day();
-	g_csv_freq[g_csv_num_val] = f->freq;
+	double ts = get_time_of_day();
 	for (i = 0; i < num_vnfs; i++) {
-		g_csv_pps_mult[i][g_csv_num_val] =
-			(1 / m[i].inter_arrival_time); //ts->pps;
-		g_csv_iat_mult[i][g_csv_num_val] = m[i].inter_arrival_time;
-		g_csv_cpu_util_mult[i][g_csv_num_val] = m[i].cpu_util[m[i].idx];
+		struct vnf_record r = {
+			.ts = ts,
+			.pps = (1 / m[i].inter_arrival_time), //ts->pps;
+			.iat = m[i].inter_arrival_time,
+			.cpu_util = m[i].cpu_util[m[i].idx],
+			.freq = f->freq,
+			.vnf = i,
+			.round = g_csv_num_round,
+		};
 		if (m[i].empty_cnt == 0) {
 			g_csv_empty_cnt = 0;
 		} else {
 			if (!g_csv_saved_stream) {
-				g_csv_pps_mult[i][g_csv_num_val] = 0.0;
-				g_csv_cpu_util_mult[i][g_csv_num_val] = 0.0;
+				r.pps = 0.0;
+				r.cpu_util = 0.0;
 				g_csv_empty_cnt += 1;
 			}
 		}
+		ffpp_log_write(vnf_log, &r);
 	}
 	g_csv_num_val++;
 	if (g_csv_empty_cnt > g_csv_empty_cnt_threshold) {
-		// @ int: CNF index
-		write_csv_file_2vnf(0);
-		write_csv_file_2vnf(1);
+		// The samples are written by the logger thread.
 		g_csv_saved_stream = true;
 		g_csv_empty_cnt = 0;
 		g_csv_num_val = 0;
@@ -220,9 +250,18 @@ static void stats_poll(int map_fd, struct freq_info *freq_info, int num_vnfs)
 	struct measurement m[2] = { 0 };
 	struct scaling_info si = { 0 };
 	struct last_stream_settings lss = { 0 };
+	struct ffpp_lcore_cycles cycles_prev[2] = { 0 }, cycles;
 
 	// m.lcore = rte_lcore_id();
 	m[0].min_cnts = m[1].min_cnts = NUM_READINGS_SMA;
+	// The VNFs run on the CNF cores of init_power_library()
+	for (i = 0; i < num_vnfs; i++) {
+		m[i].lcore = CORE_OFFSET + i * CORE_MASK;
+		if (cycle_stats != NULL) {
+			ffpp_cycle_stats_read(cycle_stats, m[i].lcore,
+					      &cycles_prev[i]);
+		}
+	}
 
 	setlocale(LC_NUMERIC, "en_US");
 	for (i = 0; i < num_vnfs; i++) {
@@ -247,7 +286,17 @@ static void stats_poll(int map_fd, struct freq_info *freq_info, int num_vnfs)
 			if (m[i].valid_vals > 0) {
 				// manage = true;
 				active++;
-				get_cpu_utilization(&m[i], freq_info);
+				if (cycle_stats != NULL) {
+					ffpp_cycle_stats_read(cycle_stats,
+							      m[i].lcore,
+							      &cycles);
+					get_cpu_utilization_cycles(
+						&m[i], &cycles_prev[i],
+						&cycles);
+					cycles_prev[i] = cycles;
+				} else {
+					get_cpu_utilization(&m[i], freq_info);
+				}
 				calc_sma(&m[i]);
 				calc_wma(&m[i]);
 			}
@@ -337,6 +386,36 @@ static void stats_poll(int map_fd, struct freq_info *freq_info, int num_vnfs)
 	}
 }
 
+/*
+ * Initialize the EAL as a secondary process of the ffpp process with the given
+ * file prefix. The EAL pins the calling thread to the CPU of the main lcore,
+ * so the CPU affinity is restored afterwards.
+ */
+static int eal_attach(const char *file_prefix)
+{
+	char prog[] = "ffpp_manager";
+	char no_pci[] = "--no-pci";
+	char proc_type[] = "--proc-type=secondary";
+	char prefix_arg[PATH_MAX];
+	char log_level[] = "--log-level=3";
+	// All lcores stay enabled for rte_lcore_is_enabled().
+	char *eal_args[] = { prog, no_pci, proc_type, prefix_arg, log_level };
+	cpu_set_t cpus;
+
+	snprintf(prefix_arg, sizeof(prefix_arg), "--file-prefix=%s",
+		 file_prefix);
+	if (sched_getaffinity(0, sizeof(cpus), &cpus) != 0) {
+		return -1;
+	}
+	if (rte_eal_init(RTE_DIM(eal_args), eal_args) < 0) {
+		fprintf(stderr, "WARN: Can not attach to the ffpp process %s\n",
+			file_prefix);
+		return -1;
+	}
+	sched_setaffinity(0, sizeof(cpus), &cpus);
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	if (argc < 1) {
@@ -431,6 +510,36 @@ int main(int argc, char *argv[])
 	printf("Scale frequency of system CPU up to maximum.\n");
 	set_system_pstate(1);
 
+	struct ffpp_logger_config log_cfg = {
+		.path = argc >= 3 ? argv[2] : log_path_default,
+		.name = "2_vnf_manager",
+		.fields = vnf_fields,
+		.nb_fields = RTE_DIM(vnf_fields),
+		.record_size = sizeof(struct vnf_record),
+	};
+	struct ffpp_logger *logger = ffpp_logger_create(&log_cfg);
+	if (logger == NULL) {
+		fprintf(stderr, "ERR: Can not create the log file: %s\n",
+			log_cfg.path);
+		return EXIT_FAILURE;
+	}
+	vnf_log = ffpp_logger_add_producer(logger);
+	if (vnf_log == NULL) {
+		fprintf(stderr, "ERR: Can not add the log producer.\n");
+		ffpp_logger_free(logger);
+		return EXIT_FAILURE;
+	}
+	printf("Measurements are logged to: %s\n", log_cfg.path);
+
+	// Measure the VNF's busy cycles instead of estimating them
+	const char *cycle_stats_prefix = getenv("FFPP_CYCLE_STATS_PREFIX");
+	if (cycle_stats_prefix != NULL && eal_attach(cycle_stats_prefix) == 0) {
+		cycle_stats = attach_cycle_stats();
+		if (cycle_stats == NULL) {
+			rte_eal_cleanup();
+		}
+	}
+
 	// Print stats from xdp_stats_map
 	printf("Collecting stats from BPF map:\n");
 	freq_info.pstate = rte_power_get_freq(CORE_OFFSET);
@@ -441,6 +550,11 @@ int main(int argc, char *argv[])
 	/// Get PID with ffpp_power and the simply kill PID
 	exit_power_library();
 	exit_power_library_on_system();
+	// Convert with scripts/ffpp_log_convert.py
+	ffpp_logger_free(logger);
+	if (cycle_stats != NULL) {
+		rte_eal_cleanup();
+	}
 	printf("\nBye..\n");
 	return 0;
 }
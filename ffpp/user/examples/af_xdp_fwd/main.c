@@ -0,0 +1,203 @@
+/*
+ * main.c
+ *
+ * About: L2 forwarder between two AF_XDP backed ffpp ports.
+ *        Queue i of both ports is handled by the i-th worker lcore.
+ */
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_ethdev.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_string_fns.h>
+
+#include <ffpp/collections.h>
+#include <ffpp/config.h>
+#include <ffpp/device.h>
+#include <ffpp/memory.h>
+#include <ffpp/packet_processors.h>
+
+#define BURST_SIZE 64
+#define NB_MBUFS_PER_QUEUE 4096
+#define STATS_PERIOD_S 1
+
+static volatile bool force_quit = false;
+
+static char in_iface[IF_NAMESIZE] = "vnf-in";
+static char out_iface[IF_NAMESIZE] = "vnf-out";
+static uint16_t nb_queues = 1;
+static uint16_t busy_budget = 0;
+static enum ffpp_af_xdp_mode xdp_mode = FFPP_AF_XDP_MODE_AUTO;
+
+static uint16_t in_port_id;
+static uint16_t out_port_id;
+static struct rte_ether_addr out_port_addr;
+
+static void signal_handler(int signum)
+{
+	if (signum == SIGINT || signum == SIGTERM) {
+		force_quit = true;
+	}
+}
+
+static int run_worker(void *arg)
+{
+	uint16_t queue_id = (uint16_t)(uintptr_t)arg;
+	struct rte_mbuf *pkts[BURST_SIZE];
+	struct ffpp_mvec vec;
+	uint16_t nb_rx, nb_tx;
+
+	ffpp_mvec_init(&vec, BURST_SIZE);
+	RTE_LOG(INFO, FFPP, "Lcore %u forwards queue %u\n", rte_lcore_id(),
+		queue_id);
+	while (!force_quit) {
+		nb_rx = rte_eth_rx_burst(in_port_id, queue_id, pkts,
+					 BURST_SIZE);
+		if (nb_rx == 0) {
+			continue;
+		}
+		ffpp_mvec_set_mbufs(&vec, pkts, nb_rx);
+		ffpp_pp_update_dl_src(&vec, &out_port_addr);
+		nb_tx = rte_eth_tx_burst(out_port_id, queue_id, pkts, nb_rx);
+		if (unlikely(nb_tx < nb_rx)) {
+			rte_pktmbuf_free_bulk(pkts + nb_tx, nb_rx - nb_tx);
+		}
+	}
+	ffpp_mvec_free(&vec);
+	return 0;
+}
+
+static void print_stats(void)
+{
+	struct rte_eth_stats in_stats, out_stats;
+	uint64_t last_tx = 0;
+
+	while (!force_quit) {
+		rte_delay_ms(STATS_PERIOD_S * 1000);
+		rte_eth_stats_get(in_port_id, &in_stats);
+		rte_eth_stats_get(out_port_id, &out_stats);
+		printf("RX: %lu, RX missed: %lu, TX: %lu, TX rate: %.3f Mpps\n",
+		       in_stats.ipackets, in_stats.imissed, out_stats.opackets,
+		       (double)(out_stats.opackets - last_tx) /
+			       (STATS_PERIOD_S * 1e6));
+		last_tx = out_stats.opackets;
+	}
+}
+
+static uint16_t init_port(const char *iface, struct rte_mempool *pool)
+{
+	struct ffpp_dpdk_device_config cfg = {
+		.pool = &pool,
+		.rx_queues = nb_queues,
+		.tx_queues = nb_queues,
+		.rx_descs = 2048,
+		.tx_descs = 2048,
+		.drop_enabled = 1,
+		.disable_offloads = 1,
+		.type = FFPP_DPDK_DEVICE_AF_XDP,
+	};
+	rte_strscpy(cfg.af_xdp.iface, iface, sizeof(cfg.af_xdp.iface));
+	cfg.af_xdp.start_queue = 0;
+	cfg.af_xdp.mode = xdp_mode;
+	cfg.af_xdp.busy_budget = busy_budget;
+	ffpp_dpdk_init_device(&cfg);
+	return cfg.port_id;
+}
+
+static void usage(void)
+{
+	printf("Usage: ffpp_af_xdp_fwd [EAL options] -- -i IFACE -o IFACE "
+	       "[-q QUEUES] [-m auto|copy] [-b BUSY_BUDGET]\n");
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int opt = 0;
+
+	while ((opt = getopt(argc, argv, "i:o:q:m:b:h")) != -1) {
+		switch (opt) {
+		case 'i':
+			rte_strscpy(in_iface, optarg, sizeof(in_iface));
+			break;
+		case 'o':
+			rte_strscpy(out_iface, optarg, sizeof(out_iface));
+			break;
+		case 'q':
+			nb_queues = atoi(optarg);
+			break;
+		case 'm':
+			if (strcmp(optarg, "auto") == 0) {
+				xdp_mode = FFPP_AF_XDP_MODE_AUTO;
+			} else if (strcmp(optarg, "copy") == 0) {
+				xdp_mode = FFPP_AF_XDP_MODE_COPY;
+			} else {
+				usage();
+				rte_exit(EXIT_FAILURE, "Unknown AF_XDP mode!\n");
+			}
+			break;
+		case 'b':
+			busy_budget = atoi(optarg);
+			break;
+		default:
+			usage();
+			rte_exit(EXIT_FAILURE, "Can not parse arguments!\n");
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct rte_mempool *pool;
+	unsigned int lcore_id;
+	uint16_t q = 0;
+	int ret;
+
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	argc -= ret;
+	argv += ret;
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+	parse_args(argc, argv);
+
+	if (rte_lcore_count() < (unsigned int)nb_queues + 1) {
+		rte_exit(EXIT_FAILURE,
+			 "One worker lcore is required for each queue.\n");
+	}
+
+	pool = ffpp_init_mempool("af_xdp_fwd", NB_MBUFS_PER_QUEUE * nb_queues * 2,
+				 RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	if (pool == NULL) {
+		rte_exit(EXIT_FAILURE, "Can not init the memory pool.\n");
+	}
+	in_port_id = init_port(in_iface, pool);
+	out_port_id = init_port(out_iface, pool);
+	rte_eth_macaddr_get(out_port_id, &out_port_addr);
+
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		if (q == nb_queues) {
+			break;
+		}
+		rte_eal_remote_launch(run_worker, (void *)(uintptr_t)q,
+				      lcore_id);
+		q++;
+	}
+	print_stats();
+
+	rte_eal_mp_wait_lcore();
+	ffpp_dpdk_cleanup_devices();
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
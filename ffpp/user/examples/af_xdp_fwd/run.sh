@@ -0,0 +1,28 @@
+#!/bin/bash
+# About: Run the AF_XDP forwarder inside the vnf0 container of the benchmark setup described in the ffpp/util.
+#
+
+if [[ ! -f "../../build/examples/ffpp_af_xdp_fwd" ]]; then
+    echo "ERR: Can not find the built ffpp_af_xdp_fwd executable."
+    echo "Please run 'make examples' in the ffpp/user folder."
+    exit 1
+fi
+
+# AF_XDP sockets need to lock the UMEM in memory.
+ulimit -l unlimited
+# The XDP program of the PMD replaces the xdp-pass program.
+xdp-loader unload vnf-in
+xdp-loader unload vnf-out
+
+# The main lcore prints the statistics, each queue needs its own worker lcore.
+QUEUES=1
+ARGS=("$@")
+for ((i = 0; i < ${#ARGS[@]}; i++)); do
+    if [[ "${ARGS[$i]}" == "-q" ]]; then
+        QUEUES=${ARGS[$((i + 1))]}
+    fi
+done
+LCORES="1-$((QUEUES + 1))"
+
+EAL_OPTS="-l $LCORES --no-pci --single-file-segments --file-prefix=af_xdp_fwd"
+../../build/examples/ffpp_af_xdp_fwd $EAL_OPTS -- -i vnf-in -o vnf-out "$@"
@@ -3,11 +3,15 @@
  * statistics provided by the XDP program(s).
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <sched.h>
 #include <signal.h>
 
 #include <locale.h>
@@ -28,18 +32,16 @@
 #include <ffpp/scaling_defines_user.h>
 #include <ffpp/general_helpers_user.h>
 #include <ffpp/global_stats_user.h>
+#include <ffpp/logger.h>
 
 #ifdef RELEASE
 #define printf(fmt, ...) (0)
 #endif /* RELEAE */
 
 static volatile bool force_quit;
+// Cycle counters of the VNF, if it is a ffpp workers runtime.
+static struct ffpp_cycle_stats *cycle_stats;
 
-double g_csv_pps[TOTAL_VALS];
-double g_csv_ts[TOTAL_VALS];
-double g_csv_iat[TOTAL_VALS];
-double g_csv_cpu_util[TOTAL_VALS];
-unsigned int g_csv_freq[TOTAL_VALS];
 unsigned int g_csv_num_val = 0;
 int g_csv_num_round = 0;
 int g_csv_empty_cnt = 0;
@@ -48,6 +50,32 @@ int g_csv_empty_cnt_threshold =
 bool g_csv_saved_stream = false;
 
 const char *pin_basedir = "/sys/fs/bpf";
+// Relative to the working directory, the second argument overrides it.
+const char *log_path_default = "c1_manager.ffpplog";
+
+// One record per interval, sessions are separated by the round.
+struct pm_record {
+	double ts;
+	double pps;
+	double iat;
+	double cpu_util;
+	uint32_t freq;
+	uint32_t round;
+};
+
+static const struct ffpp_log_field pm_fields[] = {
+	FFPP_LOG_FIELD(FFPP_LOG_F64, struct pm_record, ts),
+	FFPP_LOG_FIELD(FFPP_LOG_F64, struct pm_record, pps),
+	FFPP_LOG_FIELD(FFPP_LOG_F64, struct pm_record, iat),
+	FFPP_LOG_FIELD(FFPP_LOG_F64, struct pm_record, cpu_util),
+	FFPP_LOG_FIELD(FFPP_LOG_U32, struct pm_record, freq),
+	FFPP_LOG_FIELD(FFPP_LOG_U32, struct pm_record, round),
+};
+
+static struct ffpp_log_producer *pm_log;
+// The CPU utilization is added after collect_global_stats().
+static struct pm_record sample;
+static bool sample_pending;
 
 static void signal_handler(int signum)
 {
@@ -148,22 +176,24 @@ static void collect_global_stats(struct freq_info *f, struct measurement *m,
 				 struct scaling_info *si)
 {
 	// if (m->had_first_packet) {
-	g_csv_ts[g_csv_num_val] = get_time_of_day();
-	g_csv_pps[g_csv_num_val] = (1 / m->inter_arrival_time); //ts->pps;
-	g_csv_iat[g_csv_num_val] = m->inter_arrival_time;
-	g_csv_freq[g_csv_num_val] = f->freq;
+	sample = (struct pm_record){
+		.ts = get_time_of_day(),
+		.pps = (1 / m->inter_arrival_time), //ts->pps;
+		.iat = m->inter_arrival_time,
+		.freq = f->freq,
+		.round = g_csv_num_round,
+	};
+	sample_pending = true;
 	g_csv_num_val++;
 	if (m->empty_cnt == 0) { //(ts[0].delta_packets > 0) {
 		g_csv_empty_cnt = 0;
 	} else {
 		if (!g_csv_saved_stream) {
-			g_csv_pps[g_csv_num_val - 1] = 0.0;
-			g_csv_cpu_util[g_csv_num_val - 1] = 0.0;
+			sample.pps = 0.0;
 			g_csv_empty_cnt += 1;
 		}
 		if (g_csv_empty_cnt > g_csv_empty_cnt_threshold) {
-			write_csv_file();
-			// write_csv_file_fb_out();
+			// The samples are written by the logger thread.
 			g_csv_saved_stream = true;
 			g_csv_empty_cnt = 0;
 			g_csv_num_val = 0;
@@ -176,6 +206,14 @@ static void collect_global_stats(struct freq_info *f, struct measurement *m,
 	// }
 }
 
+static void log_sample(void)
+{
+	if (sample_pending) {
+		ffpp_log_write(pm_log, &sample);
+		sample_pending = false;
+	}
+}
+
 static void stats_print(struct stats_record *stats_rec,
 			struct stats_record *stats_prev, struct measurement *m,
 			struct scaling_info *si)
@@ -204,9 +242,13 @@ static void stats_poll(int map_fd, struct freq_info *freq_info)
 	struct measurement m = { 0 };
 	struct scaling_info si = { 0 };
 	struct last_stream_settings lss = { 0 };
+	struct ffpp_lcore_cycles cycles_prev = { 0 }, cycles;
 
-	m.lcore = rte_lcore_id();
+	m.lcore = CORE_OFFSET;
 	m.min_cnts = NUM_READINGS_SMA;
+	if (cycle_stats != NULL) {
+		ffpp_cycle_stats_read(cycle_stats, m.lcore, &cycles_prev);
+	}
 	m.had_first_packet = false;
 	si.up_trend = false; /// Do we have to set them to false explicitly?
 	si.down_trend = false;
@@ -236,15 +278,21 @@ static void stats_poll(int map_fd, struct freq_info *freq_info)
 			m.valid_vals = -1;
 		}
 		if (m.had_first_packet) {
-			// g_csv_freq[g_csv_num_val - 1] = freq_info->freq;
 			collect_global_stats(freq_info, &m, &si);
 		}
 		// if (m.cnt > 0 && m.had_first_packet) {
 		// The first meas
 		if (m.valid_vals > 0) {
-			get_cpu_utilization(&m, freq_info);
-			g_csv_cpu_util[g_csv_num_val - 1] = m.cpu_util[m.idx];
-			// g_csv_freq[g_csv_num_val - 1] = freq_info->freq;
+			if (cycle_stats != NULL) {
+				ffpp_cycle_stats_read(cycle_stats, m.lcore,
+						      &cycles);
+				get_cpu_utilization_cycles(&m, &cycles_prev,
+							   &cycles);
+				cycles_prev = cycles;
+			} else {
+				get_cpu_utilization(&m, freq_info);
+			}
+			sample.cpu_util = m.cpu_util[m.idx];
 			// }
 			// if (m.valid_vals > 1) {
 			calc_sma(&m);
@@ -286,11 +334,42 @@ static void stats_poll(int map_fd, struct freq_info *freq_info)
 		} else {
 			usleep(IDLE_INTERVAL);
 		}
+		log_sample();
 		set_system_pstate(1);
 		printf("\n");
 	}
 }
 
+/*
+ * Initialize the EAL as a secondary process of the ffpp process with the given
+ * file prefix. The EAL pins the calling thread to the CPU of the main lcore,
+ * so the CPU affinity is restored afterwards.
+ */
+static int eal_attach(const char *file_prefix)
+{
+	char prog[] = "ffpp_manager";
+	char no_pci[] = "--no-pci";
+	char proc_type[] = "--proc-type=secondary";
+	char prefix_arg[PATH_MAX];
+	char log_level[] = "--log-level=3";
+	// All lcores stay enabled for rte_lcore_is_enabled().
+	char *eal_args[] = { prog, no_pci, proc_type, prefix_arg, log_level };
+	cpu_set_t cpus;
+
+	snprintf(prefix_arg, sizeof(prefix_arg), "--file-prefix=%s",
+		 file_prefix);
+	if (sched_getaffinity(0, sizeof(cpus), &cpus) != 0) {
+		return -1;
+	}
+	if (rte_eal_init(RTE_DIM(eal_args), eal_args) < 0) {
+		fprintf(stderr, "WARN: Can not attach to the ffpp process %s\n",
+			file_prefix);
+		return -1;
+	}
+	sched_setaffinity(0, sizeof(cpus), &cpus);
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	if (argc < 1) {
@@ -384,6 +463,36 @@ int main(int argc, char *argv[])
 	printf("Scale frequency of system CPU up to maximum.\n");
 	set_system_pstate(1);
 
+	struct ffpp_logger_config log_cfg = {
+		.path = argc >= 3 ? argv[2] : log_path_default,
+		.name = "c1_manager",
+		.fields = pm_fields,
+		.nb_fields = RTE_DIM(pm_fields),
+		.record_size = sizeof(struct pm_record),
+	};
+	struct ffpp_logger *logger = ffpp_logger_create(&log_cfg);
+	if (logger == NULL) {
+		fprintf(stderr, "ERR: Can not create the log file: %s\n",
+			log_cfg.path);
+		return EXIT_FAILURE;
+	}
+	pm_log = ffpp_logger_add_producer(logger);
+	if (pm_log == NULL) {
+		fprintf(stderr, "ERR: Can not add the log producer.\n");
+		ffpp_logger_free(logger);
+		return EXIT_FAILURE;
+	}
+	printf("Measurements are logged to: %s\n", log_cfg.path);
+
+	// Measure the VNF's busy cycles instead of estimating them
+	const char *cycle_stats_prefix = getenv("FFPP_CYCLE_STATS_PREFIX");
+	if (cycle_stats_prefix != NULL && eal_attach(cycle_stats_prefix) == 0) {
+		cycle_stats = attach_cycle_stats();
+		if (cycle_stats == NULL) {
+			rte_eal_cleanup();
+		}
+	}
+
 	// Print stats from xdp_stats_map
 	printf("Collecting stats from BPF map:\n");
 	freq_info.pstate = rte_power_get_freq(CORE_OFFSET);
@@ -394,6 +503,11 @@ int main(int argc, char *argv[])
 	/// Get PID with ffpp_power and the simply kill PID
 	exit_power_library();
 	exit_power_library_on_system();
+	// Convert with scripts/ffpp_log_convert.py
+	ffpp_logger_free(logger);
+	if (cycle_stats != NULL) {
+		rte_eal_cleanup();
+	}
 	printf("\nBye..\n");
 	return 0;
 }
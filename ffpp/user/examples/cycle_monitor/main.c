@@ -0,0 +1,97 @@
+/*
+ * main.c
+ *
+ * About: Print the busy fraction of each ffpp worker lcore once per interval.
+ *        Runs as a DPDK secondary process of a ffpp application that uses the
+ *        worker runtime (task.h), like an external power manager would.
+ */
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_lcore.h>
+
+#include <ffpp/cycle_stats.h>
+
+static volatile bool force_quit = false;
+static uint32_t interval_ms = 1000;
+
+static void signal_handler(int signum)
+{
+	if (signum == SIGINT || signum == SIGTERM) {
+		force_quit = true;
+	}
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int opt = 0;
+
+	while ((opt = getopt(argc, argv, "i:h")) != -1) {
+		switch (opt) {
+		case 'i':
+			interval_ms = atoi(optarg);
+			break;
+		default:
+			printf("Usage: ffpp_cycle_monitor [EAL options] -- "
+			       "[-i INTERVAL_MS]\n");
+			rte_exit(EXIT_FAILURE, "Can not parse arguments!\n");
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static struct ffpp_lcore_cycles prev[RTE_MAX_LCORE];
+	struct ffpp_lcore_cycles cur;
+	struct ffpp_cycle_stats *cs;
+	unsigned int lcore_id;
+	uint64_t polls;
+	int ret;
+
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	argc -= ret;
+	argv += ret;
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+	parse_args(argc, argv);
+
+	cs = ffpp_cycle_stats_attach();
+	if (cs == NULL) {
+		rte_exit(EXIT_FAILURE,
+			 "No cycle stats found, is the ffpp application running?\n");
+	}
+	for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; ++lcore_id) {
+		ffpp_cycle_stats_read(cs, lcore_id, &prev[lcore_id]);
+	}
+
+	printf("lcore,busy_ratio,idle_cycles,proc_cycles,tx_cycles,polls\n");
+	while (!force_quit) {
+		rte_delay_ms(interval_ms);
+		for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; ++lcore_id) {
+			ffpp_cycle_stats_read(cs, lcore_id, &cur);
+			if (!cur.active) {
+				continue;
+			}
+			polls = (cur.empty_polls - prev[lcore_id].empty_polls) +
+				(cur.busy_polls - prev[lcore_id].busy_polls);
+			printf("%u,%.3f,%lu,%lu,%lu,%lu\n", lcore_id,
+			       ffpp_cycle_stats_busy_ratio(&prev[lcore_id], &cur),
+			       cur.idle_cycles - prev[lcore_id].idle_cycles,
+			       cur.proc_cycles - prev[lcore_id].proc_cycles,
+			       cur.tx_cycles - prev[lcore_id].tx_cycles, polls);
+			prev[lcore_id] = cur;
+		}
+		fflush(stdout);
+	}
+
+	rte_eal_cleanup();
+	return 0;
+}
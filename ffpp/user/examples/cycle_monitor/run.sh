@@ -0,0 +1,17 @@
+#!/bin/bash
+# About: Attach to a running ffpp application as secondary process and print the busy fraction of its worker lcores.
+#
+# Usage: ./run.sh FILE_PREFIX [-i INTERVAL_MS]
+#
+
+if [[ ! -f "../../build/examples/ffpp_cycle_monitor" ]]; then
+    echo "ERR: Can not find the built ffpp_cycle_monitor executable."
+    echo "Please run 'make examples' in the ffpp/user folder."
+    exit 1
+fi
+
+FILE_PREFIX=${1:-rte}
+shift
+
+EAL_OPTS="-l 0 --proc-type secondary --no-pci --file-prefix=$FILE_PREFIX --log-level=3"
+../../build/examples/ffpp_cycle_monitor $EAL_OPTS -- "$@"
@@ -29,6 +29,7 @@
 #include <ffpp/scaling_defines_user.h>
 #include <ffpp/general_helpers_user.h>
 #include <ffpp/global_stats_user.h>
+#include <ffpp/logger.h>
 #include <math.h>
 
 // supress prints
@@ -38,13 +39,7 @@
 
 static volatile bool force_quit;
 
-// Gloabl measuremnt arrays
-double g_csv_in_pps[TOTAL_VALS];
-double g_csv_out_pps[TOTAL_VALS];
-double g_csv_ts[TOTAL_VALS];
-unsigned int g_csv_freq[TOTAL_VALS];
-int g_csv_out_delta[TOTAL_VALS];
-int g_csv_offset[TOTAL_VALS];
+// Session counters of the measurements
 unsigned int g_csv_num_val = 0;
 int g_csv_num_round = 0;
 int g_csv_empty_cnt = 0;
@@ -52,6 +47,31 @@ int g_csv_empty_cnt_threshold = (3 * 1e6) / IDLE_INTERVAL;
 bool g_csv_saved_stream = false;
 
 const char *pin_basedir = "/sys/fs/bpf";
+// Relative to the working directory, the third argument overrides it.
+const char *log_path_default = "feedback_manager.ffpplog";
+
+// One record per interval, sessions are separated by the round.
+struct fb_record {
+	double ts;
+	double in_pps;
+	double out_pps;
+	int32_t out_delta;
+	int32_t offset;
+	uint32_t freq;
+	uint32_t round;
+};
+
+static const struct ffpp_log_field fb_fields[] = {
+	FFPP_LOG_FIELD(FFPP_LOG_F64, struct fb_record, ts),
+	FFPP_LOG_FIELD(FFPP_LOG_F64, struct fb_record, in_pps),
+	FFPP_LOG_FIELD(FFPP_LOG_F64, struct fb_record, out_pps),
+	FFPP_LOG_FIELD(FFPP_LOG_I32, struct fb_record, out_delta),
+	FFPP_LOG_FIELD(FFPP_LOG_I32, struct fb_record, offset),
+	FFPP_LOG_FIELD(FFPP_LOG_U32, struct fb_record, freq),
+	FFPP_LOG_FIELD(FFPP_LOG_U32, struct fb_record, round),
+};
+
+static struct ffpp_log_producer *fb_log;
 
 static void signal_handler(int signum)
 {
@@ -155,14 +175,18 @@ collect_global_stats(struct traffic_stats *ts, struct freq_info *f,
 		     __attribute__((unused)) struct scaling_info *si)
 {
 	if (m->had_first_packet) {
-		g_csv_ts[g_csv_num_val] = get_time_of_day();
-		// Ingress
-		g_csv_in_pps[g_csv_num_val] = ts[0].pps;
-		g_csv_freq[g_csv_num_val] = f->freq;
-		// Egress
-		g_csv_out_pps[g_csv_num_val] = ts[1].pps;
-		g_csv_out_delta[g_csv_num_val] = fb->delta_packets;
-		g_csv_offset[g_csv_num_val] = fb->packet_offset;
+		struct fb_record r = {
+			.ts = get_time_of_day(),
+			// Ingress
+			.in_pps = ts[0].pps,
+			.freq = f->freq,
+			// Egress
+			.out_pps = ts[1].pps,
+			.out_delta = fb->delta_packets,
+			.offset = fb->packet_offset,
+			.round = g_csv_num_round,
+		};
+		ffpp_log_write(fb_log, &r);
 		g_csv_num_val++;
 		if (ts[0].delta_packets > 0) {
 			g_csv_empty_cnt = 0;
@@ -171,7 +195,7 @@ collect_global_stats(struct traffic_stats *ts, struct freq_info *f,
 				g_csv_empty_cnt += 1;
 			}
 			if (g_csv_empty_cnt > g_csv_empty_cnt_threshold) {
-				write_csv_file_fb_in();
+				// The samples are written by the logger thread.
 				g_csv_saved_stream = true;
 				g_csv_empty_cnt = 0;
 				g_csv_num_val = 0;
@@ -308,7 +332,7 @@ static void stats_poll(int *stats_map_fd, struct freq_info *freq_info)
 
 int main(int argc, char *argv[])
 {
-	if (argc < 2) {
+	if (argc < 3) {
 		fprintf(stderr,
 			"Please supply ingress and egress interface names, resepectively");
 		return -1;
@@ -404,6 +428,27 @@ int main(int argc, char *argv[])
 	printf("Scale frequency of system CPU up to maximum.\n");
 	set_system_pstate(1);
 
+	struct ffpp_logger_config log_cfg = {
+		.path = argc >= 4 ? argv[3] : log_path_default,
+		.name = "feedback_manager",
+		.fields = fb_fields,
+		.nb_fields = RTE_DIM(fb_fields),
+		.record_size = sizeof(struct fb_record),
+	};
+	struct ffpp_logger *logger = ffpp_logger_create(&log_cfg);
+	if (logger == NULL) {
+		fprintf(stderr, "ERR: Can not create the log file: %s\n",
+			log_cfg.path);
+		return EXIT_FAILURE;
+	}
+	fb_log = ffpp_logger_add_producer(logger);
+	if (fb_log == NULL) {
+		fprintf(stderr, "ERR: Can not add the log producer.\n");
+		ffpp_logger_free(logger);
+		return EXIT_FAILURE;
+	}
+	printf("Measurements are logged to: %s\n", log_cfg.path);
+
 	// Start eBPF map polling and scaling
 	printf("Collecting stats from BPF map:\n");
 	freq_info.pstate = rte_power_get_freq(CORE_OFFSET);
@@ -414,6 +459,8 @@ int main(int argc, char *argv[])
 	/// Get PID with ffpp_power and the simply kill PID
 	exit_power_library();
 	exit_power_library_on_system();
+	// Convert with scripts/ffpp_log_convert.py
+	ffpp_logger_free(logger);
 	printf("\nBye..\n");
 	return 0;
 }
@@ -18,6 +18,7 @@
 #include <ffpp/collections.h>
 #include <ffpp/config.h>
 #include <ffpp/general_helpers_user.h>
+#include <ffpp/histogram.h>
 #include <ffpp/munf.h>
 #include <ffpp/packet_processors.h>
 
@@ -28,6 +29,8 @@ static bool TEST_MODE = false;
 static volatile bool force_quit = false;
 
 static struct rte_ether_addr tx_port_addr;
+// Cycles of a burst from the enqueue to the MuNF until its dequeue.
+static struct ffpp_hist rtt_hist;
 
 static void signal_handler(int signum)
 {
@@ -68,6 +71,7 @@ static void run_mainloop(const struct ffpp_munf_manager *ctx,
 	struct rte_mbuf *rx_buf[BURST_SIZE];
 	struct rte_mbuf *tx_buf[BURST_SIZE];
 	uint16_t nb_rx, nb_tx;
+	uint64_t start;
 
 	struct ffpp_mvec vec;
 	ffpp_mvec_init(&vec, BURST_SIZE);
@@ -89,6 +93,7 @@ static void run_mainloop(const struct ffpp_munf_manager *ctx,
 			continue;
 		}
 		RTE_LOG(DEBUG, FFPP, "Receive %u packets!\n", nb_rx);
+		start = rte_rdtsc();
 		run_enqueue_loop(rx_buf, rx_ring);
 		// TODO: Implement the basic scaling here based on the enqueue
 		// statistics.
@@ -102,9 +107,12 @@ static void run_mainloop(const struct ffpp_munf_manager *ctx,
 		}
 
 		run_dequeue_loop(tx_buf, tx_ring);
+		if (likely(!force_quit)) {
+			ffpp_hist_record(&rtt_hist, rte_rdtsc() - start);
+		}
 
 		ffpp_mvec_set_mbufs(&vec, rx_buf, nb_rx);
-		ffpp_pp_update_dl_dst(&vec, &tx_port_addr);
+		ffpp_pp_update_dl_src(&vec, &tx_port_addr);
 		// No buffering is used like l2fwd.
 		rte_eth_tx_burst(ctx->tx_port_id, 0, rx_buf, nb_rx);
 		RTE_LOG(DEBUG, FFPP, "Finish one RX/TX round!\n");
@@ -136,7 +144,10 @@ int main(int argc, char *argv[])
 	struct ffpp_munf_data munf_data;
 	ffpp_munf_register("munf_1", &munf_data);
 
+	ffpp_hist_init(&rtt_hist);
 	run_mainloop(&munf_manager, &munf_data);
+	printf("name,bursts,mean_us,min_us,p50_us,p99_us,p999_us,max_us\n");
+	ffpp_hist_print(stdout, "munf_rtt", &rtt_hist, rte_get_tsc_hz());
 
 	ffpp_munf_unregister("munf_1");
 	ffpp_munf_cleanup_manager(&munf_manager);
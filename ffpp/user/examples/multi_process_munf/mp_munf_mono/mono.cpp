@@ -19,6 +19,7 @@
 #include <ffpp/collections.h>
 #include <ffpp/config.h>
 #include <ffpp/general_helpers_user.h>
+#include <ffpp/histogram.h>
 #include <ffpp/munf.h>
 #include <ffpp/packet_processors.h>
 
@@ -29,6 +30,8 @@ static volatile bool force_quit = false;
 static struct rte_ether_addr tx_port_addr;
 
 static int func_num = 0;
+// Cycles of the function per burst.
+static struct ffpp_hist proc_hist;
 
 static uint8_t aes_key[] = { 0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe,
 			     0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
@@ -36,6 +39,8 @@ static uint8_t aes_key[] = { 0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe,
 			     0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4 };
 static uint8_t aes_iv[] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
 			    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+// Round keys of aes_key, expanded once in main().
+static struct AES_ctx aes_ctx;
 
 static void signal_handler(int signum)
 {
@@ -46,7 +51,7 @@ static void signal_handler(int signum)
 
 static void run_update_dl_dst(struct ffpp_mvec *vec)
 {
-	ffpp_pp_update_dl_dst(vec, &tx_port_addr);
+	ffpp_pp_update_dl_src(vec, &tx_port_addr);
 }
 
 static void run_l2_xor(struct ffpp_mvec *vec)
@@ -74,15 +79,14 @@ static void run_l2_aes(struct ffpp_mvec *vec)
 	struct rte_ether_hdr *eth;
 	const uint8_t xor_val = 17;
 	uint8_t *data;
-	struct AES_ctx aes_ctx;
 
 	FFPP_MVEC_FOREACH(vec, i, m)
 	{
 		rte_prefetch0(rte_pktmbuf_mtod(m, void *));
 		data = rte_pktmbuf_mtod(m, uint8_t *);
-		AES_init_ctx_iv(&aes_ctx, aes_key, aes_iv);
+		AES_ctx_set_iv(&aes_ctx, aes_iv);
 		AES_CBC_encrypt_buffer(&aes_ctx, data, 1500);
-		AES_init_ctx_iv(&aes_ctx, aes_key, aes_iv);
+		AES_ctx_set_iv(&aes_ctx, aes_iv);
 		AES_CBC_decrypt_buffer(&aes_ctx, data, 1500);
 	}
 }
@@ -91,6 +95,7 @@ void run_mainloop(const struct ffpp_munf_manager *ctx)
 {
 	struct rte_mbuf *pkt_burst[BURST_SIZE];
 	uint16_t nb_rx, nb_tx;
+	uint64_t start;
 
 	struct ffpp_mvec vec;
 	ffpp_mvec_init(&vec, BURST_SIZE);
@@ -104,6 +109,7 @@ void run_mainloop(const struct ffpp_munf_manager *ctx)
 		}
 		ffpp_mvec_set_mbufs(&vec, pkt_burst, nb_rx);
 
+		start = rte_rdtsc();
 		switch (func_num) {
 		case 0:
 			run_update_dl_dst(&vec);
@@ -120,6 +126,7 @@ void run_mainloop(const struct ffpp_munf_manager *ctx)
 		default:
 			rte_exit(EXIT_FAILURE, "Unknown function type!\n");
 		}
+		ffpp_hist_record(&proc_hist, rte_rdtsc() - start);
 
 		// No buffering is used like l2fwd.
 		rte_eth_tx_burst(ctx->tx_port_id, 0, pkt_burst, nb_rx);
@@ -154,6 +161,7 @@ int main(int argc, char *argv[])
 	signal(SIGINT, signal_handler);
 	signal(SIGTERM, signal_handler);
 	parse_args(argc, argv);
+	AES_init_ctx(&aes_ctx, aes_key);
 	printf("The function number: %d\n", func_num);
 
 	struct ffpp_munf_manager munf_manager;
@@ -164,7 +172,10 @@ int main(int argc, char *argv[])
 		rte_exit(EXIT_FAILURE, "Cannot get the MAC address.\n");
 	}
 
+	ffpp_hist_init(&proc_hist);
 	run_mainloop(&munf_manager);
+	printf("name,bursts,mean_us,min_us,p50_us,p99_us,p999_us,max_us\n");
+	ffpp_hist_print(stdout, "mono_proc", &proc_hist, rte_get_tsc_hz());
 
 	ffpp_munf_cleanup_manager(&munf_manager);
 	rte_eal_cleanup();
@@ -19,6 +19,7 @@
 #include <ffpp/collections.h>
 #include <ffpp/config.h>
 #include <ffpp/general_helpers_user.h>
+#include <ffpp/histogram.h>
 #include <ffpp/munf.h>
 #include <ffpp/packet_processors.h>
 
@@ -29,6 +30,8 @@ static bool TEST_MODE = false;
 static volatile bool force_quit = false;
 
 static int func_num = 0;
+// Cycles of the function per burst.
+static struct ffpp_hist proc_hist;
 
 static uint8_t aes_key[] = { 0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe,
 			     0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
@@ -36,6 +39,8 @@ static uint8_t aes_key[] = { 0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe,
 			     0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4 };
 static uint8_t aes_iv[] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
 			    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+// Round keys of aes_key, expanded once in main().
+static struct AES_ctx aes_ctx;
 
 static void signal_handler(int signum)
 {
@@ -95,15 +100,14 @@ static void run_l2_aes(struct ffpp_mvec *vec)
 	struct rte_ether_hdr *eth;
 	const uint8_t xor_val = 17;
 	uint8_t *data;
-	struct AES_ctx aes_ctx;
 
 	FFPP_MVEC_FOREACH(vec, i, m)
 	{
 		rte_prefetch0(rte_pktmbuf_mtod(m, void *));
 		data = rte_pktmbuf_mtod(m, uint8_t *);
-		AES_init_ctx_iv(&aes_ctx, aes_key, aes_iv);
+		AES_ctx_set_iv(&aes_ctx, aes_iv);
 		AES_CBC_encrypt_buffer(&aes_ctx, data, 1500);
-		AES_init_ctx_iv(&aes_ctx, aes_key, aes_iv);
+		AES_ctx_set_iv(&aes_ctx, aes_iv);
 		AES_CBC_decrypt_buffer(&aes_ctx, data, 1500);
 	}
 }
@@ -127,6 +131,7 @@ void run_mainloop(struct rte_ring *rx_ring, struct rte_ring *tx_ring)
 {
 	struct rte_mbuf *buf[BURST_SIZE];
 	uint16_t nb_rx, nb_tx;
+	uint64_t start;
 
 	struct ffpp_mvec vec;
 	ffpp_mvec_init(&vec, BURST_SIZE);
@@ -137,6 +142,7 @@ void run_mainloop(struct rte_ring *rx_ring, struct rte_ring *tx_ring)
 
 		ffpp_mvec_set_mbufs(&vec, buf, BURST_SIZE);
 
+		start = rte_rdtsc();
 		switch (func_num) {
 		case 0:
 			break;
@@ -150,6 +156,7 @@ void run_mainloop(struct rte_ring *rx_ring, struct rte_ring *tx_ring)
 		default:
 			rte_exit(EXIT_FAILURE, "Unknown function type!\n");
 		}
+		ffpp_hist_record(&proc_hist, rte_rdtsc() - start);
 
 		run_enqueue_loop(buf, tx_ring);
 	}
@@ -168,6 +175,7 @@ int main(int argc, char *argv[])
 	signal(SIGINT, signal_handler);
 	signal(SIGTERM, signal_handler);
 	parse_args(argc, argv);
+	AES_init_ctx(&aes_ctx, aes_key);
 
 	// Ring names are currently hard-coded.
 	struct rte_ring *rx_ring = rte_ring_lookup("munf_1_rx_ring");
@@ -177,7 +185,10 @@ int main(int argc, char *argv[])
 		rte_exit(EXIT_FAILURE, "Can not find the RX or TX ring!\n");
 	}
 
+	ffpp_hist_init(&proc_hist);
 	run_mainloop(rx_ring, tx_ring);
+	printf("name,bursts,mean_us,min_us,p50_us,p99_us,p999_us,max_us\n");
+	ffpp_hist_print(stdout, "munf_proc", &proc_hist, rte_get_tsc_hz());
 
 	rte_eal_cleanup();
 	return 0;
@@ -0,0 +1,390 @@
+/*
+ * main.c
+ *
+ * About: Two-stage MuNF chain used to compare the inter-MuNF transports.
+ *
+ *        - vhost: The head creates a vhost-user port, the tail connects to it
+ *          with a virtio-user port. Both run their own EAL.
+ *        - ring: The head (primary) creates rte_rings in shared hugepages, the
+ *          tail attaches to them as a secondary process.
+ *
+ *        The head forwards packets from the first EAL port (e.g. net_null) to
+ *        the chain, the tail counts and drops them. Queue i is handled by the
+ *        i-th worker lcore on both sides.
+ *
+ *        With -l, the head writes its TSC into the first 8 bytes of each
+ *        frame and the tail records the one-way latency of the chain into a
+ *        histogram per lcore, the processes share the TSC of the host.
+ */
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_ethdev.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_ring.h>
+#include <rte_string_fns.h>
+
+#include <ffpp/config.h>
+#include <ffpp/device.h>
+#include <ffpp/histogram.h>
+#include <ffpp/memory.h>
+
+#define BURST_SIZE 32
+#define NB_MBUFS_PER_QUEUE 8192
+#define RING_SIZE 1024
+#define RING_NAME_FMT "munf_chain_ring_%u"
+
+enum chain_role { ROLE_HEAD = 0, ROLE_TAIL };
+enum chain_transport { TRANSPORT_VHOST = 0, TRANSPORT_RING };
+
+static volatile bool force_quit = false;
+
+static enum chain_role role = ROLE_HEAD;
+static enum chain_transport transport = TRANSPORT_VHOST;
+static char socket_path[FFPP_VHOST_PATH_MAX] = "/tmp/munf_chain.sock";
+static uint16_t nb_queues = 1;
+static uint32_t duration_s = 10;
+static bool mrg_rxbuf = true;
+static bool record_latency = false;
+
+static uint16_t in_port_id = 0;
+static uint16_t chain_port_id;
+static struct rte_ring *rings[FFPP_MAX_QUEUES_PER_PORT];
+// One cache line per lcore, so the tail lcores do not share the counters.
+struct lcore_stats {
+	uint64_t rx_pkts;
+	struct ffpp_hist *latency; /**< Only with -l */
+} __rte_cache_aligned;
+
+static struct lcore_stats lcore_stats[RTE_MAX_LCORE];
+
+static void signal_handler(int signum)
+{
+	if (signum == SIGINT || signum == SIGTERM) {
+		force_quit = true;
+	}
+}
+
+static uint16_t chain_send(uint16_t q, struct rte_mbuf **pkts, uint16_t n)
+{
+	if (transport == TRANSPORT_VHOST) {
+		return rte_eth_tx_burst(chain_port_id, q, pkts, n);
+	}
+	return rte_ring_sp_enqueue_burst(rings[q], (void **)pkts, n, NULL);
+}
+
+static uint16_t chain_recv(uint16_t q, struct rte_mbuf **pkts, uint16_t n)
+{
+	if (transport == TRANSPORT_VHOST) {
+		return rte_eth_rx_burst(chain_port_id, q, pkts, n);
+	}
+	return rte_ring_sc_dequeue_burst(rings[q], (void **)pkts, n, NULL);
+}
+
+static void stamp_tsc(struct rte_mbuf **pkts, uint16_t n)
+{
+	uint64_t now = rte_rdtsc();
+	uint16_t i;
+
+	for (i = 0; i < n; ++i) {
+		if (rte_pktmbuf_data_len(pkts[i]) >= sizeof(now)) {
+			*rte_pktmbuf_mtod(pkts[i], uint64_t *) = now;
+		}
+	}
+}
+
+static void record_tsc(struct ffpp_hist *h, struct rte_mbuf **pkts,
+		       uint16_t n)
+{
+	uint64_t now = rte_rdtsc();
+	uint16_t i;
+
+	for (i = 0; i < n; ++i) {
+		if (rte_pktmbuf_data_len(pkts[i]) >= sizeof(now)) {
+			ffpp_hist_record(
+				h, now - *rte_pktmbuf_mtod(pkts[i], uint64_t *));
+		}
+	}
+}
+
+static int run_head(void *arg)
+{
+	uint16_t q = (uint16_t)(uintptr_t)arg;
+	struct rte_mbuf *pkts[BURST_SIZE];
+	uint16_t nb_rx, nb_tx;
+
+	while (!force_quit) {
+		nb_rx = rte_eth_rx_burst(in_port_id, q, pkts, BURST_SIZE);
+		if (nb_rx == 0) {
+			continue;
+		}
+		if (record_latency) {
+			stamp_tsc(pkts, nb_rx);
+		}
+		nb_tx = chain_send(q, pkts, nb_rx);
+		if (unlikely(nb_tx < nb_rx)) {
+			rte_pktmbuf_free_bulk(pkts + nb_tx, nb_rx - nb_tx);
+		}
+	}
+	return 0;
+}
+
+static int run_tail(void *arg)
+{
+	uint16_t q = (uint16_t)(uintptr_t)arg;
+	struct rte_mbuf *pkts[BURST_SIZE];
+	uint16_t nb_rx;
+	unsigned int lcore_id = rte_lcore_id();
+
+	while (!force_quit) {
+		nb_rx = chain_recv(q, pkts, BURST_SIZE);
+		if (nb_rx == 0) {
+			continue;
+		}
+		lcore_stats[lcore_id].rx_pkts += nb_rx;
+		if (record_latency) {
+			record_tsc(lcore_stats[lcore_id].latency, pkts, nb_rx);
+		}
+		rte_pktmbuf_free_bulk(pkts, nb_rx);
+	}
+	return 0;
+}
+
+static void init_vhost_port(struct rte_mempool *pool)
+{
+	struct ffpp_dpdk_device_config cfg = {
+		.pool = &pool,
+		.rx_queues = nb_queues,
+		.tx_queues = nb_queues,
+		.rx_descs = 1024,
+		.tx_descs = 1024,
+		.drop_enabled = 1,
+		.disable_offloads = 1,
+	};
+	rte_strscpy(cfg.vhost.path, socket_path, sizeof(cfg.vhost.path));
+	if (role == ROLE_HEAD) {
+		cfg.type = FFPP_DPDK_DEVICE_VHOST_USER;
+		cfg.vhost.server = true;
+	} else {
+		cfg.type = FFPP_DPDK_DEVICE_VIRTIO_USER;
+		cfg.vhost.server = false;
+		cfg.vhost.mrg_rxbuf = mrg_rxbuf;
+	}
+	ffpp_dpdk_init_device(&cfg);
+	chain_port_id = cfg.port_id;
+}
+
+static void init_rings(void)
+{
+	char name[RTE_RING_NAMESIZE];
+	uint16_t q;
+
+	for (q = 0; q < nb_queues; ++q) {
+		snprintf(name, sizeof(name), RING_NAME_FMT, q);
+		if (role == ROLE_HEAD) {
+			rings[q] = rte_ring_create(name, RING_SIZE,
+						   rte_socket_id(),
+						   RING_F_SP_ENQ | RING_F_SC_DEQ);
+		} else {
+			rings[q] = rte_ring_lookup(name);
+		}
+		if (rings[q] == NULL) {
+			rte_exit(EXIT_FAILURE, "Can not get ring: %s\n", name);
+		}
+	}
+}
+
+static void report(void)
+{
+	uint64_t last = 0;
+	uint32_t t;
+	unsigned int lcore_id;
+
+	printf("second,mpps\n");
+	for (t = 0; t < duration_s && !force_quit; ++t) {
+		uint64_t total = 0;
+		rte_delay_ms(1000);
+		RTE_LCORE_FOREACH_WORKER(lcore_id)
+		{
+			total += lcore_stats[lcore_id].rx_pkts;
+		}
+		printf("%u,%.3f\n", t, (double)(total - last) / 1e6);
+		fflush(stdout);
+		last = total;
+	}
+	force_quit = true;
+}
+
+static void report_latency(void)
+{
+	struct ffpp_hist total;
+	unsigned int lcore_id;
+	char name[16];
+
+	ffpp_hist_init(&total);
+	printf("lcore,packets,mean_us,min_us,p50_us,p99_us,p999_us,max_us\n");
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		if (lcore_stats[lcore_id].latency == NULL) {
+			continue;
+		}
+		snprintf(name, sizeof(name), "%u", lcore_id);
+		ffpp_hist_print(stdout, name, lcore_stats[lcore_id].latency,
+				rte_get_tsc_hz());
+		ffpp_hist_merge(&total, lcore_stats[lcore_id].latency);
+		ffpp_hist_free(lcore_stats[lcore_id].latency);
+		lcore_stats[lcore_id].latency = NULL;
+	}
+	ffpp_hist_print(stdout, "all", &total, rte_get_tsc_hz());
+}
+
+static void usage(void)
+{
+	printf("Usage: ffpp_munf_chain [EAL options] -- -r head|tail "
+	       "[-t vhost|ring] [-s SOCKET] [-q QUEUES] [-d DURATION] [-n] "
+	       "[-l]\n"
+	       "  -n: Disable mergeable RX buffers of the virtio-user port.\n"
+	       "  -l: Record the latency of the chain, on head and tail.\n");
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int opt = 0;
+
+	while ((opt = getopt(argc, argv, "r:t:s:q:d:nlh")) != -1) {
+		switch (opt) {
+		case 'r':
+			role = strcmp(optarg, "tail") == 0 ? ROLE_TAIL :
+								   ROLE_HEAD;
+			break;
+		case 't':
+			transport = strcmp(optarg, "ring") == 0 ?
+						  TRANSPORT_RING :
+						  TRANSPORT_VHOST;
+			break;
+		case 's':
+			rte_strscpy(socket_path, optarg, sizeof(socket_path));
+			break;
+		case 'q':
+			nb_queues = atoi(optarg);
+			break;
+		case 'd':
+			duration_s = atoi(optarg);
+			break;
+		case 'n':
+			mrg_rxbuf = false;
+			break;
+		case 'l':
+			record_latency = true;
+			break;
+		default:
+			usage();
+			rte_exit(EXIT_FAILURE, "Can not parse arguments!\n");
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct rte_mempool *pool = NULL;
+	unsigned int lcore_id;
+	uint16_t q = 0;
+	int ret;
+
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	argc -= ret;
+	argv += ret;
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+	parse_args(argc, argv);
+
+	if (nb_queues == 0 || nb_queues > FFPP_MAX_QUEUES_PER_PORT ||
+	    rte_lcore_count() < (unsigned int)nb_queues + 1) {
+		rte_exit(EXIT_FAILURE,
+			 "One worker lcore is required for each queue.\n");
+	}
+
+	// The tail of the ring transport uses the pool of the head.
+	if (!(transport == TRANSPORT_RING && role == ROLE_TAIL)) {
+		pool = ffpp_init_mempool(role == ROLE_HEAD ? "chain_head" :
+								   "chain_tail",
+					 NB_MBUFS_PER_QUEUE * nb_queues,
+					 RTE_MBUF_DEFAULT_BUF_SIZE,
+					 rte_socket_id());
+		if (pool == NULL) {
+			rte_exit(EXIT_FAILURE, "Can not init the memory pool.\n");
+		}
+	}
+
+	if (role == ROLE_HEAD) {
+		struct ffpp_dpdk_device_config in_cfg = {
+			.port_id = in_port_id,
+			.pool = &pool,
+			.rx_queues = nb_queues,
+			.tx_queues = nb_queues,
+			.rx_descs = 1024,
+			.tx_descs = 1024,
+			.drop_enabled = 1,
+			.disable_offloads = 1,
+			.type = FFPP_DPDK_DEVICE_ETHDEV,
+		};
+		ffpp_dpdk_init_device(&in_cfg);
+	}
+	if (transport == TRANSPORT_VHOST) {
+		init_vhost_port(pool);
+	} else {
+		init_rings();
+	}
+
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		if (q == nb_queues) {
+			break;
+		}
+		if (role == ROLE_TAIL && record_latency) {
+			lcore_stats[lcore_id].latency = ffpp_hist_create(
+				rte_lcore_to_socket_id(lcore_id));
+			if (lcore_stats[lcore_id].latency == NULL) {
+				rte_exit(EXIT_FAILURE,
+					 "Can not allocate the histograms.\n");
+			}
+		}
+		rte_eal_remote_launch(role == ROLE_HEAD ? run_head : run_tail,
+				      (void *)(uintptr_t)q, lcore_id);
+		q++;
+	}
+
+	if (role == ROLE_TAIL) {
+		report();
+	} else {
+		while (!force_quit) {
+			rte_delay_ms(100);
+		}
+	}
+
+	rte_eal_mp_wait_lcore();
+	if (role == ROLE_TAIL && record_latency) {
+		report_latency();
+	}
+	if (role == ROLE_HEAD || transport == TRANSPORT_VHOST) {
+		ffpp_dpdk_cleanup_devices();
+	}
+	if (transport == TRANSPORT_RING && role == ROLE_HEAD) {
+		for (q = 0; q < nb_queues; ++q) {
+			rte_ring_free(rings[q]);
+		}
+	}
+	rte_eal_cleanup();
+	return 0;
+}
@@ -0,0 +1,36 @@
+#!/bin/bash
+# About: Run one side of the two-stage MuNF chain.
+#
+# Usage: ./run.sh head|tail vhost|ring [extra options of ffpp_munf_chain]
+#
+
+if [[ ! -f "../../build/examples/ffpp_munf_chain" ]]; then
+    echo "ERR: Can not find the built ffpp_munf_chain executable."
+    echo "Please run 'make examples' in the ffpp/user folder."
+    exit 1
+fi
+
+ROLE=${1:-head}
+TRANSPORT=${2:-vhost}
+shift 2
+# Use one more lcore than the number of queues (-q).
+HEAD_LCORES=${HEAD_LCORES:-1,2}
+TAIL_LCORES=${TAIL_LCORES:-3,4}
+
+if [[ $TRANSPORT == "ring" ]]; then
+    # Rings live in the hugepages of the head, the tail must share its EAL.
+    if [[ $ROLE == "head" ]]; then
+        EAL_OPTS="-l $HEAD_LCORES --proc-type primary --no-pci --file-prefix=munf_chain --vdev=net_null0"
+    else
+        EAL_OPTS="-l $TAIL_LCORES --proc-type secondary --no-pci --file-prefix=munf_chain"
+    fi
+else
+    # Each side is an isolated EAL instance, only the socket is shared.
+    if [[ $ROLE == "head" ]]; then
+        EAL_OPTS="-l $HEAD_LCORES --no-pci --in-memory --file-prefix=munf_chain_head --vdev=net_null0"
+    else
+        EAL_OPTS="-l $TAIL_LCORES --no-pci --in-memory --single-file-segments --file-prefix=munf_chain_tail"
+    fi
+fi
+
+../../build/examples/ffpp_munf_chain $EAL_OPTS -- -r "$ROLE" -t "$TRANSPORT" "$@"
@@ -26,6 +26,8 @@
 #include <ffpp/scaling_defines_user.h>
 #include <ffpp/general_helpers_user.h>
 #include <ffpp/global_stats_user.h>
+#include <ffpp/histogram.h>
+#include <ffpp/logger.h>
 
 #ifdef RELEASE
 #define printf(fmt, ...) (0)
@@ -33,11 +35,6 @@
 
 static volatile bool force_quit;
 
-double g_csv_pps[TOTAL_VALS];
-double g_csv_ts[TOTAL_VALS];
-double g_csv_iat[TOTAL_VALS];
-double g_csv_cpu_util[TOTAL_VALS];
-unsigned int g_csv_freq[TOTAL_VALS];
 unsigned int g_csv_num_val = 0;
 int g_csv_num_round = 0;
 int g_csv_empty_cnt = 0;
@@ -45,6 +42,27 @@ int g_csv_empty_cnt_threshold = (3 * 1e6) / INTERVAL;
 bool g_csv_saved_stream = false;
 
 const char *pin_basedir = "/sys/fs/bpf";
+// Relative to the working directory, the third argument overrides it.
+const char *log_path_default = "tm.ffpplog";
+
+// One record per interval, sessions are separated by the round.
+struct tm_record {
+	double ts;
+	double pps;
+	double iat;
+	uint32_t round;
+};
+
+static const struct ffpp_log_field tm_fields[] = {
+	FFPP_LOG_FIELD(FFPP_LOG_F64, struct tm_record, ts),
+	FFPP_LOG_FIELD(FFPP_LOG_F64, struct tm_record, pps),
+	FFPP_LOG_FIELD(FFPP_LOG_F64, struct tm_record, iat),
+	FFPP_LOG_FIELD(FFPP_LOG_U32, struct tm_record, round),
+};
+
+static struct ffpp_log_producer *tm_log;
+// Inter-arrival times of the current session in ns.
+static struct ffpp_hist iat_hist;
 
 static void signal_handler(int signum)
 {
@@ -55,6 +73,31 @@ static void signal_handler(int signum)
 	}
 }
 
+static void log_sample(double pps, double iat)
+{
+	struct tm_record r = {
+		.ts = get_time_of_day(),
+		.pps = pps,
+		.iat = iat,
+		.round = g_csv_num_round,
+	};
+
+	ffpp_log_write(tm_log, &r);
+	g_csv_num_val++;
+}
+
+// Printed with fprintf, printf is disabled in the RELEASE build.
+static void print_iat_hist(void)
+{
+	char name[16];
+
+	snprintf(name, sizeof(name), "%d", g_csv_num_round);
+	fprintf(stdout, "round,samples,mean_ns,min_ns,p50_ns,p99_ns,p999_ns,"
+			"max_ns\n");
+	ffpp_hist_print(stdout, name, &iat_hist, 0);
+	ffpp_hist_reset(&iat_hist);
+}
+
 static void stats_print(struct stats_record *stats_rec,
 			struct stats_record *stats_prev, struct measurement *m,
 			struct scaling_info *si)
@@ -66,26 +109,22 @@ static void stats_print(struct stats_record *stats_rec,
 
 	calc_traffic_stats(m, rec, prev, &t_s, si);
 
-	// Collect stats in global buffers
+	// Log the stats, the logger thread writes them to the file
 	if (t_s.delta_packets > 0) {
 		if (m->had_first_packet) {
-			// Collect stats
-			g_csv_ts[g_csv_num_val] = get_time_of_day();
-			g_csv_pps[g_csv_num_val] = t_s.pps;
-			g_csv_iat[g_csv_num_val] = m->inter_arrival_time;
-			g_csv_num_val++;
+			log_sample(t_s.pps, m->inter_arrival_time);
+			ffpp_hist_record(&iat_hist, m->inter_arrival_time *
+							    NANOSEC_PER_SEC);
 			g_csv_empty_cnt = 0;
 		}
 	} else if (t_s.delta_packets == 0 && m->had_first_packet) {
 		if (!g_csv_saved_stream) {
-			g_csv_ts[g_csv_num_val] = get_time_of_day();
-			g_csv_pps[g_csv_num_val] = t_s.pps;
-			g_csv_iat[g_csv_num_val] = m->inter_arrival_time;
-			g_csv_num_val++;
+			log_sample(t_s.pps, m->inter_arrival_time);
 			g_csv_empty_cnt++;
 		}
 		if (g_csv_empty_cnt >= g_csv_empty_cnt_threshold) {
-			write_csv_file_tm();
+			// The samples are written by the logger thread.
+			print_iat_hist();
 			g_csv_saved_stream = true;
 			g_csv_empty_cnt = 0;
 			g_csv_num_val = 0;
@@ -142,7 +181,7 @@ int main(int argc, char *argv[])
 	signal(SIGTERM, signal_handler);
 
 	int raw_key = 0;
-	if (argc == 3) {
+	if (argc >= 3) {
 		char *ptr;
 		raw_key = strtoul(argv[2], &ptr, 10);
 	}
@@ -187,12 +226,34 @@ int main(int argc, char *argv[])
 	}
 	printf("Successfully open the map file of xdp stats!\n");
 
+	struct ffpp_logger_config log_cfg = {
+		.path = argc >= 4 ? argv[3] : log_path_default,
+		.name = "traffic_monitor",
+		.fields = tm_fields,
+		.nb_fields = RTE_DIM(tm_fields),
+		.record_size = sizeof(struct tm_record),
+	};
+	struct ffpp_logger *logger = ffpp_logger_create(&log_cfg);
+	if (logger == NULL) {
+		fprintf(stderr, "ERR: Can not create the log file: %s\n",
+			log_cfg.path);
+		return EXIT_FAILURE;
+	}
+	tm_log = ffpp_logger_add_producer(logger);
+	if (tm_log == NULL) {
+		fprintf(stderr, "ERR: Can not add the log producer.\n");
+		ffpp_logger_free(logger);
+		return EXIT_FAILURE;
+	}
+	printf("Measurements are logged to: %s\n", log_cfg.path);
+	ffpp_hist_init(&iat_hist);
+
 	// Print stats from xdp_stats_map
 	printf("Collecting stats from BPF map:\n");
 	stats_poll(xdp_stats_map_fd, raw_key);
 
-	/// Save global stats here --> less signaling between single sessions
-	/// Get PID with ffpp_power and the simply kill PID
+	// Convert with scripts/ffpp_log_convert.py
+	ffpp_logger_free(logger);
 	printf("\nBye..\n");
 	return 0;
 }
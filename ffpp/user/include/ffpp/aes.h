@@ -3,10 +3,15 @@
 
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // #define the macros below to 1/0 to enable/disable the mode of operation.
 //
 // CBC enables AES encryption in CBC-mode of operation.
 // CTR enables encryption in counter-mode.
+// GCM enables authenticated encryption in Galois/counter mode.
 // ECB enables the basic ECB 16-byte block algorithm. All can be enabled simultaneously.
 
 // The #ifndef-guard allows it to be configured before #include'ing or at compile time.
@@ -22,6 +27,10 @@
 #define CTR 1
 #endif
 
+#ifndef GCM
+#define GCM 1
+#endif
+
 #define AES128 1
 //#define AES192 1
 //#define AES256 1
@@ -63,13 +72,23 @@ void AES_ECB_decrypt(const struct AES_ctx *ctx, uint8_t *buf);
 #endif // #if defined(ECB) && (ECB == !)
 
 #if defined(CBC) && (CBC == 1)
-// buffer size MUST be mutile of AES_BLOCKLEN;
+// buffer size MUST be mutile of AES_BLOCKLEN, a partial last block is
+// processed as a whole block;
 // Suggest https://en.wikipedia.org/wiki/Padding_(cryptography)#PKCS7 for padding scheme
 // NOTES: you need to set IV in ctx via AES_init_ctx_iv() or AES_ctx_set_iv()
 //        no IV should ever be reused with the same key
 void AES_CBC_encrypt_buffer(struct AES_ctx *ctx, uint8_t *buf, uint32_t length);
 void AES_CBC_decrypt_buffer(struct AES_ctx *ctx, uint8_t *buf, uint32_t length);
 
+// Encrypt n independent buffers (e.g. the packets of a burst) with the key of
+// ctx. Up to 8 buffers are encrypted in lockstep with their rounds
+// interleaved, a finished buffer is replaced by the next one. ivs[i] is the IV
+// of bufs[i] and is set to its last ciphertext block. The result is the same
+// as n calls of AES_CBC_encrypt_buffer(), the buffers must not overlap.
+void AES_CBC_encrypt_multi(const struct AES_ctx *ctx, uint8_t *const bufs[],
+			   const uint32_t lengths[],
+			   uint8_t (*ivs)[AES_BLOCKLEN], uint32_t n);
+
 #endif // #if defined(CBC) && (CBC == 1)
 
 #if defined(CTR) && (CTR == 1)
@@ -83,4 +102,78 @@ void AES_CTR_xcrypt_buffer(struct AES_ctx *ctx, uint8_t *buf, uint32_t length);
 
 #endif // #if defined(CTR) && (CTR == 1)
 
+#if defined(GCM) && (GCM == 1)
+
+#define AES_GCM_IVLEN 12
+#define AES_GCM_TAGLEN 16
+// Number of cached powers of the hash key, up to this many blocks are hashed
+// with one reduction.
+#define AES_GCM_HPOWS 16
+
+struct AES_GCM_ctx {
+	struct AES_ctx aes; // Iv is not used
+	// H^(i+1) in Htab[i], the bytes reversed like the blocks are loaded for
+	// PCLMULQDQ.
+	uint8_t Htab[AES_GCM_HPOWS][AES_BLOCKLEN];
+};
+
+// One buffer of the GCM functions, encrypted or decrypted in place. The IV is
+// 96 bits (NIST SP 800-38D), the tag is always AES_GCM_TAGLEN bytes.
+struct AES_GCM_buf {
+	uint8_t *buf;
+	uint32_t length;
+	const uint8_t *iv;
+	const uint8_t *aad; // Additional authenticated data, not encrypted
+	uint32_t aad_len;
+	uint8_t *tag; // Written by encryption, read by decryption
+};
+
+void AES_GCM_init_ctx(struct AES_GCM_ctx *ctx, const uint8_t *key);
+void AES_GCM_encrypt(const struct AES_GCM_ctx *ctx,
+		     const struct AES_GCM_buf *b);
+// Returns 0 if the tag is valid, -EBADMSG otherwise. The buffer is decrypted
+// in the same pass, so it holds garbage if the tag is invalid and must be
+// dropped.
+int AES_GCM_decrypt(const struct AES_GCM_ctx *ctx,
+		    const struct AES_GCM_buf *b);
+
+// Process n independent buffers, e.g. the payloads of a batch of packets.
+// Buffers with fewer blocks than the accelerated implementations have in
+// flight are processed together, their counter blocks are encrypted in one
+// pass. The results are the same as n single calls.
+void AES_GCM_encrypt_multi(const struct AES_GCM_ctx *ctx,
+			   const struct AES_GCM_buf *bufs, uint32_t n);
+// valid[i] is set to 1 if the tag of bufs[i] is valid, 0 otherwise. Returns
+// the number of valid buffers.
+uint32_t AES_GCM_decrypt_multi(const struct AES_GCM_ctx *ctx,
+			       const struct AES_GCM_buf *bufs, uint32_t n,
+			       uint8_t *valid);
+
+#endif // #if defined(GCM) && (GCM == 1)
+
+// Implementations of the modes above. At startup, the fastest one that the CPU
+// supports is selected, the environment variable FFPP_AES_IMPL (e.g. "sw")
+// overrides it. All implementations give identical results and share the
+// struct AES_ctx, only AES_init_ctx() always uses the software key expansion.
+enum AES_impl {
+	AES_IMPL_SW = 0, // Portable byte-wise code
+	AES_IMPL_AESNI, // AES-NI, 8 blocks in flight for CBC decryption, CTR,
+			// GCM and multi-buffer CBC encryption, PCLMULQDQ for
+			// GHASH
+	AES_IMPL_VAES, // VAES and VPCLMULQDQ on AVX-512 registers, 16 blocks
+		       // in flight
+	AES_IMPL_MAX,
+};
+
+enum AES_impl AES_get_impl(void);
+// Returns 0 on success, -ENOTSUP if the CPU does not support impl.
+// Not thread safe, call it before the workers are started.
+int AES_set_impl(enum AES_impl impl);
+// "sw", "aesni" or "vaes".
+const char *AES_impl_name(enum AES_impl impl);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
 #endif // _AES_H_
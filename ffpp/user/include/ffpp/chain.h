@@ -0,0 +1,61 @@
+/*
+ * chain.h
+ */
+
+#ifndef CHAIN_H
+#define CHAIN_H
+
+/**
+ * @file
+ *
+ * C entry points of fused processor chains instantiated in the library (see
+ * chain.hpp). They have the signature of ffpp_burst_handler_t, so they can be
+ * used as stages of the worker runtime.
+ *
+ */
+
+#include <stdint.h>
+
+#include <rte_ether.h>
+
+#include <ffpp/collections.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * struct ffpp_chain_mac_args - Argument of the chains with RewriteMac.
+ */
+struct ffpp_chain_mac_args {
+	struct rte_ether_addr src;
+	struct rte_ether_addr dst;
+};
+
+/**
+ * ffpp_chain_l2fwd() - chain<RewriteMac>.
+ *
+ * @param vec
+ * @param arg: Pointer to struct ffpp_chain_mac_args.
+ *
+ * @return Number of packets to forward (all).
+ */
+uint16_t ffpp_chain_l2fwd(struct ffpp_mvec *vec, void *arg);
+
+/**
+ * ffpp_chain_l3fwd() - chain<ParseEth, DecTTL, RewriteMac>.
+ *
+ * Expired packets are moved to the tail of the vector.
+ *
+ * @param vec
+ * @param arg: Pointer to struct ffpp_chain_mac_args.
+ *
+ * @return Number of packets to forward.
+ */
+uint16_t ffpp_chain_l3fwd(struct ffpp_mvec *vec, void *arg);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !CHAIN_H */
@@ -0,0 +1,393 @@
+/*
+ * chain.hpp
+ */
+
+#ifndef CHAIN_HPP
+#define CHAIN_HPP
+
+/**
+ * @file
+ *
+ * Compile-time fused processor chains.
+ *
+ * ffpp::chain<ParseEth, DecTTL, RewriteMac> runs all stages on one packet
+ * before the next packet is touched, so each header is pulled into the cache
+ * once per chain instead of once per processor. The stage calls are resolved
+ * at compile time and inlined into a single loop, there are no indirect calls.
+ *
+ * A stage is any copyable type with bool operator()(ffpp::pkt_ctx &). It
+ * returns false to drop the packet, the remaining stages are skipped then.
+ * Like a ffpp_burst_handler_t, a chain moves dropped packets to the tail of
+ * the vector and returns the number of packets to forward.
+ *
+ * To call a chain from C, instantiate it in a C++ translation unit behind an
+ * extern "C" function with the ffpp_burst_handler_t signature, like the ones
+ * in chain.h.
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <utility>
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+#include <rte_prefetch.h>
+
+#include <ffpp/checksum.h>
+#include <ffpp/collections.h>
+
+namespace ffpp
+{
+/**
+ * Per-packet state shared by the stages of a chain.
+ *
+ * The L3 header is parsed on the first use, so it is parsed once per packet
+ * in a fused chain.
+ */
+class pkt_ctx {
+    public:
+	explicit pkt_ctx(struct rte_mbuf *m) : m_(m)
+	{
+	}
+
+	struct rte_mbuf *mbuf() const
+	{
+		return m_;
+	}
+
+	/* nullptr if the packet is shorter than an Ethernet header. */
+	struct rte_ether_hdr *eth() const
+	{
+		if (unlikely(rte_pktmbuf_data_len(m_) < RTE_ETHER_HDR_LEN)) {
+			return nullptr;
+		}
+		return rte_pktmbuf_mtod(m_, struct rte_ether_hdr *);
+	}
+
+	struct rte_ipv4_hdr *ipv4()
+	{
+		parse();
+		return ether_type_ == RTE_BE16(RTE_ETHER_TYPE_IPV4) ?
+				     static_cast<struct rte_ipv4_hdr *>(l3_) :
+				     nullptr;
+	}
+
+	struct rte_ipv6_hdr *ipv6()
+	{
+		parse();
+		return ether_type_ == RTE_BE16(RTE_ETHER_TYPE_IPV6) ?
+				     static_cast<struct rte_ipv6_hdr *>(l3_) :
+				     nullptr;
+	}
+
+	/* Find the IPv4/IPv6 header after at most one VLAN tag. */
+	void parse()
+	{
+		if (parsed_) {
+			return;
+		}
+		parsed_ = true;
+
+		struct rte_ether_hdr *eth_hdr = eth();
+		uint16_t len = rte_pktmbuf_data_len(m_);
+		uint16_t off = RTE_ETHER_HDR_LEN;
+		uint16_t type;
+
+		if (eth_hdr == nullptr) {
+			return;
+		}
+		type = eth_hdr->ether_type;
+		if (type == RTE_BE16(RTE_ETHER_TYPE_VLAN)) {
+			if (len < off + sizeof(struct rte_vlan_hdr)) {
+				return;
+			}
+			type = reinterpret_cast<struct rte_vlan_hdr *>(eth_hdr + 1)
+				       ->eth_proto;
+			off += sizeof(struct rte_vlan_hdr);
+		}
+		if ((type == RTE_BE16(RTE_ETHER_TYPE_IPV4) &&
+		     len >= off + sizeof(struct rte_ipv4_hdr)) ||
+		    (type == RTE_BE16(RTE_ETHER_TYPE_IPV6) &&
+		     len >= off + sizeof(struct rte_ipv6_hdr))) {
+			ether_type_ = type;
+			l3_ = rte_pktmbuf_mtod_offset(m_, void *, off);
+		}
+	}
+
+    private:
+	struct rte_mbuf *m_;
+	void *l3_ = nullptr;
+	uint16_t ether_type_ = 0;
+	bool parsed_ = false;
+};
+
+namespace detail
+{
+// Headers of the packet PREFETCH_OFFSET iterations ahead are prefetched.
+constexpr uint16_t PREFETCH_OFFSET = 3;
+
+static inline void prefetch(const struct ffpp_mvec *vec, uint16_t i)
+{
+	if (i < vec->len) {
+		rte_prefetch0(rte_pktmbuf_mtod(vec->head[i], void *));
+	}
+}
+
+/* Keep the i-th packet at the head of the vector, the order is kept. */
+static inline void keep_packet(struct ffpp_mvec *vec, uint16_t i,
+			       uint16_t &nb_keep)
+{
+	if (i != nb_keep) {
+		std::swap(vec->head[i], vec->head[nb_keep]);
+	}
+	nb_keep++;
+}
+} // namespace detail
+
+/**
+ * A chain of stages applied to each packet of a mbuf vector.
+ */
+template <typename... Stages> class chain {
+	static_assert(sizeof...(Stages) > 0, "A chain needs at least one stage");
+
+    public:
+	chain() = default;
+
+	explicit chain(Stages... stages) : stages_(std::move(stages)...)
+	{
+	}
+
+	/**
+	 * Run all stages on each packet in one loop.
+	 *
+	 * @return Number of packets at the head of the vector to forward.
+	 */
+	uint16_t operator()(struct ffpp_mvec *vec)
+	{
+		uint16_t nb_keep = 0;
+
+		for (uint16_t i = 0; i < detail::PREFETCH_OFFSET; ++i) {
+			detail::prefetch(vec, i);
+		}
+		for (uint16_t i = 0; i < vec->len; ++i) {
+			detail::prefetch(vec, i + detail::PREFETCH_OFFSET);
+			pkt_ctx ctx(vec->head[i]);
+			if (apply(ctx, std::index_sequence_for<Stages...>{})) {
+				detail::keep_packet(vec, i, nb_keep);
+			}
+		}
+		return nb_keep;
+	}
+
+	/**
+	 * Run the stages one after another over the whole vector, like separate
+	 * processors. Same result as the fused run, used as the baseline.
+	 */
+	uint16_t run_sequential(struct ffpp_mvec *vec)
+	{
+		return run_sequential(vec, std::index_sequence_for<Stages...>{});
+	}
+
+	static constexpr std::size_t size()
+	{
+		return sizeof...(Stages);
+	}
+
+    private:
+	std::tuple<Stages...> stages_;
+
+	template <std::size_t... I>
+	__rte_always_inline bool apply(pkt_ctx &ctx, std::index_sequence<I...>)
+	{
+		// Short-circuit: stages after a drop are not run.
+		return (std::get<I>(stages_)(ctx) && ...);
+	}
+
+	template <std::size_t I>
+	uint16_t run_stage(struct ffpp_mvec *vec, uint16_t len)
+	{
+		uint16_t nb_keep = 0;
+
+		for (uint16_t i = 0; i < detail::PREFETCH_OFFSET; ++i) {
+			detail::prefetch(vec, i);
+		}
+		for (uint16_t i = 0; i < len; ++i) {
+			detail::prefetch(vec, i + detail::PREFETCH_OFFSET);
+			pkt_ctx ctx(vec->head[i]);
+			if (std::get<I>(stages_)(ctx)) {
+				detail::keep_packet(vec, i, nb_keep);
+			}
+		}
+		return nb_keep;
+	}
+
+	template <std::size_t... I>
+	uint16_t run_sequential(struct ffpp_mvec *vec, std::index_sequence<I...>)
+	{
+		uint16_t len = vec->len;
+
+		((len = run_stage<I>(vec, len)), ...);
+		return len;
+	}
+};
+
+/* Stages */
+
+/**
+ * Parse the L3 header. Optional, the other stages parse on demand.
+ */
+struct ParseEth {
+	bool operator()(pkt_ctx &ctx) const
+	{
+		ctx.parse();
+		return true;
+	}
+};
+
+/**
+ * Set both MAC addresses.
+ */
+class RewriteMac {
+    public:
+	RewriteMac() = default;
+
+	RewriteMac(const struct rte_ether_addr &src,
+		   const struct rte_ether_addr &dst)
+		: src_(src), dst_(dst)
+	{
+	}
+
+	bool operator()(pkt_ctx &ctx) const
+	{
+		struct rte_ether_hdr *eth = ctx.eth();
+
+		if (eth != nullptr) {
+			rte_ether_addr_copy(&dst_, &eth->d_addr);
+			rte_ether_addr_copy(&src_, &eth->s_addr);
+		}
+		return true;
+	}
+
+    private:
+	struct rte_ether_addr src_ = {};
+	struct rte_ether_addr dst_ = {};
+};
+
+/**
+ * Swap the source and destination MAC addresses.
+ */
+struct SwapMac {
+	bool operator()(pkt_ctx &ctx) const
+	{
+		struct rte_ether_hdr *eth = ctx.eth();
+		struct rte_ether_addr tmp;
+
+		if (eth != nullptr) {
+			rte_ether_addr_copy(&eth->d_addr, &tmp);
+			rte_ether_addr_copy(&eth->s_addr, &eth->d_addr);
+			rte_ether_addr_copy(&tmp, &eth->s_addr);
+		}
+		return true;
+	}
+};
+
+/**
+ * Decrement the IPv4 TTL (with incremental checksum update) or the IPv6 hop
+ * limit, drop the packet if it expires.
+ */
+struct DecTTL {
+	bool operator()(pkt_ctx &ctx) const
+	{
+		struct rte_ipv4_hdr *ip = ctx.ipv4();
+		struct rte_ipv6_hdr *ip6;
+		uint16_t old, now;
+
+		if (ip != nullptr) {
+			if (ip->time_to_live <= 1) {
+				return false;
+			}
+			// TTL and protocol are one 16-bit word.
+			memcpy(&old, &ip->time_to_live, sizeof(old));
+			ip->time_to_live--;
+			memcpy(&now, &ip->time_to_live, sizeof(now));
+			ip->hdr_checksum = ffpp_csum_replace16(
+				ip->hdr_checksum, old, now);
+			return true;
+		}
+		ip6 = ctx.ipv6();
+		if (ip6 != nullptr) {
+			if (ip6->hop_limits <= 1) {
+				return false;
+			}
+			ip6->hop_limits--;
+		}
+		return true;
+	}
+};
+
+/**
+ * Set the DSCP of IPv4 (with incremental checksum update) and IPv6 packets.
+ */
+class MarkDscp {
+    public:
+	MarkDscp() = default;
+
+	explicit MarkDscp(uint8_t dscp) : dscp_(dscp & 0x3f)
+	{
+	}
+
+	bool operator()(pkt_ctx &ctx) const
+	{
+		struct rte_ipv4_hdr *ip = ctx.ipv4();
+		struct rte_ipv6_hdr *ip6;
+		uint16_t old, now;
+		uint32_t vtc_flow;
+
+		if (ip != nullptr) {
+			memcpy(&old, ip, sizeof(old));
+			ip->type_of_service =
+				(dscp_ << 2) | (ip->type_of_service & 0x03);
+			memcpy(&now, ip, sizeof(now));
+			ip->hdr_checksum = ffpp_csum_replace16(
+				ip->hdr_checksum, old, now);
+			return true;
+		}
+		ip6 = ctx.ipv6();
+		if (ip6 != nullptr) {
+			vtc_flow = rte_be_to_cpu_32(ip6->vtc_flow);
+			vtc_flow = (vtc_flow & ~(0xfcU << 20)) |
+				   (static_cast<uint32_t>(dscp_) << 22);
+			ip6->vtc_flow = rte_cpu_to_be_32(vtc_flow);
+		}
+		return true;
+	}
+
+    private:
+	uint8_t dscp_ = 0;
+};
+
+/**
+ * Recompute the IPv4 header checksum, for stages that rewrite the header
+ * without updating it.
+ */
+struct Ipv4Cksum {
+	bool operator()(pkt_ctx &ctx) const
+	{
+		struct rte_ipv4_hdr *ip = ctx.ipv4();
+
+		if (ip != nullptr) {
+			ip->hdr_checksum = 0;
+			ip->hdr_checksum = rte_ipv4_cksum(ip);
+		}
+		return true;
+	}
+};
+
+} // namespace ffpp
+
+#endif /* !CHAIN_HPP */
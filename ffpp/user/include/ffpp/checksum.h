@@ -0,0 +1,185 @@
+/*
+ * checksum.h
+ */
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+/**
+ * @file
+ *
+ * Internet checksum helpers for packet rewrites.
+ *
+ * Pick the cheapest way for each change:
+ * - Header fields changed: update the checksums incrementally (RFC 1624) with
+ *   ffpp_csum_replace16() and friends. The cost does not depend on the packet
+ *   size.
+ * - Payload changed: recompute the UDP/TCP checksum with
+ *   ffpp_csum_ipv4_udptcp(), which sums the payload with AVX2 when the library
+ *   is compiled for a CPU that supports it.
+ * - Packet sent out: ffpp_csum_finalize() lets the NIC compute the checksums
+ *   when the port supports it (see ffpp_dpdk_get_tx_offloads()) and computes
+ *   them in software otherwise.
+ *
+ * The one's complement sum does not depend on the byte order, so all words are
+ * used as they are in the packet and no byte swapping is needed.
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <rte_common.h>
+#include <rte_ip.h>
+
+#include <ffpp/collections.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * ffpp_csum_fold() - Fold a 32-bit one's complement sum to 16 bits.
+ */
+static __rte_always_inline uint16_t ffpp_csum_fold(uint32_t sum)
+{
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	return (uint16_t)sum;
+}
+
+/**
+ * ffpp_csum_diff16() - Difference ~m + m' of a 16-bit word (RFC 1624, Eqn. 3).
+ *
+ * Differences of several fields can be added up and applied once with
+ * ffpp_csum_apply(). At most 32768 differences can be added up.
+ */
+static __rte_always_inline uint32_t ffpp_csum_diff16(uint16_t old,
+						     uint16_t now)
+{
+	return (uint32_t)(uint16_t)~old + now;
+}
+
+/**
+ * ffpp_csum_diff32() - Difference of a 32-bit field, e.g. an IPv4 address.
+ */
+static __rte_always_inline uint32_t ffpp_csum_diff32(uint32_t old,
+						     uint32_t now)
+{
+	return (~old & 0xffff) + (~old >> 16) + (now & 0xffff) + (now >> 16);
+}
+
+/**
+ * ffpp_csum_apply() - Apply a difference to a checksum: HC' = ~(~HC + diff).
+ */
+static __rte_always_inline uint16_t ffpp_csum_apply(uint16_t csum,
+						    uint32_t diff)
+{
+	return (uint16_t)~ffpp_csum_fold((uint16_t)~csum + diff);
+}
+
+/**
+ * ffpp_csum_replace16() - Update a checksum for one changed 16-bit word.
+ *
+ * @param csum: Checksum field as it is in the packet.
+ * @param old: Old value of the word as it is in the packet.
+ * @param now: New value of the word as it is in the packet.
+ *
+ * @return The new checksum field.
+ */
+static __rte_always_inline uint16_t ffpp_csum_replace16(uint16_t csum,
+							uint16_t old,
+							uint16_t now)
+{
+	return ffpp_csum_apply(csum, ffpp_csum_diff16(old, now));
+}
+
+/**
+ * ffpp_csum_replace32() - Update a checksum for one changed 32-bit field.
+ */
+static __rte_always_inline uint16_t ffpp_csum_replace32(uint16_t csum,
+							uint32_t old,
+							uint32_t now)
+{
+	return ffpp_csum_apply(csum, ffpp_csum_diff32(old, now));
+}
+
+/**
+ * ffpp_csum_udp_apply() - Apply a difference to a UDP checksum.
+ *
+ * 0 means no checksum for UDP over IPv4 and is kept, a computed 0 is sent as
+ * 0xffff.
+ */
+static __rte_always_inline uint16_t ffpp_csum_udp_apply(uint16_t csum,
+							uint32_t diff)
+{
+	if (csum == 0) {
+		return 0;
+	}
+	csum = ffpp_csum_apply(csum, diff);
+	return csum == 0 ? 0xffff : csum;
+}
+
+/**
+ * ffpp_csum_raw() - One's complement sum of a buffer.
+ *
+ * Same result as rte_raw_cksum(), the sum is neither complemented nor byte
+ * swapped.
+ *
+ * @param buf: No alignment is required.
+ * @param len
+ *
+ * @return The folded sum.
+ */
+uint16_t ffpp_csum_raw(const void *buf, size_t len);
+
+/**
+ * ffpp_csum_raw_scalar() - Scalar implementation of ffpp_csum_raw().
+ */
+uint16_t ffpp_csum_raw_scalar(const void *buf, size_t len);
+
+/**
+ * ffpp_csum_ipv4_udptcp() - Compute the UDP or TCP checksum of an IPv4
+ * packet.
+ *
+ * The checksum field must be zero. The L4 length is taken from the total
+ * length of the IPv4 header, the whole datagram must be contiguous.
+ *
+ * @param ip
+ * @param l4: UDP or TCP header.
+ *
+ * @return The checksum field, 0xffff instead of 0 for UDP.
+ */
+uint16_t ffpp_csum_ipv4_udptcp(const struct rte_ipv4_hdr *ip, const void *l4);
+
+/**
+ * ffpp_csum_ipv6_udptcp() - Compute the UDP or TCP checksum of an IPv6
+ * packet.
+ *
+ * Same as ffpp_csum_ipv4_udptcp(), the L4 length is the payload length of the
+ * IPv6 header.
+ */
+uint16_t ffpp_csum_ipv6_udptcp(const struct rte_ipv6_hdr *ip6, const void *l4);
+
+/**
+ * ffpp_csum_finalize() - Set the IPv4 header checksum and the UDP/TCP
+ * checksum of all packets of a vector before they are sent.
+ *
+ * Each checksum covered by a DEV_TX_OFFLOAD_*_CKSUM flag in tx_offloads is
+ * left to the NIC: the mbuf lengths and PKT_TX_* flags are set and the L4
+ * checksum field is seeded with the pseudo header checksum. The other
+ * checksums are computed in software. Ethernet headers with at most one VLAN
+ * tag are supported, other packets, fragments and IPv6 packets with extension
+ * headers are left as they are.
+ *
+ * @param vec
+ * @param tx_offloads: TX offloads of the output port, see
+ * ffpp_dpdk_get_tx_offloads(). 0 computes everything in software.
+ */
+void ffpp_csum_finalize(struct ffpp_mvec *vec, uint64_t tx_offloads);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !CHECKSUM_H */
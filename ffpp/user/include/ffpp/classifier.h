@@ -0,0 +1,227 @@
+/*
+ * classifier.h
+ */
+
+#ifndef CLASSIFIER_H
+#define CLASSIFIER_H
+
+/**
+ * @file
+ *
+ * Flow classifier with exact 5-tuple rules (rte_hash) and IPv4/IPv6
+ * destination prefix rules (rte_lpm/rte_lpm6).
+ *
+ * ffpp_cls_lookup() returns an action ID for each packet of a vector. IPv4
+ * packets are first looked up in the exact match table, packets without an
+ * exact rule are looked up by destination address in the prefix tables. All
+ * lookups are bulk lookups.
+ *
+ * Rules can be added and deleted by a control thread while workers look up.
+ * The tables are protected by a QSBR RCU variable: Each lcore that calls
+ * ffpp_cls_lookup() registers as reader and reports a quiescent state when it
+ * holds no results of a lookup anymore, e.g. after each burst. Writers are
+ * serialized by a lock. Rule deletions wait (IPv6) or defer the reclamation
+ * (exact and IPv4) until all readers passed a quiescent state.
+ *
+ */
+
+#include <stdint.h>
+
+#include <rte_lpm6.h>
+
+#include <ffpp/collections.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// rte_lpm6 stores 21-bit next hops.
+#define FFPP_CLS_ACTION_MAX ((1U << 21) - 1)
+#define FFPP_CLS_NAME_MAX_LEN 24
+#define FFPP_CLS_LPM_TBL8S_DEFAULT (1U << 12)
+#define FFPP_CLS_LPM6_TBL8S_DEFAULT (1U << 14)
+
+/**
+ * struct ffpp_cls_5tuple - Key of an exact rule.
+ *
+ * Addresses and ports are in network byte order. The ports are 0 for other
+ * protocols than TCP, UDP and SCTP and for non-first fragments.
+ */
+struct ffpp_cls_5tuple {
+	uint32_t src_addr;
+	uint32_t dst_addr;
+	uint16_t src_port;
+	uint16_t dst_port;
+	uint8_t proto;
+	uint8_t pad[3]; /**< Must be zero, part of the hash key */
+};
+
+/**
+ * struct ffpp_cls_config - Configuration of a classifier.
+ *
+ * A table is not created if its maximal number of rules is 0.
+ */
+struct ffpp_cls_config {
+	char name[FFPP_CLS_NAME_MAX_LEN];
+	int socket_id;
+	uint32_t max_exact_rules;
+	uint32_t max_lpm_rules;
+	uint32_t lpm_tbl8s; /**< 0 to use the default */
+	uint32_t max_lpm6_rules;
+	uint32_t lpm6_tbl8s; /**< 0 to use the default */
+	uint32_t default_action; /**< Action of packets without a rule */
+};
+
+struct ffpp_classifier;
+
+/**
+ * ffpp_cls_create() - Create a classifier.
+ *
+ * @param cfg
+ *
+ * @return
+ * - Pointer to the classifier on success.
+ * - NULL on failure, rte_errno is set.
+ */
+struct ffpp_classifier *ffpp_cls_create(const struct ffpp_cls_config *cfg);
+
+/**
+ * ffpp_cls_free() - Free a classifier. No reader may use it anymore.
+ *
+ * @param cls
+ */
+void ffpp_cls_free(struct ffpp_classifier *cls);
+
+/**
+ * ffpp_cls_add_exact() - Add an exact 5-tuple rule or update its action.
+ *
+ * @param cls
+ * @param key: The padding is ignored.
+ * @param action: 0 to FFPP_CLS_ACTION_MAX.
+ *
+ * @return 0 on success, a negative errno value on failure.
+ */
+int ffpp_cls_add_exact(struct ffpp_classifier *cls,
+		       const struct ffpp_cls_5tuple *key, uint32_t action);
+
+/**
+ * ffpp_cls_del_exact() - Delete an exact 5-tuple rule.
+ *
+ * @param cls
+ * @param key
+ *
+ * @return 0 on success, -ENOENT if there is no such rule.
+ */
+int ffpp_cls_del_exact(struct ffpp_classifier *cls,
+		       const struct ffpp_cls_5tuple *key);
+
+/**
+ * ffpp_cls_add_lpm() - Add an IPv4 destination prefix rule or update its
+ * action.
+ *
+ * @param cls
+ * @param ip: Prefix in host byte order.
+ * @param depth: 1 to 32.
+ * @param action: 0 to FFPP_CLS_ACTION_MAX.
+ *
+ * @return 0 on success, a negative errno value on failure.
+ */
+int ffpp_cls_add_lpm(struct ffpp_classifier *cls, uint32_t ip, uint8_t depth,
+		     uint32_t action);
+
+/**
+ * ffpp_cls_del_lpm() - Delete an IPv4 destination prefix rule.
+ *
+ * @return 0 on success, a negative errno value on failure.
+ */
+int ffpp_cls_del_lpm(struct ffpp_classifier *cls, uint32_t ip, uint8_t depth);
+
+/**
+ * ffpp_cls_add_lpm6() - Add an IPv6 destination prefix rule or update its
+ * action.
+ *
+ * The IPv6 table is double-buffered: The rule is added to the standby copy,
+ * the copies are swapped and the rule is added to the other copy after all
+ * readers passed a quiescent state. So this call blocks until then and must
+ * not be called by an online reader.
+ *
+ * @param cls
+ * @param ip
+ * @param depth: 1 to 128.
+ * @param action: 0 to FFPP_CLS_ACTION_MAX.
+ *
+ * @return 0 on success, a negative errno value on failure.
+ */
+int ffpp_cls_add_lpm6(struct ffpp_classifier *cls,
+		      const uint8_t ip[RTE_LPM6_IPV6_ADDR_SIZE], uint8_t depth,
+		      uint32_t action);
+
+/**
+ * ffpp_cls_del_lpm6() - Delete an IPv6 destination prefix rule. Blocks like
+ * ffpp_cls_add_lpm6().
+ *
+ * @return 0 on success, a negative errno value on failure.
+ */
+int ffpp_cls_del_lpm6(struct ffpp_classifier *cls,
+		      const uint8_t ip[RTE_LPM6_IPV6_ADDR_SIZE], uint8_t depth);
+
+/**
+ * ffpp_cls_reader_register() - Register the lcore as reader.
+ *
+ * @param cls
+ * @param lcore_id
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int ffpp_cls_reader_register(struct ffpp_classifier *cls,
+			     unsigned int lcore_id);
+
+/**
+ * ffpp_cls_reader_unregister() - Unregister a reader, e.g. before the worker
+ * loop returns.
+ *
+ * @param cls
+ * @param lcore_id
+ */
+void ffpp_cls_reader_unregister(struct ffpp_classifier *cls,
+				unsigned int lcore_id);
+
+/**
+ * ffpp_cls_quiescent() - Report that the reader holds no lookup results.
+ *
+ * @param cls
+ * @param lcore_id
+ */
+void ffpp_cls_quiescent(struct ffpp_classifier *cls, unsigned int lcore_id);
+
+/**
+ * ffpp_cls_lookup() - Classify all packets of a vector.
+ *
+ * Packets that are neither IPv4 nor IPv6 (after at most one VLAN tag) get the
+ * default action.
+ *
+ * @param cls
+ * @param vec
+ * @param actions: Array with at least vec->len elements for the action IDs.
+ *
+ * @return Number of packets that matched a rule.
+ */
+uint16_t ffpp_cls_lookup(const struct ffpp_classifier *cls,
+			 const struct ffpp_mvec *vec, uint32_t *actions);
+
+/**
+ * ffpp_cls_5tuple_of() - Extract the key of an exact rule from an IPv4
+ * packet.
+ *
+ * @param m
+ * @param key
+ *
+ * @return 0 on success, -1 if the packet is not IPv4.
+ */
+int ffpp_cls_5tuple_of(const struct rte_mbuf *m, struct ffpp_cls_5tuple *key);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !CLASSIFIER_H */
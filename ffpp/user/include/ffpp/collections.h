@@ -18,5 +18,6 @@
  */
 
 #include <ffpp/mvec.h>
+#include <ffpp/wsdeque.h>
 
 #endif /* !COLLECTIONS_H */
@@ -0,0 +1,327 @@
+/*
+ * crypto.h
+ */
+
+#ifndef CRYPTO_H
+#define CRYPTO_H
+
+/**
+ * @file
+ *
+ * Crypto sessions with cached key schedules and per-flow keys.
+ *
+ * A session is created once per key and mode. Its round keys are expanded at
+ * creation and copied into cache-aligned storage of each partition (worker
+ * lcore), so the key expansion never runs per packet.
+ *
+ * The session of a flow is kept in a flow table (see flow_table.h). New flows
+ * get the default session, ffpp_crypto_set_flow_session() assigns another one,
+ * e.g. a session with a per-flow key.
+ *
+ * The IV of each packet is derived from a 64-bit sequence number:
+ * - CTR: the salt of the session with the sequence number XORed into the upper
+ *   64 bits, the lowest 32 bits are the block counter starting at 0.
+ * - CBC: the encryption of the same block with the session key, so the IVs are
+ *   unpredictable (NIST SP 800-38A, Appendix C).
+ * The sequence numbers are counted per session and partition, the upper 16
+ * bits are the partition, so lcores never use the same IV. The receiver needs
+ * the sequence number of a packet to decrypt it.
+ *
+ * Sessions can be destroyed while the partitions process packets. The sessions
+ * are protected by a QSBR RCU variable: The lcore of each partition registers
+ * as reader and reports a quiescent state when it holds no session pointers
+ * anymore, e.g. after each burst. The keys are cleared and the ID is reused
+ * only after all readers passed a quiescent state. The flows of a destroyed
+ * session are invalidated, they do not use a newer session with the same ID.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <rte_common.h>
+
+#include <ffpp/aes.h>
+#include <ffpp/classifier.h>
+#include <ffpp/collections.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFPP_CRYPTO_NAME_MAX_LEN 20
+// Session ID of no session.
+#define FFPP_CRYPTO_SESSION_NONE 0
+// Sequence number of packets that are not processed.
+#define FFPP_CRYPTO_SEQ_NONE UINT64_MAX
+#define FFPP_CRYPTO_SEQ_PART_SHIFT 48
+// Maximal number of CBC packets that are encrypted together.
+#define FFPP_CRYPTO_BATCH_MAX 64
+
+enum ffpp_crypto_algo {
+	FFPP_CRYPTO_AES_CBC = 0,
+	FFPP_CRYPTO_AES_CTR,
+	FFPP_CRYPTO_NULL, /**< No cipher, only for cryptodev.h (crypto_null) */
+};
+
+enum ffpp_crypto_dir {
+	FFPP_CRYPTO_ENCRYPT = 0,
+	FFPP_CRYPTO_DECRYPT,
+};
+
+/**
+ * struct ffpp_crypto_config - Configuration of a crypto context.
+ */
+struct ffpp_crypto_config {
+	char name[FFPP_CRYPTO_NAME_MAX_LEN];
+	int socket_id;
+	uint16_t nb_parts; /**< Number of partitions (worker lcores) */
+	uint32_t max_sessions;
+	uint32_t max_flows; /**< Maximal number of flows per partition */
+	uint64_t timeout_us; /**< Idle timeout of a flow, 0 for the default */
+	// Start of the encrypted data in the packet, e.g. the UDP payload. The
+	// rest of the first segment is processed, for CBC only whole blocks.
+	uint16_t offset;
+};
+
+/**
+ * struct ffpp_crypto_session_params - Parameters of a session.
+ */
+struct ffpp_crypto_session_params {
+	enum ffpp_crypto_algo algo;
+	uint8_t key[AES_KEYLEN];
+	uint8_t salt[AES_BLOCKLEN]; /**< Base of the IVs */
+};
+
+/**
+ * struct ffpp_crypto_session - The copy of a session in one partition.
+ */
+struct ffpp_crypto_session {
+	struct AES_ctx ctx; /**< Expanded round keys, Iv is per packet */
+	uint8_t salt[AES_BLOCKLEN];
+	uint64_t seq; /**< Next sequence number */
+	uint64_t seq_end; /**< Exclusive end of the sequence numbers */
+	enum ffpp_crypto_algo algo;
+	uint32_t gen; /**< Generation of the ID, checked against the flows */
+	bool active;
+} __rte_cache_aligned;
+
+/**
+ * struct ffpp_crypto_stats - Counters of one partition.
+ */
+struct ffpp_crypto_stats {
+	uint64_t encrypted;
+	uint64_t decrypted;
+	uint64_t bytes;
+	uint64_t untracked; /**< Not IPv4, flow table full or no session */
+	uint64_t seq_exhausted; /**< The session must be replaced */
+	uint32_t nb_flows;
+};
+
+struct ffpp_crypto;
+
+/**
+ * ffpp_crypto_create() - Create a crypto context without sessions.
+ *
+ * @param cfg
+ *
+ * @return
+ * - Pointer to the context on success.
+ * - NULL on failure, rte_errno is set.
+ */
+struct ffpp_crypto *ffpp_crypto_create(const struct ffpp_crypto_config *cfg);
+
+/**
+ * ffpp_crypto_free() - Free a context, the keys of all sessions are cleared.
+ *
+ * @param c
+ */
+void ffpp_crypto_free(struct ffpp_crypto *c);
+
+/**
+ * ffpp_crypto_session_create() - Create a session and expand its round keys.
+ *
+ * Must not be called concurrently with other control functions. It can be
+ * called while the partitions process packets.
+ *
+ * @param c
+ * @param params
+ *
+ * @return The session ID (> 0) on success, -EINVAL for invalid parameters,
+ * -ENOSPC if there are already max_sessions sessions.
+ */
+int ffpp_crypto_session_create(struct ffpp_crypto *c,
+			       const struct ffpp_crypto_session_params *params);
+
+/**
+ * ffpp_crypto_session_destroy() - Destroy a session and clear its keys.
+ *
+ * The session is not found anymore after the call starts. The call blocks
+ * until all registered readers passed a quiescent state, then the keys are
+ * cleared and the ID can be reused. So it must not be called by an online
+ * reader. Flows of the session become untracked.
+ *
+ * @return 0 on success, -ENOENT if there is no such session.
+ */
+int ffpp_crypto_session_destroy(struct ffpp_crypto *c, uint32_t id);
+
+/**
+ * ffpp_crypto_reader_register() - Register the lcore of a partition as reader
+ * of the sessions and set it online.
+ *
+ * @param c
+ * @param part
+ *
+ * @return 0 on success, -EINVAL if part is out of range.
+ */
+int ffpp_crypto_reader_register(struct ffpp_crypto *c, uint16_t part);
+
+/**
+ * ffpp_crypto_reader_unregister() - Set the reader offline and unregister it.
+ *
+ * @param c
+ * @param part
+ */
+void ffpp_crypto_reader_unregister(struct ffpp_crypto *c, uint16_t part);
+
+/**
+ * ffpp_crypto_quiescent() - Report that the partition holds no session
+ * pointers.
+ *
+ * @param c
+ * @param part
+ */
+void ffpp_crypto_quiescent(struct ffpp_crypto *c, uint16_t part);
+
+/**
+ * ffpp_crypto_session_get() - Get the copy of a session in a partition.
+ *
+ * @param c
+ * @param part: Partition of the calling lcore.
+ * @param id
+ *
+ * @return The session, NULL if there is no such session.
+ */
+struct ffpp_crypto_session *ffpp_crypto_session_get(struct ffpp_crypto *c,
+						    uint16_t part, uint32_t id);
+
+/**
+ * ffpp_crypto_set_default_session() - Set the session of new flows.
+ *
+ * @param c
+ * @param id: FFPP_CRYPTO_SESSION_NONE to pass packets of new flows unchanged.
+ *
+ * @return 0 on success, -ENOENT if there is no such session.
+ */
+int ffpp_crypto_set_default_session(struct ffpp_crypto *c, uint32_t id);
+
+/**
+ * ffpp_crypto_set_flow_session() - Set the session of a flow, the flow is
+ * inserted if it is not in the table.
+ *
+ * @param c
+ * @param part: Partition of the calling lcore.
+ * @param key: The padding must be zero.
+ * @param id
+ *
+ * @return 0 on success, -ENOENT if there is no such session, -ENOSPC if the
+ * partition is full.
+ */
+int ffpp_crypto_set_flow_session(struct ffpp_crypto *c, uint16_t part,
+				 const struct ffpp_cls_5tuple *key,
+				 uint32_t id);
+
+/**
+ * ffpp_crypto_session_iv() - Derive the IV of a sequence number.
+ *
+ * @param s
+ * @param seq
+ * @param iv: AES_BLOCKLEN bytes.
+ */
+void ffpp_crypto_session_iv(const struct ffpp_crypto_session *s, uint64_t seq,
+			    uint8_t *iv);
+
+/**
+ * ffpp_crypto_encrypt() - Encrypt a buffer in place with the next sequence
+ * number of the session.
+ *
+ * @param s
+ * @param buf
+ * @param len: For CBC, only the whole blocks are encrypted.
+ * @param seq: Set to the used sequence number.
+ *
+ * @return 0 on success, -EOVERFLOW if the sequence numbers of the session are
+ * used up.
+ */
+int ffpp_crypto_encrypt(struct ffpp_crypto_session *s, uint8_t *buf,
+			uint32_t len, uint64_t *seq);
+
+/**
+ * ffpp_crypto_decrypt() - Decrypt a buffer in place.
+ *
+ * @param s
+ * @param buf
+ * @param len: For CBC, only the whole blocks are decrypted.
+ * @param seq: Sequence number of the encryption.
+ */
+void ffpp_crypto_decrypt(struct ffpp_crypto_session *s, uint8_t *buf,
+			 uint32_t len, uint64_t seq);
+
+/**
+ * ffpp_crypto_encrypt_mvec() - Encrypt all packets of a vector with one
+ * session.
+ *
+ * CBC packets are encrypted with AES_CBC_encrypt_multi(), so the rounds of
+ * several packets are interleaved.
+ *
+ * @param s
+ * @param vec
+ * @param offset: Start of the encrypted data, for CBC only the whole blocks of
+ * the rest of the first segment are encrypted.
+ * @param seqs: Array with at least vec->len elements, set to the sequence
+ * number of each packet, FFPP_CRYPTO_SEQ_NONE if it is not encrypted.
+ *
+ * @return Number of encrypted packets.
+ */
+uint16_t ffpp_crypto_encrypt_mvec(struct ffpp_crypto_session *s,
+				  struct ffpp_mvec *vec, uint16_t offset,
+				  uint64_t *seqs);
+
+/**
+ * ffpp_crypto_process() - Encrypt or decrypt all packets of a vector with the
+ * sessions of their flows.
+ *
+ * Consecutive CBC packets of the same session are encrypted together, see
+ * ffpp_crypto_encrypt_mvec().
+ *
+ * @param c
+ * @param part: Partition of the calling lcore.
+ * @param vec
+ * @param dir
+ * @param seqs: Array with at least vec->len elements. Encryption sets it to
+ * the sequence number of each packet, decryption reads them.
+ * FFPP_CRYPTO_SEQ_NONE marks the packets that are (or were) not encrypted.
+ *
+ * @return Number of processed packets.
+ */
+uint16_t ffpp_crypto_process(struct ffpp_crypto *c, uint16_t part,
+			     struct ffpp_mvec *vec, enum ffpp_crypto_dir dir,
+			     uint64_t *seqs);
+
+/**
+ * ffpp_crypto_age() - Expire idle flows, see ffpp_flow_age().
+ */
+uint32_t ffpp_crypto_age(struct ffpp_crypto *c, uint16_t part,
+			 uint32_t budget);
+
+/**
+ * ffpp_crypto_get_stats() - Read the counters of a partition.
+ */
+void ffpp_crypto_get_stats(const struct ffpp_crypto *c, uint16_t part,
+			   struct ffpp_crypto_stats *stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !CRYPTO_H */
@@ -0,0 +1,249 @@
+/*
+ * cryptodev.h
+ */
+
+#ifndef CRYPTODEV_H
+#define CRYPTODEV_H
+
+/**
+ * @file
+ *
+ * Offload of the crypto sessions (see crypto.h) to a DPDK cryptodev.
+ *
+ * Any cryptodev with symmetric AES-CBC/AES-CTR (or NULL) ciphers can be used,
+ * e.g. the software PMDs crypto_aesni_mb, crypto_openssl and crypto_null or a
+ * hardware device. The library configures and starts the device with one
+ * queue pair per worker lcore.
+ *
+ * The processing is split into two asynchronous stages on the same lcore:
+ * ffpp_cryptodev_enqueue() turns the packets of a vector into crypto ops,
+ * ffpp_cryptodev_dequeue() (or ffpp_cryptodev_dequeue_tx()) collects the
+ * finished packets later, e.g. in the next iteration of the worker loop. The
+ * packets are processed in place.
+ *
+ * A queue pair must only be used by one lcore. The worker lcores are assigned
+ * to the queue pairs in order at creation, ffpp_cryptodev_set_qp_lcore()
+ * changes the assignment.
+ *
+ * The IVs and sequence numbers are derived like in crypto.h, with the queue
+ * pair as partition, so packets encrypted by a cryptodev can be decrypted by
+ * ffpp_crypto_decrypt() and vice versa.
+ *
+ * Like in crypto.h, the lcores of the queue pairs register as QSBR readers of
+ * the sessions if sessions are destroyed while they enqueue packets. A session
+ * is only destroyed when none of its ops is inflight anymore.
+ *
+ */
+
+#include <stdint.h>
+
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+
+#include <ffpp/collections.h>
+#include <ffpp/crypto.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFPP_CRYPTODEV_NAME_MAX_LEN 20
+#define FFPP_CRYPTODEV_BURST_MAX 64
+#define FFPP_CRYPTODEV_QP_SIZE_DEFAULT 2048
+
+/**
+ * struct ffpp_cryptodev_config - Configuration of a cryptodev offload.
+ */
+struct ffpp_cryptodev_config {
+	char name[FFPP_CRYPTODEV_NAME_MAX_LEN];
+	uint8_t dev_id; /**< Probed but not configured cryptodev */
+	int socket_id;
+	uint16_t nb_qps; /**< Queue pairs, 0 for one per worker lcore */
+	uint32_t qp_size; /**< Descriptors per queue pair, 0 for the default */
+	uint32_t nb_ops; /**< Ops of all queue pairs, 0 for the default */
+	uint32_t max_sessions;
+	// Start of the processed data in the packet, e.g. the UDP payload. The
+	// rest of the first segment is processed, for CBC only whole blocks.
+	uint16_t offset;
+};
+
+/**
+ * struct ffpp_cryptodev_stats - Counters of one queue pair.
+ */
+struct ffpp_cryptodev_stats {
+	uint64_t enqueued;
+	uint64_t dequeued;
+	uint64_t bytes;
+	uint64_t errors; /**< Ops that failed, their packets are freed */
+	uint64_t busy; /**< Packets the queue pair did not accept */
+	uint64_t no_ops; /**< Packets without a crypto op, the pool was empty */
+	uint64_t skipped; /**< Packets without data after the offset */
+	uint64_t seq_exhausted; /**< The session must be replaced */
+	uint32_t inflight;
+};
+
+struct ffpp_cryptodev;
+
+/**
+ * ffpp_cryptodev_create() - Configure and start a cryptodev.
+ *
+ * @param cfg
+ *
+ * @return
+ * - Pointer to the offload on success.
+ * - NULL on failure, rte_errno is set (ENOTSUP if the device has no
+ *   symmetric crypto).
+ */
+struct ffpp_cryptodev *
+ffpp_cryptodev_create(const struct ffpp_cryptodev_config *cfg);
+
+/**
+ * ffpp_cryptodev_free() - Stop the device and free the sessions.
+ *
+ * The packets of inflight ops are lost, dequeue all of them before.
+ *
+ * @param cd
+ */
+void ffpp_cryptodev_free(struct ffpp_cryptodev *cd);
+
+/**
+ * ffpp_cryptodev_session_create() - Create a session on the device.
+ *
+ * @param cd
+ * @param params
+ * @param dir: Sessions of the device have a direction.
+ *
+ * @return The session ID (> 0) on success, -ENOTSUP if the device does not
+ * support the algorithm, -ENOSPC if there are already max_sessions sessions,
+ * another negative errno if the device failed.
+ */
+int ffpp_cryptodev_session_create(
+	struct ffpp_cryptodev *cd,
+	const struct ffpp_crypto_session_params *params,
+	enum ffpp_crypto_dir dir);
+
+/**
+ * ffpp_cryptodev_session_destroy() - Destroy a session and clear its keys.
+ *
+ * The session does not accept packets anymore after the call starts. The call
+ * blocks until all registered readers passed a quiescent state, so it must not
+ * be called by an online reader. If ops of the session are still inflight, the
+ * session is kept and the call must be repeated after they are dequeued.
+ *
+ * @return 0 on success, -ENOENT if there is no such session, -EBUSY if ops of
+ * the session are inflight.
+ */
+int ffpp_cryptodev_session_destroy(struct ffpp_cryptodev *cd, uint32_t id);
+
+/**
+ * ffpp_cryptodev_reader_register() - Register the lcore of a queue pair as
+ * reader of the sessions and set it online.
+ *
+ * @param cd
+ * @param qp
+ *
+ * @return 0 on success, -EINVAL if qp is out of range.
+ */
+int ffpp_cryptodev_reader_register(struct ffpp_cryptodev *cd, uint16_t qp);
+
+/**
+ * ffpp_cryptodev_reader_unregister() - Set the reader offline and unregister
+ * it.
+ *
+ * @param cd
+ * @param qp
+ */
+void ffpp_cryptodev_reader_unregister(struct ffpp_cryptodev *cd, uint16_t qp);
+
+/**
+ * ffpp_cryptodev_quiescent() - Report that the lcore of the queue pair is not
+ * in ffpp_cryptodev_enqueue().
+ *
+ * @param cd
+ * @param qp
+ */
+void ffpp_cryptodev_quiescent(struct ffpp_cryptodev *cd, uint16_t qp);
+
+/**
+ * ffpp_cryptodev_nb_qps() - Get the number of queue pairs.
+ */
+uint16_t ffpp_cryptodev_nb_qps(const struct ffpp_cryptodev *cd);
+
+/**
+ * ffpp_cryptodev_set_qp_lcore() - Assign a queue pair to an lcore.
+ *
+ * The previous lcore of the queue pair and the previous queue pair of the
+ * lcore are unassigned. Not thread safe, call it before the workers run.
+ *
+ * @return 0 on success, -EINVAL for an invalid queue pair or lcore.
+ */
+int ffpp_cryptodev_set_qp_lcore(struct ffpp_cryptodev *cd, uint16_t qp,
+				unsigned int lcore_id);
+
+/**
+ * ffpp_cryptodev_lcore_qp() - Get the queue pair of an lcore.
+ *
+ * @return The queue pair, -ENOENT if the lcore has none.
+ */
+int ffpp_cryptodev_lcore_qp(const struct ffpp_cryptodev *cd,
+			    unsigned int lcore_id);
+
+/**
+ * ffpp_cryptodev_enqueue() - Enqueue the packets of a vector as crypto ops.
+ *
+ * @param cd
+ * @param qp: Queue pair of the calling lcore.
+ * @param id: Session ID.
+ * @param vec: Keeps the packets that are not enqueued, e.g. if the queue pair
+ * is full. The caller can retry, send or drop them.
+ * @param seqs: Only for decryption (NULL for encryption), the sequence number
+ * of each packet. Packets with FFPP_CRYPTO_SEQ_NONE are kept in vec.
+ *
+ * @return Number of enqueued packets.
+ */
+uint16_t ffpp_cryptodev_enqueue(struct ffpp_cryptodev *cd, uint16_t qp,
+				uint32_t id, struct ffpp_mvec *vec,
+				const uint64_t *seqs);
+
+/**
+ * ffpp_cryptodev_dequeue() - Dequeue finished packets.
+ *
+ * The packets of failed ops are freed.
+ *
+ * @param cd
+ * @param qp: Queue pair of the calling lcore.
+ * @param vec: The packets are appended up to its capacity.
+ * @param seqs: NULL or an array with at least vec->capacity elements, the
+ * sequence numbers of the appended packets are written at the same indices.
+ *
+ * @return Number of appended packets.
+ */
+uint16_t ffpp_cryptodev_dequeue(struct ffpp_cryptodev *cd, uint16_t qp,
+				struct ffpp_mvec *vec, uint64_t *seqs);
+
+/**
+ * ffpp_cryptodev_dequeue_tx() - Dequeue finished packets and send them.
+ *
+ * Packets that the port does not accept are freed.
+ *
+ * @param cd
+ * @param qp: Queue pair of the calling lcore.
+ * @param port_id
+ * @param queue_id: TX queue of the calling lcore.
+ *
+ * @return Number of sent packets.
+ */
+uint16_t ffpp_cryptodev_dequeue_tx(struct ffpp_cryptodev *cd, uint16_t qp,
+				   uint16_t port_id, uint16_t queue_id);
+
+/**
+ * ffpp_cryptodev_get_stats() - Read the counters of a queue pair.
+ */
+void ffpp_cryptodev_get_stats(const struct ffpp_cryptodev *cd, uint16_t qp,
+			      struct ffpp_cryptodev_stats *stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !CRYPTODEV_H */
@@ -0,0 +1,138 @@
+/*
+ * cycle_stats.h
+ */
+
+#ifndef CYCLE_STATS_H
+#define CYCLE_STATS_H
+
+/**
+ * @file
+ *
+ * Per-lcore busy/idle TSC cycle accounting of the worker runtime.
+ *
+ * The counters live in a memzone, so external power managers can attach as
+ * DPDK secondary processes and read them without locks. Each lcore entry has a
+ * single writer (the worker lcore) and all counters are monotonic, readers
+ * take two snapshots and use the difference.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <rte_common.h>
+#include <rte_lcore.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFPP_CYCLE_STATS_MZ_NAME "ffpp_cycle_stats"
+#define FFPP_CYCLE_STATS_MAGIC 0xffcc0001
+
+/**
+ * struct ffpp_lcore_cycles - Cycle counters of one lcore.
+ *
+ * idle_cycles: RX polls that returned no packets.
+ * proc_cycles: Non-empty RX polls (or dequeues) and the burst handlers.
+ * tx_cycles: Enqueuing to the TX buffers or rings and flushing them.
+ */
+struct ffpp_lcore_cycles {
+	uint64_t idle_cycles;
+	uint64_t proc_cycles;
+	uint64_t tx_cycles;
+	uint64_t empty_polls;
+	uint64_t busy_polls;
+	uint64_t last_tsc; /**< TSC of the last update */
+	uint32_t active; /**< The lcore runs a worker loop */
+} __rte_cache_aligned;
+
+/**
+ * struct ffpp_cycle_stats - Layout of the shared memzone.
+ */
+struct ffpp_cycle_stats {
+	uint32_t magic;
+	uint64_t tsc_hz;
+	struct ffpp_lcore_cycles lcores[RTE_MAX_LCORE];
+};
+
+/**
+ * ffpp_cycle_stats_get() - Reserve the memzone, or look it up if it already
+ * exists (e.g. in a secondary process).
+ *
+ * @return
+ * - Pointer to the stats on success.
+ * - NULL on failure, rte_errno is set.
+ */
+struct ffpp_cycle_stats *ffpp_cycle_stats_get(void);
+
+/**
+ * ffpp_cycle_stats_attach() - Look up the memzone created by a ffpp process.
+ *
+ * @return
+ * - Pointer to the stats on success.
+ * - NULL if no ffpp workers runtime is running.
+ */
+struct ffpp_cycle_stats *ffpp_cycle_stats_attach(void);
+
+/**
+ * ffpp_cycle_stats_read() - Take a snapshot of the counters of an lcore.
+ *
+ * @param cs
+ * @param lcore_id
+ * @param snap
+ */
+void ffpp_cycle_stats_read(const struct ffpp_cycle_stats *cs,
+			   unsigned int lcore_id, struct ffpp_lcore_cycles *snap);
+
+/**
+ * ffpp_cycle_stats_busy_ratio() - Busy fraction between two snapshots.
+ *
+ * @param prev
+ * @param cur
+ *
+ * @return (proc + tx) / (idle + proc + tx) cycles, 0 if the lcore did not poll
+ * in between.
+ */
+double ffpp_cycle_stats_busy_ratio(const struct ffpp_lcore_cycles *prev,
+				   const struct ffpp_lcore_cycles *cur);
+
+/* Writer side, only called by the lcore that owns the entry. */
+
+static __rte_always_inline void
+ffpp_lcore_cycles_add(uint64_t *counter, uint64_t value)
+{
+	__atomic_store_n(counter, *counter + value, __ATOMIC_RELAXED);
+}
+
+static __rte_always_inline void
+ffpp_lcore_cycles_poll(struct ffpp_lcore_cycles *c, bool empty,
+		       uint64_t cycles, uint64_t now)
+{
+	if (empty) {
+		ffpp_lcore_cycles_add(&c->idle_cycles, cycles);
+		ffpp_lcore_cycles_add(&c->empty_polls, 1);
+	} else {
+		ffpp_lcore_cycles_add(&c->proc_cycles, cycles);
+		ffpp_lcore_cycles_add(&c->busy_polls, 1);
+	}
+	__atomic_store_n(&c->last_tsc, now, __ATOMIC_RELAXED);
+}
+
+static __rte_always_inline void
+ffpp_lcore_cycles_proc(struct ffpp_lcore_cycles *c, uint64_t cycles)
+{
+	ffpp_lcore_cycles_add(&c->proc_cycles, cycles);
+}
+
+static __rte_always_inline void
+ffpp_lcore_cycles_tx(struct ffpp_lcore_cycles *c, uint64_t cycles)
+{
+	ffpp_lcore_cycles_add(&c->tx_cycles, cycles);
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !CYCLE_STATS_H */
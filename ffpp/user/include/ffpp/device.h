@@ -12,7 +12,91 @@
  *
  */
 
+#include <net/if.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define FFPP_MAX_PORTS 8
+#define FFPP_MAX_QUEUES_PER_PORT 16
+
+/**
+ * enum ffpp_dpdk_device_type - Backend of a ffpp port.
+ *
+ * FFPP_DPDK_DEVICE_ETHDEV ports are probed by the EAL (PCI devices or --vdev
+ * arguments) and identified by port_id. All other types are virtual devices
+ * created by ffpp_dpdk_init_device(), the assigned port ID is written back to
+ * the port_id field.
+ */
+enum ffpp_dpdk_device_type {
+	FFPP_DPDK_DEVICE_ETHDEV = 0,
+	FFPP_DPDK_DEVICE_AF_XDP,
+	FFPP_DPDK_DEVICE_VHOST_USER,
+	FFPP_DPDK_DEVICE_VIRTIO_USER,
+};
+
+/**
+ * enum ffpp_af_xdp_mode - UMEM mode of the AF_XDP sockets.
+ *
+ * AUTO lets the kernel choose zero-copy when the driver supports it, virtual
+ * interfaces (veth, tap...) always use copy mode. The net_af_xdp PMD can not
+ * require zero-copy, so there is no such mode. COPY forces the copy mode, this
+ * requires DPDK >= 22.11.
+ */
+enum ffpp_af_xdp_mode {
+	FFPP_AF_XDP_MODE_AUTO = 0,
+	FFPP_AF_XDP_MODE_COPY,
+};
+
+// Same as the default of the net_af_xdp PMD.
+#define FFPP_AF_XDP_BUSY_BUDGET_DEFAULT 64
+
+/**
+ * struct ffpp_af_xdp_config - AF_XDP specific port configuration.
+ *
+ * One AF_XDP socket is created for each RX queue, bound to the interface
+ * queues [start_queue, start_queue + rx_queues).
+ */
+struct ffpp_af_xdp_config {
+	char iface[IF_NAMESIZE];
+	uint16_t start_queue;
+	enum ffpp_af_xdp_mode mode;
+	// Preferred busy polling (kernel >= 5.11). 0 disables busy polling.
+	uint16_t busy_budget;
+	// Share one UMEM between all sockets using the same mempool.
+	bool shared_umem;
+	// Optional path of a custom XDP program. The built-in redirect program
+	// of libbpf is used if NULL.
+	const char *xdp_prog;
+};
+
+// Same as the size of sun_path in struct sockaddr_un.
+#define FFPP_VHOST_PATH_MAX 108
+
+/**
+ * struct ffpp_vhost_config - vhost-user/virtio-user port configuration.
+ *
+ * Two MuNFs are connected through a unix socket: one side creates a
+ * FFPP_DPDK_DEVICE_VHOST_USER port (the backend), the other side creates a
+ * FFPP_DPDK_DEVICE_VIRTIO_USER port (the frontend) on the same path. Each side
+ * runs its own EAL, so no shared primary process is needed. The number of
+ * queue pairs is the rx_queues of the device config.
+ */
+struct ffpp_vhost_config {
+	char path[FFPP_VHOST_PATH_MAX];
+	// This side creates and listens on the socket. The backend is the
+	// server by default, so the frontend must be the client.
+	bool server;
+	// Negotiate VIRTIO_NET_F_MRG_RXBUF (frontend only).
+	bool mrg_rxbuf;
+	// Use packed virtqueues instead of split ones (frontend only).
+	bool packed_vq;
+	// Virtqueue size (frontend only), 0 to use the PMD default.
+	uint16_t queue_size;
+};
 
 /**
  * struct ffpp_dpdk_device_config - DPDK device configuration
@@ -26,23 +110,49 @@ struct ffpp_dpdk_device_config {
 	uint16_t tx_descs;
 	uint8_t drop_enabled;
 	uint8_t disable_offloads;
+	// Sent packets can have a reference count > 1, e.g. when they are
+	// mirrored with clones. Disables DEV_TX_OFFLOAD_MBUF_FAST_FREE.
+	uint8_t shared_mbufs;
+	enum ffpp_dpdk_device_type type;
+	union {
+		struct ffpp_af_xdp_config af_xdp;
+		struct ffpp_vhost_config vhost;
+	};
 };
 
 /**
  * ffpp_dpdk_init_device() - Initialize a Ethernet device.
  *
+ * Virtual devices (see enum ffpp_dpdk_device_type) are created first. Every
+ * RX queue uses the same mempool. RSS is enabled when more than one RX queue
+ * is requested and the device supports it.
+ *
  * @param cfg: Device configuration packed in a ffpp_dpdk_device_config struct
  *
  * @return: Flag
  */
 int ffpp_dpdk_init_device(struct ffpp_dpdk_device_config *cfg);
 
+/**
+ * ffpp_dpdk_get_tx_offloads() - TX offloads (DEV_TX_OFFLOAD_*) enabled on a
+ * port by ffpp_dpdk_init_device().
+ *
+ * Checksum offloads are enabled when the port supports them, unless
+ * disable_offloads is set in the device config.
+ *
+ * @param port_id
+ *
+ * @return The offload flags, 0 for ports that are not initialized by ffpp.
+ */
+uint64_t ffpp_dpdk_get_tx_offloads(uint16_t port_id);
+
 /**
  * ffpp_dpdk_cleanup_devices - Cleanup all initialized Ethernet devices.
  */
 void ffpp_dpdk_cleanup_devices(void);
 
 struct rx_queue {
+	uint16_t port_idx; /**< Index of the port in the worker config */
 	uint16_t id;
 };
 
@@ -51,4 +161,8 @@ struct tx_queue {
 	uint16_t len;
 };
 
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
 #endif /* !DEVICE_H */
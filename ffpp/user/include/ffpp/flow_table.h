@@ -0,0 +1,184 @@
+/*
+ * flow_table.h
+ */
+
+#ifndef FLOW_TABLE_H
+#define FLOW_TABLE_H
+
+/**
+ * @file
+ *
+ * Connection tracking table with per-flow state for stateful VNFs.
+ *
+ * The table is split into partitions, one per worker lcore. A partition is
+ * only accessed by its lcore, so there are no locks; the flows must be steered
+ * to the lcores consistently, e.g. by RSS. Each partition is an open-addressed
+ * hash table of cache line sized buckets with 16-bit signatures, so a lookup
+ * touches one bucket line and one entry line in the common case. Keys of a
+ * whole burst are looked up in stages (hash, bucket, entry) with prefetching.
+ *
+ * Idle flows are expired by a hierarchical timer wheel. ffpp_flow_age()
+ * advances the wheel by a bounded amount of work per call, so it can be called
+ * after each burst without latency spikes.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <ffpp/classifier.h>
+#include <ffpp/collections.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFPP_FLOW_NAME_MAX_LEN 24
+#define FFPP_FLOW_BULK_MAX 64
+#define FFPP_FLOW_TICK_US_DEFAULT 1000
+#define FFPP_FLOW_TIMEOUT_US_DEFAULT (30ULL * 1000 * 1000)
+#define FFPP_FLOW_AGE_BUDGET_DEFAULT 64
+
+/**
+ * Called for each expired flow, before its entry is reused.
+ */
+typedef void (*ffpp_flow_expire_t)(const struct ffpp_cls_5tuple *key,
+				   void *data, void *arg);
+
+/**
+ * struct ffpp_flow_table_config - Configuration of a flow table.
+ */
+struct ffpp_flow_table_config {
+	char name[FFPP_FLOW_NAME_MAX_LEN];
+	int socket_id;
+	uint16_t nb_parts; /**< Number of partitions (worker lcores) */
+	uint32_t max_flows; /**< Maximal number of flows per partition */
+	uint32_t data_size; /**< Bytes of state per flow */
+	uint64_t timeout_us; /**< Idle timeout, 0 to use the default */
+	uint64_t tick_us; /**< Timer wheel resolution, 0 to use the default */
+	ffpp_flow_expire_t expire_cb; /**< Optional */
+	void *expire_arg;
+};
+
+/**
+ * struct ffpp_flow_stats - Counters of one partition.
+ */
+struct ffpp_flow_stats {
+	uint32_t nb_flows;
+	uint64_t inserts;
+	uint64_t insert_failures; /**< Partition or probed buckets full */
+	uint64_t expired;
+};
+
+struct ffpp_flow_table;
+
+/**
+ * ffpp_flow_table_create() - Create a flow table.
+ *
+ * @param cfg
+ *
+ * @return
+ * - Pointer to the table on success.
+ * - NULL on failure, rte_errno is set.
+ */
+struct ffpp_flow_table *
+ffpp_flow_table_create(const struct ffpp_flow_table_config *cfg);
+
+/**
+ * ffpp_flow_table_free() - Free a flow table. The expire callback is not
+ * called for the remaining flows.
+ *
+ * @param tbl
+ */
+void ffpp_flow_table_free(struct ffpp_flow_table *tbl);
+
+/**
+ * ffpp_flow_lookup_bulk() - Look up flows and refresh their idle timers.
+ *
+ * @param tbl
+ * @param part: Partition of the calling lcore.
+ * @param keys: The padding must be zero.
+ * @param n: At most FFPP_FLOW_BULK_MAX.
+ * @param data: Set to the state of each flow, NULL if it is not in the table.
+ *
+ * @return Number of found flows.
+ */
+uint16_t ffpp_flow_lookup_bulk(struct ffpp_flow_table *tbl, uint16_t part,
+			       const struct ffpp_cls_5tuple *keys, uint16_t n,
+			       void **data);
+
+/**
+ * ffpp_flow_insert_bulk() - Look up flows and insert the missing ones.
+ *
+ * The state of a new flow is zeroed. Keys that appear more than once in the
+ * burst get the same state.
+ *
+ * @param tbl
+ * @param part: Partition of the calling lcore.
+ * @param keys: The padding must be zero.
+ * @param n: At most FFPP_FLOW_BULK_MAX.
+ * @param data: Set to the state of each flow, NULL if it could not be
+ * inserted.
+ *
+ * @return Number of flows with state.
+ */
+uint16_t ffpp_flow_insert_bulk(struct ffpp_flow_table *tbl, uint16_t part,
+			       const struct ffpp_cls_5tuple *keys, uint16_t n,
+			       void **data);
+
+/**
+ * ffpp_flow_lookup_mvec() - Look up (and optionally insert) the flows of all
+ * packets of a vector.
+ *
+ * The keys are extracted with ffpp_cls_5tuple_of(), other than IPv4 packets
+ * get no state.
+ *
+ * @param tbl
+ * @param part: Partition of the calling lcore.
+ * @param vec
+ * @param data: Array with at least vec->len elements.
+ * @param insert: Insert the missing flows.
+ *
+ * @return Number of packets with state.
+ */
+uint16_t ffpp_flow_lookup_mvec(struct ffpp_flow_table *tbl, uint16_t part,
+			       const struct ffpp_mvec *vec, void **data,
+			       bool insert);
+
+/**
+ * ffpp_flow_del() - Delete a flow, e.g. after a TCP FIN. The expire callback
+ * is not called.
+ *
+ * @return 0 on success, -ENOENT if the flow is not in the table.
+ */
+int ffpp_flow_del(struct ffpp_flow_table *tbl, uint16_t part,
+		  const struct ffpp_cls_5tuple *key);
+
+/**
+ * ffpp_flow_age() - Advance the timer wheel of a partition to the current
+ * time and expire idle flows.
+ *
+ * Each advanced tick and each visited entry counts as one unit of work. The
+ * call returns when the budget is used up and continues from there the next
+ * time.
+ *
+ * @param tbl
+ * @param part
+ * @param budget: Work units, e.g. FFPP_FLOW_AGE_BUDGET_DEFAULT.
+ *
+ * @return Number of expired flows.
+ */
+uint32_t ffpp_flow_age(struct ffpp_flow_table *tbl, uint16_t part,
+		       uint32_t budget);
+
+/**
+ * ffpp_flow_get_stats() - Read the counters of a partition.
+ */
+void ffpp_flow_get_stats(const struct ffpp_flow_table *tbl, uint16_t part,
+			 struct ffpp_flow_stats *stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !FLOW_TABLE_H */
@@ -0,0 +1,158 @@
+/*
+ * gcm.h
+ */
+
+#ifndef GCM_H
+#define GCM_H
+
+/**
+ * @file
+ *
+ * AES-GCM packet processor for the payloads of VNF packets.
+ *
+ * The payload after cfg->offset (e.g. the UDP payload) is encrypted and
+ * authenticated in one pass (see AES_GCM_encrypt_multi() in aes.h), so no
+ * separate HMAC is needed. Encryption pushes a header with the sequence number
+ * and the tag in front of the payload, decryption verifies the tag and pulls
+ * the header again. Packets with an invalid tag are freed.
+ *
+ * Packet after encryption:
+ *
+ *	| headers (offset) | seq (8) | tag (16) | encrypted payload |
+ *
+ * The IV of a packet is the 4-byte salt followed by the sequence number, the
+ * sequence number is also the additional authenticated data. The sequence
+ * numbers are counted per partition, the upper 16 bits are the partition (like
+ * in crypto.h), so lcores never use the same IV. Replays are not detected.
+ *
+ * For an untagged IPv4/UDP packet whose payload starts at the offset, the
+ * lengths and the IPv4 checksum are updated and the UDP checksum is cleared.
+ *
+ * Small packets are processed more efficiently together. Therefore, the
+ * packets are gathered in a batch of each partition across bursts until it has
+ * cfg->batch_size packets. Call ffpp_gcm_flush() when no packets are received
+ * to bound the latency.
+ *
+ */
+
+#include <stdint.h>
+
+#include <rte_byteorder.h>
+#include <rte_common.h>
+
+#include <ffpp/aes.h>
+#include <ffpp/collections.h>
+#include <ffpp/crypto.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFPP_GCM_NAME_MAX_LEN 20
+#define FFPP_GCM_SALT_LEN 4
+#define FFPP_GCM_BATCH_MAX 64
+#define FFPP_GCM_BATCH_DEFAULT 32
+
+/**
+ * struct ffpp_gcm_hdr - Header in front of an encrypted payload.
+ */
+struct ffpp_gcm_hdr {
+	rte_be64_t seq;
+	uint8_t tag[AES_GCM_TAGLEN];
+} __rte_packed;
+
+#define FFPP_GCM_HDR_LEN (sizeof(struct ffpp_gcm_hdr))
+
+/**
+ * struct ffpp_gcm_config - Configuration of a GCM processor.
+ */
+struct ffpp_gcm_config {
+	char name[FFPP_GCM_NAME_MAX_LEN];
+	int socket_id;
+	uint16_t nb_parts; /**< Number of partitions (worker lcores) */
+	// Start of the payload in the packet, e.g. the UDP payload. Only
+	// packets with one segment are processed.
+	uint16_t offset;
+	uint16_t batch_size; /**< Up to FFPP_GCM_BATCH_MAX, 0 for the default */
+	enum ffpp_crypto_dir dir;
+	uint8_t key[AES_KEYLEN];
+	uint8_t salt[FFPP_GCM_SALT_LEN];
+};
+
+/**
+ * struct ffpp_gcm_stats - Counters of one partition.
+ */
+struct ffpp_gcm_stats {
+	uint64_t encrypted;
+	uint64_t decrypted;
+	uint64_t bytes; /**< Processed payload bytes */
+	uint64_t batches;
+	uint64_t auth_failed; /**< Invalid tags, the packets are freed */
+	// Packets that are too short, have several segments or no headroom,
+	// they are freed.
+	uint64_t dropped;
+	uint64_t seq_exhausted; /**< The key must be replaced */
+	uint32_t pending; /**< Packets in the batch */
+};
+
+struct ffpp_gcm;
+
+/**
+ * ffpp_gcm_create() - Create a GCM processor and expand its key.
+ *
+ * @param cfg
+ *
+ * @return
+ * - Pointer to the processor on success.
+ * - NULL on failure, rte_errno is set.
+ */
+struct ffpp_gcm *ffpp_gcm_create(const struct ffpp_gcm_config *cfg);
+
+/**
+ * ffpp_gcm_free() - Free a processor, the key is cleared.
+ *
+ * The packets in the batches are freed.
+ *
+ * @param g
+ */
+void ffpp_gcm_free(struct ffpp_gcm *g);
+
+/**
+ * ffpp_gcm_process() - Add the packets of a vector to the batch of a partition
+ * and process the batch when it is full.
+ *
+ * @param g
+ * @param part: Partition of the calling lcore.
+ * @param vec: The packets are moved into the batch. It keeps the packets that
+ * do not fit, i.e. if the batch is full and out has not enough room for it.
+ * @param out: The processed packets are appended.
+ *
+ * @return Number of appended packets.
+ */
+uint16_t ffpp_gcm_process(struct ffpp_gcm *g, uint16_t part,
+			  struct ffpp_mvec *vec, struct ffpp_mvec *out);
+
+/**
+ * ffpp_gcm_flush() - Process the packets in the batch of a partition.
+ *
+ * @param g
+ * @param part: Partition of the calling lcore.
+ * @param out: The processed packets are appended up to its capacity, the
+ * others stay in the batch.
+ *
+ * @return Number of appended packets.
+ */
+uint16_t ffpp_gcm_flush(struct ffpp_gcm *g, uint16_t part,
+			struct ffpp_mvec *out);
+
+/**
+ * ffpp_gcm_get_stats() - Read the counters of a partition.
+ */
+void ffpp_gcm_get_stats(const struct ffpp_gcm *g, uint16_t part,
+			struct ffpp_gcm_stats *stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !GCM_H */
@@ -0,0 +1,251 @@
+/*
+ * graph.h
+ */
+
+#ifndef GRAPH_H
+#define GRAPH_H
+
+/**
+ * @file
+ *
+ * ffpp processors as rte_graph nodes.
+ *
+ * A VNF is declared as a chain of processing nodes between the Ethernet RX and
+ * TX nodes:
+ *
+ *   ffpp_eth_rx -> nodes[0] -> ... -> nodes[n-1] -> ffpp_classify
+ *                                                   -> ffpp_eth_tx (per port)
+ *
+ * The classify node selects the TX port of each packet. Every node has the
+ * ffpp_drop node as edge 0, packets dropped by a node are freed there.
+ *
+ * The nodes are cloned for each VNF, so several VNFs with different
+ * configurations can exist at the same time. One graph is created for each
+ * used worker lcore, the (port, RX queue) pairs are spread over the graphs
+ * like in the run-to-completion mode of the worker runtime (see task.h). All
+ * graphs share the processing nodes, each graph transmits on its own TX queue.
+ *
+ * A MuNF endpoint node sends the packets to the RX ring of a registered MuNF
+ * (see munf.h). The packets coming back on the TX ring of the MuNF continue
+ * with the next node. The rings are single-producer/single-consumer, so a VNF
+ * with a MuNF endpoint runs on one lcore.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <rte_ether.h>
+#include <rte_graph.h>
+#include <rte_mbuf.h>
+
+#include <ffpp/aes.h>
+#include <ffpp/device.h>
+#include <ffpp/munf.h>
+#include <ffpp/task.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFPP_GRAPH_MAX_NODES 8 /**< Processing nodes of a VNF */
+#define FFPP_GRAPH_NAME_MAX_LEN 16
+#define FFPP_GRAPH_RX_BURST_DEFAULT 32
+
+/**
+ * Edges of all ffpp nodes. Source nodes and the TX nodes only use the drop
+ * edge for packets they can not send.
+ */
+enum ffpp_graph_edge {
+	FFPP_GRAPH_EDGE_DROP = 0,
+	FFPP_GRAPH_EDGE_NEXT,
+};
+
+/**
+ * Type of a processing node.
+ *
+ * FFPP_GRAPH_NODE_HANDLER: Any burst handler of the worker runtime, e.g. a
+ * fused chain of chain.h. Packets after the returned count are dropped.
+ *
+ * FFPP_GRAPH_NODE_REWRITE_DL: ffpp_pp_rewrite_dl().
+ *
+ * FFPP_GRAPH_NODE_UPDATE_DL_SRC: ffpp_pp_update_dl_src(), e.g. with the MAC
+ * address of the TX port like the loop of mp_munf_mono.
+ *
+ * FFPP_GRAPH_NODE_DEC_TTL: ffpp_pp_dec_ttl(), expired packets are dropped.
+ *
+ * FFPP_GRAPH_NODE_AES: AES-CBC encryption and decryption of each packet.
+ *
+ * FFPP_GRAPH_NODE_MUNF: MuNF ring endpoint.
+ */
+enum ffpp_graph_node_type {
+	FFPP_GRAPH_NODE_HANDLER = 0,
+	FFPP_GRAPH_NODE_REWRITE_DL,
+	FFPP_GRAPH_NODE_UPDATE_DL_SRC,
+	FFPP_GRAPH_NODE_DEC_TTL,
+	FFPP_GRAPH_NODE_AES,
+	FFPP_GRAPH_NODE_MUNF,
+};
+
+/**
+ * struct ffpp_graph_aes_conf - Configuration of an AES node.
+ *
+ * [offset, offset + len) of each packet is encrypted and decrypted again, the
+ * range is cut at the end of the first segment and aligned down to
+ * AES_BLOCKLEN.
+ */
+struct ffpp_graph_aes_conf {
+	uint8_t key[AES_KEYLEN];
+	uint8_t iv[AES_BLOCKLEN];
+	uint16_t offset;
+	uint16_t len;
+};
+
+/**
+ * struct ffpp_graph_node_conf - Configuration of a processing node.
+ */
+struct ffpp_graph_node_conf {
+	enum ffpp_graph_node_type type;
+	union {
+		struct {
+			ffpp_burst_handler_t func;
+			void *arg;
+		} handler;
+		struct {
+			struct rte_ether_addr src;
+			struct rte_ether_addr dst;
+		} rewrite_dl;
+		struct rte_ether_addr dl_src;
+		struct ffpp_graph_aes_conf aes;
+		// Returned by ffpp_munf_register().
+		struct ffpp_munf_data munf;
+	};
+};
+
+/**
+ * Classification callback of the classify node.
+ *
+ * @param m
+ * @param arg: classify_arg of the config.
+ *
+ * @return Index in port_ids of the TX port, or a negative value to drop the
+ * packet.
+ */
+typedef int (*ffpp_graph_classify_t)(struct rte_mbuf *m, void *arg);
+
+/**
+ * struct ffpp_graph_config - Declaration of a VNF.
+ *
+ * Ports must be initialized before the VNF is created. Every port needs one
+ * TX queue per used worker lcore.
+ */
+struct ffpp_graph_config {
+	char name[FFPP_GRAPH_NAME_MAX_LEN];
+	uint16_t nb_ports;
+	uint16_t port_ids[FFPP_MAX_PORTS];
+	// Used without classify callback: Packets received on port_ids[i] are
+	// sent to port_ids[tx_port_map[i]].
+	uint16_t tx_port_map[FFPP_MAX_PORTS];
+	uint16_t nb_rx_queues; /**< RX queues of each port */
+	uint16_t nb_tx_queues; /**< TX queues of each port */
+	uint16_t burst_size; /**< RX burst size, 0 to use the default */
+	uint16_t nb_lcores; /**< Maximal worker lcores to use, 0: all */
+	uint16_t nb_nodes;
+	struct ffpp_graph_node_conf nodes[FFPP_GRAPH_MAX_NODES];
+	ffpp_graph_classify_t classify;
+	void *classify_arg;
+};
+
+/**
+ * struct ffpp_graph_stats - Counters of a VNF summed over all graphs.
+ */
+struct ffpp_graph_stats {
+	uint64_t rx_pkts;
+	uint64_t tx_pkts;
+	uint64_t dropped; /**< Dropped by nodes or TX queue full */
+};
+
+struct ffpp_graph_vnf;
+
+/**
+ * ffpp_graph_vnf_create() - Clone the nodes of a VNF and create one graph per
+ * used worker lcore.
+ *
+ * Must be called on the main lcore. The node clones can not be released in
+ * DPDK, they are reused if a VNF with the same name is created again.
+ *
+ * @param cfg
+ *
+ * @return
+ * - Pointer to the VNF on success.
+ * - NULL on failure, rte_errno is set.
+ */
+struct ffpp_graph_vnf *
+ffpp_graph_vnf_create(const struct ffpp_graph_config *cfg);
+
+/**
+ * ffpp_graph_vnf_launch() - Walk the graphs on their worker lcores.
+ *
+ * @param vnf
+ *
+ * @return 0 on success, -1 if a lcore is busy.
+ */
+int ffpp_graph_vnf_launch(struct ffpp_graph_vnf *vnf);
+
+/**
+ * ffpp_graph_vnf_stop() - Stop the walks and wait until all lcores returned.
+ *
+ * @param vnf
+ */
+void ffpp_graph_vnf_stop(struct ffpp_graph_vnf *vnf);
+
+/**
+ * ffpp_graph_vnf_nb_graphs() - Number of graphs (used worker lcores).
+ *
+ * @param vnf
+ */
+uint16_t ffpp_graph_vnf_nb_graphs(const struct ffpp_graph_vnf *vnf);
+
+/**
+ * ffpp_graph_vnf_get_graph() - Get a graph of the VNF, e.g. to walk it on
+ * an own lcore instead of ffpp_graph_vnf_launch().
+ *
+ * @param vnf
+ * @param idx: 0 to ffpp_graph_vnf_nb_graphs() - 1.
+ *
+ * @return Pointer to the graph, NULL if idx is invalid.
+ */
+struct rte_graph *ffpp_graph_vnf_get_graph(const struct ffpp_graph_vnf *vnf,
+					   uint16_t idx);
+
+/**
+ * ffpp_graph_vnf_get_stats() - Sum up the node counters of all graphs.
+ *
+ * @param vnf
+ * @param stats
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int ffpp_graph_vnf_get_stats(const struct ffpp_graph_vnf *vnf,
+			     struct ffpp_graph_stats *stats);
+
+/**
+ * ffpp_graph_vnf_print_stats() - Print the per-node statistics of rte_graph
+ * (objects, calls and cycles) of all graphs.
+ *
+ * @param vnf
+ */
+void ffpp_graph_vnf_print_stats(const struct ffpp_graph_vnf *vnf);
+
+/**
+ * ffpp_graph_vnf_destroy() - Destroy the graphs. The VNF must be stopped.
+ *
+ * @param vnf
+ */
+void ffpp_graph_vnf_destroy(struct ffpp_graph_vnf *vnf);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !GRAPH_H */
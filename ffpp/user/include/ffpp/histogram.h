@@ -0,0 +1,224 @@
+/*
+ * histogram.h
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+/**
+ * @file
+ *
+ * Fixed-memory latency histogram with log-linear buckets (like HdrHistogram).
+ *
+ * Values below 2^FFPP_HIST_SUB_BITS have their own bucket. Above, each power
+ * of two is split into 2^(FFPP_HIST_SUB_BITS - 1) linear buckets, so the
+ * relative error of a reported value is below 2^-(FFPP_HIST_SUB_BITS - 1)
+ * over the whole uint64_t range. Values are usually TSC cycles.
+ *
+ * A histogram has a single writer, e.g. one instance per worker lcore.
+ * Counters are written with relaxed atomic stores, so other threads can take
+ * a snapshot at any time and merge snapshots of several lcores without locks.
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFPP_HIST_SUB_BITS 7
+#define FFPP_HIST_LINEAR_MAX (1U << FFPP_HIST_SUB_BITS)
+#define FFPP_HIST_SUB_BUCKETS (1U << (FFPP_HIST_SUB_BITS - 1))
+#define FFPP_HIST_NB_BUCKETS                                                   \
+	((64 - FFPP_HIST_SUB_BITS + 2) * FFPP_HIST_SUB_BUCKETS)
+
+struct ffpp_hist {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min; /**< UINT64_MAX if empty */
+	uint64_t max;
+	uint64_t buckets[FFPP_HIST_NB_BUCKETS];
+} __rte_cache_aligned;
+
+struct ffpp_hist_summary {
+	uint64_t count;
+	double mean;
+	uint64_t min;
+	uint64_t p50;
+	uint64_t p99;
+	uint64_t p999;
+	uint64_t max;
+};
+
+static __rte_always_inline uint32_t ffpp_hist_index(uint64_t value)
+{
+	uint32_t shift;
+
+	if (value < FFPP_HIST_LINEAR_MAX) {
+		return (uint32_t)value;
+	}
+	shift = 63 - __builtin_clzll(value) - (FFPP_HIST_SUB_BITS - 1);
+	return (shift << (FFPP_HIST_SUB_BITS - 1)) + (uint32_t)(value >> shift);
+}
+
+/**
+ * ffpp_hist_record_n() - Record n samples of the same value (writer only).
+ *
+ * @param h
+ * @param value
+ * @param n
+ */
+static __rte_always_inline void ffpp_hist_record_n(struct ffpp_hist *h,
+						   uint64_t value, uint64_t n)
+{
+	uint32_t i = ffpp_hist_index(value);
+
+	__atomic_store_n(&h->buckets[i], h->buckets[i] + n, __ATOMIC_RELAXED);
+	__atomic_store_n(&h->sum, h->sum + value * n, __ATOMIC_RELAXED);
+	if (unlikely(value < h->min)) {
+		__atomic_store_n(&h->min, value, __ATOMIC_RELAXED);
+	}
+	if (unlikely(value > h->max)) {
+		__atomic_store_n(&h->max, value, __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&h->count, h->count + n, __ATOMIC_RELAXED);
+}
+
+/**
+ * ffpp_hist_record() - Record one sample (writer only).
+ *
+ * @param h
+ * @param value
+ */
+static __rte_always_inline void ffpp_hist_record(struct ffpp_hist *h,
+						 uint64_t value)
+{
+	ffpp_hist_record_n(h, value, 1);
+}
+
+/**
+ * ffpp_hist_init() - Initialize an empty histogram, e.g. on the stack.
+ *
+ * @param h
+ */
+void ffpp_hist_init(struct ffpp_hist *h);
+
+/**
+ * ffpp_hist_create() - Allocate an empty histogram on the given socket.
+ *
+ * @param socket_id
+ *
+ * @return The histogram, NULL on failure with rte_errno set.
+ */
+struct ffpp_hist *ffpp_hist_create(int socket_id);
+
+/**
+ * ffpp_hist_free() - Free a histogram of ffpp_hist_create().
+ *
+ * @param h
+ */
+void ffpp_hist_free(struct ffpp_hist *h);
+
+/**
+ * ffpp_hist_reset() - Remove all samples (writer only).
+ *
+ * @param h
+ */
+void ffpp_hist_reset(struct ffpp_hist *h);
+
+/**
+ * ffpp_hist_snapshot() - Copy a histogram that is written by another lcore.
+ *
+ * The count of the snapshot is the sum of the copied buckets, so the
+ * quantiles of the snapshot are consistent.
+ *
+ * @param h
+ * @param snap
+ */
+void ffpp_hist_snapshot(const struct ffpp_hist *h, struct ffpp_hist *snap);
+
+/**
+ * ffpp_hist_merge() - Add the samples of src to dst.
+ *
+ * src can be written by another lcore, dst must not.
+ *
+ * @param dst
+ * @param src
+ */
+void ffpp_hist_merge(struct ffpp_hist *dst, const struct ffpp_hist *src);
+
+/**
+ * ffpp_hist_quantile() - Get the value at a quantile.
+ *
+ * @param h
+ * @param q: In [0, 1], e.g. 0.99 for the 99th percentile.
+ *
+ * @return The highest value of the bucket that contains the quantile (at most
+ * the maximum), 0 if the histogram is empty.
+ */
+uint64_t ffpp_hist_quantile(const struct ffpp_hist *h, double q);
+
+/**
+ * ffpp_hist_summarize() - Get count, mean, min, p50, p99, p99.9 and max.
+ *
+ * @param h
+ * @param s
+ */
+void ffpp_hist_summarize(const struct ffpp_hist *h,
+			 struct ffpp_hist_summary *s);
+
+/**
+ * ffpp_hist_print() - Print the summary as a CSV line.
+ *
+ * Format: name,count,mean,min,p50,p99,p999,max
+ *
+ * @param f
+ * @param name
+ * @param h
+ * @param tsc_hz: Values are converted from cycles to microseconds, 0 to print
+ * the raw values.
+ */
+void ffpp_hist_print(FILE *f, const char *name, const struct ffpp_hist *h,
+		     uint64_t tsc_hz);
+
+/**
+ * ffpp_hist_serialized_size() - Bytes needed by ffpp_hist_serialize().
+ *
+ * @param h
+ */
+size_t ffpp_hist_serialized_size(const struct ffpp_hist *h);
+
+/**
+ * ffpp_hist_serialize() - Encode a histogram, only non-empty buckets are
+ * stored.
+ *
+ * @param h: Must not be written concurrently, serialize a snapshot.
+ * @param buf
+ * @param len
+ *
+ * @return The number of written bytes, -ENOSPC if len is too small.
+ */
+int ffpp_hist_serialize(const struct ffpp_hist *h, void *buf, size_t len);
+
+/**
+ * ffpp_hist_deserialize() - Decode a histogram of ffpp_hist_serialize().
+ *
+ * @param h: Overwritten.
+ * @param buf
+ * @param len
+ *
+ * @return 0 on success, -EINVAL if buf is not a valid encoding.
+ */
+int ffpp_hist_deserialize(struct ffpp_hist *h, const void *buf, size_t len);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !HISTOGRAM_H */
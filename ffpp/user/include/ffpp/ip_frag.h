@@ -0,0 +1,140 @@
+/*
+ * ip_frag.h
+ */
+
+#ifndef IP_FRAG_H
+#define IP_FRAG_H
+
+/**
+ * @file
+ *
+ * IPv4 fragmentation and reassembly based on rte_ip_frag.
+ *
+ * Processors that grow packets (e.g. network coding or encryption) can emit
+ * packets larger than the MTU and fragment them before TX. The payload is not
+ * copied: each fragment is a new header mbuf that is chained with an indirect
+ * mbuf attached to the data of the original packet.
+ *
+ * The reassembly table is used by one lcore, create one context for each
+ * worker. Its memory is bounded by max_flows datagrams in flight, incomplete
+ * datagrams are dropped after the timeout or when their entry is needed for a
+ * new datagram. One datagram can be reassembled from at most
+ * RTE_LIBRTE_IP_FRAG_MAX_FRAG fragments.
+ *
+ * Only untagged or single VLAN tagged IPv4 packets are handled, other packets
+ * pass unchanged.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <rte_mempool.h>
+
+#include <ffpp/collections.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFPP_IP_FRAG_MAX_FLOWS_DEFAULT 4096
+#define FFPP_IP_FRAG_TIMEOUT_MS_DEFAULT 100
+
+/**
+ * struct ffpp_ip_frag_config - Configuration of a fragmentation and
+ * reassembly context.
+ */
+struct ffpp_ip_frag_config {
+	int socket_id;
+	uint16_t mtu; /**< IP MTU of the egress, 0 for RTE_ETHER_MTU */
+	struct rte_mempool *direct_pool; /**< Pool of the fragment headers */
+	// Pool of the indirect mbufs, the data room size can be 0.
+	struct rte_mempool *indirect_pool;
+	// DEV_TX_OFFLOAD_* of the egress port, the IPv4 checksum of the
+	// fragments is offloaded if supported.
+	uint64_t tx_offloads;
+	uint32_t max_flows; /**< Datagrams in reassembly, 0 for the default */
+	uint32_t timeout_ms; /**< Reassembly timeout, 0 for the default */
+	// Copy reassembled datagrams into their first segment, its data room
+	// must hold the whole datagram.
+	bool linearize;
+};
+
+/**
+ * struct ffpp_ip_frag_stats - Counters of a context.
+ */
+struct ffpp_ip_frag_stats {
+	uint64_t fragmented; /**< Packets split into fragments */
+	uint64_t fragments; /**< Fragments created */
+	uint64_t frag_drops; /**< DF set, no mbufs or output vector full */
+	uint64_t reasm_fragments; /**< Fragments received for reassembly */
+	uint64_t reassembled;
+	uint64_t reasm_drops; /**< Linearize failed */
+};
+
+struct ffpp_ip_frag;
+
+/**
+ * ffpp_ip_frag_create() - Create a fragmentation and reassembly context.
+ *
+ * @param cfg
+ *
+ * @return
+ * - Pointer to the context on success.
+ * - NULL on failure, rte_errno is set.
+ */
+struct ffpp_ip_frag *ffpp_ip_frag_create(const struct ffpp_ip_frag_config *cfg);
+
+/**
+ * ffpp_ip_frag_free() - Free a context and the fragments in its reassembly
+ * table. The pools are not freed.
+ *
+ * @param ctx
+ */
+void ffpp_ip_frag_free(struct ffpp_ip_frag *ctx);
+
+/**
+ * ffpp_ip_fragment() - Fragment the IPv4 packets of a vector that are larger
+ * than the MTU.
+ *
+ * The packets of in are moved to out, the original packets that are
+ * fragmented are replaced by their fragments and freed. The L2 header is
+ * copied to each fragment. The L4 checksum must be complete, a pending
+ * checksum offload of the original packet is not applied to the fragments.
+ * Packets that can not be fragmented are freed.
+ *
+ * @param ctx
+ * @param in: All packets are consumed, in->len is set to 0.
+ * @param out: Should have a capacity for the fragments of all packets.
+ *
+ * @return Number of packets in out.
+ */
+uint16_t ffpp_ip_fragment(struct ffpp_ip_frag *ctx, struct ffpp_mvec *in,
+			  struct ffpp_mvec *out);
+
+/**
+ * ffpp_ip_reassemble() - Reassemble the IPv4 fragments of a vector.
+ *
+ * Fragments are taken into the reassembly table and removed from the vector.
+ * A completed datagram replaces its last received fragment, it is a chain of
+ * the fragment mbufs unless linearize is set. vec->len is updated, the order
+ * of the remaining packets is kept.
+ *
+ * @param ctx
+ * @param vec
+ *
+ * @return Number of packets in the vector.
+ */
+uint16_t ffpp_ip_reassemble(struct ffpp_ip_frag *ctx, struct ffpp_mvec *vec);
+
+/**
+ * ffpp_ip_frag_get_stats() - Read the counters of a context.
+ */
+void ffpp_ip_frag_get_stats(const struct ffpp_ip_frag *ctx,
+			    struct ffpp_ip_frag_stats *stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !IP_FRAG_H */
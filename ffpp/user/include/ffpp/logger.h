@@ -0,0 +1,211 @@
+/*
+ * logger.h
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+/**
+ * @file
+ *
+ * Asynchronous binary logger for measurement records.
+ *
+ * Each measurement thread gets its own producer, a lock-free SPSC ring of
+ * fixed-size records. ffpp_log_write() copies one record into the ring and
+ * never blocks, a record is dropped and counted when the ring is full. A
+ * background thread drains all rings in batches into a mmap'd file.
+ *
+ * The file starts with a self-describing header (struct ffpp_log_file_hdr
+ * followed by one struct ffpp_log_file_field per field), the records follow
+ * without padding. scripts/ffpp_log_convert.py converts it to CSV or Parquet.
+ *
+ * The logger does not use the EAL, so it can also be used by the managers
+ * that only work with the XDP maps.
+ *
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFPP_LOG_MAGIC "FFPPLOG"
+#define FFPP_LOG_VERSION 1
+#define FFPP_LOG_NAME_LEN 32
+#define FFPP_LOG_MAX_FIELDS 64
+#define FFPP_LOG_MAX_PRODUCERS 32
+#define FFPP_LOG_RING_SIZE_DEFAULT 16384
+#define FFPP_LOG_FLUSH_US_DEFAULT 1000
+// The log file grows in chunks of this size.
+#define FFPP_LOG_MAP_CHUNK (16UL << 20)
+
+enum ffpp_log_type {
+	FFPP_LOG_U8 = 0,
+	FFPP_LOG_U16,
+	FFPP_LOG_U32,
+	FFPP_LOG_U64,
+	FFPP_LOG_I32,
+	FFPP_LOG_I64,
+	FFPP_LOG_F32,
+	FFPP_LOG_F64,
+};
+
+/**
+ * struct ffpp_log_field - One field of a record.
+ */
+struct ffpp_log_field {
+	const char *name;
+	enum ffpp_log_type type;
+	uint16_t offset;
+};
+
+/**
+ * FFPP_LOG_FIELD() - Describe a member of the record struct.
+ */
+#define FFPP_LOG_FIELD(type_, struct_, member)                                 \
+	{                                                                      \
+		.name = #member, .type = (type_),                              \
+		.offset = offsetof(struct_, member),                           \
+	}
+
+struct ffpp_logger_config {
+	const char *path;
+	const char *name; /**< Name of the schema, stored in the header */
+	const struct ffpp_log_field *fields;
+	uint16_t nb_fields;
+	uint16_t record_size;
+	uint32_t ring_size; /**< Records per producer, power of 2 */
+	uint32_t flush_us; /**< Sleep of the writer when all rings are empty */
+};
+
+/* On-disk format, all integers in host byte order. */
+struct ffpp_log_file_hdr {
+	char magic[8];
+	uint16_t version;
+	uint16_t hdr_len; /**< Offset of the first record */
+	uint16_t record_size;
+	uint16_t nb_fields;
+	uint64_t nb_records; /**< 0 if the logger was not closed */
+	uint64_t start_ns; /**< CLOCK_REALTIME at creation */
+	char name[FFPP_LOG_NAME_LEN];
+};
+
+struct ffpp_log_file_field {
+	char name[FFPP_LOG_NAME_LEN];
+	uint16_t offset;
+	uint8_t type;
+	uint8_t reserved;
+};
+
+/**
+ * struct ffpp_log_producer - SPSC ring of one measurement thread.
+ *
+ * head is only written by the producer and tail only by the writer thread,
+ * they are in different cache lines.
+ */
+struct ffpp_log_producer {
+	uint32_t head __rte_cache_aligned;
+	uint32_t tail_cache; /**< Last tail seen by the producer */
+	uint64_t nb_dropped;
+	uint32_t tail __rte_cache_aligned;
+	uint32_t size;
+	uint32_t mask;
+	uint16_t record_size;
+	uint8_t *slots;
+};
+
+struct ffpp_logger;
+
+struct ffpp_logger_stats {
+	uint64_t nb_written;
+	uint64_t nb_dropped;
+	uint64_t nb_io_errors;
+};
+
+/**
+ * ffpp_logger_create() - Create the log file and start the writer thread.
+ *
+ * @param cfg
+ *
+ * @return The logger, NULL on failure with errno set.
+ */
+struct ffpp_logger *ffpp_logger_create(const struct ffpp_logger_config *cfg);
+
+/**
+ * ffpp_logger_add_producer() - Add a ring for one measurement thread.
+ *
+ * Thread safe. Producers are freed with the logger.
+ *
+ * @param lg
+ *
+ * @return The producer, NULL on failure with errno set.
+ */
+struct ffpp_log_producer *ffpp_logger_add_producer(struct ffpp_logger *lg);
+
+/**
+ * ffpp_log_write() - Append one record without blocking.
+ *
+ * Must only be called by the thread that owns the producer.
+ *
+ * @param p
+ * @param record: Pointer to record_size bytes.
+ *
+ * @return 0 on success, -ENOBUFS if the ring is full and the record is
+ * dropped.
+ */
+static inline int ffpp_log_write(struct ffpp_log_producer *p,
+				 const void *record)
+{
+	uint32_t head = p->head;
+
+	if (unlikely(head - p->tail_cache == p->size)) {
+		p->tail_cache = __atomic_load_n(&p->tail, __ATOMIC_ACQUIRE);
+		if (head - p->tail_cache == p->size) {
+			p->nb_dropped++;
+			return -ENOBUFS;
+		}
+	}
+	memcpy(p->slots + (size_t)(head & p->mask) * p->record_size, record,
+	       p->record_size);
+	__atomic_store_n(&p->head, head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/**
+ * ffpp_logger_flush() - Wait until all records written so far are in the file.
+ *
+ * @param lg
+ */
+void ffpp_logger_flush(struct ffpp_logger *lg);
+
+/**
+ * ffpp_logger_get_stats() - Get the counters of all producers and the writer.
+ *
+ * @param lg
+ * @param stats
+ */
+void ffpp_logger_get_stats(struct ffpp_logger *lg,
+			   struct ffpp_logger_stats *stats);
+
+/**
+ * ffpp_logger_free() - Stop the writer, drain all rings and close the file.
+ *
+ * The producers must not be used anymore.
+ *
+ * @param lg
+ */
+void ffpp_logger_free(struct ffpp_logger *lg);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !LOGGER_H */
@@ -0,0 +1,114 @@
+/*
+ * mbuf_bulk.h
+ */
+
+#ifndef MBUF_BULK_H
+#define MBUF_BULK_H
+
+/**
+ * @file
+ *
+ * Bulk operations on the life cycle of mbufs.
+ *
+ * Processors that emit several packets per input (e.g. the NC encoder) can
+ * fan out one payload with ffpp_mbuf_fanout(): each output gets a private
+ * copy of the headers, which can be rewritten, and an indirect mbuf that
+ * references the payload of the input. The payload must not be changed while
+ * it is shared, and the outputs must not be sent on a port with
+ * DEV_TX_OFFLOAD_MBUF_FAST_FREE (see shared_mbufs in device.h).
+ *
+ */
+
+#include <stdint.h>
+
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+#include <ffpp/collections.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFPP_MBUF_BULK_MAX 64
+// Payloads of at least this size are copied with non-temporal stores.
+#define FFPP_MBUF_NT_COPY_THRESHOLD 1024
+
+/**
+ * ffpp_mbuf_alloc_bulk() - Allocate n mbufs into a vector.
+ *
+ * @param pool
+ * @param vec
+ * @param n: At most the capacity of the vector.
+ *
+ * @return 0 on success, vec->len is set to n. -EINVAL if n is too large,
+ * -ENOMEM if the pool has less than n mbufs, no mbuf is allocated then.
+ */
+int ffpp_mbuf_alloc_bulk(struct rte_mempool *pool, struct ffpp_mvec *vec,
+			 uint16_t n);
+
+/**
+ * ffpp_mbuf_free_bulk() - Free packets that can come from different pools.
+ *
+ * The packets are grouped by the pool of their first segment, so each pool
+ * gets its mbufs back in few bulk operations.
+ *
+ * @param pkts
+ * @param n
+ */
+void ffpp_mbuf_free_bulk(struct rte_mbuf **pkts, uint16_t n);
+
+/**
+ * ffpp_mbuf_free_mvec() - Free all packets of a vector, vec->len is set to 0.
+ *
+ * @param vec
+ */
+void ffpp_mbuf_free_mvec(struct ffpp_mvec *vec);
+
+/**
+ * ffpp_mbuf_fanout() - Make n packets that share the payload of m.
+ *
+ * Each output is a direct mbuf with a copy of the first hdr_len bytes of m,
+ * chained with a clone of the rest of m. The metadata (port, packet type,
+ * offload fields and flags) is copied. m itself is not changed and can be
+ * freed independently.
+ *
+ * @param m
+ * @param hdr_len: At most the data length of the first segment of m.
+ * @param hdr_pool: Pool of the header mbufs.
+ * @param indirect_pool: Pool of the clones, the data room size can be 0.
+ * @param out
+ * @param n: At most FFPP_MBUF_BULK_MAX.
+ *
+ * @return 0 on success, -EINVAL for invalid arguments, -ENOMEM if mbufs can
+ * not be allocated, no output is created then.
+ */
+int ffpp_mbuf_fanout(struct rte_mbuf *m, uint16_t hdr_len,
+		     struct rte_mempool *hdr_pool,
+		     struct rte_mempool *indirect_pool, struct rte_mbuf **out,
+		     uint16_t n);
+
+/**
+ * ffpp_mbuf_deep_copy_bulk() - Copy n packets into new single segment mbufs.
+ *
+ * The data and the metadata are copied, segmented packets are linearized.
+ * Payloads of at least FFPP_MBUF_NT_COPY_THRESHOLD bytes are written with
+ * non-temporal stores, so large copies do not evict the working set from the
+ * cache.
+ *
+ * @param pool: Its data room must hold the largest packet.
+ * @param src
+ * @param dst
+ * @param n
+ *
+ * @return 0 on success, -EINVAL if a packet does not fit into an mbuf of the
+ * pool, -ENOMEM if mbufs can not be allocated, no copy is created then.
+ */
+int ffpp_mbuf_deep_copy_bulk(struct rte_mempool *pool, struct rte_mbuf **src,
+			     struct rte_mbuf **dst, uint16_t n);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !MBUF_BULK_H */
@@ -0,0 +1,198 @@
+/*
+ * meter.h
+ */
+
+#ifndef METER_H
+#define METER_H
+
+/**
+ * @file
+ *
+ * Per-flow rate metering, policing and shaping.
+ *
+ * Each flow is metered by a srTCM (RFC 2697) or trTCM (RFC 2698) of
+ * rte_meter. The meter state and the profile of a flow are kept in a flow
+ * table (see flow_table.h), so idle flows are expired and the table is split
+ * into one partition per worker lcore. New flows get the default profile,
+ * ffpp_meter_set_flow_profile() assigns another one.
+ *
+ * ffpp_meter_police() colors the packets and drops or re-marks them by color.
+ *
+ * ffpp_meter_shape() delays the packets of a flow that exceed the committed
+ * rate (CIR) of its profile, bursts of up to CBS bytes pass at once. Delayed
+ * packets are kept in a time-ordered queue and released by
+ * ffpp_meter_shaper_dequeue() when their TSC deadline is reached.
+ *
+ * Only IPv4 packets are metered, other packets pass unchanged.
+ *
+ */
+
+#include <stdint.h>
+
+#include <rte_mbuf.h>
+#include <rte_meter.h>
+
+#include <ffpp/classifier.h>
+#include <ffpp/collections.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFPP_METER_NAME_MAX_LEN 20
+#define FFPP_METER_PROFILES_MAX 16
+#define FFPP_METER_SHAPER_QUEUE_DEFAULT 4096
+
+enum ffpp_meter_algo {
+	FFPP_METER_SRTCM = 0,
+	FFPP_METER_TRTCM,
+};
+
+/**
+ * enum ffpp_meter_action - What ffpp_meter_police() does with a color.
+ */
+enum ffpp_meter_action {
+	FFPP_METER_PASS = 0,
+	FFPP_METER_DROP,
+	FFPP_METER_MARK, /**< Set the DSCP of IPv4 packets */
+};
+
+/**
+ * struct ffpp_meter_config - Configuration of a meter.
+ *
+ * The rates are in bytes per second, the burst sizes in bytes.
+ */
+struct ffpp_meter_config {
+	char name[FFPP_METER_NAME_MAX_LEN];
+	int socket_id;
+	uint16_t nb_parts; /**< Number of partitions (worker lcores) */
+	uint32_t max_flows; /**< Maximal number of flows per partition */
+	uint64_t timeout_us; /**< Idle timeout of a flow, 0 for the default */
+	enum ffpp_meter_algo algo;
+	uint16_t nb_profiles;
+	union {
+		struct rte_meter_srtcm_params srtcm[FFPP_METER_PROFILES_MAX];
+		struct rte_meter_trtcm_params trtcm[FFPP_METER_PROFILES_MAX];
+	};
+	uint16_t default_profile;
+	enum ffpp_meter_action actions[RTE_COLORS];
+	uint8_t dscp[RTE_COLORS]; /**< DSCP of FFPP_METER_MARK */
+	// Delayed packets per partition, 0 for the default.
+	uint32_t shaper_queue_size;
+};
+
+/**
+ * struct ffpp_meter_stats - Counters of one partition.
+ */
+struct ffpp_meter_stats {
+	uint64_t colors[RTE_COLORS];
+	uint64_t dropped; /**< By policing */
+	uint64_t untracked; /**< Not IPv4 or flow table full */
+	uint64_t shaped; /**< Delayed by the shaper */
+	uint64_t shaper_drops; /**< Shaper queue full */
+	uint32_t shaper_backlog; /**< Currently delayed packets */
+	uint32_t nb_flows;
+};
+
+struct ffpp_meter;
+
+/**
+ * ffpp_meter_create() - Create a meter.
+ *
+ * @param cfg
+ *
+ * @return
+ * - Pointer to the meter on success.
+ * - NULL on failure, rte_errno is set.
+ */
+struct ffpp_meter *ffpp_meter_create(const struct ffpp_meter_config *cfg);
+
+/**
+ * ffpp_meter_free() - Free a meter and the packets in its shaper queues.
+ *
+ * @param mtr
+ */
+void ffpp_meter_free(struct ffpp_meter *mtr);
+
+/**
+ * ffpp_meter_set_flow_profile() - Set the profile of a flow, the flow is
+ * inserted if it is not in the table. The meter of the flow is reset.
+ *
+ * @param mtr
+ * @param part: Partition of the calling lcore.
+ * @param key: The padding must be zero.
+ * @param profile
+ *
+ * @return 0 on success, -EINVAL for an invalid profile, -ENOSPC if the
+ * partition is full.
+ */
+int ffpp_meter_set_flow_profile(struct ffpp_meter *mtr, uint16_t part,
+				const struct ffpp_cls_5tuple *key,
+				uint16_t profile);
+
+/**
+ * ffpp_meter_police() - Meter and police all packets of a vector.
+ *
+ * Like a ffpp_burst_handler_t, packets with the FFPP_METER_DROP action are
+ * moved to the tail of the vector and the number of remaining packets is
+ * returned, the order of them is kept.
+ *
+ * @param mtr
+ * @param part: Partition of the calling lcore.
+ * @param vec
+ * @param colors: Optional, set to the enum rte_color of each remaining
+ * packet. Untracked packets are green.
+ *
+ * @return Number of packets at the head of the vector to forward.
+ */
+uint16_t ffpp_meter_police(struct ffpp_meter *mtr, uint16_t part,
+			   struct ffpp_mvec *vec, uint8_t *colors);
+
+/**
+ * ffpp_meter_shape() - Shape all packets of a vector.
+ *
+ * Packets that conform to the committed rate of their flow stay in the
+ * vector, the others are taken into the shaper queue of the partition and
+ * removed from the vector. vec->len is updated, the order of the remaining
+ * packets is kept. Packets that do not fit into the queue are freed.
+ *
+ * @param mtr
+ * @param part: Partition of the calling lcore.
+ * @param vec
+ *
+ * @return Number of packets in the vector.
+ */
+uint16_t ffpp_meter_shape(struct ffpp_meter *mtr, uint16_t part,
+			  struct ffpp_mvec *vec);
+
+/**
+ * ffpp_meter_shaper_dequeue() - Release the delayed packets whose deadline is
+ * reached, earliest deadline first.
+ *
+ * @param mtr
+ * @param part: Partition of the calling lcore.
+ * @param pkts
+ * @param n: Maximal number of packets.
+ *
+ * @return Number of packets written to pkts.
+ */
+uint16_t ffpp_meter_shaper_dequeue(struct ffpp_meter *mtr, uint16_t part,
+				   struct rte_mbuf **pkts, uint16_t n);
+
+/**
+ * ffpp_meter_age() - Expire idle flows, see ffpp_flow_age().
+ */
+uint32_t ffpp_meter_age(struct ffpp_meter *mtr, uint16_t part,
+			uint32_t budget);
+
+/**
+ * ffpp_meter_get_stats() - Read the counters of a partition.
+ */
+void ffpp_meter_get_stats(const struct ffpp_meter *mtr, uint16_t part,
+			  struct ffpp_meter_stats *stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !METER_H */
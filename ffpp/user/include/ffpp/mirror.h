@@ -0,0 +1,140 @@
+/*
+ * mirror.h
+ */
+
+#ifndef MIRROR_H
+#define MIRROR_H
+
+/**
+ * @file
+ *
+ * Packet mirroring for debugging and analytics.
+ *
+ * Sampled packets are mirrored to rings (e.g. the RX ring of a capture MuNF)
+ * as clones: an indirect mbuf that is attached to the data of the original
+ * packet, so the payload is not copied. The ring is never waited for. If a
+ * ring is full, or the rate limit of a target is reached, the mirror copy is
+ * dropped and the original packet is not affected.
+ *
+ * The clones share the data with the original packets, so mirror the packets
+ * after the last rewrite of the chain. The original packets must not be sent
+ * on a port with DEV_TX_OFFLOAD_MBUF_FAST_FREE, set shared_mbufs in the
+ * device config. The consumer of a ring frees the clones.
+ *
+ * A mirror is used by one lcore, create one for each worker.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <rte_mempool.h>
+#include <rte_ring.h>
+
+#include <ffpp/classifier.h>
+#include <ffpp/collections.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFPP_MIRROR_TARGETS_MAX 4
+#define FFPP_MIRROR_BURST_MAX 64
+#define FFPP_MIRROR_RATE_BURST_DEFAULT 32
+
+/**
+ * enum ffpp_mirror_sampling - How 1 in sample_n packets are chosen.
+ *
+ * DETERMINISTIC mirrors exactly every sample_n-th packet, starting with the
+ * first one. RANDOM mirrors each packet with probability 1/sample_n and does
+ * not lock on periodic traffic patterns.
+ */
+enum ffpp_mirror_sampling {
+	FFPP_MIRROR_SAMPLE_DETERMINISTIC = 0,
+	FFPP_MIRROR_SAMPLE_RANDOM,
+};
+
+/**
+ * struct ffpp_mirror_target - Where and which packets are mirrored.
+ *
+ * The flow filter is applied before the sampling, the rate limit after it.
+ */
+struct ffpp_mirror_target {
+	struct rte_ring *ring; /**< Single or multi producer ring */
+	enum ffpp_mirror_sampling sampling;
+	uint32_t sample_n; /**< Mirror 1 in N packets, 0 or 1 for all */
+	uint64_t rate_pps; /**< Maximal mirror rate, 0 for no limit */
+	uint32_t rate_burst; /**< Token bucket size, 0 to use the default */
+	bool match_flow; /**< Only mirror the IPv4 packets of flow */
+	struct ffpp_cls_5tuple flow;
+};
+
+/**
+ * struct ffpp_mirror_config - Configuration of a mirror.
+ */
+struct ffpp_mirror_config {
+	int socket_id;
+	// Pool of the indirect mbufs, the data room size can be 0.
+	struct rte_mempool *clone_pool;
+	uint16_t nb_targets;
+	struct ffpp_mirror_target targets[FFPP_MIRROR_TARGETS_MAX];
+};
+
+/**
+ * struct ffpp_mirror_stats - Counters of one target.
+ */
+struct ffpp_mirror_stats {
+	uint64_t mirrored;
+	uint64_t drop_rate_limit;
+	uint64_t drop_ring_full;
+	uint64_t drop_no_mbuf; /**< Clone pool empty */
+};
+
+struct ffpp_mirror;
+
+/**
+ * ffpp_mirror_create() - Create a mirror.
+ *
+ * @param cfg
+ *
+ * @return
+ * - Pointer to the mirror on success.
+ * - NULL on failure, rte_errno is set.
+ */
+struct ffpp_mirror *ffpp_mirror_create(const struct ffpp_mirror_config *cfg);
+
+/**
+ * ffpp_mirror_free() - Free a mirror. The rings and pools are not freed.
+ *
+ * @param mir
+ */
+void ffpp_mirror_free(struct ffpp_mirror *mir);
+
+/**
+ * ffpp_mirror_process() - Mirror the sampled packets of a vector.
+ *
+ * The vector is not changed.
+ *
+ * @param mir
+ * @param vec
+ *
+ * @return Number of mirror copies enqueued to all targets.
+ */
+uint16_t ffpp_mirror_process(struct ffpp_mirror *mir,
+			     const struct ffpp_mvec *vec);
+
+/**
+ * ffpp_mirror_get_stats() - Read the counters of a target.
+ *
+ * @param mir
+ * @param target: Index of the target in the config.
+ * @param stats
+ */
+void ffpp_mirror_get_stats(const struct ffpp_mirror *mir, uint16_t target,
+			   struct ffpp_mirror_stats *stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !MIRROR_H */
@@ -70,7 +70,7 @@ int ffpp_mvec_set_mbufs(struct ffpp_mvec *vec, struct rte_mbuf **buf,
 void ffpp_mvec_free(struct ffpp_mvec *vec);
 
 /**
- * Free all mbufs in the vector (Not the contained mbufs).
+ * Free all mbufs in the vector, the vector itself is kept and becomes empty.
  *
  * @param vec
  */
@@ -96,7 +96,7 @@ struct rte_mbuf *ffpp_mvec_at_index(struct ffpp_mvec *vec, uint16_t n);
 uint16_t ffpp_mvec_len(struct ffpp_mvec *vec);
 
 /**
- * Free a part of mbufs in the vector.
+ * Free the mbufs in the vector from offset on, the vector keeps the others.
  *
  * @param vec
  * @param offset
@@ -5,6 +5,22 @@
 #ifndef PACKET_PROCESSORS_H
 #define PACKET_PROCESSORS_H
 
+/**
+ * @file
+ *
+ * Burst processors for common L2/L3 header rewrites over a mbuf vector.
+ *
+ * The default functions use SSE (MAC and VLAN rewrites, one 16 bytes register
+ * covers the Ethernet header) and AVX2 (TTL and DSCP checksum updates of 8
+ * packets at once) when the library is compiled for a CPU that supports them,
+ * and fall back to the scalar implementations otherwise. The *_scalar variants
+ * are always available for testing and benchmarking.
+ *
+ * Ethernet headers with at most one VLAN tag are supported. Address and port
+ * arguments are in network byte order.
+ *
+ */
+
 #include <stdint.h>
 
 #include <rte_ether.h>
@@ -15,9 +31,126 @@
 extern "C" {
 #endif
 
+#define FFPP_PP_NAT_SRC_ADDR 0x01
+#define FFPP_PP_NAT_DST_ADDR 0x02
+#define FFPP_PP_NAT_SRC_PORT 0x04
+#define FFPP_PP_NAT_DST_PORT 0x08
+
+/**
+ * struct ffpp_pp_nat - Rewrite rule of ffpp_pp_nat_rewrite().
+ */
+struct ffpp_pp_nat {
+	uint32_t src_addr;
+	uint32_t dst_addr;
+	uint16_t src_port;
+	uint16_t dst_port;
+	uint8_t flags; /**< FFPP_PP_NAT_* fields to rewrite */
+};
+
+/**
+ * ffpp_pp_update_dl_dst() - Set the destination MAC address of all packets.
+ *
+ * @param vec
+ * @param dl_dst
+ */
 void ffpp_pp_update_dl_dst(struct ffpp_mvec *vec,
 			   const struct rte_ether_addr *dl_dst);
 
+/**
+ * ffpp_pp_update_dl_src() - Set the source MAC address of all packets.
+ *
+ * @param vec
+ * @param dl_src
+ */
+void ffpp_pp_update_dl_src(struct ffpp_mvec *vec,
+			   const struct rte_ether_addr *dl_src);
+
+/**
+ * ffpp_pp_rewrite_dl() - Set both MAC addresses of all packets.
+ *
+ * @param vec
+ * @param dl_src
+ * @param dl_dst
+ */
+void ffpp_pp_rewrite_dl(struct ffpp_mvec *vec,
+			const struct rte_ether_addr *dl_src,
+			const struct rte_ether_addr *dl_dst);
+void ffpp_pp_rewrite_dl_scalar(struct ffpp_mvec *vec,
+			       const struct rte_ether_addr *dl_src,
+			       const struct rte_ether_addr *dl_dst);
+
+/**
+ * ffpp_pp_swap_dl() - Swap the source and destination MAC addresses.
+ *
+ * @param vec
+ */
+void ffpp_pp_swap_dl(struct ffpp_mvec *vec);
+void ffpp_pp_swap_dl_scalar(struct ffpp_mvec *vec);
+
+/**
+ * ffpp_pp_vlan_push() - Insert a 802.1Q tag after the MAC addresses.
+ *
+ * Packets without enough headroom are not modified.
+ *
+ * @param vec
+ * @param tci: Tag control information in host byte order.
+ *
+ * @return Number of tagged packets.
+ */
+uint16_t ffpp_pp_vlan_push(struct ffpp_mvec *vec, uint16_t tci);
+uint16_t ffpp_pp_vlan_push_scalar(struct ffpp_mvec *vec, uint16_t tci);
+
+/**
+ * ffpp_pp_vlan_pop() - Remove the outer 802.1Q tag.
+ *
+ * Like rte_vlan_strip(), the TCI is stored in mbuf->vlan_tci. Untagged packets
+ * are not modified.
+ *
+ * @param vec
+ *
+ * @return Number of untagged packets.
+ */
+uint16_t ffpp_pp_vlan_pop(struct ffpp_mvec *vec);
+uint16_t ffpp_pp_vlan_pop_scalar(struct ffpp_mvec *vec);
+
+/**
+ * ffpp_pp_dec_ttl() - Decrement the IPv4 TTL (with incremental checksum
+ * update) or the IPv6 hop limit.
+ *
+ * Like a ffpp_burst_handler_t, packets whose TTL or hop limit would reach 0
+ * are moved to the tail of the vector (without decrementing) and the number
+ * of remaining packets is returned, the order of them is kept. Non-IP packets
+ * are kept unchanged.
+ *
+ * @param vec
+ *
+ * @return Number of packets at the head of the vector to forward.
+ */
+uint16_t ffpp_pp_dec_ttl(struct ffpp_mvec *vec);
+uint16_t ffpp_pp_dec_ttl_scalar(struct ffpp_mvec *vec);
+
+/**
+ * ffpp_pp_mark_dscp() - Set the DSCP of IPv4 and IPv6 packets, the ECN bits
+ * are kept.
+ *
+ * @param vec
+ * @param dscp: 6 bits DSCP value.
+ */
+void ffpp_pp_mark_dscp(struct ffpp_mvec *vec, uint8_t dscp);
+void ffpp_pp_mark_dscp_scalar(struct ffpp_mvec *vec, uint8_t dscp);
+
+/**
+ * ffpp_pp_nat_rewrite() - Rewrite IPv4 addresses and TCP/UDP ports.
+ *
+ * The IPv4 and the TCP/UDP checksums are updated incrementally. Ports are
+ * only rewritten for the first fragment. There is no SIMD version, because
+ * the offset of the L4 header depends on the IHL.
+ *
+ * @param vec
+ * @param nat
+ */
+void ffpp_pp_nat_rewrite(struct ffpp_mvec *vec, const struct ffpp_pp_nat *nat);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,274 @@
+/*
+ * pcap.h
+ */
+
+#ifndef PCAP_H
+#define PCAP_H
+
+/**
+ * @file
+ *
+ * Memory-mapped PCAP/PCAPNG replay and capture.
+ *
+ * The reader maps the whole trace file and copies packets directly from the
+ * mapping into bulk-allocated mbufs, so a burst costs one
+ * rte_pktmbuf_alloc_bulk() and no read syscalls. Traces larger than the mbuf
+ * pool are streamed: mbufs are only held until they are transmitted.
+ *
+ * The writer decouples the fast path from disk IO: workers enqueue mbufs into
+ * a SPSC ring and a background lcore drains the ring into a mmap'd PCAP file.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_ring.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFPP_PCAP_MAX_IFACES 8
+#define FFPP_PCAP_SNAPLEN_DEFAULT 65535
+#define FFPP_PCAP_RING_SIZE_DEFAULT 4096
+// The capture file grows in chunks of this size.
+#define FFPP_PCAP_MAP_CHUNK (64UL << 20)
+
+enum ffpp_pcap_format {
+	FFPP_PCAP_FORMAT_PCAP = 0,
+	FFPP_PCAP_FORMAT_PCAPNG,
+};
+
+/**
+ * struct ffpp_pcap_reader - A read-only mapping of a PCAP or PCAPNG file.
+ */
+struct ffpp_pcap_reader {
+	const uint8_t *map;
+	size_t map_len;
+	size_t off; /**< Offset of the next record/block */
+	size_t first_off; /**< Offset of the first record/block */
+	enum ffpp_pcap_format format;
+	uint8_t swapped; /**< File is in the opposite byte order */
+	uint32_t link_type;
+	// Timestamp resolution of each interface: ns = ticks * mult / div.
+	// PCAP files only use the first entry.
+	uint64_t ts_mult[FFPP_PCAP_MAX_IFACES];
+	uint64_t ts_div[FFPP_PCAP_MAX_IFACES];
+	uint16_t nb_ifaces;
+	uint64_t nb_read;
+	uint64_t nb_skipped; /**< Packets larger than the mbuf data room */
+};
+
+/**
+ * ffpp_pcap_reader_open() - Map a PCAP or PCAPNG file for reading.
+ *
+ * The format is detected from the magic number.
+ *
+ * @param r
+ * @param path
+ *
+ * @return
+ * - 0 on success.
+ * - -1 on failure, rte_errno is set.
+ */
+int ffpp_pcap_reader_open(struct ffpp_pcap_reader *r, const char *path);
+
+/**
+ * ffpp_pcap_reader_close() - Unmap the file.
+ *
+ * @param r
+ */
+void ffpp_pcap_reader_close(struct ffpp_pcap_reader *r);
+
+/**
+ * ffpp_pcap_reader_rewind() - Restart reading from the first packet.
+ *
+ * @param r
+ */
+void ffpp_pcap_reader_rewind(struct ffpp_pcap_reader *r);
+
+/**
+ * ffpp_pcap_reader_eof() - Check if all packets have been read.
+ *
+ * @param r
+ */
+static inline bool ffpp_pcap_reader_eof(const struct ffpp_pcap_reader *r)
+{
+	return r->off >= r->map_len;
+}
+
+/**
+ * ffpp_pcap_reader_read_burst() - Read up to nb_pkts packets into new mbufs.
+ *
+ * All mbufs are allocated with a single rte_pktmbuf_alloc_bulk() call. Unused
+ * mbufs at the end of the file are returned to the pool.
+ *
+ * @param r
+ * @param pool
+ * @param pkts: Array of at least nb_pkts mbuf pointers.
+ * @param ts_ns: Optional array of at least nb_pkts capture timestamps in
+ * nanoseconds. Can be NULL.
+ * @param nb_pkts
+ *
+ * @return
+ * Number of packets read. 0 at the end of the file or if the pool is empty.
+ */
+uint16_t ffpp_pcap_reader_read_burst(struct ffpp_pcap_reader *r,
+				     struct rte_mempool *pool,
+				     struct rte_mbuf **pkts, uint64_t *ts_ns,
+				     uint16_t nb_pkts);
+
+enum ffpp_pcap_replay_mode {
+	FFPP_PCAP_REPLAY_LINE_RATE = 0, /**< Send as fast as the port allows */
+	FFPP_PCAP_REPLAY_TIMED, /**< Keep the original inter-packet gaps */
+};
+
+struct ffpp_pcap_replay_config {
+	uint16_t port_id;
+	uint16_t queue_id;
+	uint16_t burst_size;
+	enum ffpp_pcap_replay_mode mode;
+	double speed; /**< Time scaling for TIMED mode, 1.0 is original */
+	uint32_t loops; /**< Number of passes over the file, 0 is forever */
+	volatile bool *stop; /**< Optional stop flag checked every burst */
+};
+
+struct ffpp_pcap_replay_stats {
+	uint64_t tx_pkts;
+	uint64_t tx_bytes;
+	uint64_t tx_dropped; /**< TX queue full (TIMED) or unsent on stop */
+	uint64_t loops;
+	uint64_t tsc_elapsed;
+};
+
+/**
+ * ffpp_pcap_replay() - Replay a trace on a TX queue.
+ *
+ * In TIMED mode, packets are released when their TSC deadline (derived from
+ * the capture timestamps) is reached. Busy-waits on the calling lcore.
+ *
+ * @param r
+ * @param pool
+ * @param cfg
+ * @param stats: Can be NULL.
+ *
+ * @return
+ * - 0 on success.
+ * - -1 on invalid configuration.
+ */
+int ffpp_pcap_replay(struct ffpp_pcap_reader *r, struct rte_mempool *pool,
+		     const struct ffpp_pcap_replay_config *cfg,
+		     struct ffpp_pcap_replay_stats *stats);
+
+/**
+ * struct ffpp_pcap_writer - Capture mbufs into a mmap'd PCAP file.
+ *
+ * The producer side (ffpp_pcap_writer_enqueue) and the consumer side
+ * (ffpp_pcap_writer_drain/ffpp_pcap_writer_run) must each be used by a single
+ * lcore.
+ */
+struct ffpp_pcap_writer {
+	int fd;
+	uint8_t *map;
+	size_t map_len;
+	size_t off;
+	uint32_t snaplen;
+	struct rte_ring *ring;
+	int tsc_dynfield_offset;
+	// Wall clock at open in nanoseconds and the TSC value at the same time.
+	uint64_t base_ns;
+	uint64_t base_tsc;
+	unsigned int lcore_id;
+	volatile bool running;
+	uint64_t nb_written;
+	uint64_t nb_dropped; /**< Ring full on enqueue */
+	uint64_t nb_io_errors;
+} __rte_cache_aligned;
+
+/**
+ * ffpp_pcap_writer_open() - Create the capture file and the SPSC ring.
+ *
+ * @param w
+ * @param path
+ * @param ring_size: Must be a power of 2.
+ * @param snaplen: 0 to use FFPP_PCAP_SNAPLEN_DEFAULT.
+ *
+ * @return
+ * - 0 on success.
+ * - -1 on failure, rte_errno is set.
+ */
+int ffpp_pcap_writer_open(struct ffpp_pcap_writer *w, const char *path,
+			  uint32_t ring_size, uint32_t snaplen);
+
+/**
+ * ffpp_pcap_writer_enqueue() - Hand packets to the writer without blocking.
+ *
+ * The ownership of enqueued mbufs is moved to the writer. Mbufs that do not
+ * fit into the ring stay with the caller and are counted as dropped. Use
+ * rte_pktmbuf_clone() or increase the refcnt to keep forwarding the packets.
+ *
+ * @param w
+ * @param pkts
+ * @param nb_pkts
+ *
+ * @return
+ * Number of enqueued packets.
+ */
+uint16_t ffpp_pcap_writer_enqueue(struct ffpp_pcap_writer *w,
+				  struct rte_mbuf **pkts, uint16_t nb_pkts);
+
+/**
+ * ffpp_pcap_writer_drain() - Write all packets currently in the ring.
+ *
+ * @param w
+ *
+ * @return
+ * Number of written packets.
+ */
+uint32_t ffpp_pcap_writer_drain(struct ffpp_pcap_writer *w);
+
+/**
+ * ffpp_pcap_writer_run() - Main loop of the background writer lcore.
+ *
+ * Can be used as lcore_function_t with the writer as argument. Returns after
+ * ffpp_pcap_writer_stop() and the ring is empty.
+ *
+ * @param arg: Pointer to a struct ffpp_pcap_writer.
+ */
+int ffpp_pcap_writer_run(void *arg);
+
+/**
+ * ffpp_pcap_writer_start() - Launch ffpp_pcap_writer_run() on a worker lcore.
+ *
+ * @param w
+ * @param lcore_id
+ *
+ * @return
+ * - 0 on success.
+ * - Negative value on failure.
+ */
+int ffpp_pcap_writer_start(struct ffpp_pcap_writer *w, unsigned int lcore_id);
+
+/**
+ * ffpp_pcap_writer_stop() - Stop the background lcore and wait for it.
+ *
+ * @param w
+ */
+void ffpp_pcap_writer_stop(struct ffpp_pcap_writer *w);
+
+/**
+ * ffpp_pcap_writer_close() - Flush remaining packets, truncate the file to
+ * its real size and release all resources.
+ *
+ * @param w
+ */
+void ffpp_pcap_writer_close(struct ffpp_pcap_writer *w);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !PCAP_H */
@@ -5,20 +5,244 @@
 #ifndef PYE_H
 #define PYE_H
 
+/**
+ * @file
+ *
+ * Embedded Python engine (PyE) for the slow path.
+ *
+ * A whole vector of packets is handed to a Python function, the application
+ * processing unit (APU) handler, in one call:
+ *
+ *	def handler(payloads, lengths):
+ *
+ * - payloads: List of writable memoryviews, one per packet. Each view covers
+ *   the payload (the data after the offset) and the tailroom of the first
+ *   segment, the memory of the mbuf is not copied.
+ * - lengths: Writable memoryview of int32 ("i"), set to the payload length of
+ *   each packet. The handler writes the new length of a packet (up to the size
+ *   of its view) or FFPP_PYE_DROP. numpy.frombuffer(lengths, dtype=numpy.int32)
+ *   gives a NumPy view of it, numpy.frombuffer(payloads[i], dtype=numpy.uint8)
+ *   one of a payload.
+ *
+ * Instead of writing into lengths, the handler can return a sequence with one
+ * length or verdict per packet. The views are only valid during the call,
+ * they are released after it. The call fails if the handler still holds an
+ * export of them, e.g. a pickle.PickleBuffer. Views derived from them, e.g.
+ * slices or NumPy arrays, are not detected and must not be kept either.
+ *
+ * The GIL is released after ffpp_pye_init(), ffpp_pye_process_apu() takes it
+ * once per vector, so any lcore can call it, but the lcores are serialized.
+ *
+ * A worker pool (ffpp_pye_pool_create()) runs the handler in several forked
+ * processes instead, each with its own interpreter and GIL. The batches are
+ * passed as descriptors (address and size of each payload) through a ring per
+ * worker, the workers map the payloads in place because the hugepages are
+ * shared with the forked processes. The packets stay owned by the calling
+ * lcore, it submits batches and collects them in order when the workers
+ * completed them, so many batches can be outstanding.
+ *
+ */
+
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
 
+#include <sched.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <ffpp/collections.h>
 #include <ffpp/private.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Verdict of the handler to drop a packet, any negative length drops it.
+#define FFPP_PYE_DROP (-1)
+// Maximal number of packets in one call of the handler, larger vectors are
+// split without releasing the GIL in between.
+#define FFPP_PYE_BATCH_MAX 256
+
+#define FFPP_PYE_NAME_MAX_LEN 20
+#define FFPP_PYE_WORKERS_MAX 64
+#define FFPP_PYE_POOL_BATCH_DEFAULT 32
+#define FFPP_PYE_POOL_SLOTS_DEFAULT 64
+
+/**
+ * ffpp_pye_init() - Start the interpreter and release the GIL.
+ *
+ * @param program_name
+ * @param module_path: Inserted at the front of sys.path, can be NULL.
+ *
+ * @return 0 on success, -EALREADY if it is already started, -EINVAL if the
+ * interpreter can not be started.
+ */
 EXPORT
 int ffpp_pye_init(const char *program_name, const char *module_path);
 
+/**
+ * ffpp_pye_set_apu_handler() - Import a module and set the APU handler.
+ *
+ * @param module_name
+ * @param func_name
+ *
+ * @return 0 on success, -EPERM if the interpreter is not started, -ENOENT if
+ * the module or function can not be imported, -EINVAL if it is not callable.
+ */
 EXPORT
 int ffpp_pye_set_apu_handler(const char *module_name, const char *func_name);
 
+/**
+ * ffpp_pye_process_apu() - Process the payloads of a vector with the handler.
+ *
+ * Dropped packets are freed and removed from the vector, the lengths of the
+ * others are adjusted. Packets with several segments or less than offset bytes
+ * get an empty view, they are only dropped or kept unchanged.
+ *
+ * @param vec
+ * @param offset: Start of the payload, e.g. the UDP payload.
+ *
+ * @return Number of kept packets, -ENOENT if there is no handler, -EIO if the
+ * handler raised an exception (it is printed) or kept an export of the packets,
+ * -EINVAL for an invalid return value. On errors, the packets of the failed
+ * call stay in the vector without changed lengths, but their payloads could be
+ * modified.
+ */
 EXPORT
-int ffpp_pye_process_apu();
+int ffpp_pye_process_apu(struct ffpp_mvec *vec, uint16_t offset);
 
+/**
+ * ffpp_pye_cleanup() - Drop the handler and finalize the interpreter.
+ */
 EXPORT void ffpp_pye_cleanup(void);
 
+/**
+ * struct ffpp_pye_pool_config - Configuration of a worker pool.
+ */
+struct ffpp_pye_pool_config {
+	char name[FFPP_PYE_NAME_MAX_LEN];
+	int socket_id;
+	uint16_t nb_workers; /**< Up to FFPP_PYE_WORKERS_MAX */
+	// Batches that can be outstanding, i.e. submitted but not collected, 0
+	// for the default.
+	uint16_t nb_slots;
+	uint16_t batch_size; /**< Up to FFPP_PYE_BATCH_MAX, 0 for the default */
+	uint16_t offset; /**< Start of the payload, e.g. the UDP payload */
+	const char *module_name; /**< Imported by each worker */
+	const char *func_name; /**< APU handler in the module */
+	// CPUs of the workers, NULL for the CPUs of the EAL control threads,
+	// i.e. the CPUs of the process without the lcores.
+	const cpu_set_t *cpuset;
+};
+
+/**
+ * struct ffpp_pye_pool_stats - Counters of a worker pool.
+ */
+struct ffpp_pye_pool_stats {
+	uint64_t submitted; /**< Packets */
+	uint64_t batches; /**< Submitted batches */
+	uint64_t kept; /**< Collected packets */
+	uint64_t dropped; /**< Packets dropped by the handler, they are freed */
+	// Packets of batches whose handler failed, they are collected with
+	// unchanged lengths.
+	uint64_t failed;
+	uint32_t outstanding; /**< Batches that are not collected */
+};
+
+struct ffpp_pye_pool;
+
+/**
+ * ffpp_pye_pool_create() - Fork the workers of a pool and wait until they
+ * imported the handler.
+ *
+ * The interpreter must be started with ffpp_pye_init(). Fork the workers
+ * during the initialization, before other lcores are launched, and after the
+ * mempools of the packets are created: Memory that is allocated later is not
+ * mapped in the workers. The EAL must use hugepages (not --no-huge), otherwise
+ * the memory is not shared. The workers are killed when the process exits.
+ *
+ * The workers do not inherit the affinity of the lcore, they run on the CPUs
+ * of cfg->cpuset.
+ *
+ * @param cfg
+ *
+ * @return
+ * - Pointer to the pool on success.
+ * - NULL on failure, rte_errno is set: EPERM if the interpreter is not
+ *   started, ENOTSUP without hugepages, ENOENT if a worker can not import the
+ *   handler, EINVAL if a worker can not run on the CPUs.
+ */
+EXPORT
+struct ffpp_pye_pool *ffpp_pye_pool_create(
+	const struct ffpp_pye_pool_config *cfg);
+
+/**
+ * ffpp_pye_pool_free() - Stop the workers and free the pool.
+ *
+ * Waits until the workers finished their current batch, the packets of
+ * outstanding batches are freed.
+ *
+ * @param pool
+ */
+EXPORT void ffpp_pye_pool_free(struct ffpp_pye_pool *pool);
+
+/**
+ * ffpp_pye_pool_submit() - Split a vector into batches and pass them to the
+ * least loaded workers.
+ *
+ * It does not wait for the workers. Packets with several segments or less
+ * than offset bytes get an empty view, like in ffpp_pye_process_apu().
+ *
+ * @param pool
+ * @param vec: The packets are moved into the batches. It keeps the packets
+ * that do not fit, i.e. if all slots are outstanding.
+ *
+ * @return Number of submitted packets.
+ */
+EXPORT
+uint16_t ffpp_pye_pool_submit(struct ffpp_pye_pool *pool,
+			      struct ffpp_mvec *vec);
+
+/**
+ * ffpp_pye_pool_collect() - Collect the completed batches in submission order.
+ *
+ * Collection stops at the first batch that is not completed yet, so the order
+ * of the packets is kept even if the workers complete out of order. The
+ * lengths are adjusted and the dropped packets are freed, like in
+ * ffpp_pye_process_apu().
+ *
+ * The workers are checked periodically. The outstanding batches of a worker
+ * that died, e.g. killed by the OOM killer, are collected as failed, and the
+ * worker gets no more batches.
+ *
+ * @param pool
+ * @param out: The kept packets are appended, a batch is only collected if out
+ * has room for all its packets.
+ *
+ * @return Number of appended packets.
+ */
+EXPORT
+uint16_t ffpp_pye_pool_collect(struct ffpp_pye_pool *pool,
+			       struct ffpp_mvec *out);
+
+/**
+ * ffpp_pye_pool_get_stats() - Read the counters of a pool.
+ */
+EXPORT
+void ffpp_pye_pool_get_stats(const struct ffpp_pye_pool *pool,
+			     struct ffpp_pye_pool_stats *stats);
+
+/**
+ * ffpp_pye_pool_get_worker_pid() - Get the process ID of a worker.
+ *
+ * @return PID, or 0 if the worker is not running, e.g. it died.
+ */
+EXPORT
+pid_t ffpp_pye_pool_get_worker_pid(const struct ffpp_pye_pool *pool,
+				   uint16_t worker);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
 #endif /* !PYE_H */
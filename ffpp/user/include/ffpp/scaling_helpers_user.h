@@ -11,14 +11,11 @@
 #include <rte_power.h>
 
 #include <ffpp/bpf_defines_user.h>
+#include <ffpp/cycle_stats.h>
 #include <ffpp/scaling_defines_user.h>
 #include <ffpp/general_helpers_user.h>
 #include <ffpp/global_stats_user.h>
 
-double g_csv_pps[TOTAL_VALS];
-double g_csv_ts[TOTAL_VALS];
-double g_csv_cpu_util[TOTAL_VALS];
-unsigned int g_csv_freq[TOTAL_VALS];
 unsigned int g_csv_num_val;
 int g_csv_num_round;
 bool g_csv_saved_stream;
@@ -198,4 +195,24 @@ double calc_period(struct record *r, struct record *p);
  */
 void get_cpu_utilization(struct measurement *m, struct freq_info *f);
 
+/**
+ * Stores the measured busy fraction of a ffpp worker lcore as the CPU
+ * utilization, instead of the estimation based on C_PACKET
+ *
+ * @param m: struct of the current measurement status and values
+ * @param prev: previous snapshot of the lcore's cycle counters
+ * @param cur: current snapshot of the lcore's cycle counters
+ */
+void get_cpu_utilization_cycles(struct measurement *m,
+				const struct ffpp_lcore_cycles *prev,
+				const struct ffpp_lcore_cycles *cur);
+
+/**
+ * Attaches to the cycle counters of a running ffpp worker runtime. The caller
+ * must have initialized the EAL as a secondary process of it.
+ *
+ * @return the counters, NULL if no worker runtime is running
+ */
+struct ffpp_cycle_stats *attach_cycle_stats(void);
+
 #endif /* !SCALING_HELPERS_USER_H */
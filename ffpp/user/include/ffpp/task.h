@@ -12,12 +12,38 @@
  *
  */
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <rte_ethdev.h>
 #include <rte_launch.h>
 #include <rte_lcore.h>
 #include <rte_memory.h>
+#include <rte_ring.h>
+
+#include <ffpp/collections.h>
+#include <ffpp/cycle_stats.h>
+#include <ffpp/histogram.h>
+#include <ffpp/wsdeque.h>
 
 #include "device.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFPP_WORKER_MAX_RXQS (FFPP_MAX_PORTS * FFPP_MAX_QUEUES_PER_PORT)
+#define FFPP_WORKER_MAX_STAGES 8
+#define FFPP_WORKER_BURST_SIZE_DEFAULT 32
+#define FFPP_WORKER_RING_SIZE_DEFAULT 1024
+#define FFPP_WORKER_TX_DRAIN_US_DEFAULT 100
+// Batches queued per worker in work-stealing mode.
+#define FFPP_WORKER_WS_DEQUE_SIZE 64
+// Maximal RX bursts per loop of a work-stealing worker.
+#define FFPP_WORKER_WS_RX_BURSTS 4
+// Per-lcore cache of the batch mempool in work-stealing mode.
+#define FFPP_WORKER_WS_BATCH_CACHE_SIZE 32
+
 /**
  * print_lcore_infos() - Print all lcores' information
  */
@@ -31,29 +57,248 @@ void print_lcore_infos(void);
 void dpdk_enter_mainloop_master(lcore_function_t *func, void *args);
 
 /**
- * struct worker - A worker for processing received packets.
+ * Burst handler (processing stage) of a worker.
  *
- * Each worker is launched on a slave lcore and currently handles ONLY one RX
- * and TX queue of a port. E.g. for 2 ports with 2 queues per port, worker 0
- * handle rx/tx queue 0 of port 0 and 1, and worker 1 handle rx/tx queue 1 of
- * port 0 and 1. This dispatch focuses on performance, multiple queues are
- * handled by different lcores even for single port
+ * The handler can modify, reorder and drop the packets in the vector. It
+ * returns the number of packets at the head of the vector that are passed to
+ * the next stage (or transmitted after the last stage). The remaining packets
+ * [ret, len) are freed by the runtime.
  *
+ * @param vec: Received packets.
+ * @param arg: The handler argument of the stage in the config.
+ *
+ * @return Number of packets to keep.
+ */
+typedef uint16_t (*ffpp_burst_handler_t)(struct ffpp_mvec *vec, void *arg);
+
+/**
+ * enum ffpp_worker_mode - How the stages are mapped to lcores.
+ *
+ * FFPP_WORKER_MODE_RTC: Run-to-completion. The (port, queue) pairs are spread
+ * over all worker lcores and every worker runs all stages on its packets.
+ *
+ * FFPP_WORKER_MODE_PIPELINE: One worker lcore per stage. The first stage polls
+ * all (port, queue) pairs, stages are connected with SPSC rings and the last
+ * stage transmits. The last stage sends each packet according to its port
+ * field.
+ *
+ * FFPP_WORKER_MODE_STEAL: Work-stealing for CPU-heavy handlers and skewed RSS.
+ * The last worker lcore is the TX lcore, the (port, queue) pairs are spread
+ * over the others like in RTC mode. Each worker queues received batches in its
+ * own deque, idle workers steal half of the queued batches of busy ones. The
+ * TX lcore restores the order of each RX queue before transmitting.
+ */
+enum ffpp_worker_mode {
+	FFPP_WORKER_MODE_RTC = 0,
+	FFPP_WORKER_MODE_PIPELINE,
+	FFPP_WORKER_MODE_STEAL,
+};
+
+/**
+ * struct ffpp_worker_config - Configuration of the worker runtime.
+ *
+ * Ports must be initialized (e.g. with ffpp_dpdk_init_device()) before the
+ * runtime is created. In RTC mode, every port needs one TX queue per used
+ * worker lcore.
+ */
+struct ffpp_worker_config {
+	enum ffpp_worker_mode mode;
+	uint16_t nb_ports;
+	uint16_t port_ids[FFPP_MAX_PORTS];
+	// Packets received on port_ids[i] are sent to port_ids[tx_port_map[i]].
+	uint16_t tx_port_map[FFPP_MAX_PORTS];
+	uint16_t nb_rx_queues; /**< RX queues of each port */
+	uint16_t nb_tx_queues; /**< TX queues of each port */
+	uint16_t burst_size; /**< 0 to use the default */
+	uint32_t tx_drain_us; /**< Flush interval of TX buffers, 0: default */
+	uint32_t ring_size; /**< Ring size between stages, 0: default */
+	uint16_t nb_stages;
+	ffpp_burst_handler_t handlers[FFPP_WORKER_MAX_STAGES];
+	void *handler_args[FFPP_WORKER_MAX_STAGES];
+};
+
+/**
+ * struct ffpp_worker_stats - Per-worker counters.
+ *
+ * Each counter is only written by its worker lcore.
+ */
+struct ffpp_worker_stats {
+	uint64_t rx_pkts;
+	uint64_t tx_pkts;
+	uint64_t tx_dropped; /**< TX queue full */
+	uint64_t nf_dropped; /**< Dropped by the burst handlers */
+	uint64_t ring_dropped; /**< Ring to the next stage full */
+	uint64_t rx_polls;
+	uint64_t rx_empty_polls;
+	uint64_t stolen_batches;
+};
+
+enum ffpp_worker_role {
+	FFPP_WORKER_ROLE_IDLE = 0,
+	FFPP_WORKER_ROLE_RTC,
+	FFPP_WORKER_ROLE_STAGE,
+	FFPP_WORKER_ROLE_WS,
+	FFPP_WORKER_ROLE_WS_TX,
+};
+
+struct ffpp_worker_runtime;
+struct ffpp_ws_batch;
+struct ffpp_ws_reorder;
+
+/**
+ * struct worker - A worker for processing received packets.
+ *
+ * Each worker is launched on a slave lcore. In run-to-completion mode, the
+ * (port, queue) pairs are assigned round-robin: E.g. for 2 ports with 2 queues
+ * per port and 2 workers, worker 0 handles queue 0 of port 0 and 1, and worker
+ * 1 handles queue 1 of port 0 and 1. Each worker transmits on its own TX queue
+ * of every port. This dispatch focuses on performance, multiple queues are
+ * handled by different lcores even for single port.
  */
 struct worker {
-	struct rx_queue rxqs[FFPP_MAX_PORTS];
+	struct rx_queue rxqs[FFPP_WORKER_MAX_RXQS];
 	struct tx_queue txqs[FFPP_MAX_PORTS];
+	struct rte_eth_dev_tx_buffer *tx_buffers[FFPP_MAX_PORTS];
+	uint16_t nb_rxqs;
 	uint16_t core_id;
+	enum ffpp_worker_role role;
+	uint16_t stage; /**< Stage index in pipeline mode */
+	bool launched; /**< Launched by ffpp_workers_launch() */
+	struct ffpp_worker_runtime *rt;
+	struct ffpp_lcore_cycles *cycles; /**< Entry in the shared cycle stats */
+	struct ffpp_hist *burst_hist; /**< Cycles of each non-empty poll */
+	// Work-stealing mode
+	struct ffpp_wsdeque *deque;
+	uint32_t rxq_seqn[FFPP_WORKER_MAX_RXQS];
+	uint16_t next_victim;
+	struct ffpp_worker_stats stats __rte_cache_aligned;
 } __rte_cache_aligned;
 
+/**
+ * struct ffpp_worker_runtime - Workers and shared state of the runtime.
+ */
+struct ffpp_worker_runtime {
+	struct ffpp_worker_config cfg;
+	unsigned int id;
+	struct worker workers[RTE_MAX_LCORE];
+	// Maps a port ID back to its index in cfg.port_ids.
+	uint16_t port_idx[RTE_MAX_ETHPORTS];
+	struct rte_ring *rings[FFPP_WORKER_MAX_STAGES];
+	unsigned int stage_lcores[FFPP_WORKER_MAX_STAGES];
+	uint64_t tx_drain_tsc;
+	struct ffpp_cycle_stats *cycle_stats;
+	volatile bool stop;
+	volatile bool stage_done[FFPP_WORKER_MAX_STAGES];
+	// Work-stealing mode
+	unsigned int ws_lcores[RTE_MAX_LCORE];
+	uint16_t nb_ws_lcores;
+	uint16_t ws_running;
+	struct rte_mempool *ws_batch_pool;
+	struct rte_ring *ws_tx_ring;
+	struct ffpp_ws_reorder *ws_reorder;
+	struct ffpp_ws_batch **ws_windows;
+};
+
 /**
  * launch_workers() - Launch the same function on given workers.
  *
  * @param func
- * @param workers
+ * @param workers: Array indexed by the lcore ID.
  *
  * @return
  */
 int launch_workers(lcore_function_t *func, struct worker *workers);
 
+/**
+ * ffpp_workers_create() - Create the runtime and assign the (port, queue) pairs
+ * and stages to the worker lcores.
+ *
+ * @param cfg
+ *
+ * @return
+ * - Pointer to the runtime on success.
+ * - NULL on failure, rte_errno is set to EINVAL if the config does not fit the
+ *   worker lcores or TX queues, ENOMEM if an allocation failed.
+ */
+struct ffpp_worker_runtime *
+ffpp_workers_create(const struct ffpp_worker_config *cfg);
+
+/**
+ * ffpp_worker_main() - Main loop of a worker, used by ffpp_workers_launch().
+ *
+ * @param arg: Pointer to the struct worker of the lcore.
+ */
+int ffpp_worker_main(void *arg);
+
+/**
+ * ffpp_workers_launch() - Launch ffpp_worker_main() on the worker lcores
+ * that have a role.
+ *
+ * @param rt
+ *
+ * @return 0 on success, a negative errno if an lcore is busy. The lcores that
+ * were launched keep running, stop and wait for them.
+ */
+int ffpp_workers_launch(struct ffpp_worker_runtime *rt);
+
+/**
+ * ffpp_workers_stop() - Ask all workers to stop.
+ *
+ * Workers flush their TX buffers before they return. In pipeline mode, each
+ * stage drains its input ring first.
+ *
+ * @param rt
+ */
+void ffpp_workers_stop(struct ffpp_worker_runtime *rt);
+
+/**
+ * ffpp_workers_wait() - Wait until the launched workers returned.
+ *
+ * Other lcores, e.g. of another runtime, are not waited for.
+ *
+ * @param rt
+ */
+void ffpp_workers_wait(struct ffpp_worker_runtime *rt);
+
+/**
+ * ffpp_workers_get_stats() - Sum up the counters of all workers.
+ *
+ * @param rt
+ * @param total
+ */
+void ffpp_workers_get_stats(const struct ffpp_worker_runtime *rt,
+			    struct ffpp_worker_stats *total);
+
+/**
+ * ffpp_workers_get_burst_hist() - Merge the burst latency histograms of all
+ * workers.
+ *
+ * Can be called while the workers run. A sample is the TSC cycles of one
+ * non-empty poll, i.e. the RX burst (or dequeue) and the burst handlers.
+ *
+ * @param rt
+ * @param hist: Initialized with ffpp_hist_init(), the samples are added.
+ */
+void ffpp_workers_get_burst_hist(const struct ffpp_worker_runtime *rt,
+				 struct ffpp_hist *hist);
+
+/**
+ * ffpp_workers_print_stats() - Print the counters and the burst latency of each
+ * worker.
+ *
+ * @param rt
+ */
+void ffpp_workers_print_stats(const struct ffpp_worker_runtime *rt);
+
+/**
+ * ffpp_workers_destroy() - Release the runtime. Workers must be stopped.
+ *
+ * @param rt
+ */
+void ffpp_workers_destroy(struct ffpp_worker_runtime *rt);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
 #endif /* !TASK_H */
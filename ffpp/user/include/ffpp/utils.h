@@ -28,12 +28,13 @@ extern "C" {
 /**
  * mbuf_deep_copy() -  Make a deep copy of a mbuf. The returned copied mbuf is
  * allocated from the mbuf_pool, the head room is adjusted, the data room is
- * copied from the given mbuf.
+ * copied from the given mbuf. See ffpp_mbuf_deep_copy_bulk() in mbuf_bulk.h
+ * for bursts.
  *
  * @param mbuf_pool
  * @param m
  *
- * @return
+ * @return The copy, NULL if no mbuf can be allocated.
  */
 struct rte_mbuf *mbuf_deep_copy(struct rte_mempool *mbuf_pool,
 				struct rte_mbuf *m);
@@ -61,6 +62,7 @@ int mbuf_datacmp(struct rte_mbuf *m1, struct rte_mbuf *m2);
  */
 double get_delay_tsc_ms(uint64_t tsc_cnt);
 
+// They block on file IO, use the logger in logger.h on measurement threads.
 void save_double_list_csv(char *path, double *list, size_t n);
 void save_u64_list_csv(char *path, uint64_t *list, size_t n);
 
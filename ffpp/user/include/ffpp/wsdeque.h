@@ -0,0 +1,165 @@
+/*
+ * wsdeque.h
+ */
+
+#ifndef WSDEQUE_H
+#define WSDEQUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file
+ *
+ * Bounded lock-free work-stealing deque of pointers.
+ *
+ * This is the Chase-Lev deque with the C11 memory orderings of Le et al.
+ * ("Correct and efficient work-stealing for weak memory models", PPoPP'13)
+ * on a fixed size array. Only the owner lcore calls ffpp_wsdeque_push() and
+ * ffpp_wsdeque_take() on the bottom end, any lcore can call
+ * ffpp_wsdeque_steal() on the top end.
+ *
+ */
+
+/**
+ * struct ffpp_wsdeque - A work-stealing deque.
+ *
+ * top and bottom are in different cache lines, because the owner writes the
+ * bottom in every operation while thieves only write the top.
+ */
+struct ffpp_wsdeque {
+	int64_t top __rte_cache_aligned;
+	int64_t bottom __rte_cache_aligned;
+	uint32_t size;
+	uint32_t mask;
+	void *items[] __rte_cache_aligned;
+};
+
+/**
+ * ffpp_wsdeque_create() - Create a deque on the given socket.
+ *
+ * @param size: Capacity, must be a power of 2.
+ * @param socket_id
+ *
+ * @return
+ * - Pointer to the deque on success.
+ * - NULL on failure, rte_errno is set.
+ */
+struct ffpp_wsdeque *ffpp_wsdeque_create(uint32_t size, int socket_id);
+
+/**
+ * ffpp_wsdeque_free() - Free the deque. Contained items are not freed.
+ *
+ * @param dq
+ */
+void ffpp_wsdeque_free(struct ffpp_wsdeque *dq);
+
+/**
+ * ffpp_wsdeque_count() - Approximate number of items in the deque.
+ *
+ * @param dq
+ */
+static inline uint32_t ffpp_wsdeque_count(const struct ffpp_wsdeque *dq)
+{
+	int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED);
+	int64_t t = __atomic_load_n(&dq->top, __ATOMIC_RELAXED);
+
+	return (b > t) ? (uint32_t)(b - t) : 0;
+}
+
+/**
+ * ffpp_wsdeque_push() - Push an item to the bottom (owner only).
+ *
+ * @param dq
+ * @param item
+ *
+ * @return 0 on success, -1 if the deque is full.
+ */
+static inline int ffpp_wsdeque_push(struct ffpp_wsdeque *dq, void *item)
+{
+	int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED);
+	int64_t t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+
+	if (unlikely(b - t >= (int64_t)dq->size)) {
+		return -1;
+	}
+	__atomic_store_n(&dq->items[b & dq->mask], item, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+	return 0;
+}
+
+/**
+ * ffpp_wsdeque_take() - Take the newest item from the bottom (owner only).
+ *
+ * @param dq
+ *
+ * @return The item or NULL if the deque is empty.
+ */
+static inline void *ffpp_wsdeque_take(struct ffpp_wsdeque *dq)
+{
+	int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED) - 1;
+	int64_t t;
+	void *item = NULL;
+
+	__atomic_store_n(&dq->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	t = __atomic_load_n(&dq->top, __ATOMIC_RELAXED);
+
+	if (t <= b) {
+		item = __atomic_load_n(&dq->items[b & dq->mask],
+				       __ATOMIC_RELAXED);
+		if (t == b) {
+			// Last item, race against thieves.
+			if (!__atomic_compare_exchange_n(&dq->top, &t, t + 1,
+							 false, __ATOMIC_SEQ_CST,
+							 __ATOMIC_RELAXED)) {
+				item = NULL;
+			}
+			__atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+		}
+	} else {
+		__atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+	}
+	return item;
+}
+
+/**
+ * ffpp_wsdeque_steal() - Steal the oldest item from the top (any lcore).
+ *
+ * @param dq
+ *
+ * @return The item or NULL if the deque is empty or another lcore won the
+ * race.
+ */
+static inline void *ffpp_wsdeque_steal(struct ffpp_wsdeque *dq)
+{
+	int64_t t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+	int64_t b;
+	void *item;
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	b = __atomic_load_n(&dq->bottom, __ATOMIC_ACQUIRE);
+	if (t >= b) {
+		return NULL;
+	}
+	item = __atomic_load_n(&dq->items[t & dq->mask], __ATOMIC_RELAXED);
+	if (!__atomic_compare_exchange_n(&dq->top, &t, t + 1, false,
+					 __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+		return NULL;
+	}
+	return item;
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !WSDEQUE_H */
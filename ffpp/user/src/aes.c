@@ -34,9 +34,13 @@ NOTE:   String length must be evenly divisible by 16byte (str_len % 16 == 0)
 /*****************************************************************************/
 /* Includes:                                                                 */
 /*****************************************************************************/
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h> // CBC mode, for memset
 #include <ffpp/aes.h>
 
+#include "aes_impl.h"
+
 /*****************************************************************************/
 /* Defines:                                                                  */
 /*****************************************************************************/
@@ -464,17 +468,17 @@ static void InvCipher(state_t *state, const uint8_t *RoundKey)
 #endif // #if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1)
 
 /*****************************************************************************/
-/* Public functions:                                                         */
+/* Software modes of operation:                                              */
 /*****************************************************************************/
 #if defined(ECB) && (ECB == 1)
 
-void AES_ECB_encrypt(const struct AES_ctx *ctx, uint8_t *buf)
+static void sw_ecb_encrypt(const struct AES_ctx *ctx, uint8_t *buf)
 {
 	// The next function call encrypts the PlainText with the Key using AES algorithm.
 	Cipher((state_t *)buf, ctx->RoundKey);
 }
 
-void AES_ECB_decrypt(const struct AES_ctx *ctx, uint8_t *buf)
+static void sw_ecb_decrypt(const struct AES_ctx *ctx, uint8_t *buf)
 {
 	// The next function call decrypts the PlainText with the Key using AES algorithm.
 	InvCipher((state_t *)buf, ctx->RoundKey);
@@ -494,7 +498,7 @@ static void XorWithIv(uint8_t *buf, const uint8_t *Iv)
 	}
 }
 
-void AES_CBC_encrypt_buffer(struct AES_ctx *ctx, uint8_t *buf, uint32_t length)
+static void sw_cbc_encrypt(struct AES_ctx *ctx, uint8_t *buf, uint32_t length)
 {
 	uintptr_t i;
 	uint8_t *Iv = ctx->Iv;
@@ -508,7 +512,23 @@ void AES_CBC_encrypt_buffer(struct AES_ctx *ctx, uint8_t *buf, uint32_t length)
 	memcpy(ctx->Iv, Iv, AES_BLOCKLEN);
 }
 
-void AES_CBC_decrypt_buffer(struct AES_ctx *ctx, uint8_t *buf, uint32_t length)
+static void sw_cbc_encrypt_multi(const struct AES_ctx *ctx,
+				 uint8_t *const bufs[], const uint32_t lengths[],
+				 uint8_t (*ivs)[AES_BLOCKLEN], uint32_t n)
+{
+	struct AES_ctx c;
+	uint32_t i;
+
+	// Cipher() takes non-const round keys.
+	memcpy(c.RoundKey, ctx->RoundKey, AES_keyExpSize);
+	for (i = 0; i < n; ++i) {
+		memcpy(c.Iv, ivs[i], AES_BLOCKLEN);
+		sw_cbc_encrypt(&c, bufs[i], lengths[i]);
+		memcpy(ivs[i], c.Iv, AES_BLOCKLEN);
+	}
+}
+
+static void sw_cbc_decrypt(struct AES_ctx *ctx, uint8_t *buf, uint32_t length)
 {
 	uintptr_t i;
 	uint8_t storeNextIv[AES_BLOCKLEN];
@@ -526,7 +546,7 @@ void AES_CBC_decrypt_buffer(struct AES_ctx *ctx, uint8_t *buf, uint32_t length)
 #if defined(CTR) && (CTR == 1)
 
 /* Symmetrical operation: same function for encrypting as for decrypting. Note any IV/nonce should never be reused with the same key */
-void AES_CTR_xcrypt_buffer(struct AES_ctx *ctx, uint8_t *buf, uint32_t length)
+static void sw_ctr_xcrypt(struct AES_ctx *ctx, uint8_t *buf, uint32_t length)
 {
 	uint8_t buffer[AES_BLOCKLEN];
 
@@ -557,3 +577,319 @@ void AES_CTR_xcrypt_buffer(struct AES_ctx *ctx, uint8_t *buf, uint32_t length)
 }
 
 #endif // #if defined(CTR) && (CTR == 1)
+
+#if defined(GCM) && (GCM == 1)
+
+// The coefficient of x^0 of a GCM block is the most significant bit of the
+// first byte (NIST SP 800-38D 6.3), x = x * y.
+static void gf_mul(uint8_t *x, const uint8_t *y)
+{
+	uint8_t z[AES_BLOCKLEN] = { 0 };
+	uint8_t v[AES_BLOCKLEN];
+	uint8_t lsb;
+	int i, j;
+
+	memcpy(v, y, AES_BLOCKLEN);
+	for (i = 0; i < AES_BLOCKLEN * 8; ++i) {
+		if (x[i / 8] & (0x80 >> (i % 8))) {
+			for (j = 0; j < AES_BLOCKLEN; ++j) {
+				z[j] ^= v[j];
+			}
+		}
+		lsb = v[AES_BLOCKLEN - 1] & 1;
+		for (j = AES_BLOCKLEN - 1; j > 0; --j) {
+			v[j] = (v[j] >> 1) | (v[j - 1] << 7);
+		}
+		v[0] >>= 1;
+		if (lsb) {
+			v[0] ^= 0xe1;
+		}
+	}
+	memcpy(x, z, AES_BLOCKLEN);
+}
+
+static void reverse_block(uint8_t *dst, const uint8_t *src)
+{
+	uint8_t i;
+
+	for (i = 0; i < AES_BLOCKLEN; ++i) {
+		dst[i] = src[AES_BLOCKLEN - 1 - i];
+	}
+}
+
+// A partial last block is padded with zeros.
+static void sw_ghash(uint8_t *x, const uint8_t *h, const uint8_t *p,
+		     uint32_t len)
+{
+	uint32_t i, n;
+
+	for (; len > 0; len -= n, p += n) {
+		n = len < AES_BLOCKLEN ? len : AES_BLOCKLEN;
+		for (i = 0; i < n; ++i) {
+			x[i] ^= p[i];
+		}
+		gf_mul(x, h);
+	}
+}
+
+static void sw_gcm_crypt(const struct AES_GCM_ctx *ctx,
+			 const struct AES_GCM_buf *b, int encrypt,
+			 uint8_t *tag)
+{
+	uint8_t h[AES_BLOCKLEN], x[AES_BLOCKLEN] = { 0 };
+	uint8_t j0[AES_BLOCKLEN], ctr[AES_BLOCKLEN], ks[AES_BLOCKLEN];
+	uint64_t bits[2];
+	uint32_t i, j, n;
+
+	reverse_block(h, ctx->Htab[0]);
+	memcpy(j0, b->iv, AES_GCM_IVLEN);
+	memset(j0 + AES_GCM_IVLEN, 0, AES_BLOCKLEN - AES_GCM_IVLEN);
+	j0[AES_BLOCKLEN - 1] = 1;
+
+	sw_ghash(x, h, b->aad, b->aad_len);
+	if (!encrypt) {
+		sw_ghash(x, h, b->buf, b->length);
+	}
+	memcpy(ctr, j0, AES_BLOCKLEN);
+	for (i = 0; i < b->length; i += n) {
+		// inc32(), the lowest 32 bits are the block counter.
+		for (j = AES_BLOCKLEN - 1; j >= AES_GCM_IVLEN; --j) {
+			if (++ctr[j] != 0) {
+				break;
+			}
+		}
+		memcpy(ks, ctr, AES_BLOCKLEN);
+		Cipher((state_t *)ks, ctx->aes.RoundKey);
+		n = b->length - i < AES_BLOCKLEN ? b->length - i : AES_BLOCKLEN;
+		for (j = 0; j < n; ++j) {
+			b->buf[i + j] ^= ks[j];
+		}
+	}
+	if (encrypt) {
+		sw_ghash(x, h, b->buf, b->length);
+	}
+	bits[0] = __builtin_bswap64((uint64_t)b->aad_len * 8);
+	bits[1] = __builtin_bswap64((uint64_t)b->length * 8);
+	sw_ghash(x, h, (const uint8_t *)bits, sizeof(bits));
+
+	memcpy(ks, j0, AES_BLOCKLEN);
+	Cipher((state_t *)ks, ctx->aes.RoundKey);
+	for (j = 0; j < AES_GCM_TAGLEN; ++j) {
+		tag[j] = ks[j] ^ x[j];
+	}
+}
+
+static void sw_gcm_encrypt_multi(const struct AES_GCM_ctx *ctx,
+				 const struct AES_GCM_buf *bufs, uint32_t n)
+{
+	uint32_t i;
+
+	for (i = 0; i < n; ++i) {
+		sw_gcm_crypt(ctx, &bufs[i], 1, bufs[i].tag);
+	}
+}
+
+static uint32_t sw_gcm_decrypt_multi(const struct AES_GCM_ctx *ctx,
+				     const struct AES_GCM_buf *bufs,
+				     uint32_t n, uint8_t *valid)
+{
+	uint8_t tag[AES_GCM_TAGLEN], diff;
+	uint32_t i, j, nb_valid = 0;
+
+	for (i = 0; i < n; ++i) {
+		sw_gcm_crypt(ctx, &bufs[i], 0, tag);
+		// Compare in constant time.
+		diff = 0;
+		for (j = 0; j < AES_GCM_TAGLEN; ++j) {
+			diff |= tag[j] ^ bufs[i].tag[j];
+		}
+		valid[i] = diff == 0;
+		nb_valid += valid[i];
+	}
+	return nb_valid;
+}
+
+#endif // #if defined(GCM) && (GCM == 1)
+
+/*****************************************************************************/
+/* Runtime dispatch:                                                         */
+/*****************************************************************************/
+static const struct aes_ops sw_ops = {
+	.impl = AES_IMPL_SW,
+#if defined(ECB) && (ECB == 1)
+	.ecb_encrypt = sw_ecb_encrypt,
+	.ecb_decrypt = sw_ecb_decrypt,
+#endif
+#if defined(CBC) && (CBC == 1)
+	.cbc_encrypt = sw_cbc_encrypt,
+	.cbc_decrypt = sw_cbc_decrypt,
+	.cbc_encrypt_multi = sw_cbc_encrypt_multi,
+#endif
+#if defined(CTR) && (CTR == 1)
+	.ctr_xcrypt = sw_ctr_xcrypt,
+#endif
+#if defined(GCM) && (GCM == 1)
+	.gcm_encrypt_multi = sw_gcm_encrypt_multi,
+	.gcm_decrypt_multi = sw_gcm_decrypt_multi,
+#endif
+};
+
+static const char *impl_names[AES_IMPL_MAX] = {
+	[AES_IMPL_SW] = "sw",
+	[AES_IMPL_AESNI] = "aesni",
+	[AES_IMPL_VAES] = "vaes",
+};
+
+static const struct aes_ops *ops = &sw_ops;
+
+enum AES_impl AES_get_impl(void)
+{
+	return ops->impl;
+}
+
+int AES_set_impl(enum AES_impl impl)
+{
+	const struct aes_ops *new_ops;
+
+	switch (impl) {
+	case AES_IMPL_SW:
+		new_ops = &sw_ops;
+		break;
+	case AES_IMPL_AESNI:
+		new_ops = aes_ni_get_ops();
+		break;
+	case AES_IMPL_VAES:
+		new_ops = aes_vaes_get_ops();
+		break;
+	default:
+		return -EINVAL;
+	}
+	if (new_ops == NULL) {
+		return -ENOTSUP;
+	}
+	ops = new_ops;
+	return 0;
+}
+
+const char *AES_impl_name(enum AES_impl impl)
+{
+	if ((unsigned int)impl >= AES_IMPL_MAX) {
+		return "unknown";
+	}
+	return impl_names[impl];
+}
+
+// Runs before main(), so the impl is fixed before any worker is started.
+__attribute__((constructor)) static void select_impl(void)
+{
+	const char *name = getenv("FFPP_AES_IMPL");
+	int i;
+
+	if (name != NULL) {
+		for (i = 0; i < AES_IMPL_MAX; ++i) {
+			if (strcmp(name, impl_names[i]) == 0 &&
+			    AES_set_impl(i) == 0) {
+				return;
+			}
+		}
+	}
+	for (i = AES_IMPL_MAX - 1; i > AES_IMPL_SW; --i) {
+		if (AES_set_impl(i) == 0) {
+			return;
+		}
+	}
+}
+
+/*****************************************************************************/
+/* Public functions:                                                         */
+/*****************************************************************************/
+#if defined(ECB) && (ECB == 1)
+
+void AES_ECB_encrypt(const struct AES_ctx *ctx, uint8_t *buf)
+{
+	ops->ecb_encrypt(ctx, buf);
+}
+
+void AES_ECB_decrypt(const struct AES_ctx *ctx, uint8_t *buf)
+{
+	ops->ecb_decrypt(ctx, buf);
+}
+
+#endif // #if defined(ECB) && (ECB == 1)
+
+#if defined(CBC) && (CBC == 1)
+
+void AES_CBC_encrypt_buffer(struct AES_ctx *ctx, uint8_t *buf, uint32_t length)
+{
+	ops->cbc_encrypt(ctx, buf, length);
+}
+
+void AES_CBC_decrypt_buffer(struct AES_ctx *ctx, uint8_t *buf, uint32_t length)
+{
+	ops->cbc_decrypt(ctx, buf, length);
+}
+
+void AES_CBC_encrypt_multi(const struct AES_ctx *ctx, uint8_t *const bufs[],
+			   const uint32_t lengths[],
+			   uint8_t (*ivs)[AES_BLOCKLEN], uint32_t n)
+{
+	ops->cbc_encrypt_multi(ctx, bufs, lengths, ivs, n);
+}
+
+#endif // #if defined(CBC) && (CBC == 1)
+
+#if defined(CTR) && (CTR == 1)
+
+void AES_CTR_xcrypt_buffer(struct AES_ctx *ctx, uint8_t *buf, uint32_t length)
+{
+	ops->ctr_xcrypt(ctx, buf, length);
+}
+
+#endif // #if defined(CTR) && (CTR == 1)
+
+#if defined(GCM) && (GCM == 1)
+
+// The powers of H are computed once per key with the software multiplication.
+void AES_GCM_init_ctx(struct AES_GCM_ctx *ctx, const uint8_t *key)
+{
+	uint8_t h[AES_BLOCKLEN] = { 0 };
+	uint8_t p[AES_BLOCKLEN];
+	int i;
+
+	AES_init_ctx(&ctx->aes, key);
+	Cipher((state_t *)h, ctx->aes.RoundKey);
+	memcpy(p, h, AES_BLOCKLEN);
+	for (i = 0; i < AES_GCM_HPOWS; ++i) {
+		reverse_block(ctx->Htab[i], p);
+		gf_mul(p, h);
+	}
+}
+
+void AES_GCM_encrypt(const struct AES_GCM_ctx *ctx,
+		     const struct AES_GCM_buf *b)
+{
+	ops->gcm_encrypt_multi(ctx, b, 1);
+}
+
+int AES_GCM_decrypt(const struct AES_GCM_ctx *ctx,
+		    const struct AES_GCM_buf *b)
+{
+	uint8_t valid;
+
+	return ops->gcm_decrypt_multi(ctx, b, 1, &valid) == 1 ? 0 : -EBADMSG;
+}
+
+void AES_GCM_encrypt_multi(const struct AES_GCM_ctx *ctx,
+			   const struct AES_GCM_buf *bufs, uint32_t n)
+{
+	ops->gcm_encrypt_multi(ctx, bufs, n);
+}
+
+uint32_t AES_GCM_decrypt_multi(const struct AES_GCM_ctx *ctx,
+			       const struct AES_GCM_buf *bufs, uint32_t n,
+			       uint8_t *valid)
+{
+	return ops->gcm_decrypt_multi(ctx, bufs, n, valid);
+}
+
+#endif // #if defined(GCM) && (GCM == 1)
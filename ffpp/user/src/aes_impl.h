@@ -0,0 +1,42 @@
+/*
+ * aes_impl.h
+ *
+ * Internal interface between aes.c and the accelerated implementations.
+ */
+
+#ifndef AES_IMPL_H
+#define AES_IMPL_H
+
+#include <stdint.h>
+
+#include <ffpp/aes.h>
+
+// Number of rounds, 10, 12 or 14.
+#define AES_NR (AES_KEYLEN / 4 + 6)
+
+struct aes_ops {
+	enum AES_impl impl;
+	void (*ecb_encrypt)(const struct AES_ctx *ctx, uint8_t *buf);
+	void (*ecb_decrypt)(const struct AES_ctx *ctx, uint8_t *buf);
+	void (*cbc_encrypt)(struct AES_ctx *ctx, uint8_t *buf, uint32_t length);
+	void (*cbc_decrypt)(struct AES_ctx *ctx, uint8_t *buf, uint32_t length);
+	void (*cbc_encrypt_multi)(const struct AES_ctx *ctx,
+				  uint8_t *const bufs[],
+				  const uint32_t lengths[],
+				  uint8_t (*ivs)[AES_BLOCKLEN], uint32_t n);
+	void (*ctr_xcrypt)(struct AES_ctx *ctx, uint8_t *buf, uint32_t length);
+#if defined(GCM) && (GCM == 1)
+	void (*gcm_encrypt_multi)(const struct AES_GCM_ctx *ctx,
+				  const struct AES_GCM_buf *bufs, uint32_t n);
+	uint32_t (*gcm_decrypt_multi)(const struct AES_GCM_ctx *ctx,
+				      const struct AES_GCM_buf *bufs,
+				      uint32_t n, uint8_t *valid);
+#endif
+};
+
+// Return NULL if the CPU (or the architecture) does not support the
+// implementation.
+const struct aes_ops *aes_ni_get_ops(void);
+const struct aes_ops *aes_vaes_get_ops(void);
+
+#endif /* !AES_IMPL_H */
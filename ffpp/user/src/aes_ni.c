@@ -0,0 +1,1076 @@
+/*
+ * aes_ni.c
+ *
+ * AES-NI and VAES implementations of the modes of aes.c.
+ *
+ * The round keys of the software KeyExpansion() are already in the byte order
+ * of the AES-NI instructions, so all implementations share struct AES_ctx.
+ * The decryption keys of the equivalent inverse cipher (FIPS-197 5.3.5) are
+ * derived per call with AESIMC, which costs less than one block.
+ *
+ * CBC encryption of one buffer is sequential, only CBC decryption and CTR
+ * process several independent blocks in parallel to hide the latency of
+ * AESENC/AESDEC. AES_CBC_encrypt_multi() gets the same parallelism from
+ * several buffers instead.
+ */
+
+#include <string.h>
+
+#include <ffpp/aes.h>
+
+#include "aes_impl.h"
+
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+
+#define TARGET_AESNI __attribute__((target("sse2,aes")))
+#define TARGET_VAES __attribute__((target("sse2,aes,avx512f,avx512bw,vaes")))
+
+// Blocks in flight.
+#define NI_LANES 8
+#define VAES_REGS 4
+#define VAES_LANES (VAES_REGS * 4)
+
+static inline uint64_t nb_blocks(uint32_t length)
+{
+	return ((uint64_t)length + AES_BLOCKLEN - 1) / AES_BLOCKLEN;
+}
+
+static TARGET_AESNI inline __m128i load_block(const uint8_t *p)
+{
+	return _mm_loadu_si128((const __m128i *)p);
+}
+
+static TARGET_AESNI inline void store_block(uint8_t *p, __m128i b)
+{
+	_mm_storeu_si128((__m128i *)p, b);
+}
+
+static TARGET_AESNI inline void load_enc_keys(__m128i rk[AES_NR + 1],
+					      const uint8_t *RoundKey)
+{
+	int i;
+
+	for (i = 0; i <= AES_NR; ++i) {
+		rk[i] = load_block(RoundKey + i * AES_BLOCKLEN);
+	}
+}
+
+static TARGET_AESNI inline void load_dec_keys(__m128i dk[AES_NR + 1],
+					      const uint8_t *RoundKey)
+{
+	int i;
+
+	dk[0] = load_block(RoundKey + AES_NR * AES_BLOCKLEN);
+	for (i = 1; i < AES_NR; ++i) {
+		dk[i] = _mm_aesimc_si128(
+			load_block(RoundKey + (AES_NR - i) * AES_BLOCKLEN));
+	}
+	dk[AES_NR] = load_block(RoundKey);
+}
+
+static TARGET_AESNI inline __m128i enc_block(__m128i b, const __m128i *rk)
+{
+	int i;
+
+	b = _mm_xor_si128(b, rk[0]);
+	for (i = 1; i < AES_NR; ++i) {
+		b = _mm_aesenc_si128(b, rk[i]);
+	}
+	return _mm_aesenclast_si128(b, rk[AES_NR]);
+}
+
+static TARGET_AESNI inline __m128i dec_block(__m128i b, const __m128i *dk)
+{
+	int i;
+
+	b = _mm_xor_si128(b, dk[0]);
+	for (i = 1; i < AES_NR; ++i) {
+		b = _mm_aesdec_si128(b, dk[i]);
+	}
+	return _mm_aesdeclast_si128(b, dk[AES_NR]);
+}
+
+static TARGET_AESNI inline void enc_lanes(__m128i b[NI_LANES],
+					  const __m128i *rk)
+{
+	int i, j;
+
+	for (j = 0; j < NI_LANES; ++j) {
+		b[j] = _mm_xor_si128(b[j], rk[0]);
+	}
+	for (i = 1; i < AES_NR; ++i) {
+		for (j = 0; j < NI_LANES; ++j) {
+			b[j] = _mm_aesenc_si128(b[j], rk[i]);
+		}
+	}
+	for (j = 0; j < NI_LANES; ++j) {
+		b[j] = _mm_aesenclast_si128(b[j], rk[AES_NR]);
+	}
+}
+
+static TARGET_AESNI inline void dec_lanes(__m128i b[NI_LANES],
+					  const __m128i *dk)
+{
+	int i, j;
+
+	for (j = 0; j < NI_LANES; ++j) {
+		b[j] = _mm_xor_si128(b[j], dk[0]);
+	}
+	for (i = 1; i < AES_NR; ++i) {
+		for (j = 0; j < NI_LANES; ++j) {
+			b[j] = _mm_aesdec_si128(b[j], dk[i]);
+		}
+	}
+	for (j = 0; j < NI_LANES; ++j) {
+		b[j] = _mm_aesdeclast_si128(b[j], dk[AES_NR]);
+	}
+}
+
+/* The IV of CTR is a 128-bit big-endian counter, kept as two host words. */
+struct ctr128 {
+	uint64_t hi;
+	uint64_t lo;
+};
+
+static inline void ctr_load(struct ctr128 *c, const uint8_t *Iv)
+{
+	memcpy(&c->hi, Iv, sizeof(c->hi));
+	memcpy(&c->lo, Iv + sizeof(c->hi), sizeof(c->lo));
+	c->hi = __builtin_bswap64(c->hi);
+	c->lo = __builtin_bswap64(c->lo);
+}
+
+static inline void ctr_store(const struct ctr128 *c, uint8_t *Iv)
+{
+	uint64_t hi = __builtin_bswap64(c->hi);
+	uint64_t lo = __builtin_bswap64(c->lo);
+
+	memcpy(Iv, &hi, sizeof(hi));
+	memcpy(Iv + sizeof(hi), &lo, sizeof(lo));
+}
+
+// Return the current counter block and increment the counter.
+static TARGET_AESNI inline __m128i ctr_next(struct ctr128 *c)
+{
+	__m128i b = _mm_set_epi64x((long long)__builtin_bswap64(c->lo),
+				   (long long)__builtin_bswap64(c->hi));
+
+	if (++c->lo == 0) {
+		++c->hi;
+	}
+	return b;
+}
+
+/*****************************************************************************/
+/* AES-NI                                                                    */
+/*****************************************************************************/
+
+#if defined(ECB) && (ECB == 1)
+
+static TARGET_AESNI void ni_ecb_encrypt(const struct AES_ctx *ctx,
+					uint8_t *buf)
+{
+	__m128i rk[AES_NR + 1];
+
+	load_enc_keys(rk, ctx->RoundKey);
+	store_block(buf, enc_block(load_block(buf), rk));
+}
+
+static TARGET_AESNI void ni_ecb_decrypt(const struct AES_ctx *ctx,
+					uint8_t *buf)
+{
+	__m128i dk[AES_NR + 1];
+
+	load_dec_keys(dk, ctx->RoundKey);
+	store_block(buf, dec_block(load_block(buf), dk));
+}
+
+#endif // #if defined(ECB) && (ECB == 1)
+
+#if defined(CBC) && (CBC == 1)
+
+static TARGET_AESNI void ni_cbc_encrypt(struct AES_ctx *ctx, uint8_t *buf,
+					uint32_t length)
+{
+	uint64_t i, n = nb_blocks(length);
+	__m128i rk[AES_NR + 1];
+	__m128i iv;
+
+	load_enc_keys(rk, ctx->RoundKey);
+	iv = load_block(ctx->Iv);
+	for (i = 0; i < n; ++i, buf += AES_BLOCKLEN) {
+		iv = enc_block(_mm_xor_si128(load_block(buf), iv), rk);
+		store_block(buf, iv);
+	}
+	store_block(ctx->Iv, iv);
+}
+
+static TARGET_AESNI void ni_cbc_decrypt_blocks(struct AES_ctx *ctx,
+					       uint8_t *buf, uint64_t n)
+{
+	__m128i b[NI_LANES], c[NI_LANES];
+	__m128i dk[AES_NR + 1];
+	__m128i prev, cur;
+	uint64_t i;
+	int j;
+
+	load_dec_keys(dk, ctx->RoundKey);
+	prev = load_block(ctx->Iv);
+	for (i = 0; i + NI_LANES <= n; i += NI_LANES, buf += sizeof(c)) {
+		// All ciphertext blocks are loaded before the buffer is
+		// overwritten in place.
+		for (j = 0; j < NI_LANES; ++j) {
+			c[j] = load_block(buf + j * AES_BLOCKLEN);
+			b[j] = c[j];
+		}
+		dec_lanes(b, dk);
+		store_block(buf, _mm_xor_si128(b[0], prev));
+		for (j = 1; j < NI_LANES; ++j) {
+			store_block(buf + j * AES_BLOCKLEN,
+				    _mm_xor_si128(b[j], c[j - 1]));
+		}
+		prev = c[NI_LANES - 1];
+	}
+	for (; i < n; ++i, buf += AES_BLOCKLEN) {
+		cur = load_block(buf);
+		store_block(buf, _mm_xor_si128(dec_block(cur, dk), prev));
+		prev = cur;
+	}
+	store_block(ctx->Iv, prev);
+}
+
+static void ni_cbc_decrypt(struct AES_ctx *ctx, uint8_t *buf, uint32_t length)
+{
+	ni_cbc_decrypt_blocks(ctx, buf, nb_blocks(length));
+}
+
+/* A buffer of AES_CBC_encrypt_multi() that is being encrypted. */
+struct mb_lane {
+	uint8_t *buf; /**< Next block */
+	uint64_t left; /**< Blocks left */
+	uint32_t idx; /**< Index in the arguments */
+};
+
+// Encrypt n blocks of each of the first k lanes, the rounds of the k lanes are
+// interleaved. k is a constant in each caller, so the lane loops are unrolled.
+static TARGET_AESNI inline __attribute__((always_inline)) void
+mb_encrypt(struct mb_lane *lanes, __m128i *iv, int k, uint64_t n,
+	   const __m128i *rk)
+{
+	__m128i b[NI_LANES];
+	uint64_t i;
+	int j, r;
+
+	for (i = 0; i < n; ++i) {
+		for (j = 0; j < k; ++j) {
+			b[j] = _mm_xor_si128(load_block(lanes[j].buf), iv[j]);
+			b[j] = _mm_xor_si128(b[j], rk[0]);
+		}
+		for (r = 1; r < AES_NR; ++r) {
+			for (j = 0; j < k; ++j) {
+				b[j] = _mm_aesenc_si128(b[j], rk[r]);
+			}
+		}
+		for (j = 0; j < k; ++j) {
+			iv[j] = _mm_aesenclast_si128(b[j], rk[AES_NR]);
+			store_block(lanes[j].buf, iv[j]);
+			lanes[j].buf += AES_BLOCKLEN;
+		}
+	}
+	for (j = 0; j < k; ++j) {
+		lanes[j].left -= n;
+	}
+}
+
+static TARGET_AESNI void ni_cbc_encrypt_multi(const struct AES_ctx *ctx,
+					      uint8_t *const bufs[],
+					      const uint32_t lengths[],
+					      uint8_t (*ivs)[AES_BLOCKLEN],
+					      uint32_t n)
+{
+	struct mb_lane lanes[NI_LANES];
+	__m128i iv[NI_LANES];
+	__m128i rk[AES_NR + 1];
+	uint32_t next = 0;
+	uint64_t step;
+	int j, k = 0;
+
+	load_enc_keys(rk, ctx->RoundKey);
+	for (;;) {
+		// Fill the free lanes, the active lanes are always the first k.
+		for (; k < NI_LANES && next < n; ++next) {
+			if (lengths[next] == 0) {
+				continue;
+			}
+			lanes[k].buf = bufs[next];
+			lanes[k].left = nb_blocks(lengths[next]);
+			lanes[k].idx = next;
+			iv[k++] = load_block(ivs[next]);
+		}
+		if (k == 0) {
+			break;
+		}
+
+		// Run until the shortest buffer is done.
+		step = lanes[0].left;
+		for (j = 1; j < k; ++j) {
+			step = lanes[j].left < step ? lanes[j].left : step;
+		}
+		switch (k) {
+		case 8:
+			mb_encrypt(lanes, iv, 8, step, rk);
+			break;
+		case 7:
+			mb_encrypt(lanes, iv, 7, step, rk);
+			break;
+		case 6:
+			mb_encrypt(lanes, iv, 6, step, rk);
+			break;
+		case 5:
+			mb_encrypt(lanes, iv, 5, step, rk);
+			break;
+		case 4:
+			mb_encrypt(lanes, iv, 4, step, rk);
+			break;
+		case 3:
+			mb_encrypt(lanes, iv, 3, step, rk);
+			break;
+		case 2:
+			mb_encrypt(lanes, iv, 2, step, rk);
+			break;
+		default:
+			mb_encrypt(lanes, iv, 1, step, rk);
+			break;
+		}
+
+		for (j = 0; j < k;) {
+			if (lanes[j].left != 0) {
+				++j;
+				continue;
+			}
+			store_block(ivs[lanes[j].idx], iv[j]);
+			--k;
+			lanes[j] = lanes[k];
+			iv[j] = iv[k];
+		}
+	}
+}
+
+#endif // #if defined(CBC) && (CBC == 1)
+
+#if defined(CTR) && (CTR == 1)
+
+// Same semantics as the software code: every call starts a new key stream
+// block, the rest of the key stream of a partial last block is discarded.
+static TARGET_AESNI void ni_ctr_xcrypt(struct AES_ctx *ctx, uint8_t *buf,
+				       uint32_t length)
+{
+	uint8_t ks[AES_BLOCKLEN];
+	__m128i rk[AES_NR + 1];
+	__m128i b[NI_LANES];
+	struct ctr128 c;
+	uint32_t i;
+	int j;
+
+	load_enc_keys(rk, ctx->RoundKey);
+	ctr_load(&c, ctx->Iv);
+	for (; length >= sizeof(b); length -= sizeof(b), buf += sizeof(b)) {
+		for (j = 0; j < NI_LANES; ++j) {
+			b[j] = ctr_next(&c);
+		}
+		enc_lanes(b, rk);
+		for (j = 0; j < NI_LANES; ++j) {
+			store_block(buf + j * AES_BLOCKLEN,
+				    _mm_xor_si128(b[j], load_block(
+						buf + j * AES_BLOCKLEN)));
+		}
+	}
+	for (; length >= AES_BLOCKLEN;
+	     length -= AES_BLOCKLEN, buf += AES_BLOCKLEN) {
+		store_block(buf, _mm_xor_si128(enc_block(ctr_next(&c), rk),
+					       load_block(buf)));
+	}
+	if (length > 0) {
+		store_block(ks, enc_block(ctr_next(&c), rk));
+		for (i = 0; i < length; ++i) {
+			buf[i] ^= ks[i];
+		}
+	}
+	ctr_store(&c, ctx->Iv);
+}
+
+#endif // #if defined(CTR) && (CTR == 1)
+
+#if defined(GCM) && (GCM == 1)
+
+/*
+ * GCM: CTR with inc32() on the 32-bit block counter of J0 = IV || 1, GHASH
+ * with PCLMULQDQ on the byte-reversed blocks (Gueron and Kounavis, "Intel
+ * Carry-Less Multiplication Instruction and its Usage for Computing the GCM
+ * Mode"). Up to AES_GCM_HPOWS blocks are multiplied with the powers of H and
+ * summed before one reduction. The ciphertext is hashed right after it is
+ * computed, while it is still in registers.
+ */
+
+#define TARGET_GCM __attribute__((target("sse2,ssse3,aes,pclmul")))
+
+static TARGET_GCM inline __m128i bswap_block(__m128i b)
+{
+	return _mm_shuffle_epi8(b, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+						10, 11, 12, 13, 14, 15));
+}
+
+static TARGET_AESNI inline __m128i load_partial(const uint8_t *p,
+						uint32_t len)
+{
+	uint8_t b[AES_BLOCKLEN] = { 0 };
+
+	memcpy(b, p, len);
+	return load_block(b);
+}
+
+// J0 with the bytes reversed, the block counter is the lowest 32-bit word.
+static TARGET_GCM inline __m128i j0_of(const uint8_t *iv)
+{
+	uint8_t j0[AES_BLOCKLEN] = { 0 };
+
+	memcpy(j0, iv, AES_GCM_IVLEN);
+	j0[AES_BLOCKLEN - 1] = 1;
+	return bswap_block(load_block(j0));
+}
+
+// The counter block i of J0, i = 0 is J0 itself.
+static TARGET_GCM inline __m128i ctr_block(__m128i j0r, uint32_t i)
+{
+	return bswap_block(_mm_add_epi32(j0r, _mm_setr_epi32(i, 0, 0, 0)));
+}
+
+/* Unreduced sum of 256-bit products, the middle 128 bits are kept apart. */
+struct gh_acc {
+	__m128i lo;
+	__m128i mid;
+	__m128i hi;
+};
+
+static TARGET_GCM inline void gh_mul(struct gh_acc *a, __m128i x, __m128i h)
+{
+	a->lo = _mm_xor_si128(a->lo, _mm_clmulepi64_si128(x, h, 0x00));
+	a->hi = _mm_xor_si128(a->hi, _mm_clmulepi64_si128(x, h, 0x11));
+	a->mid = _mm_xor_si128(a->mid,
+			       _mm_xor_si128(_mm_clmulepi64_si128(x, h, 0x01),
+					     _mm_clmulepi64_si128(x, h, 0x10)));
+}
+
+// Shift the product left by one bit, the operands are bit-reflected, and
+// reduce it modulo x^128 + x^7 + x^2 + x + 1 (algorithm 5 of the paper).
+static TARGET_GCM inline __m128i gh_reduce(const struct gh_acc *a)
+{
+	__m128i t2, t3, t4, t5, t6, t7, t8, t9;
+
+	t3 = _mm_xor_si128(a->lo, _mm_slli_si128(a->mid, 8));
+	t6 = _mm_xor_si128(a->hi, _mm_srli_si128(a->mid, 8));
+
+	t7 = _mm_srli_epi32(t3, 31);
+	t8 = _mm_srli_epi32(t6, 31);
+	t3 = _mm_slli_epi32(t3, 1);
+	t6 = _mm_slli_epi32(t6, 1);
+	t9 = _mm_srli_si128(t7, 12);
+	t8 = _mm_slli_si128(t8, 4);
+	t7 = _mm_slli_si128(t7, 4);
+	t3 = _mm_or_si128(t3, t7);
+	t6 = _mm_or_si128(t6, t8);
+	t6 = _mm_or_si128(t6, t9);
+
+	t7 = _mm_slli_epi32(t3, 31);
+	t8 = _mm_slli_epi32(t3, 30);
+	t9 = _mm_slli_epi32(t3, 25);
+	t7 = _mm_xor_si128(t7, t8);
+	t7 = _mm_xor_si128(t7, t9);
+	t8 = _mm_srli_si128(t7, 4);
+	t7 = _mm_slli_si128(t7, 12);
+	t3 = _mm_xor_si128(t3, t7);
+
+	t2 = _mm_srli_epi32(t3, 1);
+	t4 = _mm_srli_epi32(t3, 2);
+	t5 = _mm_srli_epi32(t3, 7);
+	t2 = _mm_xor_si128(t2, t4);
+	t2 = _mm_xor_si128(t2, t5);
+	t2 = _mm_xor_si128(t2, t8);
+	t3 = _mm_xor_si128(t3, t2);
+	return _mm_xor_si128(t6, t3);
+}
+
+/* GHASH of one buffer, the blocks are hashed in groups of AES_GCM_HPOWS. */
+struct ghash {
+	__m128i x; /**< Hash of the reduced groups, bytes reversed */
+	__m128i b[AES_GCM_HPOWS]; /**< Pending blocks, bytes reversed */
+	int k; /**< Number of pending blocks */
+};
+
+// H[i] is H^(i+1).
+static TARGET_GCM inline void gh_flush(struct ghash *g, const __m128i *H)
+{
+	struct gh_acc a;
+	int i;
+
+	if (g->k == 0) {
+		return;
+	}
+	a.lo = a.mid = a.hi = _mm_setzero_si128();
+	gh_mul(&a, _mm_xor_si128(g->x, g->b[0]), H[g->k - 1]);
+	for (i = 1; i < g->k; ++i) {
+		gh_mul(&a, g->b[i], H[g->k - 1 - i]);
+	}
+	g->x = gh_reduce(&a);
+	g->k = 0;
+}
+
+static TARGET_GCM inline void gh_push(struct ghash *g, __m128i b,
+				      const __m128i *H)
+{
+	g->b[g->k++] = bswap_block(b);
+	if (g->k == AES_GCM_HPOWS) {
+		gh_flush(g, H);
+	}
+}
+
+// A partial last block is padded with zeros.
+static TARGET_GCM inline void gh_push_bytes(struct ghash *g, const uint8_t *p,
+					    uint32_t len, const __m128i *H)
+{
+	for (; len >= AES_BLOCKLEN; len -= AES_BLOCKLEN, p += AES_BLOCKLEN) {
+		gh_push(g, load_block(p), H);
+	}
+	if (len > 0) {
+		gh_push(g, load_partial(p, len), H);
+	}
+}
+
+static TARGET_GCM inline void gh_init(struct ghash *g,
+				      const struct AES_GCM_buf *b,
+				      const __m128i *H)
+{
+	g->x = _mm_setzero_si128();
+	g->k = 0;
+	gh_push_bytes(g, b->aad, b->aad_len, H);
+}
+
+// XOR len bytes with the key stream blocks ks and hash the ciphertext.
+static TARGET_GCM inline void gcm_xor(struct ghash *g, uint8_t *p,
+				      uint32_t len, const __m128i *ks,
+				      const __m128i *H, int encrypt)
+{
+	uint8_t t[AES_BLOCKLEN];
+	__m128i in, out;
+
+	for (; len >= AES_BLOCKLEN;
+	     len -= AES_BLOCKLEN, p += AES_BLOCKLEN, ++ks) {
+		in = load_block(p);
+		out = _mm_xor_si128(in, *ks);
+		store_block(p, out);
+		gh_push(g, encrypt ? out : in, H);
+	}
+	if (len > 0) {
+		in = load_partial(p, len);
+		store_block(t, _mm_xor_si128(in, *ks));
+		memcpy(p, t, len);
+		gh_push(g, encrypt ? load_partial(t, len) : in, H);
+	}
+}
+
+// Hash the lengths and write (encryption) or check (decryption) the tag.
+// ks0 is the encrypted J0. Return 1 if the tag is valid.
+static TARGET_GCM inline int gcm_final(struct ghash *g,
+				       const struct AES_GCM_buf *b, __m128i ks0,
+				       const __m128i *H, int encrypt)
+{
+	__m128i tag;
+
+	gh_push(g,
+		_mm_set_epi64x(
+			(long long)__builtin_bswap64((uint64_t)b->length * 8),
+			(long long)__builtin_bswap64((uint64_t)b->aad_len * 8)),
+		H);
+	gh_flush(g, H);
+	tag = _mm_xor_si128(ks0, bswap_block(g->x));
+	if (encrypt) {
+		store_block(b->tag, tag);
+		return 1;
+	}
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(tag, load_block(b->tag))) ==
+	       0xffff;
+}
+
+// Process the data from the counter block cnt on, NI_LANES blocks at a time.
+static TARGET_GCM inline void ni_gcm_blocks(struct ghash *g, uint8_t *p,
+					    uint32_t len, __m128i j0r,
+					    uint32_t cnt, const __m128i *rk,
+					    const __m128i *H, int encrypt)
+{
+	__m128i b[NI_LANES];
+	uint32_t chunk;
+	int j;
+
+	while (len > 0) {
+		for (j = 0; j < NI_LANES; ++j) {
+			b[j] = ctr_block(j0r, cnt + j);
+		}
+		enc_lanes(b, rk);
+		chunk = len < sizeof(b) ? len : sizeof(b);
+		gcm_xor(g, p, chunk, b, H, encrypt);
+		cnt += NI_LANES;
+		p += chunk;
+		len -= chunk;
+	}
+}
+
+static TARGET_GCM int ni_gcm_large(const struct AES_GCM_buf *b,
+				   const __m128i *rk, const __m128i *H,
+				   int encrypt)
+{
+	__m128i j0r = j0_of(b->iv);
+	__m128i ks0 = enc_block(ctr_block(j0r, 0), rk);
+	struct ghash g;
+
+	gh_init(&g, b, H);
+	ni_gcm_blocks(&g, b->buf, b->length, j0r, 1, rk, H, encrypt);
+	return gcm_final(&g, b, ks0, H, encrypt);
+}
+
+// ks[0] is the encrypted J0, followed by the key stream of the data.
+static TARGET_GCM inline int gcm_small(const struct AES_GCM_buf *b,
+				       const __m128i *ks, const __m128i *H,
+				       int encrypt)
+{
+	struct ghash g;
+
+	gh_init(&g, b, H);
+	gcm_xor(&g, b->buf, b->length, ks + 1, H, encrypt);
+	return gcm_final(&g, b, ks[0], H, encrypt);
+}
+
+static TARGET_AESNI void ni_gcm_ks(__m128i *ks, const __m128i *rk)
+{
+	enc_lanes(ks, rk);
+}
+
+/* Key stream width and large buffer path of an implementation. */
+struct gcm_impl {
+	uint32_t lanes; /**< Blocks encrypted together, at most VAES_LANES */
+	void (*ks)(__m128i *ks, const __m128i *rk);
+	int (*large)(const struct AES_GCM_buf *b, const __m128i *rk,
+		     const __m128i *H, int encrypt);
+};
+
+static const struct gcm_impl ni_gcm = {
+	.lanes = NI_LANES,
+	.ks = ni_gcm_ks,
+	.large = ni_gcm_large,
+};
+
+// Buffers that need more counter blocks than lanes (J0 included) are
+// processed one by one. The counter blocks of the smaller ones are gathered
+// until the next one does not fit, then encrypted in one pass.
+static TARGET_GCM inline __attribute__((always_inline)) uint32_t
+gcm_multi(const struct gcm_impl *impl, const struct AES_GCM_ctx *ctx,
+	  const struct AES_GCM_buf *bufs, uint32_t n, int encrypt,
+	  uint8_t *valid)
+{
+	__m128i rk[AES_NR + 1], H[AES_GCM_HPOWS];
+	__m128i ks[VAES_LANES];
+	uint32_t group[VAES_LANES];
+	uint32_t i, j, k = 0, used = 0, need, nb_valid = 0;
+	__m128i j0r;
+	int ok;
+
+	load_enc_keys(rk, ctx->aes.RoundKey);
+	for (i = 0; i < AES_GCM_HPOWS; ++i) {
+		H[i] = load_block(ctx->Htab[i]);
+	}
+	for (i = 0; i <= n; ++i) {
+		need = i < n ? 1 + nb_blocks(bufs[i].length) : impl->lanes + 1;
+		if (need > impl->lanes - used && k > 0) {
+			impl->ks(ks, rk);
+			for (j = 0, used = 0; j < k; ++j) {
+				ok = gcm_small(&bufs[group[j]], &ks[used], H,
+					       encrypt);
+				used += 1 + nb_blocks(bufs[group[j]].length);
+				if (!encrypt) {
+					valid[group[j]] = ok;
+					nb_valid += ok;
+				}
+			}
+			k = 0;
+			used = 0;
+		}
+		if (i == n) {
+			break;
+		}
+		if (need > impl->lanes) {
+			ok = impl->large(&bufs[i], rk, H, encrypt);
+			if (!encrypt) {
+				valid[i] = ok;
+				nb_valid += ok;
+			}
+			continue;
+		}
+		j0r = j0_of(bufs[i].iv);
+		for (j = 0; j < need; ++j) {
+			ks[used + j] = ctr_block(j0r, j);
+		}
+		used += need;
+		group[k++] = i;
+	}
+	return nb_valid;
+}
+
+static TARGET_GCM void ni_gcm_encrypt_multi(const struct AES_GCM_ctx *ctx,
+					    const struct AES_GCM_buf *bufs,
+					    uint32_t n)
+{
+	gcm_multi(&ni_gcm, ctx, bufs, n, 1, NULL);
+}
+
+static TARGET_GCM uint32_t ni_gcm_decrypt_multi(const struct AES_GCM_ctx *ctx,
+						const struct AES_GCM_buf *bufs,
+						uint32_t n, uint8_t *valid)
+{
+	return gcm_multi(&ni_gcm, ctx, bufs, n, 0, valid);
+}
+
+#endif // #if defined(GCM) && (GCM == 1)
+
+static const struct aes_ops ni_ops = {
+	.impl = AES_IMPL_AESNI,
+#if defined(ECB) && (ECB == 1)
+	.ecb_encrypt = ni_ecb_encrypt,
+	.ecb_decrypt = ni_ecb_decrypt,
+#endif
+#if defined(CBC) && (CBC == 1)
+	.cbc_encrypt = ni_cbc_encrypt,
+	.cbc_decrypt = ni_cbc_decrypt,
+	.cbc_encrypt_multi = ni_cbc_encrypt_multi,
+#endif
+#if defined(CTR) && (CTR == 1)
+	.ctr_xcrypt = ni_ctr_xcrypt,
+#endif
+#if defined(GCM) && (GCM == 1)
+	.gcm_encrypt_multi = ni_gcm_encrypt_multi,
+	.gcm_decrypt_multi = ni_gcm_decrypt_multi,
+#endif
+};
+
+/*****************************************************************************/
+/* VAES, four blocks per AVX-512 register                                    */
+/*****************************************************************************/
+
+static TARGET_VAES inline void bcast_keys(__m512i k[AES_NR + 1],
+					  const __m128i *rk)
+{
+	int i;
+
+	for (i = 0; i <= AES_NR; ++i) {
+		k[i] = _mm512_broadcast_i32x4(rk[i]);
+	}
+}
+
+#if defined(CBC) && (CBC == 1)
+
+static TARGET_VAES void vaes_cbc_decrypt(struct AES_ctx *ctx, uint8_t *buf,
+					 uint32_t length)
+{
+	__m512i b[VAES_REGS], c[VAES_REGS];
+	__m512i dk[AES_NR + 1];
+	__m128i dk128[AES_NR + 1];
+	uint64_t i, n = nb_blocks(length);
+	__m512i last;
+	int r, j;
+
+	if (n < VAES_LANES) {
+		ni_cbc_decrypt_blocks(ctx, buf, n);
+		return;
+	}
+	load_dec_keys(dk128, ctx->RoundKey);
+	bcast_keys(dk, dk128);
+	// Lane 3 of last holds the previous ciphertext block.
+	last = _mm512_broadcast_i32x4(load_block(ctx->Iv));
+	for (i = 0; i + VAES_LANES <= n; i += VAES_LANES, buf += sizeof(c)) {
+		for (j = 0; j < VAES_REGS; ++j) {
+			c[j] = _mm512_loadu_si512(buf + j * sizeof(c[0]));
+			b[j] = _mm512_xor_si512(c[j], dk[0]);
+		}
+		for (r = 1; r < AES_NR; ++r) {
+			for (j = 0; j < VAES_REGS; ++j) {
+				b[j] = _mm512_aesdec_epi128(b[j], dk[r]);
+			}
+		}
+		for (j = 0; j < VAES_REGS; ++j) {
+			b[j] = _mm512_aesdeclast_epi128(b[j], dk[AES_NR]);
+		}
+		// XOR each block with its predecessor: shift the ciphertext
+		// by one block (two 64-bit words).
+		b[0] = _mm512_xor_si512(b[0],
+					_mm512_alignr_epi64(c[0], last, 6));
+		for (j = 1; j < VAES_REGS; ++j) {
+			b[j] = _mm512_xor_si512(
+				b[j], _mm512_alignr_epi64(c[j], c[j - 1], 6));
+		}
+		for (j = 0; j < VAES_REGS; ++j) {
+			_mm512_storeu_si512(buf + j * sizeof(b[0]), b[j]);
+		}
+		last = c[VAES_REGS - 1];
+	}
+	store_block(ctx->Iv, _mm512_extracti32x4_epi32(last, 3));
+	ni_cbc_decrypt_blocks(ctx, buf, n - i);
+}
+
+#endif // #if defined(CBC) && (CBC == 1)
+
+#if defined(CTR) && (CTR == 1)
+
+static TARGET_VAES void vaes_ctr_xcrypt(struct AES_ctx *ctx, uint8_t *buf,
+					uint32_t length)
+{
+	// Swap the bytes of each 64-bit word.
+	const __m512i bswap = _mm512_set4_epi64(
+		0x08090a0b0c0d0e0fLL, 0x0001020304050607LL,
+		0x08090a0b0c0d0e0fLL, 0x0001020304050607LL);
+	const __m512i inc = _mm512_set_epi64(4, 0, 4, 0, 4, 0, 4, 0);
+	__m512i b[VAES_REGS];
+	__m512i k[AES_NR + 1];
+	__m128i rk[AES_NR + 1];
+	__m512i ctr;
+	struct ctr128 c;
+	int r, j;
+
+	if (length < VAES_LANES * AES_BLOCKLEN) {
+		ni_ctr_xcrypt(ctx, buf, length);
+		return;
+	}
+	load_enc_keys(rk, ctx->RoundKey);
+	bcast_keys(k, rk);
+	ctr_load(&c, ctx->Iv);
+	for (; length >= sizeof(b); length -= sizeof(b), buf += sizeof(b)) {
+		// The low words are added without carry, the rare chunk that
+		// wraps them is left to the AES-NI code.
+		if (c.lo > UINT64_MAX - VAES_LANES) {
+			break;
+		}
+		ctr = _mm512_set_epi64(c.lo + 3, c.hi, c.lo + 2, c.hi, c.lo + 1,
+				       c.hi, c.lo, c.hi);
+		for (j = 0; j < VAES_REGS; ++j) {
+			b[j] = _mm512_xor_si512(
+				_mm512_shuffle_epi8(ctr, bswap), k[0]);
+			ctr = _mm512_add_epi64(ctr, inc);
+		}
+		for (r = 1; r < AES_NR; ++r) {
+			for (j = 0; j < VAES_REGS; ++j) {
+				b[j] = _mm512_aesenc_epi128(b[j], k[r]);
+			}
+		}
+		for (j = 0; j < VAES_REGS; ++j) {
+			b[j] = _mm512_aesenclast_epi128(b[j], k[AES_NR]);
+			b[j] = _mm512_xor_si512(
+				b[j],
+				_mm512_loadu_si512(buf + j * sizeof(b[0])));
+			_mm512_storeu_si512(buf + j * sizeof(b[0]), b[j]);
+		}
+		c.lo += VAES_LANES;
+	}
+	ctr_store(&c, ctx->Iv);
+	ni_ctr_xcrypt(ctx, buf, length);
+}
+
+#endif // #if defined(CTR) && (CTR == 1)
+
+#if defined(GCM) && (GCM == 1)
+
+#define TARGET_VGCM                                                            \
+	__attribute__((target("sse2,ssse3,aes,pclmul,avx512f,avx512bw,vaes,"   \
+			      "vpclmulqdq")))
+
+static TARGET_VGCM inline __m128i xor_lanes(__m512i v)
+{
+	__m256i t = _mm256_xor_si256(_mm512_castsi512_si256(v),
+				     _mm512_extracti64x4_epi64(v, 1));
+
+	return _mm_xor_si128(_mm256_castsi256_si128(t),
+			     _mm256_extracti128_si256(t, 1));
+}
+
+static TARGET_VGCM void vaes_gcm_ks(__m128i *ks, const __m128i *rk)
+{
+	__m512i b[VAES_REGS];
+	__m512i k[AES_NR + 1];
+	int r, j;
+
+	bcast_keys(k, rk);
+	for (j = 0; j < VAES_REGS; ++j) {
+		b[j] = _mm512_xor_si512(_mm512_loadu_si512(ks + 4 * j), k[0]);
+	}
+	for (r = 1; r < AES_NR; ++r) {
+		for (j = 0; j < VAES_REGS; ++j) {
+			b[j] = _mm512_aesenc_epi128(b[j], k[r]);
+		}
+	}
+	for (j = 0; j < VAES_REGS; ++j) {
+		_mm512_storeu_si512(ks + 4 * j,
+				   _mm512_aesenclast_epi128(b[j], k[AES_NR]));
+	}
+}
+
+// VAES_LANES blocks per iteration, their GHASH is one reduction. The rest is
+// left to the AES-NI code.
+static TARGET_VGCM int vaes_gcm_large(const struct AES_GCM_buf *b,
+				      const __m128i *rk, const __m128i *H,
+				      int encrypt)
+{
+	const __m512i bswap = _mm512_broadcast_i32x4(_mm_set_epi8(
+		0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+	const __m512i inc = _mm512_broadcast_i32x4(_mm_setr_epi32(4, 0, 0, 0));
+	__m512i c[VAES_REGS], hz[VAES_REGS];
+	__m512i k[AES_NR + 1];
+	__m512i ctr, in, out, d, lo, mid, hi;
+	__m128i j0r = j0_of(b->iv);
+	__m128i ks0 = enc_block(ctr_block(j0r, 0), rk);
+	uint32_t len = b->length, cnt = 1;
+	uint8_t *p = b->buf;
+	struct gh_acc a;
+	struct ghash g;
+	int r, j;
+
+	gh_init(&g, b, H);
+	gh_flush(&g, H);
+	bcast_keys(k, rk);
+	// Register j holds the blocks 4j to 4j+3, they are multiplied with
+	// H^(16-4j) down to H^(13-4j).
+	for (j = 0; j < VAES_REGS; ++j) {
+		hz[j] = _mm512_loadu_si512(H + 4 * (VAES_REGS - 1 - j));
+		hz[j] = _mm512_shuffle_i64x2(hz[j], hz[j], 0x1b);
+	}
+	ctr = _mm512_add_epi32(_mm512_broadcast_i32x4(j0r),
+			       _mm512_set_epi32(0, 0, 0, 4, 0, 0, 0, 3, 0, 0, 0,
+						2, 0, 0, 0, 1));
+	for (; len >= sizeof(c); len -= sizeof(c), p += sizeof(c)) {
+		for (j = 0; j < VAES_REGS; ++j) {
+			c[j] = _mm512_xor_si512(_mm512_shuffle_epi8(ctr, bswap),
+						k[0]);
+			ctr = _mm512_add_epi32(ctr, inc);
+		}
+		for (r = 1; r < AES_NR; ++r) {
+			for (j = 0; j < VAES_REGS; ++j) {
+				c[j] = _mm512_aesenc_epi128(c[j], k[r]);
+			}
+		}
+		lo = mid = hi = _mm512_setzero_si512();
+		for (j = 0; j < VAES_REGS; ++j) {
+			in = _mm512_loadu_si512(p + j * sizeof(c[0]));
+			out = _mm512_xor_si512(
+				_mm512_aesenclast_epi128(c[j], k[AES_NR]), in);
+			_mm512_storeu_si512(p + j * sizeof(c[0]), out);
+			d = _mm512_shuffle_epi8(encrypt ? out : in, bswap);
+			if (j == 0) {
+				d = _mm512_xor_si512(
+					d, _mm512_zextsi128_si512(g.x));
+			}
+			lo = _mm512_xor_si512(
+				lo, _mm512_clmulepi64_epi128(d, hz[j], 0x00));
+			hi = _mm512_xor_si512(
+				hi, _mm512_clmulepi64_epi128(d, hz[j], 0x11));
+			mid = _mm512_ternarylogic_epi64(
+				mid, _mm512_clmulepi64_epi128(d, hz[j], 0x01),
+				_mm512_clmulepi64_epi128(d, hz[j], 0x10), 0x96);
+		}
+		a.lo = xor_lanes(lo);
+		a.mid = xor_lanes(mid);
+		a.hi = xor_lanes(hi);
+		g.x = gh_reduce(&a);
+		cnt += VAES_LANES;
+	}
+	ni_gcm_blocks(&g, p, len, j0r, cnt, rk, H, encrypt);
+	return gcm_final(&g, b, ks0, H, encrypt);
+}
+
+static const struct gcm_impl vaes_gcm = {
+	.lanes = VAES_LANES,
+	.ks = vaes_gcm_ks,
+	.large = vaes_gcm_large,
+};
+
+static TARGET_GCM void vaes_gcm_encrypt_multi(const struct AES_GCM_ctx *ctx,
+					      const struct AES_GCM_buf *bufs,
+					      uint32_t n)
+{
+	gcm_multi(&vaes_gcm, ctx, bufs, n, 1, NULL);
+}
+
+static TARGET_GCM uint32_t
+vaes_gcm_decrypt_multi(const struct AES_GCM_ctx *ctx,
+		       const struct AES_GCM_buf *bufs, uint32_t n,
+		       uint8_t *valid)
+{
+	return gcm_multi(&vaes_gcm, ctx, bufs, n, 0, valid);
+}
+
+#endif // #if defined(GCM) && (GCM == 1)
+
+// Single blocks and CBC encryption do not gain from wider registers.
+static const struct aes_ops vaes_ops = {
+	.impl = AES_IMPL_VAES,
+#if defined(ECB) && (ECB == 1)
+	.ecb_encrypt = ni_ecb_encrypt,
+	.ecb_decrypt = ni_ecb_decrypt,
+#endif
+#if defined(CBC) && (CBC == 1)
+	.cbc_encrypt = ni_cbc_encrypt,
+	.cbc_decrypt = vaes_cbc_decrypt,
+	.cbc_encrypt_multi = ni_cbc_encrypt_multi,
+#endif
+#if defined(CTR) && (CTR == 1)
+	.ctr_xcrypt = vaes_ctr_xcrypt,
+#endif
+#if defined(GCM) && (GCM == 1)
+	.gcm_encrypt_multi = vaes_gcm_encrypt_multi,
+	.gcm_decrypt_multi = vaes_gcm_decrypt_multi,
+#endif
+};
+
+// GCM needs PCLMULQDQ (VPCLMULQDQ for VAES), without it the next implementation
+// is selected.
+const struct aes_ops *aes_ni_get_ops(void)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul")) {
+		return &ni_ops;
+	}
+	return NULL;
+}
+
+const struct aes_ops *aes_vaes_get_ops(void)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("aes") && __builtin_cpu_supports("vaes") &&
+	    __builtin_cpu_supports("avx512f") &&
+	    __builtin_cpu_supports("avx512bw") &&
+	    __builtin_cpu_supports("pclmul") &&
+	    __builtin_cpu_supports("vpclmulqdq")) {
+		return &vaes_ops;
+	}
+	return NULL;
+}
+
+#else
+
+const struct aes_ops *aes_ni_get_ops(void)
+{
+	return NULL;
+}
+
+const struct aes_ops *aes_vaes_get_ops(void)
+{
+	return NULL;
+}
+
+#endif // #if defined(__x86_64__)
@@ -0,0 +1,25 @@
+/*
+ * chain.cpp
+ */
+
+#include <ffpp/chain.h>
+#include <ffpp/chain.hpp>
+
+uint16_t ffpp_chain_l2fwd(struct ffpp_mvec *vec, void *arg)
+{
+	auto args = static_cast<const struct ffpp_chain_mac_args *>(arg);
+	ffpp::chain<ffpp::RewriteMac> c(
+		ffpp::RewriteMac(args->src, args->dst));
+
+	return c(vec);
+}
+
+uint16_t ffpp_chain_l3fwd(struct ffpp_mvec *vec, void *arg)
+{
+	auto args = static_cast<const struct ffpp_chain_mac_args *>(arg);
+	ffpp::chain<ffpp::ParseEth, ffpp::DecTTL, ffpp::RewriteMac> c(
+		ffpp::ParseEth(), ffpp::DecTTL(),
+		ffpp::RewriteMac(args->src, args->dst));
+
+	return c(vec);
+}
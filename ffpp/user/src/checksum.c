@@ -0,0 +1,315 @@
+/*
+ * checksum.c
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <rte_byteorder.h>
+#include <rte_ethdev.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+#include <rte_tcp.h>
+#include <rte_udp.h>
+#include <rte_vect.h>
+
+#include <ffpp/checksum.h>
+
+#define VLAN_HDR_LEN (sizeof(struct rte_vlan_hdr))
+
+static __rte_always_inline uint16_t fold64(uint64_t sum)
+{
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	return ffpp_csum_fold((uint32_t)sum);
+}
+
+/*
+ * Sum of 32-bit words, folded at the end. The sum of the 32-bit words folds to
+ * the same value as the sum of the 16-bit words.
+ */
+static __rte_always_inline uint64_t sum_scalar(const uint8_t *p, size_t len)
+{
+	uint64_t sum = 0;
+	uint32_t w32;
+	uint16_t w16;
+
+	for (; len >= 4; len -= 4, p += 4) {
+		memcpy(&w32, p, sizeof(w32));
+		sum += w32;
+	}
+	if (len >= 2) {
+		memcpy(&w16, p, sizeof(w16));
+		sum += w16;
+		len -= 2;
+		p += 2;
+	}
+	if (len == 1) {
+		// The last byte is padded with a zero byte.
+		w16 = 0;
+		memcpy(&w16, p, 1);
+		sum += w16;
+	}
+	return sum;
+}
+
+uint16_t ffpp_csum_raw_scalar(const void *buf, size_t len)
+{
+	return fold64(sum_scalar(buf, len));
+}
+
+#if defined(__AVX2__)
+
+/*
+ * Each block of 32 bytes adds at most 2 * 0xffff to the 32-bit lanes, they are
+ * widened to the 64-bit accumulator before they can overflow.
+ */
+#define AVX2_BLOCKS_MAX 16384
+
+uint16_t ffpp_csum_raw(const void *buf, size_t len)
+{
+	const __m256i lo16 = _mm256_set1_epi32(0xffff);
+	const __m256i lo32 = _mm256_set1_epi64x(0xffffffff);
+	const uint8_t *p = buf;
+	__m256i acc = _mm256_setzero_si256();
+	__m256i acc32, v;
+	uint64_t lanes[4];
+	size_t i, n;
+
+	while (len >= 32) {
+		n = RTE_MIN(len / 32, (size_t)AVX2_BLOCKS_MAX);
+		acc32 = _mm256_setzero_si256();
+		for (i = 0; i < n; ++i) {
+			v = _mm256_loadu_si256((const __m256i *)p);
+			acc32 = _mm256_add_epi32(acc32,
+						 _mm256_and_si256(v, lo16));
+			acc32 = _mm256_add_epi32(acc32,
+						 _mm256_srli_epi32(v, 16));
+			p += 32;
+		}
+		len -= n * 32;
+		acc = _mm256_add_epi64(acc, _mm256_and_si256(acc32, lo32));
+		acc = _mm256_add_epi64(acc, _mm256_srli_epi64(acc32, 32));
+	}
+	_mm256_storeu_si256((__m256i *)lanes, acc);
+	return fold64(lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+		      sum_scalar(p, len));
+}
+
+#else
+
+uint16_t ffpp_csum_raw(const void *buf, size_t len)
+{
+	return ffpp_csum_raw_scalar(buf, len);
+}
+
+#endif
+
+static __rte_always_inline uint16_t l4_cksum(uint32_t sum, const void *l4,
+					     uint32_t l4_len, uint8_t proto)
+{
+	uint16_t cksum;
+
+	sum += ffpp_csum_raw(l4, l4_len);
+	cksum = (uint16_t)~ffpp_csum_fold(sum);
+	// RFC 768: a computed 0 is sent as all ones.
+	if (cksum == 0 && proto == IPPROTO_UDP) {
+		cksum = 0xffff;
+	}
+	return cksum;
+}
+
+uint16_t ffpp_csum_ipv4_udptcp(const struct rte_ipv4_hdr *ip, const void *l4)
+{
+	uint32_t l3_len = rte_be_to_cpu_16(ip->total_length);
+	uint32_t ihl = (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) *
+		       RTE_IPV4_IHL_MULTIPLIER;
+
+	if (unlikely(l3_len < ihl)) {
+		return 0;
+	}
+	return l4_cksum(rte_ipv4_phdr_cksum(ip, 0), l4, l3_len - ihl,
+			ip->next_proto_id);
+}
+
+uint16_t ffpp_csum_ipv6_udptcp(const struct rte_ipv6_hdr *ip6, const void *l4)
+{
+	return l4_cksum(rte_ipv6_phdr_cksum(ip6, 0), l4,
+			rte_be_to_cpu_16(ip6->payload_len), ip6->proto);
+}
+
+/**
+ * Return the L4 checksum field of a UDP or TCP header, NULL for other
+ * protocols or if the header is not in the first segment.
+ */
+static __rte_always_inline uint16_t *l4_cksum_field(struct rte_mbuf *m,
+						    uint8_t proto,
+						    uint32_t l4_off)
+{
+	if (proto == IPPROTO_UDP &&
+	    l4_off + sizeof(struct rte_udp_hdr) <= rte_pktmbuf_data_len(m)) {
+		return rte_pktmbuf_mtod_offset(
+			m, uint16_t *,
+			l4_off + offsetof(struct rte_udp_hdr, dgram_cksum));
+	}
+	if (proto == IPPROTO_TCP &&
+	    l4_off + sizeof(struct rte_tcp_hdr) <= rte_pktmbuf_data_len(m)) {
+		return rte_pktmbuf_mtod_offset(
+			m, uint16_t *,
+			l4_off + offsetof(struct rte_tcp_hdr, cksum));
+	}
+	return NULL;
+}
+
+static __rte_always_inline bool l4_offloaded(uint8_t proto,
+					     uint64_t tx_offloads)
+{
+	return (proto == IPPROTO_UDP &&
+		(tx_offloads & DEV_TX_OFFLOAD_UDP_CKSUM)) ||
+	       (proto == IPPROTO_TCP &&
+		(tx_offloads & DEV_TX_OFFLOAD_TCP_CKSUM));
+}
+
+/**
+ * Software L4 checksum over the pseudo header sum and l4_len bytes from
+ * l4_off. The checksum field must be zero.
+ */
+static void l4_cksum_sw(struct rte_mbuf *m, uint16_t *field, uint32_t phdr,
+			uint32_t l4_off, uint32_t l4_len, uint8_t proto)
+{
+	uint16_t sum;
+
+	if (likely(l4_off + l4_len <= rte_pktmbuf_data_len(m))) {
+		*field = l4_cksum(phdr,
+				  rte_pktmbuf_mtod_offset(m, void *, l4_off),
+				  l4_len, proto);
+		return;
+	}
+	if (rte_raw_cksum_mbuf(m, l4_off, l4_len, &sum) == 0) {
+		*field = (uint16_t)~ffpp_csum_fold(phdr + sum);
+		if (*field == 0 && proto == IPPROTO_UDP) {
+			*field = 0xffff;
+		}
+	}
+}
+
+static void finalize_ipv4(struct rte_mbuf *m, struct rte_ipv4_hdr *ip,
+			  uint16_t l2_len, uint64_t tx_offloads)
+{
+	uint32_t ihl = (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) *
+		       RTE_IPV4_IHL_MULTIPLIER;
+	uint32_t l3_len = rte_be_to_cpu_16(ip->total_length);
+	uint64_t ol_flags = 0;
+	uint16_t *field = NULL;
+
+	if (unlikely(ihl < sizeof(*ip) || l3_len < ihl ||
+		     l2_len + l3_len > rte_pktmbuf_pkt_len(m) ||
+		     l2_len + ihl > rte_pktmbuf_data_len(m))) {
+		return;
+	}
+	if ((ip->fragment_offset &
+	     RTE_BE16(RTE_IPV4_HDR_OFFSET_MASK | RTE_IPV4_HDR_MF_FLAG)) == 0) {
+		field = l4_cksum_field(m, ip->next_proto_id, l2_len + ihl);
+	}
+
+	ip->hdr_checksum = 0;
+	if (tx_offloads & DEV_TX_OFFLOAD_IPV4_CKSUM) {
+		ol_flags |= PKT_TX_IPV4 | PKT_TX_IP_CKSUM;
+	} else {
+		ip->hdr_checksum = rte_ipv4_cksum(ip);
+	}
+	if (field != NULL) {
+		*field = 0;
+		if (l4_offloaded(ip->next_proto_id, tx_offloads)) {
+			ol_flags |= PKT_TX_IPV4;
+			ol_flags |= ip->next_proto_id == IPPROTO_UDP ?
+					    PKT_TX_UDP_CKSUM :
+					    PKT_TX_TCP_CKSUM;
+			*field = rte_ipv4_phdr_cksum(ip, ol_flags);
+		} else {
+			l4_cksum_sw(m, field, rte_ipv4_phdr_cksum(ip, 0),
+				    l2_len + ihl, l3_len - ihl,
+				    ip->next_proto_id);
+		}
+	}
+	if (ol_flags != 0) {
+		m->l2_len = l2_len;
+		m->l3_len = ihl;
+		m->ol_flags |= ol_flags;
+	}
+}
+
+static void finalize_ipv6(struct rte_mbuf *m, struct rte_ipv6_hdr *ip6,
+			  uint16_t l2_len, uint64_t tx_offloads)
+{
+	uint32_t l4_len = rte_be_to_cpu_16(ip6->payload_len);
+	uint32_t l4_off = l2_len + sizeof(*ip6);
+	uint64_t ol_flags;
+	uint16_t *field;
+
+	if (unlikely(l4_off + l4_len > rte_pktmbuf_pkt_len(m))) {
+		return;
+	}
+	field = l4_cksum_field(m, ip6->proto, l4_off);
+	if (field == NULL) {
+		return;
+	}
+	*field = 0;
+	if (l4_offloaded(ip6->proto, tx_offloads)) {
+		ol_flags = PKT_TX_IPV6 | (ip6->proto == IPPROTO_UDP ?
+						  PKT_TX_UDP_CKSUM :
+						  PKT_TX_TCP_CKSUM);
+		*field = rte_ipv6_phdr_cksum(ip6, ol_flags);
+		m->l2_len = l2_len;
+		m->l3_len = sizeof(*ip6);
+		m->ol_flags |= ol_flags;
+	} else {
+		l4_cksum_sw(m, field, rte_ipv6_phdr_cksum(ip6, 0), l4_off,
+			    l4_len, ip6->proto);
+	}
+}
+
+static void finalize_one(struct rte_mbuf *m, uint64_t tx_offloads)
+{
+	const struct rte_ether_hdr *eth;
+	uint16_t len = rte_pktmbuf_data_len(m);
+	uint16_t off = RTE_ETHER_HDR_LEN;
+	uint16_t type;
+
+	if (unlikely(len < RTE_ETHER_HDR_LEN)) {
+		return;
+	}
+	eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+	type = eth->ether_type;
+	if (type == RTE_BE16(RTE_ETHER_TYPE_VLAN)) {
+		if (unlikely(len < off + VLAN_HDR_LEN)) {
+			return;
+		}
+		type = ((const struct rte_vlan_hdr *)(eth + 1))->eth_proto;
+		off += VLAN_HDR_LEN;
+	}
+	if (type == RTE_BE16(RTE_ETHER_TYPE_IPV4) &&
+	    len >= off + sizeof(struct rte_ipv4_hdr)) {
+		finalize_ipv4(m,
+			      rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *,
+						      off),
+			      off, tx_offloads);
+	} else if (type == RTE_BE16(RTE_ETHER_TYPE_IPV6) &&
+		   len >= off + sizeof(struct rte_ipv6_hdr)) {
+		finalize_ipv6(m,
+			      rte_pktmbuf_mtod_offset(m, struct rte_ipv6_hdr *,
+						      off),
+			      off, tx_offloads);
+	}
+}
+
+void ffpp_csum_finalize(struct ffpp_mvec *vec, uint64_t tx_offloads)
+{
+	uint16_t i;
+
+	for (i = 0; i < vec->len; ++i) {
+		finalize_one(vec->head[i], tx_offloads);
+	}
+}
@@ -0,0 +1,487 @@
+/*
+ * classifier.c
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <rte_byteorder.h>
+#include <rte_common.h>
+#include <rte_errno.h>
+#include <rte_ether.h>
+#include <rte_hash.h>
+#include <rte_hash_crc.h>
+#include <rte_ip.h>
+#include <rte_log.h>
+#include <rte_lpm.h>
+#include <rte_lpm6.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_prefetch.h>
+#include <rte_rcu_qsbr.h>
+#include <rte_spinlock.h>
+
+#include <ffpp/classifier.h>
+#include <ffpp/config.h>
+
+// Packets of a vector are looked up in chunks of this size.
+#define CLS_BULK RTE_HASH_LOOKUP_BULK_MAX
+#define PREFETCH_OFFSET 3
+#define LPM_NEXT_HOP_MASK 0x00ffffff
+
+struct ffpp_classifier {
+	struct ffpp_cls_config cfg;
+	struct rte_hash *exact;
+	struct rte_lpm *lpm;
+	// Active and standby copy, see ffpp_cls_add_lpm6().
+	struct rte_lpm6 *lpm6[2];
+	uint32_t lpm6_active;
+	struct rte_rcu_qsbr *qsbr;
+	rte_spinlock_t lock; /**< Serializes the writers */
+};
+
+struct ffpp_classifier *ffpp_cls_create(const struct ffpp_cls_config *cfg)
+{
+	struct ffpp_classifier *cls;
+	char name[RTE_HASH_NAMESIZE];
+	size_t sz;
+	int i;
+
+	if (cfg->name[0] == '\0' ||
+	    strnlen(cfg->name, FFPP_CLS_NAME_MAX_LEN) ==
+		    FFPP_CLS_NAME_MAX_LEN ||
+	    cfg->default_action > FFPP_CLS_ACTION_MAX) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+
+	cls = rte_zmalloc_socket("ffpp_classifier", sizeof(*cls),
+				 RTE_CACHE_LINE_SIZE, cfg->socket_id);
+	if (cls == NULL) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	cls->cfg = *cfg;
+	if (cls->cfg.lpm_tbl8s == 0) {
+		cls->cfg.lpm_tbl8s = FFPP_CLS_LPM_TBL8S_DEFAULT;
+	}
+	if (cls->cfg.lpm6_tbl8s == 0) {
+		cls->cfg.lpm6_tbl8s = FFPP_CLS_LPM6_TBL8S_DEFAULT;
+	}
+	rte_spinlock_init(&cls->lock);
+
+	sz = rte_rcu_qsbr_get_memsize(RTE_MAX_LCORE);
+	cls->qsbr = rte_zmalloc_socket("ffpp_cls_qsbr", sz, RTE_CACHE_LINE_SIZE,
+				       cfg->socket_id);
+	if (cls->qsbr == NULL || rte_rcu_qsbr_init(cls->qsbr, RTE_MAX_LCORE)) {
+		goto fail;
+	}
+
+	if (cfg->max_exact_rules > 0) {
+		struct rte_hash_parameters params = {
+			.name = name,
+			.entries = cfg->max_exact_rules,
+			.key_len = sizeof(struct ffpp_cls_5tuple),
+			.hash_func = rte_hash_crc,
+			.hash_func_init_val = 0,
+			.socket_id = cfg->socket_id,
+			// Lock-free lookups concurrent to the writer.
+			.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF |
+				      RTE_HASH_EXTRA_FLAGS_EXT_TABLE,
+		};
+		struct rte_hash_rcu_config rcu_cfg = {
+			.v = cls->qsbr,
+			.mode = RTE_HASH_QSBR_MODE_DQ,
+		};
+
+		snprintf(name, sizeof(name), "%s_em", cfg->name);
+		cls->exact = rte_hash_create(&params);
+		if (cls->exact == NULL ||
+		    rte_hash_rcu_qsbr_add(cls->exact, &rcu_cfg) != 0) {
+			RTE_LOG(ERR, FFPP,
+				"Can not create the hash table %s.\n", name);
+			goto fail;
+		}
+	}
+
+	if (cfg->max_lpm_rules > 0) {
+		struct rte_lpm_config lpm_cfg = {
+			.max_rules = cfg->max_lpm_rules,
+			.number_tbl8s = cls->cfg.lpm_tbl8s,
+			.flags = 0,
+		};
+		struct rte_lpm_rcu_config rcu_cfg = {
+			.v = cls->qsbr,
+			.mode = RTE_LPM_QSBR_MODE_DQ,
+		};
+
+		snprintf(name, sizeof(name), "%s_lpm", cfg->name);
+		cls->lpm = rte_lpm_create(name, cfg->socket_id, &lpm_cfg);
+		if (cls->lpm == NULL ||
+		    rte_lpm_rcu_qsbr_add(cls->lpm, &rcu_cfg) != 0) {
+			RTE_LOG(ERR, FFPP, "Can not create the LPM table %s.\n",
+				name);
+			goto fail;
+		}
+	}
+
+	if (cfg->max_lpm6_rules > 0) {
+		struct rte_lpm6_config lpm6_cfg = {
+			.max_rules = cfg->max_lpm6_rules,
+			.number_tbl8s = cls->cfg.lpm6_tbl8s,
+			.flags = 0,
+		};
+
+		for (i = 0; i < 2; ++i) {
+			snprintf(name, sizeof(name), "%s_lpm6_%d", cfg->name,
+				 i);
+			cls->lpm6[i] = rte_lpm6_create(name, cfg->socket_id,
+						       &lpm6_cfg);
+			if (cls->lpm6[i] == NULL) {
+				RTE_LOG(ERR, FFPP,
+					"Can not create the LPM6 table %s.\n",
+					name);
+				goto fail;
+			}
+		}
+	}
+
+	return cls;
+
+fail:
+	ffpp_cls_free(cls);
+	rte_errno = ENOMEM;
+	return NULL;
+}
+
+void ffpp_cls_free(struct ffpp_classifier *cls)
+{
+	if (cls == NULL) {
+		return;
+	}
+	rte_hash_free(cls->exact);
+	rte_lpm_free(cls->lpm);
+	rte_lpm6_free(cls->lpm6[0]);
+	rte_lpm6_free(cls->lpm6[1]);
+	rte_free(cls->qsbr);
+	rte_free(cls);
+}
+
+int ffpp_cls_add_exact(struct ffpp_classifier *cls,
+		       const struct ffpp_cls_5tuple *key, uint32_t action)
+{
+	struct ffpp_cls_5tuple k = *key;
+	int ret;
+
+	if (cls->exact == NULL) {
+		return -ENOTSUP;
+	}
+	if (action > FFPP_CLS_ACTION_MAX) {
+		return -EINVAL;
+	}
+	memset(k.pad, 0, sizeof(k.pad));
+	rte_spinlock_lock(&cls->lock);
+	ret = rte_hash_add_key_data(cls->exact, &k,
+				    (void *)(uintptr_t)action);
+	rte_spinlock_unlock(&cls->lock);
+	return ret;
+}
+
+int ffpp_cls_del_exact(struct ffpp_classifier *cls,
+		       const struct ffpp_cls_5tuple *key)
+{
+	struct ffpp_cls_5tuple k = *key;
+	int ret;
+
+	if (cls->exact == NULL) {
+		return -ENOTSUP;
+	}
+	memset(k.pad, 0, sizeof(k.pad));
+	rte_spinlock_lock(&cls->lock);
+	// The key slot is reclaimed after a grace period.
+	ret = rte_hash_del_key(cls->exact, &k);
+	rte_spinlock_unlock(&cls->lock);
+	return ret < 0 ? ret : 0;
+}
+
+int ffpp_cls_add_lpm(struct ffpp_classifier *cls, uint32_t ip, uint8_t depth,
+		     uint32_t action)
+{
+	int ret;
+
+	if (cls->lpm == NULL) {
+		return -ENOTSUP;
+	}
+	if (action > FFPP_CLS_ACTION_MAX) {
+		return -EINVAL;
+	}
+	rte_spinlock_lock(&cls->lock);
+	ret = rte_lpm_add(cls->lpm, ip, depth, action);
+	rte_spinlock_unlock(&cls->lock);
+	return ret;
+}
+
+int ffpp_cls_del_lpm(struct ffpp_classifier *cls, uint32_t ip, uint8_t depth)
+{
+	int ret;
+
+	if (cls->lpm == NULL) {
+		return -ENOTSUP;
+	}
+	rte_spinlock_lock(&cls->lock);
+	ret = rte_lpm_delete(cls->lpm, ip, depth);
+	rte_spinlock_unlock(&cls->lock);
+	return ret;
+}
+
+/**
+ * rte_lpm6 has no RCU support, a deletion recycles tbl8 groups readers might
+ * still use. So the update is applied to the standby copy, which becomes
+ * active, and to the other copy after the grace period.
+ */
+static int lpm6_update(struct ffpp_classifier *cls, const uint8_t *ip,
+		       uint8_t depth, uint32_t action, bool add)
+{
+	uint32_t active;
+	int ret, i;
+
+	if (cls->lpm6[0] == NULL) {
+		return -ENOTSUP;
+	}
+	if (action > FFPP_CLS_ACTION_MAX) {
+		return -EINVAL;
+	}
+
+	rte_spinlock_lock(&cls->lock);
+	active = cls->lpm6_active;
+	for (i = 0; i < 2; ++i) {
+		struct rte_lpm6 *lpm6 = cls->lpm6[i == 0 ? !active : active];
+
+		ret = add ? rte_lpm6_add(lpm6, ip, depth, action) :
+				  rte_lpm6_delete(lpm6, ip, depth);
+		if (ret < 0) {
+			if (i == 1) {
+				RTE_LOG(ERR, FFPP,
+					"The LPM6 copies of %s differ.\n",
+					cls->cfg.name);
+			}
+			break;
+		}
+		if (i == 0) {
+			__atomic_store_n(&cls->lpm6_active, !active,
+					 __ATOMIC_RELEASE);
+			rte_rcu_qsbr_synchronize(cls->qsbr,
+						 RTE_QSBR_THRID_INVALID);
+		}
+	}
+	rte_spinlock_unlock(&cls->lock);
+	return ret;
+}
+
+int ffpp_cls_add_lpm6(struct ffpp_classifier *cls,
+		      const uint8_t ip[RTE_LPM6_IPV6_ADDR_SIZE], uint8_t depth,
+		      uint32_t action)
+{
+	return lpm6_update(cls, ip, depth, action, true);
+}
+
+int ffpp_cls_del_lpm6(struct ffpp_classifier *cls,
+		      const uint8_t ip[RTE_LPM6_IPV6_ADDR_SIZE], uint8_t depth)
+{
+	return lpm6_update(cls, ip, depth, 0, false);
+}
+
+int ffpp_cls_reader_register(struct ffpp_classifier *cls,
+			     unsigned int lcore_id)
+{
+	if (rte_rcu_qsbr_thread_register(cls->qsbr, lcore_id) != 0) {
+		return -1;
+	}
+	rte_rcu_qsbr_thread_online(cls->qsbr, lcore_id);
+	return 0;
+}
+
+void ffpp_cls_reader_unregister(struct ffpp_classifier *cls,
+				unsigned int lcore_id)
+{
+	rte_rcu_qsbr_thread_offline(cls->qsbr, lcore_id);
+	rte_rcu_qsbr_thread_unregister(cls->qsbr, lcore_id);
+}
+
+void ffpp_cls_quiescent(struct ffpp_classifier *cls, unsigned int lcore_id)
+{
+	rte_rcu_qsbr_quiescent(cls->qsbr, lcore_id);
+}
+
+/**
+ * Return the IPv4 or IPv6 header after at most one VLAN tag, its EtherType
+ * in network byte order and the bytes from the header to the end of the first
+ * segment. NULL for other packets or if the fixed header is truncated.
+ */
+static __rte_always_inline const void *
+l3_hdr(const struct rte_mbuf *m, uint16_t *ether_type, uint16_t *avail)
+{
+	const struct rte_ether_hdr *eth;
+	uint16_t len = rte_pktmbuf_data_len(m);
+	uint16_t off = RTE_ETHER_HDR_LEN;
+	uint16_t type;
+
+	if (unlikely(len < RTE_ETHER_HDR_LEN)) {
+		return NULL;
+	}
+	eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+	type = eth->ether_type;
+	if (type == RTE_BE16(RTE_ETHER_TYPE_VLAN)) {
+		if (len < off + sizeof(struct rte_vlan_hdr)) {
+			return NULL;
+		}
+		type = ((const struct rte_vlan_hdr *)(eth + 1))->eth_proto;
+		off += sizeof(struct rte_vlan_hdr);
+	}
+	if ((type == RTE_BE16(RTE_ETHER_TYPE_IPV4) &&
+	     len >= off + sizeof(struct rte_ipv4_hdr)) ||
+	    (type == RTE_BE16(RTE_ETHER_TYPE_IPV6) &&
+	     len >= off + sizeof(struct rte_ipv6_hdr))) {
+		*ether_type = type;
+		*avail = len - off;
+		return rte_pktmbuf_mtod_offset(m, const void *, off);
+	}
+	return NULL;
+}
+
+static __rte_always_inline void fill_5tuple(const struct rte_ipv4_hdr *ip,
+					    uint16_t avail,
+					    struct ffpp_cls_5tuple *key)
+{
+	uint16_t ihl = (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) *
+		       RTE_IPV4_IHL_MULTIPLIER;
+	const uint16_t *ports;
+
+	memset(key, 0, sizeof(*key));
+	key->src_addr = ip->src_addr;
+	key->dst_addr = ip->dst_addr;
+	key->proto = ip->next_proto_id;
+	if ((key->proto == IPPROTO_TCP || key->proto == IPPROTO_UDP ||
+	     key->proto == IPPROTO_SCTP) &&
+	    (ip->fragment_offset & RTE_BE16(RTE_IPV4_HDR_OFFSET_MASK)) == 0 &&
+	    avail >= ihl + 2 * sizeof(uint16_t)) {
+		ports = (const uint16_t *)((const uint8_t *)ip + ihl);
+		key->src_port = ports[0];
+		key->dst_port = ports[1];
+	}
+}
+
+int ffpp_cls_5tuple_of(const struct rte_mbuf *m, struct ffpp_cls_5tuple *key)
+{
+	const void *l3;
+	uint16_t type, avail;
+
+	l3 = l3_hdr(m, &type, &avail);
+	if (l3 == NULL || type != RTE_BE16(RTE_ETHER_TYPE_IPV4)) {
+		return -1;
+	}
+	fill_5tuple(l3, avail, key);
+	return 0;
+}
+
+static uint16_t lookup_bulk(const struct ffpp_classifier *cls,
+			    struct rte_mbuf **pkts, uint16_t n,
+			    uint32_t *actions)
+{
+	struct ffpp_cls_5tuple keys[CLS_BULK];
+	const void *key_ptrs[CLS_BULK];
+	void *data[CLS_BULK];
+	uint32_t dst4[CLS_BULK];
+	uint32_t hops4[CLS_BULK];
+	uint8_t dst6[CLS_BULK][RTE_LPM6_IPV6_ADDR_SIZE];
+	int32_t hops6[CLS_BULK];
+	uint16_t v4_idx[CLS_BULK];
+	uint16_t v6_idx[CLS_BULK];
+	uint16_t miss_idx[CLS_BULK];
+	uint16_t nb_v4 = 0, nb_v6 = 0, nb_miss = 0, nb_match = 0;
+	uint64_t hit_mask = 0;
+	const struct rte_lpm6 *lpm6;
+	const void *l3;
+	uint16_t type, avail;
+	uint16_t i;
+
+	for (i = 0; i < PREFETCH_OFFSET && i < n; ++i) {
+		rte_prefetch0(rte_pktmbuf_mtod(pkts[i], void *));
+	}
+	for (i = 0; i < n; ++i) {
+		if (i + PREFETCH_OFFSET < n) {
+			rte_prefetch0(rte_pktmbuf_mtod(
+				pkts[i + PREFETCH_OFFSET], void *));
+		}
+		actions[i] = cls->cfg.default_action;
+		l3 = l3_hdr(pkts[i], &type, &avail);
+		if (l3 == NULL) {
+			continue;
+		}
+		if (type == RTE_BE16(RTE_ETHER_TYPE_IPV4)) {
+			fill_5tuple(l3, avail, &keys[nb_v4]);
+			key_ptrs[nb_v4] = &keys[nb_v4];
+			v4_idx[nb_v4++] = i;
+		} else {
+			memcpy(dst6[nb_v6],
+			       ((const struct rte_ipv6_hdr *)l3)->dst_addr,
+			       RTE_LPM6_IPV6_ADDR_SIZE);
+			v6_idx[nb_v6++] = i;
+		}
+	}
+
+	if (nb_v4 > 0 && cls->exact != NULL) {
+		rte_hash_lookup_bulk_data(cls->exact, key_ptrs, nb_v4,
+					  &hit_mask, data);
+	}
+	for (i = 0; i < nb_v4; ++i) {
+		if (hit_mask & (1ULL << i)) {
+			actions[v4_idx[i]] = (uint32_t)(uintptr_t)data[i];
+			nb_match++;
+		} else {
+			dst4[nb_miss] = rte_be_to_cpu_32(keys[i].dst_addr);
+			miss_idx[nb_miss++] = v4_idx[i];
+		}
+	}
+
+	if (nb_miss > 0 && cls->lpm != NULL) {
+		rte_lpm_lookup_bulk(cls->lpm, dst4, hops4, nb_miss);
+		for (i = 0; i < nb_miss; ++i) {
+			if (hops4[i] & RTE_LPM_LOOKUP_SUCCESS) {
+				actions[miss_idx[i]] =
+					hops4[i] & LPM_NEXT_HOP_MASK;
+				nb_match++;
+			}
+		}
+	}
+
+	if (nb_v6 > 0 && cls->lpm6[0] != NULL) {
+		lpm6 = cls->lpm6[__atomic_load_n(&cls->lpm6_active,
+						 __ATOMIC_ACQUIRE)];
+		rte_lpm6_lookup_bulk_func(lpm6, dst6, hops6, nb_v6);
+		for (i = 0; i < nb_v6; ++i) {
+			if (hops6[i] >= 0) {
+				actions[v6_idx[i]] = (uint32_t)hops6[i];
+				nb_match++;
+			}
+		}
+	}
+
+	return nb_match;
+}
+
+uint16_t ffpp_cls_lookup(const struct ffpp_classifier *cls,
+			 const struct ffpp_mvec *vec, uint32_t *actions)
+{
+	uint16_t nb_match = 0;
+	uint16_t i;
+
+	for (i = 0; i < vec->len; i += CLS_BULK) {
+		nb_match += lookup_bulk(cls, vec->head + i,
+					RTE_MIN(CLS_BULK, vec->len - i),
+					actions + i);
+	}
+	return nb_match;
+}
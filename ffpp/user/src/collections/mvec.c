@@ -66,7 +66,7 @@ void ffpp_mvec_free_mbufs_part(struct ffpp_mvec *vec, uint16_t offset)
 	for (i = offset; i < vec->len; ++i) {
 		rte_pktmbuf_free(*(vec->head + i));
 	}
-	rte_free(vec);
+	vec->len = RTE_MIN(vec->len, offset);
 }
 
 void ffpp_mvec_free_mbufs(struct ffpp_mvec *vec)
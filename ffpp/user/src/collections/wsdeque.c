@@ -0,0 +1,36 @@
+/*
+ * wsdeque.c
+ */
+
+#include <errno.h>
+
+#include <rte_common.h>
+#include <rte_errno.h>
+#include <rte_malloc.h>
+
+#include <ffpp/wsdeque.h>
+
+struct ffpp_wsdeque *ffpp_wsdeque_create(uint32_t size, int socket_id)
+{
+	struct ffpp_wsdeque *dq;
+
+	if (size == 0 || !rte_is_power_of_2(size)) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+	dq = rte_zmalloc_socket("ffpp_wsdeque",
+				sizeof(*dq) + sizeof(void *) * size,
+				RTE_CACHE_LINE_SIZE, socket_id);
+	if (dq == NULL) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	dq->size = size;
+	dq->mask = size - 1;
+	return dq;
+}
+
+void ffpp_wsdeque_free(struct ffpp_wsdeque *dq)
+{
+	rte_free(dq);
+}
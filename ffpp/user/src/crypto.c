@@ -0,0 +1,534 @@
+/*
+ * crypto.c
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_byteorder.h>
+#include <rte_common.h>
+#include <rte_errno.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_rcu_qsbr.h>
+
+#include <ffpp/crypto.h>
+#include <ffpp/flow_table.h>
+
+/* State of a flow, kept in the flow table and zeroed for new flows. */
+struct flow_crypto {
+	uint32_t session;
+	uint32_t gen; /**< Generation of the session ID */
+	uint8_t configured;
+};
+
+struct crypto_part {
+	// max_sessions + 1 entries, the ID is the index.
+	struct ffpp_crypto_session *sessions;
+	struct ffpp_crypto_stats stats;
+} __rte_cache_aligned;
+
+struct ffpp_crypto {
+	struct ffpp_crypto_config cfg;
+	struct ffpp_flow_table *flows;
+	struct crypto_part *parts;
+	uint8_t *used; /**< Session IDs in use, only for the control plane */
+	uint32_t *gens; /**< Last generation of each session ID */
+	struct rte_rcu_qsbr *qsbr; /**< The partitions read the sessions */
+	uint32_t default_session;
+};
+
+struct ffpp_crypto *ffpp_crypto_create(const struct ffpp_crypto_config *cfg)
+{
+	struct ffpp_flow_table_config flow_cfg;
+	struct ffpp_crypto *c;
+	size_t sz;
+	uint16_t i;
+
+	if (cfg->name[0] == '\0' ||
+	    strnlen(cfg->name, FFPP_CRYPTO_NAME_MAX_LEN) ==
+		    FFPP_CRYPTO_NAME_MAX_LEN ||
+	    cfg->nb_parts == 0 || cfg->max_sessions == 0 ||
+	    cfg->max_sessions == UINT32_MAX) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+
+	c = rte_zmalloc_socket("ffpp_crypto", sizeof(*c), RTE_CACHE_LINE_SIZE,
+			       cfg->socket_id);
+	if (c == NULL) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	c->cfg = *cfg;
+
+	memset(&flow_cfg, 0, sizeof(flow_cfg));
+	snprintf(flow_cfg.name, sizeof(flow_cfg.name), "%s_ft", cfg->name);
+	flow_cfg.socket_id = cfg->socket_id;
+	flow_cfg.nb_parts = cfg->nb_parts;
+	flow_cfg.max_flows = cfg->max_flows;
+	flow_cfg.data_size = sizeof(struct flow_crypto);
+	flow_cfg.timeout_us = cfg->timeout_us;
+	c->flows = ffpp_flow_table_create(&flow_cfg);
+	if (c->flows == NULL) {
+		// rte_errno is set by the flow table.
+		ffpp_crypto_free(c);
+		return NULL;
+	}
+
+	c->used = rte_zmalloc_socket("ffpp_crypto_used", cfg->max_sessions + 1,
+				     0, cfg->socket_id);
+	c->gens = rte_zmalloc_socket("ffpp_crypto_gens",
+				     (cfg->max_sessions + 1) * sizeof(*c->gens),
+				     0, cfg->socket_id);
+	c->parts = rte_zmalloc_socket("ffpp_crypto_parts",
+				      cfg->nb_parts * sizeof(*c->parts),
+				      RTE_CACHE_LINE_SIZE, cfg->socket_id);
+	sz = rte_rcu_qsbr_get_memsize(cfg->nb_parts);
+	c->qsbr = rte_zmalloc_socket("ffpp_crypto_qsbr", sz, RTE_CACHE_LINE_SIZE,
+				     cfg->socket_id);
+	if (c->used == NULL || c->gens == NULL || c->parts == NULL ||
+	    c->qsbr == NULL || rte_rcu_qsbr_init(c->qsbr, cfg->nb_parts) != 0) {
+		goto fail;
+	}
+	for (i = 0; i < cfg->nb_parts; ++i) {
+		c->parts[i].sessions = rte_zmalloc_socket(
+			"ffpp_crypto_sessions",
+			((size_t)cfg->max_sessions + 1) *
+				sizeof(struct ffpp_crypto_session),
+			RTE_CACHE_LINE_SIZE, cfg->socket_id);
+		if (c->parts[i].sessions == NULL) {
+			goto fail;
+		}
+	}
+	return c;
+
+fail:
+	ffpp_crypto_free(c);
+	rte_errno = ENOMEM;
+	return NULL;
+}
+
+void ffpp_crypto_free(struct ffpp_crypto *c)
+{
+	uint16_t i;
+
+	if (c == NULL) {
+		return;
+	}
+	if (c->parts != NULL) {
+		for (i = 0; i < c->cfg.nb_parts; ++i) {
+			if (c->parts[i].sessions == NULL) {
+				continue;
+			}
+			explicit_bzero(c->parts[i].sessions,
+				       ((size_t)c->cfg.max_sessions + 1) *
+					       sizeof(*c->parts[i].sessions));
+			rte_free(c->parts[i].sessions);
+		}
+		rte_free(c->parts);
+	}
+	rte_free(c->used);
+	rte_free(c->gens);
+	rte_free(c->qsbr);
+	ffpp_flow_table_free(c->flows);
+	rte_free(c);
+}
+
+int ffpp_crypto_session_create(struct ffpp_crypto *c,
+			       const struct ffpp_crypto_session_params *params)
+{
+	struct ffpp_crypto_session tmpl;
+	struct ffpp_crypto_session *s;
+	uint32_t id;
+	uint16_t i;
+
+	if (params->algo != FFPP_CRYPTO_AES_CBC &&
+	    params->algo != FFPP_CRYPTO_AES_CTR) {
+		return -EINVAL;
+	}
+	for (id = 1; id <= c->cfg.max_sessions; ++id) {
+		if (!c->used[id]) {
+			break;
+		}
+	}
+	if (id > c->cfg.max_sessions) {
+		return -ENOSPC;
+	}
+
+	// The only key expansion of the session.
+	memset(&tmpl, 0, sizeof(tmpl));
+	AES_init_ctx(&tmpl.ctx, params->key);
+	memcpy(tmpl.salt, params->salt, AES_BLOCKLEN);
+	tmpl.algo = params->algo;
+	tmpl.gen = ++c->gens[id];
+	for (i = 0; i < c->cfg.nb_parts; ++i) {
+		s = &c->parts[i].sessions[id];
+		*s = tmpl;
+		s->seq = (uint64_t)i << FFPP_CRYPTO_SEQ_PART_SHIFT;
+		s->seq_end = s->seq + (1ULL << FFPP_CRYPTO_SEQ_PART_SHIFT) - 1;
+		// Publish the session after its keys are written.
+		__atomic_store_n(&s->active, true, __ATOMIC_RELEASE);
+	}
+	explicit_bzero(&tmpl, sizeof(tmpl));
+	c->used[id] = 1;
+	return id;
+}
+
+int ffpp_crypto_session_destroy(struct ffpp_crypto *c, uint32_t id)
+{
+	struct ffpp_crypto_session *s;
+	uint16_t i;
+
+	if (id == FFPP_CRYPTO_SESSION_NONE || id > c->cfg.max_sessions ||
+	    !c->used[id]) {
+		return -ENOENT;
+	}
+	if (__atomic_load_n(&c->default_session, __ATOMIC_RELAXED) == id) {
+		__atomic_store_n(&c->default_session, FFPP_CRYPTO_SESSION_NONE,
+				 __ATOMIC_RELAXED);
+	}
+	for (i = 0; i < c->cfg.nb_parts; ++i) {
+		__atomic_store_n(&c->parts[i].sessions[id].active, false,
+				 __ATOMIC_RELEASE);
+	}
+	// The partitions may still use the keys until their next quiescent
+	// state. The ID is free afterwards.
+	rte_rcu_qsbr_synchronize(c->qsbr, RTE_QSBR_THRID_INVALID);
+	for (i = 0; i < c->cfg.nb_parts; ++i) {
+		s = &c->parts[i].sessions[id];
+		explicit_bzero(s, sizeof(*s));
+	}
+	c->used[id] = 0;
+	return 0;
+}
+
+int ffpp_crypto_reader_register(struct ffpp_crypto *c, uint16_t part)
+{
+	if (part >= c->cfg.nb_parts ||
+	    rte_rcu_qsbr_thread_register(c->qsbr, part) != 0) {
+		return -EINVAL;
+	}
+	rte_rcu_qsbr_thread_online(c->qsbr, part);
+	return 0;
+}
+
+void ffpp_crypto_reader_unregister(struct ffpp_crypto *c, uint16_t part)
+{
+	rte_rcu_qsbr_thread_offline(c->qsbr, part);
+	rte_rcu_qsbr_thread_unregister(c->qsbr, part);
+}
+
+void ffpp_crypto_quiescent(struct ffpp_crypto *c, uint16_t part)
+{
+	rte_rcu_qsbr_quiescent(c->qsbr, part);
+}
+
+static __rte_always_inline struct ffpp_crypto_session *
+session_of(struct crypto_part *p, uint32_t max_sessions, uint32_t id)
+{
+	struct ffpp_crypto_session *s;
+
+	if (id == FFPP_CRYPTO_SESSION_NONE || id > max_sessions) {
+		return NULL;
+	}
+	s = &p->sessions[id];
+	return __atomic_load_n(&s->active, __ATOMIC_ACQUIRE) ? s : NULL;
+}
+
+/*
+ * The session of a flow. A flow of a destroyed session is invalidated, even if
+ * its ID was reused by a newer session.
+ */
+static __rte_always_inline struct ffpp_crypto_session *
+flow_session(struct crypto_part *p, uint32_t max_sessions,
+	     struct flow_crypto *f)
+{
+	struct ffpp_crypto_session *s;
+
+	s = session_of(p, max_sessions, f->session);
+	if (likely(s != NULL && s->gen == f->gen)) {
+		return s;
+	}
+	f->session = FFPP_CRYPTO_SESSION_NONE;
+	return NULL;
+}
+
+struct ffpp_crypto_session *ffpp_crypto_session_get(struct ffpp_crypto *c,
+						    uint16_t part, uint32_t id)
+{
+	return session_of(&c->parts[part], c->cfg.max_sessions, id);
+}
+
+int ffpp_crypto_set_default_session(struct ffpp_crypto *c, uint32_t id)
+{
+	if (id != FFPP_CRYPTO_SESSION_NONE &&
+	    (id > c->cfg.max_sessions || !c->used[id])) {
+		return -ENOENT;
+	}
+	__atomic_store_n(&c->default_session, id, __ATOMIC_RELAXED);
+	return 0;
+}
+
+int ffpp_crypto_set_flow_session(struct ffpp_crypto *c, uint16_t part,
+				 const struct ffpp_cls_5tuple *key,
+				 uint32_t id)
+{
+	struct ffpp_crypto_session *s;
+	struct flow_crypto *f;
+	void *data;
+
+	s = session_of(&c->parts[part], c->cfg.max_sessions, id);
+	if (s == NULL) {
+		return -ENOENT;
+	}
+	if (ffpp_flow_insert_bulk(c->flows, part, key, 1, &data) == 0) {
+		return -ENOSPC;
+	}
+	f = data;
+	f->session = id;
+	f->gen = s->gen;
+	f->configured = 1;
+	return 0;
+}
+
+void ffpp_crypto_session_iv(const struct ffpp_crypto_session *s, uint64_t seq,
+			    uint8_t *iv)
+{
+	uint64_t hi;
+
+	memcpy(&hi, s->salt, sizeof(hi));
+	hi ^= rte_cpu_to_be_64(seq);
+	memcpy(iv, &hi, sizeof(hi));
+	memcpy(iv + sizeof(hi), s->salt + sizeof(hi),
+	       AES_BLOCKLEN - sizeof(hi));
+	if (s->algo == FFPP_CRYPTO_AES_CTR) {
+		// A packet never carries into the bits of the sequence number.
+		memset(iv + AES_BLOCKLEN - sizeof(uint32_t), 0,
+		       sizeof(uint32_t));
+	} else {
+		AES_ECB_encrypt(&s->ctx, iv);
+	}
+}
+
+static __rte_always_inline void xcrypt(struct ffpp_crypto_session *s,
+				       enum ffpp_crypto_dir dir, uint8_t *buf,
+				       uint32_t len, uint64_t seq)
+{
+	ffpp_crypto_session_iv(s, seq, s->ctx.Iv);
+	if (s->algo == FFPP_CRYPTO_AES_CTR) {
+		AES_CTR_xcrypt_buffer(&s->ctx, buf, len);
+	} else if (dir == FFPP_CRYPTO_ENCRYPT) {
+		AES_CBC_encrypt_buffer(&s->ctx, buf,
+				       RTE_ALIGN_FLOOR(len, AES_BLOCKLEN));
+	} else {
+		AES_CBC_decrypt_buffer(&s->ctx, buf,
+				       RTE_ALIGN_FLOOR(len, AES_BLOCKLEN));
+	}
+}
+
+int ffpp_crypto_encrypt(struct ffpp_crypto_session *s, uint8_t *buf,
+			uint32_t len, uint64_t *seq)
+{
+	if (unlikely(s->seq == s->seq_end)) {
+		return -EOVERFLOW;
+	}
+	*seq = s->seq++;
+	xcrypt(s, FFPP_CRYPTO_ENCRYPT, buf, len, *seq);
+	return 0;
+}
+
+void ffpp_crypto_decrypt(struct ffpp_crypto_session *s, uint8_t *buf,
+			 uint32_t len, uint64_t seq)
+{
+	xcrypt(s, FFPP_CRYPTO_DECRYPT, buf, len, seq);
+}
+
+/* CBC encryptions of one session that are run by AES_CBC_encrypt_multi(). */
+struct cbc_batch {
+	struct ffpp_crypto_session *s;
+	uint16_t n;
+	uint8_t *bufs[FFPP_CRYPTO_BATCH_MAX];
+	uint32_t lengths[FFPP_CRYPTO_BATCH_MAX];
+	uint8_t ivs[FFPP_CRYPTO_BATCH_MAX][AES_BLOCKLEN];
+};
+
+static void cbc_batch_flush(struct cbc_batch *b)
+{
+	if (b->n > 0) {
+		AES_CBC_encrypt_multi(&b->s->ctx, b->bufs, b->lengths, b->ivs,
+				      b->n);
+		b->n = 0;
+	}
+}
+
+static __rte_always_inline void cbc_batch_add(struct cbc_batch *b,
+					      struct ffpp_crypto_session *s,
+					      uint8_t *buf, uint32_t len,
+					      uint64_t seq)
+{
+	if (b->s != s || b->n == FFPP_CRYPTO_BATCH_MAX) {
+		cbc_batch_flush(b);
+		b->s = s;
+	}
+	ffpp_crypto_session_iv(s, seq, b->ivs[b->n]);
+	b->bufs[b->n] = buf;
+	b->lengths[b->n] = RTE_ALIGN_FLOOR(len, AES_BLOCKLEN);
+	b->n++;
+}
+
+/* Encrypt a packet, CBC encryptions are deferred to the batch. */
+static __rte_always_inline int encrypt_pkt(struct ffpp_crypto_session *s,
+					   struct cbc_batch *b, uint8_t *buf,
+					   uint32_t len, uint64_t *seq)
+{
+	if (unlikely(s->seq == s->seq_end)) {
+		return -EOVERFLOW;
+	}
+	*seq = s->seq++;
+	if (s->algo == FFPP_CRYPTO_AES_CBC) {
+		cbc_batch_add(b, s, buf, len, *seq);
+	} else {
+		xcrypt(s, FFPP_CRYPTO_ENCRYPT, buf, len, *seq);
+	}
+	return 0;
+}
+
+uint16_t ffpp_crypto_encrypt_mvec(struct ffpp_crypto_session *s,
+				  struct ffpp_mvec *vec, uint16_t offset,
+				  uint64_t *seqs)
+{
+	struct cbc_batch batch;
+	uint16_t nb_done = 0;
+	struct rte_mbuf *m;
+	uint16_t i;
+
+	batch.s = s;
+	batch.n = 0;
+	FFPP_MVEC_FOREACH(vec, i, m)
+	{
+		if (rte_pktmbuf_data_len(m) <= offset ||
+		    encrypt_pkt(s, &batch,
+				rte_pktmbuf_mtod_offset(m, uint8_t *, offset),
+				rte_pktmbuf_data_len(m) - offset,
+				&seqs[i]) != 0) {
+			seqs[i] = FFPP_CRYPTO_SEQ_NONE;
+			continue;
+		}
+		nb_done++;
+	}
+	cbc_batch_flush(&batch);
+	return nb_done;
+}
+
+/**
+ * Look up the flows of n packets, new flows are inserted and get the default
+ * session. flows[i] is NULL for untracked packets.
+ */
+static void lookup_flows(struct ffpp_crypto *c, uint16_t part,
+			 struct rte_mbuf **pkts, uint16_t n,
+			 struct flow_crypto **flows)
+{
+	struct ffpp_cls_5tuple keys[FFPP_FLOW_BULK_MAX];
+	void *found[FFPP_FLOW_BULK_MAX];
+	uint16_t pos[FFPP_FLOW_BULK_MAX];
+	struct ffpp_crypto_session *s;
+	struct flow_crypto *f;
+	uint16_t i, nb_keys = 0;
+
+	for (i = 0; i < n; ++i) {
+		flows[i] = NULL;
+		if (ffpp_cls_5tuple_of(pkts[i], &keys[nb_keys]) == 0) {
+			pos[nb_keys++] = i;
+		}
+	}
+	ffpp_flow_insert_bulk(c->flows, part, keys, nb_keys, found);
+	for (i = 0; i < nb_keys; ++i) {
+		f = found[i];
+		if (f != NULL && unlikely(!f->configured)) {
+			f->session = __atomic_load_n(&c->default_session,
+						     __ATOMIC_RELAXED);
+			s = session_of(&c->parts[part], c->cfg.max_sessions,
+				       f->session);
+			f->gen = s != NULL ? s->gen : 0;
+			f->configured = 1;
+		}
+		flows[pos[i]] = f;
+	}
+}
+
+uint16_t ffpp_crypto_process(struct ffpp_crypto *c, uint16_t part,
+			     struct ffpp_mvec *vec, enum ffpp_crypto_dir dir,
+			     uint64_t *seqs)
+{
+	struct crypto_part *p = &c->parts[part];
+	struct flow_crypto *flows[FFPP_FLOW_BULK_MAX];
+	uint16_t offset = c->cfg.offset;
+	struct ffpp_crypto_session *s;
+	struct cbc_batch batch;
+	uint16_t nb_done = 0;
+	uint16_t off, n, i;
+	struct rte_mbuf *m;
+	uint8_t *data;
+	uint32_t len;
+
+	batch.s = NULL;
+	batch.n = 0;
+	for (off = 0; off < vec->len; off += n) {
+		n = RTE_MIN(vec->len - off, FFPP_FLOW_BULK_MAX);
+		lookup_flows(c, part, vec->head + off, n, flows);
+		for (i = 0; i < n; ++i) {
+			m = vec->head[off + i];
+			if (dir == FFPP_CRYPTO_DECRYPT &&
+			    seqs[off + i] == FFPP_CRYPTO_SEQ_NONE) {
+				continue;
+			}
+			s = NULL;
+			if (flows[i] != NULL) {
+				s = flow_session(p, c->cfg.max_sessions,
+						 flows[i]);
+			}
+			if (s == NULL || rte_pktmbuf_data_len(m) <= offset) {
+				p->stats.untracked++;
+				seqs[off + i] = FFPP_CRYPTO_SEQ_NONE;
+				continue;
+			}
+			data = rte_pktmbuf_mtod_offset(m, uint8_t *, offset);
+			len = rte_pktmbuf_data_len(m) - offset;
+			if (dir == FFPP_CRYPTO_DECRYPT) {
+				ffpp_crypto_decrypt(s, data, len,
+						    seqs[off + i]);
+				p->stats.decrypted++;
+			} else if (encrypt_pkt(s, &batch, data, len,
+					       &seqs[off + i]) == 0) {
+				p->stats.encrypted++;
+			} else {
+				p->stats.seq_exhausted++;
+				seqs[off + i] = FFPP_CRYPTO_SEQ_NONE;
+				continue;
+			}
+			p->stats.bytes += len;
+			nb_done++;
+		}
+	}
+	cbc_batch_flush(&batch);
+	return nb_done;
+}
+
+uint32_t ffpp_crypto_age(struct ffpp_crypto *c, uint16_t part,
+			 uint32_t budget)
+{
+	return ffpp_flow_age(c->flows, part, budget);
+}
+
+void ffpp_crypto_get_stats(const struct ffpp_crypto *c, uint16_t part,
+			   struct ffpp_crypto_stats *stats)
+{
+	struct ffpp_flow_stats flow_stats;
+
+	*stats = c->parts[part].stats;
+	ffpp_flow_get_stats(c->flows, part, &flow_stats);
+	stats->nb_flows = flow_stats.nb_flows;
+}
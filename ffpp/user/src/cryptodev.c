@@ -0,0 +1,644 @@
+/*
+ * cryptodev.c
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+#include <rte_crypto.h>
+#include <rte_cryptodev.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_rcu_qsbr.h>
+
+#include <ffpp/cryptodev.h>
+
+#define OP_CACHE_SIZE 128
+/* The private data of an op follows its symmetric op. */
+#define OP_PRIV_OFFSET                                                         \
+	(sizeof(struct rte_crypto_op) + sizeof(struct rte_crypto_sym_op))
+
+struct op_priv {
+	uint8_t iv[AES_BLOCKLEN]; /**< Read by the device */
+	uint64_t seq;
+	uint32_t session;
+};
+
+struct cdev_session {
+	struct rte_cryptodev_sym_session *sess;
+	enum ffpp_crypto_dir dir;
+};
+
+struct cdev_qp {
+	// max_sessions + 1 entries, the IV state of the sessions, the ID is the
+	// index. Only the round keys of CBC are used, for the IVs.
+	struct ffpp_crypto_session *ivs;
+	// max_sessions + 1 entries, the inflight ops of each session. Written
+	// by the lcore of the queue pair, read by the control plane.
+	uint32_t *sess_inflight;
+	struct ffpp_cryptodev_stats stats;
+	unsigned int lcore_id; /**< RTE_MAX_LCORE if unassigned */
+} __rte_cache_aligned;
+
+struct ffpp_cryptodev {
+	struct ffpp_cryptodev_config cfg;
+	struct rte_mempool *op_pool;
+	struct rte_mempool *sess_pool;
+	struct rte_mempool *sess_priv_pool;
+	struct cdev_session *sessions; /**< max_sessions + 1 entries */
+	struct cdev_qp *qps;
+	struct rte_rcu_qsbr *qsbr; /**< The queue pairs read the sessions */
+	int lcore_qp[RTE_MAX_LCORE]; /**< -1 if unassigned */
+	bool started;
+};
+
+static int create_pools(struct ffpp_cryptodev *cd)
+{
+	const struct ffpp_cryptodev_config *cfg = &cd->cfg;
+	char name[RTE_MEMPOOL_NAMESIZE];
+
+	snprintf(name, sizeof(name), "%s_op", cfg->name);
+	cd->op_pool = rte_crypto_op_pool_create(
+		name, RTE_CRYPTO_OP_TYPE_SYMMETRIC, cfg->nb_ops, OP_CACHE_SIZE,
+		sizeof(struct op_priv), cfg->socket_id);
+	snprintf(name, sizeof(name), "%s_ss", cfg->name);
+	cd->sess_pool = rte_cryptodev_sym_session_pool_create(
+		name, cfg->max_sessions, 0, 0, 0, cfg->socket_id);
+	snprintf(name, sizeof(name), "%s_sp", cfg->name);
+	cd->sess_priv_pool = rte_mempool_create(
+		name, cfg->max_sessions,
+		rte_cryptodev_sym_get_private_session_size(cfg->dev_id), 0, 0,
+		NULL, NULL, NULL, NULL, cfg->socket_id, 0);
+	if (cd->op_pool == NULL || cd->sess_pool == NULL ||
+	    cd->sess_priv_pool == NULL) {
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static int start_dev(struct ffpp_cryptodev *cd)
+{
+	const struct ffpp_cryptodev_config *cfg = &cd->cfg;
+	struct rte_cryptodev_qp_conf qp_cfg;
+	struct rte_cryptodev_config dev_cfg;
+	uint16_t i;
+	int ret;
+
+	memset(&dev_cfg, 0, sizeof(dev_cfg));
+	dev_cfg.socket_id = cfg->socket_id;
+	dev_cfg.nb_queue_pairs = cfg->nb_qps;
+	dev_cfg.ff_disable =
+		RTE_CRYPTODEV_FF_ASYMMETRIC_CRYPTO | RTE_CRYPTODEV_FF_SECURITY;
+	ret = rte_cryptodev_configure(cfg->dev_id, &dev_cfg);
+	if (ret < 0) {
+		return ret;
+	}
+
+	memset(&qp_cfg, 0, sizeof(qp_cfg));
+	qp_cfg.nb_descriptors = cfg->qp_size;
+	qp_cfg.mp_session = cd->sess_pool;
+	qp_cfg.mp_session_private = cd->sess_priv_pool;
+	for (i = 0; i < cfg->nb_qps; ++i) {
+		ret = rte_cryptodev_queue_pair_setup(cfg->dev_id, i, &qp_cfg,
+						     cfg->socket_id);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+
+	ret = rte_cryptodev_start(cfg->dev_id);
+	if (ret < 0) {
+		return ret;
+	}
+	cd->started = true;
+	return 0;
+}
+
+struct ffpp_cryptodev *
+ffpp_cryptodev_create(const struct ffpp_cryptodev_config *cfg)
+{
+	struct rte_cryptodev_info info;
+	struct ffpp_cryptodev *cd;
+	unsigned int lcore_id;
+	size_t sz;
+	uint16_t i;
+	int ret;
+
+	if (cfg->name[0] == '\0' ||
+	    strnlen(cfg->name, FFPP_CRYPTODEV_NAME_MAX_LEN) ==
+		    FFPP_CRYPTODEV_NAME_MAX_LEN ||
+	    cfg->max_sessions == 0 || cfg->max_sessions == UINT32_MAX ||
+	    !rte_cryptodev_is_valid_dev(cfg->dev_id)) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+	rte_cryptodev_info_get(cfg->dev_id, &info);
+	if ((info.feature_flags & RTE_CRYPTODEV_FF_SYMMETRIC_CRYPTO) == 0) {
+		rte_errno = ENOTSUP;
+		return NULL;
+	}
+
+	cd = rte_zmalloc_socket("ffpp_cryptodev", sizeof(*cd),
+				RTE_CACHE_LINE_SIZE, cfg->socket_id);
+	if (cd == NULL) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	cd->cfg = *cfg;
+	if (cd->cfg.nb_qps == 0) {
+		cd->cfg.nb_qps = RTE_MAX(rte_lcore_count() - 1, 1U);
+	}
+	if (cd->cfg.qp_size == 0) {
+		cd->cfg.qp_size = FFPP_CRYPTODEV_QP_SIZE_DEFAULT;
+	}
+	if (cd->cfg.nb_ops == 0) {
+		// The inflight ops and one burst per queue pair being built.
+		cd->cfg.nb_ops = cd->cfg.nb_qps * (cd->cfg.qp_size +
+						   FFPP_CRYPTODEV_BURST_MAX +
+						   OP_CACHE_SIZE);
+	}
+	for (i = 0; i < RTE_MAX_LCORE; ++i) {
+		cd->lcore_qp[i] = -1;
+	}
+	if (cd->cfg.nb_qps > info.max_nb_queue_pairs) {
+		ret = -EINVAL;
+		goto fail;
+	}
+
+	ret = create_pools(cd);
+	if (ret < 0) {
+		goto fail;
+	}
+	cd->sessions = rte_zmalloc_socket(
+		"ffpp_cryptodev_sessions",
+		((size_t)cfg->max_sessions + 1) * sizeof(*cd->sessions), 0,
+		cfg->socket_id);
+	cd->qps = rte_zmalloc_socket("ffpp_cryptodev_qps",
+				     cd->cfg.nb_qps * sizeof(*cd->qps),
+				     RTE_CACHE_LINE_SIZE, cfg->socket_id);
+	sz = rte_rcu_qsbr_get_memsize(cd->cfg.nb_qps);
+	cd->qsbr = rte_zmalloc_socket("ffpp_cryptodev_qsbr", sz,
+				      RTE_CACHE_LINE_SIZE, cfg->socket_id);
+	if (cd->sessions == NULL || cd->qps == NULL || cd->qsbr == NULL ||
+	    rte_rcu_qsbr_init(cd->qsbr, cd->cfg.nb_qps) != 0) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+	for (i = 0; i < cd->cfg.nb_qps; ++i) {
+		cd->qps[i].lcore_id = RTE_MAX_LCORE;
+		cd->qps[i].ivs = rte_zmalloc_socket(
+			"ffpp_cryptodev_ivs",
+			((size_t)cfg->max_sessions + 1) *
+				sizeof(*cd->qps[i].ivs),
+			RTE_CACHE_LINE_SIZE, cfg->socket_id);
+		cd->qps[i].sess_inflight = rte_zmalloc_socket(
+			"ffpp_cryptodev_inflight",
+			((size_t)cfg->max_sessions + 1) *
+				sizeof(*cd->qps[i].sess_inflight),
+			0, cfg->socket_id);
+		if (cd->qps[i].ivs == NULL ||
+		    cd->qps[i].sess_inflight == NULL) {
+			ret = -ENOMEM;
+			goto fail;
+		}
+	}
+
+	ret = start_dev(cd);
+	if (ret < 0) {
+		goto fail;
+	}
+
+	i = 0;
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		if (i == cd->cfg.nb_qps) {
+			break;
+		}
+		ffpp_cryptodev_set_qp_lcore(cd, i++, lcore_id);
+	}
+	return cd;
+
+fail:
+	ffpp_cryptodev_free(cd);
+	rte_errno = -ret;
+	return NULL;
+}
+
+/* Clear the keys of a session and free its ID. */
+static void session_wipe(struct ffpp_cryptodev *cd, uint32_t id)
+{
+	uint16_t i;
+
+	for (i = 0; i < cd->cfg.nb_qps; ++i) {
+		explicit_bzero(&cd->qps[i].ivs[id], sizeof(cd->qps[i].ivs[id]));
+	}
+	// The device clears the keys of its private session data.
+	rte_cryptodev_sym_session_clear(cd->cfg.dev_id, cd->sessions[id].sess);
+	rte_cryptodev_sym_session_free(cd->sessions[id].sess);
+	cd->sessions[id].sess = NULL;
+}
+
+void ffpp_cryptodev_free(struct ffpp_cryptodev *cd)
+{
+	uint32_t id;
+	uint16_t i;
+
+	if (cd == NULL) {
+		return;
+	}
+	if (cd->started) {
+		rte_cryptodev_stop(cd->cfg.dev_id);
+	}
+	// The stopped device has no inflight ops anymore.
+	if (cd->sessions != NULL && cd->qps != NULL) {
+		for (id = 1; id <= cd->cfg.max_sessions; ++id) {
+			if (cd->sessions[id].sess != NULL) {
+				session_wipe(cd, id);
+			}
+		}
+	}
+	if (cd->qps != NULL) {
+		for (i = 0; i < cd->cfg.nb_qps; ++i) {
+			rte_free(cd->qps[i].ivs);
+			rte_free(cd->qps[i].sess_inflight);
+		}
+		rte_free(cd->qps);
+	}
+	rte_free(cd->qsbr);
+	rte_free(cd->sessions);
+	rte_mempool_free(cd->sess_priv_pool);
+	rte_mempool_free(cd->sess_pool);
+	rte_mempool_free(cd->op_pool);
+	rte_free(cd);
+}
+
+int ffpp_cryptodev_session_create(
+	struct ffpp_cryptodev *cd,
+	const struct ffpp_crypto_session_params *params,
+	enum ffpp_crypto_dir dir)
+{
+	const struct rte_cryptodev_symmetric_capability *cap;
+	struct rte_cryptodev_sym_capability_idx cap_idx;
+	struct rte_cryptodev_sym_session *sess;
+	struct ffpp_crypto_session tmpl;
+	struct rte_crypto_sym_xform xform;
+	struct ffpp_crypto_session *s;
+	uint16_t key_len, iv_len, i;
+	uint32_t id;
+	int ret;
+
+	memset(&xform, 0, sizeof(xform));
+	key_len = AES_KEYLEN;
+	iv_len = AES_BLOCKLEN;
+	switch (params->algo) {
+	case FFPP_CRYPTO_AES_CBC:
+		xform.cipher.algo = RTE_CRYPTO_CIPHER_AES_CBC;
+		break;
+	case FFPP_CRYPTO_AES_CTR:
+		xform.cipher.algo = RTE_CRYPTO_CIPHER_AES_CTR;
+		break;
+	case FFPP_CRYPTO_NULL:
+		xform.cipher.algo = RTE_CRYPTO_CIPHER_NULL;
+		key_len = 0;
+		iv_len = 0;
+		break;
+	default:
+		return -EINVAL;
+	}
+	cap_idx.type = RTE_CRYPTO_SYM_XFORM_CIPHER;
+	cap_idx.algo.cipher = xform.cipher.algo;
+	cap = rte_cryptodev_sym_capability_get(cd->cfg.dev_id, &cap_idx);
+	if (cap == NULL || rte_cryptodev_sym_capability_check_cipher(
+				   cap, key_len, iv_len) != 0) {
+		return -ENOTSUP;
+	}
+	for (id = 1; id <= cd->cfg.max_sessions; ++id) {
+		if (cd->sessions[id].sess == NULL) {
+			break;
+		}
+	}
+	if (id > cd->cfg.max_sessions) {
+		return -ENOSPC;
+	}
+
+	xform.type = RTE_CRYPTO_SYM_XFORM_CIPHER;
+	xform.cipher.op = dir == FFPP_CRYPTO_ENCRYPT ?
+				  RTE_CRYPTO_CIPHER_OP_ENCRYPT :
+				  RTE_CRYPTO_CIPHER_OP_DECRYPT;
+	xform.cipher.key.data = params->key;
+	xform.cipher.key.length = key_len;
+	xform.cipher.iv.offset = OP_PRIV_OFFSET;
+	xform.cipher.iv.length = iv_len;
+	sess = rte_cryptodev_sym_session_create(cd->sess_pool);
+	if (sess == NULL) {
+		return -ENOMEM;
+	}
+	ret = rte_cryptodev_sym_session_init(cd->cfg.dev_id, sess, &xform,
+					     cd->sess_priv_pool);
+	if (ret < 0) {
+		rte_cryptodev_sym_session_free(sess);
+		return ret;
+	}
+	cd->sessions[id].sess = sess;
+	cd->sessions[id].dir = dir;
+
+	// The IVs are derived like in crypto.c, the queue pair is the
+	// partition of the sequence numbers.
+	memset(&tmpl, 0, sizeof(tmpl));
+	if (params->algo == FFPP_CRYPTO_AES_CBC) {
+		AES_init_ctx(&tmpl.ctx, params->key);
+	}
+	memcpy(tmpl.salt, params->salt, AES_BLOCKLEN);
+	tmpl.algo = params->algo;
+	for (i = 0; i < cd->cfg.nb_qps; ++i) {
+		s = &cd->qps[i].ivs[id];
+		*s = tmpl;
+		s->seq = (uint64_t)i << FFPP_CRYPTO_SEQ_PART_SHIFT;
+		s->seq_end = s->seq + (1ULL << FFPP_CRYPTO_SEQ_PART_SHIFT) - 1;
+		__atomic_store_n(&s->active, true, __ATOMIC_RELEASE);
+	}
+	explicit_bzero(&tmpl, sizeof(tmpl));
+	return id;
+}
+
+int ffpp_cryptodev_session_destroy(struct ffpp_cryptodev *cd, uint32_t id)
+{
+	uint16_t i;
+
+	if (id == FFPP_CRYPTO_SESSION_NONE || id > cd->cfg.max_sessions ||
+	    cd->sessions[id].sess == NULL) {
+		return -ENOENT;
+	}
+	for (i = 0; i < cd->cfg.nb_qps; ++i) {
+		__atomic_store_n(&cd->qps[i].ivs[id].active, false,
+				 __ATOMIC_RELEASE);
+	}
+	// After the quiescent state, no reader enqueues ops of the session.
+	rte_rcu_qsbr_synchronize(cd->qsbr, RTE_QSBR_THRID_INVALID);
+	for (i = 0; i < cd->cfg.nb_qps; ++i) {
+		if (__atomic_load_n(&cd->qps[i].sess_inflight[id],
+				    __ATOMIC_ACQUIRE) != 0) {
+			return -EBUSY;
+		}
+	}
+	session_wipe(cd, id);
+	return 0;
+}
+
+int ffpp_cryptodev_reader_register(struct ffpp_cryptodev *cd, uint16_t qp)
+{
+	if (qp >= cd->cfg.nb_qps ||
+	    rte_rcu_qsbr_thread_register(cd->qsbr, qp) != 0) {
+		return -EINVAL;
+	}
+	rte_rcu_qsbr_thread_online(cd->qsbr, qp);
+	return 0;
+}
+
+void ffpp_cryptodev_reader_unregister(struct ffpp_cryptodev *cd, uint16_t qp)
+{
+	rte_rcu_qsbr_thread_offline(cd->qsbr, qp);
+	rte_rcu_qsbr_thread_unregister(cd->qsbr, qp);
+}
+
+void ffpp_cryptodev_quiescent(struct ffpp_cryptodev *cd, uint16_t qp)
+{
+	rte_rcu_qsbr_quiescent(cd->qsbr, qp);
+}
+
+uint16_t ffpp_cryptodev_nb_qps(const struct ffpp_cryptodev *cd)
+{
+	return cd->cfg.nb_qps;
+}
+
+int ffpp_cryptodev_set_qp_lcore(struct ffpp_cryptodev *cd, uint16_t qp,
+				unsigned int lcore_id)
+{
+	struct cdev_qp *q;
+
+	if (qp >= cd->cfg.nb_qps || lcore_id >= RTE_MAX_LCORE) {
+		return -EINVAL;
+	}
+	q = &cd->qps[qp];
+	if (q->lcore_id != RTE_MAX_LCORE) {
+		cd->lcore_qp[q->lcore_id] = -1;
+	}
+	if (cd->lcore_qp[lcore_id] >= 0) {
+		cd->qps[cd->lcore_qp[lcore_id]].lcore_id = RTE_MAX_LCORE;
+	}
+	q->lcore_id = lcore_id;
+	cd->lcore_qp[lcore_id] = qp;
+	return 0;
+}
+
+int ffpp_cryptodev_lcore_qp(const struct ffpp_cryptodev *cd,
+			    unsigned int lcore_id)
+{
+	if (lcore_id >= RTE_MAX_LCORE || cd->lcore_qp[lcore_id] < 0) {
+		return -ENOENT;
+	}
+	return cd->lcore_qp[lcore_id];
+}
+
+static __rte_always_inline struct ffpp_crypto_session *
+session_of(struct cdev_qp *q, uint32_t max_sessions, uint32_t id)
+{
+	struct ffpp_crypto_session *s;
+
+	if (id == FFPP_CRYPTO_SESSION_NONE || id > max_sessions) {
+		return NULL;
+	}
+	s = &q->ivs[id];
+	return __atomic_load_n(&s->active, __ATOMIC_ACQUIRE) ? s : NULL;
+}
+
+/* Build the op of a packet, return false if the packet is not processed. */
+static __rte_always_inline bool
+prepare_op(struct ffpp_cryptodev *cd, struct cdev_qp *q, uint32_t id,
+	   struct ffpp_crypto_session *s, const struct cdev_session *cs,
+	   struct rte_crypto_op *op, struct rte_mbuf *m, const uint64_t *seq)
+{
+	uint16_t offset = cd->cfg.offset;
+	struct op_priv *priv;
+	uint32_t len = 0;
+
+	if (rte_pktmbuf_data_len(m) > offset) {
+		len = rte_pktmbuf_data_len(m) - offset;
+	}
+	if (s->algo == FFPP_CRYPTO_AES_CBC) {
+		len = RTE_ALIGN_FLOOR(len, AES_BLOCKLEN);
+	}
+	if (len == 0) {
+		q->stats.skipped++;
+		return false;
+	}
+
+	priv = rte_crypto_op_ctod_offset(op, struct op_priv *, OP_PRIV_OFFSET);
+	if (cs->dir == FFPP_CRYPTO_DECRYPT) {
+		if (*seq == FFPP_CRYPTO_SEQ_NONE) {
+			q->stats.skipped++;
+			return false;
+		}
+		priv->seq = *seq;
+	} else if (likely(s->seq != s->seq_end)) {
+		priv->seq = s->seq++;
+	} else {
+		q->stats.seq_exhausted++;
+		return false;
+	}
+	if (s->algo != FFPP_CRYPTO_NULL) {
+		ffpp_crypto_session_iv(s, priv->seq, priv->iv);
+	}
+	priv->session = id;
+	rte_crypto_op_attach_sym_session(op, cs->sess);
+	op->sym->m_src = m;
+	op->sym->cipher.data.offset = offset;
+	op->sym->cipher.data.length = len;
+	return true;
+}
+
+uint16_t ffpp_cryptodev_enqueue(struct ffpp_cryptodev *cd, uint16_t qp,
+				uint32_t id, struct ffpp_mvec *vec,
+				const uint64_t *seqs)
+{
+	struct rte_crypto_op *ops[FFPP_CRYPTODEV_BURST_MAX];
+	struct cdev_qp *q = &cd->qps[qp];
+	struct ffpp_crypto_session *s;
+	const struct cdev_session *cs;
+	uint16_t nb_keep = 0, nb_enq = 0;
+	uint16_t off, n, i, nb_ops, ret;
+	struct rte_mbuf *m;
+
+	s = session_of(q, cd->cfg.max_sessions, id);
+	cs = &cd->sessions[id];
+	if (unlikely(s == NULL ||
+		     (cs->dir == FFPP_CRYPTO_DECRYPT && seqs == NULL))) {
+		return 0;
+	}
+
+	for (off = 0; off < vec->len; off += n) {
+		n = RTE_MIN(vec->len - off, FFPP_CRYPTODEV_BURST_MAX);
+		if (unlikely(rte_crypto_op_bulk_alloc(
+				     cd->op_pool, RTE_CRYPTO_OP_TYPE_SYMMETRIC,
+				     ops, n) == 0)) {
+			q->stats.no_ops += vec->len - off;
+			break;
+		}
+		nb_ops = 0;
+		for (i = 0; i < n; ++i) {
+			m = vec->head[off + i];
+			if (prepare_op(cd, q, id, s, cs, ops[nb_ops], m,
+				       seqs != NULL ? &seqs[off + i] : NULL)) {
+				nb_ops++;
+			} else {
+				vec->head[nb_keep++] = m;
+			}
+		}
+		ret = rte_cryptodev_enqueue_burst(cd->cfg.dev_id, qp, ops,
+						  nb_ops);
+		// The mbufs of the rejected ops are kept, all packets of this
+		// burst have been read already.
+		for (i = ret; i < nb_ops; ++i) {
+			vec->head[nb_keep++] = ops[i]->sym->m_src;
+		}
+		rte_mempool_put_bulk(cd->op_pool, (void **)&ops[ret], n - ret);
+		q->stats.busy += nb_ops - ret;
+		q->stats.enqueued += ret;
+		q->stats.inflight += ret;
+		nb_enq += ret;
+		__atomic_store_n(&q->sess_inflight[id],
+				 q->sess_inflight[id] + ret, __ATOMIC_RELAXED);
+		if (ret < nb_ops) {
+			off += n;
+			break;
+		}
+	}
+	// Keep the packets that were not tried because of a full device or
+	// an empty op pool.
+	for (; off < vec->len; ++off) {
+		vec->head[nb_keep++] = vec->head[off];
+	}
+	vec->len = nb_keep;
+	return nb_enq;
+}
+
+uint16_t ffpp_cryptodev_dequeue(struct ffpp_cryptodev *cd, uint16_t qp,
+				struct ffpp_mvec *vec, uint64_t *seqs)
+{
+	struct rte_crypto_op *ops[FFPP_CRYPTODEV_BURST_MAX];
+	struct cdev_qp *q = &cd->qps[qp];
+	uint16_t nb_done = 0;
+	uint16_t n, nb_deq, i;
+	struct rte_crypto_op *op;
+	struct op_priv *priv;
+
+	while (vec->len < vec->capacity) {
+		n = RTE_MIN(vec->capacity - vec->len, FFPP_CRYPTODEV_BURST_MAX);
+		nb_deq = rte_cryptodev_dequeue_burst(cd->cfg.dev_id, qp, ops,
+						     n);
+		for (i = 0; i < nb_deq; ++i) {
+			op = ops[i];
+			priv = rte_crypto_op_ctod_offset(op, struct op_priv *,
+							 OP_PRIV_OFFSET);
+			// The device is done with the session of the op.
+			__atomic_store_n(&q->sess_inflight[priv->session],
+					 q->sess_inflight[priv->session] - 1,
+					 __ATOMIC_RELEASE);
+			if (unlikely(op->status !=
+				     RTE_CRYPTO_OP_STATUS_SUCCESS)) {
+				q->stats.errors++;
+				rte_pktmbuf_free(op->sym->m_src);
+				continue;
+			}
+			if (seqs != NULL) {
+				seqs[vec->len] = priv->seq;
+			}
+			q->stats.bytes += op->sym->cipher.data.length;
+			vec->head[vec->len++] = op->sym->m_src;
+			nb_done++;
+		}
+		if (nb_deq > 0) {
+			rte_mempool_put_bulk(cd->op_pool, (void **)ops, nb_deq);
+		}
+		q->stats.inflight -= nb_deq;
+		if (nb_deq < n) {
+			break;
+		}
+	}
+	q->stats.dequeued += nb_done;
+	return nb_done;
+}
+
+uint16_t ffpp_cryptodev_dequeue_tx(struct ffpp_cryptodev *cd, uint16_t qp,
+				   uint16_t port_id, uint16_t queue_id)
+{
+	struct rte_mbuf *pkts[FFPP_CRYPTODEV_BURST_MAX];
+	struct ffpp_mvec vec;
+	uint16_t nb_tx;
+
+	vec.len = 0;
+	vec.capacity = FFPP_CRYPTODEV_BURST_MAX;
+	vec.socket_id = rte_socket_id();
+	vec.head = pkts;
+	if (ffpp_cryptodev_dequeue(cd, qp, &vec, NULL) == 0) {
+		return 0;
+	}
+	nb_tx = rte_eth_tx_burst(port_id, queue_id, pkts, vec.len);
+	if (unlikely(nb_tx < vec.len)) {
+		rte_pktmbuf_free_bulk(pkts + nb_tx, vec.len - nb_tx);
+	}
+	return nb_tx;
+}
+
+void ffpp_cryptodev_get_stats(const struct ffpp_cryptodev *cd, uint16_t qp,
+			      struct ffpp_cryptodev_stats *stats)
+{
+	*stats = cd->qps[qp].stats;
+}
@@ -0,0 +1,91 @@
+/*
+ * cycle_stats.c
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <rte_atomic.h>
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_errno.h>
+#include <rte_log.h>
+#include <rte_memzone.h>
+
+#include <ffpp/config.h>
+#include <ffpp/cycle_stats.h>
+
+struct ffpp_cycle_stats *ffpp_cycle_stats_get(void)
+{
+	const struct rte_memzone *mz;
+	struct ffpp_cycle_stats *cs;
+
+	mz = rte_memzone_lookup(FFPP_CYCLE_STATS_MZ_NAME);
+	if (mz != NULL) {
+		return mz->addr;
+	}
+	if (rte_eal_process_type() != RTE_PROC_PRIMARY) {
+		rte_errno = ENOENT;
+		return NULL;
+	}
+
+	mz = rte_memzone_reserve(FFPP_CYCLE_STATS_MZ_NAME,
+				 sizeof(struct ffpp_cycle_stats), SOCKET_ID_ANY,
+				 0);
+	if (mz == NULL) {
+		RTE_LOG(ERR, FFPP, "Can not reserve the cycle stats memzone.\n");
+		return NULL;
+	}
+	cs = mz->addr;
+	memset(cs, 0, sizeof(*cs));
+	cs->tsc_hz = rte_get_tsc_hz();
+	rte_smp_wmb();
+	cs->magic = FFPP_CYCLE_STATS_MAGIC;
+	return cs;
+}
+
+struct ffpp_cycle_stats *ffpp_cycle_stats_attach(void)
+{
+	const struct rte_memzone *mz;
+	struct ffpp_cycle_stats *cs;
+
+	mz = rte_memzone_lookup(FFPP_CYCLE_STATS_MZ_NAME);
+	if (mz == NULL) {
+		rte_errno = ENOENT;
+		return NULL;
+	}
+	cs = mz->addr;
+	if (cs->magic != FFPP_CYCLE_STATS_MAGIC) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+	rte_smp_rmb();
+	return cs;
+}
+
+void ffpp_cycle_stats_read(const struct ffpp_cycle_stats *cs,
+			   unsigned int lcore_id, struct ffpp_lcore_cycles *snap)
+{
+	const struct ffpp_lcore_cycles *c = &(cs->lcores[lcore_id]);
+
+	snap->idle_cycles = __atomic_load_n(&c->idle_cycles, __ATOMIC_RELAXED);
+	snap->proc_cycles = __atomic_load_n(&c->proc_cycles, __ATOMIC_RELAXED);
+	snap->tx_cycles = __atomic_load_n(&c->tx_cycles, __ATOMIC_RELAXED);
+	snap->empty_polls = __atomic_load_n(&c->empty_polls, __ATOMIC_RELAXED);
+	snap->busy_polls = __atomic_load_n(&c->busy_polls, __ATOMIC_RELAXED);
+	snap->last_tsc = __atomic_load_n(&c->last_tsc, __ATOMIC_RELAXED);
+	snap->active = __atomic_load_n(&c->active, __ATOMIC_RELAXED);
+}
+
+double ffpp_cycle_stats_busy_ratio(const struct ffpp_lcore_cycles *prev,
+				   const struct ffpp_lcore_cycles *cur)
+{
+	uint64_t idle = cur->idle_cycles - prev->idle_cycles;
+	uint64_t busy = (cur->proc_cycles - prev->proc_cycles) +
+			(cur->tx_cycles - prev->tx_cycles);
+
+	if (idle + busy == 0) {
+		return 0.0;
+	}
+	return (double)busy / (double)(idle + busy);
+}
@@ -2,24 +2,204 @@
  * device.c
  */
 
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include <rte_bus_vdev.h>
+#include <rte_dev.h>
 #include <rte_ethdev.h>
 #include <rte_ether.h>
 #include <rte_log.h>
+#include <rte_version.h>
 
 #include <ffpp/device.h>
 
+#define VDEV_ARGS_MAX_LEN 512
+#define TX_CKSUM_OFFLOADS                                                      \
+	(DEV_TX_OFFLOAD_IPV4_CKSUM | DEV_TX_OFFLOAD_UDP_CKSUM |                \
+	 DEV_TX_OFFLOAD_TCP_CKSUM)
+
+// TX offloads enabled by ffpp_dpdk_init_device().
+static uint64_t port_tx_offloads[RTE_MAX_ETHPORTS];
+
+/**
+ * Create a virtual device with the given driver and devargs, and write the
+ * assigned port ID back into the config.
+ */
+static int create_vdev(struct ffpp_dpdk_device_config *cfg, const char *name,
+		       const char *args)
+{
+	uint16_t port_id;
+	int ret;
+
+	RTE_LOG(INFO, PORT, "[PORT INFO] Create vdev %s with args: %s\n", name,
+		args);
+	ret = rte_vdev_init(name, args);
+	if (ret < 0) {
+		RTE_LOG(ERR, PORT, "Can not create vdev %s: err=%d\n", name,
+			ret);
+		return ret;
+	}
+	ret = rte_eth_dev_get_port_by_name(name, &port_id);
+	if (ret < 0) {
+		rte_vdev_uninit(name);
+		return ret;
+	}
+	cfg->port_id = port_id;
+	return 0;
+}
+
+/**
+ * Append to the devargs at offset *len and advance it. Returns -EINVAL on an
+ * encoding error and -ENAMETOOLONG if the args do not fit.
+ */
+__rte_format_printf(3, 4)
+static int vdev_args_append(char *args, int *len, const char *fmt, ...)
+{
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = vsnprintf(args + *len, VDEV_ARGS_MAX_LEN - *len, fmt, ap);
+	va_end(ap);
+	if (ret < 0) {
+		return -EINVAL;
+	}
+	if ((size_t)ret >= (size_t)(VDEV_ARGS_MAX_LEN - *len)) {
+		return -ENAMETOOLONG;
+	}
+	*len += ret;
+	return 0;
+}
+
+static int create_af_xdp_vdev(struct ffpp_dpdk_device_config *cfg)
+{
+	const struct ffpp_af_xdp_config *xcfg = &(cfg->af_xdp);
+	char name[RTE_DEV_NAME_MAX_LEN];
+	char args[VDEV_ARGS_MAX_LEN];
+	int len = 0;
+	int ret;
+
+	if (cfg->rx_queues != cfg->tx_queues) {
+		RTE_LOG(ERR, PORT,
+			"AF_XDP ports need the same number of RX and TX queues.\n");
+		return -EINVAL;
+	}
+
+	snprintf(name, sizeof(name), "net_af_xdp_%s", xcfg->iface);
+	ret = vdev_args_append(
+		args, &len,
+		"iface=%s,start_queue=%u,queue_count=%u,busy_budget=%u",
+		xcfg->iface, xcfg->start_queue, cfg->rx_queues,
+		xcfg->busy_budget);
+	if (ret == 0 && xcfg->shared_umem) {
+		ret = vdev_args_append(args, &len, ",shared_umem=1");
+	}
+	if (ret == 0 && xcfg->xdp_prog != NULL) {
+		ret = vdev_args_append(args, &len, ",xdp_prog=%s",
+				       xcfg->xdp_prog);
+	}
+	if (ret < 0) {
+		return ret;
+	}
+
+	switch (xcfg->mode) {
+	case FFPP_AF_XDP_MODE_AUTO:
+		break;
+	case FFPP_AF_XDP_MODE_COPY:
+#if RTE_VERSION >= RTE_VERSION_NUM(22, 11, 0, 0)
+		ret = vdev_args_append(args, &len, ",force_copy=1");
+		if (ret < 0) {
+			return ret;
+		}
+#else
+		RTE_LOG(WARNING, PORT,
+			"AF_XDP copy mode can not be forced with this DPDK version, the kernel chooses the mode.\n");
+#endif
+		break;
+	default:
+		RTE_LOG(ERR, PORT, "Unknown AF_XDP mode %d.\n", xcfg->mode);
+		return -EINVAL;
+	}
+
+	return create_vdev(cfg, name, args);
+}
+
+static int create_vhost_vdev(struct ffpp_dpdk_device_config *cfg)
+{
+	static uint16_t vhost_cnt = 0;
+	static uint16_t virtio_cnt = 0;
+	const struct ffpp_vhost_config *vcfg = &(cfg->vhost);
+	char name[RTE_DEV_NAME_MAX_LEN];
+	char args[VDEV_ARGS_MAX_LEN];
+	int len = 0;
+	int ret;
+
+	if (cfg->rx_queues != cfg->tx_queues) {
+		RTE_LOG(ERR, PORT,
+			"vhost/virtio-user ports need the same number of RX and TX queues.\n");
+		return -EINVAL;
+	}
+
+	if (cfg->type == FFPP_DPDK_DEVICE_VHOST_USER) {
+		snprintf(name, sizeof(name), "net_vhost%u", vhost_cnt++);
+		ret = vdev_args_append(args, &len,
+				       "iface=%s,queues=%u,client=%d",
+				       vcfg->path, cfg->rx_queues,
+				       !vcfg->server);
+	} else {
+		snprintf(name, sizeof(name), "virtio_user%u", virtio_cnt++);
+		ret = vdev_args_append(args, &len,
+				       "path=%s,queues=%u,server=%d,"
+				       "mrg_rxbuf=%d,packed_vq=%d",
+				       vcfg->path, cfg->rx_queues, vcfg->server,
+				       vcfg->mrg_rxbuf, vcfg->packed_vq);
+		if (ret == 0 && vcfg->queue_size != 0) {
+			ret = vdev_args_append(args, &len, ",queue_size=%u",
+					       vcfg->queue_size);
+		}
+	}
+	if (ret < 0) {
+		RTE_LOG(ERR, PORT, "Invalid vhost/virtio-user path %s.\n",
+			vcfg->path);
+		return ret;
+	}
+
+	return create_vdev(cfg, name, args);
+}
+
 int ffpp_dpdk_init_device(struct ffpp_dpdk_device_config *cfg)
 {
 	int ret = 0;
+	uint16_t q;
 	struct rte_eth_dev_info dev_info;
 	struct rte_eth_rxconf rxq_conf;
 	struct rte_eth_txconf txq_conf;
 	struct rte_ether_addr port_eth_addr;
 
-	/* TODO: Add support for multiple RX TX queues using flow director
-         * <01-03-19, Zuo> */
-	if (cfg->rx_queues > 1 || cfg->tx_queues > 2) {
-		rte_exit(EXIT_FAILURE, "Support only one TX and RX queue.\n");
+	if (cfg->rx_queues > FFPP_MAX_QUEUES_PER_PORT ||
+	    cfg->tx_queues > FFPP_MAX_QUEUES_PER_PORT) {
+		rte_exit(EXIT_FAILURE, "Support maximal %d TX and RX queues.\n",
+			 FFPP_MAX_QUEUES_PER_PORT);
+	}
+
+	switch (cfg->type) {
+	case FFPP_DPDK_DEVICE_ETHDEV:
+		break;
+	case FFPP_DPDK_DEVICE_AF_XDP:
+		ret = create_af_xdp_vdev(cfg);
+		break;
+	case FFPP_DPDK_DEVICE_VHOST_USER:
+	case FFPP_DPDK_DEVICE_VIRTIO_USER:
+		ret = create_vhost_vdev(cfg);
+		break;
+	default:
+		ret = -EINVAL;
+	}
+	if (ret < 0) {
+		rte_exit(EXIT_FAILURE, "Cannot create device: err=%d, type=%d\n",
+			 ret, cfg->type);
 	}
 
 	rte_eth_dev_info_get(cfg->port_id, &dev_info);
@@ -29,6 +209,14 @@ int ffpp_dpdk_init_device(struct ffpp_dpdk_device_config *cfg)
 		cfg->port_id, dev_info.driver_name, dev_info.nb_rx_queues,
 		dev_info.nb_tx_queues);
 
+	if (cfg->rx_queues > dev_info.max_rx_queues ||
+	    cfg->tx_queues > dev_info.max_tx_queues) {
+		rte_exit(EXIT_FAILURE,
+			 "Port %d supports maximal %u RX and %u TX queues.\n",
+			 cfg->port_id, dev_info.max_rx_queues,
+			 dev_info.max_tx_queues);
+	}
+
 	// Use a generic port_conf by default
 	struct rte_eth_conf port_conf = {
 		.rxmode =
@@ -41,12 +229,32 @@ int ffpp_dpdk_init_device(struct ffpp_dpdk_device_config *cfg)
 			},
 
 	};
-	if (dev_info.tx_offload_capa & DEV_TX_OFFLOAD_MBUF_FAST_FREE) {
+	if (!cfg->shared_mbufs &&
+	    (dev_info.tx_offload_capa & DEV_TX_OFFLOAD_MBUF_FAST_FREE)) {
 		RTE_LOG(INFO, PORT,
 			"[PORT INFO] Port ID: %d support fast mbuf free.\n",
 			cfg->port_id);
 		port_conf.txmode.offloads |= DEV_TX_OFFLOAD_MBUF_FAST_FREE;
 	}
+	// Packets without PKT_TX_*_CKSUM flags are not affected, see
+	// ffpp_csum_finalize().
+	if (!cfg->disable_offloads &&
+	    (dev_info.tx_offload_capa & TX_CKSUM_OFFLOADS) != 0) {
+		RTE_LOG(INFO, PORT,
+			"[PORT INFO] Port ID: %d support TX checksum offloads.\n",
+			cfg->port_id);
+		port_conf.txmode.offloads |=
+			dev_info.tx_offload_capa & TX_CKSUM_OFFLOADS;
+	}
+	// AF_XDP ports report no RSS offloads, the kernel driver spreads the
+	// traffic over the bound NIC queues instead.
+	if (cfg->rx_queues > 1 && dev_info.flow_type_rss_offloads != 0) {
+		port_conf.rxmode.mq_mode = ETH_MQ_RX_RSS;
+		port_conf.rx_adv_conf.rss_conf.rss_key = NULL;
+		port_conf.rx_adv_conf.rss_conf.rss_hf =
+			(ETH_RSS_IP | ETH_RSS_UDP | ETH_RSS_TCP) &
+			dev_info.flow_type_rss_offloads;
+	}
 
 	ret = rte_eth_dev_configure(cfg->port_id, cfg->rx_queues,
 				    cfg->tx_queues, &port_conf);
@@ -56,6 +264,7 @@ int ffpp_dpdk_init_device(struct ffpp_dpdk_device_config *cfg)
 			 "Cannot configure device: err=%d, port=%d\n", ret,
 			 cfg->port_id);
 	}
+	port_tx_offloads[cfg->port_id] = port_conf.txmode.offloads;
 
 	// Check that numbers of Rx and Tx descriptors satisfy descriptors
 	// limits from the ethernet device information, otherwise adjust them to
@@ -76,22 +285,29 @@ int ffpp_dpdk_init_device(struct ffpp_dpdk_device_config *cfg)
 
 	rxq_conf = dev_info.default_rxconf;
 	rxq_conf.offloads = port_conf.rxmode.offloads;
-	ret = rte_eth_rx_queue_setup(cfg->port_id, 0, cfg->rx_descs,
-				     rte_eth_dev_socket_id(cfg->port_id),
-				     &rxq_conf, *(cfg->pool));
-	if (unlikely(ret != 0)) {
-		rte_exit(EXIT_FAILURE,
-			 "Can not setup rx queue with error code:%d\n", ret);
+	for (q = 0; q < cfg->rx_queues; ++q) {
+		ret = rte_eth_rx_queue_setup(
+			cfg->port_id, q, cfg->rx_descs,
+			rte_eth_dev_socket_id(cfg->port_id), &rxq_conf,
+			*(cfg->pool));
+		if (unlikely(ret != 0)) {
+			rte_exit(EXIT_FAILURE,
+				 "Can not setup rx queue %u with error code:%d\n",
+				 q, ret);
+		}
 	}
 
 	txq_conf = dev_info.default_txconf;
 	txq_conf.offloads = port_conf.txmode.offloads;
-	ret = rte_eth_tx_queue_setup(cfg->port_id, 0, cfg->tx_descs,
-				     rte_eth_dev_socket_id(cfg->port_id),
-				     &txq_conf);
-	if (unlikely(ret != 0)) {
-		rte_exit(EXIT_FAILURE,
-			 "Can not setup tx queue with error code:%d\n", ret);
+	for (q = 0; q < cfg->tx_queues; ++q) {
+		ret = rte_eth_tx_queue_setup(cfg->port_id, q, cfg->tx_descs,
+					     rte_eth_dev_socket_id(cfg->port_id),
+					     &txq_conf);
+		if (unlikely(ret != 0)) {
+			rte_exit(EXIT_FAILURE,
+				 "Can not setup tx queue %u with error code:%d\n",
+				 q, ret);
+		}
 	}
 
 	// Start device
@@ -111,6 +327,14 @@ int ffpp_dpdk_init_device(struct ffpp_dpdk_device_config *cfg)
 	return 0;
 }
 
+uint64_t ffpp_dpdk_get_tx_offloads(uint16_t port_id)
+{
+	if (port_id >= RTE_MAX_ETHPORTS) {
+		return 0;
+	}
+	return port_tx_offloads[port_id];
+}
+
 void ffpp_dpdk_cleanup_devices(void)
 {
 	uint32_t port_id;
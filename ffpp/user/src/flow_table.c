@@ -0,0 +1,577 @@
+/*
+ * flow_table.c
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_hash_crc.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_prefetch.h>
+
+#include <ffpp/config.h>
+#include <ffpp/flow_table.h>
+
+#define BUCKET_ENTRIES 8
+// Buckets after the home bucket that are probed for a free slot.
+#define MAX_PROBE 4
+#define SIG_EMPTY 0
+#define IDX_NONE UINT32_MAX
+
+/*
+ * Timer wheel: 256 slots of 1 tick, 64 slots of 256 ticks and 64 slots of
+ * 16384 ticks. Flows with a later deadline are parked in the last level and
+ * rescheduled when it is cascaded.
+ */
+#define TW_L0_BITS 8
+#define TW_LN_BITS 6
+#define TW_L0_SLOTS (1U << TW_L0_BITS)
+#define TW_LN_SLOTS (1U << TW_LN_BITS)
+#define TW_L1_SPAN (1ULL << (TW_L0_BITS + TW_LN_BITS))
+#define TW_MAX_DELTA (1ULL << (TW_L0_BITS + 2 * TW_LN_BITS))
+#define TW_NB_SLOTS (TW_L0_SLOTS + 2 * TW_LN_SLOTS)
+
+struct flow_bucket {
+	uint16_t sig[BUCKET_ENTRIES];
+	uint32_t idx[BUCKET_ENTRIES];
+	// Entries with an earlier home bucket that are stored after this one.
+	uint32_t nb_displaced;
+} __rte_cache_aligned;
+
+enum entry_state { ENTRY_FREE, ENTRY_ACTIVE, ENTRY_DELETED };
+
+struct flow_entry {
+	struct ffpp_cls_5tuple key;
+	uint64_t last_tick;
+	uint32_t hash;
+	uint32_t tw_next;
+	uint8_t state;
+	uint8_t data[] __attribute__((aligned(8)));
+};
+
+struct tw_list {
+	uint32_t head;
+	uint32_t tail;
+};
+
+struct flow_part {
+	struct flow_bucket *buckets;
+	uint8_t *entries;
+	uint32_t *free_idx;
+	uint32_t nb_free;
+	uint64_t cur_tick;
+	// Every allocated entry is in exactly one slot or in pending.
+	struct tw_list slots[TW_NB_SLOTS];
+	struct tw_list pending;
+	struct ffpp_flow_stats stats;
+} __rte_cache_aligned;
+
+struct ffpp_flow_table {
+	struct ffpp_flow_table_config cfg;
+	uint32_t bucket_mask;
+	uint32_t entry_size;
+	uint64_t tick_tsc;
+	uint64_t timeout_ticks;
+	struct flow_part parts[];
+};
+
+static __rte_always_inline struct flow_entry *
+entry_at(const struct ffpp_flow_table *tbl, const struct flow_part *p,
+	 uint32_t idx)
+{
+	return (struct flow_entry *)(p->entries +
+				     (size_t)idx * tbl->entry_size);
+}
+
+static __rte_always_inline uint16_t sig_of(uint32_t hash)
+{
+	uint16_t sig = hash >> 16;
+	return sig == SIG_EMPTY ? 1 : sig;
+}
+
+static __rte_always_inline bool key_eq(const struct ffpp_cls_5tuple *k1,
+				       const struct ffpp_cls_5tuple *k2)
+{
+	uint64_t a[2], b[2];
+
+	memcpy(a, k1, sizeof(a));
+	memcpy(b, k2, sizeof(b));
+	return ((a[0] ^ b[0]) | (a[1] ^ b[1])) == 0;
+}
+
+static __rte_always_inline uint64_t now_tick(const struct ffpp_flow_table *tbl)
+{
+	return rte_rdtsc() / tbl->tick_tsc;
+}
+
+static void tw_push(const struct ffpp_flow_table *tbl, struct flow_part *p,
+		    struct tw_list *l, uint32_t idx)
+{
+	entry_at(tbl, p, idx)->tw_next = IDX_NONE;
+	if (l->tail == IDX_NONE) {
+		l->head = idx;
+	} else {
+		entry_at(tbl, p, l->tail)->tw_next = idx;
+	}
+	l->tail = idx;
+}
+
+static uint32_t tw_pop(const struct ffpp_flow_table *tbl, struct flow_part *p,
+		       struct tw_list *l)
+{
+	uint32_t idx = l->head;
+
+	l->head = entry_at(tbl, p, idx)->tw_next;
+	if (l->head == IDX_NONE) {
+		l->tail = IDX_NONE;
+	}
+	return idx;
+}
+
+static void tw_splice(const struct ffpp_flow_table *tbl, struct flow_part *p,
+		      struct tw_list *dst, struct tw_list *src)
+{
+	if (src->head == IDX_NONE) {
+		return;
+	}
+	if (dst->tail == IDX_NONE) {
+		dst->head = src->head;
+	} else {
+		entry_at(tbl, p, dst->tail)->tw_next = src->head;
+	}
+	dst->tail = src->tail;
+	src->head = IDX_NONE;
+	src->tail = IDX_NONE;
+}
+
+/* The deadline must be after the current tick. */
+static void tw_schedule(const struct ffpp_flow_table *tbl, struct flow_part *p,
+			uint32_t idx, uint64_t deadline)
+{
+	uint64_t delta = deadline - p->cur_tick;
+	uint32_t slot;
+
+	if (delta >= TW_MAX_DELTA) {
+		deadline = p->cur_tick + TW_MAX_DELTA - 1;
+		delta = TW_MAX_DELTA - 1;
+	}
+	if (delta < TW_L0_SLOTS) {
+		slot = deadline & (TW_L0_SLOTS - 1);
+	} else if (delta < TW_L1_SPAN) {
+		slot = TW_L0_SLOTS +
+		       ((deadline >> TW_L0_BITS) & (TW_LN_SLOTS - 1));
+	} else {
+		slot = TW_L0_SLOTS + TW_LN_SLOTS +
+		       ((deadline >> (TW_L0_BITS + TW_LN_BITS)) &
+			(TW_LN_SLOTS - 1));
+	}
+	tw_push(tbl, p, &p->slots[slot], idx);
+}
+
+/* Move the entries that are due at the next tick to pending, O(1). */
+static void tw_advance(const struct ffpp_flow_table *tbl, struct flow_part *p)
+{
+	uint64_t t = ++p->cur_tick;
+
+	tw_splice(tbl, p, &p->pending, &p->slots[t & (TW_L0_SLOTS - 1)]);
+	if ((t & (TW_L0_SLOTS - 1)) != 0) {
+		return;
+	}
+	tw_splice(tbl, p, &p->pending,
+		  &p->slots[TW_L0_SLOTS +
+			    ((t >> TW_L0_BITS) & (TW_LN_SLOTS - 1))]);
+	if ((t & (TW_L1_SPAN - 1)) != 0) {
+		return;
+	}
+	tw_splice(tbl, p, &p->pending,
+		  &p->slots[TW_L0_SLOTS + TW_LN_SLOTS +
+			    ((t >> (TW_L0_BITS + TW_LN_BITS)) &
+			     (TW_LN_SLOTS - 1))]);
+}
+
+static uint32_t find(const struct ffpp_flow_table *tbl,
+		     const struct flow_part *p,
+		     const struct ffpp_cls_5tuple *key, uint32_t hash)
+{
+	uint16_t sig = sig_of(hash);
+	const struct flow_bucket *bkt;
+	uint32_t d, s;
+
+	for (d = 0; d < MAX_PROBE; ++d) {
+		bkt = &p->buckets[(hash + d) & tbl->bucket_mask];
+		for (s = 0; s < BUCKET_ENTRIES; ++s) {
+			if (bkt->sig[s] == sig &&
+			    key_eq(&entry_at(tbl, p, bkt->idx[s])->key, key)) {
+				return bkt->idx[s];
+			}
+		}
+		if (bkt->nb_displaced == 0) {
+			break;
+		}
+	}
+	return IDX_NONE;
+}
+
+static void unlink_entry(const struct ffpp_flow_table *tbl,
+			 struct flow_part *p, uint32_t idx, uint32_t hash)
+{
+	struct flow_bucket *bkt;
+	uint32_t d, k, s;
+
+	for (d = 0; d < MAX_PROBE; ++d) {
+		bkt = &p->buckets[(hash + d) & tbl->bucket_mask];
+		for (s = 0; s < BUCKET_ENTRIES; ++s) {
+			if (bkt->sig[s] == SIG_EMPTY || bkt->idx[s] != idx) {
+				continue;
+			}
+			bkt->sig[s] = SIG_EMPTY;
+			for (k = 0; k < d; ++k) {
+				p->buckets[(hash + k) & tbl->bucket_mask]
+					.nb_displaced--;
+			}
+			p->stats.nb_flows--;
+			return;
+		}
+	}
+}
+
+static void *insert_one(const struct ffpp_flow_table *tbl, struct flow_part *p,
+			const struct ffpp_cls_5tuple *key, uint32_t hash,
+			uint64_t tick)
+{
+	struct flow_bucket *bkt = NULL;
+	struct flow_entry *e;
+	uint32_t d, k, s = 0;
+	uint32_t idx;
+
+	// The key may have been inserted for an earlier packet of the burst.
+	idx = find(tbl, p, key, hash);
+	if (idx != IDX_NONE) {
+		e = entry_at(tbl, p, idx);
+		e->last_tick = tick;
+		return e->data;
+	}
+
+	if (p->nb_free == 0) {
+		p->stats.insert_failures++;
+		return NULL;
+	}
+	for (d = 0; d < MAX_PROBE; ++d) {
+		bkt = &p->buckets[(hash + d) & tbl->bucket_mask];
+		for (s = 0; s < BUCKET_ENTRIES; ++s) {
+			if (bkt->sig[s] == SIG_EMPTY) {
+				break;
+			}
+		}
+		if (s < BUCKET_ENTRIES) {
+			break;
+		}
+	}
+	if (d == MAX_PROBE) {
+		p->stats.insert_failures++;
+		return NULL;
+	}
+	for (k = 0; k < d; ++k) {
+		p->buckets[(hash + k) & tbl->bucket_mask].nb_displaced++;
+	}
+
+	idx = p->free_idx[--p->nb_free];
+	e = entry_at(tbl, p, idx);
+	e->key = *key;
+	e->hash = hash;
+	e->last_tick = tick;
+	e->state = ENTRY_ACTIVE;
+	memset(e->data, 0, tbl->cfg.data_size);
+	bkt->sig[s] = sig_of(hash);
+	bkt->idx[s] = idx;
+	tw_schedule(tbl, p, idx, tick + tbl->timeout_ticks);
+	p->stats.nb_flows++;
+	p->stats.inserts++;
+	return e->data;
+}
+
+/**
+ * Look up in three passes over the burst: hash and prefetch the home buckets,
+ * match the signatures and prefetch the entries, compare the keys. Flows that
+ * are not in their home bucket or share a signature take the slow path.
+ */
+static uint16_t lookup_bulk(const struct ffpp_flow_table *tbl,
+			    struct flow_part *p,
+			    const struct ffpp_cls_5tuple *keys, uint16_t n,
+			    void **data, uint32_t *hashes, uint64_t tick)
+{
+	uint32_t cand[FFPP_FLOW_BULK_MAX];
+	const struct flow_bucket *bkt;
+	struct flow_entry *e;
+	uint16_t nb_found = 0;
+	uint16_t i, s, sig;
+
+	for (i = 0; i < n; ++i) {
+		hashes[i] = rte_hash_crc(&keys[i], sizeof(keys[i]), 0);
+		rte_prefetch0(&p->buckets[hashes[i] & tbl->bucket_mask]);
+	}
+
+	for (i = 0; i < n; ++i) {
+		bkt = &p->buckets[hashes[i] & tbl->bucket_mask];
+		sig = sig_of(hashes[i]);
+		cand[i] = IDX_NONE;
+		for (s = 0; s < BUCKET_ENTRIES; ++s) {
+			if (bkt->sig[s] == sig) {
+				cand[i] = bkt->idx[s];
+				rte_prefetch0(entry_at(tbl, p, cand[i]));
+				break;
+			}
+		}
+	}
+
+	for (i = 0; i < n; ++i) {
+		if (cand[i] == IDX_NONE ||
+		    !key_eq(&entry_at(tbl, p, cand[i])->key, &keys[i])) {
+			cand[i] = find(tbl, p, &keys[i], hashes[i]);
+		}
+		if (cand[i] == IDX_NONE) {
+			data[i] = NULL;
+			continue;
+		}
+		e = entry_at(tbl, p, cand[i]);
+		e->last_tick = tick;
+		data[i] = e->data;
+		nb_found++;
+	}
+	return nb_found;
+}
+
+struct ffpp_flow_table *
+ffpp_flow_table_create(const struct ffpp_flow_table_config *cfg)
+{
+	struct ffpp_flow_table *tbl;
+	struct flow_part *p;
+	uint32_t nb_buckets;
+	uint32_t i, j;
+
+	if (cfg->name[0] == '\0' ||
+	    strnlen(cfg->name, FFPP_FLOW_NAME_MAX_LEN) ==
+		    FFPP_FLOW_NAME_MAX_LEN ||
+	    cfg->nb_parts == 0 || cfg->max_flows == 0 ||
+	    cfg->max_flows > (1U << 31)) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+
+	tbl = rte_zmalloc_socket(cfg->name,
+				 sizeof(*tbl) + cfg->nb_parts * sizeof(*p),
+				 RTE_CACHE_LINE_SIZE, cfg->socket_id);
+	if (tbl == NULL) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	tbl->cfg = *cfg;
+	if (tbl->cfg.tick_us == 0) {
+		tbl->cfg.tick_us = FFPP_FLOW_TICK_US_DEFAULT;
+	}
+	if (tbl->cfg.timeout_us == 0) {
+		tbl->cfg.timeout_us = FFPP_FLOW_TIMEOUT_US_DEFAULT;
+	}
+	tbl->tick_tsc = RTE_MAX(rte_get_tsc_hz() * tbl->cfg.tick_us / US_PER_S,
+				1UL);
+	tbl->timeout_ticks =
+		RTE_MAX((tbl->cfg.timeout_us + tbl->cfg.tick_us - 1) /
+				tbl->cfg.tick_us,
+			1UL);
+	// At most half of the slots are used.
+	nb_buckets = RTE_MAX(rte_align32pow2(cfg->max_flows) /
+				     (BUCKET_ENTRIES / 2),
+			     1U);
+	tbl->bucket_mask = nb_buckets - 1;
+	tbl->entry_size = RTE_ALIGN_CEIL(sizeof(struct flow_entry) +
+						 cfg->data_size,
+					 RTE_CACHE_LINE_SIZE);
+
+	for (i = 0; i < cfg->nb_parts; ++i) {
+		p = &tbl->parts[i];
+		p->buckets = rte_zmalloc_socket(
+			"ffpp_flow_buckets",
+			(size_t)nb_buckets * sizeof(struct flow_bucket),
+			RTE_CACHE_LINE_SIZE, cfg->socket_id);
+		p->entries = rte_zmalloc_socket(
+			"ffpp_flow_entries",
+			(size_t)cfg->max_flows * tbl->entry_size,
+			RTE_CACHE_LINE_SIZE, cfg->socket_id);
+		p->free_idx = rte_malloc_socket(
+			"ffpp_flow_free", cfg->max_flows * sizeof(uint32_t),
+			RTE_CACHE_LINE_SIZE, cfg->socket_id);
+		if (p->buckets == NULL || p->entries == NULL ||
+		    p->free_idx == NULL) {
+			RTE_LOG(ERR, FFPP,
+				"Can not allocate the flow table %s.\n",
+				cfg->name);
+			ffpp_flow_table_free(tbl);
+			rte_errno = ENOMEM;
+			return NULL;
+		}
+		for (j = 0; j < cfg->max_flows; ++j) {
+			p->free_idx[j] = cfg->max_flows - 1 - j;
+		}
+		p->nb_free = cfg->max_flows;
+		for (j = 0; j < TW_NB_SLOTS; ++j) {
+			p->slots[j].head = IDX_NONE;
+			p->slots[j].tail = IDX_NONE;
+		}
+		p->pending.head = IDX_NONE;
+		p->pending.tail = IDX_NONE;
+		p->cur_tick = now_tick(tbl);
+	}
+
+	return tbl;
+}
+
+void ffpp_flow_table_free(struct ffpp_flow_table *tbl)
+{
+	uint16_t i;
+
+	if (tbl == NULL) {
+		return;
+	}
+	for (i = 0; i < tbl->cfg.nb_parts; ++i) {
+		rte_free(tbl->parts[i].buckets);
+		rte_free(tbl->parts[i].entries);
+		rte_free(tbl->parts[i].free_idx);
+	}
+	rte_free(tbl);
+}
+
+uint16_t ffpp_flow_lookup_bulk(struct ffpp_flow_table *tbl, uint16_t part,
+			       const struct ffpp_cls_5tuple *keys, uint16_t n,
+			       void **data)
+{
+	uint32_t hashes[FFPP_FLOW_BULK_MAX];
+
+	return lookup_bulk(tbl, &tbl->parts[part], keys, n, data, hashes,
+			   now_tick(tbl));
+}
+
+uint16_t ffpp_flow_insert_bulk(struct ffpp_flow_table *tbl, uint16_t part,
+			       const struct ffpp_cls_5tuple *keys, uint16_t n,
+			       void **data)
+{
+	uint32_t hashes[FFPP_FLOW_BULK_MAX];
+	struct flow_part *p = &tbl->parts[part];
+	uint64_t tick = now_tick(tbl);
+	uint16_t nb_found, i;
+
+	nb_found = lookup_bulk(tbl, p, keys, n, data, hashes, tick);
+	if (nb_found == n) {
+		return n;
+	}
+	for (i = 0; i < n; ++i) {
+		if (data[i] != NULL) {
+			continue;
+		}
+		data[i] = insert_one(tbl, p, &keys[i], hashes[i], tick);
+		if (data[i] != NULL) {
+			nb_found++;
+		}
+	}
+	return nb_found;
+}
+
+uint16_t ffpp_flow_lookup_mvec(struct ffpp_flow_table *tbl, uint16_t part,
+			       const struct ffpp_mvec *vec, void **data,
+			       bool insert)
+{
+	struct ffpp_cls_5tuple keys[FFPP_FLOW_BULK_MAX];
+	void *found[FFPP_FLOW_BULK_MAX];
+	uint16_t pos[FFPP_FLOW_BULK_MAX];
+	uint16_t nb_found = 0;
+	uint16_t i, k, n;
+
+	for (i = 0; i < vec->len;) {
+		for (n = 0; n < FFPP_FLOW_BULK_MAX && i < vec->len; ++i) {
+			data[i] = NULL;
+			if (ffpp_cls_5tuple_of(vec->head[i], &keys[n]) == 0) {
+				pos[n++] = i;
+			}
+		}
+		if (insert) {
+			nb_found += ffpp_flow_insert_bulk(tbl, part, keys, n,
+							  found);
+		} else {
+			nb_found += ffpp_flow_lookup_bulk(tbl, part, keys, n,
+							  found);
+		}
+		for (k = 0; k < n; ++k) {
+			data[pos[k]] = found[k];
+		}
+	}
+	return nb_found;
+}
+
+int ffpp_flow_del(struct ffpp_flow_table *tbl, uint16_t part,
+		  const struct ffpp_cls_5tuple *key)
+{
+	struct flow_part *p = &tbl->parts[part];
+	uint32_t hash = rte_hash_crc(key, sizeof(*key), 0);
+	uint32_t idx;
+
+	idx = find(tbl, p, key, hash);
+	if (idx == IDX_NONE) {
+		return -ENOENT;
+	}
+	unlink_entry(tbl, p, idx, hash);
+	// The entry is freed when the timer wheel reaches it.
+	entry_at(tbl, p, idx)->state = ENTRY_DELETED;
+	return 0;
+}
+
+uint32_t ffpp_flow_age(struct ffpp_flow_table *tbl, uint16_t part,
+		       uint32_t budget)
+{
+	struct flow_part *p = &tbl->parts[part];
+	uint64_t now = now_tick(tbl);
+	uint32_t work = 0, nb_expired = 0;
+	struct flow_entry *e;
+	uint64_t deadline;
+	uint32_t idx;
+
+	while (work < budget) {
+		work++;
+		if (p->pending.head == IDX_NONE) {
+			if (p->cur_tick >= now) {
+				break;
+			}
+			tw_advance(tbl, p);
+			continue;
+		}
+
+		idx = tw_pop(tbl, p, &p->pending);
+		e = entry_at(tbl, p, idx);
+		if (e->state == ENTRY_ACTIVE) {
+			deadline = e->last_tick + tbl->timeout_ticks;
+			if (deadline > p->cur_tick) {
+				tw_schedule(tbl, p, idx, deadline);
+				continue;
+			}
+			unlink_entry(tbl, p, idx, e->hash);
+			if (tbl->cfg.expire_cb != NULL) {
+				tbl->cfg.expire_cb(&e->key, e->data,
+						   tbl->cfg.expire_arg);
+			}
+			nb_expired++;
+		}
+		e->state = ENTRY_FREE;
+		p->free_idx[p->nb_free++] = idx;
+	}
+
+	p->stats.expired += nb_expired;
+	return nb_expired;
+}
+
+void ffpp_flow_get_stats(const struct ffpp_flow_table *tbl, uint16_t part,
+			 struct ffpp_flow_stats *stats)
+{
+	*stats = tbl->parts[part].stats;
+}
@@ -0,0 +1,339 @@
+/*
+ * gcm.c
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_byteorder.h>
+#include <rte_common.h>
+#include <rte_errno.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_udp.h>
+
+#include <ffpp/gcm.h>
+
+struct gcm_part {
+	struct AES_GCM_ctx ctx;
+	uint64_t seq; /**< Next sequence number */
+	uint64_t seq_end; /**< Exclusive end of the sequence numbers */
+	struct ffpp_gcm_stats stats;
+	uint16_t nb_pending;
+	struct rte_mbuf *pending[FFPP_GCM_BATCH_MAX];
+	// Scratch of the batch, at the same indices as the packets.
+	struct AES_GCM_buf bufs[FFPP_GCM_BATCH_MAX];
+	uint8_t ivs[FFPP_GCM_BATCH_MAX][AES_GCM_IVLEN];
+	uint8_t valid[FFPP_GCM_BATCH_MAX];
+} __rte_cache_aligned;
+
+struct ffpp_gcm {
+	struct ffpp_gcm_config cfg;
+	struct gcm_part *parts;
+};
+
+struct ffpp_gcm *ffpp_gcm_create(const struct ffpp_gcm_config *cfg)
+{
+	struct AES_GCM_ctx ctx;
+	struct ffpp_gcm *g;
+	struct gcm_part *p;
+	uint16_t i;
+
+	if (cfg->name[0] == '\0' ||
+	    strnlen(cfg->name, FFPP_GCM_NAME_MAX_LEN) ==
+		    FFPP_GCM_NAME_MAX_LEN ||
+	    cfg->nb_parts == 0 || cfg->batch_size > FFPP_GCM_BATCH_MAX ||
+	    (cfg->dir != FFPP_CRYPTO_ENCRYPT &&
+	     cfg->dir != FFPP_CRYPTO_DECRYPT)) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+
+	g = rte_zmalloc_socket("ffpp_gcm", sizeof(*g), RTE_CACHE_LINE_SIZE,
+			       cfg->socket_id);
+	if (g == NULL) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	g->cfg = *cfg;
+	if (g->cfg.batch_size == 0) {
+		g->cfg.batch_size = FFPP_GCM_BATCH_DEFAULT;
+	}
+	// Only the copies of the key schedule are kept.
+	explicit_bzero(g->cfg.key, sizeof(g->cfg.key));
+
+	g->parts = rte_zmalloc_socket("ffpp_gcm_parts",
+				      cfg->nb_parts * sizeof(*g->parts),
+				      RTE_CACHE_LINE_SIZE, cfg->socket_id);
+	if (g->parts == NULL) {
+		rte_free(g);
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+
+	// The only key expansion, each partition gets a copy of the round keys
+	// and the powers of the hash key.
+	AES_GCM_init_ctx(&ctx, cfg->key);
+	for (i = 0; i < cfg->nb_parts; ++i) {
+		p = &g->parts[i];
+		p->ctx = ctx;
+		p->seq = (uint64_t)i << FFPP_CRYPTO_SEQ_PART_SHIFT;
+		p->seq_end = p->seq + (1ULL << FFPP_CRYPTO_SEQ_PART_SHIFT) - 1;
+	}
+	explicit_bzero(&ctx, sizeof(ctx));
+	return g;
+}
+
+void ffpp_gcm_free(struct ffpp_gcm *g)
+{
+	uint16_t i;
+
+	if (g == NULL) {
+		return;
+	}
+	for (i = 0; i < g->cfg.nb_parts; ++i) {
+		rte_pktmbuf_free_bulk(g->parts[i].pending,
+				      g->parts[i].nb_pending);
+	}
+	explicit_bzero(g->parts, g->cfg.nb_parts * sizeof(*g->parts));
+	rte_free(g->parts);
+	rte_free(g);
+}
+
+/*
+ * Update the lengths of an untagged IPv4/UDP packet whose payload starts at
+ * the offset, other packets are not changed.
+ */
+static __rte_always_inline void fix_udp(uint8_t *data, uint16_t offset,
+					int16_t delta)
+{
+	const struct rte_ether_hdr *eth = (const struct rte_ether_hdr *)data;
+	struct rte_ipv4_hdr *ip;
+	struct rte_udp_hdr *udp;
+	uint16_t ihl;
+
+	if (offset < RTE_ETHER_HDR_LEN + sizeof(*ip) + sizeof(*udp) ||
+	    eth->ether_type != RTE_BE16(RTE_ETHER_TYPE_IPV4)) {
+		return;
+	}
+	ip = (struct rte_ipv4_hdr *)(eth + 1);
+	ihl = (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) *
+	      RTE_IPV4_IHL_MULTIPLIER;
+	if (ip->next_proto_id != IPPROTO_UDP ||
+	    RTE_ETHER_HDR_LEN + ihl + sizeof(*udp) != offset) {
+		return;
+	}
+	udp = (struct rte_udp_hdr *)((uint8_t *)ip + ihl);
+	ip->total_length = rte_cpu_to_be_16(
+		(uint16_t)(rte_be_to_cpu_16(ip->total_length) + delta));
+	ip->hdr_checksum = 0;
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+	udp->dgram_len = rte_cpu_to_be_16(
+		(uint16_t)(rte_be_to_cpu_16(udp->dgram_len) + delta));
+	// The checksum would cover the ciphertext, the tag protects it anyway.
+	udp->dgram_cksum = 0;
+}
+
+static __rte_always_inline void set_iv(uint8_t *iv, const uint8_t *salt,
+				       rte_be64_t seq)
+{
+	memcpy(iv, salt, FFPP_GCM_SALT_LEN);
+	memcpy(iv + FFPP_GCM_SALT_LEN, &seq, sizeof(seq));
+}
+
+/*
+ * Push the header of a packet and fill in its buffer. Returns 0 if the packet
+ * must be dropped.
+ */
+static __rte_always_inline int prepare_encrypt(const struct ffpp_gcm *g,
+					       struct gcm_part *p,
+					       struct rte_mbuf *m, uint16_t i)
+{
+	uint16_t offset = g->cfg.offset;
+	struct ffpp_gcm_hdr *hdr;
+	uint8_t *data;
+
+	if (unlikely(!rte_pktmbuf_is_contiguous(m) ||
+		     rte_pktmbuf_data_len(m) < offset)) {
+		p->stats.dropped += 1;
+		return 0;
+	}
+	if (unlikely(p->seq == p->seq_end)) {
+		p->stats.seq_exhausted += 1;
+		return 0;
+	}
+	data = (uint8_t *)rte_pktmbuf_prepend(m, FFPP_GCM_HDR_LEN);
+	if (unlikely(data == NULL)) {
+		p->stats.dropped += 1;
+		return 0;
+	}
+	memmove(data, data + FFPP_GCM_HDR_LEN, offset);
+	fix_udp(data, offset, FFPP_GCM_HDR_LEN);
+
+	hdr = (struct ffpp_gcm_hdr *)(data + offset);
+	hdr->seq = rte_cpu_to_be_64(p->seq);
+	p->seq += 1;
+	set_iv(p->ivs[i], g->cfg.salt, hdr->seq);
+	p->bufs[i] = (struct AES_GCM_buf){
+		.buf = data + offset + FFPP_GCM_HDR_LEN,
+		.length = rte_pktmbuf_data_len(m) - offset - FFPP_GCM_HDR_LEN,
+		.iv = p->ivs[i],
+		.aad = (const uint8_t *)&hdr->seq,
+		.aad_len = sizeof(hdr->seq),
+		.tag = hdr->tag,
+	};
+	return 1;
+}
+
+static __rte_always_inline int prepare_decrypt(const struct ffpp_gcm *g,
+					       struct gcm_part *p,
+					       struct rte_mbuf *m, uint16_t i)
+{
+	uint16_t offset = g->cfg.offset;
+	struct ffpp_gcm_hdr *hdr;
+	uint8_t *data;
+
+	if (unlikely(!rte_pktmbuf_is_contiguous(m) ||
+		     rte_pktmbuf_data_len(m) < offset + FFPP_GCM_HDR_LEN)) {
+		p->stats.dropped += 1;
+		return 0;
+	}
+	data = rte_pktmbuf_mtod(m, uint8_t *);
+	hdr = (struct ffpp_gcm_hdr *)(data + offset);
+	set_iv(p->ivs[i], g->cfg.salt, hdr->seq);
+	p->bufs[i] = (struct AES_GCM_buf){
+		.buf = data + offset + FFPP_GCM_HDR_LEN,
+		.length = rte_pktmbuf_data_len(m) - offset - FFPP_GCM_HDR_LEN,
+		.iv = p->ivs[i],
+		.aad = (const uint8_t *)&hdr->seq,
+		.aad_len = sizeof(hdr->seq),
+		.tag = hdr->tag,
+	};
+	return 1;
+}
+
+/* Pull the header of a decrypted packet. */
+static __rte_always_inline void finish_decrypt(uint16_t offset,
+					       struct rte_mbuf *m)
+{
+	uint8_t *data = rte_pktmbuf_mtod(m, uint8_t *);
+
+	memmove(data + FFPP_GCM_HDR_LEN, data, offset);
+	data = (uint8_t *)rte_pktmbuf_adj(m, FFPP_GCM_HDR_LEN);
+	fix_udp(data, offset, -(int16_t)FFPP_GCM_HDR_LEN);
+}
+
+/*
+ * Process the first n packets of the batch and append them to out, the
+ * remaining packets are moved to the front.
+ */
+static uint16_t run_batch(struct ffpp_gcm *g, struct gcm_part *p, uint16_t n,
+			  struct ffpp_mvec *out)
+{
+	struct rte_mbuf *m;
+	uint64_t bytes = 0;
+	uint16_t nb_bufs = 0;
+	uint16_t nb_out = 0;
+	uint16_t i;
+	int ok;
+
+	// Drop the invalid packets first, so the buffers are contiguous.
+	for (i = 0; i < n; ++i) {
+		m = p->pending[i];
+		if (g->cfg.dir == FFPP_CRYPTO_ENCRYPT) {
+			ok = prepare_encrypt(g, p, m, nb_bufs);
+		} else {
+			ok = prepare_decrypt(g, p, m, nb_bufs);
+		}
+		if (unlikely(!ok)) {
+			rte_pktmbuf_free(m);
+			continue;
+		}
+		p->pending[nb_bufs++] = m;
+	}
+
+	if (g->cfg.dir == FFPP_CRYPTO_ENCRYPT) {
+		AES_GCM_encrypt_multi(&p->ctx, p->bufs, nb_bufs);
+		for (i = 0; i < nb_bufs; ++i) {
+			bytes += p->bufs[i].length;
+			out->head[out->len + nb_out++] = p->pending[i];
+		}
+		p->stats.encrypted += nb_bufs;
+	} else {
+		AES_GCM_decrypt_multi(&p->ctx, p->bufs, nb_bufs, p->valid);
+		for (i = 0; i < nb_bufs; ++i) {
+			m = p->pending[i];
+			if (unlikely(!p->valid[i])) {
+				p->stats.auth_failed += 1;
+				rte_pktmbuf_free(m);
+				continue;
+			}
+			bytes += p->bufs[i].length;
+			finish_decrypt(g->cfg.offset, m);
+			out->head[out->len + nb_out++] = m;
+		}
+		p->stats.decrypted += nb_out;
+	}
+	out->len += nb_out;
+	p->stats.bytes += bytes;
+	p->stats.batches += 1;
+
+	memmove(p->pending, p->pending + n,
+		(p->nb_pending - n) * sizeof(p->pending[0]));
+	p->nb_pending -= n;
+	return nb_out;
+}
+
+uint16_t ffpp_gcm_process(struct ffpp_gcm *g, uint16_t part,
+			  struct ffpp_mvec *vec, struct ffpp_mvec *out)
+{
+	struct gcm_part *p = &g->parts[part];
+	uint16_t batch_size = g->cfg.batch_size;
+	uint16_t nb_out = 0;
+	uint16_t i = 0;
+	uint16_t n;
+
+	while (i < vec->len) {
+		n = RTE_MIN(vec->len - i, batch_size - p->nb_pending);
+		memcpy(p->pending + p->nb_pending, vec->head + i,
+		       n * sizeof(vec->head[0]));
+		p->nb_pending += n;
+		i += n;
+		if (p->nb_pending < batch_size) {
+			break;
+		}
+		if (out->capacity - out->len < batch_size) {
+			break;
+		}
+		nb_out += run_batch(g, p, batch_size, out);
+	}
+
+	memmove(vec->head, vec->head + i,
+		(vec->len - i) * sizeof(vec->head[0]));
+	vec->len -= i;
+	return nb_out;
+}
+
+uint16_t ffpp_gcm_flush(struct ffpp_gcm *g, uint16_t part,
+			struct ffpp_mvec *out)
+{
+	struct gcm_part *p = &g->parts[part];
+	uint16_t n = RTE_MIN(p->nb_pending, out->capacity - out->len);
+
+	if (n == 0) {
+		return 0;
+	}
+	return run_batch(g, p, n, out);
+}
+
+void ffpp_gcm_get_stats(const struct ffpp_gcm *g, uint16_t part,
+			struct ffpp_gcm_stats *stats)
+{
+	const struct gcm_part *p = &g->parts[part];
+
+	*stats = p->stats;
+	stats->pending = p->nb_pending;
+}
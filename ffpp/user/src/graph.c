@@ -0,0 +1,1076 @@
+/*
+ * graph.c
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <rte_common.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_graph.h>
+#include <rte_graph_worker.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+#include <rte_log.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_prefetch.h>
+#include <rte_ring.h>
+
+#include <ffpp/aes.h>
+#include <ffpp/config.h>
+#include <ffpp/graph.h>
+#include <ffpp/packet_processors.h>
+
+// Node IDs are allocated one after another by rte_graph, clones included.
+#define GRAPH_NODE_ID_MAX 4096
+#define GRAPH_MAX_RXQS (FFPP_MAX_PORTS * FFPP_MAX_QUEUES_PER_PORT)
+// RX, processing, MuNF RX, classify, TX and drop nodes of a graph.
+#define GRAPH_MAX_PATTERNS                                                     \
+	(GRAPH_MAX_RXQS + 2 * FFPP_GRAPH_MAX_NODES + 1 + FFPP_MAX_PORTS + 1)
+
+/**
+ * struct graph_node - A node cloned for a VNF.
+ *
+ * The init function of the node copies what it needs into the context of its
+ * instance in each graph.
+ */
+struct graph_node {
+	char name[RTE_NODE_NAMESIZE];
+	rte_node_t id;
+	struct ffpp_graph_vnf *vnf;
+	const struct ffpp_graph_node_conf *conf;
+	struct rte_ring *ring; /**< MuNF endpoints */
+	uint16_t port_idx; /**< Ethernet RX and TX */
+	uint16_t queue_id; /**< Ethernet RX */
+};
+
+struct vnf_graph {
+	char name[RTE_GRAPH_NAMESIZE];
+	rte_graph_t id;
+	struct rte_graph *graph;
+	unsigned int lcore_id;
+	struct ffpp_graph_vnf *vnf;
+	uint16_t nb_rx_nodes;
+	uint16_t rx_nodes[GRAPH_MAX_RXQS];
+};
+
+struct ffpp_graph_vnf {
+	struct ffpp_graph_config cfg;
+	volatile bool stop;
+	bool has_munf;
+	// Maps a port ID back to its index in cfg.port_ids.
+	uint16_t port_idx[RTE_MAX_ETHPORTS];
+	// Index of the graph being created, used as its TX queue.
+	uint16_t tx_queue;
+	uint16_t nb_graphs;
+	struct vnf_graph graphs[RTE_MAX_LCORE];
+	uint16_t nb_rx_nodes;
+	struct graph_node rx_nodes[GRAPH_MAX_RXQS];
+	struct graph_node proc_nodes[FFPP_GRAPH_MAX_NODES];
+	struct graph_node munf_rx_nodes[FFPP_GRAPH_MAX_NODES];
+	struct graph_node classify_node;
+	struct graph_node tx_nodes[FFPP_MAX_PORTS];
+};
+
+struct eth_rx_ctx {
+	uint16_t port_id;
+	uint16_t queue_id;
+	uint16_t burst_size;
+};
+
+struct eth_tx_ctx {
+	uint16_t port_id;
+	uint16_t queue_id;
+};
+
+struct ring_ctx {
+	struct rte_ring *ring;
+	uint16_t burst_size;
+};
+
+struct proc_ctx {
+	const struct ffpp_graph_node_conf *conf;
+};
+
+struct aes_ctx {
+	struct aes_state *state;
+};
+
+/* State of an AES node in one graph, the IV is modified by the CBC mode. */
+struct aes_state {
+	struct AES_ctx ctx;
+	const struct ffpp_graph_aes_conf *conf;
+};
+
+struct classify_ctx {
+	const struct ffpp_graph_vnf *vnf;
+};
+
+static struct graph_node *node_table[GRAPH_NODE_ID_MAX];
+
+static __rte_always_inline struct graph_node *
+node_data(const struct rte_node *node)
+{
+	return node->id < GRAPH_NODE_ID_MAX ? node_table[node->id] : NULL;
+}
+
+/* Send the first nb_keep objects to the next node and the others to drop. */
+static __rte_always_inline void forward(struct rte_graph *graph,
+					struct rte_node *node, void **objs,
+					uint16_t nb_objs, uint16_t nb_keep)
+{
+	if (likely(nb_keep == nb_objs)) {
+		rte_node_next_stream_move(graph, node, FFPP_GRAPH_EDGE_NEXT);
+		return;
+	}
+	if (nb_keep > 0) {
+		rte_node_enqueue(graph, node, FFPP_GRAPH_EDGE_NEXT, objs,
+				 nb_keep);
+	}
+	rte_node_enqueue(graph, node, FFPP_GRAPH_EDGE_DROP, &objs[nb_keep],
+			 nb_objs - nb_keep);
+}
+
+static __rte_always_inline void mvec_of_objs(struct ffpp_mvec *vec,
+					     const struct rte_graph *graph,
+					     void **objs, uint16_t nb_objs)
+{
+	vec->len = nb_objs;
+	vec->capacity = nb_objs;
+	vec->socket_id = graph->socket;
+	vec->head = (struct rte_mbuf **)objs;
+}
+
+/* Ethernet RX */
+
+static uint16_t eth_rx_process(struct rte_graph *graph, struct rte_node *node,
+			       void **objs, uint16_t nb_objs)
+{
+	const struct eth_rx_ctx *ctx = (const struct eth_rx_ctx *)node->ctx;
+	uint16_t n;
+
+	RTE_SET_USED(objs);
+	RTE_SET_USED(nb_objs);
+
+	n = rte_eth_rx_burst(ctx->port_id, ctx->queue_id,
+			     (struct rte_mbuf **)node->objs, ctx->burst_size);
+	if (n == 0) {
+		return 0;
+	}
+	node->idx = n;
+	rte_node_next_stream_move(graph, node, FFPP_GRAPH_EDGE_NEXT);
+	return n;
+}
+
+static int eth_rx_init(const struct rte_graph *graph, struct rte_node *node)
+{
+	struct eth_rx_ctx *ctx = (struct eth_rx_ctx *)node->ctx;
+	const struct graph_node *data = node_data(node);
+
+	RTE_BUILD_BUG_ON(sizeof(struct eth_rx_ctx) > RTE_NODE_CTX_SZ);
+	RTE_SET_USED(graph);
+	if (data == NULL) {
+		return -EINVAL;
+	}
+	ctx->port_id = data->vnf->cfg.port_ids[data->port_idx];
+	ctx->queue_id = data->queue_id;
+	ctx->burst_size = data->vnf->cfg.burst_size;
+	return 0;
+}
+
+static struct rte_node_register eth_rx_node = {
+	.name = "ffpp_eth_rx",
+	.flags = RTE_NODE_SOURCE_F,
+	.process = eth_rx_process,
+	.init = eth_rx_init,
+	.nb_edges = 1,
+	.next_nodes = { "ffpp_drop" },
+};
+
+RTE_NODE_REGISTER(eth_rx_node);
+
+/* Ethernet TX */
+
+static uint16_t eth_tx_process(struct rte_graph *graph, struct rte_node *node,
+			       void **objs, uint16_t nb_objs)
+{
+	const struct eth_tx_ctx *ctx = (const struct eth_tx_ctx *)node->ctx;
+	uint16_t n;
+
+	n = rte_eth_tx_burst(ctx->port_id, ctx->queue_id,
+			     (struct rte_mbuf **)objs, nb_objs);
+	if (unlikely(n < nb_objs)) {
+		rte_node_enqueue(graph, node, FFPP_GRAPH_EDGE_DROP, &objs[n],
+				 nb_objs - n);
+	}
+	return n;
+}
+
+static int eth_tx_init(const struct rte_graph *graph, struct rte_node *node)
+{
+	struct eth_tx_ctx *ctx = (struct eth_tx_ctx *)node->ctx;
+	const struct graph_node *data = node_data(node);
+
+	RTE_BUILD_BUG_ON(sizeof(struct eth_tx_ctx) > RTE_NODE_CTX_SZ);
+	RTE_SET_USED(graph);
+	if (data == NULL) {
+		return -EINVAL;
+	}
+	ctx->port_id = data->vnf->cfg.port_ids[data->port_idx];
+	ctx->queue_id = data->vnf->tx_queue;
+	return 0;
+}
+
+static struct rte_node_register eth_tx_node = {
+	.name = "ffpp_eth_tx",
+	.process = eth_tx_process,
+	.init = eth_tx_init,
+	.nb_edges = 1,
+	.next_nodes = { "ffpp_drop" },
+};
+
+RTE_NODE_REGISTER(eth_tx_node);
+
+/* Drop */
+
+static uint16_t drop_process(struct rte_graph *graph, struct rte_node *node,
+			     void **objs, uint16_t nb_objs)
+{
+	RTE_SET_USED(graph);
+	RTE_SET_USED(node);
+
+	rte_pktmbuf_free_bulk((struct rte_mbuf **)objs, nb_objs);
+	return nb_objs;
+}
+
+static struct rte_node_register drop_node = {
+	.name = "ffpp_drop",
+	.process = drop_process,
+};
+
+RTE_NODE_REGISTER(drop_node);
+
+/* Classify */
+
+static __rte_always_inline rte_edge_t
+classify_one(const struct ffpp_graph_vnf *vnf, struct rte_mbuf *m)
+{
+	const struct ffpp_graph_config *cfg = &(vnf->cfg);
+	int idx;
+
+	if (cfg->classify == NULL) {
+		return FFPP_GRAPH_EDGE_NEXT +
+		       cfg->tx_port_map[vnf->port_idx[m->port]];
+	}
+	idx = cfg->classify(m, cfg->classify_arg);
+	if (idx < 0 || idx >= cfg->nb_ports) {
+		return FFPP_GRAPH_EDGE_DROP;
+	}
+	return FFPP_GRAPH_EDGE_NEXT + idx;
+}
+
+/**
+ * Packets are enqueued in runs with the same edge, so the stream is moved
+ * without copying if all packets go to the same TX port.
+ */
+static uint16_t classify_process(struct rte_graph *graph,
+				 struct rte_node *node, void **objs,
+				 uint16_t nb_objs)
+{
+	const struct classify_ctx *ctx = (const struct classify_ctx *)node->ctx;
+	struct rte_mbuf **pkts = (struct rte_mbuf **)objs;
+	rte_edge_t last, next;
+	uint16_t start = 0;
+	uint16_t i;
+
+	last = classify_one(ctx->vnf, pkts[0]);
+	for (i = 1; i < nb_objs; ++i) {
+		next = classify_one(ctx->vnf, pkts[i]);
+		if (next != last) {
+			rte_node_enqueue(graph, node, last, &objs[start],
+					 i - start);
+			start = i;
+			last = next;
+		}
+	}
+	if (start == 0) {
+		rte_node_next_stream_move(graph, node, last);
+	} else {
+		rte_node_enqueue(graph, node, last, &objs[start],
+				 nb_objs - start);
+	}
+	return nb_objs;
+}
+
+static int classify_init(const struct rte_graph *graph, struct rte_node *node)
+{
+	struct classify_ctx *ctx = (struct classify_ctx *)node->ctx;
+	const struct graph_node *data = node_data(node);
+
+	RTE_BUILD_BUG_ON(sizeof(struct classify_ctx) > RTE_NODE_CTX_SZ);
+	RTE_SET_USED(graph);
+	if (data == NULL) {
+		return -EINVAL;
+	}
+	ctx->vnf = data->vnf;
+	return 0;
+}
+
+static struct rte_node_register classify_node = {
+	.name = "ffpp_classify",
+	.process = classify_process,
+	.init = classify_init,
+	.nb_edges = 1,
+	.next_nodes = { "ffpp_drop" },
+};
+
+RTE_NODE_REGISTER(classify_node);
+
+/* Processing nodes */
+
+static int proc_init(const struct rte_graph *graph, struct rte_node *node)
+{
+	struct proc_ctx *ctx = (struct proc_ctx *)node->ctx;
+	const struct graph_node *data = node_data(node);
+
+	RTE_BUILD_BUG_ON(sizeof(struct proc_ctx) > RTE_NODE_CTX_SZ);
+	RTE_SET_USED(graph);
+	if (data == NULL) {
+		return -EINVAL;
+	}
+	ctx->conf = data->conf;
+	return 0;
+}
+
+static uint16_t handler_process(struct rte_graph *graph, struct rte_node *node,
+				void **objs, uint16_t nb_objs)
+{
+	const struct proc_ctx *ctx = (const struct proc_ctx *)node->ctx;
+	struct ffpp_mvec vec;
+	uint16_t nb_keep;
+
+	mvec_of_objs(&vec, graph, objs, nb_objs);
+	nb_keep = ctx->conf->handler.func(&vec, ctx->conf->handler.arg);
+	forward(graph, node, objs, nb_objs, RTE_MIN(nb_keep, nb_objs));
+	return nb_objs;
+}
+
+static struct rte_node_register handler_node = {
+	.name = "ffpp_handler",
+	.process = handler_process,
+	.init = proc_init,
+	.nb_edges = 1,
+	.next_nodes = { "ffpp_drop" },
+};
+
+RTE_NODE_REGISTER(handler_node);
+
+static uint16_t rewrite_dl_process(struct rte_graph *graph,
+				   struct rte_node *node, void **objs,
+				   uint16_t nb_objs)
+{
+	const struct proc_ctx *ctx = (const struct proc_ctx *)node->ctx;
+	struct ffpp_mvec vec;
+
+	mvec_of_objs(&vec, graph, objs, nb_objs);
+	ffpp_pp_rewrite_dl(&vec, &(ctx->conf->rewrite_dl.src),
+			   &(ctx->conf->rewrite_dl.dst));
+	rte_node_next_stream_move(graph, node, FFPP_GRAPH_EDGE_NEXT);
+	return nb_objs;
+}
+
+static struct rte_node_register rewrite_dl_node = {
+	.name = "ffpp_rewrite_dl",
+	.process = rewrite_dl_process,
+	.init = proc_init,
+	.nb_edges = 1,
+	.next_nodes = { "ffpp_drop" },
+};
+
+RTE_NODE_REGISTER(rewrite_dl_node);
+
+static uint16_t update_dl_src_process(struct rte_graph *graph,
+				      struct rte_node *node, void **objs,
+				      uint16_t nb_objs)
+{
+	const struct proc_ctx *ctx = (const struct proc_ctx *)node->ctx;
+	struct ffpp_mvec vec;
+
+	mvec_of_objs(&vec, graph, objs, nb_objs);
+	ffpp_pp_update_dl_src(&vec, &(ctx->conf->dl_src));
+	rte_node_next_stream_move(graph, node, FFPP_GRAPH_EDGE_NEXT);
+	return nb_objs;
+}
+
+static struct rte_node_register update_dl_src_node = {
+	.name = "ffpp_update_dl_src",
+	.process = update_dl_src_process,
+	.init = proc_init,
+	.nb_edges = 1,
+	.next_nodes = { "ffpp_drop" },
+};
+
+RTE_NODE_REGISTER(update_dl_src_node);
+
+static uint16_t dec_ttl_process(struct rte_graph *graph, struct rte_node *node,
+				void **objs, uint16_t nb_objs)
+{
+	struct ffpp_mvec vec;
+
+	mvec_of_objs(&vec, graph, objs, nb_objs);
+	forward(graph, node, objs, nb_objs, ffpp_pp_dec_ttl(&vec));
+	return nb_objs;
+}
+
+static struct rte_node_register dec_ttl_node = {
+	.name = "ffpp_dec_ttl",
+	.process = dec_ttl_process,
+	.nb_edges = 1,
+	.next_nodes = { "ffpp_drop" },
+};
+
+RTE_NODE_REGISTER(dec_ttl_node);
+
+static uint16_t aes_process(struct rte_graph *graph, struct rte_node *node,
+			    void **objs, uint16_t nb_objs)
+{
+	struct aes_state *st = ((struct aes_ctx *)node->ctx)->state;
+	const struct ffpp_graph_aes_conf *conf = st->conf;
+	struct rte_mbuf **pkts = (struct rte_mbuf **)objs;
+	uint8_t *data;
+	uint32_t len;
+	uint16_t i;
+
+	for (i = 0; i < nb_objs; ++i) {
+		if (i + 1 < nb_objs) {
+			rte_prefetch0(rte_pktmbuf_mtod(pkts[i + 1], void *));
+		}
+		if (rte_pktmbuf_data_len(pkts[i]) <= conf->offset) {
+			continue;
+		}
+		data = rte_pktmbuf_mtod_offset(pkts[i], uint8_t *,
+					       conf->offset);
+		len = RTE_MIN((uint32_t)conf->len,
+			      (uint32_t)(rte_pktmbuf_data_len(pkts[i]) -
+					 conf->offset));
+		len = RTE_ALIGN_FLOOR(len, AES_BLOCKLEN);
+		// The round keys are expanded once in init, only the IV is reset.
+		AES_ctx_set_iv(&(st->ctx), conf->iv);
+		AES_CBC_encrypt_buffer(&(st->ctx), data, len);
+		AES_ctx_set_iv(&(st->ctx), conf->iv);
+		AES_CBC_decrypt_buffer(&(st->ctx), data, len);
+	}
+	rte_node_next_stream_move(graph, node, FFPP_GRAPH_EDGE_NEXT);
+	return nb_objs;
+}
+
+static int aes_init(const struct rte_graph *graph, struct rte_node *node)
+{
+	struct aes_ctx *ctx = (struct aes_ctx *)node->ctx;
+	const struct graph_node *data = node_data(node);
+	struct aes_state *st;
+
+	RTE_BUILD_BUG_ON(sizeof(struct aes_ctx) > RTE_NODE_CTX_SZ);
+	if (data == NULL) {
+		return -EINVAL;
+	}
+	st = rte_zmalloc_socket("ffpp_graph_aes", sizeof(*st),
+				RTE_CACHE_LINE_SIZE, graph->socket);
+	if (st == NULL) {
+		return -ENOMEM;
+	}
+	st->conf = &(data->conf->aes);
+	AES_init_ctx_iv(&(st->ctx), st->conf->key, st->conf->iv);
+	ctx->state = st;
+	return 0;
+}
+
+static void aes_fini(const struct rte_graph *graph, struct rte_node *node)
+{
+	struct aes_ctx *ctx = (struct aes_ctx *)node->ctx;
+
+	RTE_SET_USED(graph);
+	rte_free(ctx->state);
+	ctx->state = NULL;
+}
+
+static struct rte_node_register aes_node = {
+	.name = "ffpp_aes",
+	.process = aes_process,
+	.init = aes_init,
+	.fini = aes_fini,
+	.nb_edges = 1,
+	.next_nodes = { "ffpp_drop" },
+};
+
+RTE_NODE_REGISTER(aes_node);
+
+/* MuNF ring endpoints */
+
+static int ring_init(const struct rte_graph *graph, struct rte_node *node)
+{
+	struct ring_ctx *ctx = (struct ring_ctx *)node->ctx;
+	const struct graph_node *data = node_data(node);
+
+	RTE_BUILD_BUG_ON(sizeof(struct ring_ctx) > RTE_NODE_CTX_SZ);
+	RTE_SET_USED(graph);
+	if (data == NULL) {
+		return -EINVAL;
+	}
+	ctx->ring = data->ring;
+	ctx->burst_size = data->vnf->cfg.burst_size;
+	return 0;
+}
+
+/* Send the packets to the RX ring of the MuNF. */
+static uint16_t munf_tx_process(struct rte_graph *graph, struct rte_node *node,
+				void **objs, uint16_t nb_objs)
+{
+	const struct ring_ctx *ctx = (const struct ring_ctx *)node->ctx;
+	unsigned int n;
+
+	n = rte_ring_sp_enqueue_burst(ctx->ring, objs, nb_objs, NULL);
+	if (unlikely(n < nb_objs)) {
+		rte_node_enqueue(graph, node, FFPP_GRAPH_EDGE_DROP, &objs[n],
+				 nb_objs - n);
+	}
+	return n;
+}
+
+static struct rte_node_register munf_tx_node = {
+	.name = "ffpp_munf_tx",
+	.process = munf_tx_process,
+	.init = ring_init,
+	.nb_edges = 1,
+	.next_nodes = { "ffpp_drop" },
+};
+
+RTE_NODE_REGISTER(munf_tx_node);
+
+/* Receive the packets processed by the MuNF from its TX ring. */
+static uint16_t munf_rx_process(struct rte_graph *graph, struct rte_node *node,
+				void **objs, uint16_t nb_objs)
+{
+	const struct ring_ctx *ctx = (const struct ring_ctx *)node->ctx;
+	unsigned int n;
+
+	RTE_SET_USED(objs);
+	RTE_SET_USED(nb_objs);
+
+	n = rte_ring_sc_dequeue_burst(ctx->ring, node->objs, ctx->burst_size,
+				      NULL);
+	if (n == 0) {
+		return 0;
+	}
+	node->idx = n;
+	rte_node_next_stream_move(graph, node, FFPP_GRAPH_EDGE_NEXT);
+	return n;
+}
+
+static struct rte_node_register munf_rx_node = {
+	.name = "ffpp_munf_rx",
+	.flags = RTE_NODE_SOURCE_F,
+	.process = munf_rx_process,
+	.init = ring_init,
+	.nb_edges = 1,
+	.next_nodes = { "ffpp_drop" },
+};
+
+RTE_NODE_REGISTER(munf_rx_node);
+
+/* VNFs */
+
+static const char *proc_parent_name(enum ffpp_graph_node_type type)
+{
+	switch (type) {
+	case FFPP_GRAPH_NODE_HANDLER:
+		return handler_node.name;
+	case FFPP_GRAPH_NODE_REWRITE_DL:
+		return rewrite_dl_node.name;
+	case FFPP_GRAPH_NODE_UPDATE_DL_SRC:
+		return update_dl_src_node.name;
+	case FFPP_GRAPH_NODE_DEC_TTL:
+		return dec_ttl_node.name;
+	case FFPP_GRAPH_NODE_AES:
+		return aes_node.name;
+	case FFPP_GRAPH_NODE_MUNF:
+		return munf_tx_node.name;
+	default:
+		return NULL;
+	}
+}
+
+static int check_graph_config(const struct ffpp_graph_config *cfg)
+{
+	uint16_t i;
+
+	if (cfg->name[0] == '\0' ||
+	    strnlen(cfg->name, FFPP_GRAPH_NAME_MAX_LEN) ==
+		    FFPP_GRAPH_NAME_MAX_LEN) {
+		RTE_LOG(ERR, FFPP, "Invalid name of the VNF.\n");
+		return -1;
+	}
+	if (cfg->nb_ports == 0 || cfg->nb_ports > FFPP_MAX_PORTS) {
+		RTE_LOG(ERR, FFPP, "Graphs support 1 to %d ports.\n",
+			FFPP_MAX_PORTS);
+		return -1;
+	}
+	if (cfg->nb_rx_queues == 0 ||
+	    cfg->nb_rx_queues > FFPP_MAX_QUEUES_PER_PORT ||
+	    cfg->nb_tx_queues == 0 ||
+	    cfg->nb_tx_queues > FFPP_MAX_QUEUES_PER_PORT) {
+		RTE_LOG(ERR, FFPP, "Graphs support 1 to %d queues per port.\n",
+			FFPP_MAX_QUEUES_PER_PORT);
+		return -1;
+	}
+	if (cfg->burst_size > RTE_GRAPH_BURST_SIZE) {
+		RTE_LOG(ERR, FFPP, "The maximal burst size is %d.\n",
+			RTE_GRAPH_BURST_SIZE);
+		return -1;
+	}
+	if (cfg->nb_nodes > FFPP_GRAPH_MAX_NODES) {
+		RTE_LOG(ERR, FFPP, "Graphs support up to %d nodes.\n",
+			FFPP_GRAPH_MAX_NODES);
+		return -1;
+	}
+	for (i = 0; i < cfg->nb_nodes; ++i) {
+		if (proc_parent_name(cfg->nodes[i].type) == NULL ||
+		    (cfg->nodes[i].type == FFPP_GRAPH_NODE_HANDLER &&
+		     cfg->nodes[i].handler.func == NULL)) {
+			RTE_LOG(ERR, FFPP, "Invalid node %u.\n", i);
+			return -1;
+		}
+	}
+	for (i = 0; i < cfg->nb_ports; ++i) {
+		if (!rte_eth_dev_is_valid_port(cfg->port_ids[i]) ||
+		    cfg->tx_port_map[i] >= cfg->nb_ports) {
+			RTE_LOG(ERR, FFPP, "Invalid port or TX port map: %u.\n",
+				cfg->port_ids[i]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Clone the parent node as "<parent>-<suffix>" or reuse the clone of an
+ * earlier VNF with the same name.
+ */
+static int clone_node(struct graph_node *n, struct ffpp_graph_vnf *vnf,
+		      const char *parent, const char *suffix)
+{
+	rte_node_t parent_id = rte_node_from_name(parent);
+
+	snprintf(n->name, sizeof(n->name), "%s-%s", parent, suffix);
+	n->vnf = vnf;
+	n->id = rte_node_from_name(n->name);
+	if (n->id == RTE_NODE_ID_INVALID) {
+		n->id = rte_node_clone(parent_id, suffix);
+	}
+	if (n->id == RTE_NODE_ID_INVALID || n->id >= GRAPH_NODE_ID_MAX) {
+		RTE_LOG(ERR, FFPP, "Can not clone the node %s.\n", n->name);
+		return -1;
+	}
+	node_table[n->id] = n;
+	return 0;
+}
+
+/* Set the edges after the drop edge, edges of an older clone are removed. */
+static int set_next_nodes(const struct graph_node *n, const char **next_nodes,
+			  uint16_t nb_next)
+{
+	// Returns the number of updated edges.
+	if (rte_node_edge_update(n->id, FFPP_GRAPH_EDGE_NEXT, next_nodes,
+				 nb_next) != nb_next ||
+	    rte_node_edge_shrink(n->id, FFPP_GRAPH_EDGE_NEXT + nb_next) ==
+		    RTE_EDGE_ID_INVALID) {
+		RTE_LOG(ERR, FFPP, "Can not set the edges of the node %s.\n",
+			n->name);
+		return -1;
+	}
+	return 0;
+}
+
+/* The MuNF TX node is the entry, the MuNF RX node continues with next. */
+static int build_munf_nodes(struct ffpp_graph_vnf *vnf, uint16_t i,
+			    const char *suffix, const char *next)
+{
+	const struct ffpp_munf_data *munf = &(vnf->cfg.nodes[i].munf);
+	struct graph_node *tx = &(vnf->proc_nodes[i]);
+	struct graph_node *rx = &(vnf->munf_rx_nodes[i]);
+
+	tx->ring = rte_ring_lookup(munf->rx_ring_name);
+	rx->ring = rte_ring_lookup(munf->tx_ring_name);
+	if (tx->ring == NULL || rx->ring == NULL) {
+		RTE_LOG(ERR, FFPP, "Can not find the rings of the MuNF.\n");
+		return -1;
+	}
+	if (clone_node(tx, vnf, munf_tx_node.name, suffix) < 0 ||
+	    set_next_nodes(tx, NULL, 0) < 0 ||
+	    clone_node(rx, vnf, munf_rx_node.name, suffix) < 0 ||
+	    set_next_nodes(rx, &next, 1) < 0) {
+		return -1;
+	}
+	return 0;
+}
+
+static int build_nodes(struct ffpp_graph_vnf *vnf)
+{
+	const struct ffpp_graph_config *cfg = &(vnf->cfg);
+	const char *tx_names[FFPP_MAX_PORTS];
+	char suffix[RTE_NODE_NAMESIZE];
+	const char *next;
+	struct graph_node *n;
+	uint16_t p, q;
+	int i;
+
+	for (p = 0; p < cfg->nb_ports; ++p) {
+		snprintf(suffix, sizeof(suffix), "%s_%u", cfg->name, p);
+		n = &(vnf->tx_nodes[p]);
+		n->port_idx = p;
+		if (clone_node(n, vnf, eth_tx_node.name, suffix) < 0 ||
+		    set_next_nodes(n, NULL, 0) < 0) {
+			return -1;
+		}
+		tx_names[p] = n->name;
+	}
+
+	n = &(vnf->classify_node);
+	if (clone_node(n, vnf, classify_node.name, cfg->name) < 0 ||
+	    set_next_nodes(n, tx_names, cfg->nb_ports) < 0) {
+		return -1;
+	}
+
+	// From the last processing node back to the first one.
+	next = vnf->classify_node.name;
+	for (i = cfg->nb_nodes - 1; i >= 0; --i) {
+		snprintf(suffix, sizeof(suffix), "%s_%d", cfg->name, i);
+		n = &(vnf->proc_nodes[i]);
+		n->conf = &(cfg->nodes[i]);
+		if (cfg->nodes[i].type == FFPP_GRAPH_NODE_MUNF) {
+			if (build_munf_nodes(vnf, i, suffix, next) < 0) {
+				return -1;
+			}
+		} else if (clone_node(n, vnf,
+				      proc_parent_name(cfg->nodes[i].type),
+				      suffix) < 0 ||
+			   set_next_nodes(n, &next, 1) < 0) {
+			return -1;
+		}
+		next = n->name;
+	}
+
+	for (q = 0; q < cfg->nb_rx_queues; ++q) {
+		for (p = 0; p < cfg->nb_ports; ++p) {
+			snprintf(suffix, sizeof(suffix), "%s_%u_%u", cfg->name,
+				 p, q);
+			n = &(vnf->rx_nodes[vnf->nb_rx_nodes++]);
+			n->port_idx = p;
+			n->queue_id = q;
+			if (clone_node(n, vnf, eth_rx_node.name, suffix) < 0 ||
+			    set_next_nodes(n, &next, 1) < 0) {
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * Like the run-to-completion mode of the worker runtime, the RX nodes are
+ * sorted by queue first and split in contiguous chunks.
+ */
+static uint16_t assign_rx_nodes(struct ffpp_graph_vnf *vnf,
+				const unsigned int *lcores,
+				unsigned int nb_lcores)
+{
+	unsigned int chunk = (vnf->nb_rx_nodes + nb_lcores - 1) / nb_lcores;
+	struct vnf_graph *vg;
+	uint16_t k;
+
+	for (k = 0; k < vnf->nb_rx_nodes; ++k) {
+		vg = &(vnf->graphs[k / chunk]);
+		vg->lcore_id = lcores[k / chunk];
+		vg->rx_nodes[vg->nb_rx_nodes++] = k;
+	}
+	return (vnf->nb_rx_nodes + chunk - 1) / chunk;
+}
+
+static int create_graph(struct ffpp_graph_vnf *vnf, uint16_t idx)
+{
+	const struct ffpp_graph_config *cfg = &(vnf->cfg);
+	struct vnf_graph *vg = &(vnf->graphs[idx]);
+	const char *patterns[GRAPH_MAX_PATTERNS];
+	struct rte_graph_param prm;
+	uint16_t nb = 0;
+	uint16_t i;
+
+	for (i = 0; i < vg->nb_rx_nodes; ++i) {
+		patterns[nb++] = vnf->rx_nodes[vg->rx_nodes[i]].name;
+	}
+	for (i = 0; i < cfg->nb_nodes; ++i) {
+		patterns[nb++] = vnf->proc_nodes[i].name;
+		if (cfg->nodes[i].type == FFPP_GRAPH_NODE_MUNF) {
+			patterns[nb++] = vnf->munf_rx_nodes[i].name;
+		}
+	}
+	patterns[nb++] = vnf->classify_node.name;
+	for (i = 0; i < cfg->nb_ports; ++i) {
+		patterns[nb++] = vnf->tx_nodes[i].name;
+	}
+	patterns[nb++] = drop_node.name;
+
+	snprintf(vg->name, sizeof(vg->name), "ffpp_%s_%u", cfg->name,
+		 vg->lcore_id);
+	vg->vnf = vnf;
+	memset(&prm, 0, sizeof(prm));
+	prm.socket_id = rte_lcore_to_socket_id(vg->lcore_id);
+	prm.nb_node_patterns = nb;
+	prm.node_patterns = patterns;
+
+	// The node init functions run in rte_graph_create().
+	vnf->tx_queue = idx;
+	vg->id = rte_graph_create(vg->name, &prm);
+	if (vg->id == RTE_GRAPH_ID_INVALID) {
+		RTE_LOG(ERR, FFPP, "Can not create the graph %s.\n", vg->name);
+		return -1;
+	}
+	vg->graph = rte_graph_lookup(vg->name);
+	return vg->graph == NULL ? -1 : 0;
+}
+
+struct ffpp_graph_vnf *
+ffpp_graph_vnf_create(const struct ffpp_graph_config *cfg)
+{
+	struct ffpp_graph_vnf *vnf;
+	unsigned int lcores[RTE_MAX_LCORE];
+	unsigned int nb_lcores = 0;
+	unsigned int lcore_id;
+	uint16_t i;
+
+	if (check_graph_config(cfg) < 0) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+
+	vnf = rte_zmalloc("ffpp_graph_vnf", sizeof(*vnf), RTE_CACHE_LINE_SIZE);
+	if (vnf == NULL) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	vnf->cfg = *cfg;
+	if (vnf->cfg.burst_size == 0) {
+		vnf->cfg.burst_size = FFPP_GRAPH_RX_BURST_DEFAULT;
+	}
+	for (i = 0; i < cfg->nb_ports; ++i) {
+		vnf->port_idx[cfg->port_ids[i]] = i;
+	}
+	for (i = 0; i < cfg->nb_nodes; ++i) {
+		if (cfg->nodes[i].type == FFPP_GRAPH_NODE_MUNF) {
+			vnf->has_munf = true;
+		}
+	}
+
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		lcores[nb_lcores++] = lcore_id;
+	}
+	if (cfg->nb_lcores > 0) {
+		nb_lcores = RTE_MIN(nb_lcores, (unsigned int)cfg->nb_lcores);
+	}
+	nb_lcores = RTE_MIN(nb_lcores, (unsigned int)cfg->nb_tx_queues);
+	if (vnf->has_munf) {
+		nb_lcores = RTE_MIN(nb_lcores, 1U);
+	}
+	if (nb_lcores == 0) {
+		RTE_LOG(ERR, FFPP, "No worker lcore is available.\n");
+		rte_free(vnf);
+		rte_errno = EINVAL;
+		return NULL;
+	}
+
+	if (build_nodes(vnf) < 0) {
+		ffpp_graph_vnf_destroy(vnf);
+		rte_errno = EINVAL;
+		return NULL;
+	}
+	vnf->nb_graphs = assign_rx_nodes(vnf, lcores, nb_lcores);
+	for (i = 0; i < vnf->nb_graphs; ++i) {
+		vnf->graphs[i].id = RTE_GRAPH_ID_INVALID;
+	}
+	for (i = 0; i < vnf->nb_graphs; ++i) {
+		if (create_graph(vnf, i) < 0) {
+			ffpp_graph_vnf_destroy(vnf);
+			rte_errno = ENOMEM;
+			return NULL;
+		}
+		RTE_LOG(INFO, FFPP, "Graph %s polls %u RX queues.\n",
+			vnf->graphs[i].name, vnf->graphs[i].nb_rx_nodes);
+	}
+
+	return vnf;
+}
+
+static int graph_main(void *arg)
+{
+	struct vnf_graph *vg = arg;
+	struct rte_graph *graph = vg->graph;
+	const struct ffpp_graph_vnf *vnf = vg->vnf;
+
+	while (!vnf->stop) {
+		rte_graph_walk(graph);
+	}
+	return 0;
+}
+
+int ffpp_graph_vnf_launch(struct ffpp_graph_vnf *vnf)
+{
+	uint16_t i;
+
+	vnf->stop = false;
+	rte_smp_wmb();
+	for (i = 0; i < vnf->nb_graphs; ++i) {
+		if (rte_eal_remote_launch(graph_main, &(vnf->graphs[i]),
+					  vnf->graphs[i].lcore_id) < 0) {
+			RTE_LOG(ERR, FFPP, "Cannot launch graph on core:%u\n",
+				vnf->graphs[i].lcore_id);
+			ffpp_graph_vnf_stop(vnf);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void ffpp_graph_vnf_stop(struct ffpp_graph_vnf *vnf)
+{
+	uint16_t i;
+
+	vnf->stop = true;
+	rte_smp_wmb();
+	for (i = 0; i < vnf->nb_graphs; ++i) {
+		rte_eal_wait_lcore(vnf->graphs[i].lcore_id);
+	}
+}
+
+uint16_t ffpp_graph_vnf_nb_graphs(const struct ffpp_graph_vnf *vnf)
+{
+	return vnf->nb_graphs;
+}
+
+struct rte_graph *ffpp_graph_vnf_get_graph(const struct ffpp_graph_vnf *vnf,
+					   uint16_t idx)
+{
+	if (idx >= vnf->nb_graphs) {
+		return NULL;
+	}
+	return vnf->graphs[idx].graph;
+}
+
+static int sum_node_stats(bool is_first, bool is_last, void *cookie,
+			  const struct rte_graph_cluster_node_stats *st)
+{
+	struct ffpp_graph_stats *stats = cookie;
+
+	RTE_SET_USED(is_first);
+	RTE_SET_USED(is_last);
+
+	if (strncmp(st->name, eth_rx_node.name, strlen(eth_rx_node.name)) ==
+	    0) {
+		stats->rx_pkts += st->objs;
+	} else if (strncmp(st->name, eth_tx_node.name,
+			   strlen(eth_tx_node.name)) == 0) {
+		stats->tx_pkts += st->objs;
+	} else if (strcmp(st->name, drop_node.name) == 0) {
+		stats->dropped += st->objs;
+	}
+	return 0;
+}
+
+static struct rte_graph_cluster_stats *
+create_cluster_stats(const struct ffpp_graph_vnf *vnf,
+		     rte_graph_cluster_stats_cb_t fn, void *cookie)
+{
+	const char *patterns[RTE_MAX_LCORE];
+	struct rte_graph_cluster_stats_param prm;
+	uint16_t i;
+
+	for (i = 0; i < vnf->nb_graphs; ++i) {
+		patterns[i] = vnf->graphs[i].name;
+	}
+	memset(&prm, 0, sizeof(prm));
+	prm.socket_id = SOCKET_ID_ANY;
+	prm.fn = fn;
+	if (fn == NULL) {
+		prm.f = stdout;
+	} else {
+		prm.cookie = cookie;
+	}
+	prm.nb_graph_patterns = vnf->nb_graphs;
+	prm.graph_patterns = patterns;
+	return rte_graph_cluster_stats_create(&prm);
+}
+
+int ffpp_graph_vnf_get_stats(const struct ffpp_graph_vnf *vnf,
+			     struct ffpp_graph_stats *stats)
+{
+	struct rte_graph_cluster_stats *cs;
+
+	memset(stats, 0, sizeof(*stats));
+	cs = create_cluster_stats(vnf, sum_node_stats, stats);
+	if (cs == NULL) {
+		return -1;
+	}
+	rte_graph_cluster_stats_get(cs, false);
+	rte_graph_cluster_stats_destroy(cs);
+	return 0;
+}
+
+void ffpp_graph_vnf_print_stats(const struct ffpp_graph_vnf *vnf)
+{
+	struct rte_graph_cluster_stats *cs;
+
+	cs = create_cluster_stats(vnf, NULL, NULL);
+	if (cs == NULL) {
+		RTE_LOG(ERR, FFPP, "Can not get the graph stats.\n");
+		return;
+	}
+	rte_graph_cluster_stats_get(cs, false);
+	rte_graph_cluster_stats_destroy(cs);
+}
+
+static void release_node(struct graph_node *n)
+{
+	if (n->vnf != NULL && n->id < GRAPH_NODE_ID_MAX &&
+	    node_table[n->id] == n) {
+		node_table[n->id] = NULL;
+	}
+}
+
+void ffpp_graph_vnf_destroy(struct ffpp_graph_vnf *vnf)
+{
+	uint16_t i;
+
+	if (vnf == NULL) {
+		return;
+	}
+	for (i = 0; i < vnf->nb_graphs; ++i) {
+		if (vnf->graphs[i].id != RTE_GRAPH_ID_INVALID) {
+			rte_graph_destroy(vnf->graphs[i].id);
+		}
+	}
+	for (i = 0; i < GRAPH_MAX_RXQS; ++i) {
+		release_node(&(vnf->rx_nodes[i]));
+	}
+	for (i = 0; i < FFPP_GRAPH_MAX_NODES; ++i) {
+		release_node(&(vnf->proc_nodes[i]));
+		release_node(&(vnf->munf_rx_nodes[i]));
+	}
+	release_node(&(vnf->classify_node));
+	for (i = 0; i < FFPP_MAX_PORTS; ++i) {
+		release_node(&(vnf->tx_nodes[i]));
+	}
+	rte_free(vnf);
+}
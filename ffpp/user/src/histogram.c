@@ -0,0 +1,237 @@
+/*
+ * histogram.c
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include <rte_common.h>
+#include <rte_errno.h>
+#include <rte_malloc.h>
+
+#include <ffpp/histogram.h>
+
+#define HIST_MAGIC 0x46464831 /* "FFH1" */
+
+/* Encoding of ffpp_hist_serialize(), all integers in host byte order. */
+struct hist_enc_hdr {
+	uint32_t magic;
+	uint16_t sub_bits;
+	uint16_t reserved;
+	uint32_t nb_entries;
+	uint32_t reserved2;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+};
+
+struct hist_enc_entry {
+	uint32_t idx;
+	uint32_t reserved;
+	uint64_t count;
+};
+
+/* Highest value that falls into bucket idx. */
+static uint64_t bucket_upper(uint32_t idx)
+{
+	uint32_t shift, top;
+
+	if (idx < FFPP_HIST_LINEAR_MAX) {
+		return idx;
+	}
+	shift = (idx >> (FFPP_HIST_SUB_BITS - 1)) - 1;
+	top = idx - (shift << (FFPP_HIST_SUB_BITS - 1));
+	// Wraps to UINT64_MAX for the last bucket.
+	return ((uint64_t)(top + 1) << shift) - 1;
+}
+
+void ffpp_hist_init(struct ffpp_hist *h)
+{
+	memset(h, 0, sizeof(*h));
+	h->min = UINT64_MAX;
+}
+
+struct ffpp_hist *ffpp_hist_create(int socket_id)
+{
+	struct ffpp_hist *h;
+
+	h = rte_malloc_socket("ffpp_hist", sizeof(*h), RTE_CACHE_LINE_SIZE,
+			      socket_id);
+	if (h == NULL) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	ffpp_hist_init(h);
+	return h;
+}
+
+void ffpp_hist_free(struct ffpp_hist *h)
+{
+	rte_free(h);
+}
+
+void ffpp_hist_reset(struct ffpp_hist *h)
+{
+	uint32_t i;
+
+	__atomic_store_n(&h->count, 0, __ATOMIC_RELAXED);
+	for (i = 0; i < FFPP_HIST_NB_BUCKETS; ++i) {
+		__atomic_store_n(&h->buckets[i], 0, __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&h->sum, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&h->min, UINT64_MAX, __ATOMIC_RELAXED);
+	__atomic_store_n(&h->max, 0, __ATOMIC_RELAXED);
+}
+
+void ffpp_hist_merge(struct ffpp_hist *dst, const struct ffpp_hist *src)
+{
+	uint64_t count = 0;
+	uint64_t n, v;
+	uint32_t i;
+
+	for (i = 0; i < FFPP_HIST_NB_BUCKETS; ++i) {
+		n = __atomic_load_n(&src->buckets[i], __ATOMIC_RELAXED);
+		dst->buckets[i] += n;
+		count += n;
+	}
+	dst->count += count;
+	dst->sum += __atomic_load_n(&src->sum, __ATOMIC_RELAXED);
+	v = __atomic_load_n(&src->min, __ATOMIC_RELAXED);
+	dst->min = RTE_MIN(dst->min, v);
+	v = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+	dst->max = RTE_MAX(dst->max, v);
+}
+
+void ffpp_hist_snapshot(const struct ffpp_hist *h, struct ffpp_hist *snap)
+{
+	ffpp_hist_init(snap);
+	ffpp_hist_merge(snap, h);
+}
+
+uint64_t ffpp_hist_quantile(const struct ffpp_hist *h, double q)
+{
+	uint64_t target, cum = 0;
+	uint32_t i;
+
+	if (h->count == 0) {
+		return 0;
+	}
+	q = RTE_MAX(0.0, RTE_MIN(q, 1.0));
+	target = RTE_MAX((uint64_t)ceil(q * h->count), (uint64_t)1);
+	for (i = 0; i < FFPP_HIST_NB_BUCKETS; ++i) {
+		cum += h->buckets[i];
+		if (cum >= target) {
+			return RTE_MIN(bucket_upper(i), h->max);
+		}
+	}
+	return h->max;
+}
+
+void ffpp_hist_summarize(const struct ffpp_hist *h,
+			 struct ffpp_hist_summary *s)
+{
+	s->count = h->count;
+	s->mean = h->count > 0 ? (double)h->sum / h->count : 0.0;
+	s->min = h->count > 0 ? h->min : 0;
+	s->p50 = ffpp_hist_quantile(h, 0.5);
+	s->p99 = ffpp_hist_quantile(h, 0.99);
+	s->p999 = ffpp_hist_quantile(h, 0.999);
+	s->max = h->max;
+}
+
+void ffpp_hist_print(FILE *f, const char *name, const struct ffpp_hist *h,
+		     uint64_t tsc_hz)
+{
+	struct ffpp_hist_summary s;
+	double scale = tsc_hz > 0 ? 1e6 / tsc_hz : 1.0;
+
+	ffpp_hist_summarize(h, &s);
+	fprintf(f, "%s,%lu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", name, s.count,
+		s.mean * scale, s.min * scale, s.p50 * scale, s.p99 * scale,
+		s.p999 * scale, s.max * scale);
+}
+
+static uint32_t nb_used_buckets(const struct ffpp_hist *h)
+{
+	uint32_t n = 0;
+	uint32_t i;
+
+	for (i = 0; i < FFPP_HIST_NB_BUCKETS; ++i) {
+		n += h->buckets[i] != 0;
+	}
+	return n;
+}
+
+size_t ffpp_hist_serialized_size(const struct ffpp_hist *h)
+{
+	return sizeof(struct hist_enc_hdr) +
+	       nb_used_buckets(h) * sizeof(struct hist_enc_entry);
+}
+
+int ffpp_hist_serialize(const struct ffpp_hist *h, void *buf, size_t len)
+{
+	struct hist_enc_hdr hdr;
+	struct hist_enc_entry e;
+	uint8_t *p = buf;
+	uint32_t i;
+
+	if (len < ffpp_hist_serialized_size(h)) {
+		return -ENOSPC;
+	}
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = HIST_MAGIC;
+	hdr.sub_bits = FFPP_HIST_SUB_BITS;
+	hdr.nb_entries = nb_used_buckets(h);
+	hdr.sum = h->sum;
+	hdr.min = h->min;
+	hdr.max = h->max;
+	memcpy(p, &hdr, sizeof(hdr));
+	p += sizeof(hdr);
+
+	memset(&e, 0, sizeof(e));
+	for (i = 0; i < FFPP_HIST_NB_BUCKETS; ++i) {
+		if (h->buckets[i] == 0) {
+			continue;
+		}
+		e.idx = i;
+		e.count = h->buckets[i];
+		memcpy(p, &e, sizeof(e));
+		p += sizeof(e);
+	}
+	return p - (uint8_t *)buf;
+}
+
+int ffpp_hist_deserialize(struct ffpp_hist *h, const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+	struct hist_enc_hdr hdr;
+	struct hist_enc_entry e;
+	uint32_t i;
+
+	if (len < sizeof(hdr)) {
+		return -EINVAL;
+	}
+	memcpy(&hdr, p, sizeof(hdr));
+	p += sizeof(hdr);
+	if (hdr.magic != HIST_MAGIC || hdr.sub_bits != FFPP_HIST_SUB_BITS ||
+	    len < sizeof(hdr) + (size_t)hdr.nb_entries * sizeof(e)) {
+		return -EINVAL;
+	}
+
+	ffpp_hist_init(h);
+	for (i = 0; i < hdr.nb_entries; ++i) {
+		memcpy(&e, p, sizeof(e));
+		p += sizeof(e);
+		if (e.idx >= FFPP_HIST_NB_BUCKETS) {
+			ffpp_hist_init(h);
+			return -EINVAL;
+		}
+		h->buckets[e.idx] += e.count;
+		h->count += e.count;
+	}
+	h->sum = hdr.sum;
+	h->min = hdr.min;
+	h->max = hdr.max;
+	return 0;
+}
@@ -46,10 +46,7 @@ void dpdk_recv_into(uint16_t port_id, uint16_t queue_id,
 
 void dpdk_free_buf(struct rte_mbuf **buf, uint16_t buf_size)
 {
-	uint16_t i = 0;
-	for (i = 0; i < buf_size; ++i) {
-		rte_pktmbuf_free(*(buf + i));
-	}
+	rte_pktmbuf_free_bulk(buf, buf_size);
 }
 
 /**************************
@@ -0,0 +1,251 @@
+/*
+ * ip_frag.c
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_ether.h>
+#include <rte_ethdev.h>
+#include <rte_ip.h>
+#include <rte_ip_frag.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+
+#include <ffpp/ip_frag.h>
+
+#define VLAN_HDR_LEN (sizeof(struct rte_vlan_hdr))
+#define L2_HDR_MAX_LEN (RTE_ETHER_HDR_LEN + VLAN_HDR_LEN)
+// Minimal MTU of IPv4 (RFC 791).
+#define IPV4_MTU_MIN 68
+#define FRAG_TBL_BUCKET_ENTRIES 16
+#define DEATH_ROW_PREFETCH 3
+// One reassembly adds at most all fragments of a datagram and the current one
+// to the death row.
+#define DEATH_ROW_FULL \
+	(IP_FRAG_DEATH_ROW_MBUF_LEN - RTE_LIBRTE_IP_FRAG_MAX_FRAG - 1)
+
+struct ffpp_ip_frag {
+	struct ffpp_ip_frag_config cfg;
+	struct rte_ip_frag_tbl *tbl;
+	struct rte_ip_frag_death_row dr;
+	struct ffpp_ip_frag_stats stats;
+};
+
+struct ffpp_ip_frag *ffpp_ip_frag_create(const struct ffpp_ip_frag_config *cfg)
+{
+	struct ffpp_ip_frag *ctx;
+	uint64_t timeout_cycles;
+
+	if (cfg->direct_pool == NULL || cfg->indirect_pool == NULL ||
+	    (cfg->mtu != 0 && cfg->mtu < IPV4_MTU_MIN)) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+
+	ctx = rte_zmalloc_socket("ffpp_ip_frag", sizeof(*ctx),
+				 RTE_CACHE_LINE_SIZE, cfg->socket_id);
+	if (ctx == NULL) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	ctx->cfg = *cfg;
+	if (ctx->cfg.mtu == 0) {
+		ctx->cfg.mtu = RTE_ETHER_MTU;
+	}
+	if (ctx->cfg.max_flows == 0) {
+		ctx->cfg.max_flows = FFPP_IP_FRAG_MAX_FLOWS_DEFAULT;
+	}
+	if (ctx->cfg.timeout_ms == 0) {
+		ctx->cfg.timeout_ms = FFPP_IP_FRAG_TIMEOUT_MS_DEFAULT;
+	}
+
+	timeout_cycles = (rte_get_tsc_hz() + MS_PER_S - 1) / MS_PER_S *
+			 ctx->cfg.timeout_ms;
+	ctx->tbl = rte_ip_frag_table_create(
+		ctx->cfg.max_flows, FRAG_TBL_BUCKET_ENTRIES, ctx->cfg.max_flows,
+		timeout_cycles, cfg->socket_id);
+	if (ctx->tbl == NULL) {
+		rte_free(ctx);
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	return ctx;
+}
+
+void ffpp_ip_frag_free(struct ffpp_ip_frag *ctx)
+{
+	if (ctx == NULL) {
+		return;
+	}
+	rte_ip_frag_free_death_row(&ctx->dr, 0);
+	rte_ip_frag_table_destroy(ctx->tbl);
+	rte_free(ctx);
+}
+
+/* Length of the L2 header of an IPv4 packet, 0 for other packets. */
+static uint16_t ipv4_l2_len(const struct rte_mbuf *m)
+{
+	const struct rte_ether_hdr *eth;
+	uint16_t data_len = rte_pktmbuf_data_len(m);
+	uint16_t len = RTE_ETHER_HDR_LEN;
+	uint16_t type;
+
+	if (unlikely(data_len < len)) {
+		return 0;
+	}
+	eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+	type = eth->ether_type;
+	if (type == RTE_BE16(RTE_ETHER_TYPE_VLAN)) {
+		if (unlikely(data_len < len + VLAN_HDR_LEN)) {
+			return 0;
+		}
+		type = ((const struct rte_vlan_hdr *)(eth + 1))->eth_proto;
+		len += VLAN_HDR_LEN;
+	}
+	// An untagged packet can be shorter than the longest L2 header.
+	if (type != RTE_BE16(RTE_ETHER_TYPE_IPV4) ||
+	    unlikely(data_len < len + sizeof(struct rte_ipv4_hdr))) {
+		return 0;
+	}
+	return len;
+}
+
+static __rte_always_inline uint16_t ipv4_hdr_len(const struct rte_ipv4_hdr *ip)
+{
+	return (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) *
+	       RTE_IPV4_IHL_MULTIPLIER;
+}
+
+/* Add the L2 header and the IPv4 checksum to a new fragment. */
+static void finish_fragment(const struct ffpp_ip_frag *ctx, struct rte_mbuf *m,
+			    const uint8_t *l2_hdr, uint16_t l2_len)
+{
+	struct rte_ipv4_hdr *ip;
+	char *hdr;
+
+	// The fragment header is a direct mbuf with the default headroom.
+	hdr = rte_pktmbuf_prepend(m, l2_len);
+	memcpy(hdr, l2_hdr, l2_len);
+	ip = (struct rte_ipv4_hdr *)(hdr + l2_len);
+	m->l2_len = l2_len;
+	m->l3_len = ipv4_hdr_len(ip);
+	m->ol_flags &= ~(PKT_TX_L4_MASK | PKT_TX_IP_CKSUM | PKT_TX_IPV4);
+	ip->hdr_checksum = 0;
+	if (ctx->cfg.tx_offloads & DEV_TX_OFFLOAD_IPV4_CKSUM) {
+		m->ol_flags |= PKT_TX_IPV4 | PKT_TX_IP_CKSUM;
+	} else {
+		ip->hdr_checksum = rte_ipv4_cksum(ip);
+	}
+}
+
+uint16_t ffpp_ip_fragment(struct ffpp_ip_frag *ctx, struct ffpp_mvec *in,
+			  struct ffpp_mvec *out)
+{
+	uint8_t l2_hdr[L2_HDR_MAX_LEN];
+	struct rte_mbuf *m;
+	uint16_t nb_out = 0;
+	uint16_t l2_len, room, i;
+	int32_t n, j;
+
+	for (i = 0; i < in->len; ++i) {
+		m = in->head[i];
+		room = out->capacity - nb_out;
+		l2_len = ipv4_l2_len(m);
+		if (l2_len == 0 ||
+		    rte_pktmbuf_pkt_len(m) - l2_len <= ctx->cfg.mtu) {
+			if (unlikely(room == 0)) {
+				rte_pktmbuf_free(m);
+				ctx->stats.frag_drops++;
+				continue;
+			}
+			out->head[nb_out++] = m;
+			continue;
+		}
+
+		memcpy(l2_hdr, rte_pktmbuf_mtod(m, uint8_t *), l2_len);
+		rte_pktmbuf_adj(m, l2_len);
+		n = rte_ipv4_fragment_packet(m, out->head + nb_out, room,
+					     ctx->cfg.mtu, ctx->cfg.direct_pool,
+					     ctx->cfg.indirect_pool);
+		// The fragments hold a reference to the data.
+		rte_pktmbuf_free(m);
+		if (unlikely(n < 0)) {
+			ctx->stats.frag_drops++;
+			continue;
+		}
+		for (j = 0; j < n; ++j) {
+			finish_fragment(ctx, out->head[nb_out + j], l2_hdr,
+					l2_len);
+		}
+		nb_out += n;
+		ctx->stats.fragmented++;
+		ctx->stats.fragments += n;
+	}
+	in->len = 0;
+	out->len = nb_out;
+	return nb_out;
+}
+
+uint16_t ffpp_ip_reassemble(struct ffpp_ip_frag *ctx, struct ffpp_mvec *vec)
+{
+	uint64_t now = rte_rdtsc();
+	struct rte_ipv4_hdr *ip;
+	struct rte_mbuf *m;
+	uint16_t nb_keep = 0;
+	uint16_t l2_len, i;
+
+	for (i = 0; i < vec->len; ++i) {
+		m = vec->head[i];
+		l2_len = ipv4_l2_len(m);
+		if (l2_len == 0) {
+			vec->head[nb_keep++] = m;
+			continue;
+		}
+		ip = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, l2_len);
+		if (!rte_ipv4_frag_pkt_is_fragmented(ip)) {
+			vec->head[nb_keep++] = m;
+			continue;
+		}
+
+		ctx->stats.reasm_fragments++;
+		if (unlikely(ctx->dr.cnt > DEATH_ROW_FULL)) {
+			rte_ip_frag_free_death_row(&ctx->dr,
+						   DEATH_ROW_PREFETCH);
+		}
+		m->l2_len = l2_len;
+		m->l3_len = ipv4_hdr_len(ip);
+		m = rte_ipv4_frag_reassemble_packet(ctx->tbl, &ctx->dr, m, now,
+						    ip);
+		if (m == NULL) {
+			continue;
+		}
+		if (ctx->cfg.linearize && m->nb_segs > 1 &&
+		    rte_pktmbuf_linearize(m) != 0) {
+			rte_pktmbuf_free(m);
+			ctx->stats.reasm_drops++;
+			continue;
+		}
+		// The header of the datagram is the one of its first fragment
+		// with a new length and offset.
+		ip = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *,
+					     m->l2_len);
+		ip->hdr_checksum = 0;
+		ip->hdr_checksum = rte_ipv4_cksum(ip);
+		ctx->stats.reassembled++;
+		vec->head[nb_keep++] = m;
+	}
+	rte_ip_frag_free_death_row(&ctx->dr, DEATH_ROW_PREFETCH);
+	vec->len = nb_keep;
+	return nb_keep;
+}
+
+void ffpp_ip_frag_get_stats(const struct ffpp_ip_frag *ctx,
+			    struct ffpp_ip_frag_stats *stats)
+{
+	*stats = ctx->stats;
+}
@@ -0,0 +1,339 @@
+/*
+ * logger.c
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <rte_common.h>
+
+#include <ffpp/logger.h>
+
+#define NSEC_PER_SEC 1000000000ULL
+
+struct ffpp_logger {
+	struct ffpp_log_producer *producers[FFPP_LOG_MAX_PRODUCERS];
+	uint32_t nb_producers;
+	pthread_mutex_t lock; /**< Serializes ffpp_logger_add_producer() */
+	pthread_t writer;
+	bool running;
+	int fd;
+	uint8_t *map;
+	size_t map_len;
+	size_t off;
+	uint16_t hdr_len;
+	uint16_t record_size;
+	uint32_t ring_size;
+	uint32_t flush_us;
+	uint64_t nb_written;
+	uint64_t nb_io_errors;
+};
+
+static int logger_grow(struct ffpp_logger *lg, size_t need)
+{
+	size_t new_len = lg->map_len;
+	void *map;
+
+	while (new_len < lg->off + need) {
+		new_len += FFPP_LOG_MAP_CHUNK;
+	}
+	if (ftruncate(lg->fd, new_len) < 0) {
+		return -1;
+	}
+	map = mremap(lg->map, lg->map_len, new_len, MREMAP_MAYMOVE);
+	if (map == MAP_FAILED) {
+		return -1;
+	}
+	lg->map = map;
+	lg->map_len = new_len;
+	return 0;
+}
+
+/* Copy all records of a ring into the file, returns the number of records. */
+static uint32_t drain_producer(struct ffpp_logger *lg,
+			       struct ffpp_log_producer *p)
+{
+	uint32_t head = __atomic_load_n(&p->head, __ATOMIC_ACQUIRE);
+	uint32_t tail = p->tail;
+	uint32_t n = head - tail;
+	uint32_t idx = tail & p->mask;
+	uint32_t first = RTE_MIN(n, p->size - idx);
+	size_t len = (size_t)n * lg->record_size;
+
+	if (n == 0) {
+		return 0;
+	}
+	if (unlikely(lg->off + len > lg->map_len) && logger_grow(lg, len) < 0) {
+		// Drop the batch, the producer must not stall.
+		__atomic_store_n(&lg->nb_io_errors, lg->nb_io_errors + 1,
+				 __ATOMIC_RELAXED);
+		__atomic_store_n(&p->tail, head, __ATOMIC_RELEASE);
+		return 0;
+	}
+	// The ring wraps at most once.
+	memcpy(lg->map + lg->off, p->slots + (size_t)idx * lg->record_size,
+	       (size_t)first * lg->record_size);
+	memcpy(lg->map + lg->off + (size_t)first * lg->record_size, p->slots,
+	       (size_t)(n - first) * lg->record_size);
+	lg->off += len;
+	__atomic_store_n(&lg->nb_written, lg->nb_written + n, __ATOMIC_RELAXED);
+	__atomic_store_n(&p->tail, head, __ATOMIC_RELEASE);
+	return n;
+}
+
+static uint32_t drain_all(struct ffpp_logger *lg)
+{
+	uint32_t nb = __atomic_load_n(&lg->nb_producers, __ATOMIC_ACQUIRE);
+	uint32_t total = 0;
+	uint32_t i;
+
+	for (i = 0; i < nb; ++i) {
+		total += drain_producer(lg, lg->producers[i]);
+	}
+	return total;
+}
+
+static void *writer_main(void *arg)
+{
+	struct ffpp_logger *lg = arg;
+	struct timespec idle = {
+		.tv_sec = lg->flush_us / 1000000,
+		.tv_nsec = (lg->flush_us % 1000000) * 1000,
+	};
+
+	while (__atomic_load_n(&lg->running, __ATOMIC_ACQUIRE)) {
+		if (drain_all(lg) == 0) {
+			nanosleep(&idle, NULL);
+		}
+	}
+	drain_all(lg);
+	return NULL;
+}
+
+static int write_file_hdr(struct ffpp_logger *lg,
+			  const struct ffpp_logger_config *cfg)
+{
+	struct ffpp_log_file_field *ff;
+	struct ffpp_log_file_hdr *hdr;
+	struct timespec now;
+	uint16_t i;
+
+	if (logger_grow(lg, lg->hdr_len) < 0) {
+		return -1;
+	}
+	clock_gettime(CLOCK_REALTIME, &now);
+	hdr = (struct ffpp_log_file_hdr *)lg->map;
+	memcpy(hdr->magic, FFPP_LOG_MAGIC, sizeof(FFPP_LOG_MAGIC));
+	hdr->version = FFPP_LOG_VERSION;
+	hdr->hdr_len = lg->hdr_len;
+	hdr->record_size = cfg->record_size;
+	hdr->nb_fields = cfg->nb_fields;
+	hdr->nb_records = 0;
+	hdr->start_ns = (uint64_t)now.tv_sec * NSEC_PER_SEC + now.tv_nsec;
+	if (cfg->name != NULL) {
+		strncpy(hdr->name, cfg->name, FFPP_LOG_NAME_LEN - 1);
+	}
+
+	ff = (struct ffpp_log_file_field *)(hdr + 1);
+	for (i = 0; i < cfg->nb_fields; ++i) {
+		strncpy(ff[i].name, cfg->fields[i].name, FFPP_LOG_NAME_LEN - 1);
+		ff[i].offset = cfg->fields[i].offset;
+		ff[i].type = cfg->fields[i].type;
+	}
+	lg->off = lg->hdr_len;
+	return 0;
+}
+
+static const uint8_t type_sizes[] = {
+	[FFPP_LOG_U8] = 1,  [FFPP_LOG_U16] = 2, [FFPP_LOG_U32] = 4,
+	[FFPP_LOG_U64] = 8, [FFPP_LOG_I32] = 4, [FFPP_LOG_I64] = 8,
+	[FFPP_LOG_F32] = 4, [FFPP_LOG_F64] = 8,
+};
+
+static bool config_is_valid(const struct ffpp_logger_config *cfg)
+{
+	uint16_t i;
+
+	if (cfg->path == NULL || cfg->fields == NULL || cfg->nb_fields == 0 ||
+	    cfg->nb_fields > FFPP_LOG_MAX_FIELDS || cfg->record_size == 0 ||
+	    (cfg->ring_size != 0 && !rte_is_power_of_2(cfg->ring_size))) {
+		return false;
+	}
+	for (i = 0; i < cfg->nb_fields; ++i) {
+		if (cfg->fields[i].name == NULL ||
+		    (unsigned int)cfg->fields[i].type >= RTE_DIM(type_sizes) ||
+		    cfg->fields[i].offset + type_sizes[cfg->fields[i].type] >
+			    cfg->record_size) {
+			return false;
+		}
+	}
+	return true;
+}
+
+struct ffpp_logger *ffpp_logger_create(const struct ffpp_logger_config *cfg)
+{
+	struct ffpp_logger *lg;
+	int err;
+
+	if (!config_is_valid(cfg)) {
+		errno = EINVAL;
+		return NULL;
+	}
+	lg = calloc(1, sizeof(*lg));
+	if (lg == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	pthread_mutex_init(&lg->lock, NULL);
+	lg->record_size = cfg->record_size;
+	lg->hdr_len = sizeof(struct ffpp_log_file_hdr) +
+		      cfg->nb_fields * sizeof(struct ffpp_log_file_field);
+	lg->ring_size = cfg->ring_size == 0 ? FFPP_LOG_RING_SIZE_DEFAULT :
+						    cfg->ring_size;
+	lg->flush_us = cfg->flush_us == 0 ? FFPP_LOG_FLUSH_US_DEFAULT :
+						  cfg->flush_us;
+
+	lg->fd = open(cfg->path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (lg->fd < 0) {
+		err = errno;
+		goto err_free;
+	}
+	lg->map_len = FFPP_LOG_MAP_CHUNK;
+	if (ftruncate(lg->fd, lg->map_len) < 0) {
+		err = errno;
+		goto err_close;
+	}
+	lg->map = mmap(NULL, lg->map_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+		       lg->fd, 0);
+	if (lg->map == MAP_FAILED) {
+		err = errno;
+		goto err_close;
+	}
+	if (write_file_hdr(lg, cfg) < 0) {
+		err = errno;
+		goto err_unmap;
+	}
+
+	lg->running = true;
+	err = pthread_create(&lg->writer, NULL, writer_main, lg);
+	if (err != 0) {
+		goto err_unmap;
+	}
+	pthread_setname_np(lg->writer, "ffpp_logger");
+	return lg;
+
+err_unmap:
+	munmap(lg->map, lg->map_len);
+err_close:
+	close(lg->fd);
+	unlink(cfg->path);
+err_free:
+	pthread_mutex_destroy(&lg->lock);
+	free(lg);
+	errno = err;
+	return NULL;
+}
+
+struct ffpp_log_producer *ffpp_logger_add_producer(struct ffpp_logger *lg)
+{
+	struct ffpp_log_producer *p = NULL;
+
+	pthread_mutex_lock(&lg->lock);
+	if (lg->nb_producers == FFPP_LOG_MAX_PRODUCERS) {
+		errno = ENOSPC;
+		goto out;
+	}
+	if (posix_memalign((void **)&p, RTE_CACHE_LINE_SIZE, sizeof(*p)) != 0) {
+		p = NULL;
+		errno = ENOMEM;
+		goto out;
+	}
+	memset(p, 0, sizeof(*p));
+	p->size = lg->ring_size;
+	p->mask = lg->ring_size - 1;
+	p->record_size = lg->record_size;
+	p->slots = malloc((size_t)p->size * p->record_size);
+	if (p->slots == NULL) {
+		free(p);
+		p = NULL;
+		errno = ENOMEM;
+		goto out;
+	}
+	lg->producers[lg->nb_producers] = p;
+	// Publish the producer after it is initialized.
+	__atomic_store_n(&lg->nb_producers, lg->nb_producers + 1,
+			 __ATOMIC_RELEASE);
+out:
+	pthread_mutex_unlock(&lg->lock);
+	return p;
+}
+
+void ffpp_logger_flush(struct ffpp_logger *lg)
+{
+	uint32_t nb = __atomic_load_n(&lg->nb_producers, __ATOMIC_ACQUIRE);
+	struct timespec idle = { .tv_sec = 0, .tv_nsec = 100000 };
+	struct ffpp_log_producer *p;
+	uint32_t head, i;
+
+	for (i = 0; i < nb; ++i) {
+		p = lg->producers[i];
+		head = __atomic_load_n(&p->head, __ATOMIC_ACQUIRE);
+		// Wrap-safe: wait until the writer has passed head.
+		while ((int32_t)(__atomic_load_n(&p->tail, __ATOMIC_ACQUIRE) -
+				 head) < 0) {
+			nanosleep(&idle, NULL);
+		}
+	}
+}
+
+void ffpp_logger_get_stats(struct ffpp_logger *lg,
+			   struct ffpp_logger_stats *stats)
+{
+	uint32_t nb = __atomic_load_n(&lg->nb_producers, __ATOMIC_ACQUIRE);
+	uint32_t i;
+
+	memset(stats, 0, sizeof(*stats));
+	for (i = 0; i < nb; ++i) {
+		stats->nb_dropped += __atomic_load_n(
+			&lg->producers[i]->nb_dropped, __ATOMIC_RELAXED);
+	}
+	stats->nb_written = __atomic_load_n(&lg->nb_written, __ATOMIC_RELAXED);
+	stats->nb_io_errors =
+		__atomic_load_n(&lg->nb_io_errors, __ATOMIC_RELAXED);
+}
+
+void ffpp_logger_free(struct ffpp_logger *lg)
+{
+	struct ffpp_log_file_hdr *hdr;
+	uint32_t i;
+
+	if (lg == NULL) {
+		return;
+	}
+	__atomic_store_n(&lg->running, false, __ATOMIC_RELEASE);
+	pthread_join(lg->writer, NULL);
+
+	hdr = (struct ffpp_log_file_hdr *)lg->map;
+	hdr->nb_records = lg->nb_written;
+	munmap(lg->map, lg->map_len);
+	if (ftruncate(lg->fd, lg->off) < 0) {
+		fprintf(stderr, "Logger: Can not truncate the log file.\n");
+	}
+	close(lg->fd);
+
+	for (i = 0; i < lg->nb_producers; ++i) {
+		free(lg->producers[i]->slots);
+		free(lg->producers[i]);
+	}
+	pthread_mutex_destroy(&lg->lock);
+	free(lg);
+}
@@ -0,0 +1,244 @@
+/*
+ * mbuf_bulk.c
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+#include <rte_mbuf.h>
+#include <rte_mbuf_dyn.h>
+#include <rte_memcpy.h>
+#include <rte_mempool.h>
+#include <rte_vect.h>
+
+#include <ffpp/mbuf_bulk.h>
+
+// Distinct pools per burst that are grouped, the others are freed together.
+#define FREE_POOLS_MAX 4
+
+int ffpp_mbuf_alloc_bulk(struct rte_mempool *pool, struct ffpp_mvec *vec,
+			 uint16_t n)
+{
+	if (n > vec->capacity) {
+		return -EINVAL;
+	}
+	if (rte_pktmbuf_alloc_bulk(pool, vec->head, n) != 0) {
+		return -ENOMEM;
+	}
+	vec->len = n;
+	return 0;
+}
+
+void ffpp_mbuf_free_bulk(struct rte_mbuf **pkts, uint16_t n)
+{
+	struct rte_mbuf *groups[FREE_POOLS_MAX + 1][FFPP_MBUF_BULK_MAX];
+	struct rte_mempool *pools[FREE_POOLS_MAX];
+	uint16_t counts[FREE_POOLS_MAX + 1];
+	uint16_t nb_pools, len, off, i, j;
+	struct rte_mbuf *m;
+
+	for (off = 0; off < n; off += len) {
+		len = RTE_MIN(n - off, FFPP_MBUF_BULK_MAX);
+		memset(counts, 0, sizeof(counts));
+		nb_pools = 0;
+		for (i = 0; i < len; ++i) {
+			m = pkts[off + i];
+			if (m == NULL) {
+				continue;
+			}
+			for (j = 0; j < nb_pools; ++j) {
+				if (pools[j] == m->pool) {
+					break;
+				}
+			}
+			if (j == nb_pools) {
+				if (nb_pools < FREE_POOLS_MAX) {
+					pools[nb_pools++] = m->pool;
+				} else {
+					j = FREE_POOLS_MAX;
+				}
+			}
+			groups[j][counts[j]++] = m;
+		}
+		if (likely(nb_pools <= 1)) {
+			rte_pktmbuf_free_bulk(pkts + off, len);
+			continue;
+		}
+		for (j = 0; j <= FREE_POOLS_MAX; ++j) {
+			if (counts[j] > 0) {
+				rte_pktmbuf_free_bulk(groups[j], counts[j]);
+			}
+		}
+	}
+}
+
+void ffpp_mbuf_free_mvec(struct ffpp_mvec *vec)
+{
+	ffpp_mbuf_free_bulk(vec->head, vec->len);
+	vec->len = 0;
+}
+
+static __rte_always_inline void copy_metadata(struct rte_mbuf *dst,
+					      const struct rte_mbuf *src)
+{
+	dst->port = src->port;
+	dst->vlan_tci = src->vlan_tci;
+	dst->vlan_tci_outer = src->vlan_tci_outer;
+	dst->tx_offload = src->tx_offload;
+	dst->hash = src->hash;
+	dst->packet_type = src->packet_type;
+	dst->ol_flags =
+		src->ol_flags & ~(IND_ATTACHED_MBUF | EXT_ATTACHED_MBUF);
+	rte_mbuf_dynfield_copy(dst, src);
+}
+
+int ffpp_mbuf_fanout(struct rte_mbuf *m, uint16_t hdr_len,
+		     struct rte_mempool *hdr_pool,
+		     struct rte_mempool *indirect_pool, struct rte_mbuf **out,
+		     uint16_t n)
+{
+	struct rte_mbuf *clones[FFPP_MBUF_BULK_MAX];
+	bool has_payload = rte_pktmbuf_pkt_len(m) > hdr_len;
+	uint16_t hdr_room = rte_pktmbuf_data_room_size(hdr_pool);
+	char *hdr;
+	uint16_t i;
+
+	if (n == 0 || n > FFPP_MBUF_BULK_MAX ||
+	    hdr_len > rte_pktmbuf_data_len(m) ||
+	    hdr_room < RTE_PKTMBUF_HEADROOM + hdr_len ||
+	    m->nb_segs >= RTE_MBUF_MAX_NB_SEGS) {
+		return -EINVAL;
+	}
+	if (rte_pktmbuf_alloc_bulk(hdr_pool, out, n) != 0) {
+		return -ENOMEM;
+	}
+	if (has_payload && likely(m->nb_segs == 1)) {
+		if (rte_pktmbuf_alloc_bulk(indirect_pool, clones, n) != 0) {
+			goto nomem;
+		}
+		for (i = 0; i < n; ++i) {
+			rte_pktmbuf_attach(clones[i], m);
+		}
+	} else if (has_payload) {
+		// Each segment needs its own indirect mbuf.
+		for (i = 0; i < n; ++i) {
+			clones[i] = rte_pktmbuf_clone(m, indirect_pool);
+			if (clones[i] == NULL) {
+				rte_pktmbuf_free_bulk(clones, i);
+				goto nomem;
+			}
+		}
+	}
+
+	for (i = 0; i < n; ++i) {
+		hdr = rte_pktmbuf_append(out[i], hdr_len);
+		rte_memcpy(hdr, rte_pktmbuf_mtod(m, void *), hdr_len);
+		copy_metadata(out[i], m);
+		if (has_payload) {
+			rte_pktmbuf_adj(clones[i], hdr_len);
+			rte_pktmbuf_chain(out[i], clones[i]);
+		}
+	}
+	return 0;
+
+nomem:
+	rte_pktmbuf_free_bulk(out, n);
+	return -ENOMEM;
+}
+
+#if defined(__SSE2__)
+
+/* Copy with streaming stores that bypass the cache, see _mm_stream_si128(). */
+static void copy_nt(void *dst, const void *src, size_t len)
+{
+	uint8_t *d = dst;
+	const uint8_t *s = src;
+	size_t head = RTE_MIN((size_t)(RTE_PTR_ALIGN_CEIL(d, 16) - d), len);
+	__m128i v0, v1, v2, v3;
+
+	memcpy(d, s, head);
+	d += head;
+	s += head;
+	len -= head;
+	for (; len >= 64; len -= 64, d += 64, s += 64) {
+		v0 = _mm_loadu_si128((const __m128i *)s);
+		v1 = _mm_loadu_si128((const __m128i *)(s + 16));
+		v2 = _mm_loadu_si128((const __m128i *)(s + 32));
+		v3 = _mm_loadu_si128((const __m128i *)(s + 48));
+		_mm_stream_si128((__m128i *)d, v0);
+		_mm_stream_si128((__m128i *)(d + 16), v1);
+		_mm_stream_si128((__m128i *)(d + 32), v2);
+		_mm_stream_si128((__m128i *)(d + 48), v3);
+	}
+	for (; len >= 16; len -= 16, d += 16, s += 16) {
+		_mm_stream_si128((__m128i *)d,
+				 _mm_loadu_si128((const __m128i *)s));
+	}
+	memcpy(d, s, len);
+}
+
+static __rte_always_inline void copy_nt_fence(void)
+{
+	// Streaming stores are weakly ordered.
+	_mm_sfence();
+}
+
+#else
+
+static void copy_nt(void *dst, const void *src, size_t len)
+{
+	rte_memcpy(dst, src, len);
+}
+
+static __rte_always_inline void copy_nt_fence(void)
+{
+}
+
+#endif
+
+int ffpp_mbuf_deep_copy_bulk(struct rte_mempool *pool, struct rte_mbuf **src,
+			     struct rte_mbuf **dst, uint16_t n)
+{
+	uint16_t data_room = rte_pktmbuf_data_room_size(pool);
+	uint32_t room = data_room > RTE_PKTMBUF_HEADROOM ?
+				data_room - RTE_PKTMBUF_HEADROOM :
+				0;
+	const struct rte_mbuf *seg;
+	bool used_nt = false;
+	bool nt;
+	char *p;
+	uint16_t i;
+
+	for (i = 0; i < n; ++i) {
+		if (rte_pktmbuf_pkt_len(src[i]) > room) {
+			return -EINVAL;
+		}
+	}
+	if (rte_pktmbuf_alloc_bulk(pool, dst, n) != 0) {
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < n; ++i) {
+		p = rte_pktmbuf_append(dst[i], rte_pktmbuf_pkt_len(src[i]));
+		nt = rte_pktmbuf_pkt_len(src[i]) >= FFPP_MBUF_NT_COPY_THRESHOLD;
+		used_nt |= nt;
+		for (seg = src[i]; seg != NULL; seg = seg->next) {
+			if (nt) {
+				copy_nt(p, rte_pktmbuf_mtod(seg, void *),
+					seg->data_len);
+			} else {
+				rte_memcpy(p, rte_pktmbuf_mtod(seg, void *),
+					   seg->data_len);
+			}
+			p += seg->data_len;
+		}
+		copy_metadata(dst[i], src[i]);
+	}
+	if (used_nt) {
+		copy_nt_fence();
+	}
+	return 0;
+}
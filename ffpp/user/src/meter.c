@@ -0,0 +1,463 @@
+/*
+ * meter.c
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_meter.h>
+
+#include <ffpp/checksum.h>
+#include <ffpp/flow_table.h>
+#include <ffpp/meter.h>
+
+#define VLAN_HDR_LEN (sizeof(struct rte_vlan_hdr))
+// Fixed point shift of the shaper cycles per byte.
+#define CPB_SHIFT 16
+
+/* State of a flow, kept in the flow table and zeroed for new flows. */
+struct flow_meter {
+	union {
+		struct rte_meter_srtcm srtcm;
+		struct rte_meter_trtcm trtcm;
+	};
+	uint64_t tat; /**< Shaper: theoretical arrival time (TSC) */
+	uint16_t profile;
+	uint8_t configured;
+};
+
+struct shaper_entry {
+	uint64_t deadline;
+	struct rte_mbuf *m;
+};
+
+struct meter_part {
+	struct shaper_entry *heap; /**< Min-heap by deadline */
+	uint32_t heap_len;
+	struct ffpp_meter_stats stats;
+} __rte_cache_aligned;
+
+struct ffpp_meter {
+	struct ffpp_meter_config cfg;
+	struct ffpp_flow_table *flows;
+	struct meter_part *parts;
+	union {
+		struct rte_meter_srtcm_profile srtcm[FFPP_METER_PROFILES_MAX];
+		struct rte_meter_trtcm_profile trtcm[FFPP_METER_PROFILES_MAX];
+	};
+	// Shaper: TSC cycles per byte of the CIR (fixed point) and the CBS in
+	// cycles.
+	uint64_t cpb[FFPP_METER_PROFILES_MAX];
+	uint64_t burst_cycles[FFPP_METER_PROFILES_MAX];
+};
+
+static int config_profiles(struct ffpp_meter *mtr)
+{
+	struct ffpp_meter_config *cfg = &mtr->cfg;
+	uint64_t hz = rte_get_tsc_hz();
+	uint64_t cir, cbs;
+	uint16_t i;
+	int ret;
+
+	for (i = 0; i < cfg->nb_profiles; ++i) {
+		if (cfg->algo == FFPP_METER_SRTCM) {
+			ret = rte_meter_srtcm_profile_config(&mtr->srtcm[i],
+							     &cfg->srtcm[i]);
+			cir = cfg->srtcm[i].cir;
+			cbs = cfg->srtcm[i].cbs;
+		} else {
+			ret = rte_meter_trtcm_profile_config(&mtr->trtcm[i],
+							     &cfg->trtcm[i]);
+			cir = cfg->trtcm[i].cir;
+			cbs = cfg->trtcm[i].cbs;
+		}
+		if (ret != 0) {
+			return ret;
+		}
+		mtr->cpb[i] = RTE_MAX((hz << CPB_SHIFT) / cir, (uint64_t)1);
+		mtr->burst_cycles[i] = (uint64_t)((double)cbs * hz / cir);
+	}
+	return 0;
+}
+
+struct ffpp_meter *ffpp_meter_create(const struct ffpp_meter_config *cfg)
+{
+	struct ffpp_flow_table_config flow_cfg;
+	struct ffpp_meter *mtr;
+	uint32_t queue_size;
+	uint16_t i;
+
+	if (cfg->name[0] == '\0' ||
+	    strnlen(cfg->name, FFPP_METER_NAME_MAX_LEN) ==
+		    FFPP_METER_NAME_MAX_LEN ||
+	    cfg->nb_parts == 0 || cfg->nb_profiles == 0 ||
+	    cfg->nb_profiles > FFPP_METER_PROFILES_MAX ||
+	    cfg->default_profile >= cfg->nb_profiles) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+	for (i = 0; i < RTE_COLORS; ++i) {
+		if (cfg->actions[i] > FFPP_METER_MARK || cfg->dscp[i] > 0x3f) {
+			rte_errno = EINVAL;
+			return NULL;
+		}
+	}
+
+	mtr = rte_zmalloc_socket("ffpp_meter", sizeof(*mtr),
+				 RTE_CACHE_LINE_SIZE, cfg->socket_id);
+	if (mtr == NULL) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	mtr->cfg = *cfg;
+	if (mtr->cfg.shaper_queue_size == 0) {
+		mtr->cfg.shaper_queue_size = FFPP_METER_SHAPER_QUEUE_DEFAULT;
+	}
+	if (config_profiles(mtr) != 0) {
+		rte_free(mtr);
+		rte_errno = EINVAL;
+		return NULL;
+	}
+
+	memset(&flow_cfg, 0, sizeof(flow_cfg));
+	snprintf(flow_cfg.name, sizeof(flow_cfg.name), "%s_ft", cfg->name);
+	flow_cfg.socket_id = cfg->socket_id;
+	flow_cfg.nb_parts = cfg->nb_parts;
+	flow_cfg.max_flows = cfg->max_flows;
+	flow_cfg.data_size = sizeof(struct flow_meter);
+	flow_cfg.timeout_us = cfg->timeout_us;
+	mtr->flows = ffpp_flow_table_create(&flow_cfg);
+	if (mtr->flows == NULL) {
+		// rte_errno is set by the flow table.
+		ffpp_meter_free(mtr);
+		return NULL;
+	}
+
+	mtr->parts = rte_zmalloc_socket("ffpp_meter_parts",
+					cfg->nb_parts * sizeof(*mtr->parts),
+					RTE_CACHE_LINE_SIZE, cfg->socket_id);
+	if (mtr->parts == NULL) {
+		goto fail;
+	}
+	queue_size = mtr->cfg.shaper_queue_size;
+	for (i = 0; i < cfg->nb_parts; ++i) {
+		mtr->parts[i].heap = rte_malloc_socket(
+			"ffpp_meter_shaper",
+			queue_size * sizeof(struct shaper_entry),
+			RTE_CACHE_LINE_SIZE, cfg->socket_id);
+		if (mtr->parts[i].heap == NULL) {
+			goto fail;
+		}
+	}
+	return mtr;
+
+fail:
+	ffpp_meter_free(mtr);
+	rte_errno = ENOMEM;
+	return NULL;
+}
+
+static void heap_push(struct meter_part *p, uint64_t deadline,
+		      struct rte_mbuf *m)
+{
+	uint32_t i = p->heap_len++;
+	uint32_t parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (p->heap[parent].deadline <= deadline) {
+			break;
+		}
+		p->heap[i] = p->heap[parent];
+		i = parent;
+	}
+	p->heap[i].deadline = deadline;
+	p->heap[i].m = m;
+}
+
+static struct rte_mbuf *heap_pop(struct meter_part *p)
+{
+	struct rte_mbuf *top = p->heap[0].m;
+	struct shaper_entry last = p->heap[--p->heap_len];
+	uint32_t i = 0;
+	uint32_t c;
+
+	while ((c = 2 * i + 1) < p->heap_len) {
+		if (c + 1 < p->heap_len &&
+		    p->heap[c + 1].deadline < p->heap[c].deadline) {
+			c++;
+		}
+		if (last.deadline <= p->heap[c].deadline) {
+			break;
+		}
+		p->heap[i] = p->heap[c];
+		i = c;
+	}
+	p->heap[i] = last;
+	return top;
+}
+
+void ffpp_meter_free(struct ffpp_meter *mtr)
+{
+	struct meter_part *p;
+	uint16_t i;
+
+	if (mtr == NULL) {
+		return;
+	}
+	if (mtr->parts != NULL) {
+		for (i = 0; i < mtr->cfg.nb_parts; ++i) {
+			p = &mtr->parts[i];
+			while (p->heap_len > 0) {
+				rte_pktmbuf_free(heap_pop(p));
+			}
+			rte_free(p->heap);
+		}
+		rte_free(mtr->parts);
+	}
+	ffpp_flow_table_free(mtr->flows);
+	rte_free(mtr);
+}
+
+static __rte_always_inline void flow_config(struct ffpp_meter *mtr,
+					    struct flow_meter *f,
+					    uint16_t profile)
+{
+	if (mtr->cfg.algo == FFPP_METER_SRTCM) {
+		rte_meter_srtcm_config(&f->srtcm, &mtr->srtcm[profile]);
+	} else {
+		rte_meter_trtcm_config(&f->trtcm, &mtr->trtcm[profile]);
+	}
+	f->profile = profile;
+	f->tat = 0;
+	f->configured = 1;
+}
+
+int ffpp_meter_set_flow_profile(struct ffpp_meter *mtr, uint16_t part,
+				const struct ffpp_cls_5tuple *key,
+				uint16_t profile)
+{
+	void *data;
+
+	if (profile >= mtr->cfg.nb_profiles) {
+		return -EINVAL;
+	}
+	if (ffpp_flow_insert_bulk(mtr->flows, part, key, 1, &data) == 0) {
+		return -ENOSPC;
+	}
+	flow_config(mtr, data, profile);
+	return 0;
+}
+
+/**
+ * Look up the flows of n packets, new flows are inserted and get the default
+ * profile. flows[i] is NULL for untracked packets.
+ */
+static void lookup_flows(struct ffpp_meter *mtr, uint16_t part,
+			 struct rte_mbuf **pkts, uint16_t n,
+			 struct flow_meter **flows)
+{
+	struct ffpp_cls_5tuple keys[FFPP_FLOW_BULK_MAX];
+	void *found[FFPP_FLOW_BULK_MAX];
+	uint16_t pos[FFPP_FLOW_BULK_MAX];
+	struct flow_meter *f;
+	uint16_t i, nb_keys = 0;
+
+	for (i = 0; i < n; ++i) {
+		flows[i] = NULL;
+		if (ffpp_cls_5tuple_of(pkts[i], &keys[nb_keys]) == 0) {
+			pos[nb_keys++] = i;
+		}
+	}
+	ffpp_flow_insert_bulk(mtr->flows, part, keys, nb_keys, found);
+	for (i = 0; i < nb_keys; ++i) {
+		f = found[i];
+		if (f != NULL && unlikely(!f->configured)) {
+			flow_config(mtr, f, mtr->cfg.default_profile);
+		}
+		flows[pos[i]] = f;
+	}
+}
+
+static __rte_always_inline enum rte_color meter_check(struct ffpp_meter *mtr,
+						      struct flow_meter *f,
+						      uint64_t now,
+						      uint32_t len)
+{
+	if (mtr->cfg.algo == FFPP_METER_SRTCM) {
+		return rte_meter_srtcm_color_blind_check(
+			&f->srtcm, &mtr->srtcm[f->profile], now, len);
+	}
+	return rte_meter_trtcm_color_blind_check(
+		&f->trtcm, &mtr->trtcm[f->profile], now, len);
+}
+
+/* Set the DSCP of an IPv4 packet with incremental checksum update. */
+static void mark_dscp(struct rte_mbuf *m, uint8_t dscp)
+{
+	const struct rte_ether_hdr *eth;
+	struct rte_ipv4_hdr *ip;
+	uint16_t off = RTE_ETHER_HDR_LEN;
+	uint16_t type, old, now;
+
+	eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+	type = eth->ether_type;
+	if (type == RTE_BE16(RTE_ETHER_TYPE_VLAN)) {
+		type = ((const struct rte_vlan_hdr *)(eth + 1))->eth_proto;
+		off += VLAN_HDR_LEN;
+	}
+	// Tracked packets are IPv4, see ffpp_cls_5tuple_of().
+	if (unlikely(type != RTE_BE16(RTE_ETHER_TYPE_IPV4))) {
+		return;
+	}
+	ip = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, off);
+	memcpy(&old, ip, sizeof(old));
+	ip->type_of_service = (dscp << 2) | (ip->type_of_service & 0x03);
+	memcpy(&now, ip, sizeof(now));
+	ip->hdr_checksum = ffpp_csum_replace16(ip->hdr_checksum, old, now);
+}
+
+/* Keep the i-th packet at the head of the vector, the order is kept. */
+static __rte_always_inline void keep_packet(struct ffpp_mvec *vec, uint16_t i,
+					    uint16_t *nb_keep)
+{
+	struct rte_mbuf *tmp;
+
+	if (i != *nb_keep) {
+		tmp = vec->head[*nb_keep];
+		vec->head[*nb_keep] = vec->head[i];
+		vec->head[i] = tmp;
+	}
+	(*nb_keep)++;
+}
+
+uint16_t ffpp_meter_police(struct ffpp_meter *mtr, uint16_t part,
+			   struct ffpp_mvec *vec, uint8_t *colors)
+{
+	struct ffpp_meter_stats *stats = &mtr->parts[part].stats;
+	struct flow_meter *flows[FFPP_FLOW_BULK_MAX];
+	uint64_t now = rte_rdtsc();
+	enum rte_color color;
+	struct rte_mbuf *m;
+	uint16_t nb_keep = 0;
+	uint16_t off, n, i;
+
+	for (off = 0; off < vec->len; off += n) {
+		n = RTE_MIN(vec->len - off, FFPP_FLOW_BULK_MAX);
+		lookup_flows(mtr, part, vec->head + off, n, flows);
+		for (i = 0; i < n; ++i) {
+			m = vec->head[off + i];
+			color = RTE_COLOR_GREEN;
+			if (flows[i] == NULL) {
+				stats->untracked++;
+			} else {
+				color = meter_check(mtr, flows[i], now,
+						    rte_pktmbuf_pkt_len(m));
+				stats->colors[color]++;
+				if (mtr->cfg.actions[color] ==
+				    FFPP_METER_DROP) {
+					stats->dropped++;
+					continue;
+				}
+				if (mtr->cfg.actions[color] ==
+				    FFPP_METER_MARK) {
+					mark_dscp(m, mtr->cfg.dscp[color]);
+				}
+			}
+			if (colors != NULL) {
+				colors[nb_keep] = color;
+			}
+			keep_packet(vec, off + i, &nb_keep);
+		}
+	}
+	return nb_keep;
+}
+
+uint16_t ffpp_meter_shape(struct ffpp_meter *mtr, uint16_t part,
+			  struct ffpp_mvec *vec)
+{
+	struct meter_part *p = &mtr->parts[part];
+	struct flow_meter *flows[FFPP_FLOW_BULK_MAX];
+	uint64_t now = rte_rdtsc();
+	uint64_t inc, burst;
+	struct flow_meter *f;
+	struct rte_mbuf *m;
+	uint16_t nb_keep = 0;
+	uint16_t off, n, i;
+
+	for (off = 0; off < vec->len; off += n) {
+		n = RTE_MIN(vec->len - off, FFPP_FLOW_BULK_MAX);
+		lookup_flows(mtr, part, vec->head + off, n, flows);
+		for (i = 0; i < n; ++i) {
+			m = vec->head[off + i];
+			f = flows[i];
+			if (f == NULL) {
+				p->stats.untracked++;
+				keep_packet(vec, off + i, &nb_keep);
+				continue;
+			}
+			// Virtual scheduling: the packet conforms if it would
+			// be sent at most one burst ahead of the CIR.
+			inc = ((uint64_t)rte_pktmbuf_pkt_len(m) *
+			       mtr->cpb[f->profile]) >>
+			      CPB_SHIFT;
+			burst = mtr->burst_cycles[f->profile];
+			f->tat = RTE_MAX(f->tat, now) + inc;
+			if (f->tat <= now + burst) {
+				keep_packet(vec, off + i, &nb_keep);
+				continue;
+			}
+			if (unlikely(p->heap_len ==
+				     mtr->cfg.shaper_queue_size)) {
+				// The dropped packet does not use the rate.
+				f->tat -= inc;
+				p->stats.shaper_drops++;
+				rte_pktmbuf_free(m);
+				continue;
+			}
+			heap_push(p, f->tat - burst, m);
+			p->stats.shaped++;
+		}
+	}
+	vec->len = nb_keep;
+	return nb_keep;
+}
+
+uint16_t ffpp_meter_shaper_dequeue(struct ffpp_meter *mtr, uint16_t part,
+				   struct rte_mbuf **pkts, uint16_t n)
+{
+	struct meter_part *p = &mtr->parts[part];
+	uint64_t now = rte_rdtsc();
+	uint16_t nb = 0;
+
+	while (nb < n && p->heap_len > 0 && p->heap[0].deadline <= now) {
+		pkts[nb++] = heap_pop(p);
+	}
+	return nb;
+}
+
+uint32_t ffpp_meter_age(struct ffpp_meter *mtr, uint16_t part,
+			uint32_t budget)
+{
+	return ffpp_flow_age(mtr->flows, part, budget);
+}
+
+void ffpp_meter_get_stats(const struct ffpp_meter *mtr, uint16_t part,
+			  struct ffpp_meter_stats *stats)
+{
+	struct ffpp_flow_stats flow_stats;
+
+	*stats = mtr->parts[part].stats;
+	stats->shaper_backlog = mtr->parts[part].heap_len;
+	ffpp_flow_get_stats(mtr->flows, part, &flow_stats);
+	stats->nb_flows = flow_stats.nb_flows;
+}
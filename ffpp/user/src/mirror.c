@@ -0,0 +1,236 @@
+/*
+ * mirror.c
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_random.h>
+#include <rte_ring.h>
+
+#include <ffpp/mirror.h>
+
+struct mirror_target {
+	struct ffpp_mirror_target cfg;
+	uint32_t countdown; /**< Packets until the next deterministic sample */
+	uint64_t rand_threshold; /**< rte_rand() below it samples */
+	// Token bucket, one token per mirrored packet. 0 cycles per token
+	// disables the rate limit.
+	uint64_t cycles_per_token;
+	uint64_t tokens;
+	uint64_t last_tsc;
+	struct ffpp_mirror_stats stats;
+} __rte_cache_aligned;
+
+struct ffpp_mirror {
+	struct rte_mempool *clone_pool;
+	uint16_t nb_targets;
+	bool match_flows; /**< At least one target filters by flow */
+	struct mirror_target targets[FFPP_MIRROR_TARGETS_MAX];
+};
+
+struct ffpp_mirror *ffpp_mirror_create(const struct ffpp_mirror_config *cfg)
+{
+	const struct ffpp_mirror_target *tcfg;
+	struct ffpp_mirror *mir;
+	struct mirror_target *t;
+	uint64_t hz = rte_get_tsc_hz();
+	uint16_t i;
+
+	if (cfg->clone_pool == NULL || cfg->nb_targets == 0 ||
+	    cfg->nb_targets > FFPP_MIRROR_TARGETS_MAX) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+	for (i = 0; i < cfg->nb_targets; ++i) {
+		if (cfg->targets[i].ring == NULL) {
+			rte_errno = EINVAL;
+			return NULL;
+		}
+	}
+
+	mir = rte_zmalloc_socket("ffpp_mirror", sizeof(*mir),
+				 RTE_CACHE_LINE_SIZE, cfg->socket_id);
+	if (mir == NULL) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	mir->clone_pool = cfg->clone_pool;
+	mir->nb_targets = cfg->nb_targets;
+	for (i = 0; i < cfg->nb_targets; ++i) {
+		tcfg = &cfg->targets[i];
+		t = &mir->targets[i];
+		t->cfg = *tcfg;
+		// The flow is compared with memcmp() to the keys of the packets.
+		memset(t->cfg.flow.pad, 0, sizeof(t->cfg.flow.pad));
+		if (t->cfg.sample_n == 0) {
+			t->cfg.sample_n = 1;
+		}
+		if (t->cfg.rate_burst == 0) {
+			t->cfg.rate_burst = FFPP_MIRROR_RATE_BURST_DEFAULT;
+		}
+		t->countdown = 1;
+		t->rand_threshold = UINT64_MAX / t->cfg.sample_n;
+		if (tcfg->rate_pps > 0) {
+			t->cycles_per_token =
+				RTE_MAX(hz / tcfg->rate_pps, (uint64_t)1);
+			t->tokens = t->cfg.rate_burst;
+			t->last_tsc = rte_rdtsc();
+		}
+		mir->match_flows |= tcfg->match_flow;
+	}
+	return mir;
+}
+
+void ffpp_mirror_free(struct ffpp_mirror *mir)
+{
+	rte_free(mir);
+}
+
+static __rte_always_inline bool sample(struct mirror_target *t)
+{
+	if (t->cfg.sample_n == 1) {
+		return true;
+	}
+	if (t->cfg.sampling == FFPP_MIRROR_SAMPLE_RANDOM) {
+		return rte_rand() < t->rand_threshold;
+	}
+	if (--t->countdown == 0) {
+		t->countdown = t->cfg.sample_n;
+		return true;
+	}
+	return false;
+}
+
+static __rte_always_inline void refill(struct mirror_target *t, uint64_t now)
+{
+	uint64_t n = (now - t->last_tsc) / t->cycles_per_token;
+
+	if (n == 0) {
+		return;
+	}
+	if (n >= t->cfg.rate_burst - t->tokens) {
+		// Full bucket, the idle time is not saved up.
+		t->tokens = t->cfg.rate_burst;
+		t->last_tsc = now;
+	} else {
+		t->tokens += n;
+		t->last_tsc += n * t->cycles_per_token;
+	}
+}
+
+/**
+ * Attach a clone to each selected packet and enqueue them to the ring of the
+ * target.
+ */
+static uint16_t mirror_to(struct ffpp_mirror *mir, struct mirror_target *t,
+			  struct rte_mbuf **sel, uint16_t nb_sel)
+{
+	struct rte_mbuf *clones[FFPP_MIRROR_BURST_MAX];
+	uint16_t nb_clones = 0;
+	uint16_t nb_enq, i;
+
+	if (unlikely(rte_pktmbuf_alloc_bulk(mir->clone_pool, clones, nb_sel) !=
+		     0)) {
+		t->stats.drop_no_mbuf += nb_sel;
+		return 0;
+	}
+	for (i = 0; i < nb_sel; ++i) {
+		if (likely(sel[i]->nb_segs == 1)) {
+			rte_pktmbuf_attach(clones[i], sel[i]);
+			clones[nb_clones++] = clones[i];
+			continue;
+		}
+		// Each segment needs its own indirect mbuf.
+		rte_pktmbuf_free(clones[i]);
+		clones[nb_clones] = rte_pktmbuf_clone(sel[i], mir->clone_pool);
+		if (unlikely(clones[nb_clones] == NULL)) {
+			t->stats.drop_no_mbuf++;
+			continue;
+		}
+		nb_clones++;
+	}
+
+	nb_enq = rte_ring_enqueue_burst(t->cfg.ring, (void **)clones, nb_clones,
+					NULL);
+	if (unlikely(nb_enq < nb_clones)) {
+		rte_pktmbuf_free_bulk(clones + nb_enq, nb_clones - nb_enq);
+		t->stats.drop_ring_full += nb_clones - nb_enq;
+	}
+	t->stats.mirrored += nb_enq;
+	return nb_enq;
+}
+
+static uint16_t mirror_bulk(struct ffpp_mirror *mir, struct rte_mbuf **pkts,
+			    uint16_t n, uint64_t now)
+{
+	struct ffpp_cls_5tuple keys[FFPP_MIRROR_BURST_MAX];
+	struct rte_mbuf *sel[FFPP_MIRROR_BURST_MAX];
+	bool is_ipv4[FFPP_MIRROR_BURST_MAX];
+	struct mirror_target *t;
+	uint16_t nb_mirrored = 0;
+	uint16_t nb_sel, i, j;
+
+	if (mir->match_flows) {
+		for (i = 0; i < n; ++i) {
+			is_ipv4[i] = ffpp_cls_5tuple_of(pkts[i], &keys[i]) == 0;
+		}
+	}
+
+	for (j = 0; j < mir->nb_targets; ++j) {
+		t = &mir->targets[j];
+		if (t->cycles_per_token != 0) {
+			refill(t, now);
+		}
+		nb_sel = 0;
+		for (i = 0; i < n; ++i) {
+			if (t->cfg.match_flow &&
+			    (!is_ipv4[i] ||
+			     memcmp(&keys[i], &t->cfg.flow, sizeof(keys[i])) !=
+				     0)) {
+				continue;
+			}
+			if (!sample(t)) {
+				continue;
+			}
+			if (t->cycles_per_token != 0) {
+				if (t->tokens == 0) {
+					t->stats.drop_rate_limit++;
+					continue;
+				}
+				t->tokens--;
+			}
+			sel[nb_sel++] = pkts[i];
+		}
+		if (nb_sel > 0) {
+			nb_mirrored += mirror_to(mir, t, sel, nb_sel);
+		}
+	}
+	return nb_mirrored;
+}
+
+uint16_t ffpp_mirror_process(struct ffpp_mirror *mir,
+			     const struct ffpp_mvec *vec)
+{
+	uint64_t now = rte_rdtsc();
+	uint16_t nb_mirrored = 0;
+	uint16_t off, n;
+
+	for (off = 0; off < vec->len; off += n) {
+		n = RTE_MIN(vec->len - off, FFPP_MIRROR_BURST_MAX);
+		nb_mirrored += mirror_bulk(mir, vec->head + off, n, now);
+	}
+	return nb_mirrored;
+}
+
+void ffpp_mirror_get_stats(const struct ffpp_mirror *mir, uint16_t target,
+			   struct ffpp_mirror_stats *stats)
+{
+	*stats = mir->targets[target].stats;
+}
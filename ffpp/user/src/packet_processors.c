@@ -2,21 +2,789 @@
  * packet_processors.c
  */
 
+#include <stdbool.h>
+#include <string.h>
+
+#include <rte_byteorder.h>
+#include <rte_ip.h>
 #include <rte_mbuf.h>
+#include <rte_prefetch.h>
+#include <rte_tcp.h>
+#include <rte_udp.h>
+#include <rte_vect.h>
 
+#include <ffpp/checksum.h>
 #include <ffpp/packet_processors.h>
 
+// Headers of the packet PREFETCH_OFFSET iterations ahead are prefetched.
+#define PREFETCH_OFFSET 3
+#define VLAN_HDR_LEN (sizeof(struct rte_vlan_hdr))
+#define MAC_ADDRS_LEN (2 * RTE_ETHER_ADDR_LEN)
+#define SIMD_LANES 8
+
+static __rte_always_inline void prefetch_first(const struct ffpp_mvec *vec)
+{
+	uint16_t i;
+
+	for (i = 0; i < PREFETCH_OFFSET && i < vec->len; ++i) {
+		rte_prefetch0(rte_pktmbuf_mtod(vec->head[i], void *));
+	}
+}
+
+static __rte_always_inline void prefetch_ahead(const struct ffpp_mvec *vec,
+					       uint16_t i)
+{
+	if (i + PREFETCH_OFFSET < vec->len) {
+		rte_prefetch0(
+			rte_pktmbuf_mtod(vec->head[i + PREFETCH_OFFSET], void *));
+	}
+}
+
+/**
+ * Return the IPv4 or IPv6 header (after at most one VLAN tag) and its
+ * EtherType in network byte order. NULL for other packets or if the fixed
+ * header is not in the first segment.
+ */
+static __rte_always_inline void *ip_hdr(struct rte_mbuf *m,
+					uint16_t *ether_type)
+{
+	const struct rte_ether_hdr *eth;
+	uint16_t len = rte_pktmbuf_data_len(m);
+	uint16_t off = RTE_ETHER_HDR_LEN;
+	uint16_t type;
+
+	if (unlikely(len < RTE_ETHER_HDR_LEN)) {
+		return NULL;
+	}
+	eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+	type = eth->ether_type;
+	if (type == RTE_BE16(RTE_ETHER_TYPE_VLAN)) {
+		if (unlikely(len < off + VLAN_HDR_LEN)) {
+			return NULL;
+		}
+		type = ((const struct rte_vlan_hdr *)(eth + 1))->eth_proto;
+		off += VLAN_HDR_LEN;
+	}
+	if (type == RTE_BE16(RTE_ETHER_TYPE_IPV4)) {
+		if (unlikely(len < off + sizeof(struct rte_ipv4_hdr))) {
+			return NULL;
+		}
+	} else if (type == RTE_BE16(RTE_ETHER_TYPE_IPV6)) {
+		if (unlikely(len < off + sizeof(struct rte_ipv6_hdr))) {
+			return NULL;
+		}
+	} else {
+		return NULL;
+	}
+	*ether_type = type;
+	return rte_pktmbuf_mtod_offset(m, void *, off);
+}
+
+/* MAC rewrite */
+
+static __rte_always_inline void
+rewrite_dl_one(struct rte_mbuf *m, const struct rte_ether_addr *dl_src,
+	       const struct rte_ether_addr *dl_dst)
+{
+	struct rte_ether_hdr *eth;
+
+	if (unlikely(rte_pktmbuf_data_len(m) < RTE_ETHER_HDR_LEN)) {
+		return;
+	}
+	eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+	if (dl_dst != NULL) {
+		rte_ether_addr_copy(dl_dst, &eth->d_addr);
+	}
+	if (dl_src != NULL) {
+		rte_ether_addr_copy(dl_src, &eth->s_addr);
+	}
+}
+
+static __rte_always_inline void
+rewrite_dl_scalar(struct ffpp_mvec *vec, const struct rte_ether_addr *dl_src,
+		  const struct rte_ether_addr *dl_dst)
+{
+	uint16_t i;
+
+	prefetch_first(vec);
+	for (i = 0; i < vec->len; ++i) {
+		prefetch_ahead(vec, i);
+		rewrite_dl_one(vec->head[i], dl_src, dl_dst);
+	}
+}
+
+#if defined(__SSE4_1__)
+/* Blend the addresses into the first 16 bytes of the frame. */
+static __rte_always_inline void
+rewrite_dl_sse(struct ffpp_mvec *vec, const struct rte_ether_addr *dl_src,
+	       const struct rte_ether_addr *dl_dst)
+{
+	uint8_t addrs[sizeof(__m128i)] = { 0 };
+	uint8_t select[sizeof(__m128i)] = { 0 };
+	__m128i v_addrs, v_select;
+	__m128i *hdr;
+	struct rte_mbuf *m;
+	uint16_t i;
+
+	if (dl_dst != NULL) {
+		memcpy(addrs, dl_dst, RTE_ETHER_ADDR_LEN);
+		memset(select, 0xff, RTE_ETHER_ADDR_LEN);
+	}
+	if (dl_src != NULL) {
+		memcpy(addrs + RTE_ETHER_ADDR_LEN, dl_src, RTE_ETHER_ADDR_LEN);
+		memset(select + RTE_ETHER_ADDR_LEN, 0xff, RTE_ETHER_ADDR_LEN);
+	}
+	v_addrs = _mm_loadu_si128((const __m128i *)addrs);
+	v_select = _mm_loadu_si128((const __m128i *)select);
+
+	prefetch_first(vec);
+	for (i = 0; i < vec->len; ++i) {
+		prefetch_ahead(vec, i);
+		m = vec->head[i];
+		if (unlikely(rte_pktmbuf_data_len(m) < sizeof(__m128i))) {
+			rewrite_dl_one(m, dl_src, dl_dst);
+			continue;
+		}
+		hdr = rte_pktmbuf_mtod(m, __m128i *);
+		_mm_storeu_si128(hdr, _mm_blendv_epi8(_mm_loadu_si128(hdr),
+						      v_addrs, v_select));
+	}
+}
+#endif
+
+static __rte_always_inline void
+rewrite_dl(struct ffpp_mvec *vec, const struct rte_ether_addr *dl_src,
+	   const struct rte_ether_addr *dl_dst)
+{
+#if defined(__SSE4_1__)
+	rewrite_dl_sse(vec, dl_src, dl_dst);
+#else
+	rewrite_dl_scalar(vec, dl_src, dl_dst);
+#endif
+}
+
 void ffpp_pp_update_dl_dst(struct ffpp_mvec *vec,
 			   const struct rte_ether_addr *dl_dst)
+{
+	rewrite_dl(vec, NULL, dl_dst);
+}
+
+void ffpp_pp_update_dl_src(struct ffpp_mvec *vec,
+			   const struct rte_ether_addr *dl_src)
+{
+	rewrite_dl(vec, dl_src, NULL);
+}
+
+void ffpp_pp_rewrite_dl(struct ffpp_mvec *vec,
+			const struct rte_ether_addr *dl_src,
+			const struct rte_ether_addr *dl_dst)
+{
+	rewrite_dl(vec, dl_src, dl_dst);
+}
+
+void ffpp_pp_rewrite_dl_scalar(struct ffpp_mvec *vec,
+			       const struct rte_ether_addr *dl_src,
+			       const struct rte_ether_addr *dl_dst)
+{
+	rewrite_dl_scalar(vec, dl_src, dl_dst);
+}
+
+/* MAC swap */
+
+static __rte_always_inline void swap_dl_one(struct rte_mbuf *m)
+{
+	struct rte_ether_hdr *eth;
+	struct rte_ether_addr tmp;
+
+	if (unlikely(rte_pktmbuf_data_len(m) < RTE_ETHER_HDR_LEN)) {
+		return;
+	}
+	eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+	rte_ether_addr_copy(&eth->d_addr, &tmp);
+	rte_ether_addr_copy(&eth->s_addr, &eth->d_addr);
+	rte_ether_addr_copy(&tmp, &eth->s_addr);
+}
+
+void ffpp_pp_swap_dl_scalar(struct ffpp_mvec *vec)
 {
 	uint16_t i;
+
+	prefetch_first(vec);
+	for (i = 0; i < vec->len; ++i) {
+		prefetch_ahead(vec, i);
+		swap_dl_one(vec->head[i]);
+	}
+}
+
+void ffpp_pp_swap_dl(struct ffpp_mvec *vec)
+{
+#if defined(__SSSE3__)
+	const __m128i shuffle = _mm_setr_epi8(6, 7, 8, 9, 10, 11, 0, 1, 2, 3,
+					      4, 5, 12, 13, 14, 15);
 	struct rte_mbuf *m;
+	__m128i *hdr;
+	uint16_t i;
+
+	prefetch_first(vec);
+	for (i = 0; i < vec->len; ++i) {
+		prefetch_ahead(vec, i);
+		m = vec->head[i];
+		if (unlikely(rte_pktmbuf_data_len(m) < sizeof(__m128i))) {
+			swap_dl_one(m);
+			continue;
+		}
+		hdr = rte_pktmbuf_mtod(m, __m128i *);
+		_mm_storeu_si128(hdr, _mm_shuffle_epi8(_mm_loadu_si128(hdr),
+						       shuffle));
+	}
+#else
+	ffpp_pp_swap_dl_scalar(vec);
+#endif
+}
+
+/* VLAN push/pop */
+
+static __rte_always_inline uint16_t vlan_push_one(struct rte_mbuf *m,
+						  rte_be16_t tci)
+{
+	struct rte_ether_hdr *eth;
+	uint8_t *p;
+
+	if (unlikely(rte_pktmbuf_data_len(m) < RTE_ETHER_HDR_LEN)) {
+		return 0;
+	}
+	p = (uint8_t *)rte_pktmbuf_prepend(m, VLAN_HDR_LEN);
+	if (unlikely(p == NULL)) {
+		return 0;
+	}
+	memmove(p, p + VLAN_HDR_LEN, MAC_ADDRS_LEN);
+	eth = (struct rte_ether_hdr *)p;
+	// The original EtherType is already at the place of eth_proto.
+	eth->ether_type = RTE_BE16(RTE_ETHER_TYPE_VLAN);
+	((struct rte_vlan_hdr *)(eth + 1))->vlan_tci = tci;
+	return 1;
+}
+
+uint16_t ffpp_pp_vlan_push_scalar(struct ffpp_mvec *vec, uint16_t tci)
+{
+	rte_be16_t tci_be = rte_cpu_to_be_16(tci);
+	uint16_t nb_tagged = 0;
+	uint16_t i;
+
+	prefetch_first(vec);
+	for (i = 0; i < vec->len; ++i) {
+		prefetch_ahead(vec, i);
+		nb_tagged += vlan_push_one(vec->head[i], tci_be);
+	}
+	return nb_tagged;
+}
+
+uint16_t ffpp_pp_vlan_push(struct ffpp_mvec *vec, uint16_t tci)
+{
+#if defined(__SSSE3__)
+	// Move the MAC addresses 4 bytes ahead and fill in TPID and TCI.
+	const __m128i shuffle =
+		_mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, -128, -128,
+			      -128, -128);
+	const __m128i tag = _mm_setr_epi8(
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		(char)(RTE_ETHER_TYPE_VLAN >> 8),
+		(char)(RTE_ETHER_TYPE_VLAN & 0xff), (char)(tci >> 8),
+		(char)(tci & 0xff));
+	rte_be16_t tci_be = rte_cpu_to_be_16(tci);
+	uint16_t nb_tagged = 0;
+	struct rte_mbuf *m;
+	__m128i hdr;
+	void *p;
+	uint16_t i;
+
+	prefetch_first(vec);
+	for (i = 0; i < vec->len; ++i) {
+		prefetch_ahead(vec, i);
+		m = vec->head[i];
+		if (unlikely(rte_pktmbuf_data_len(m) < sizeof(__m128i))) {
+			nb_tagged += vlan_push_one(m, tci_be);
+			continue;
+		}
+		hdr = _mm_loadu_si128(rte_pktmbuf_mtod(m, __m128i *));
+		p = rte_pktmbuf_prepend(m, VLAN_HDR_LEN);
+		if (unlikely(p == NULL)) {
+			continue;
+		}
+		_mm_storeu_si128((__m128i *)p,
+				 _mm_or_si128(_mm_shuffle_epi8(hdr, shuffle),
+					      tag));
+		nb_tagged++;
+	}
+	return nb_tagged;
+#else
+	return ffpp_pp_vlan_push_scalar(vec, tci);
+#endif
+}
+
+static __rte_always_inline struct rte_ether_hdr *
+vlan_pop_prepare(struct rte_mbuf *m, uint16_t min_len)
+{
+	struct rte_ether_hdr *eth;
+
+	if (unlikely(rte_pktmbuf_data_len(m) < min_len)) {
+		return NULL;
+	}
+	eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+	if (eth->ether_type != RTE_BE16(RTE_ETHER_TYPE_VLAN)) {
+		return NULL;
+	}
+	m->vlan_tci = rte_be_to_cpu_16(
+		((const struct rte_vlan_hdr *)(eth + 1))->vlan_tci);
+	m->ol_flags |= PKT_RX_VLAN | PKT_RX_VLAN_STRIPPED;
+	return eth;
+}
+
+static __rte_always_inline uint16_t vlan_pop_one(struct rte_mbuf *m)
+{
 	struct rte_ether_hdr *eth;
 
-	FFPP_MVEC_FOREACH(vec, i, m)
-	{
-		rte_prefetch0(rte_pktmbuf_mtod(m, void *));
-		eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
-		rte_ether_addr_copy(dl_dst, &eth->s_addr);
+	eth = vlan_pop_prepare(m, RTE_ETHER_HDR_LEN + VLAN_HDR_LEN);
+	if (eth == NULL) {
+		return 0;
+	}
+	memmove((uint8_t *)eth + VLAN_HDR_LEN, eth, MAC_ADDRS_LEN);
+	rte_pktmbuf_adj(m, VLAN_HDR_LEN);
+	return 1;
+}
+
+uint16_t ffpp_pp_vlan_pop_scalar(struct ffpp_mvec *vec)
+{
+	uint16_t nb_untagged = 0;
+	uint16_t i;
+
+	prefetch_first(vec);
+	for (i = 0; i < vec->len; ++i) {
+		prefetch_ahead(vec, i);
+		nb_untagged += vlan_pop_one(vec->head[i]);
+	}
+	return nb_untagged;
+}
+
+uint16_t ffpp_pp_vlan_pop(struct ffpp_mvec *vec)
+{
+#if defined(__SSE4_1__)
+	uint16_t nb_untagged = 0;
+	struct rte_ether_hdr *eth;
+	struct rte_mbuf *m;
+	__m128i hdr, shifted;
+	uint16_t i;
+
+	prefetch_first(vec);
+	for (i = 0; i < vec->len; ++i) {
+		prefetch_ahead(vec, i);
+		m = vec->head[i];
+		if (unlikely(rte_pktmbuf_data_len(m) <
+			     VLAN_HDR_LEN + sizeof(__m128i))) {
+			nb_untagged += vlan_pop_one(m);
+			continue;
+		}
+		eth = vlan_pop_prepare(m, VLAN_HDR_LEN + sizeof(__m128i));
+		if (eth == NULL) {
+			continue;
+		}
+		// MAC addresses from the first load, the inner EtherType and
+		// the 2 bytes after it from the second one.
+		hdr = _mm_loadu_si128((const __m128i *)eth);
+		shifted = _mm_loadu_si128(
+			(const __m128i *)((uint8_t *)eth + VLAN_HDR_LEN));
+		_mm_storeu_si128((__m128i *)((uint8_t *)eth + VLAN_HDR_LEN),
+				 _mm_blend_epi16(hdr, shifted, 0xc0));
+		rte_pktmbuf_adj(m, VLAN_HDR_LEN);
+		nb_untagged++;
+	}
+	return nb_untagged;
+#else
+	return ffpp_pp_vlan_pop_scalar(vec);
+#endif
+}
+
+/* TTL and DSCP */
+
+/* Keep the i-th packet at the head of the vector, the order is kept. */
+static __rte_always_inline void keep_packet(struct ffpp_mvec *vec, uint16_t i,
+					    uint16_t *nb_keep)
+{
+	struct rte_mbuf *tmp;
+
+	if (i != *nb_keep) {
+		tmp = vec->head[*nb_keep];
+		vec->head[*nb_keep] = vec->head[i];
+		vec->head[i] = tmp;
+	}
+	(*nb_keep)++;
+}
+
+static __rte_always_inline bool dec_hop_limit(struct rte_ipv6_hdr *ip6)
+{
+	if (ip6->hop_limits <= 1) {
+		return false;
+	}
+	ip6->hop_limits--;
+	return true;
+}
+
+/* Return false if the packet expires. */
+static __rte_always_inline bool dec_ttl_one(struct rte_mbuf *m)
+{
+	struct rte_ipv4_hdr *ip;
+	uint16_t ether_type, old, new;
+	void *l3;
+
+	l3 = ip_hdr(m, &ether_type);
+	if (l3 == NULL) {
+		return true;
+	}
+	if (ether_type == RTE_BE16(RTE_ETHER_TYPE_IPV6)) {
+		return dec_hop_limit(l3);
+	}
+	ip = l3;
+	if (ip->time_to_live <= 1) {
+		return false;
+	}
+	// TTL and protocol are one 16-bit word of the checksum.
+	memcpy(&old, &ip->time_to_live, sizeof(old));
+	ip->time_to_live--;
+	memcpy(&new, &ip->time_to_live, sizeof(new));
+	ip->hdr_checksum = ffpp_csum_replace16(ip->hdr_checksum, old, new);
+	return true;
+}
+
+uint16_t ffpp_pp_dec_ttl_scalar(struct ffpp_mvec *vec)
+{
+	uint16_t nb_keep = 0;
+	uint16_t i;
+
+	prefetch_first(vec);
+	for (i = 0; i < vec->len; ++i) {
+		prefetch_ahead(vec, i);
+		if (dec_ttl_one(vec->head[i])) {
+			keep_packet(vec, i, &nb_keep);
+		}
+	}
+	return nb_keep;
+}
+
+static __rte_always_inline void mark_dscp_one(struct rte_mbuf *m,
+					      uint8_t dscp)
+{
+	struct rte_ipv6_hdr *ip6;
+	struct rte_ipv4_hdr *ip;
+	uint16_t ether_type, old, new;
+	uint32_t vtc_flow;
+	void *l3;
+
+	l3 = ip_hdr(m, &ether_type);
+	if (l3 == NULL) {
+		return;
+	}
+	if (ether_type == RTE_BE16(RTE_ETHER_TYPE_IPV6)) {
+		ip6 = l3;
+		vtc_flow = rte_be_to_cpu_32(ip6->vtc_flow);
+		vtc_flow = (vtc_flow & ~(0xfcU << 20)) | ((uint32_t)dscp << 22);
+		ip6->vtc_flow = rte_cpu_to_be_32(vtc_flow);
+		return;
+	}
+	ip = l3;
+	memcpy(&old, ip, sizeof(old));
+	ip->type_of_service = (dscp << 2) | (ip->type_of_service & 0x03);
+	memcpy(&new, ip, sizeof(new));
+	ip->hdr_checksum = ffpp_csum_replace16(ip->hdr_checksum, old, new);
+}
+
+void ffpp_pp_mark_dscp_scalar(struct ffpp_mvec *vec, uint8_t dscp)
+{
+	uint16_t i;
+
+	prefetch_first(vec);
+	for (i = 0; i < vec->len; ++i) {
+		prefetch_ahead(vec, i);
+		mark_dscp_one(vec->head[i], dscp & 0x3f);
+	}
+}
+
+#if defined(__AVX2__)
+/*
+ * The IPv4 header words of 8 packets are gathered into one register and the
+ * checksums are updated in 32-bit lanes. Lanes of other packets point to a
+ * dummy word and their results are ignored.
+ */
+
+static __rte_always_inline __m256i gather_words(const void *const addrs[])
+{
+	__m128i lo, hi;
+
+	lo = _mm256_i64gather_epi32(
+		(const int *)0, _mm256_loadu_si256((const __m256i *)addrs), 1);
+	hi = _mm256_i64gather_epi32(
+		(const int *)0,
+		_mm256_loadu_si256((const __m256i *)(addrs + 4)), 1);
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+/* HC' = ~(~HC + ~m + m') in each lane, all values are 16-bit. */
+static __rte_always_inline __m256i csum_update_x8(__m256i csum, __m256i old,
+						   __m256i new)
+{
+	const __m256i lo16 = _mm256_set1_epi32(0xffff);
+	__m256i sum;
+
+	sum = _mm256_add_epi32(_mm256_xor_si256(csum, lo16),
+			       _mm256_xor_si256(old, lo16));
+	sum = _mm256_add_epi32(sum, new);
+	sum = _mm256_add_epi32(_mm256_and_si256(sum, lo16),
+			       _mm256_srli_epi32(sum, 16));
+	sum = _mm256_add_epi32(_mm256_and_si256(sum, lo16),
+			       _mm256_srli_epi32(sum, 16));
+	return _mm256_xor_si256(sum, lo16);
+}
+
+static uint16_t dec_ttl_avx2(struct ffpp_mvec *vec)
+{
+	const __m256i lo16 = _mm256_set1_epi32(0xffff);
+	const __m256i two = _mm256_set1_epi32(2);
+	const __m256i ttl_mask = _mm256_set1_epi32(0xff);
+	const uint32_t dummy = 0;
+	const void *addrs[SIMD_LANES];
+	uint32_t words[SIMD_LANES];
+	bool keep[SIMD_LANES];
+	struct rte_ipv4_hdr *ip;
+	__m256i w, old, new, csum;
+	uint16_t nb_keep = 0;
+	uint16_t ether_type;
+	uint16_t i, j;
+	uint32_t v4_lanes;
+	int expired;
+	void *l3;
+
+	prefetch_first(vec);
+	for (i = 0; i + SIMD_LANES <= vec->len; i += SIMD_LANES) {
+		v4_lanes = 0;
+		for (j = 0; j < SIMD_LANES; ++j) {
+			prefetch_ahead(vec, i + j);
+			addrs[j] = &dummy;
+			keep[j] = true;
+			l3 = ip_hdr(vec->head[i + j], &ether_type);
+			if (l3 == NULL) {
+				continue;
+			}
+			if (ether_type == RTE_BE16(RTE_ETHER_TYPE_IPV6)) {
+				keep[j] = dec_hop_limit(l3);
+				continue;
+			}
+			ip = l3;
+			// TTL, protocol and checksum.
+			addrs[j] = &ip->time_to_live;
+			v4_lanes |= 1U << j;
+		}
+
+		if (v4_lanes != 0) {
+			w = gather_words(addrs);
+			old = _mm256_and_si256(w, lo16);
+			// The TTL is the low byte on little endian.
+			new = _mm256_sub_epi32(old, _mm256_set1_epi32(1));
+			csum = csum_update_x8(_mm256_srli_epi32(w, 16), old,
+					      new);
+			expired = _mm256_movemask_ps(_mm256_castsi256_ps(
+				_mm256_cmpgt_epi32(two,
+						   _mm256_and_si256(w, ttl_mask))));
+			_mm256_storeu_si256(
+				(__m256i *)words,
+				_mm256_or_si256(new,
+						_mm256_slli_epi32(csum, 16)));
+			for (j = 0; j < SIMD_LANES; ++j) {
+				if (!(v4_lanes & (1U << j))) {
+					continue;
+				}
+				if (expired & (1 << j)) {
+					keep[j] = false;
+					continue;
+				}
+				memcpy((void *)(uintptr_t)addrs[j], &words[j],
+				       sizeof(words[j]));
+			}
+		}
+
+		for (j = 0; j < SIMD_LANES; ++j) {
+			if (keep[j]) {
+				keep_packet(vec, i + j, &nb_keep);
+			}
+		}
+	}
+
+	for (; i < vec->len; ++i) {
+		prefetch_ahead(vec, i);
+		if (dec_ttl_one(vec->head[i])) {
+			keep_packet(vec, i, &nb_keep);
+		}
+	}
+	return nb_keep;
+}
+
+static void mark_dscp_avx2(struct ffpp_mvec *vec, uint8_t dscp)
+{
+	const __m256i lo16 = _mm256_set1_epi32(0xffff);
+	// Keep version, IHL and ECN. The TOS is the high byte on little endian.
+	const __m256i keep_mask = _mm256_set1_epi32(0x03ff);
+	const __m256i dscp_bits = _mm256_set1_epi32((uint32_t)dscp << 10);
+	const uint32_t dummy = 0;
+	const void *tos_addrs[SIMD_LANES];
+	const void *csum_addrs[SIMD_LANES];
+	uint32_t words[SIMD_LANES];
+	struct rte_ipv4_hdr *ip;
+	__m256i old, new, csum;
+	uint16_t ether_type;
+	uint16_t i, j;
+	uint32_t v4_lanes;
+	void *l3;
+
+	prefetch_first(vec);
+	for (i = 0; i + SIMD_LANES <= vec->len; i += SIMD_LANES) {
+		v4_lanes = 0;
+		for (j = 0; j < SIMD_LANES; ++j) {
+			prefetch_ahead(vec, i + j);
+			tos_addrs[j] = &dummy;
+			csum_addrs[j] = &dummy;
+			l3 = ip_hdr(vec->head[i + j], &ether_type);
+			if (l3 == NULL) {
+				continue;
+			}
+			if (ether_type == RTE_BE16(RTE_ETHER_TYPE_IPV6)) {
+				mark_dscp_one(vec->head[i + j], dscp);
+				continue;
+			}
+			ip = l3;
+			tos_addrs[j] = ip;
+			csum_addrs[j] = &ip->time_to_live;
+			v4_lanes |= 1U << j;
+		}
+		if (v4_lanes == 0) {
+			continue;
+		}
+
+		old = _mm256_and_si256(gather_words(tos_addrs), lo16);
+		new = _mm256_or_si256(_mm256_and_si256(old, keep_mask),
+				      dscp_bits);
+		csum = csum_update_x8(
+			_mm256_srli_epi32(gather_words(csum_addrs), 16), old,
+			new);
+		_mm256_storeu_si256((__m256i *)words,
+				    _mm256_or_si256(new,
+						    _mm256_slli_epi32(csum, 16)));
+		for (j = 0; j < SIMD_LANES; ++j) {
+			if (!(v4_lanes & (1U << j))) {
+				continue;
+			}
+			ip = (struct rte_ipv4_hdr *)(uintptr_t)tos_addrs[j];
+			ip->type_of_service = (uint8_t)(words[j] >> 8);
+			ip->hdr_checksum = (uint16_t)(words[j] >> 16);
+		}
+	}
+
+	for (; i < vec->len; ++i) {
+		prefetch_ahead(vec, i);
+		mark_dscp_one(vec->head[i], dscp);
+	}
+}
+#endif
+
+uint16_t ffpp_pp_dec_ttl(struct ffpp_mvec *vec)
+{
+#if defined(__AVX2__)
+	return dec_ttl_avx2(vec);
+#else
+	return ffpp_pp_dec_ttl_scalar(vec);
+#endif
+}
+
+void ffpp_pp_mark_dscp(struct ffpp_mvec *vec, uint8_t dscp)
+{
+#if defined(__AVX2__)
+	mark_dscp_avx2(vec, dscp & 0x3f);
+#else
+	ffpp_pp_mark_dscp_scalar(vec, dscp);
+#endif
+}
+
+/* NAT */
+
+static __rte_always_inline void nat_rewrite_one(struct rte_mbuf *m,
+						const struct ffpp_pp_nat *nat)
+{
+	const uint8_t *end =
+		rte_pktmbuf_mtod(m, uint8_t *) + rte_pktmbuf_data_len(m);
+	struct rte_udp_hdr *udp = NULL;
+	struct rte_tcp_hdr *tcp = NULL;
+	// UDP and TCP have the ports at the same offsets.
+	struct rte_udp_hdr *ports = NULL;
+	struct rte_ipv4_hdr *ip;
+	uint32_t ip_diff = 0;
+	uint32_t l4_diff;
+	uint16_t ether_type;
+	uint8_t *l4;
+
+	ip = ip_hdr(m, &ether_type);
+	if (ip == NULL || ether_type != RTE_BE16(RTE_ETHER_TYPE_IPV4)) {
+		return;
+	}
+	l4 = (uint8_t *)ip + (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) *
+				     RTE_IPV4_IHL_MULTIPLIER;
+	if ((ip->fragment_offset & RTE_BE16(RTE_IPV4_HDR_OFFSET_MASK)) == 0) {
+		if (ip->next_proto_id == IPPROTO_TCP &&
+		    l4 + sizeof(struct rte_tcp_hdr) <= end) {
+			tcp = (struct rte_tcp_hdr *)l4;
+			ports = (struct rte_udp_hdr *)l4;
+		} else if (ip->next_proto_id == IPPROTO_UDP &&
+			   l4 + sizeof(struct rte_udp_hdr) <= end) {
+			udp = (struct rte_udp_hdr *)l4;
+			ports = udp;
+		}
+	}
+
+	if (nat->flags & FFPP_PP_NAT_SRC_ADDR) {
+		ip_diff += ffpp_csum_diff32(ip->src_addr, nat->src_addr);
+		ip->src_addr = nat->src_addr;
+	}
+	if (nat->flags & FFPP_PP_NAT_DST_ADDR) {
+		ip_diff += ffpp_csum_diff32(ip->dst_addr, nat->dst_addr);
+		ip->dst_addr = nat->dst_addr;
+	}
+	if (ip_diff != 0) {
+		ip->hdr_checksum = ffpp_csum_apply(ip->hdr_checksum, ip_diff);
+	}
+	if (ports == NULL) {
+		return;
+	}
+
+	// The pseudo header contains the addresses.
+	l4_diff = ip_diff;
+	if (nat->flags & FFPP_PP_NAT_SRC_PORT) {
+		l4_diff += ffpp_csum_diff16(ports->src_port, nat->src_port);
+		ports->src_port = nat->src_port;
+	}
+	if (nat->flags & FFPP_PP_NAT_DST_PORT) {
+		l4_diff += ffpp_csum_diff16(ports->dst_port, nat->dst_port);
+		ports->dst_port = nat->dst_port;
+	}
+	if (tcp != NULL) {
+		tcp->cksum = ffpp_csum_apply(tcp->cksum, l4_diff);
+	} else {
+		udp->dgram_cksum = ffpp_csum_udp_apply(udp->dgram_cksum, l4_diff);
+	}
+}
+
+void ffpp_pp_nat_rewrite(struct ffpp_mvec *vec, const struct ffpp_pp_nat *nat)
+{
+	uint16_t i;
+
+	prefetch_first(vec);
+	for (i = 0; i < vec->len; ++i) {
+		prefetch_ahead(vec, i);
+		nat_rewrite_one(vec->head[i], nat);
 	}
 }
@@ -0,0 +1,761 @@
+/*
+ * pcap.c
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <rte_atomic.h>
+#include <rte_branch_prediction.h>
+#include <rte_byteorder.h>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+#include <rte_log.h>
+#include <rte_mbuf.h>
+#include <rte_mbuf_dyn.h>
+#include <rte_memcpy.h>
+#include <rte_pause.h>
+#include <rte_prefetch.h>
+
+#include <ffpp/config.h>
+#include <ffpp/pcap.h>
+
+#define PCAP_MAGIC_USEC 0xa1b2c3d4
+#define PCAP_MAGIC_NSEC 0xa1b23c4d
+#define PCAP_GLOBAL_HDR_LEN 24
+#define PCAP_RECORD_HDR_LEN 16
+#define PCAP_LINKTYPE_ETHERNET 1
+
+#define PCAPNG_BLOCK_SHB 0x0A0D0D0A
+#define PCAPNG_BLOCK_IDB 0x00000001
+#define PCAPNG_BLOCK_SPB 0x00000003
+#define PCAPNG_BLOCK_EPB 0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define PCAPNG_OPT_ENDOFOPT 0
+#define PCAPNG_OPT_IF_TSRESOL 9
+
+#define PCAP_REPLAY_BURST_MAX 64
+#define PCAP_WRITER_BURST 64
+
+#define NSEC_PER_SEC 1000000000ULL
+
+/*******************
+ *  Reader helpers  *
+ *******************/
+
+static __rte_always_inline uint16_t rd16(const struct ffpp_pcap_reader *r,
+					 const uint8_t *p)
+{
+	uint16_t v;
+	memcpy(&v, p, sizeof(v));
+	return r->swapped ? rte_bswap16(v) : v;
+}
+
+static __rte_always_inline uint32_t rd32(const struct ffpp_pcap_reader *r,
+					 const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return r->swapped ? rte_bswap32(v) : v;
+}
+
+static __rte_always_inline uint64_t ticks_to_ns(uint64_t ticks, uint64_t mult,
+						uint64_t div)
+{
+	if (div == 1) {
+		return ticks * mult;
+	}
+	return (ticks / div) * mult +
+	       (uint64_t)(((unsigned __int128)(ticks % div) * mult) / div);
+}
+
+static void set_ts_resolution(struct ffpp_pcap_reader *r, uint16_t iface,
+			      uint8_t tsresol)
+{
+	uint8_t exp = tsresol & 0x7F;
+
+	if (tsresol & 0x80) {
+		// Negative power of 2.
+		r->ts_mult[iface] = NSEC_PER_SEC;
+		r->ts_div[iface] = 1ULL << RTE_MIN(exp, 63);
+		return;
+	}
+	// Negative power of 10.
+	r->ts_mult[iface] = 1;
+	r->ts_div[iface] = 1;
+	if (exp <= 9) {
+		while (exp++ < 9) {
+			r->ts_mult[iface] *= 10;
+		}
+	} else {
+		exp = RTE_MIN(exp, 19);
+		while (exp-- > 9) {
+			r->ts_div[iface] *= 10;
+		}
+	}
+}
+
+static void pcapng_parse_idb(struct ffpp_pcap_reader *r, const uint8_t *blk,
+			     uint32_t blk_len)
+{
+	uint16_t iface = r->nb_ifaces;
+	const uint8_t *opt = blk + 16;
+	const uint8_t *end = blk + blk_len - 4;
+
+	if (iface >= FFPP_PCAP_MAX_IFACES) {
+		RTE_LOG(WARNING, FFPP,
+			"PCAP: Too many interfaces, extra ones are ignored.\n");
+		return;
+	}
+	r->nb_ifaces++;
+	if (iface == 0) {
+		r->link_type = rd16(r, blk + 8);
+	}
+	// Microseconds is the default resolution.
+	set_ts_resolution(r, iface, 6);
+
+	while (opt + 4 <= end) {
+		uint16_t code = rd16(r, opt);
+		uint16_t len = rd16(r, opt + 2);
+		if (code == PCAPNG_OPT_ENDOFOPT) {
+			break;
+		}
+		if (code == PCAPNG_OPT_IF_TSRESOL && len == 1) {
+			set_ts_resolution(r, iface, *(opt + 4));
+		}
+		opt += 4 + RTE_ALIGN_CEIL(len, 4);
+	}
+}
+
+/**
+ * Get the next packet of a PCAPNG file. Non-packet blocks are parsed or
+ * skipped on the way.
+ *
+ * @return 1 if a packet is found, 0 at the end or on a truncated file.
+ */
+static int pcapng_next(struct ffpp_pcap_reader *r, const uint8_t **data,
+		       uint32_t *cap_len, uint64_t *ts_ns)
+{
+	while (r->off + 12 <= r->map_len) {
+		const uint8_t *blk = r->map + r->off;
+		uint32_t type;
+		uint32_t blk_len;
+
+		memcpy(&type, blk, sizeof(type));
+		if (type == PCAPNG_BLOCK_SHB) {
+			uint32_t bom;
+			memcpy(&bom, blk + 8, sizeof(bom));
+			r->swapped = (bom != PCAPNG_BYTE_ORDER_MAGIC);
+			// Interface IDs are local to a section.
+			r->nb_ifaces = 0;
+		} else {
+			type = r->swapped ? rte_bswap32(type) : type;
+		}
+
+		blk_len = rd32(r, blk + 4);
+		if (blk_len < 12 || (blk_len & 0x3) != 0 ||
+		    r->off + blk_len > r->map_len) {
+			RTE_LOG(WARNING, FFPP,
+				"PCAP: Truncated or corrupted block at offset %zu.\n",
+				r->off);
+			r->off = r->map_len;
+			return 0;
+		}
+		r->off += blk_len;
+
+		if (type == PCAPNG_BLOCK_IDB) {
+			pcapng_parse_idb(r, blk, blk_len);
+		} else if (type == PCAPNG_BLOCK_EPB && blk_len >= 32) {
+			uint32_t iface = rd32(r, blk + 8);
+			uint64_t ticks = ((uint64_t)rd32(r, blk + 12) << 32) |
+					 rd32(r, blk + 16);
+			*cap_len = RTE_MIN(rd32(r, blk + 20), blk_len - 32);
+			*data = blk + 28;
+			if (iface >= r->nb_ifaces) {
+				iface = 0;
+			}
+			*ts_ns = ticks_to_ns(ticks, r->ts_mult[iface],
+					     r->ts_div[iface]);
+			return 1;
+		} else if (type == PCAPNG_BLOCK_SPB && blk_len >= 16) {
+			*cap_len = RTE_MIN(rd32(r, blk + 8), blk_len - 16);
+			*data = blk + 12;
+			// Simple packet blocks have no timestamp.
+			*ts_ns = 0;
+			return 1;
+		}
+	}
+	r->off = r->map_len;
+	return 0;
+}
+
+static int pcap_next(struct ffpp_pcap_reader *r, const uint8_t **data,
+		     uint32_t *cap_len, uint64_t *ts_ns)
+{
+	const uint8_t *rec = r->map + r->off;
+	uint32_t len;
+
+	if (r->off + PCAP_RECORD_HDR_LEN > r->map_len) {
+		r->off = r->map_len;
+		return 0;
+	}
+	len = rd32(r, rec + 8);
+	if (r->off + PCAP_RECORD_HDR_LEN + len > r->map_len) {
+		RTE_LOG(WARNING, FFPP,
+			"PCAP: Truncated record at offset %zu.\n", r->off);
+		r->off = r->map_len;
+		return 0;
+	}
+	*ts_ns = (uint64_t)rd32(r, rec) * NSEC_PER_SEC +
+		 (uint64_t)rd32(r, rec + 4) * r->ts_mult[0];
+	*cap_len = len;
+	*data = rec + PCAP_RECORD_HDR_LEN;
+	r->off += PCAP_RECORD_HDR_LEN + len;
+	return 1;
+}
+
+/************
+ *  Reader  *
+ ************/
+
+int ffpp_pcap_reader_open(struct ffpp_pcap_reader *r, const char *path)
+{
+	struct stat st;
+	uint32_t magic;
+	int fd;
+	void *map;
+
+	memset(r, 0, sizeof(*r));
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		rte_errno = errno;
+		RTE_LOG(ERR, FFPP, "PCAP: Can not open file: %s\n", path);
+		return -1;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size < PCAP_GLOBAL_HDR_LEN) {
+		rte_errno = EINVAL;
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd,
+		   0);
+	// The mapping stays valid after the file descriptor is closed.
+	close(fd);
+	if (map == MAP_FAILED) {
+		rte_errno = errno;
+		RTE_LOG(ERR, FFPP, "PCAP: Can not map file: %s\n", path);
+		return -1;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	r->map = map;
+	r->map_len = st.st_size;
+
+	memcpy(&magic, r->map, sizeof(magic));
+	switch (magic) {
+	case PCAP_MAGIC_USEC:
+	case PCAP_MAGIC_NSEC:
+		r->swapped = 0;
+		break;
+	case RTE_STATIC_BSWAP32(PCAP_MAGIC_USEC):
+	case RTE_STATIC_BSWAP32(PCAP_MAGIC_NSEC):
+		r->swapped = 1;
+		break;
+	case PCAPNG_BLOCK_SHB:
+		r->format = FFPP_PCAP_FORMAT_PCAPNG;
+		break;
+	default:
+		RTE_LOG(ERR, FFPP, "PCAP: Unknown file format: %s\n", path);
+		ffpp_pcap_reader_close(r);
+		rte_errno = EINVAL;
+		return -1;
+	}
+
+	if (r->format == FFPP_PCAP_FORMAT_PCAP) {
+		magic = rd32(r, r->map);
+		r->ts_mult[0] = (magic == PCAP_MAGIC_NSEC) ? 1 : 1000;
+		r->ts_div[0] = 1;
+		r->link_type = rd32(r, r->map + 20);
+		r->nb_ifaces = 1;
+		r->first_off = PCAP_GLOBAL_HDR_LEN;
+	} else {
+		r->first_off = 0;
+	}
+	r->off = r->first_off;
+
+	if (r->format == FFPP_PCAP_FORMAT_PCAP &&
+	    r->link_type != PCAP_LINKTYPE_ETHERNET) {
+		RTE_LOG(WARNING, FFPP,
+			"PCAP: Link type %u is not Ethernet, packets are loaded as-is.\n",
+			r->link_type);
+	}
+
+	return 0;
+}
+
+void ffpp_pcap_reader_close(struct ffpp_pcap_reader *r)
+{
+	if (r->map != NULL) {
+		munmap((void *)r->map, r->map_len);
+	}
+	r->map = NULL;
+	r->map_len = 0;
+	r->off = 0;
+}
+
+void ffpp_pcap_reader_rewind(struct ffpp_pcap_reader *r)
+{
+	r->off = r->first_off;
+}
+
+uint16_t ffpp_pcap_reader_read_burst(struct ffpp_pcap_reader *r,
+				     struct rte_mempool *pool,
+				     struct rte_mbuf **pkts, uint64_t *ts_ns,
+				     uint16_t nb_pkts)
+{
+	uint16_t nb_rx = 0;
+
+	if (unlikely(nb_pkts == 0 || ffpp_pcap_reader_eof(r))) {
+		return 0;
+	}
+	if (unlikely(rte_pktmbuf_alloc_bulk(pool, pkts, nb_pkts) != 0)) {
+		return 0;
+	}
+
+	while (nb_rx < nb_pkts) {
+		const uint8_t *data;
+		uint32_t cap_len;
+		uint64_t ts;
+		struct rte_mbuf *m = pkts[nb_rx];
+		int ret;
+
+		if (r->format == FFPP_PCAP_FORMAT_PCAP) {
+			ret = pcap_next(r, &data, &cap_len, &ts);
+		} else {
+			ret = pcapng_next(r, &data, &cap_len, &ts);
+		}
+		if (ret == 0) {
+			break;
+		}
+		// Pull the next record header while the current one is copied.
+		rte_prefetch0(r->map + RTE_MIN(r->off, r->map_len - 1));
+
+		if (unlikely(cap_len > rte_pktmbuf_tailroom(m))) {
+			r->nb_skipped++;
+			continue;
+		}
+		rte_memcpy(rte_pktmbuf_mtod(m, void *), data, cap_len);
+		m->data_len = cap_len;
+		m->pkt_len = cap_len;
+		if (ts_ns != NULL) {
+			ts_ns[nb_rx] = ts;
+		}
+		nb_rx++;
+	}
+
+	if (nb_rx < nb_pkts) {
+		rte_pktmbuf_free_bulk(pkts + nb_rx, nb_pkts - nb_rx);
+	}
+	r->nb_read += nb_rx;
+	return nb_rx;
+}
+
+/************
+ *  Replay  *
+ ************/
+
+static void replay_flush(const struct ffpp_pcap_replay_config *cfg,
+			 struct rte_mbuf **pkts, uint16_t nb_pkts,
+			 struct ffpp_pcap_replay_stats *stats)
+{
+	uint16_t nb_tx = 0;
+	uint16_t i;
+
+	while (nb_tx < nb_pkts) {
+		uint16_t sent = rte_eth_tx_burst(cfg->port_id, cfg->queue_id,
+						 pkts + nb_tx, nb_pkts - nb_tx);
+		for (i = nb_tx; i < nb_tx + sent; ++i) {
+			stats->tx_bytes += pkts[i]->pkt_len;
+		}
+		nb_tx += sent;
+		// Only line rate mode waits for free TX descriptors, until the
+		// replay is stopped. Late packets are useless for the timed
+		// mode.
+		if (cfg->mode != FFPP_PCAP_REPLAY_LINE_RATE ||
+		    (cfg->stop != NULL && *cfg->stop)) {
+			break;
+		}
+		if (sent == 0) {
+			rte_pause();
+		}
+	}
+	stats->tx_pkts += nb_tx;
+	if (unlikely(nb_tx < nb_pkts)) {
+		stats->tx_dropped += nb_pkts - nb_tx;
+		rte_pktmbuf_free_bulk(pkts + nb_tx, nb_pkts - nb_tx);
+	}
+}
+
+int ffpp_pcap_replay(struct ffpp_pcap_reader *r, struct rte_mempool *pool,
+		     const struct ffpp_pcap_replay_config *cfg,
+		     struct ffpp_pcap_replay_stats *stats)
+{
+	struct rte_mbuf *pkts[PCAP_REPLAY_BURST_MAX];
+	uint64_t ts[PCAP_REPLAY_BURST_MAX];
+	struct ffpp_pcap_replay_stats local_stats;
+	uint16_t burst_size;
+	double tsc_per_ns;
+	uint64_t tsc_start;
+
+	if (cfg->mode == FFPP_PCAP_REPLAY_TIMED && cfg->speed < 0) {
+		rte_errno = EINVAL;
+		return -1;
+	}
+	if (stats == NULL) {
+		stats = &local_stats;
+	}
+	memset(stats, 0, sizeof(*stats));
+	burst_size = cfg->burst_size == 0 ?
+				   32 :
+				   RTE_MIN(cfg->burst_size, PCAP_REPLAY_BURST_MAX);
+	tsc_per_ns = (double)rte_get_tsc_hz() / NSEC_PER_SEC;
+	if (cfg->mode == FFPP_PCAP_REPLAY_TIMED && cfg->speed > 0) {
+		tsc_per_ns /= cfg->speed;
+	}
+
+	tsc_start = rte_rdtsc();
+	ffpp_pcap_reader_rewind(r);
+	while (cfg->loops == 0 || stats->loops < cfg->loops) {
+		uint64_t loop_tsc = rte_rdtsc();
+		uint64_t ts_first = 0;
+		bool first = true;
+
+		for (;;) {
+			uint16_t nb_rx;
+			uint16_t sent = 0;
+			uint16_t i;
+
+			if (cfg->stop != NULL && *cfg->stop) {
+				goto out;
+			}
+			nb_rx = ffpp_pcap_reader_read_burst(r, pool, pkts, ts,
+							    burst_size);
+			if (nb_rx == 0) {
+				if (ffpp_pcap_reader_eof(r)) {
+					break;
+				}
+				// Pool is exhausted, wait for TX completions.
+				rte_pause();
+				continue;
+			}
+			if (cfg->mode == FFPP_PCAP_REPLAY_LINE_RATE) {
+				replay_flush(cfg, pkts, nb_rx, stats);
+				continue;
+			}
+
+			if (first) {
+				ts_first = ts[0];
+				first = false;
+			}
+			for (i = 0; i < nb_rx; ++i) {
+				uint64_t gap = ts[i] > ts_first ?
+							     ts[i] - ts_first :
+							     0;
+				uint64_t deadline =
+					loop_tsc +
+					(uint64_t)((double)gap * tsc_per_ns);
+				if (rte_rdtsc() >= deadline) {
+					continue;
+				}
+				// Release everything that is already due
+				// before waiting for the i-th packet.
+				replay_flush(cfg, pkts + sent, i - sent, stats);
+				sent = i;
+				while (rte_rdtsc() < deadline) {
+					rte_pause();
+				}
+			}
+			replay_flush(cfg, pkts + sent, nb_rx - sent, stats);
+		}
+		stats->loops++;
+		ffpp_pcap_reader_rewind(r);
+	}
+out:
+	stats->tsc_elapsed = rte_rdtsc() - tsc_start;
+	return 0;
+}
+
+/************
+ *  Writer  *
+ ************/
+
+static const struct rte_mbuf_dynfield pcap_tsc_dynfield_desc = {
+	.name = "ffpp_pcap_dynfield_tsc",
+	.size = sizeof(uint64_t),
+	.align = __alignof__(uint64_t),
+};
+
+struct pcap_global_hdr {
+	uint32_t magic;
+	uint16_t version_major;
+	uint16_t version_minor;
+	int32_t thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t network;
+};
+
+struct pcap_record_hdr {
+	uint32_t ts_sec;
+	uint32_t ts_nsec;
+	uint32_t incl_len;
+	uint32_t orig_len;
+};
+
+static int writer_grow(struct ffpp_pcap_writer *w, size_t need)
+{
+	size_t new_len = w->map_len;
+	void *map;
+
+	while (new_len < w->off + need) {
+		new_len += FFPP_PCAP_MAP_CHUNK;
+	}
+	if (ftruncate(w->fd, new_len) < 0) {
+		return -1;
+	}
+	map = mremap(w->map, w->map_len, new_len, MREMAP_MAYMOVE);
+	if (map == MAP_FAILED) {
+		return -1;
+	}
+	w->map = map;
+	w->map_len = new_len;
+	return 0;
+}
+
+static void writer_write_mbuf(struct ffpp_pcap_writer *w, struct rte_mbuf *m,
+			      double ns_per_tsc)
+{
+	struct pcap_record_hdr hdr;
+	uint32_t cap_len = RTE_MIN(m->pkt_len, w->snaplen);
+	uint64_t tsc =
+		*RTE_MBUF_DYNFIELD(m, w->tsc_dynfield_offset, uint64_t *);
+	uint64_t ns;
+	uint8_t *dst;
+	const void *src;
+
+	if (unlikely(w->off + sizeof(hdr) + cap_len > w->map_len)) {
+		if (writer_grow(w, sizeof(hdr) + cap_len) < 0) {
+			w->nb_io_errors++;
+			return;
+		}
+	}
+
+	ns = w->base_ns;
+	if (likely(tsc > w->base_tsc)) {
+		ns += (uint64_t)((double)(tsc - w->base_tsc) * ns_per_tsc);
+	}
+	hdr.ts_sec = ns / NSEC_PER_SEC;
+	hdr.ts_nsec = ns % NSEC_PER_SEC;
+	hdr.incl_len = cap_len;
+	hdr.orig_len = m->pkt_len;
+
+	dst = w->map + w->off;
+	memcpy(dst, &hdr, sizeof(hdr));
+	dst += sizeof(hdr);
+	src = rte_pktmbuf_read(m, 0, cap_len, dst);
+	if (src != NULL && src != dst) {
+		rte_memcpy(dst, src, cap_len);
+	}
+	w->off += sizeof(hdr) + cap_len;
+	w->nb_written++;
+}
+
+int ffpp_pcap_writer_open(struct ffpp_pcap_writer *w, const char *path,
+			  uint32_t ring_size, uint32_t snaplen)
+{
+	static rte_atomic32_t writer_cnt = RTE_ATOMIC32_INIT(0);
+	char ring_name[RTE_RING_NAMESIZE];
+	struct pcap_global_hdr ghdr;
+	struct timespec now;
+
+	memset(w, 0, sizeof(*w));
+	w->lcore_id = LCORE_ID_ANY;
+	w->snaplen = snaplen == 0 ? FFPP_PCAP_SNAPLEN_DEFAULT : snaplen;
+
+	w->tsc_dynfield_offset =
+		rte_mbuf_dynfield_register(&pcap_tsc_dynfield_desc);
+	if (w->tsc_dynfield_offset < 0) {
+		RTE_LOG(ERR, FFPP, "PCAP: Can not register the TSC dynfield.\n");
+		return -1;
+	}
+
+	w->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (w->fd < 0) {
+		rte_errno = errno;
+		RTE_LOG(ERR, FFPP, "PCAP: Can not create file: %s\n", path);
+		return -1;
+	}
+	w->map_len = FFPP_PCAP_MAP_CHUNK;
+	if (ftruncate(w->fd, w->map_len) < 0) {
+		rte_errno = errno;
+		goto err_close;
+	}
+	w->map = mmap(NULL, w->map_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+		      w->fd, 0);
+	if (w->map == MAP_FAILED) {
+		rte_errno = errno;
+		w->map = NULL;
+		goto err_close;
+	}
+
+	snprintf(ring_name, sizeof(ring_name), "ffpp_pcap_w%d",
+		 rte_atomic32_add_return(&writer_cnt, 1));
+	w->ring = rte_ring_create(ring_name, ring_size, rte_socket_id(),
+				  RING_F_SP_ENQ | RING_F_SC_DEQ);
+	if (w->ring == NULL) {
+		goto err_unmap;
+	}
+
+	ghdr = (struct pcap_global_hdr){
+		.magic = PCAP_MAGIC_NSEC,
+		.version_major = 2,
+		.version_minor = 4,
+		.thiszone = 0,
+		.sigfigs = 0,
+		.snaplen = w->snaplen,
+		.network = PCAP_LINKTYPE_ETHERNET,
+	};
+	memcpy(w->map, &ghdr, sizeof(ghdr));
+	w->off = sizeof(ghdr);
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	w->base_tsc = rte_rdtsc();
+	w->base_ns = (uint64_t)now.tv_sec * NSEC_PER_SEC + now.tv_nsec;
+
+	return 0;
+
+err_unmap:
+	munmap(w->map, w->map_len);
+	w->map = NULL;
+err_close:
+	close(w->fd);
+	w->fd = -1;
+	RTE_LOG(ERR, FFPP, "PCAP: Can not init the writer for file: %s\n",
+		path);
+	return -1;
+}
+
+uint16_t ffpp_pcap_writer_enqueue(struct ffpp_pcap_writer *w,
+				  struct rte_mbuf **pkts, uint16_t nb_pkts)
+{
+	uint64_t tsc = rte_rdtsc();
+	uint16_t nb_eq;
+	uint16_t i;
+
+	for (i = 0; i < nb_pkts; ++i) {
+		*RTE_MBUF_DYNFIELD(pkts[i], w->tsc_dynfield_offset,
+				   uint64_t *) = tsc;
+	}
+	nb_eq = rte_ring_sp_enqueue_burst(w->ring, (void **)pkts, nb_pkts,
+					  NULL);
+	w->nb_dropped += nb_pkts - nb_eq;
+	return nb_eq;
+}
+
+uint32_t ffpp_pcap_writer_drain(struct ffpp_pcap_writer *w)
+{
+	struct rte_mbuf *pkts[PCAP_WRITER_BURST];
+	double ns_per_tsc = (double)NSEC_PER_SEC / rte_get_tsc_hz();
+	uint32_t nb_total = 0;
+	unsigned int nb_dq;
+	unsigned int i;
+
+	do {
+		nb_dq = rte_ring_sc_dequeue_burst(w->ring, (void **)pkts,
+						  PCAP_WRITER_BURST, NULL);
+		for (i = 0; i < nb_dq; ++i) {
+			if (i + 1 < nb_dq) {
+				rte_prefetch0(rte_pktmbuf_mtod(pkts[i + 1],
+							       void *));
+			}
+			writer_write_mbuf(w, pkts[i], ns_per_tsc);
+		}
+		rte_pktmbuf_free_bulk(pkts, nb_dq);
+		nb_total += nb_dq;
+	} while (nb_dq == PCAP_WRITER_BURST);
+
+	return nb_total;
+}
+
+int ffpp_pcap_writer_run(void *arg)
+{
+	struct ffpp_pcap_writer *w = arg;
+
+	RTE_LOG(INFO, FFPP, "PCAP: Writer runs on lcore %u\n", rte_lcore_id());
+	while (w->running) {
+		if (ffpp_pcap_writer_drain(w) == 0) {
+			rte_pause();
+		}
+	}
+	ffpp_pcap_writer_drain(w);
+	return 0;
+}
+
+int ffpp_pcap_writer_start(struct ffpp_pcap_writer *w, unsigned int lcore_id)
+{
+	int ret;
+
+	w->running = true;
+	w->lcore_id = lcore_id;
+	rte_smp_wmb();
+	ret = rte_eal_remote_launch(ffpp_pcap_writer_run, w, lcore_id);
+	if (ret < 0) {
+		RTE_LOG(ERR, FFPP, "PCAP: Can not launch writer on lcore %u\n",
+			lcore_id);
+		w->running = false;
+		w->lcore_id = LCORE_ID_ANY;
+	}
+	return ret;
+}
+
+void ffpp_pcap_writer_stop(struct ffpp_pcap_writer *w)
+{
+	w->running = false;
+	if (w->lcore_id != LCORE_ID_ANY) {
+		rte_eal_wait_lcore(w->lcore_id);
+		w->lcore_id = LCORE_ID_ANY;
+	}
+}
+
+void ffpp_pcap_writer_close(struct ffpp_pcap_writer *w)
+{
+	ffpp_pcap_writer_stop(w);
+	if (w->map != NULL) {
+		ffpp_pcap_writer_drain(w);
+		munmap(w->map, w->map_len);
+		w->map = NULL;
+	}
+	if (w->fd >= 0) {
+		if (ftruncate(w->fd, w->off) < 0) {
+			RTE_LOG(WARNING, FFPP,
+				"PCAP: Can not truncate the capture file.\n");
+		}
+		close(w->fd);
+		w->fd = -1;
+	}
+	rte_ring_free(w->ring);
+	w->ring = NULL;
+	RTE_LOG(INFO, FFPP,
+		"PCAP: Writer closed. Written: %lu, dropped: %lu, IO errors: %lu\n",
+		w->nb_written, w->nb_dropped, w->nb_io_errors);
+}
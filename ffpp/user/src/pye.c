@@ -0,0 +1,827 @@
+/*
+ * pye.c
+ */
+
+// Python.h (included by pye.h) must be included before the system headers.
+#include <ffpp/pye.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_errno.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_pause.h>
+#include <rte_ring.h>
+
+struct pye_engine {
+	PyThreadState *main; /**< Saved while the GIL is released */
+	PyObject *handler;
+};
+
+static struct pye_engine pye;
+
+int ffpp_pye_init(const char *program_name, const char *module_path)
+{
+	PyObject *path, *dir;
+	PyConfig config;
+	PyStatus status;
+
+	if (Py_IsInitialized()) {
+		return -EALREADY;
+	}
+	PyConfig_InitPythonConfig(&config);
+	// Keep the signal handlers of the application.
+	config.install_signal_handlers = 0;
+	if (program_name != NULL) {
+		status = PyConfig_SetBytesString(&config, &config.program_name,
+						 program_name);
+		if (PyStatus_Exception(status)) {
+			PyConfig_Clear(&config);
+			return -EINVAL;
+		}
+	}
+	status = Py_InitializeFromConfig(&config);
+	PyConfig_Clear(&config);
+	if (PyStatus_Exception(status)) {
+		return -EINVAL;
+	}
+
+	if (module_path != NULL) {
+		path = PySys_GetObject("path");
+		dir = PyUnicode_DecodeFSDefault(module_path);
+		if (path == NULL || dir == NULL ||
+		    PyList_Insert(path, 0, dir) != 0) {
+			Py_XDECREF(dir);
+			goto fail;
+		}
+		Py_DECREF(dir);
+	}
+	pye.main = PyEval_SaveThread();
+	return 0;
+
+fail:
+	PyErr_Print();
+	Py_FinalizeEx();
+	return -EINVAL;
+}
+
+int ffpp_pye_set_apu_handler(const char *module_name, const char *func_name)
+{
+	PyObject *module, *func;
+	PyGILState_STATE gstate;
+	int ret = 0;
+
+	if (pye.main == NULL) {
+		return -EPERM;
+	}
+	gstate = PyGILState_Ensure();
+	module = PyImport_ImportModule(module_name);
+	func = module == NULL ? NULL :
+				PyObject_GetAttrString(module, func_name);
+	Py_XDECREF(module);
+	if (func == NULL) {
+		PyErr_Print();
+		ret = -ENOENT;
+	} else if (!PyCallable_Check(func)) {
+		Py_DECREF(func);
+		ret = -EINVAL;
+	} else {
+		Py_XDECREF(pye.handler);
+		pye.handler = func;
+	}
+	PyGILState_Release(gstate);
+	return ret;
+}
+
+static __rte_always_inline bool has_payload(const struct rte_mbuf *m,
+					    uint16_t offset)
+{
+	return rte_pktmbuf_is_contiguous(m) &&
+	       rte_pktmbuf_data_len(m) >= offset;
+}
+
+/*
+ * Payload of a packet as seen by the handler, in the shared memory of a pool
+ * it is also valid in the workers.
+ */
+struct pye_desc {
+	char *data;
+	uint32_t size; /**< Payload and tailroom, 0 for an empty view */
+};
+
+/*
+ * Describe the payloads of n packets, lens is set to the payload lengths.
+ */
+static void fill_descs(struct rte_mbuf **pkts, uint16_t n, uint16_t offset,
+		       struct pye_desc *desc, int32_t *lens)
+{
+	struct rte_mbuf *m;
+	uint16_t i;
+
+	for (i = 0; i < n; ++i) {
+		m = pkts[i];
+		if (likely(has_payload(m, offset))) {
+			lens[i] = rte_pktmbuf_data_len(m) - offset;
+			desc[i].data =
+				rte_pktmbuf_mtod_offset(m, char *, offset);
+			desc[i].size = lens[i] + rte_pktmbuf_tailroom(m);
+		} else {
+			lens[i] = 0;
+			desc[i].data = rte_pktmbuf_mtod(m, char *);
+			desc[i].size = 0;
+		}
+	}
+}
+
+/*
+ * Release n memoryviews and drop their references. Returns -EIO if the handler
+ * still holds an export of a view, e.g. a NumPy array. Its memory stays
+ * accessible then.
+ */
+static int release_views(PyObject **views, uint16_t n)
+{
+	PyObject *ret;
+	uint16_t i;
+	int err = 0;
+
+	for (i = 0; i < n; ++i) {
+		// release() raises BufferError while the view is exported.
+		ret = PyObject_CallMethod(views[i], "release", NULL);
+		if (ret == NULL) {
+			if (PyErr_ExceptionMatches(PyExc_BufferError)) {
+				PyErr_Clear();
+			} else {
+				PyErr_Print();
+			}
+			err = -EIO;
+		}
+		Py_XDECREF(ret);
+		Py_DECREF(views[i]);
+	}
+	return err;
+}
+
+/*
+ * Call the handler with n payloads, the results are written to lens. Returns 0
+ * or a negative errno.
+ *
+ * The memoryviews of the packets and of lens are released after the call, the
+ * handler must copy what it keeps. The list of the payloads can be changed by
+ * the handler, so the views are also referenced by an array.
+ */
+static int call_handler(PyObject *handler, const struct pye_desc *desc,
+			uint16_t n, int32_t *lens)
+{
+	// The payloads and the lengths.
+	PyObject *views[FFPP_PYE_BATCH_MAX + 1];
+	static char fmt[] = "i";
+	PyObject *payloads, *view, *ret, *seq;
+	Py_ssize_t shape = n;
+	Py_buffer info;
+	long len;
+	uint16_t i;
+	int err = 0;
+
+	payloads = PyList_New(n);
+	if (payloads == NULL) {
+		PyErr_Print();
+		return -ENOMEM;
+	}
+	for (i = 0; i < n; ++i) {
+		view = PyMemoryView_FromMemory(desc[i].data, desc[i].size,
+					       PyBUF_WRITE);
+		if (view == NULL) {
+			PyErr_Print();
+			release_views(views, i);
+			Py_DECREF(payloads);
+			return -ENOMEM;
+		}
+		Py_INCREF(view);
+		views[i] = view;
+		PyList_SET_ITEM(payloads, i, view);
+	}
+
+	// An int array, the view copies the shape.
+	PyBuffer_FillInfo(&info, NULL, lens, n * sizeof(*lens), 0,
+			  PyBUF_FULL);
+	info.format = fmt;
+	info.itemsize = sizeof(*lens);
+	info.shape = &shape;
+	info.strides = &info.itemsize;
+	views[n] = PyMemoryView_FromBuffer(&info);
+	if (views[n] == NULL) {
+		PyErr_Print();
+		release_views(views, n);
+		Py_DECREF(payloads);
+		return -ENOMEM;
+	}
+
+	ret = PyObject_CallFunctionObjArgs(handler, payloads, views[n], NULL);
+	Py_DECREF(payloads);
+	if (ret == NULL) {
+		PyErr_Print();
+		err = -EIO;
+	}
+	if (release_views(views, n + 1) != 0) {
+		err = -EIO;
+	}
+	if (err != 0) {
+		Py_XDECREF(ret);
+		return err;
+	}
+	if (ret == Py_None) {
+		Py_DECREF(ret);
+		return 0;
+	}
+
+	seq = PySequence_Fast(ret, "The APU handler must return a sequence");
+	Py_DECREF(ret);
+	if (seq == NULL || PySequence_Fast_GET_SIZE(seq) != n) {
+		err = -EINVAL;
+		goto out;
+	}
+	for (i = 0; i < n; ++i) {
+		len = PyLong_AsLong(PySequence_Fast_GET_ITEM(seq, i));
+		if (len == -1 && PyErr_Occurred()) {
+			err = -EINVAL;
+			goto out;
+		}
+		lens[i] = len < 0 ? FFPP_PYE_DROP : RTE_MIN(len, INT32_MAX);
+	}
+out:
+	if (PyErr_Occurred()) {
+		PyErr_Print();
+	}
+	Py_XDECREF(seq);
+	return err;
+}
+
+/*
+ * Apply the lengths of the handler to n packets, the kept ones are written to
+ * kept. Returns the number of kept packets.
+ */
+static uint16_t apply_lengths(struct rte_mbuf **pkts, uint16_t n,
+			      uint16_t offset, const int32_t *lens,
+			      struct rte_mbuf **kept)
+{
+	uint32_t cur, len, room;
+	struct rte_mbuf *m;
+	uint16_t nb_kept = 0;
+	uint16_t i;
+
+	for (i = 0; i < n; ++i) {
+		m = pkts[i];
+		if (lens[i] < 0) {
+			rte_pktmbuf_free(m);
+			continue;
+		}
+		kept[nb_kept++] = m;
+		if (unlikely(!has_payload(m, offset))) {
+			continue;
+		}
+		cur = rte_pktmbuf_data_len(m) - offset;
+		room = cur + rte_pktmbuf_tailroom(m);
+		len = RTE_MIN((uint32_t)lens[i], room);
+		if (len > cur) {
+			rte_pktmbuf_append(m, len - cur);
+		} else if (len < cur) {
+			rte_pktmbuf_trim(m, cur - len);
+		}
+	}
+	return nb_kept;
+}
+
+int ffpp_pye_process_apu(struct ffpp_mvec *vec, uint16_t offset)
+{
+	// Per call, the handler can release the GIL and another lcore enter.
+	struct pye_desc desc[FFPP_PYE_BATCH_MAX];
+	int32_t lens[FFPP_PYE_BATCH_MAX];
+	PyGILState_STATE gstate;
+	PyObject *handler;
+	uint16_t nb_kept = 0;
+	uint16_t i = 0;
+	uint16_t n;
+	int ret = 0;
+
+	if (pye.main == NULL) {
+		return -ENOENT;
+	}
+	if (vec->len == 0) {
+		return 0;
+	}
+
+	// The only GIL acquisition of the vector.
+	gstate = PyGILState_Ensure();
+	handler = pye.handler;
+	if (handler == NULL) {
+		PyGILState_Release(gstate);
+		return -ENOENT;
+	}
+	// The handler can be replaced while it runs.
+	Py_INCREF(handler);
+	for (i = 0; i < vec->len; i += n) {
+		n = RTE_MIN(vec->len - i, FFPP_PYE_BATCH_MAX);
+		fill_descs(vec->head + i, n, offset, desc, lens);
+		ret = call_handler(handler, desc, n, lens);
+		if (ret < 0) {
+			break;
+		}
+		nb_kept += apply_lengths(vec->head + i, n, offset, lens,
+					 vec->head + nb_kept);
+	}
+	Py_DECREF(handler);
+	PyGILState_Release(gstate);
+
+	// The packets after a failed call stay in the vector unchanged.
+	memmove(vec->head + nb_kept, vec->head + i,
+		(vec->len - i) * sizeof(vec->head[0]));
+	vec->len = nb_kept + (vec->len - i);
+	return ret < 0 ? ret : nb_kept;
+}
+
+void ffpp_pye_cleanup(void)
+{
+	if (pye.main == NULL) {
+		return;
+	}
+	PyEval_RestoreThread(pye.main);
+	pye.main = NULL;
+	Py_CLEAR(pye.handler);
+	Py_FinalizeEx();
+}
+
+// Empty polls of a worker before it starts to sleep between the polls.
+#define PYE_WORKER_IDLE_SPINS (1U << 16)
+#define PYE_WORKER_IDLE_SLEEP_US 50
+#define PYE_WORKER_START_POLL_US 1000
+// Interval of the checks for dead workers in ffpp_pye_pool_collect().
+#define PYE_WORKER_CHECK_US 10000
+
+enum pye_worker_state {
+	PYE_WORKER_STARTING = 0,
+	PYE_WORKER_READY,
+	PYE_WORKER_FAILED,
+	PYE_WORKER_NO_CPUS,
+};
+
+/*
+ * A batch in the shared memory. The descriptors and lengths are written by the
+ * lcore before the slot is enqueued and by the worker before done is set.
+ */
+struct pye_slot {
+	struct pye_desc desc[FFPP_PYE_BATCH_MAX];
+	int32_t lens[FFPP_PYE_BATCH_MAX];
+	// Only used by the lcore.
+	struct rte_mbuf *pkts[FFPP_PYE_BATCH_MAX];
+	uint16_t nb;
+	uint16_t worker;
+	int32_t status; /**< Result of the handler */
+	uint32_t done;
+} __rte_cache_aligned;
+
+struct pye_worker {
+	struct rte_ring *ring; /**< Slots to process */
+	pid_t pid; /**< 0 if the worker is not running */
+	uint32_t state; /**< Written by the worker */
+	uint32_t outstanding; /**< Batches that are not collected */
+} __rte_cache_aligned;
+
+// All in the hugepages, so the workers share it with the lcore.
+struct ffpp_pye_pool {
+	struct ffpp_pye_pool_config cfg;
+	uint32_t stop;
+	// Slots in submission order: head is the oldest outstanding, tail the
+	// next free one.
+	uint32_t head;
+	uint32_t tail;
+	struct ffpp_pye_pool_stats stats;
+	struct pye_worker *workers;
+	struct pye_slot *slots;
+	cpu_set_t cpuset; /**< CPUs of the workers */
+	uint64_t check_cycles;
+	uint64_t next_check; /**< Timer cycles of the next dead worker check */
+};
+
+static void worker_loop(struct ffpp_pye_pool *pool, struct pye_worker *w,
+			PyObject *handler)
+{
+	struct pye_slot *slot;
+	uint32_t idle = 0;
+
+	while (!__atomic_load_n(&pool->stop, __ATOMIC_ACQUIRE)) {
+		if (rte_ring_sc_dequeue(w->ring, (void **)&slot) != 0) {
+			if (++idle < PYE_WORKER_IDLE_SPINS) {
+				rte_pause();
+			} else {
+				rte_delay_us_sleep(PYE_WORKER_IDLE_SLEEP_US);
+			}
+			continue;
+		}
+		idle = 0;
+		slot->status =
+			call_handler(handler, slot->desc, slot->nb, slot->lens);
+		__atomic_store_n(&slot->done, 1, __ATOMIC_RELEASE);
+	}
+}
+
+/*
+ * Entry of a forked worker, it holds the GIL of its own interpreter and never
+ * returns.
+ */
+static void __rte_noreturn worker_main(struct ffpp_pye_pool *pool,
+				       struct pye_worker *w, pid_t parent)
+{
+	PyObject *module, *handler;
+
+	PyOS_AfterFork_Child();
+	// The lcore is pinned to its CPU, the worker would compete with it.
+	if (sched_setaffinity(0, sizeof(pool->cpuset), &pool->cpuset) != 0) {
+		__atomic_store_n(&w->state, PYE_WORKER_NO_CPUS,
+				 __ATOMIC_RELEASE);
+		_exit(EXIT_FAILURE);
+	}
+	// Do not outlive the lcore, it would keep the hugepages. The signal is
+	// sent when the forking thread exits, i.e. the main lcore.
+	if (prctl(PR_SET_PDEATHSIG, SIGKILL) != 0 || getppid() != parent) {
+		_exit(EXIT_FAILURE);
+	}
+	module = PyImport_ImportModule(pool->cfg.module_name);
+	handler = module == NULL ?
+			  NULL :
+			  PyObject_GetAttrString(module, pool->cfg.func_name);
+	Py_XDECREF(module);
+	if (handler == NULL || !PyCallable_Check(handler)) {
+		if (PyErr_Occurred()) {
+			PyErr_Print();
+		}
+		__atomic_store_n(&w->state, PYE_WORKER_FAILED,
+				 __ATOMIC_RELEASE);
+		_exit(EXIT_FAILURE);
+	}
+	__atomic_store_n(&w->state, PYE_WORKER_READY, __ATOMIC_RELEASE);
+
+	worker_loop(pool, w, handler);
+	Py_DECREF(handler);
+	// Flush the output of the handler, the DPDK atexit handlers belong to
+	// the lcore.
+	Py_FinalizeEx();
+	_exit(EXIT_SUCCESS);
+}
+
+static int fork_worker(struct ffpp_pye_pool *pool, struct pye_worker *w)
+{
+	pid_t parent = getpid();
+	pid_t pid;
+
+	// Like os.fork(), the GIL is held.
+	PyOS_BeforeFork();
+	pid = fork();
+	if (pid == 0) {
+		worker_main(pool, w, parent);
+	}
+	PyOS_AfterFork_Parent();
+	if (pid < 0) {
+		return -errno;
+	}
+	w->pid = pid;
+	return 0;
+}
+
+/*
+ * Wait until a worker imported the handler. Returns 0, -ENOENT if it failed or
+ * -EINVAL if it can not run on the CPUs.
+ */
+static int wait_worker(struct pye_worker *w)
+{
+	uint32_t state;
+
+	for (;;) {
+		state = __atomic_load_n(&w->state, __ATOMIC_ACQUIRE);
+		if (state == PYE_WORKER_READY) {
+			return 0;
+		}
+		if (state == PYE_WORKER_FAILED || state == PYE_WORKER_NO_CPUS ||
+		    waitpid(w->pid, NULL, WNOHANG) == w->pid) {
+			waitpid(w->pid, NULL, 0);
+			w->pid = 0;
+			return state == PYE_WORKER_NO_CPUS ? -EINVAL : -ENOENT;
+		}
+		rte_delay_us_sleep(PYE_WORKER_START_POLL_US);
+	}
+}
+
+static void *read_affinity(void *arg)
+{
+	cpu_set_t *cpuset = arg;
+
+	if (pthread_getaffinity_np(pthread_self(), sizeof(*cpuset), cpuset) !=
+	    0) {
+		CPU_ZERO(cpuset);
+	}
+	return NULL;
+}
+
+/*
+ * Get the CPUs of the EAL control threads, the EAL computes them from the
+ * affinity of the process without the lcores.
+ */
+static int get_ctrl_cpuset(cpu_set_t *cpuset)
+{
+	pthread_t tid;
+	int ret;
+
+	ret = rte_ctrl_thread_create(&tid, "ffpp-pye-cpus", NULL,
+				     read_affinity, cpuset);
+	if (ret != 0) {
+		return ret;
+	}
+	pthread_join(tid, NULL);
+	return CPU_COUNT(cpuset) > 0 ? 0 : -EINVAL;
+}
+
+struct ffpp_pye_pool *
+ffpp_pye_pool_create(const struct ffpp_pye_pool_config *cfg)
+{
+	char ring_name[RTE_RING_NAMESIZE];
+	struct ffpp_pye_pool *pool;
+	PyGILState_STATE gstate;
+	struct pye_worker *w;
+	uint16_t i;
+	int ret = 0;
+
+	if (pye.main == NULL) {
+		rte_errno = EPERM;
+		return NULL;
+	}
+	if (cfg->name[0] == '\0' ||
+	    strnlen(cfg->name, FFPP_PYE_NAME_MAX_LEN) ==
+		    FFPP_PYE_NAME_MAX_LEN ||
+	    cfg->nb_workers == 0 || cfg->nb_workers > FFPP_PYE_WORKERS_MAX ||
+	    cfg->batch_size > FFPP_PYE_BATCH_MAX || cfg->module_name == NULL ||
+	    cfg->func_name == NULL ||
+	    (cfg->cpuset != NULL && CPU_COUNT(cfg->cpuset) == 0)) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+	// Private memory is copied on write, the workers would not see the
+	// packets of the lcore.
+	if (!rte_eal_has_hugepages()) {
+		rte_errno = ENOTSUP;
+		return NULL;
+	}
+
+	pool = rte_zmalloc_socket("ffpp_pye_pool", sizeof(*pool),
+				  RTE_CACHE_LINE_SIZE, cfg->socket_id);
+	if (pool == NULL) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	pool->cfg = *cfg;
+	if (pool->cfg.batch_size == 0) {
+		pool->cfg.batch_size = FFPP_PYE_POOL_BATCH_DEFAULT;
+	}
+	if (pool->cfg.nb_slots == 0) {
+		pool->cfg.nb_slots = FFPP_PYE_POOL_SLOTS_DEFAULT;
+	}
+	// The workers read the CPUs from the pool.
+	pool->cfg.cpuset = NULL;
+	if (cfg->cpuset != NULL) {
+		pool->cpuset = *cfg->cpuset;
+	} else {
+		ret = get_ctrl_cpuset(&pool->cpuset);
+		if (ret < 0) {
+			goto fail;
+		}
+	}
+	pool->check_cycles = rte_get_timer_hz() * PYE_WORKER_CHECK_US / US_PER_S;
+	pool->next_check = rte_get_timer_cycles() + pool->check_cycles;
+	pool->workers = rte_zmalloc_socket(
+		"ffpp_pye_workers", cfg->nb_workers * sizeof(*pool->workers),
+		RTE_CACHE_LINE_SIZE, cfg->socket_id);
+	pool->slots = rte_zmalloc_socket(
+		"ffpp_pye_slots", pool->cfg.nb_slots * sizeof(*pool->slots),
+		RTE_CACHE_LINE_SIZE, cfg->socket_id);
+	if (pool->workers == NULL || pool->slots == NULL) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+	// A ring can hold all slots, so enqueuing never fails.
+	for (i = 0; i < cfg->nb_workers; ++i) {
+		snprintf(ring_name, sizeof(ring_name), "%s_w%u", cfg->name, i);
+		pool->workers[i].ring = rte_ring_create(
+			ring_name, pool->cfg.nb_slots, cfg->socket_id,
+			RING_F_SP_ENQ | RING_F_SC_DEQ | RING_F_EXACT_SZ);
+		if (pool->workers[i].ring == NULL) {
+			ret = -rte_errno;
+			goto fail;
+		}
+	}
+
+	gstate = PyGILState_Ensure();
+	for (i = 0; i < cfg->nb_workers && ret == 0; ++i) {
+		ret = fork_worker(pool, &pool->workers[i]);
+	}
+	PyGILState_Release(gstate);
+	for (i = 0; i < cfg->nb_workers && ret == 0; ++i) {
+		w = &pool->workers[i];
+		ret = wait_worker(w);
+	}
+	if (ret < 0) {
+		goto fail;
+	}
+	return pool;
+
+fail:
+	ffpp_pye_pool_free(pool);
+	rte_errno = -ret;
+	return NULL;
+}
+
+void ffpp_pye_pool_free(struct ffpp_pye_pool *pool)
+{
+	struct pye_slot *slot;
+	uint16_t i;
+
+	if (pool == NULL) {
+		return;
+	}
+	__atomic_store_n(&pool->stop, 1, __ATOMIC_RELEASE);
+	for (i = 0; pool->workers != NULL && i < pool->cfg.nb_workers; ++i) {
+		if (pool->workers[i].pid > 0) {
+			waitpid(pool->workers[i].pid, NULL, 0);
+		}
+		rte_ring_free(pool->workers[i].ring);
+	}
+	for (; pool->head != pool->tail; ++pool->head) {
+		slot = &pool->slots[pool->head % pool->cfg.nb_slots];
+		rte_pktmbuf_free_bulk(slot->pkts, slot->nb);
+	}
+	rte_free(pool->slots);
+	rte_free(pool->workers);
+	rte_free(pool);
+}
+
+/*
+ * The running worker with the fewest outstanding batches, nb_workers if all
+ * workers died.
+ */
+static __rte_always_inline uint16_t
+least_loaded_worker(const struct ffpp_pye_pool *pool)
+{
+	uint16_t best = pool->cfg.nb_workers;
+	uint16_t i;
+
+	for (i = 0; i < pool->cfg.nb_workers; ++i) {
+		if (pool->workers[i].pid == 0) {
+			continue;
+		}
+		if (best == pool->cfg.nb_workers ||
+		    pool->workers[i].outstanding <
+			    pool->workers[best].outstanding) {
+			best = i;
+		}
+	}
+	return best;
+}
+
+uint16_t ffpp_pye_pool_submit(struct ffpp_pye_pool *pool,
+			      struct ffpp_mvec *vec)
+{
+	struct pye_worker *w;
+	struct pye_slot *slot;
+	uint16_t nb_sub = 0;
+	uint16_t worker, n;
+
+	while (nb_sub < vec->len &&
+	       pool->tail - pool->head < pool->cfg.nb_slots) {
+		worker = least_loaded_worker(pool);
+		if (unlikely(worker == pool->cfg.nb_workers)) {
+			break;
+		}
+		slot = &pool->slots[pool->tail % pool->cfg.nb_slots];
+		n = RTE_MIN(vec->len - nb_sub, pool->cfg.batch_size);
+		memcpy(slot->pkts, vec->head + nb_sub,
+		       n * sizeof(slot->pkts[0]));
+		fill_descs(slot->pkts, n, pool->cfg.offset, slot->desc,
+			   slot->lens);
+		slot->nb = n;
+		slot->worker = worker;
+		slot->done = 0;
+		w = &pool->workers[slot->worker];
+		// The ring publishes the slot with a release barrier.
+		rte_ring_sp_enqueue(w->ring, slot);
+		w->outstanding += 1;
+		pool->tail += 1;
+		pool->stats.batches += 1;
+		nb_sub += n;
+	}
+	memmove(vec->head, vec->head + nb_sub,
+		(vec->len - nb_sub) * sizeof(vec->head[0]));
+	vec->len -= nb_sub;
+	pool->stats.submitted += nb_sub;
+	return nb_sub;
+}
+
+/*
+ * Complete the outstanding batches of the workers that died as failed. The
+ * lcore consumes the ring of a dead worker.
+ */
+static void reap_workers(struct ffpp_pye_pool *pool)
+{
+	struct pye_worker *w;
+	struct pye_slot *slot;
+	uint32_t pos;
+	uint16_t i;
+	pid_t ret;
+
+	for (i = 0; i < pool->cfg.nb_workers; ++i) {
+		w = &pool->workers[i];
+		if (w->pid == 0) {
+			continue;
+		}
+		ret = waitpid(w->pid, NULL, WNOHANG);
+		if (ret == 0 || (ret < 0 && errno != ECHILD)) {
+			continue;
+		}
+		w->pid = 0;
+		while (rte_ring_sc_dequeue(w->ring, (void **)&slot) == 0) {
+		}
+		for (pos = pool->head; pos != pool->tail; ++pos) {
+			slot = &pool->slots[pos % pool->cfg.nb_slots];
+			if (slot->worker == i &&
+			    !__atomic_load_n(&slot->done, __ATOMIC_ACQUIRE)) {
+				slot->status = -ECHILD;
+				slot->done = 1;
+			}
+		}
+	}
+}
+
+uint16_t ffpp_pye_pool_collect(struct ffpp_pye_pool *pool,
+			       struct ffpp_mvec *out)
+{
+	struct pye_slot *slot;
+	uint16_t nb_kept = 0;
+	uint64_t now;
+	uint16_t n;
+
+	now = rte_get_timer_cycles();
+	if (unlikely(now >= pool->next_check)) {
+		pool->next_check = now + pool->check_cycles;
+		reap_workers(pool);
+	}
+	while (pool->head != pool->tail) {
+		slot = &pool->slots[pool->head % pool->cfg.nb_slots];
+		if (!__atomic_load_n(&slot->done, __ATOMIC_ACQUIRE) ||
+		    out->capacity - out->len < slot->nb) {
+			break;
+		}
+		if (unlikely(slot->status < 0)) {
+			memcpy(out->head + out->len, slot->pkts,
+			       slot->nb * sizeof(slot->pkts[0]));
+			n = slot->nb;
+			pool->stats.failed += n;
+		} else {
+			n = apply_lengths(slot->pkts, slot->nb,
+					  pool->cfg.offset, slot->lens,
+					  out->head + out->len);
+			pool->stats.dropped += slot->nb - n;
+		}
+		out->len += n;
+		nb_kept += n;
+		pool->workers[slot->worker].outstanding -= 1;
+		pool->head += 1;
+	}
+	pool->stats.kept += nb_kept;
+	return nb_kept;
+}
+
+void ffpp_pye_pool_get_stats(const struct ffpp_pye_pool *pool,
+			     struct ffpp_pye_pool_stats *stats)
+{
+	*stats = pool->stats;
+	stats->outstanding = pool->tail - pool->head;
+}
+
+pid_t ffpp_pye_pool_get_worker_pid(const struct ffpp_pye_pool *pool,
+				   uint16_t worker)
+{
+	if (worker >= pool->cfg.nb_workers) {
+		return 0;
+	}
+	return pool->workers[worker].pid;
+}
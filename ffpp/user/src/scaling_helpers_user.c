@@ -301,6 +301,25 @@ void get_cpu_utilization(struct measurement *m, struct freq_info *f)
 	printf("Current CPU utilization: %f\n", m->cpu_util[m->idx]);
 }
 
+void get_cpu_utilization_cycles(struct measurement *m,
+				const struct ffpp_lcore_cycles *prev,
+				const struct ffpp_lcore_cycles *cur)
+{
+	m->cpu_util[m->idx] = ffpp_cycle_stats_busy_ratio(prev, cur);
+	printf("Measured CPU utilization: %f\n", m->cpu_util[m->idx]);
+}
+
+struct ffpp_cycle_stats *attach_cycle_stats(void)
+{
+	struct ffpp_cycle_stats *cs;
+
+	cs = ffpp_cycle_stats_attach();
+	if (cs == NULL) {
+		fprintf(stderr, "WARN: No ffpp workers runtime is running.\n");
+	}
+	return cs;
+}
+
 void calc_sma(struct measurement *m)
 {
 	int i;
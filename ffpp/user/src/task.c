@@ -2,14 +2,51 @@
  * task.c
  */
 
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
 #include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
 #include <rte_launch.h>
 #include <rte_lcore.h>
 #include <rte_log.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_ring.h>
 
 #include <ffpp/config.h>
+#include <ffpp/cycle_stats.h>
 #include <ffpp/device.h>
+#include <ffpp/histogram.h>
 #include <ffpp/task.h>
+#include <ffpp/wsdeque.h>
+
+/**
+ * struct ffpp_ws_batch - A received burst in work-stealing mode.
+ */
+struct ffpp_ws_batch {
+	struct ffpp_mvec vec;
+	uint32_t seqn; /**< Sequence number in its RX queue */
+	uint16_t rxq_idx; /**< port_idx * nb_rx_queues + queue ID */
+	uint16_t port_idx;
+	struct rte_mbuf *pkts[];
+};
+
+/**
+ * struct ffpp_ws_reorder - Reorder window of a RX queue.
+ *
+ * The batches in flight are bounded by the size of the batch pool, so a
+ * window of at least that size never wraps around.
+ */
+struct ffpp_ws_reorder {
+	uint32_t next;
+	uint32_t mask;
+	struct ffpp_ws_batch **window;
+};
 
 void print_lcore_infos(void)
 {
@@ -59,3 +96,934 @@ int launch_workers(lcore_function_t *func, struct worker *workers)
 	}
 	return 0;
 }
+
+static int check_worker_config(const struct ffpp_worker_config *cfg)
+{
+	uint16_t i;
+
+	if (cfg->nb_ports == 0 || cfg->nb_ports > FFPP_MAX_PORTS) {
+		RTE_LOG(ERR, FFPP, "Workers support 1 to %d ports.\n",
+			FFPP_MAX_PORTS);
+		return -1;
+	}
+	if (cfg->nb_rx_queues == 0 ||
+	    cfg->nb_rx_queues > FFPP_MAX_QUEUES_PER_PORT ||
+	    cfg->nb_tx_queues == 0 ||
+	    cfg->nb_tx_queues > FFPP_MAX_QUEUES_PER_PORT) {
+		RTE_LOG(ERR, FFPP, "Workers support 1 to %d queues per port.\n",
+			FFPP_MAX_QUEUES_PER_PORT);
+		return -1;
+	}
+	if (cfg->nb_stages == 0 || cfg->nb_stages > FFPP_WORKER_MAX_STAGES) {
+		RTE_LOG(ERR, FFPP, "Workers support 1 to %d stages.\n",
+			FFPP_WORKER_MAX_STAGES);
+		return -1;
+	}
+	for (i = 0; i < cfg->nb_stages; ++i) {
+		if (cfg->handlers[i] == NULL) {
+			RTE_LOG(ERR, FFPP, "Stage %u has no handler.\n", i);
+			return -1;
+		}
+	}
+	for (i = 0; i < cfg->nb_ports; ++i) {
+		if (!rte_eth_dev_is_valid_port(cfg->port_ids[i]) ||
+		    cfg->tx_port_map[i] >= cfg->nb_ports) {
+			RTE_LOG(ERR, FFPP, "Invalid port or TX port map: %u.\n",
+				cfg->port_ids[i]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int setup_tx_buffers(struct ffpp_worker_runtime *rt, struct worker *w,
+			    uint16_t tx_queue)
+{
+	struct rte_eth_dev_tx_buffer *buf;
+	uint16_t i;
+
+	for (i = 0; i < rt->cfg.nb_ports; ++i) {
+		buf = rte_zmalloc_socket(
+			"ffpp_tx_buffer",
+			RTE_ETH_TX_BUFFER_SIZE(rt->cfg.burst_size), 0,
+			rte_lcore_to_socket_id(w->core_id));
+		if (buf == NULL) {
+			return -ENOMEM;
+		}
+		rte_eth_tx_buffer_init(buf, rt->cfg.burst_size);
+		rte_eth_tx_buffer_set_err_callback(
+			buf, rte_eth_tx_buffer_count_callback,
+			&(w->stats.tx_dropped));
+		w->tx_buffers[i] = buf;
+		w->txqs[i].id = tx_queue;
+		w->txqs[i].len = 0;
+	}
+	return 0;
+}
+
+static void add_rxq(struct worker *w, uint16_t port_idx, uint16_t queue_id)
+{
+	w->rxqs[w->nb_rxqs].port_idx = port_idx;
+	w->rxqs[w->nb_rxqs].id = queue_id;
+	w->nb_rxqs++;
+}
+
+/**
+ * The (port, queue) pairs are sorted by queue first and split in contiguous
+ * chunks, so the same queue of all ports is handled by the same worker when
+ * there are not enough lcores.
+ *
+ * Return the number of used lcores.
+ */
+static unsigned int assign_rxqs(struct ffpp_worker_runtime *rt,
+				const unsigned int *lcores,
+				unsigned int nb_lcores,
+				enum ffpp_worker_role role)
+{
+	const struct ffpp_worker_config *cfg = &(rt->cfg);
+	unsigned int nb_pairs = cfg->nb_ports * cfg->nb_rx_queues;
+	unsigned int chunk, k;
+	uint16_t p, q;
+
+	chunk = (nb_pairs + nb_lcores - 1) / nb_lcores;
+	k = 0;
+	for (q = 0; q < cfg->nb_rx_queues; ++q) {
+		for (p = 0; p < cfg->nb_ports; ++p) {
+			struct worker *w = &(rt->workers[lcores[k / chunk]]);
+			w->role = role;
+			add_rxq(w, p, q);
+			k++;
+		}
+	}
+	return (nb_pairs + chunk - 1) / chunk;
+}
+
+static int assign_rtc(struct ffpp_worker_runtime *rt,
+		      const unsigned int *lcores, unsigned int nb_lcores)
+{
+	unsigned int nb_used, k;
+	int ret;
+
+	nb_used = assign_rxqs(rt, lcores, nb_lcores, FFPP_WORKER_ROLE_RTC);
+	if (nb_used > rt->cfg.nb_tx_queues) {
+		RTE_LOG(ERR, FFPP,
+			"%u workers are used, but ports only have %u TX queues.\n",
+			nb_used, rt->cfg.nb_tx_queues);
+		return -EINVAL;
+	}
+	for (k = 0; k < nb_used; ++k) {
+		ret = setup_tx_buffers(rt, &(rt->workers[lcores[k]]), k);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+	return 0;
+}
+
+static int assign_pipeline(struct ffpp_worker_runtime *rt,
+			   const unsigned int *lcores, unsigned int nb_lcores)
+{
+	const struct ffpp_worker_config *cfg = &(rt->cfg);
+	char name[RTE_RING_NAMESIZE];
+	uint16_t s, p, q;
+
+	if (nb_lcores < cfg->nb_stages) {
+		RTE_LOG(ERR, FFPP,
+			"Pipeline mode needs one worker lcore per stage.\n");
+		return -EINVAL;
+	}
+
+	for (s = 0; s < cfg->nb_stages; ++s) {
+		struct worker *w = &(rt->workers[lcores[s]]);
+		w->role = FFPP_WORKER_ROLE_STAGE;
+		w->stage = s;
+		rt->stage_lcores[s] = lcores[s];
+	}
+
+	for (q = 0; q < cfg->nb_rx_queues; ++q) {
+		for (p = 0; p < cfg->nb_ports; ++p) {
+			add_rxq(&(rt->workers[lcores[0]]), p, q);
+		}
+	}
+
+	for (s = 0; s + 1 < cfg->nb_stages; ++s) {
+		snprintf(name, sizeof(name), "ffpp_worker_%u_%u", rt->id, s);
+		rt->rings[s] = rte_ring_create(
+			name, cfg->ring_size, rte_lcore_to_socket_id(lcores[s + 1]),
+			RING_F_SP_ENQ | RING_F_SC_DEQ);
+		if (rt->rings[s] == NULL) {
+			RTE_LOG(ERR, FFPP, "Can not create ring: %s\n", name);
+			return -ENOMEM;
+		}
+	}
+
+	return setup_tx_buffers(
+		rt, &(rt->workers[lcores[cfg->nb_stages - 1]]), 0);
+}
+
+static void ws_batch_init(struct rte_mempool *mp, void *opaque, void *obj,
+			  unsigned int obj_idx)
+{
+	const struct ffpp_worker_runtime *rt = opaque;
+	struct ffpp_ws_batch *b = obj;
+
+	RTE_SET_USED(obj_idx);
+	b->vec.len = 0;
+	b->vec.capacity = rt->cfg.burst_size;
+	b->vec.socket_id = mp->socket_id;
+	b->vec.head = b->pkts;
+}
+
+static int assign_steal(struct ffpp_worker_runtime *rt,
+			const unsigned int *lcores, unsigned int nb_lcores)
+{
+	const struct ffpp_worker_config *cfg = &(rt->cfg);
+	char name[RTE_MEMPOOL_NAMESIZE];
+	unsigned int tx_lcore, nb_batches, nb_rxqs, window, k;
+	int socket_id;
+
+	if (nb_lcores < 2) {
+		RTE_LOG(ERR, FFPP,
+			"Work-stealing mode needs at least two worker lcores.\n");
+		return -EINVAL;
+	}
+	tx_lcore = lcores[nb_lcores - 1];
+	rt->nb_ws_lcores = nb_lcores - 1;
+	assign_rxqs(rt, lcores, rt->nb_ws_lcores, FFPP_WORKER_ROLE_WS);
+	for (k = 0; k < rt->nb_ws_lcores; ++k) {
+		struct worker *w = &(rt->workers[lcores[k]]);
+		// Workers without RX queues only steal.
+		w->role = FFPP_WORKER_ROLE_WS;
+		w->next_victim = k;
+		w->deque = ffpp_wsdeque_create(FFPP_WORKER_WS_DEQUE_SIZE,
+					       rte_lcore_to_socket_id(lcores[k]));
+		if (w->deque == NULL) {
+			return -ENOMEM;
+		}
+		rt->ws_lcores[k] = lcores[k];
+	}
+
+	socket_id = rte_lcore_to_socket_id(tx_lcore);
+	// Every poll takes a batch before the RX burst and puts it back if
+	// the burst is empty, the per-lcore caches keep this off the shared
+	// ring. The caches of all lcores (up to 1.5 times their size) are
+	// added, so they can not starve a worker.
+	nb_batches = rt->nb_ws_lcores * FFPP_WORKER_WS_DEQUE_SIZE * 2 +
+		     nb_lcores * FFPP_WORKER_WS_BATCH_CACHE_SIZE * 3 / 2;
+	snprintf(name, sizeof(name), "ffpp_ws_batch_%u", rt->id);
+	rt->ws_batch_pool = rte_mempool_create(
+		name, nb_batches,
+		sizeof(struct ffpp_ws_batch) +
+			sizeof(struct rte_mbuf *) * cfg->burst_size,
+		FFPP_WORKER_WS_BATCH_CACHE_SIZE, 0, NULL, NULL, ws_batch_init,
+		rt, socket_id, 0);
+	if (rt->ws_batch_pool == NULL) {
+		RTE_LOG(ERR, FFPP, "Can not create the batch pool: %s\n", name);
+		return -ENOMEM;
+	}
+	// The ring can hold all batches, so enqueuing never fails.
+	snprintf(name, sizeof(name), "ffpp_ws_tx_%u", rt->id);
+	rt->ws_tx_ring = rte_ring_create(name, rte_align32pow2(nb_batches + 1),
+					 socket_id, RING_F_SC_DEQ);
+	if (rt->ws_tx_ring == NULL) {
+		RTE_LOG(ERR, FFPP, "Can not create ring: %s\n", name);
+		return -ENOMEM;
+	}
+
+	nb_rxqs = cfg->nb_ports * cfg->nb_rx_queues;
+	window = rte_align32pow2(nb_batches);
+	rt->ws_reorder = rte_zmalloc_socket(
+		"ffpp_ws_reorder", sizeof(struct ffpp_ws_reorder) * nb_rxqs,
+		RTE_CACHE_LINE_SIZE, socket_id);
+	rt->ws_windows = rte_zmalloc_socket(
+		"ffpp_ws_windows",
+		sizeof(struct ffpp_ws_batch *) * nb_rxqs * window,
+		RTE_CACHE_LINE_SIZE, socket_id);
+	if (rt->ws_reorder == NULL || rt->ws_windows == NULL) {
+		return -ENOMEM;
+	}
+	for (k = 0; k < nb_rxqs; ++k) {
+		rt->ws_reorder[k].mask = window - 1;
+		rt->ws_reorder[k].window = rt->ws_windows + k * window;
+	}
+
+	rt->workers[tx_lcore].role = FFPP_WORKER_ROLE_WS_TX;
+	return setup_tx_buffers(rt, &(rt->workers[tx_lcore]), 0);
+}
+
+struct ffpp_worker_runtime *
+ffpp_workers_create(const struct ffpp_worker_config *cfg)
+{
+	static unsigned int rt_cnt = 0;
+	struct ffpp_worker_runtime *rt;
+	unsigned int lcores[RTE_MAX_LCORE];
+	unsigned int nb_lcores = 0;
+	unsigned int lcore_id;
+	uint16_t i;
+	int ret;
+
+	if (check_worker_config(cfg) < 0) {
+		rte_errno = EINVAL;
+		return NULL;
+	}
+
+	rt = rte_zmalloc("ffpp_worker_runtime", sizeof(*rt),
+			 RTE_CACHE_LINE_SIZE);
+	if (rt == NULL) {
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+	rt->cfg = *cfg;
+	rt->id = rt_cnt++;
+	if (rt->cfg.burst_size == 0) {
+		rt->cfg.burst_size = FFPP_WORKER_BURST_SIZE_DEFAULT;
+	}
+	if (rt->cfg.tx_drain_us == 0) {
+		rt->cfg.tx_drain_us = FFPP_WORKER_TX_DRAIN_US_DEFAULT;
+	}
+	if (rt->cfg.ring_size == 0) {
+		rt->cfg.ring_size = FFPP_WORKER_RING_SIZE_DEFAULT;
+	}
+	rt->tx_drain_tsc = (rte_get_tsc_hz() + US_PER_S - 1) / US_PER_S *
+			   rt->cfg.tx_drain_us;
+	for (i = 0; i < rt->cfg.nb_ports; ++i) {
+		rt->port_idx[rt->cfg.port_ids[i]] = i;
+	}
+
+	rt->cycle_stats = ffpp_cycle_stats_get();
+	if (rt->cycle_stats == NULL) {
+		ffpp_workers_destroy(rt);
+		rte_errno = ENOMEM;
+		return NULL;
+	}
+
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		rt->workers[lcore_id].core_id = lcore_id;
+		rt->workers[lcore_id].rt = rt;
+		rt->workers[lcore_id].cycles =
+			&(rt->cycle_stats->lcores[lcore_id]);
+		rt->workers[lcore_id].burst_hist =
+			ffpp_hist_create(rte_lcore_to_socket_id(lcore_id));
+		if (rt->workers[lcore_id].burst_hist == NULL) {
+			ffpp_workers_destroy(rt);
+			rte_errno = ENOMEM;
+			return NULL;
+		}
+		lcores[nb_lcores++] = lcore_id;
+	}
+	if (nb_lcores == 0) {
+		RTE_LOG(ERR, FFPP, "No worker lcore is available.\n");
+		ffpp_workers_destroy(rt);
+		rte_errno = EINVAL;
+		return NULL;
+	}
+
+	switch (rt->cfg.mode) {
+	case FFPP_WORKER_MODE_PIPELINE:
+		ret = assign_pipeline(rt, lcores, nb_lcores);
+		break;
+	case FFPP_WORKER_MODE_STEAL:
+		ret = assign_steal(rt, lcores, nb_lcores);
+		break;
+	default:
+		ret = assign_rtc(rt, lcores, nb_lcores);
+	}
+	if (ret < 0) {
+		ffpp_workers_destroy(rt);
+		rte_errno = -ret;
+		return NULL;
+	}
+
+	return rt;
+}
+
+static __rte_always_inline void run_stage(const struct ffpp_worker_config *cfg,
+					  struct worker *w,
+					  struct ffpp_mvec *vec, uint16_t s)
+{
+	uint16_t n;
+
+	n = cfg->handlers[s](vec, cfg->handler_args[s]);
+	n = RTE_MIN(n, vec->len);
+	if (unlikely(n < vec->len)) {
+		rte_pktmbuf_free_bulk(vec->head + n, vec->len - n);
+		w->stats.nf_dropped += vec->len - n;
+	}
+	vec->len = n;
+}
+
+/**
+ * Flush all TX buffers of the worker, started at start_tsc. Return the TSC
+ * after flushing.
+ */
+static uint64_t flush_tx_buffers(struct ffpp_worker_runtime *rt,
+				 struct worker *w, uint64_t start_tsc)
+{
+	uint64_t end_tsc;
+	uint16_t i;
+
+	for (i = 0; i < rt->cfg.nb_ports; ++i) {
+		if (w->tx_buffers[i] == NULL) {
+			continue;
+		}
+		w->stats.tx_pkts += rte_eth_tx_buffer_flush(
+			rt->cfg.port_ids[i], w->txqs[i].id, w->tx_buffers[i]);
+	}
+	end_tsc = rte_rdtsc();
+	ffpp_lcore_cycles_tx(w->cycles, end_tsc - start_tsc);
+	return end_tsc;
+}
+
+/**
+ * Account an empty poll started at start_tsc.
+ */
+static __rte_always_inline void account_idle(struct worker *w,
+					     uint64_t start_tsc)
+{
+	uint64_t end_tsc = rte_rdtsc();
+
+	ffpp_lcore_cycles_poll(w->cycles, true, end_tsc - start_tsc, end_tsc);
+}
+
+/**
+ * Account the processing of a burst started at start_tsc. Return the TSC after
+ * processing.
+ */
+static __rte_always_inline uint64_t account_proc(struct worker *w,
+						 uint64_t start_tsc)
+{
+	uint64_t end_tsc = rte_rdtsc();
+
+	ffpp_lcore_cycles_poll(w->cycles, false, end_tsc - start_tsc, end_tsc);
+	ffpp_hist_record(w->burst_hist, end_tsc - start_tsc);
+	return end_tsc;
+}
+
+static __rte_always_inline uint16_t rx_next_queue(struct ffpp_worker_runtime *rt,
+						  struct worker *w,
+						  struct ffpp_mvec *vec,
+						  uint16_t *next,
+						  uint16_t *rxq_idx)
+{
+	const struct rx_queue *rxq = &(w->rxqs[*next]);
+	uint16_t nb_rx;
+
+	*rxq_idx = *next;
+	*next = (*next + 1 == w->nb_rxqs) ? 0 : *next + 1;
+	nb_rx = rte_eth_rx_burst(rt->cfg.port_ids[rxq->port_idx], rxq->id,
+				 vec->head, rt->cfg.burst_size);
+	w->stats.rx_polls++;
+	if (nb_rx == 0) {
+		w->stats.rx_empty_polls++;
+	}
+	w->stats.rx_pkts += nb_rx;
+	vec->len = nb_rx;
+	return nb_rx;
+}
+
+static void worker_loop_rtc(struct ffpp_worker_runtime *rt, struct worker *w,
+			    struct ffpp_mvec *vec)
+{
+	const struct ffpp_worker_config *cfg = &(rt->cfg);
+	uint64_t prev_tsc = rte_rdtsc();
+	uint64_t cur_tsc;
+	uint16_t next = 0;
+	uint16_t rxq_idx, out_idx, s, i;
+
+	while (!rt->stop) {
+		cur_tsc = rte_rdtsc();
+		if (unlikely(cur_tsc - prev_tsc > rt->tx_drain_tsc)) {
+			cur_tsc = flush_tx_buffers(rt, w, cur_tsc);
+			prev_tsc = cur_tsc;
+		}
+
+		if (rx_next_queue(rt, w, vec, &next, &rxq_idx) == 0) {
+			account_idle(w, cur_tsc);
+			continue;
+		}
+		for (s = 0; s < cfg->nb_stages && vec->len > 0; ++s) {
+			run_stage(cfg, w, vec, s);
+		}
+		cur_tsc = account_proc(w, cur_tsc);
+
+		out_idx = cfg->tx_port_map[w->rxqs[rxq_idx].port_idx];
+		for (i = 0; i < vec->len; ++i) {
+			w->stats.tx_pkts += rte_eth_tx_buffer(
+				cfg->port_ids[out_idx], w->txqs[out_idx].id,
+				w->tx_buffers[out_idx], vec->head[i]);
+		}
+		ffpp_lcore_cycles_tx(w->cycles, rte_rdtsc() - cur_tsc);
+	}
+	flush_tx_buffers(rt, w, rte_rdtsc());
+}
+
+static void worker_loop_stage(struct ffpp_worker_runtime *rt, struct worker *w,
+			      struct ffpp_mvec *vec)
+{
+	const struct ffpp_worker_config *cfg = &(rt->cfg);
+	const uint16_t s = w->stage;
+	const bool last = (s == cfg->nb_stages - 1);
+	struct rte_ring *in = (s > 0) ? rt->rings[s - 1] : NULL;
+	struct rte_ring *out = last ? NULL : rt->rings[s];
+	uint64_t prev_tsc = rte_rdtsc();
+	uint64_t cur_tsc;
+	uint16_t next = 0;
+	uint16_t rxq_idx, out_idx, n, i;
+	struct rte_mbuf *m;
+
+	while (true) {
+		cur_tsc = rte_rdtsc();
+		if (last && unlikely(cur_tsc - prev_tsc > rt->tx_drain_tsc)) {
+			cur_tsc = flush_tx_buffers(rt, w, cur_tsc);
+			prev_tsc = cur_tsc;
+		}
+
+		if (in == NULL) {
+			if (rt->stop) {
+				break;
+			}
+			if (rx_next_queue(rt, w, vec, &next, &rxq_idx) == 0) {
+				account_idle(w, cur_tsc);
+				continue;
+			}
+		} else {
+			vec->len = rte_ring_sc_dequeue_burst(
+				in, (void **)vec->head, cfg->burst_size, NULL);
+			if (vec->len == 0) {
+				account_idle(w, cur_tsc);
+				// The upstream stage stopped and all its
+				// packets are processed.
+				if (rt->stage_done[s - 1]) {
+					rte_smp_rmb();
+					if (rte_ring_empty(in)) {
+						break;
+					}
+				}
+				continue;
+			}
+		}
+
+		run_stage(cfg, w, vec, s);
+		cur_tsc = account_proc(w, cur_tsc);
+		if (vec->len == 0) {
+			continue;
+		}
+
+		if (!last) {
+			n = rte_ring_sp_enqueue_burst(out, (void **)vec->head,
+						      vec->len, NULL);
+			if (unlikely(n < vec->len)) {
+				rte_pktmbuf_free_bulk(vec->head + n,
+						      vec->len - n);
+				w->stats.ring_dropped += vec->len - n;
+			}
+		} else {
+			for (i = 0; i < vec->len; ++i) {
+				m = vec->head[i];
+				out_idx = cfg->tx_port_map[rt->port_idx[m->port]];
+				w->stats.tx_pkts += rte_eth_tx_buffer(
+					cfg->port_ids[out_idx],
+					w->txqs[out_idx].id,
+					w->tx_buffers[out_idx], m);
+			}
+		}
+		ffpp_lcore_cycles_tx(w->cycles, rte_rdtsc() - cur_tsc);
+	}
+
+	if (last) {
+		flush_tx_buffers(rt, w, rte_rdtsc());
+	}
+	rte_smp_wmb();
+	rt->stage_done[s] = true;
+}
+
+static void ws_process(struct ffpp_worker_runtime *rt, struct worker *w,
+		       struct ffpp_ws_batch *b)
+{
+	const struct ffpp_worker_config *cfg = &(rt->cfg);
+	uint16_t s;
+
+	for (s = 0; s < cfg->nb_stages && b->vec.len > 0; ++s) {
+		run_stage(cfg, w, &(b->vec), s);
+	}
+	// Empty batches are still sent to keep the sequence numbers contiguous.
+	rte_ring_mp_enqueue(rt->ws_tx_ring, b);
+}
+
+/**
+ * Steal half of the queued batches of the next busy victim, one CAS per
+ * batch. The first one is returned, the others are queued locally.
+ */
+static struct ffpp_ws_batch *ws_steal(struct ffpp_worker_runtime *rt,
+				      struct worker *w)
+{
+	struct ffpp_ws_batch *first = NULL;
+	struct ffpp_ws_batch *b;
+	struct worker *victim;
+	uint32_t n, i;
+	uint16_t k;
+
+	for (k = 0; k < rt->nb_ws_lcores; ++k) {
+		w->next_victim = (w->next_victim + 1) % rt->nb_ws_lcores;
+		victim = &(rt->workers[rt->ws_lcores[w->next_victim]]);
+		if (victim == w) {
+			continue;
+		}
+		n = ffpp_wsdeque_count(victim->deque);
+		if (n == 0) {
+			continue;
+		}
+		n = (n + 1) / 2;
+		for (i = 0; i < n; ++i) {
+			b = ffpp_wsdeque_steal(victim->deque);
+			if (b == NULL) {
+				break;
+			}
+			w->stats.stolen_batches++;
+			if (first == NULL) {
+				first = b;
+			} else if (ffpp_wsdeque_push(w->deque, b) < 0) {
+				ws_process(rt, w, b);
+			}
+		}
+		if (first != NULL) {
+			return first;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * The owner also consumes its deque from the top, so the batches of a RX queue
+ * are processed in arrival order and the reorder stage rarely holds them back.
+ */
+static __rte_always_inline struct ffpp_ws_batch *ws_next(struct worker *w)
+{
+	struct ffpp_ws_batch *b;
+
+	do {
+		b = ffpp_wsdeque_steal(w->deque);
+	} while (b == NULL && ffpp_wsdeque_count(w->deque) > 0);
+	return b;
+}
+
+static void worker_loop_ws(struct ffpp_worker_runtime *rt, struct worker *w)
+{
+	struct ffpp_ws_batch *b;
+	uint16_t next = 0;
+	uint16_t rxq_idx, i;
+	const struct rx_queue *rxq;
+	uint64_t cur_tsc;
+	bool busy;
+
+	while (!rt->stop) {
+		cur_tsc = rte_rdtsc();
+		busy = false;
+		for (i = 0; i < FFPP_WORKER_WS_RX_BURSTS && w->nb_rxqs > 0;
+		     ++i) {
+			if (ffpp_wsdeque_count(w->deque) >= w->deque->size ||
+			    rte_mempool_get(rt->ws_batch_pool, (void **)&b) <
+				    0) {
+				break;
+			}
+			if (rx_next_queue(rt, w, &(b->vec), &next, &rxq_idx) ==
+			    0) {
+				rte_mempool_put(rt->ws_batch_pool, b);
+				continue;
+			}
+			rxq = &(w->rxqs[rxq_idx]);
+			b->port_idx = rxq->port_idx;
+			b->rxq_idx =
+				rxq->port_idx * rt->cfg.nb_rx_queues + rxq->id;
+			b->seqn = w->rxq_seqn[rxq_idx]++;
+			busy = true;
+			if (ffpp_wsdeque_push(w->deque, b) < 0) {
+				ws_process(rt, w, b);
+			}
+		}
+
+		b = ws_next(w);
+		if (b == NULL) {
+			b = ws_steal(rt, w);
+		}
+		if (b != NULL) {
+			ws_process(rt, w, b);
+			busy = true;
+		}
+
+		// Handing batches to the TX lcore is accounted as processing.
+		if (busy) {
+			account_proc(w, cur_tsc);
+		} else {
+			account_idle(w, cur_tsc);
+		}
+	}
+
+	while ((b = ws_next(w)) != NULL) {
+		ws_process(rt, w, b);
+	}
+	__atomic_fetch_sub(&rt->ws_running, 1, __ATOMIC_RELEASE);
+}
+
+static void ws_tx_batch(struct ffpp_worker_runtime *rt, struct worker *w,
+			struct ffpp_ws_batch *b)
+{
+	const struct ffpp_worker_config *cfg = &(rt->cfg);
+	uint16_t out_idx = cfg->tx_port_map[b->port_idx];
+	uint16_t i;
+
+	for (i = 0; i < b->vec.len; ++i) {
+		w->stats.tx_pkts += rte_eth_tx_buffer(
+			cfg->port_ids[out_idx], w->txqs[out_idx].id,
+			w->tx_buffers[out_idx], b->vec.head[i]);
+	}
+	b->vec.len = 0;
+	rte_mempool_put(rt->ws_batch_pool, b);
+}
+
+static void ws_reorder_tx(struct ffpp_worker_runtime *rt, struct worker *w,
+			  struct ffpp_ws_batch *b)
+{
+	struct ffpp_ws_reorder *ro = &(rt->ws_reorder[b->rxq_idx]);
+
+	if (b->seqn != ro->next) {
+		ro->window[b->seqn & ro->mask] = b;
+		return;
+	}
+	do {
+		ro->window[ro->next & ro->mask] = NULL;
+		ws_tx_batch(rt, w, b);
+		ro->next++;
+		b = ro->window[ro->next & ro->mask];
+	} while (b != NULL);
+}
+
+static void worker_loop_ws_tx(struct ffpp_worker_runtime *rt, struct worker *w)
+{
+	struct ffpp_ws_batch *batches[FFPP_WORKER_BURST_SIZE_DEFAULT];
+	uint64_t prev_tsc = rte_rdtsc();
+	uint64_t cur_tsc;
+	unsigned int n, i;
+
+	while (true) {
+		cur_tsc = rte_rdtsc();
+		if (unlikely(cur_tsc - prev_tsc > rt->tx_drain_tsc)) {
+			cur_tsc = flush_tx_buffers(rt, w, cur_tsc);
+			prev_tsc = cur_tsc;
+		}
+
+		n = rte_ring_sc_dequeue_burst(rt->ws_tx_ring, (void **)batches,
+					      RTE_DIM(batches), NULL);
+		if (n == 0) {
+			account_idle(w, cur_tsc);
+			if (__atomic_load_n(&rt->ws_running, __ATOMIC_ACQUIRE) ==
+				    0 &&
+			    rte_ring_empty(rt->ws_tx_ring)) {
+				break;
+			}
+			continue;
+		}
+		cur_tsc = account_proc(w, cur_tsc);
+		for (i = 0; i < n; ++i) {
+			ws_reorder_tx(rt, w, batches[i]);
+		}
+		ffpp_lcore_cycles_tx(w->cycles, rte_rdtsc() - cur_tsc);
+	}
+	flush_tx_buffers(rt, w, rte_rdtsc());
+}
+
+int ffpp_worker_main(void *arg)
+{
+	struct worker *w = arg;
+	struct ffpp_worker_runtime *rt = w->rt;
+	struct ffpp_mvec vec;
+	int ret = 0;
+
+	if (w->role == FFPP_WORKER_ROLE_IDLE) {
+		return 0;
+	}
+
+	__atomic_store_n(&(w->cycles->active), 1, __ATOMIC_RELAXED);
+	switch (w->role) {
+	case FFPP_WORKER_ROLE_WS:
+		worker_loop_ws(rt, w);
+		break;
+	case FFPP_WORKER_ROLE_WS_TX:
+		worker_loop_ws_tx(rt, w);
+		break;
+	default:
+		if (ffpp_mvec_init(&vec, rt->cfg.burst_size) < 0) {
+			RTE_LOG(ERR, FFPP,
+				"Lcore %u can not allocate the vector.\n",
+				w->core_id);
+			if (w->role == FFPP_WORKER_ROLE_STAGE) {
+				rt->stage_done[w->stage] = true;
+			}
+			ret = -ENOMEM;
+			break;
+		}
+		RTE_LOG(INFO, FFPP, "Lcore %u polls %u RX queues.\n",
+			w->core_id, w->nb_rxqs);
+		if (w->role == FFPP_WORKER_ROLE_RTC) {
+			worker_loop_rtc(rt, w, &vec);
+		} else {
+			worker_loop_stage(rt, w, &vec);
+		}
+		ffpp_mvec_free(&vec);
+	}
+	__atomic_store_n(&(w->cycles->active), 0, __ATOMIC_RELAXED);
+
+	return ret;
+}
+
+int ffpp_workers_launch(struct ffpp_worker_runtime *rt)
+{
+	struct worker *w;
+	unsigned int lcore_id;
+	uint16_t s;
+	int ret;
+
+	rt->stop = false;
+	for (s = 0; s < FFPP_WORKER_MAX_STAGES; ++s) {
+		rt->stage_done[s] = false;
+	}
+	__atomic_store_n(&rt->ws_running, rt->nb_ws_lcores, __ATOMIC_RELAXED);
+	rte_smp_wmb();
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		w = &(rt->workers[lcore_id]);
+		if (w->role == FFPP_WORKER_ROLE_IDLE) {
+			continue;
+		}
+		ret = rte_eal_remote_launch(ffpp_worker_main, w, lcore_id);
+		if (ret < 0) {
+			RTE_LOG(ERR, FFPP, "Cannot launch worker for core:%u\n",
+				lcore_id);
+			return ret;
+		}
+		w->launched = true;
+	}
+	return 0;
+}
+
+void ffpp_workers_stop(struct ffpp_worker_runtime *rt)
+{
+	rt->stop = true;
+	rte_smp_wmb();
+}
+
+void ffpp_workers_wait(struct ffpp_worker_runtime *rt)
+{
+	unsigned int lcore_id;
+
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		if (rt->workers[lcore_id].launched) {
+			rte_eal_wait_lcore(lcore_id);
+			rt->workers[lcore_id].launched = false;
+		}
+	}
+}
+
+void ffpp_workers_get_stats(const struct ffpp_worker_runtime *rt,
+			    struct ffpp_worker_stats *total)
+{
+	const struct ffpp_worker_stats *st;
+	unsigned int lcore_id;
+
+	memset(total, 0, sizeof(*total));
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		st = &(rt->workers[lcore_id].stats);
+		total->rx_pkts += st->rx_pkts;
+		total->tx_pkts += st->tx_pkts;
+		total->tx_dropped += st->tx_dropped;
+		total->nf_dropped += st->nf_dropped;
+		total->ring_dropped += st->ring_dropped;
+		total->rx_polls += st->rx_polls;
+		total->rx_empty_polls += st->rx_empty_polls;
+		total->stolen_batches += st->stolen_batches;
+	}
+}
+
+void ffpp_workers_get_burst_hist(const struct ffpp_worker_runtime *rt,
+				 struct ffpp_hist *hist)
+{
+	const struct worker *w;
+	unsigned int lcore_id;
+
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		w = &(rt->workers[lcore_id]);
+		if (w->role != FFPP_WORKER_ROLE_IDLE) {
+			ffpp_hist_merge(hist, w->burst_hist);
+		}
+	}
+}
+
+void ffpp_workers_print_stats(const struct ffpp_worker_runtime *rt)
+{
+	struct ffpp_hist *snap;
+	char name[16];
+	const struct worker *w;
+	unsigned int lcore_id;
+
+	printf("lcore,rx_pkts,tx_pkts,tx_dropped,nf_dropped,ring_dropped,"
+	       "rx_polls,rx_empty_polls,stolen_batches\n");
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		w = &(rt->workers[lcore_id]);
+		if (w->role == FFPP_WORKER_ROLE_IDLE) {
+			continue;
+		}
+		printf("%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n", lcore_id,
+		       w->stats.rx_pkts, w->stats.tx_pkts, w->stats.tx_dropped,
+		       w->stats.nf_dropped, w->stats.ring_dropped,
+		       w->stats.rx_polls, w->stats.rx_empty_polls,
+		       w->stats.stolen_batches);
+	}
+
+	snap = rte_malloc("ffpp_hist_snap", sizeof(*snap), RTE_CACHE_LINE_SIZE);
+	if (snap == NULL) {
+		return;
+	}
+	printf("lcore,bursts,mean_us,min_us,p50_us,p99_us,p999_us,max_us\n");
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		w = &(rt->workers[lcore_id]);
+		if (w->role == FFPP_WORKER_ROLE_IDLE) {
+			continue;
+		}
+		ffpp_hist_snapshot(w->burst_hist, snap);
+		snprintf(name, sizeof(name), "%u", lcore_id);
+		ffpp_hist_print(stdout, name, snap, rte_get_tsc_hz());
+	}
+	rte_free(snap);
+}
+
+void ffpp_workers_destroy(struct ffpp_worker_runtime *rt)
+{
+	unsigned int lcore_id;
+	uint16_t i;
+
+	if (rt == NULL) {
+		return;
+	}
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		for (i = 0; i < FFPP_MAX_PORTS; ++i) {
+			rte_free(rt->workers[lcore_id].tx_buffers[i]);
+		}
+		ffpp_wsdeque_free(rt->workers[lcore_id].deque);
+		ffpp_hist_free(rt->workers[lcore_id].burst_hist);
+	}
+	for (i = 0; i < FFPP_WORKER_MAX_STAGES; ++i) {
+		rte_ring_free(rt->rings[i]);
+	}
+	rte_ring_free(rt->ws_tx_ring);
+	rte_mempool_free(rt->ws_batch_pool);
+	rte_free(rt->ws_reorder);
+	rte_free(rt->ws_windows);
+	rte_free(rt);
+}
@@ -40,6 +40,9 @@ struct rte_mbuf *mbuf_deep_copy(struct rte_mempool *mbuf_pool,
 	}
 	struct rte_mbuf *m_copy;
 	m_copy = rte_pktmbuf_alloc(mbuf_pool);
+	if (m_copy == NULL) {
+		return NULL;
+	}
 	m_copy->data_len = m->data_len;
 	m_copy->pkt_len = m->pkt_len;
 	if (rte_pktmbuf_headroom(m) != RTE_PKTMBUF_HEADROOM) {
@@ -86,6 +89,7 @@ void save_double_list_csv(char *path, double *list, size_t n)
 	fd = fopen(path, "a+");
 	if (fd == NULL) {
 		perror("Can not open the CSV file!");
+		return;
 	}
 	for (i = 0; i < n; ++i) {
 		fprintf(fd, "%.8f,", list[i]);
@@ -102,6 +106,7 @@ void save_u64_list_csv(char *path, uint64_t *list, size_t n)
 	fd = fopen(path, "a+");
 	if (fd == NULL) {
 		perror("Can not open the CSV file!");
+		return;
 	}
 	for (i = 0; i < n; ++i) {
 		fprintf(fd, "%lu,", list[i]);
@@ -1,4 +1,5 @@
 import os
+import pickle
 import time
 
 import numpy as np
@@ -37,6 +38,65 @@ def print_vector(vector):
     print(vector)
 
 
+# APU handlers of test_pye, see ffpp/pye.h.
+
+
+def apu_echo(payloads, lengths):
+    """Drop the payloads that start with b"drop", increment the first byte of
+    the others and truncate them to 8 bytes."""
+    for i, payload in enumerate(payloads):
+        if lengths[i] == 0:
+            continue
+        if payload[:4] == b"drop":
+            lengths[i] = -1
+            continue
+        payload[0] = (payload[0] + 1) % 256
+        lengths[i] = min(lengths[i], 8)
+
+
+def apu_verdicts(payloads, lengths):
+    """Keep the even packets unchanged and drop the odd ones."""
+    return [lengths[i] if i % 2 == 0 else -1 for i in range(len(payloads))]
+
+
+def apu_numpy(payloads, lengths):
+    """Append the packet index (4 bytes, big endian) to each payload."""
+    lens = np.frombuffer(lengths, dtype=np.int32)
+    for i, payload in enumerate(payloads):
+        data = np.frombuffer(payload, dtype=np.uint8)
+        data[lens[i] : lens[i] + 4] = np.frombuffer(
+            i.to_bytes(4, "big"), dtype=np.uint8
+        )
+    lens += 4
+
+
+def apu_raise(payloads, lengths):
+    raise ValueError("APU handler failed")
+
+
+kept_export = None
+
+
+def apu_keep_export(payloads, lengths):
+    """Keep an export of a payload after the call."""
+    global kept_export
+    kept_export = pickle.PickleBuffer(payloads[1])
+
+
+def apu_pid(payloads, lengths):
+    """Drop the payloads that start with b"drop", replace the others with the
+    process ID of the worker (4 bytes, big endian)."""
+    pid = os.getpid().to_bytes(4, "big")
+    for i, payload in enumerate(payloads):
+        if lengths[i] == 0:
+            continue
+        if payload[:4] == b"drop":
+            lengths[i] = -1
+            continue
+        payload[:4] = pid
+        lengths[i] = 4
+
+
 if __name__ == "__main__":
     print("Test file path: %s" % os.path.realpath(__file__))
     print("Today is: %s" % time.ctime(time.time()))
@@ -0,0 +1,336 @@
+/*
+ * test_aes.cpp
+ *
+ * Check every implementation of aes.c that the CPU supports against the NIST
+ * SP 800-38A vectors and against the software code for many lengths, partial
+ * CTR blocks, counter wrap-around and chained calls. GCM is checked against
+ * the test cases 2 and 4 of the GCM specification (McGrew and Viega) and the
+ * multi-buffer functions against single calls of the software code.
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "ffpp/aes.h"
+
+static const uint8_t key[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae,
+				 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88,
+				 0x09, 0xcf, 0x4f, 0x3c };
+
+static const uint8_t plain[64] = {
+	0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e,
+	0x11, 0x73, 0x93, 0x17, 0x2a, 0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03,
+	0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51, 0x30,
+	0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19,
+	0x1a, 0x0a, 0x52, 0xef, 0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b,
+	0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+
+static const uint8_t ecb_cipher[16] = { 0x3a, 0xd7, 0x7b, 0xb4, 0x0d, 0x7a,
+					0x36, 0x60, 0xa8, 0x9e, 0xca, 0xf3,
+					0x24, 0x66, 0xef, 0x97 };
+
+static const uint8_t cbc_iv[16] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+				    0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+				    0x0c, 0x0d, 0x0e, 0x0f };
+
+static const uint8_t cbc_cipher[64] = {
+	0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46, 0xce, 0xe9, 0x8e,
+	0x9b, 0x12, 0xe9, 0x19, 0x7d, 0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72,
+	0x19, 0xee, 0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2, 0x73,
+	0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b, 0x71, 0x16, 0xe6, 0x9e,
+	0x22, 0x22, 0x95, 0x16, 0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac,
+	0x09, 0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7
+};
+
+static const uint8_t ctr_iv[16] = { 0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5,
+				    0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb,
+				    0xfc, 0xfd, 0xfe, 0xff };
+
+static const uint8_t ctr_cipher[64] = {
+	0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68,
+	0x64, 0x99, 0x0d, 0xb6, 0xce, 0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70,
+	0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff, 0x5a,
+	0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02,
+	0x0d, 0xb0, 0x3e, 0xab, 0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03,
+	0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee
+};
+
+// GCM test case 4: a partial last block and AAD that is not a whole block.
+static const uint8_t gcm_key[16] = { 0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65,
+				     0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94,
+				     0x67, 0x30, 0x83, 0x08 };
+
+static const uint8_t gcm_iv[AES_GCM_IVLEN] = { 0xca, 0xfe, 0xba, 0xbe,
+					       0xfa, 0xce, 0xdb, 0xad,
+					       0xde, 0xca, 0xf8, 0x88 };
+
+static const uint8_t gcm_aad[20] = { 0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe,
+				     0xef, 0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad,
+				     0xbe, 0xef, 0xab, 0xad, 0xda, 0xd2 };
+
+static const uint8_t gcm_plain[60] = {
+	0xd9, 0x31, 0x32, 0x25, 0xf8, 0x84, 0x06, 0xe5, 0xa5, 0x59, 0x09, 0xc5,
+	0xaf, 0xf5, 0x26, 0x9a, 0x86, 0xa7, 0xa9, 0x53, 0x15, 0x34, 0xf7, 0xda,
+	0x2e, 0x4c, 0x30, 0x3d, 0x8a, 0x31, 0x8a, 0x72, 0x1c, 0x3c, 0x0c, 0x95,
+	0x95, 0x68, 0x09, 0x53, 0x2f, 0xcf, 0x0e, 0x24, 0x49, 0xa6, 0xb5, 0x25,
+	0xb1, 0x6a, 0xed, 0xf5, 0xaa, 0x0d, 0xe6, 0x57, 0xba, 0x63, 0x7b, 0x39
+};
+
+static const uint8_t gcm_cipher[60] = {
+	0x42, 0x83, 0x1e, 0xc2, 0x21, 0x77, 0x74, 0x24, 0x4b, 0x72, 0x21, 0xb7,
+	0x84, 0xd0, 0xd4, 0x9c, 0xe3, 0xaa, 0x21, 0x2f, 0x2c, 0x02, 0xa4, 0xe0,
+	0x35, 0xc1, 0x7e, 0x23, 0x29, 0xac, 0xa1, 0x2e, 0x21, 0xd5, 0x14, 0xb2,
+	0x54, 0x66, 0x93, 0x1c, 0x7d, 0x8f, 0x6a, 0x5a, 0xac, 0x84, 0xaa, 0x05,
+	0x1b, 0xa3, 0x0b, 0x39, 0x6a, 0x0a, 0xac, 0x97, 0x3d, 0x58, 0xe0, 0x91
+};
+
+static const uint8_t gcm_tag[AES_GCM_TAGLEN] = { 0x5b, 0xc9, 0x4f, 0xbc,
+						 0x32, 0x21, 0xa5, 0xdb,
+						 0x94, 0xfa, 0xe9, 0x5a,
+						 0xe7, 0x12, 0x1a, 0x47 };
+
+// GCM test case 2: zero key, IV and one zero block.
+static const uint8_t gcm_zero_cipher[16] = { 0x03, 0x88, 0xda, 0xce,
+					     0x60, 0xb6, 0xa3, 0x92,
+					     0xf3, 0x28, 0xc2, 0xb9,
+					     0x71, 0xb2, 0xfe, 0x78 };
+
+static const uint8_t gcm_zero_tag[AES_GCM_TAGLEN] = { 0xab, 0x6e, 0x47, 0xd4,
+						      0x2c, 0xec, 0x13, 0xbd,
+						      0xf5, 0x3a, 0x67, 0xb2,
+						      0x12, 0x57, 0xbd, 0xdf };
+
+static void test_nist(void)
+{
+	struct AES_ctx ctx;
+	uint8_t buf[64];
+
+	AES_init_ctx(&ctx, key);
+	memcpy(buf, plain, 16);
+	AES_ECB_encrypt(&ctx, buf);
+	assert(memcmp(buf, ecb_cipher, 16) == 0);
+	AES_ECB_decrypt(&ctx, buf);
+	assert(memcmp(buf, plain, 16) == 0);
+
+	AES_init_ctx_iv(&ctx, key, cbc_iv);
+	memcpy(buf, plain, sizeof(buf));
+	AES_CBC_encrypt_buffer(&ctx, buf, sizeof(buf));
+	assert(memcmp(buf, cbc_cipher, sizeof(buf)) == 0);
+	AES_ctx_set_iv(&ctx, cbc_iv);
+	AES_CBC_decrypt_buffer(&ctx, buf, sizeof(buf));
+	assert(memcmp(buf, plain, sizeof(buf)) == 0);
+
+	AES_init_ctx_iv(&ctx, key, ctr_iv);
+	memcpy(buf, plain, sizeof(buf));
+	AES_CTR_xcrypt_buffer(&ctx, buf, sizeof(buf));
+	assert(memcmp(buf, ctr_cipher, sizeof(buf)) == 0);
+}
+
+enum mode { CBC_ENC, CBC_DEC, CTR_XCRYPT };
+
+// Run a mode with impl and return the buffer followed by the final IV.
+static std::vector<uint8_t> run(enum AES_impl impl, enum mode m,
+				const uint8_t *iv, uint32_t len)
+{
+	std::vector<uint8_t> out(len + AES_BLOCKLEN);
+	struct AES_ctx ctx;
+
+	assert(AES_set_impl(impl) == 0);
+	for (uint32_t i = 0; i < len; ++i) {
+		out[i] = static_cast<uint8_t>(i * 131 + len);
+	}
+	AES_init_ctx_iv(&ctx, key, iv);
+	// Two calls to check the IV that is carried over.
+	for (uint32_t off : { 0U, len / 2 }) {
+		uint8_t *p = out.data() + off;
+		uint32_t n = off == 0 ? len / 2 : len - len / 2;
+		if (m == CBC_ENC) {
+			AES_CBC_encrypt_buffer(&ctx, p, n);
+		} else if (m == CBC_DEC) {
+			AES_CBC_decrypt_buffer(&ctx, p, n);
+		} else {
+			AES_CTR_xcrypt_buffer(&ctx, p, n);
+		}
+	}
+	memcpy(out.data() + len, ctx.Iv, AES_BLOCKLEN);
+	return out;
+}
+
+static void test_same_as_sw(enum AES_impl impl)
+{
+	// The low 64 bits of the counter wrap after 3 blocks.
+	const uint8_t wrap_iv[16] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				      0x00, 0x01, 0xff, 0xff, 0xff, 0xff,
+				      0xff, 0xff, 0xff, 0xfd };
+	const uint8_t max_iv[16] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+				     0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+				     0xff, 0xff, 0xff, 0xff };
+
+	for (uint32_t blocks = 0; blocks <= 70; ++blocks) {
+		// Each half is a whole number of blocks for CBC.
+		uint32_t len = blocks * 2 * AES_BLOCKLEN;
+		for (enum mode m : { CBC_ENC, CBC_DEC }) {
+			assert(run(impl, m, cbc_iv, len) ==
+			       run(AES_IMPL_SW, m, cbc_iv, len));
+		}
+	}
+	for (uint32_t len = 0; len <= 1600; ++len) {
+		for (const uint8_t *iv : { ctr_iv, wrap_iv, max_iv }) {
+			assert(run(impl, CTR_XCRYPT, iv, len) ==
+			       run(AES_IMPL_SW, CTR_XCRYPT, iv, len));
+		}
+	}
+}
+
+// Buffers of mixed lengths, including empty ones and partial blocks, so that
+// the lanes finish at different times and are refilled. The reference is one
+// call of AES_CBC_encrypt_buffer() per buffer with the software code.
+static void test_multi(enum AES_impl impl)
+{
+	const uint32_t max_n = 20;
+	uint8_t ivs[max_n][AES_BLOCKLEN];
+	struct AES_ctx ctx;
+
+	AES_init_ctx(&ctx, key);
+	for (uint32_t n = 0; n <= max_n; ++n) {
+		std::vector<std::vector<uint8_t>> bufs(n), expected(n);
+		std::vector<uint8_t *> ptrs(n);
+		std::vector<uint32_t> lengths(n);
+		for (uint32_t i = 0; i < n; ++i) {
+			lengths[i] = i % 7 == 3 ? 0 : (i * 389 + n * 97) % 1601;
+			// A partial last block is processed as a whole block.
+			bufs[i].assign(lengths[i] + AES_BLOCKLEN, 0);
+			for (uint32_t j = 0; j < lengths[i]; ++j) {
+				bufs[i][j] = static_cast<uint8_t>(j * 131 + i);
+			}
+			expected[i] = bufs[i];
+			ptrs[i] = bufs[i].data();
+			memcpy(ivs[i], cbc_iv, AES_BLOCKLEN);
+		}
+
+		assert(AES_set_impl(AES_IMPL_SW) == 0);
+		for (uint32_t i = 0; i < n; ++i) {
+			AES_ctx_set_iv(&ctx, cbc_iv);
+			AES_CBC_encrypt_buffer(&ctx, expected[i].data(),
+					       lengths[i]);
+			expected[i].insert(expected[i].end(), ctx.Iv,
+					   ctx.Iv + AES_BLOCKLEN);
+		}
+		assert(AES_set_impl(impl) == 0);
+		AES_CBC_encrypt_multi(&ctx, ptrs.data(), lengths.data(), ivs,
+				      n);
+		for (uint32_t i = 0; i < n; ++i) {
+			bufs[i].insert(bufs[i].end(), ivs[i],
+				       ivs[i] + AES_BLOCKLEN);
+			assert(bufs[i] == expected[i]);
+		}
+	}
+}
+
+static void test_gcm_vectors(void)
+{
+	const uint8_t zero[16] = { 0 };
+	struct AES_GCM_ctx ctx;
+	uint8_t buf[60], tag[AES_GCM_TAGLEN];
+	struct AES_GCM_buf b = { buf, sizeof(gcm_plain), gcm_iv, gcm_aad,
+				 sizeof(gcm_aad), tag };
+
+	AES_GCM_init_ctx(&ctx, gcm_key);
+	memcpy(buf, gcm_plain, sizeof(buf));
+	AES_GCM_encrypt(&ctx, &b);
+	assert(memcmp(buf, gcm_cipher, sizeof(buf)) == 0);
+	assert(memcmp(tag, gcm_tag, sizeof(tag)) == 0);
+	assert(AES_GCM_decrypt(&ctx, &b) == 0);
+	assert(memcmp(buf, gcm_plain, sizeof(buf)) == 0);
+	// A modified AAD must be detected.
+	uint8_t aad[sizeof(gcm_aad)];
+	memcpy(aad, gcm_aad, sizeof(aad));
+	aad[sizeof(aad) - 1] ^= 1;
+	b.aad = aad;
+	AES_GCM_encrypt(&ctx, &b);
+	b.aad = gcm_aad;
+	assert(AES_GCM_decrypt(&ctx, &b) == -EBADMSG);
+
+	AES_GCM_init_ctx(&ctx, zero);
+	memset(buf, 0, sizeof(buf));
+	b = { buf, 16, zero, NULL, 0, tag };
+	AES_GCM_encrypt(&ctx, &b);
+	assert(memcmp(buf, gcm_zero_cipher, 16) == 0);
+	assert(memcmp(tag, gcm_zero_tag, sizeof(tag)) == 0);
+}
+
+// Buffers from empty to several VAES chunks, so that the small ones share key
+// stream passes and the large ones are processed alone. One ciphertext is
+// modified before the decryption.
+static void test_gcm_multi(enum AES_impl impl)
+{
+	const uint32_t n = 40;
+	std::vector<std::vector<uint8_t>> bufs(n), expected(n);
+	std::vector<struct AES_GCM_buf> gcm_bufs(n);
+	uint8_t ivs[n][AES_GCM_IVLEN], tags[n][AES_GCM_TAGLEN];
+	uint8_t expected_tags[n][AES_GCM_TAGLEN], valid[n];
+	struct AES_GCM_ctx ctx;
+
+	AES_GCM_init_ctx(&ctx, key);
+	assert(AES_set_impl(AES_IMPL_SW) == 0);
+	for (uint32_t i = 0; i < n; ++i) {
+		uint32_t len = i % 4 == 0 ? (i * 397) % 1601 : (i * 13) % 130;
+		bufs[i].resize(len);
+		for (uint32_t j = 0; j < len; ++j) {
+			bufs[i][j] = static_cast<uint8_t>(j * 131 + i);
+		}
+		for (uint32_t j = 0; j < AES_GCM_IVLEN; ++j) {
+			ivs[i][j] = static_cast<uint8_t>(i + j);
+		}
+		expected[i] = bufs[i];
+		gcm_bufs[i] = { expected[i].data(), len, ivs[i], gcm_aad,
+				i % 3 * 10, expected_tags[i] };
+		AES_GCM_encrypt(&ctx, &gcm_bufs[i]);
+		gcm_bufs[i].buf = bufs[i].data();
+		gcm_bufs[i].tag = tags[i];
+	}
+
+	assert(AES_set_impl(impl) == 0);
+	AES_GCM_encrypt_multi(&ctx, gcm_bufs.data(), n);
+	for (uint32_t i = 0; i < n; ++i) {
+		assert(bufs[i] == expected[i]);
+		assert(memcmp(tags[i], expected_tags[i], AES_GCM_TAGLEN) == 0);
+	}
+	bufs[4][7] ^= 0x80;
+	assert(AES_GCM_decrypt_multi(&ctx, gcm_bufs.data(), n, valid) ==
+	       n - 1);
+	for (uint32_t i = 0; i < n; ++i) {
+		assert(valid[i] == (i != 4));
+		for (uint32_t j = 0; i != 4 && j < bufs[i].size(); ++j) {
+			assert(bufs[i][j] == static_cast<uint8_t>(j * 131 + i));
+		}
+	}
+}
+
+int main()
+{
+	printf("Default AES implementation: %s\n",
+	       AES_impl_name(AES_get_impl()));
+	assert(AES_set_impl(AES_IMPL_MAX) == -EINVAL);
+
+	for (int i = AES_IMPL_SW; i < AES_IMPL_MAX; ++i) {
+		enum AES_impl impl = static_cast<enum AES_impl>(i);
+		if (AES_set_impl(impl) != 0) {
+			printf("%s: not supported\n", AES_impl_name(impl));
+			continue;
+		}
+		assert(AES_get_impl() == impl);
+		test_nist();
+		test_same_as_sw(impl);
+		test_multi(impl);
+		test_gcm_vectors();
+		test_gcm_multi(impl);
+		printf("%s: ok\n", AES_impl_name(impl));
+	}
+	return 0;
+}
@@ -0,0 +1,226 @@
+/*
+ * test_chain.cpp
+ *
+ * Check the order in which fused and sequential chains run their stages, that
+ * a dropping stage skips the later stages and that the kept packets stay in
+ * order at the head of the vector.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <rte_eal.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+#include "ffpp/chain.hpp"
+#include "ffpp/collections.h"
+#include "ffpp/memory.h"
+
+static constexpr uint16_t nb_pkts = 29;
+static constexpr uint16_t frame_size = 64;
+
+// (stage, packet) of every stage call.
+using trace_t = std::vector<std::pair<int, uint16_t>>;
+
+// The packet index is stored after the Ethernet header.
+static uint16_t pkt_index(const struct rte_mbuf *m)
+{
+	return *rte_pktmbuf_mtod_offset(m, const uint16_t *,
+					RTE_ETHER_HDR_LEN);
+}
+
+/* Record the call, drop the packets whose index is a multiple of drop_mod. */
+class Record {
+    public:
+	Record(int id, trace_t *trace, uint16_t drop_mod = 0)
+		: id_(id), trace_(trace), drop_mod_(drop_mod)
+	{
+	}
+
+	bool operator()(ffpp::pkt_ctx &ctx) const
+	{
+		uint16_t i = pkt_index(ctx.mbuf());
+
+		trace_->emplace_back(id_, i);
+		return drop_mod_ == 0 || i % drop_mod_ != 0;
+	}
+
+    private:
+	int id_;
+	trace_t *trace_;
+	uint16_t drop_mod_;
+};
+
+static void build_pkts(struct rte_mbuf **pkts, struct ffpp_mvec *vec)
+{
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		rte_pktmbuf_reset(pkts[i]);
+		auto p = reinterpret_cast<uint8_t *>(
+			rte_pktmbuf_append(pkts[i], frame_size));
+		assert(p != NULL);
+		memset(p, 0, frame_size);
+		auto eth = reinterpret_cast<struct rte_ether_hdr *>(p);
+		eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+		auto ip = reinterpret_cast<struct rte_ipv4_hdr *>(eth + 1);
+		// The index overlaps the unused version_ihl and ToS.
+		memcpy(ip, &i, sizeof(i));
+		// Packets with TTL 1 expire.
+		ip->time_to_live = i % 4 + 1;
+	}
+	ffpp_mvec_set_mbufs(vec, pkts, nb_pkts);
+}
+
+/* The first nb_keep packets are the kept ones in order, then the dropped. */
+static void check_vec(const struct ffpp_mvec *vec, uint16_t nb_keep,
+		      uint16_t drop_mod)
+{
+	std::vector<uint16_t> kept, dropped;
+
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		(i % drop_mod != 0 ? kept : dropped).push_back(i);
+	}
+	assert(nb_keep == kept.size());
+	assert(vec->len == nb_pkts);
+	for (uint16_t i = 0; i < nb_keep; ++i) {
+		assert(pkt_index(vec->head[i]) == kept[i]);
+	}
+	std::vector<uint16_t> tail;
+	for (uint16_t i = nb_keep; i < nb_pkts; ++i) {
+		tail.push_back(pkt_index(vec->head[i]));
+	}
+	std::sort(tail.begin(), tail.end());
+	assert(tail == dropped);
+}
+
+static void test_order(struct rte_mbuf **pkts, struct ffpp_mvec *vec)
+{
+	trace_t trace;
+	ffpp::chain<Record, Record, Record> c(Record(0, &trace),
+					      Record(1, &trace),
+					      Record(2, &trace));
+	static_assert(decltype(c)::size() == 3);
+
+	// Fused: all stages on a packet before the next packet.
+	build_pkts(pkts, vec);
+	assert(c(vec) == nb_pkts);
+	assert(trace.size() == 3 * nb_pkts);
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		for (int s = 0; s < 3; ++s) {
+			assert(trace[i * 3 + s] == std::make_pair(s, i));
+		}
+	}
+
+	// Sequential: each stage over the whole vector.
+	trace.clear();
+	build_pkts(pkts, vec);
+	assert(c.run_sequential(vec) == nb_pkts);
+	assert(trace.size() == 3 * nb_pkts);
+	for (int s = 0; s < 3; ++s) {
+		for (uint16_t i = 0; i < nb_pkts; ++i) {
+			assert(trace[s * nb_pkts + i] == std::make_pair(s, i));
+		}
+	}
+}
+
+static void test_drop(struct rte_mbuf **pkts, struct ffpp_mvec *vec)
+{
+	constexpr uint16_t drop_mod = 3;
+	trace_t trace;
+	ffpp::chain<Record, Record, Record> c(Record(0, &trace),
+					      Record(1, &trace, drop_mod),
+					      Record(2, &trace));
+	uint16_t nb_keep;
+
+	// The stage after the dropping one only sees the kept packets.
+	build_pkts(pkts, vec);
+	nb_keep = c(vec);
+	check_vec(vec, nb_keep, drop_mod);
+	for (auto &t : trace) {
+		assert(t.first != 2 || t.second % drop_mod != 0);
+	}
+	assert(trace.size() == 2 * nb_pkts + nb_keep);
+
+	trace.clear();
+	build_pkts(pkts, vec);
+	assert(c.run_sequential(vec) == nb_keep);
+	check_vec(vec, nb_keep, drop_mod);
+	for (auto &t : trace) {
+		assert(t.first != 2 || t.second % drop_mod != 0);
+	}
+	assert(trace.size() == 2 * nb_pkts + nb_keep);
+
+	// An expiring TTL skips the MAC rewrite.
+	struct rte_ether_addr src = { { 0x02, 0, 0, 0, 0, 0x01 } };
+	struct rte_ether_addr dst = { { 0x02, 0, 0, 0, 0, 0x02 } };
+	ffpp::chain<ffpp::ParseEth, ffpp::DecTTL, ffpp::RewriteMac> l3fwd(
+		ffpp::ParseEth(), ffpp::DecTTL(), ffpp::RewriteMac(src, dst));
+	build_pkts(pkts, vec);
+	nb_keep = l3fwd(vec);
+	assert(nb_keep == nb_pkts - (nb_pkts + 3) / 4);
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		auto eth = rte_pktmbuf_mtod(vec->head[i],
+					    struct rte_ether_hdr *);
+		assert(rte_is_same_ether_addr(&eth->d_addr, &dst) ==
+		       (i < nb_keep));
+	}
+}
+
+static void test_ctx(struct rte_mbuf *m)
+{
+	rte_pktmbuf_reset(m);
+	auto eth = reinterpret_cast<struct rte_ether_hdr *>(rte_pktmbuf_append(
+		m, RTE_ETHER_HDR_LEN + sizeof(struct rte_vlan_hdr) +
+			   sizeof(struct rte_ipv4_hdr)));
+	assert(eth != NULL);
+	eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_VLAN);
+	auto vlan = reinterpret_cast<struct rte_vlan_hdr *>(eth + 1);
+	vlan->eth_proto = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+
+	ffpp::pkt_ctx ctx(m);
+	assert(ctx.eth() == eth);
+	assert(ctx.ipv4() == reinterpret_cast<struct rte_ipv4_hdr *>(vlan + 1));
+	assert(ctx.ipv6() == nullptr);
+
+	// Truncated headers are not parsed.
+	rte_pktmbuf_trim(m, 1);
+	ffpp::pkt_ctx short_l3(m);
+	assert(short_l3.eth() == eth);
+	assert(short_l3.ipv4() == nullptr);
+	rte_pktmbuf_trim(m, rte_pktmbuf_data_len(m) - RTE_ETHER_HDR_LEN + 1);
+	ffpp::pkt_ctx short_eth(m);
+	assert(short_eth.eth() == nullptr);
+	assert(short_eth.ipv4() == nullptr);
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	struct rte_mempool *pool =
+		ffpp_init_mempool("test_chain", 1023, RTE_MBUF_DEFAULT_BUF_SIZE,
+				  rte_socket_id());
+	assert(pool != NULL);
+
+	struct rte_mbuf *pkts[nb_pkts];
+	struct ffpp_mvec vec;
+	assert(rte_pktmbuf_alloc_bulk(pool, pkts, nb_pkts) == 0);
+	ffpp_mvec_init(&vec, nb_pkts);
+
+	test_order(pkts, &vec);
+	test_drop(pkts, &vec);
+	test_ctx(pkts[0]);
+
+	rte_pktmbuf_free_bulk(pkts, nb_pkts);
+	ffpp_mvec_free(&vec);
+	assert(rte_mempool_in_use_count(pool) == 0);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * test_checksum.cpp
+ *
+ * Compare the checksum helpers with the DPDK implementations: raw sums of odd
+ * lengths and offsets, full UDP/TCP checksums, incremental updates of the
+ * addresses and ports, and ffpp_csum_finalize() with and without offloads.
+ */
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+#include <rte_eal.h>
+#include <rte_ethdev.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_tcp.h>
+#include <rte_udp.h>
+
+#include "ffpp/checksum.h"
+#include "ffpp/collections.h"
+#include "ffpp/memory.h"
+
+static constexpr uint16_t nb_pkts = 8;
+static constexpr uint16_t payload_len = 1001;
+
+static size_t cksum_offset(uint8_t proto)
+{
+	if (proto == IPPROTO_UDP) {
+		return offsetof(struct rte_udp_hdr, dgram_cksum);
+	}
+	return offsetof(struct rte_tcp_hdr, cksum);
+}
+
+static struct rte_ipv4_hdr *build_ipv4(struct rte_mbuf *m, uint8_t proto,
+				       uint16_t i)
+{
+	uint16_t l4_len = (proto == IPPROTO_UDP ? sizeof(struct rte_udp_hdr) :
+						  sizeof(struct rte_tcp_hdr)) +
+			  payload_len;
+	uint16_t frame_len =
+		RTE_ETHER_HDR_LEN + sizeof(struct rte_ipv4_hdr) + l4_len;
+	auto p = reinterpret_cast<uint8_t *>(rte_pktmbuf_append(m, frame_len));
+	assert(p != NULL);
+	for (uint16_t j = 0; j < frame_len; ++j) {
+		p[j] = static_cast<uint8_t>(j * 7 + i);
+	}
+	auto eth = reinterpret_cast<struct rte_ether_hdr *>(p);
+	eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+	auto ip = reinterpret_cast<struct rte_ipv4_hdr *>(eth + 1);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = rte_cpu_to_be_16(sizeof(*ip) + l4_len);
+	ip->fragment_offset = 0;
+	ip->time_to_live = 64;
+	ip->next_proto_id = proto;
+	ip->src_addr = rte_cpu_to_be_32(RTE_IPV4(10, 0, 0, 1));
+	ip->dst_addr = rte_cpu_to_be_32(RTE_IPV4(10, 0, i, 2));
+	ip->hdr_checksum = 0;
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+	if (proto == IPPROTO_UDP) {
+		auto udp = reinterpret_cast<struct rte_udp_hdr *>(ip + 1);
+		udp->dgram_len = rte_cpu_to_be_16(l4_len);
+		udp->dgram_cksum = 0;
+		udp->dgram_cksum = rte_ipv4_udptcp_cksum(ip, udp);
+	} else {
+		auto tcp = reinterpret_cast<struct rte_tcp_hdr *>(ip + 1);
+		tcp->data_off = 0x50;
+		tcp->cksum = 0;
+		tcp->cksum = rte_ipv4_udptcp_cksum(ip, tcp);
+	}
+	return ip;
+}
+
+static void test_raw(void)
+{
+	uint8_t buf[4099];
+	for (size_t i = 0; i < sizeof(buf); ++i) {
+		buf[i] = static_cast<uint8_t>(i * 31 + 5);
+	}
+	for (size_t off = 0; off < 4; ++off) {
+		for (size_t len = 0; len + off <= sizeof(buf); len += 37) {
+			uint16_t ref = rte_raw_cksum(buf + off, len);
+			assert(ffpp_csum_raw(buf + off, len) == ref);
+			assert(ffpp_csum_raw_scalar(buf + off, len) == ref);
+		}
+	}
+	memset(buf, 0xff, sizeof(buf));
+	assert(ffpp_csum_raw(buf, sizeof(buf)) ==
+	       rte_raw_cksum(buf, sizeof(buf)));
+}
+
+static void test_incremental(struct rte_mbuf *m)
+{
+	auto ip = build_ipv4(m, IPPROTO_UDP, 1);
+	auto udp = reinterpret_cast<struct rte_udp_hdr *>(ip + 1);
+	uint32_t addr = rte_cpu_to_be_32(RTE_IPV4(192, 168, 1, 1));
+	uint16_t port = rte_cpu_to_be_16(4242);
+
+	uint32_t diff = ffpp_csum_diff32(ip->src_addr, addr);
+	ip->hdr_checksum = ffpp_csum_apply(ip->hdr_checksum, diff);
+	diff += ffpp_csum_diff16(udp->src_port, port);
+	udp->dgram_cksum = ffpp_csum_udp_apply(udp->dgram_cksum, diff);
+	ip->src_addr = addr;
+	udp->src_port = port;
+	uint16_t csum = ip->hdr_checksum;
+	ip->hdr_checksum = 0;
+	assert(rte_ipv4_cksum(ip) == csum);
+	ip->hdr_checksum = csum;
+	csum = udp->dgram_cksum;
+	udp->dgram_cksum = 0;
+	assert(ffpp_csum_ipv4_udptcp(ip, udp) == csum);
+	assert(rte_ipv4_udptcp_cksum(ip, udp) == csum);
+
+	// A disabled UDP checksum stays disabled.
+	assert(ffpp_csum_udp_apply(0, diff) == 0);
+	uint16_t len = ip->total_length;
+	ip->total_length = rte_cpu_to_be_16(rte_be_to_cpu_16(len) - 1);
+	ip->hdr_checksum =
+		ffpp_csum_replace16(ip->hdr_checksum, len, ip->total_length);
+	csum = ip->hdr_checksum;
+	ip->hdr_checksum = 0;
+	assert(rte_ipv4_cksum(ip) == csum);
+}
+
+static void test_finalize(struct rte_mbuf **pkts, struct ffpp_mvec *vec,
+			  uint64_t tx_offloads)
+{
+	struct rte_ipv4_hdr *ips[nb_pkts];
+	uint16_t ref[nb_pkts];
+
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		rte_pktmbuf_reset(pkts[i]);
+		ips[i] = build_ipv4(pkts[i], i % 2 ? IPPROTO_TCP : IPPROTO_UDP,
+				    i);
+		ref[i] = ips[i]->hdr_checksum;
+		// Rewrite the ports and invalidate the checksums.
+		ips[i]->hdr_checksum = 0x1234;
+		memset(ips[i] + 1, 0xab, 4);
+	}
+	ffpp_mvec_set_mbufs(vec, pkts, nb_pkts);
+	ffpp_csum_finalize(vec, tx_offloads);
+
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		struct rte_ipv4_hdr *ip = ips[i];
+		auto l4 = reinterpret_cast<uint8_t *>(ip + 1);
+		uint16_t *field = reinterpret_cast<uint16_t *>(
+			l4 + cksum_offset(ip->next_proto_id));
+		uint16_t csum = *field;
+		uint64_t l4_flag = ip->next_proto_id == IPPROTO_UDP ?
+					   PKT_TX_UDP_CKSUM :
+					   PKT_TX_TCP_CKSUM;
+
+		if (tx_offloads & DEV_TX_OFFLOAD_IPV4_CKSUM) {
+			assert(ip->hdr_checksum == 0);
+			assert(pkts[i]->ol_flags & PKT_TX_IP_CKSUM);
+		} else {
+			assert(ip->hdr_checksum == ref[i]);
+			assert(!(pkts[i]->ol_flags & PKT_TX_IP_CKSUM));
+		}
+		if (tx_offloads & (DEV_TX_OFFLOAD_UDP_CKSUM |
+				   DEV_TX_OFFLOAD_TCP_CKSUM)) {
+			assert(pkts[i]->ol_flags & l4_flag);
+			assert(pkts[i]->l2_len == RTE_ETHER_HDR_LEN);
+			assert(pkts[i]->l3_len == sizeof(*ip));
+			assert(csum ==
+			       rte_ipv4_phdr_cksum(ip, pkts[i]->ol_flags));
+		} else {
+			assert(!(pkts[i]->ol_flags & l4_flag));
+			*field = 0;
+			assert(csum == rte_ipv4_udptcp_cksum(ip, l4));
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	struct rte_mempool *pool =
+		ffpp_init_mempool("test_csum", 1023, RTE_MBUF_DEFAULT_BUF_SIZE,
+				  rte_socket_id());
+	assert(pool != NULL);
+	struct rte_mbuf *pkts[nb_pkts];
+	assert(rte_pktmbuf_alloc_bulk(pool, pkts, nb_pkts) == 0);
+	struct ffpp_mvec vec;
+	ffpp_mvec_init(&vec, nb_pkts);
+
+	test_raw();
+
+	const uint8_t protos[] = { IPPROTO_UDP, IPPROTO_TCP };
+	for (uint8_t proto : protos) {
+		rte_pktmbuf_reset(pkts[0]);
+		auto ip = build_ipv4(pkts[0], proto, 0);
+		auto l4 = reinterpret_cast<uint8_t *>(ip + 1);
+		size_t off = cksum_offset(proto);
+		uint16_t csum;
+		memcpy(&csum, l4 + off, sizeof(csum));
+		memset(l4 + off, 0, sizeof(csum));
+		assert(ffpp_csum_ipv4_udptcp(ip, l4) == csum);
+	}
+
+	rte_pktmbuf_reset(pkts[0]);
+	test_incremental(pkts[0]);
+
+	test_finalize(pkts, &vec, 0);
+	test_finalize(pkts, &vec, DEV_TX_OFFLOAD_IPV4_CKSUM);
+	test_finalize(pkts, &vec,
+		      DEV_TX_OFFLOAD_IPV4_CKSUM | DEV_TX_OFFLOAD_UDP_CKSUM |
+			      DEV_TX_OFFLOAD_TCP_CKSUM);
+
+	rte_pktmbuf_free_bulk(pkts, nb_pkts);
+	ffpp_mvec_free(&vec);
+	assert(rte_mempool_in_use_count(pool) == 0);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * test_classifier.cpp
+ *
+ * Add, update and delete exact, LPM and LPM6 rules and check the actions of
+ * a vector with IPv4, VLAN tagged IPv4, IPv6 and ARP packets.
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <rte_eal.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_udp.h>
+
+#include "ffpp/classifier.h"
+#include "ffpp/collections.h"
+#include "ffpp/memory.h"
+
+// More than one bulk of the classifier.
+static constexpr uint16_t nb_pkts = 100;
+static constexpr uint16_t frame_size = 128;
+static constexpr uint32_t default_action = 1;
+
+enum pkt_kind { KIND_IPV4, KIND_IPV6, KIND_ARP, KIND_VLAN_IPV4 };
+
+static const uint8_t net6[RTE_LPM6_IPV6_ADDR_SIZE] = { 0x20, 0x01, 0x0d,
+						      0xb8 };
+
+static void build_pkt(struct rte_mbuf *m, uint16_t i)
+{
+	auto p = reinterpret_cast<uint8_t *>(rte_pktmbuf_append(m, frame_size));
+	assert(p != NULL);
+	memset(p, 0, frame_size);
+	auto eth = reinterpret_cast<struct rte_ether_hdr *>(p);
+	uint8_t *l3 = p + RTE_ETHER_HDR_LEN;
+
+	switch (i % 4) {
+	case KIND_ARP:
+		eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_ARP);
+		return;
+	case KIND_IPV6: {
+		eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV6);
+		auto ip6 = reinterpret_cast<struct rte_ipv6_hdr *>(l3);
+		ip6->vtc_flow = rte_cpu_to_be_32(6 << 28);
+		memcpy(ip6->dst_addr, net6, sizeof(net6));
+		ip6->dst_addr[15] = i;
+		return;
+	}
+	case KIND_VLAN_IPV4: {
+		eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_VLAN);
+		auto vlan = reinterpret_cast<struct rte_vlan_hdr *>(l3);
+		vlan->eth_proto = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+		l3 += sizeof(struct rte_vlan_hdr);
+		break;
+	}
+	default:
+		eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+	}
+	auto ip = reinterpret_cast<struct rte_ipv4_hdr *>(l3);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->next_proto_id = IPPROTO_UDP;
+	ip->src_addr = rte_cpu_to_be_32(RTE_IPV4(10, 0, 0, 1));
+	ip->dst_addr = rte_cpu_to_be_32(RTE_IPV4(10, 1, i, 1));
+	auto udp = reinterpret_cast<struct rte_udp_hdr *>(ip + 1);
+	udp->src_port = rte_cpu_to_be_16(1000 + i);
+	udp->dst_port = rte_cpu_to_be_16(80);
+}
+
+static void check_actions(const struct ffpp_classifier *cls,
+			  const struct ffpp_mvec *vec, uint32_t v4_action,
+			  uint32_t v6_action, uint16_t nb_match)
+{
+	uint32_t actions[nb_pkts];
+	assert(ffpp_cls_lookup(cls, vec, actions) == nb_match);
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		switch (i % 4) {
+		case KIND_ARP:
+			assert(actions[i] == default_action);
+			break;
+		case KIND_IPV6:
+			assert(actions[i] == v6_action);
+			break;
+		default:
+			// Packet 0 may match the exact rule.
+			if (i != 0) {
+				assert(actions[i] == v4_action);
+			}
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	struct rte_mempool *pool =
+		ffpp_init_mempool("test_cls", 1023, RTE_MBUF_DEFAULT_BUF_SIZE,
+				  rte_socket_id());
+	assert(pool != NULL);
+
+	struct rte_mbuf *pkts[nb_pkts];
+	struct ffpp_mvec vec;
+	assert(rte_pktmbuf_alloc_bulk(pool, pkts, nb_pkts) == 0);
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		build_pkt(pkts[i], i);
+	}
+	ffpp_mvec_init(&vec, nb_pkts);
+	ffpp_mvec_set_mbufs(&vec, pkts, nb_pkts);
+
+	struct ffpp_cls_config cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	strcpy(cfg.name, "test_cls");
+	cfg.socket_id = rte_socket_id();
+	cfg.max_exact_rules = 1024;
+	cfg.max_lpm_rules = 1024;
+	cfg.max_lpm6_rules = 1024;
+	cfg.default_action = FFPP_CLS_ACTION_MAX + 1;
+	assert(ffpp_cls_create(&cfg) == NULL);
+	cfg.default_action = default_action;
+	struct ffpp_classifier *cls = ffpp_cls_create(&cfg);
+	assert(cls != NULL);
+
+	const uint16_t nb_v4 = nb_pkts / 2;
+	const uint16_t nb_v6 = nb_pkts / 4;
+	uint32_t actions[nb_pkts];
+
+	unsigned int lcore_id = rte_lcore_id();
+	assert(ffpp_cls_reader_register(cls, lcore_id) == 0);
+	check_actions(cls, &vec, default_action, default_action, 0);
+	ffpp_cls_quiescent(cls, lcore_id);
+
+	struct ffpp_cls_5tuple key;
+	assert(ffpp_cls_5tuple_of(pkts[KIND_ARP], &key) == -1);
+	assert(ffpp_cls_5tuple_of(pkts[0], &key) == 0);
+	assert(key.dst_port == rte_cpu_to_be_16(80));
+	assert(ffpp_cls_add_exact(cls, &key, FFPP_CLS_ACTION_MAX + 1) ==
+	       -EINVAL);
+	assert(ffpp_cls_add_exact(cls, &key, 7) == 0);
+	assert(ffpp_cls_add_lpm(cls, RTE_IPV4(10, 1, 0, 0), 16, 3) == 0);
+	check_actions(cls, &vec, 3, default_action, nb_v4);
+	assert(ffpp_cls_lookup(cls, &vec, actions) == nb_v4);
+	assert(actions[0] == 7);
+
+	// Update the action of the exact rule, then delete it.
+	assert(ffpp_cls_add_exact(cls, &key, 8) == 0);
+	assert(ffpp_cls_lookup(cls, &vec, actions) == nb_v4);
+	assert(actions[0] == 8);
+	assert(ffpp_cls_del_exact(cls, &key) == 0);
+	assert(ffpp_cls_del_exact(cls, &key) == -ENOENT);
+	ffpp_cls_quiescent(cls, lcore_id);
+	assert(ffpp_cls_lookup(cls, &vec, actions) == nb_v4);
+	assert(actions[0] == 3);
+	ffpp_cls_quiescent(cls, lcore_id);
+
+	// LPM6 updates wait for the readers.
+	ffpp_cls_reader_unregister(cls, lcore_id);
+	assert(ffpp_cls_add_lpm6(cls, net6, 32, 5) == 0);
+	check_actions(cls, &vec, 3, 5, nb_v4 + nb_v6);
+	assert(ffpp_cls_add_lpm6(cls, net6, 32, 6) == 0);
+	check_actions(cls, &vec, 3, 6, nb_v4 + nb_v6);
+	assert(ffpp_cls_del_lpm6(cls, net6, 32) == 0);
+	assert(ffpp_cls_del_lpm6(cls, net6, 32) < 0);
+	check_actions(cls, &vec, 3, default_action, nb_v4);
+
+	assert(ffpp_cls_del_lpm(cls, RTE_IPV4(10, 1, 0, 0), 16) == 0);
+	check_actions(cls, &vec, default_action, default_action, 0);
+	ffpp_cls_free(cls);
+
+	// Only the LPM table.
+	cfg.max_exact_rules = 0;
+	cfg.max_lpm6_rules = 0;
+	cls = ffpp_cls_create(&cfg);
+	assert(cls != NULL);
+	assert(ffpp_cls_add_exact(cls, &key, 7) == -ENOTSUP);
+	assert(ffpp_cls_add_lpm6(cls, net6, 32, 5) == -ENOTSUP);
+	assert(ffpp_cls_add_lpm(cls, RTE_IPV4(10, 1, 3, 0), 24, 4) == 0);
+	assert(ffpp_cls_lookup(cls, &vec, actions) == 1);
+	assert(actions[3] == 4);
+	ffpp_cls_free(cls);
+
+	rte_pktmbuf_free_bulk(pkts, nb_pkts);
+	ffpp_mvec_free(&vec);
+	assert(rte_mempool_in_use_count(pool) == 0);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
@@ -0,0 +1,322 @@
+/*
+ * test_crypto.cpp
+ *
+ * Encrypt and decrypt a burst of two flows, one with the default CTR session
+ * and one with its own CBC session, check the derived IVs, the sequence
+ * numbers of the partitions and the life cycle of the sessions. Encrypt a
+ * burst of different lengths with the multi-buffer CBC path.
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <rte_eal.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_udp.h>
+
+#include "ffpp/collections.h"
+#include "ffpp/crypto.h"
+#include "ffpp/memory.h"
+
+static constexpr uint16_t nb_pkts = 32;
+static constexpr uint16_t frame_size = 128;
+static constexpr uint16_t payload_offset = RTE_ETHER_HDR_LEN +
+					   sizeof(struct rte_ipv4_hdr) +
+					   sizeof(struct rte_udp_hdr);
+
+static const struct ffpp_crypto_session_params ctr_params = {
+	FFPP_CRYPTO_AES_CTR,
+	{ 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15,
+	  0x88, 0x09, 0xcf, 0x4f, 0x3c },
+	{ 0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+	  0xfb, 0xfc, 0xfd, 0xfe, 0xff },
+};
+
+static const struct ffpp_crypto_session_params cbc_params = {
+	FFPP_CRYPTO_AES_CBC,
+	{ 0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae,
+	  0xf0, 0x85, 0x7d, 0x77, 0x81 },
+	{ 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
+	  0x0b, 0x0c, 0x0d, 0x0e, 0x0f },
+};
+
+static void build_udp(struct rte_mbuf *m, uint16_t src_port, bool is_ipv4)
+{
+	auto eth = reinterpret_cast<struct rte_ether_hdr *>(
+		rte_pktmbuf_append(m, frame_size));
+	assert(eth != NULL);
+	memset(eth, 0, frame_size);
+	if (!is_ipv4) {
+		eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_ARP);
+		return;
+	}
+	eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+	auto ip = reinterpret_cast<struct rte_ipv4_hdr *>(eth + 1);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = rte_cpu_to_be_16(frame_size - RTE_ETHER_HDR_LEN);
+	ip->time_to_live = 64;
+	ip->next_proto_id = IPPROTO_UDP;
+	ip->src_addr = rte_cpu_to_be_32(RTE_IPV4(10, 0, 0, 1));
+	ip->dst_addr = rte_cpu_to_be_32(RTE_IPV4(10, 1, 0, 1));
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+	auto udp = reinterpret_cast<struct rte_udp_hdr *>(ip + 1);
+	udp->src_port = rte_cpu_to_be_16(src_port);
+	udp->dst_port = rte_cpu_to_be_16(80);
+	auto payload = reinterpret_cast<uint8_t *>(udp + 1);
+	for (uint16_t i = 0; i < frame_size - payload_offset; ++i) {
+		payload[i] = static_cast<uint8_t>(i);
+	}
+}
+
+static struct ffpp_crypto *create_crypto(uint16_t nb_parts,
+					 uint32_t max_sessions)
+{
+	struct ffpp_crypto_config cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	strcpy(cfg.name, "test_crypto");
+	cfg.socket_id = rte_socket_id();
+	cfg.nb_parts = nb_parts;
+	cfg.max_sessions = max_sessions;
+	cfg.max_flows = 1024;
+	cfg.offset = payload_offset;
+	return ffpp_crypto_create(&cfg);
+}
+
+static void test_sessions(void)
+{
+	assert(create_crypto(0, 2) == NULL);
+	assert(create_crypto(2, 0) == NULL);
+	struct ffpp_crypto *c = create_crypto(2, 2);
+	assert(c != NULL);
+
+	int ctr = ffpp_crypto_session_create(c, &ctr_params);
+	int cbc = ffpp_crypto_session_create(c, &cbc_params);
+	assert(ctr == 1 && cbc == 2);
+	assert(ffpp_crypto_session_create(c, &ctr_params) == -ENOSPC);
+
+	// Each partition has its own range of sequence numbers.
+	struct ffpp_crypto_session *s0 = ffpp_crypto_session_get(c, 0, ctr);
+	struct ffpp_crypto_session *s1 = ffpp_crypto_session_get(c, 1, ctr);
+	assert(s0 != NULL && s1 != NULL && s0 != s1);
+	assert(s0->seq == 0);
+	assert(s1->seq == 1ULL << FFPP_CRYPTO_SEQ_PART_SHIFT);
+	assert(ffpp_crypto_session_get(c, 0, FFPP_CRYPTO_SESSION_NONE) ==
+	       NULL);
+	assert(ffpp_crypto_session_get(c, 0, 3) == NULL);
+
+	// CTR: the salt with the sequence number, the block counter is zero.
+	uint8_t iv[AES_BLOCKLEN];
+	uint8_t expected[AES_BLOCKLEN];
+	ffpp_crypto_session_iv(s1, s1->seq + 5, iv);
+	memcpy(expected, ctr_params.salt, AES_BLOCKLEN);
+	expected[1] ^= 0x01;
+	expected[7] ^= 0x05;
+	memset(expected + 12, 0, 4);
+	assert(memcmp(iv, expected, AES_BLOCKLEN) == 0);
+
+	// CBC: the block is encrypted, so the IV is not predictable.
+	struct ffpp_crypto_session *cbc0 = ffpp_crypto_session_get(c, 0, cbc);
+	struct AES_ctx ctx;
+	AES_init_ctx(&ctx, cbc_params.key);
+	memcpy(expected, cbc_params.salt, AES_BLOCKLEN);
+	expected[7] ^= 0x05;
+	AES_ECB_encrypt(&ctx, expected);
+	ffpp_crypto_session_iv(cbc0, 5, iv);
+	assert(memcmp(iv, expected, AES_BLOCKLEN) == 0);
+
+	// Round trip with the cached round keys.
+	uint8_t buf[100], plain[100];
+	for (uint16_t i = 0; i < sizeof(buf); ++i) {
+		plain[i] = static_cast<uint8_t>(i * 7);
+	}
+	memcpy(buf, plain, sizeof(buf));
+	uint64_t seq;
+	assert(ffpp_crypto_encrypt(s0, buf, sizeof(buf), &seq) == 0);
+	assert(seq == 0 && s0->seq == 1);
+	assert(memcmp(buf, plain, sizeof(buf)) != 0);
+	ffpp_crypto_decrypt(s0, buf, sizeof(buf), seq);
+	assert(memcmp(buf, plain, sizeof(buf)) == 0);
+
+	// The same plaintext gives another ciphertext with the next seq.
+	uint8_t first[sizeof(buf)];
+	assert(ffpp_crypto_encrypt(cbc0, buf, sizeof(buf), &seq) == 0);
+	memcpy(first, buf, sizeof(buf));
+	memcpy(buf, plain, sizeof(buf));
+	assert(ffpp_crypto_encrypt(cbc0, buf, sizeof(buf), &seq) == 0);
+	assert(seq == 1);
+	assert(memcmp(buf, first, AES_BLOCKLEN) != 0);
+	// Only whole blocks are encrypted.
+	assert(memcmp(buf + 96, plain + 96, 4) == 0);
+	ffpp_crypto_decrypt(cbc0, buf, sizeof(buf), seq);
+	assert(memcmp(buf, plain, sizeof(buf)) == 0);
+
+	s0->seq = s0->seq_end;
+	assert(ffpp_crypto_encrypt(s0, buf, sizeof(buf), &seq) == -EOVERFLOW);
+
+	assert(ffpp_crypto_set_default_session(c, 3) == -ENOENT);
+	assert(ffpp_crypto_set_default_session(c, ctr) == 0);
+	assert(ffpp_crypto_session_destroy(c, ctr) == 0);
+	assert(ffpp_crypto_session_destroy(c, ctr) == -ENOENT);
+	assert(ffpp_crypto_session_get(c, 0, ctr) == NULL);
+	assert(ffpp_crypto_set_default_session(c, ctr) == -ENOENT);
+	// The ID is reused.
+	assert(ffpp_crypto_session_create(c, &ctr_params) == ctr);
+
+	ffpp_crypto_free(c);
+}
+
+// Even packets belong to flow 1000 with the default CTR session, odd packets
+// to flow 2000 with a CBC session. The last packet is not IPv4.
+static void test_process(struct rte_mempool *pool, struct ffpp_mvec *vec)
+{
+	struct rte_mbuf *pkts[nb_pkts];
+	assert(rte_pktmbuf_alloc_bulk(pool, pkts, nb_pkts) == 0);
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		build_udp(pkts[i], i % 2 == 0 ? 1000 : 2000,
+			  i != nb_pkts - 1);
+	}
+	ffpp_mvec_set_mbufs(vec, pkts, nb_pkts);
+
+	struct ffpp_crypto *c = create_crypto(1, 4);
+	assert(c != NULL);
+	int ctr = ffpp_crypto_session_create(c, &ctr_params);
+	int cbc = ffpp_crypto_session_create(c, &cbc_params);
+	assert(ffpp_crypto_set_default_session(c, ctr) == 0);
+	struct ffpp_cls_5tuple key;
+	assert(ffpp_cls_5tuple_of(pkts[1], &key) == 0);
+	assert(ffpp_crypto_set_flow_session(c, 0, &key, 3) == -ENOENT);
+	assert(ffpp_crypto_set_flow_session(c, 0, &key, cbc) == 0);
+
+	uint64_t seqs[nb_pkts];
+	uint8_t plain[frame_size];
+	memcpy(plain, rte_pktmbuf_mtod(pkts[0], uint8_t *), frame_size);
+	uint16_t nb_done =
+		ffpp_crypto_process(c, 0, vec, FFPP_CRYPTO_ENCRYPT, seqs);
+	assert(nb_done == nb_pkts - 1);
+	for (uint16_t i = 0; i < nb_pkts - 1; ++i) {
+		// The sequence numbers are counted per session.
+		assert(seqs[i] == i / 2);
+		auto data = rte_pktmbuf_mtod(pkts[i], uint8_t *);
+		assert(memcmp(data, plain, payload_offset - 8) == 0);
+		assert(memcmp(data + payload_offset, plain + payload_offset,
+			      AES_BLOCKLEN) != 0);
+	}
+	assert(seqs[nb_pkts - 1] == FFPP_CRYPTO_SEQ_NONE);
+
+	// Packets with the same plaintext and session differ.
+	assert(memcmp(rte_pktmbuf_mtod(pkts[0], uint8_t *),
+		      rte_pktmbuf_mtod(pkts[2], uint8_t *), frame_size) != 0);
+
+	nb_done = ffpp_crypto_process(c, 0, vec, FFPP_CRYPTO_DECRYPT, seqs);
+	assert(nb_done == nb_pkts - 1);
+	for (uint16_t i = 0; i < nb_pkts - 1; ++i) {
+		auto data = rte_pktmbuf_mtod_offset(pkts[i], uint8_t *,
+						    payload_offset);
+		assert(memcmp(data, plain + payload_offset,
+			      frame_size - payload_offset) == 0);
+	}
+
+	struct ffpp_crypto_stats stats;
+	ffpp_crypto_get_stats(c, 0, &stats);
+	assert(stats.encrypted == nb_pkts - 1);
+	assert(stats.decrypted == nb_pkts - 1);
+	assert(stats.untracked == 1);
+	assert(stats.seq_exhausted == 0);
+	assert(stats.nb_flows == 2);
+	// CTR processes the whole payload, CBC only the whole blocks.
+	uint32_t len = frame_size - payload_offset;
+	uint32_t cbc_len = len / AES_BLOCKLEN * AES_BLOCKLEN;
+	assert(stats.bytes ==
+	       2 * (nb_pkts / 2 * len + (nb_pkts / 2 - 1) * cbc_len));
+
+	// The flows of a destroyed session do not use the reused ID.
+	assert(ffpp_crypto_reader_register(c, 1) == -EINVAL);
+	assert(ffpp_crypto_reader_register(c, 0) == 0);
+	ffpp_crypto_quiescent(c, 0);
+	ffpp_crypto_reader_unregister(c, 0);
+	assert(ffpp_crypto_session_destroy(c, cbc) == 0);
+	assert(ffpp_crypto_session_create(c, &cbc_params) == cbc);
+	nb_done = ffpp_crypto_process(c, 0, vec, FFPP_CRYPTO_ENCRYPT, seqs);
+	assert(nb_done == nb_pkts / 2);
+	for (uint16_t i = 1; i < nb_pkts; i += 2) {
+		assert(seqs[i] == FFPP_CRYPTO_SEQ_NONE);
+	}
+	ffpp_crypto_get_stats(c, 0, &stats);
+	assert(stats.untracked == 1 + nb_pkts / 2);
+
+	ffpp_crypto_free(c);
+	ffpp_mvec_free_mbufs(vec);
+}
+
+// Packets of different lengths are encrypted in lockstep. Each one must be the
+// same as a single CBC encryption with its IV, the first packet has no payload.
+static void test_encrypt_mvec(struct rte_mempool *pool, struct ffpp_mvec *vec)
+{
+	struct rte_mbuf *pkts[nb_pkts];
+	assert(rte_pktmbuf_alloc_bulk(pool, pkts, nb_pkts) == 0);
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		build_udp(pkts[i], 1000, true);
+		uint16_t trim = i == 0 ? frame_size - payload_offset : i * 3;
+		assert(rte_pktmbuf_trim(pkts[i], trim) == 0);
+	}
+	ffpp_mvec_set_mbufs(vec, pkts, nb_pkts);
+
+	struct ffpp_crypto *c = create_crypto(1, 1);
+	assert(c != NULL);
+	int cbc = ffpp_crypto_session_create(c, &cbc_params);
+	struct ffpp_crypto_session *s = ffpp_crypto_session_get(c, 0, cbc);
+
+	uint64_t seqs[nb_pkts];
+	uint16_t nb_done =
+		ffpp_crypto_encrypt_mvec(s, vec, payload_offset, seqs);
+	assert(nb_done == nb_pkts - 1);
+	assert(seqs[0] == FFPP_CRYPTO_SEQ_NONE);
+
+	struct AES_ctx ctx;
+	AES_init_ctx(&ctx, cbc_params.key);
+	for (uint16_t i = 1; i < nb_pkts; ++i) {
+		assert(seqs[i] == i - 1u);
+		uint32_t len = rte_pktmbuf_data_len(pkts[i]) - payload_offset;
+		uint8_t expected[frame_size];
+		for (uint32_t j = 0; j < len; ++j) {
+			expected[j] = static_cast<uint8_t>(j);
+		}
+		ffpp_crypto_session_iv(s, seqs[i], ctx.Iv);
+		AES_CBC_encrypt_buffer(&ctx, expected,
+				       len / AES_BLOCKLEN * AES_BLOCKLEN);
+		assert(memcmp(rte_pktmbuf_mtod_offset(pkts[i], uint8_t *,
+						      payload_offset),
+			      expected, len) == 0);
+	}
+
+	ffpp_crypto_free(c);
+	ffpp_mvec_free_mbufs(vec);
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	struct rte_mempool *pool =
+		ffpp_init_mempool("test_crypto", 1023,
+				  RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	assert(pool != NULL);
+	struct ffpp_mvec vec;
+	ffpp_mvec_init(&vec, nb_pkts);
+
+	test_sessions();
+	test_process(pool, &vec);
+	assert(rte_mempool_in_use_count(pool) == 0);
+	test_encrypt_mvec(pool, &vec);
+	assert(rte_mempool_in_use_count(pool) == 0);
+
+	ffpp_mvec_free(&vec);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
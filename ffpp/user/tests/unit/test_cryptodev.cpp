@@ -0,0 +1,256 @@
+/*
+ * test_cryptodev.cpp
+ *
+ * Encrypt a burst with a software cryptodev (crypto_aesni_mb, crypto_openssl or
+ * crypto_null, the first one that can be created) and decrypt it with the
+ * inline crypto sessions, then the other way around. Check the packets that
+ * are kept by the enqueue, the queue pair of the lcore and the counters.
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <rte_bus_vdev.h>
+#include <rte_cryptodev.h>
+#include <rte_eal.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_udp.h>
+
+#include "ffpp/collections.h"
+#include "ffpp/crypto.h"
+#include "ffpp/cryptodev.h"
+#include "ffpp/memory.h"
+
+static constexpr uint16_t nb_pkts = 32;
+static constexpr uint16_t frame_size = 128;
+static constexpr uint16_t payload_offset = RTE_ETHER_HDR_LEN +
+					   sizeof(struct rte_ipv4_hdr) +
+					   sizeof(struct rte_udp_hdr);
+static constexpr uint32_t max_polls = 1000000;
+
+static const char *const vdevs[] = { "crypto_aesni_mb", "crypto_openssl",
+				     "crypto_null" };
+
+static struct ffpp_crypto_session_params params = {
+	FFPP_CRYPTO_AES_CBC,
+	{ 0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae,
+	  0xf0, 0x85, 0x7d, 0x77, 0x81 },
+	{ 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
+	  0x0b, 0x0c, 0x0d, 0x0e, 0x0f },
+};
+
+static void build_udp(struct rte_mbuf *m)
+{
+	auto data = rte_pktmbuf_mtod(m, uint8_t *);
+	assert(rte_pktmbuf_append(m, frame_size) != NULL);
+	memset(data, 0, payload_offset);
+	for (uint16_t i = payload_offset; i < frame_size; ++i) {
+		data[i] = static_cast<uint8_t>(i);
+	}
+}
+
+static bool payload_is_plain(struct rte_mbuf *m)
+{
+	auto data = rte_pktmbuf_mtod(m, uint8_t *);
+	for (uint16_t i = payload_offset; i < frame_size; ++i) {
+		if (data[i] != static_cast<uint8_t>(i)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Dequeue until n packets are appended to vec.
+static void dequeue_all(struct ffpp_cryptodev *cd, struct ffpp_mvec *vec,
+			uint64_t *seqs, uint16_t n)
+{
+	for (uint32_t i = 0; vec->len < n && i < max_polls; ++i) {
+		ffpp_cryptodev_dequeue(cd, 0, vec, seqs);
+	}
+	assert(vec->len == n);
+}
+
+static void test_create(const char *name, uint8_t dev_id,
+			struct ffpp_cryptodev_config *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	strcpy(cfg->name, "test_cdev");
+	cfg->dev_id = dev_id;
+	cfg->socket_id = rte_socket_id();
+	cfg->max_sessions = 2;
+	cfg->offset = payload_offset;
+
+	struct ffpp_cryptodev_config bad = *cfg;
+	bad.max_sessions = 0;
+	assert(ffpp_cryptodev_create(&bad) == NULL && rte_errno == EINVAL);
+	bad = *cfg;
+	bad.nb_qps = UINT16_MAX;
+	assert(ffpp_cryptodev_create(&bad) == NULL && rte_errno == EINVAL);
+	printf("Testing with %s\n", name);
+}
+
+static void test_offload(struct ffpp_cryptodev *cd, struct rte_mempool *pool,
+			 struct ffpp_mvec *vec)
+{
+	bool is_null = params.algo == FFPP_CRYPTO_NULL;
+
+	// Without worker lcores, there is one queue pair without an lcore.
+	assert(ffpp_cryptodev_nb_qps(cd) == 1);
+	assert(ffpp_cryptodev_lcore_qp(cd, rte_lcore_id()) == -ENOENT);
+	assert(ffpp_cryptodev_set_qp_lcore(cd, 1, rte_lcore_id()) == -EINVAL);
+	assert(ffpp_cryptodev_set_qp_lcore(cd, 0, rte_lcore_id()) == 0);
+	assert(ffpp_cryptodev_lcore_qp(cd, rte_lcore_id()) == 0);
+
+	int enc = ffpp_cryptodev_session_create(cd, &params,
+						FFPP_CRYPTO_ENCRYPT);
+	int dec = ffpp_cryptodev_session_create(cd, &params,
+						FFPP_CRYPTO_DECRYPT);
+	assert(enc == 1 && dec == 2);
+	assert(ffpp_cryptodev_session_create(cd, &params,
+					     FFPP_CRYPTO_ENCRYPT) == -ENOSPC);
+
+	struct ffpp_crypto_config cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	strcpy(cfg.name, "test_cdev_inline");
+	cfg.socket_id = rte_socket_id();
+	cfg.nb_parts = 1;
+	cfg.max_sessions = 1;
+	cfg.max_flows = 64;
+	cfg.offset = payload_offset;
+	struct ffpp_crypto *c = nullptr;
+	struct ffpp_crypto_session *s = nullptr;
+	if (!is_null) {
+		c = ffpp_crypto_create(&cfg);
+		assert(c != NULL);
+		s = ffpp_crypto_session_get(
+			c, 0, ffpp_crypto_session_create(c, &params));
+		assert(s != NULL);
+	}
+
+	// The last packet has no payload and is kept.
+	struct rte_mbuf *pkts[nb_pkts];
+	assert(rte_pktmbuf_alloc_bulk(pool, pkts, nb_pkts) == 0);
+	for (uint16_t i = 0; i < nb_pkts - 1; ++i) {
+		build_udp(pkts[i]);
+	}
+	assert(rte_pktmbuf_append(pkts[nb_pkts - 1], payload_offset) != NULL);
+	ffpp_mvec_set_mbufs(vec, pkts, nb_pkts);
+	assert(ffpp_cryptodev_enqueue(cd, 0, enc, vec, NULL) == nb_pkts - 1);
+	assert(vec->len == 1 && vec->head[0] == pkts[nb_pkts - 1]);
+	rte_pktmbuf_free(vec->head[0]);
+	vec->len = 0;
+
+	uint64_t seqs[nb_pkts];
+	dequeue_all(cd, vec, seqs, nb_pkts - 1);
+	for (uint16_t i = 0; i < vec->len; ++i) {
+		// The sequence numbers of the queue pair start at 0.
+		assert(seqs[i] == i);
+		auto m = vec->head[i];
+		assert(payload_is_plain(m) == is_null);
+		if (!is_null) {
+			ffpp_crypto_decrypt(
+				s,
+				rte_pktmbuf_mtod_offset(m, uint8_t *,
+							payload_offset),
+				frame_size - payload_offset, seqs[i]);
+			assert(payload_is_plain(m));
+		}
+	}
+
+	// Encrypt inline and decrypt with the device.
+	if (!is_null) {
+		assert(ffpp_crypto_encrypt_mvec(s, vec, payload_offset, seqs) ==
+		       vec->len);
+	}
+	uint16_t n = vec->len;
+	assert(ffpp_cryptodev_enqueue(cd, 0, dec, vec, NULL) == 0);
+	assert(vec->len == n);
+	assert(ffpp_cryptodev_enqueue(cd, 0, dec, vec, seqs) == n);
+	assert(vec->len == 0);
+	dequeue_all(cd, vec, NULL, n);
+	for (uint16_t i = 0; i < vec->len; ++i) {
+		assert(payload_is_plain(vec->head[i]));
+	}
+
+	struct ffpp_cryptodev_stats stats;
+	ffpp_cryptodev_get_stats(cd, 0, &stats);
+	assert(stats.enqueued == 2 * n && stats.dequeued == 2 * n);
+	assert(stats.skipped == 1 && stats.inflight == 0);
+	assert(stats.errors == 0 && stats.busy == 0 && stats.no_ops == 0);
+	// CBC processes only whole blocks.
+	uint32_t len = frame_size - payload_offset;
+	if (!is_null) {
+		len = len / AES_BLOCKLEN * AES_BLOCKLEN;
+	}
+	assert(stats.bytes == 2ULL * n * len);
+
+	// The session is kept while its ops are inflight, but it does not
+	// accept packets anymore.
+	assert(ffpp_cryptodev_reader_register(cd, 1) == -EINVAL);
+	assert(ffpp_cryptodev_reader_register(cd, 0) == 0);
+	assert(ffpp_cryptodev_enqueue(cd, 0, enc, vec, NULL) == n);
+	ffpp_cryptodev_quiescent(cd, 0);
+	ffpp_cryptodev_reader_unregister(cd, 0);
+	assert(ffpp_cryptodev_session_destroy(cd, enc) == -EBUSY);
+	assert(ffpp_cryptodev_session_create(cd, &params,
+					     FFPP_CRYPTO_ENCRYPT) == -ENOSPC);
+	dequeue_all(cd, vec, NULL, n);
+	assert(ffpp_cryptodev_enqueue(cd, 0, enc, vec, NULL) == 0);
+	assert(vec->len == n);
+	assert(ffpp_cryptodev_session_destroy(cd, enc) == 0);
+	assert(ffpp_cryptodev_session_destroy(cd, enc) == -ENOENT);
+	assert(ffpp_cryptodev_enqueue(cd, 0, enc, vec, NULL) == 0);
+	ffpp_mvec_free_mbufs(vec);
+	ffpp_crypto_free(c);
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	const char *name = nullptr;
+	for (const char *vdev : vdevs) {
+		if (rte_vdev_init(vdev, NULL) == 0) {
+			name = vdev;
+			break;
+		}
+	}
+	if (name == nullptr) {
+		printf("No software cryptodev is available, skip the test.\n");
+		rte_eal_cleanup();
+		return 0;
+	}
+	if (strcmp(name, "crypto_null") == 0) {
+		params.algo = FFPP_CRYPTO_NULL;
+	}
+	int dev_id = rte_cryptodev_get_dev_id(name);
+	assert(dev_id >= 0);
+
+	struct rte_mempool *pool =
+		ffpp_init_mempool("test_cryptodev", 1023,
+				  RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	assert(pool != NULL);
+	struct ffpp_mvec vec;
+	ffpp_mvec_init(&vec, nb_pkts);
+
+	struct ffpp_cryptodev_config cfg;
+	test_create(name, dev_id, &cfg);
+	struct ffpp_cryptodev *cd = ffpp_cryptodev_create(&cfg);
+	assert(cd != NULL);
+	test_offload(cd, pool, &vec);
+	assert(rte_mempool_in_use_count(pool) == 0);
+
+	ffpp_cryptodev_free(cd);
+	rte_cryptodev_close(dev_id);
+	rte_vdev_uninit(name);
+	ffpp_mvec_free(&vec);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
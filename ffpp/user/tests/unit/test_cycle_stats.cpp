@@ -0,0 +1,104 @@
+/*
+ * test_cycle_stats.cpp
+ *
+ * Check the shared memzone layout of the cycle stats, the accumulation of the
+ * writer side and the busy ratio between two snapshots.
+ */
+
+#include <cassert>
+#include <cstddef>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_errno.h>
+#include <rte_lcore.h>
+#include <rte_memzone.h>
+
+#include "ffpp/cycle_stats.h"
+
+// Each lcore writes to its own cache lines.
+static_assert(sizeof(struct ffpp_lcore_cycles) % RTE_CACHE_LINE_SIZE == 0);
+static_assert(offsetof(struct ffpp_cycle_stats, lcores) % RTE_CACHE_LINE_SIZE ==
+	      0);
+
+static void test_layout(void)
+{
+	assert(ffpp_cycle_stats_attach() == NULL);
+	assert(rte_errno == ENOENT);
+
+	struct ffpp_cycle_stats *cs = ffpp_cycle_stats_get();
+	assert(cs != NULL);
+	assert(cs->magic == FFPP_CYCLE_STATS_MAGIC);
+	assert(cs->tsc_hz == rte_get_tsc_hz());
+	for (unsigned int i = 0; i < RTE_MAX_LCORE; ++i) {
+		assert(cs->lcores[i].active == 0);
+		assert(cs->lcores[i].last_tsc == 0);
+	}
+	assert(ffpp_cycle_stats_get() == cs);
+	assert(ffpp_cycle_stats_attach() == cs);
+
+	// Secondary processes find the stats by the memzone name.
+	const struct rte_memzone *mz =
+		rte_memzone_lookup(FFPP_CYCLE_STATS_MZ_NAME);
+	assert(mz != NULL);
+	assert(mz->addr == cs);
+	assert(mz->len >= sizeof(*cs));
+
+	// Attaching fails until the primary has initialized the stats.
+	cs->magic = 0;
+	assert(ffpp_cycle_stats_attach() == NULL);
+	assert(rte_errno == EINVAL);
+	cs->magic = FFPP_CYCLE_STATS_MAGIC;
+}
+
+static void test_accumulation(void)
+{
+	struct ffpp_cycle_stats *cs = ffpp_cycle_stats_attach();
+	struct ffpp_lcore_cycles *c = &(cs->lcores[rte_lcore_id()]);
+	struct ffpp_lcore_cycles prev, cur;
+
+	ffpp_cycle_stats_read(cs, rte_lcore_id(), &prev);
+	assert(ffpp_cycle_stats_busy_ratio(&prev, &prev) == 0.0);
+
+	ffpp_lcore_cycles_poll(c, true, 100, 1000);
+	ffpp_lcore_cycles_poll(c, true, 200, 2000);
+	ffpp_lcore_cycles_poll(c, false, 400, 3000);
+	ffpp_lcore_cycles_proc(c, 100);
+	ffpp_lcore_cycles_tx(c, 200);
+	ffpp_cycle_stats_read(cs, rte_lcore_id(), &cur);
+	assert(cur.idle_cycles == prev.idle_cycles + 300);
+	assert(cur.proc_cycles == prev.proc_cycles + 500);
+	assert(cur.tx_cycles == prev.tx_cycles + 200);
+	assert(cur.empty_polls == prev.empty_polls + 2);
+	assert(cur.busy_polls == prev.busy_polls + 1);
+	assert(cur.last_tsc == 3000);
+	assert(ffpp_cycle_stats_busy_ratio(&prev, &cur) == 0.7);
+
+	// Only the difference between the snapshots counts.
+	prev = cur;
+	ffpp_lcore_cycles_poll(c, true, 1000, 4000);
+	ffpp_cycle_stats_read(cs, rte_lcore_id(), &cur);
+	assert(ffpp_cycle_stats_busy_ratio(&prev, &cur) == 0.0);
+	prev = cur;
+	ffpp_lcore_cycles_poll(c, false, 1000, 5000);
+	ffpp_cycle_stats_read(cs, rte_lcore_id(), &cur);
+	assert(ffpp_cycle_stats_busy_ratio(&prev, &cur) == 1.0);
+
+	// The other lcores are not touched.
+	unsigned int other = (rte_lcore_id() + 1) % RTE_MAX_LCORE;
+	ffpp_cycle_stats_read(cs, other, &cur);
+	assert(cur.idle_cycles == 0 && cur.proc_cycles == 0 &&
+	       cur.tx_cycles == 0 && cur.last_tsc == 0);
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	test_layout();
+	test_accumulation();
+
+	rte_eal_cleanup();
+	return 0;
+}
@@ -0,0 +1,196 @@
+/*
+ * test_flow_table.cpp
+ *
+ * Insert, look up and delete flows of two partitions, fill a partition and
+ * expire idle flows with small timer wheel slices.
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_udp.h>
+
+#include "ffpp/collections.h"
+#include "ffpp/flow_table.h"
+#include "ffpp/memory.h"
+
+static constexpr uint32_t max_flows = 1000;
+static constexpr uint16_t nb_pkts = 100;
+
+struct flow_state {
+	uint64_t pkts;
+	uint32_t id;
+};
+
+static uint32_t nb_expire_calls = 0;
+
+static void on_expire(const struct ffpp_cls_5tuple *key, void *data, void *arg)
+{
+	(void)key;
+	auto state = reinterpret_cast<struct flow_state *>(data);
+	assert(state->pkts > 0);
+	(*reinterpret_cast<uint32_t *>(arg))++;
+}
+
+static void make_key(uint32_t i, struct ffpp_cls_5tuple *key)
+{
+	memset(key, 0, sizeof(*key));
+	key->src_addr = rte_cpu_to_be_32(RTE_IPV4(10, 0, 0, 0) + i);
+	key->dst_addr = rte_cpu_to_be_32(RTE_IPV4(10, 1, 0, 1));
+	key->src_port = rte_cpu_to_be_16(1000);
+	key->dst_port = rte_cpu_to_be_16(80);
+	key->proto = IPPROTO_UDP;
+}
+
+static void build_udp(struct rte_mbuf *m, uint32_t i)
+{
+	auto eth = reinterpret_cast<struct rte_ether_hdr *>(
+		rte_pktmbuf_append(m, 64));
+	assert(eth != NULL);
+	memset(eth, 0, 64);
+	eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+	auto ip = reinterpret_cast<struct rte_ipv4_hdr *>(eth + 1);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->next_proto_id = IPPROTO_UDP;
+	ip->src_addr = rte_cpu_to_be_32(RTE_IPV4(10, 0, 0, 0) + i);
+	ip->dst_addr = rte_cpu_to_be_32(RTE_IPV4(10, 1, 0, 1));
+	auto udp = reinterpret_cast<struct rte_udp_hdr *>(ip + 1);
+	udp->src_port = rte_cpu_to_be_16(1000);
+	udp->dst_port = rte_cpu_to_be_16(80);
+}
+
+static uint32_t age_all(struct ffpp_flow_table *tbl, uint16_t part)
+{
+	uint32_t nb_expired = 0;
+	// Slices of one unit of work, at most one flow expires per call.
+	for (uint32_t i = 0; i < 100000; ++i) {
+		uint32_t n = ffpp_flow_age(tbl, part, 1);
+		assert(n <= 1);
+		nb_expired += n;
+	}
+	return nb_expired;
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	struct ffpp_flow_table_config cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	strcpy(cfg.name, "test_flows");
+	cfg.socket_id = rte_socket_id();
+	cfg.nb_parts = 2;
+	cfg.max_flows = max_flows;
+	cfg.data_size = sizeof(struct flow_state);
+	cfg.tick_us = 100;
+	cfg.timeout_us = 2000;
+	cfg.expire_cb = on_expire;
+	cfg.expire_arg = &nb_expire_calls;
+	struct ffpp_flow_table *tbl = ffpp_flow_table_create(&cfg);
+	assert(tbl != NULL);
+
+	struct ffpp_cls_5tuple keys[FFPP_FLOW_BULK_MAX];
+	void *data[FFPP_FLOW_BULK_MAX];
+	for (uint32_t i = 0; i < FFPP_FLOW_BULK_MAX; ++i) {
+		// The second half repeats the first half.
+		make_key(i % (FFPP_FLOW_BULK_MAX / 2), &keys[i]);
+	}
+	assert(ffpp_flow_lookup_bulk(tbl, 0, keys, FFPP_FLOW_BULK_MAX, data) ==
+	       0);
+	assert(ffpp_flow_insert_bulk(tbl, 0, keys, FFPP_FLOW_BULK_MAX, data) ==
+	       FFPP_FLOW_BULK_MAX);
+	for (uint32_t i = 0; i < FFPP_FLOW_BULK_MAX / 2; ++i) {
+		assert(data[i] == data[i + FFPP_FLOW_BULK_MAX / 2]);
+		auto state = reinterpret_cast<struct flow_state *>(data[i]);
+		assert(state->pkts == 0);
+		state->pkts = 1;
+		state->id = i;
+	}
+	struct ffpp_flow_stats stats;
+	ffpp_flow_get_stats(tbl, 0, &stats);
+	assert(stats.nb_flows == FFPP_FLOW_BULK_MAX / 2);
+	assert(stats.inserts == FFPP_FLOW_BULK_MAX / 2);
+	// The partitions are independent.
+	assert(ffpp_flow_lookup_bulk(tbl, 1, keys, FFPP_FLOW_BULK_MAX, data) ==
+	       0);
+
+	assert(ffpp_flow_lookup_bulk(tbl, 0, keys, FFPP_FLOW_BULK_MAX, data) ==
+	       FFPP_FLOW_BULK_MAX);
+	assert(reinterpret_cast<struct flow_state *>(data[5])->id == 5);
+	assert(ffpp_flow_del(tbl, 0, &keys[5]) == 0);
+	assert(ffpp_flow_del(tbl, 0, &keys[5]) == -ENOENT);
+	assert(ffpp_flow_lookup_bulk(tbl, 0, keys, FFPP_FLOW_BULK_MAX, data) ==
+	       FFPP_FLOW_BULK_MAX - 2);
+	assert(data[5] == NULL);
+
+	// The flows of the vector are inserted into partition 1.
+	struct rte_mempool *pool =
+		ffpp_init_mempool("test_flows", 1023, RTE_MBUF_DEFAULT_BUF_SIZE,
+				  rte_socket_id());
+	assert(pool != NULL);
+	struct rte_mbuf *pkts[nb_pkts];
+	assert(rte_pktmbuf_alloc_bulk(pool, pkts, nb_pkts) == 0);
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		build_udp(pkts[i], i);
+	}
+	struct ffpp_mvec vec;
+	ffpp_mvec_init(&vec, nb_pkts);
+	ffpp_mvec_set_mbufs(&vec, pkts, nb_pkts);
+	void *vec_data[nb_pkts];
+	assert(ffpp_flow_lookup_mvec(tbl, 1, &vec, vec_data, false) == 0);
+	assert(ffpp_flow_lookup_mvec(tbl, 1, &vec, vec_data, true) == nb_pkts);
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		reinterpret_cast<struct flow_state *>(vec_data[i])->pkts++;
+	}
+	make_key(7, &keys[0]);
+	assert(ffpp_flow_lookup_bulk(tbl, 1, keys, 1, data) == 1);
+	assert(data[0] == vec_data[7]);
+
+	// Fill partition 1.
+	uint32_t nb_inserted = nb_pkts;
+	for (uint32_t i = nb_pkts; i < 2 * max_flows; i += FFPP_FLOW_BULK_MAX) {
+		for (uint32_t j = 0; j < FFPP_FLOW_BULK_MAX; ++j) {
+			make_key(i + j, &keys[j]);
+		}
+		nb_inserted += ffpp_flow_insert_bulk(tbl, 1, keys,
+						     FFPP_FLOW_BULK_MAX, data);
+		for (uint32_t j = 0; j < FFPP_FLOW_BULK_MAX; ++j) {
+			if (data[j] != NULL) {
+				reinterpret_cast<struct flow_state *>(data[j])
+					->pkts = 1;
+			}
+		}
+	}
+	ffpp_flow_get_stats(tbl, 1, &stats);
+	assert(nb_inserted == max_flows);
+	assert(stats.nb_flows == max_flows);
+	assert(stats.insert_failures > 0);
+
+	// All idle flows expire, the deleted one is not reported.
+	rte_delay_ms(5);
+	assert(age_all(tbl, 0) == FFPP_FLOW_BULK_MAX / 2 - 1);
+	assert(age_all(tbl, 1) == max_flows);
+	assert(nb_expire_calls == FFPP_FLOW_BULK_MAX / 2 - 1 + max_flows);
+	ffpp_flow_get_stats(tbl, 1, &stats);
+	assert(stats.nb_flows == 0);
+	assert(stats.expired == max_flows);
+
+	// The entries are reused.
+	assert(ffpp_flow_lookup_mvec(tbl, 1, &vec, vec_data, true) == nb_pkts);
+
+	ffpp_flow_table_free(tbl);
+	rte_pktmbuf_free_bulk(pkts, nb_pkts);
+	ffpp_mvec_free(&vec);
+	assert(rte_mempool_in_use_count(pool) == 0);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
@@ -0,0 +1,239 @@
+/*
+ * test_gcm.cpp
+ *
+ * Encrypt UDP packets of several bursts with a GCM processor, check the pushed
+ * headers and the batching, then decrypt them with a second processor. A
+ * tampered packet and packets that are too short are freed.
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <rte_eal.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_udp.h>
+
+#include "ffpp/collections.h"
+#include "ffpp/gcm.h"
+#include "ffpp/memory.h"
+
+static constexpr uint16_t nb_pkts = 40;
+static constexpr uint16_t burst = 6;
+static constexpr uint16_t batch_size = 16;
+static constexpr uint16_t part = 1;
+static constexpr uint16_t payload_offset = RTE_ETHER_HDR_LEN +
+					   sizeof(struct rte_ipv4_hdr) +
+					   sizeof(struct rte_udp_hdr);
+
+static uint16_t frame_size(uint16_t i)
+{
+	// Empty payloads, partial blocks and several batches of blocks.
+	return payload_offset + (i * 37) % 1400;
+}
+
+static void build_udp(struct rte_mbuf *m, uint16_t size)
+{
+	auto data = reinterpret_cast<uint8_t *>(rte_pktmbuf_append(m, size));
+	assert(data != NULL);
+	memset(data, 0, payload_offset);
+	for (uint16_t i = payload_offset; i < size; ++i) {
+		data[i] = static_cast<uint8_t>(i);
+	}
+	auto eth = reinterpret_cast<struct rte_ether_hdr *>(data);
+	eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+	auto ip = reinterpret_cast<struct rte_ipv4_hdr *>(eth + 1);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->next_proto_id = IPPROTO_UDP;
+	ip->total_length = rte_cpu_to_be_16(size - RTE_ETHER_HDR_LEN);
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+	auto udp = reinterpret_cast<struct rte_udp_hdr *>(ip + 1);
+	udp->dgram_len = rte_cpu_to_be_16(size - RTE_ETHER_HDR_LEN -
+					  sizeof(struct rte_ipv4_hdr));
+}
+
+static bool payload_is_plain(struct rte_mbuf *m)
+{
+	auto data = rte_pktmbuf_mtod(m, uint8_t *);
+	for (uint16_t i = payload_offset; i < rte_pktmbuf_data_len(m); ++i) {
+		if (data[i] != static_cast<uint8_t>(i)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// The lengths and the IPv4 checksum must match the data length.
+static void check_udp(struct rte_mbuf *m)
+{
+	auto ip = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *,
+					  RTE_ETHER_HDR_LEN);
+	auto udp = reinterpret_cast<struct rte_udp_hdr *>(ip + 1);
+	assert(rte_be_to_cpu_16(ip->total_length) ==
+	       rte_pktmbuf_data_len(m) - RTE_ETHER_HDR_LEN);
+	struct rte_ipv4_hdr hdr = *ip;
+	hdr.hdr_checksum = 0;
+	assert(rte_ipv4_cksum(&hdr) == ip->hdr_checksum);
+	assert(rte_be_to_cpu_16(udp->dgram_len) ==
+	       rte_be_to_cpu_16(ip->total_length) -
+		       sizeof(struct rte_ipv4_hdr));
+	assert(udp->dgram_cksum == 0);
+}
+
+static struct ffpp_gcm *create(enum ffpp_crypto_dir dir)
+{
+	struct ffpp_gcm_config cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	strcpy(cfg.name, dir == FFPP_CRYPTO_ENCRYPT ? "test_gcm_enc" :
+							"test_gcm_dec");
+	cfg.socket_id = rte_socket_id();
+	cfg.nb_parts = 2;
+	cfg.offset = payload_offset;
+	cfg.dir = dir;
+	for (uint8_t i = 0; i < AES_KEYLEN; ++i) {
+		cfg.key[i] = i;
+	}
+	memcpy(cfg.salt, "\xca\xfe\xba\xbe", FFPP_GCM_SALT_LEN);
+
+	struct ffpp_gcm_config bad = cfg;
+	bad.batch_size = FFPP_GCM_BATCH_MAX + 1;
+	assert(ffpp_gcm_create(&bad) == NULL && rte_errno == EINVAL);
+	bad = cfg;
+	bad.nb_parts = 0;
+	assert(ffpp_gcm_create(&bad) == NULL && rte_errno == EINVAL);
+
+	cfg.batch_size = batch_size;
+	struct ffpp_gcm *g = ffpp_gcm_create(&cfg);
+	assert(g != NULL);
+	return g;
+}
+
+static void test_encrypt(struct ffpp_gcm *enc, struct rte_mempool *pool,
+			 struct ffpp_mvec *vec, struct ffpp_mvec *out)
+{
+	struct rte_mbuf *pkts[nb_pkts + 1];
+	assert(rte_pktmbuf_alloc_bulk(pool, pkts, nb_pkts + 1) == 0);
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		build_udp(pkts[i], frame_size(i));
+	}
+	// Too short for the offset, it is dropped.
+	assert(rte_pktmbuf_append(pkts[nb_pkts], payload_offset - 1) != NULL);
+
+	// The packets of several bursts are gathered until a batch is full.
+	struct ffpp_gcm_stats stats;
+	uint16_t n = 0;
+	for (uint16_t i = 0; i < nb_pkts + 1; i += burst) {
+		uint16_t len = RTE_MIN(burst, nb_pkts + 1 - i);
+		ffpp_mvec_set_mbufs(vec, pkts + i, len);
+		n += ffpp_gcm_process(enc, part, vec, out);
+		assert(vec->len == 0);
+		ffpp_gcm_get_stats(enc, part, &stats);
+		assert(stats.pending == (i + len) % batch_size);
+		assert(n == out->len && out->len % batch_size == 0);
+	}
+	assert(ffpp_gcm_flush(enc, part, out) == nb_pkts - n);
+	assert(out->len == nb_pkts);
+	assert(ffpp_gcm_flush(enc, part, out) == 0);
+
+	ffpp_gcm_get_stats(enc, part, &stats);
+	assert(stats.encrypted == nb_pkts && stats.dropped == 1);
+	assert(stats.batches == (nb_pkts + 1) / batch_size + 1);
+	assert(stats.pending == 0 && stats.auth_failed == 0);
+	ffpp_gcm_get_stats(enc, 0, &stats);
+	assert(stats.encrypted == 0 && stats.batches == 0);
+
+	uint64_t bytes = 0;
+	for (uint16_t i = 0; i < out->len; ++i) {
+		auto m = out->head[i];
+		assert(m == pkts[i]);
+		assert(rte_pktmbuf_data_len(m) ==
+		       frame_size(i) + FFPP_GCM_HDR_LEN);
+		check_udp(m);
+		// The sequence numbers of the partition start at part << 48.
+		auto hdr = rte_pktmbuf_mtod_offset(m, struct ffpp_gcm_hdr *,
+						   payload_offset);
+		assert(rte_be_to_cpu_64(hdr->seq) ==
+		       ((uint64_t)part << FFPP_CRYPTO_SEQ_PART_SHIFT) + i);
+		bytes += frame_size(i) - payload_offset;
+	}
+	ffpp_gcm_get_stats(enc, part, &stats);
+	assert(stats.bytes == bytes);
+}
+
+static void test_decrypt(struct ffpp_gcm *dec, struct ffpp_mvec *vec,
+			 struct ffpp_mvec *out)
+{
+	// Flip a bit of the ciphertext and of the sequence number (AAD).
+	auto tampered = vec->head[3];
+	*rte_pktmbuf_mtod_offset(tampered, uint8_t *,
+				 payload_offset + FFPP_GCM_HDR_LEN) ^= 1;
+	auto tampered_seq = vec->head[7];
+	*rte_pktmbuf_mtod_offset(tampered_seq, uint8_t *, payload_offset) ^= 1;
+
+	// There is only room for one batch in out, the rest stays in vec.
+	uint16_t n = vec->len;
+	out->capacity = batch_size;
+	assert(ffpp_gcm_process(dec, part, vec, out) == batch_size - 2);
+	assert(vec->len == n - 2 * batch_size);
+	out->capacity = nb_pkts + 1;
+	while (vec->len > 0) {
+		ffpp_gcm_process(dec, part, vec, out);
+	}
+	ffpp_gcm_flush(dec, part, out);
+	assert(out->len == n - 2);
+
+	struct ffpp_gcm_stats stats;
+	ffpp_gcm_get_stats(dec, part, &stats);
+	assert(stats.decrypted == n - 2u && stats.auth_failed == 2);
+	assert(stats.dropped == 0 && stats.pending == 0);
+	for (uint16_t i = 0; i < out->len; ++i) {
+		auto m = out->head[i];
+		assert(m != tampered && m != tampered_seq);
+		assert(payload_is_plain(m));
+		check_udp(m);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	struct rte_mempool *pool =
+		ffpp_init_mempool("test_gcm", 1023, RTE_MBUF_DEFAULT_BUF_SIZE,
+				  rte_socket_id());
+	assert(pool != NULL);
+	struct ffpp_mvec vec;
+	struct ffpp_mvec out;
+	ffpp_mvec_init(&vec, nb_pkts + 1);
+	ffpp_mvec_init(&out, nb_pkts + 1);
+
+	struct ffpp_gcm *enc = create(FFPP_CRYPTO_ENCRYPT);
+	struct ffpp_gcm *dec = create(FFPP_CRYPTO_DECRYPT);
+	test_encrypt(enc, pool, &vec, &out);
+	ffpp_mvec_set_mbufs(&vec, out.head, out.len);
+	out.len = 0;
+	test_decrypt(dec, &vec, &out);
+	ffpp_mvec_free_mbufs(&out);
+
+	// The packets in a batch are freed with the processor.
+	struct rte_mbuf *m = rte_pktmbuf_alloc(pool);
+	assert(m != NULL);
+	build_udp(m, frame_size(1));
+	ffpp_mvec_set_mbufs(&vec, &m, 1);
+	assert(ffpp_gcm_process(enc, 0, &vec, &out) == 0);
+	ffpp_gcm_free(enc);
+	ffpp_gcm_free(dec);
+	assert(rte_mempool_in_use_count(pool) == 0);
+
+	ffpp_mvec_free(&vec);
+	ffpp_mvec_free(&out);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
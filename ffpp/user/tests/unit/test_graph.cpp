@@ -0,0 +1,111 @@
+/*
+ * test_graph.cpp
+ *
+ * Test a VNF declared as graph with two null ports, one graph per worker
+ * lcore.
+ */
+
+#include <cassert>
+#include <cstring>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+#include "ffpp/collections.h"
+#include "ffpp/device.h"
+#include "ffpp/graph.h"
+#include "ffpp/memory.h"
+
+static uint16_t drop_half(struct ffpp_mvec *vec, void *arg)
+{
+	(void)arg;
+	return vec->len / 2;
+}
+
+static int to_port_0(struct rte_mbuf *m, void *arg)
+{
+	(void)m;
+	(void)arg;
+	return 0;
+}
+
+static void run_and_check(const struct ffpp_graph_config *cfg,
+			  struct rte_mempool *pool)
+{
+	struct ffpp_graph_vnf *vnf = ffpp_graph_vnf_create(cfg);
+	assert(vnf != NULL);
+	assert(ffpp_graph_vnf_nb_graphs(vnf) == 2);
+	assert(ffpp_graph_vnf_get_graph(vnf, 2) == NULL);
+	assert(ffpp_graph_vnf_launch(vnf) == 0);
+	rte_delay_ms(100);
+	ffpp_graph_vnf_stop(vnf);
+
+	struct ffpp_graph_stats stats;
+	assert(ffpp_graph_vnf_get_stats(vnf, &stats) == 0);
+	ffpp_graph_vnf_print_stats(vnf);
+	assert(stats.rx_pkts > 0);
+	assert(stats.dropped >= stats.rx_pkts / 2);
+	assert(stats.rx_pkts == stats.tx_pkts + stats.dropped);
+	// All mbufs are either transmitted or freed after the walks stopped.
+	assert(rte_mempool_in_use_count(pool) == 0);
+	ffpp_graph_vnf_destroy(vnf);
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	assert(rte_lcore_count() >= 3);
+
+	struct rte_mempool *pool = ffpp_init_mempool(
+		"test_graph", 8191, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	assert(pool != NULL);
+
+	for (uint16_t port_id = 0; port_id < 2; ++port_id) {
+		struct ffpp_dpdk_device_config dev_cfg;
+		memset(&dev_cfg, 0, sizeof(dev_cfg));
+		dev_cfg.port_id = port_id;
+		dev_cfg.pool = &pool;
+		dev_cfg.rx_queues = 2;
+		dev_cfg.tx_queues = 2;
+		dev_cfg.rx_descs = 512;
+		dev_cfg.tx_descs = 512;
+		dev_cfg.disable_offloads = 1;
+		ffpp_dpdk_init_device(&dev_cfg);
+	}
+
+	struct ffpp_graph_config cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	strcpy(cfg.name, "test");
+	cfg.nb_ports = 2;
+	cfg.port_ids[0] = 0;
+	cfg.port_ids[1] = 1;
+	cfg.tx_port_map[0] = 1;
+	cfg.tx_port_map[1] = 0;
+	cfg.nb_rx_queues = 2;
+	cfg.nb_tx_queues = 2;
+	cfg.nb_nodes = 3;
+	cfg.nodes[0].type = FFPP_GRAPH_NODE_REWRITE_DL;
+	cfg.nodes[1].type = FFPP_GRAPH_NODE_HANDLER;
+	cfg.nodes[1].handler.func = drop_half;
+	cfg.nodes[2].type = FFPP_GRAPH_NODE_UPDATE_DL_SRC;
+
+	cfg.nodes[1].handler.func = NULL;
+	assert(ffpp_graph_vnf_create(&cfg) == NULL);
+	cfg.nodes[1].handler.func = drop_half;
+
+	run_and_check(&cfg, pool);
+
+	// The node clones of the first run are reused with other edges.
+	cfg.nb_nodes = 2;
+	cfg.classify = to_port_0;
+	run_and_check(&cfg, pool);
+
+	ffpp_dpdk_cleanup_devices();
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * test_histogram.cpp
+ *
+ * Compare the quantiles of the histogram with the exact ones of a sorted
+ * sample, merge the histograms of two lcores while they record and round-trip
+ * the serialization.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <rte_eal.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+#include <rte_random.h>
+
+#include "ffpp/histogram.h"
+
+static constexpr uint32_t nb_samples = 100000;
+// Relative error of a bucket.
+static constexpr double max_error = 1.0 / FFPP_HIST_SUB_BUCKETS;
+
+static int record_worker(void *arg)
+{
+	auto h = static_cast<struct ffpp_hist *>(arg);
+	for (uint32_t i = 0; i < nb_samples; ++i) {
+		ffpp_hist_record(h, 1000 + i % 1000);
+	}
+	return 0;
+}
+
+static void test_quantiles(struct ffpp_hist *h)
+{
+	std::vector<uint64_t> values;
+	for (uint32_t i = 0; i < nb_samples; ++i) {
+		// Mostly small values with a long tail.
+		uint64_t v = rte_rand() % 2000;
+		if (i % 100 == 0) {
+			v = rte_rand() % (1ULL << 40);
+		}
+		values.push_back(v);
+		ffpp_hist_record(h, v);
+	}
+	std::sort(values.begin(), values.end());
+
+	assert(h->count == nb_samples);
+	assert(h->min == values.front());
+	assert(h->max == values.back());
+	for (double q : { 0.5, 0.9, 0.99, 0.999 }) {
+		uint64_t exact = values[(size_t)std::ceil(q * nb_samples) - 1];
+		uint64_t v = ffpp_hist_quantile(h, q);
+		assert(v >= exact);
+		assert((double)(v - exact) <= max_error * exact);
+	}
+	assert(ffpp_hist_quantile(h, 1.0) == values.back());
+
+	struct ffpp_hist_summary s;
+	ffpp_hist_summarize(h, &s);
+	assert(s.count == nb_samples);
+	assert(s.p99 == ffpp_hist_quantile(h, 0.99));
+	assert(s.max == values.back());
+}
+
+static void test_serialize(const struct ffpp_hist *h, struct ffpp_hist *out)
+{
+	size_t len = ffpp_hist_serialized_size(h);
+	std::vector<uint8_t> buf(len);
+	assert(ffpp_hist_serialize(h, buf.data(), len - 1) == -ENOSPC);
+	assert(ffpp_hist_serialize(h, buf.data(), len) == (int)len);
+	assert(ffpp_hist_deserialize(out, buf.data(), len - 1) == -EINVAL);
+	assert(ffpp_hist_deserialize(out, buf.data(), len) == 0);
+	assert(memcmp(out, h, sizeof(*h)) == 0);
+	buf[0] ^= 0xff;
+	assert(ffpp_hist_deserialize(out, buf.data(), len) == -EINVAL);
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	struct ffpp_hist *h = ffpp_hist_create(rte_socket_id());
+	struct ffpp_hist *snap = ffpp_hist_create(rte_socket_id());
+	assert(h != NULL && snap != NULL);
+	assert(ffpp_hist_quantile(h, 0.5) == 0);
+	assert(ffpp_hist_index(UINT64_MAX) == FFPP_HIST_NB_BUCKETS - 1);
+
+	test_quantiles(h);
+	test_serialize(h, snap);
+	ffpp_hist_reset(h);
+	assert(h->count == 0 && ffpp_hist_quantile(h, 0.99) == 0);
+
+	// Merge a worker lcore while it records, if there is one.
+	unsigned int lcore_id = rte_get_next_lcore(-1, 1, 0);
+	ffpp_hist_record(h, 10);
+	if (lcore_id < RTE_MAX_LCORE) {
+		struct ffpp_hist *remote = ffpp_hist_create(rte_socket_id());
+		assert(remote != NULL);
+		rte_eal_remote_launch(record_worker, remote, lcore_id);
+		ffpp_hist_snapshot(remote, snap);
+		assert(snap->count <= nb_samples);
+		rte_eal_wait_lcore(lcore_id);
+		ffpp_hist_merge(h, remote);
+		ffpp_hist_free(remote);
+	} else {
+		record_worker(h);
+	}
+	assert(h->count == nb_samples + 1);
+	assert(h->min == 10);
+	assert(h->max == 1999);
+	assert(ffpp_hist_quantile(h, 0.5) >= 1499);
+	assert(ffpp_hist_quantile(h, 0.5) <= 1499 * (1 + max_error));
+
+	ffpp_hist_free(snap);
+	ffpp_hist_free(h);
+	rte_eal_cleanup();
+	return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * test_ip_frag.cpp
+ *
+ * Fragment a jumbo UDP packet, reassemble its fragments out of order and
+ * check the datagram. Fragments that arrive after the reassembly timeout do
+ * not complete a datagram.
+ */
+
+#include <cassert>
+#include <cstring>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_udp.h>
+
+#include "ffpp/collections.h"
+#include "ffpp/ip_frag.h"
+#include "ffpp/memory.h"
+
+static constexpr uint16_t vec_size = 8;
+static constexpr uint16_t mtu = 1500;
+static constexpr uint16_t jumbo_ip_len = 3000;
+static constexpr uint16_t small_ip_len = 100;
+static constexpr uint16_t hdr_len = RTE_ETHER_HDR_LEN +
+				    sizeof(struct rte_ipv4_hdr) +
+				    sizeof(struct rte_udp_hdr);
+
+static struct rte_mbuf *build_udp(struct rte_mempool *pool, uint16_t ip_len,
+				  uint16_t packet_id, bool df)
+{
+	struct rte_mbuf *m = rte_pktmbuf_alloc(pool);
+	assert(m != NULL);
+	auto eth = reinterpret_cast<struct rte_ether_hdr *>(
+		rte_pktmbuf_append(m, RTE_ETHER_HDR_LEN + ip_len));
+	assert(eth != NULL);
+	memset(eth, 0, hdr_len);
+	eth->d_addr.addr_bytes[5] = 0x02;
+	eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+	auto ip = reinterpret_cast<struct rte_ipv4_hdr *>(eth + 1);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = rte_cpu_to_be_16(ip_len);
+	ip->packet_id = rte_cpu_to_be_16(packet_id);
+	ip->fragment_offset = df ? RTE_BE16(RTE_IPV4_HDR_DF_FLAG) : 0;
+	ip->time_to_live = 64;
+	ip->next_proto_id = IPPROTO_UDP;
+	ip->src_addr = rte_cpu_to_be_32(RTE_IPV4(10, 0, 0, 1));
+	ip->dst_addr = rte_cpu_to_be_32(RTE_IPV4(10, 1, 0, 1));
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+	auto udp = reinterpret_cast<struct rte_udp_hdr *>(ip + 1);
+	udp->src_port = rte_cpu_to_be_16(1000);
+	udp->dst_port = rte_cpu_to_be_16(80);
+	udp->dgram_len = rte_cpu_to_be_16(ip_len - sizeof(*ip));
+	auto payload = reinterpret_cast<uint8_t *>(udp + 1);
+	for (uint16_t i = 0; i < RTE_ETHER_HDR_LEN + ip_len - hdr_len; ++i) {
+		payload[i] = i & 0xff;
+	}
+	return m;
+}
+
+static void check_ip_cksum(struct rte_ipv4_hdr *ip)
+{
+	uint16_t cksum = ip->hdr_checksum;
+	ip->hdr_checksum = 0;
+	assert(rte_ipv4_cksum(ip) == cksum);
+	ip->hdr_checksum = cksum;
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	struct rte_mempool *pool = ffpp_init_mempool(
+		"test_ip_frag", 1023, 8192 + RTE_PKTMBUF_HEADROOM,
+		rte_socket_id());
+	assert(pool != NULL);
+	struct rte_mempool *indirect_pool = rte_pktmbuf_pool_create(
+		"test_ip_frag_ind", 1023, 0, 0, 0, rte_socket_id());
+	assert(indirect_pool != NULL);
+
+	struct ffpp_ip_frag_config cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.socket_id = rte_socket_id();
+	assert(ffpp_ip_frag_create(&cfg) == NULL);
+	cfg.direct_pool = pool;
+	cfg.indirect_pool = indirect_pool;
+	cfg.timeout_ms = 10;
+	cfg.linearize = true;
+	struct ffpp_ip_frag *ctx = ffpp_ip_frag_create(&cfg);
+	assert(ctx != NULL);
+
+	struct ffpp_mvec in, out;
+	ffpp_mvec_init(&in, vec_size);
+	ffpp_mvec_init(&out, vec_size);
+	struct rte_mbuf *pkts[] = { build_udp(pool, small_ip_len, 1, false),
+				    build_udp(pool, jumbo_ip_len, 2, false),
+				    build_udp(pool, jumbo_ip_len, 3, true) };
+	ffpp_mvec_set_mbufs(&in, pkts, 3);
+
+	// 2980 bytes of IP payload in fragments of 1480, 1480 and 20 bytes.
+	assert(ffpp_ip_fragment(ctx, &in, &out) == 4);
+	assert(in.len == 0);
+	assert(out.head[0] == pkts[0]);
+	for (uint16_t i = 1; i < 4; ++i) {
+		struct rte_mbuf *m = out.head[i];
+		assert(rte_pktmbuf_pkt_len(m) <= RTE_ETHER_HDR_LEN + mtu);
+		auto eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+		assert(eth->d_addr.addr_bytes[5] == 0x02);
+		assert(eth->ether_type == RTE_BE16(RTE_ETHER_TYPE_IPV4));
+		auto ip = reinterpret_cast<struct rte_ipv4_hdr *>(eth + 1);
+		check_ip_cksum(ip);
+		uint16_t fofs = rte_be_to_cpu_16(ip->fragment_offset);
+		assert((fofs & RTE_IPV4_HDR_OFFSET_MASK) * 8 == (i - 1) * 1480);
+		assert(((fofs & RTE_IPV4_HDR_MF_FLAG) != 0) == (i < 3));
+	}
+	struct ffpp_ip_frag_stats stats;
+	ffpp_ip_frag_get_stats(ctx, &stats);
+	assert(stats.fragmented == 1);
+	assert(stats.fragments == 3);
+	assert(stats.frag_drops == 1);
+
+	// Reassemble the fragments in reverse order.
+	struct rte_mbuf *frags[] = { out.head[3], out.head[0], out.head[2],
+				     out.head[1] };
+	ffpp_mvec_set_mbufs(&out, frags, 4);
+	assert(ffpp_ip_reassemble(ctx, &out) == 2);
+	assert(out.head[0] == pkts[0]);
+	struct rte_mbuf *dgram = out.head[1];
+	assert(dgram->nb_segs == 1);
+	assert(rte_pktmbuf_pkt_len(dgram) == RTE_ETHER_HDR_LEN + jumbo_ip_len);
+	auto ip = rte_pktmbuf_mtod_offset(dgram, struct rte_ipv4_hdr *,
+					  RTE_ETHER_HDR_LEN);
+	assert(ip->fragment_offset == 0);
+	assert(rte_be_to_cpu_16(ip->total_length) == jumbo_ip_len);
+	check_ip_cksum(ip);
+	auto payload = rte_pktmbuf_mtod_offset(dgram, uint8_t *, hdr_len);
+	for (uint16_t i = 0; i < RTE_ETHER_HDR_LEN + jumbo_ip_len - hdr_len;
+	     ++i) {
+		assert(payload[i] == (i & 0xff));
+	}
+	ffpp_ip_frag_get_stats(ctx, &stats);
+	assert(stats.reasm_fragments == 3);
+	assert(stats.reassembled == 1);
+	rte_pktmbuf_free_bulk(out.head, out.len);
+
+	// The first fragment expires before the others arrive.
+	pkts[0] = build_udp(pool, jumbo_ip_len, 4, false);
+	ffpp_mvec_set_mbufs(&in, pkts, 1);
+	assert(ffpp_ip_fragment(ctx, &in, &out) == 3);
+	memcpy(frags, out.head, 3 * sizeof(frags[0]));
+	ffpp_mvec_set_mbufs(&out, frags, 1);
+	assert(ffpp_ip_reassemble(ctx, &out) == 0);
+	rte_delay_ms(2 * cfg.timeout_ms);
+	ffpp_mvec_set_mbufs(&out, frags + 1, 2);
+	assert(ffpp_ip_reassemble(ctx, &out) == 0);
+	ffpp_ip_frag_get_stats(ctx, &stats);
+	assert(stats.reassembled == 1);
+
+	// The pending fragments are freed with the table.
+	ffpp_ip_frag_free(ctx);
+	ffpp_mvec_free(&in);
+	ffpp_mvec_free(&out);
+	assert(rte_mempool_in_use_count(pool) == 0);
+	assert(rte_mempool_in_use_count(indirect_pool) == 0);
+	rte_mempool_free(indirect_pool);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
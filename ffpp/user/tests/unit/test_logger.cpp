@@ -0,0 +1,123 @@
+/*
+ * test_logger.cpp
+ *
+ * Log records from two threads, check the schema header of the file and that
+ * every record is written once and in order per thread.
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ffpp/logger.h"
+
+static constexpr uint32_t nb_threads = 2;
+static constexpr uint32_t nb_records = 100000;
+static constexpr uint32_t ring_size = 1024;
+static const char *log_path = "/tmp/ffpp_test_logger.ffpplog";
+
+struct test_record {
+	uint64_t seq;
+	double value;
+	uint16_t thread;
+};
+
+static const struct ffpp_log_field test_fields[] = {
+	FFPP_LOG_FIELD(FFPP_LOG_U64, struct test_record, seq),
+	FFPP_LOG_FIELD(FFPP_LOG_F64, struct test_record, value),
+	FFPP_LOG_FIELD(FFPP_LOG_U16, struct test_record, thread),
+};
+
+static void produce(struct ffpp_log_producer *p, uint16_t thread)
+{
+	for (uint32_t i = 0; i < nb_records; ++i) {
+		struct test_record r = { i, i * 0.5, thread };
+		// Retry, so all records are in the file.
+		while (ffpp_log_write(p, &r) != 0) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+int main()
+{
+	struct ffpp_logger_config cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.path = log_path;
+	cfg.name = "test";
+	cfg.fields = test_fields;
+	cfg.nb_fields = RTE_DIM(test_fields);
+	cfg.record_size = sizeof(struct test_record);
+	cfg.ring_size = ring_size + 1;
+	assert(ffpp_logger_create(&cfg) == NULL && errno == EINVAL);
+	cfg.ring_size = ring_size;
+	cfg.record_size = offsetof(struct test_record, thread);
+	assert(ffpp_logger_create(&cfg) == NULL && errno == EINVAL);
+	cfg.record_size = sizeof(struct test_record);
+
+	struct ffpp_logger *lg = ffpp_logger_create(&cfg);
+	assert(lg != NULL);
+	std::vector<std::thread> threads;
+	for (uint16_t t = 0; t < nb_threads; ++t) {
+		struct ffpp_log_producer *p = ffpp_logger_add_producer(lg);
+		assert(p != NULL);
+		threads.emplace_back(produce, p, t);
+	}
+	for (auto &t : threads) {
+		t.join();
+	}
+	ffpp_logger_flush(lg);
+	struct ffpp_logger_stats stats;
+	ffpp_logger_get_stats(lg, &stats);
+	assert(stats.nb_written == nb_threads * nb_records);
+	assert(stats.nb_io_errors == 0);
+	ffpp_logger_free(lg);
+
+	int fd = open(log_path, O_RDONLY);
+	assert(fd >= 0);
+	struct stat st;
+	assert(fstat(fd, &st) == 0);
+	auto map = static_cast<const uint8_t *>(
+		mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+	assert(map != MAP_FAILED);
+
+	auto hdr = reinterpret_cast<const struct ffpp_log_file_hdr *>(map);
+	assert(memcmp(hdr->magic, FFPP_LOG_MAGIC, sizeof(FFPP_LOG_MAGIC)) == 0);
+	assert(hdr->version == FFPP_LOG_VERSION);
+	assert(hdr->record_size == sizeof(struct test_record));
+	assert(hdr->nb_fields == RTE_DIM(test_fields));
+	assert(hdr->nb_records == nb_threads * nb_records);
+	assert(strcmp(hdr->name, "test") == 0);
+	assert((size_t)st.st_size ==
+	       hdr->hdr_len + hdr->nb_records * hdr->record_size);
+	auto fields =
+		reinterpret_cast<const struct ffpp_log_file_field *>(hdr + 1);
+	for (uint16_t i = 0; i < hdr->nb_fields; ++i) {
+		assert(strcmp(fields[i].name, test_fields[i].name) == 0);
+		assert(fields[i].offset == test_fields[i].offset);
+		assert(fields[i].type == test_fields[i].type);
+	}
+
+	uint64_t next[nb_threads] = { 0 };
+	auto records = reinterpret_cast<const struct test_record *>(
+		map + hdr->hdr_len);
+	for (uint64_t i = 0; i < hdr->nb_records; ++i) {
+		const struct test_record &r = records[i];
+		assert(r.thread < nb_threads);
+		assert(r.seq == next[r.thread]);
+		assert(r.value == r.seq * 0.5);
+		next[r.thread]++;
+	}
+
+	munmap(const_cast<uint8_t *>(map), st.st_size);
+	close(fd);
+	unlink(log_path);
+	return 0;
+}
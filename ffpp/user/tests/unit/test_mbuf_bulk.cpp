@@ -0,0 +1,172 @@
+/*
+ * test_mbuf_bulk.cpp
+ *
+ * Allocate and free bursts from two pools, fan out one payload to several
+ * packets with private headers, and deep copy small and large (segmented)
+ * packets.
+ */
+
+#include <cassert>
+#include <cstring>
+
+#include <rte_eal.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+#include "ffpp/collections.h"
+#include "ffpp/mbuf_bulk.h"
+#include "ffpp/memory.h"
+
+static constexpr uint16_t burst_size = 32;
+static constexpr uint16_t hdr_len = 42;
+static constexpr uint16_t nb_outputs = 4;
+
+static void fill(struct rte_mbuf *m, uint16_t len, uint8_t seed)
+{
+	auto p = reinterpret_cast<uint8_t *>(rte_pktmbuf_append(m, len));
+	assert(p != NULL);
+	for (uint16_t i = 0; i < len; ++i) {
+		p[i] = seed + i;
+	}
+}
+
+// Check the data of a possibly segmented packet.
+static void check_data(const struct rte_mbuf *m, uint8_t seed, uint16_t off)
+{
+	uint16_t i = off;
+	for (const struct rte_mbuf *seg = m; seg != NULL; seg = seg->next) {
+		auto p = rte_pktmbuf_mtod(seg, const uint8_t *);
+		for (uint16_t j = 0; j < seg->data_len; ++j, ++i) {
+			assert(p[j] == (uint8_t)(seed + i));
+		}
+	}
+}
+
+static void test_alloc_free(struct rte_mempool *pool_a,
+			    struct rte_mempool *pool_b)
+{
+	struct ffpp_mvec vec_a, vec_b;
+	ffpp_mvec_init(&vec_a, burst_size);
+	ffpp_mvec_init(&vec_b, burst_size);
+	assert(ffpp_mbuf_alloc_bulk(pool_a, &vec_a, burst_size + 1) == -EINVAL);
+	assert(ffpp_mbuf_alloc_bulk(pool_a, &vec_a, burst_size) == 0);
+	assert(vec_a.len == burst_size);
+	assert(ffpp_mbuf_alloc_bulk(pool_b, &vec_b, burst_size) == 0);
+	assert(rte_mempool_in_use_count(pool_a) == burst_size);
+
+	// Interleave the pools and free them at once.
+	struct rte_mbuf *mixed[2 * burst_size];
+	for (uint16_t i = 0; i < burst_size; ++i) {
+		mixed[2 * i] = vec_a.head[i];
+		mixed[2 * i + 1] = vec_b.head[i];
+	}
+	ffpp_mbuf_free_bulk(mixed, 2 * burst_size);
+	assert(rte_mempool_in_use_count(pool_a) == 0);
+	assert(rte_mempool_in_use_count(pool_b) == 0);
+
+	assert(ffpp_mbuf_alloc_bulk(pool_a, &vec_a, burst_size) == 0);
+	ffpp_mbuf_free_mvec(&vec_a);
+	assert(vec_a.len == 0);
+	assert(rte_mempool_in_use_count(pool_a) == 0);
+	ffpp_mvec_free(&vec_a);
+	ffpp_mvec_free(&vec_b);
+}
+
+static void test_fanout(struct rte_mempool *pool,
+			struct rte_mempool *indirect_pool)
+{
+	struct rte_mbuf *m = rte_pktmbuf_alloc(pool);
+	assert(m != NULL);
+	fill(m, hdr_len + 1000, 0);
+	m->port = 3;
+
+	struct rte_mbuf *out[nb_outputs];
+	assert(ffpp_mbuf_fanout(m, rte_pktmbuf_data_len(m) + 1, pool,
+				indirect_pool, out, nb_outputs) == -EINVAL);
+	assert(ffpp_mbuf_fanout(m, hdr_len, pool, indirect_pool, out,
+				nb_outputs) == 0);
+	assert(rte_mbuf_refcnt_read(m) == 1 + nb_outputs);
+	for (uint16_t i = 0; i < nb_outputs; ++i) {
+		assert(out[i]->nb_segs == 2);
+		assert(out[i]->port == 3);
+		assert(rte_pktmbuf_pkt_len(out[i]) == rte_pktmbuf_pkt_len(m));
+		check_data(out[i], 0, 0);
+		// The payload is shared, the header is private.
+		assert(rte_pktmbuf_mtod(out[i]->next, uint8_t *) ==
+		       rte_pktmbuf_mtod(m, uint8_t *) + hdr_len);
+		*rte_pktmbuf_mtod(out[i], uint8_t *) = 0xff;
+	}
+	check_data(m, 0, 0);
+	rte_pktmbuf_free_bulk(out, nb_outputs);
+	assert(rte_mbuf_refcnt_read(m) == 1);
+
+	// Only headers, nothing to share.
+	assert(ffpp_mbuf_fanout(m, rte_pktmbuf_pkt_len(m), pool, indirect_pool,
+				out, nb_outputs) == 0);
+	for (uint16_t i = 0; i < nb_outputs; ++i) {
+		assert(out[i]->nb_segs == 1);
+		check_data(out[i], 0, 0);
+	}
+	ffpp_mbuf_free_bulk(out, nb_outputs);
+	rte_pktmbuf_free(m);
+}
+
+static void test_deep_copy(struct rte_mempool *pool,
+			   struct rte_mempool *jumbo_pool)
+{
+	// A small packet and a large one in two segments.
+	struct rte_mbuf *src[2];
+	assert(rte_pktmbuf_alloc_bulk(pool, src, 2) == 0);
+	fill(src[0], 100, 1);
+	fill(src[1], 1500, 2);
+	struct rte_mbuf *tail = rte_pktmbuf_alloc(pool);
+	assert(tail != NULL);
+	fill(tail, 1500, 2 + 1500 % 256);
+	assert(rte_pktmbuf_chain(src[1], tail) == 0);
+	src[1]->port = 5;
+
+	struct rte_mbuf *dst[2];
+	assert(ffpp_mbuf_deep_copy_bulk(pool, src, dst, 2) == -EINVAL);
+	assert(ffpp_mbuf_deep_copy_bulk(jumbo_pool, src, dst, 2) == 0);
+	for (uint16_t i = 0; i < 2; ++i) {
+		assert(dst[i]->nb_segs == 1);
+		assert(rte_pktmbuf_pkt_len(dst[i]) ==
+		       rte_pktmbuf_pkt_len(src[i]));
+		check_data(dst[i], i + 1, 0);
+		assert(rte_pktmbuf_mtod(dst[i], uint8_t *) !=
+		       rte_pktmbuf_mtod(src[i], uint8_t *));
+	}
+	assert(dst[1]->port == 5);
+	ffpp_mbuf_free_bulk(src, 2);
+	ffpp_mbuf_free_bulk(dst, 2);
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	struct rte_mempool *pool_a =
+		ffpp_init_mempool("test_mbuf_a", 1023,
+				  RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	struct rte_mempool *pool_b = ffpp_init_mempool(
+		"test_mbuf_b", 1023, 4096 + RTE_PKTMBUF_HEADROOM,
+		rte_socket_id());
+	struct rte_mempool *indirect_pool = rte_pktmbuf_pool_create(
+		"test_mbuf_ind", 1023, 0, 0, 0, rte_socket_id());
+	assert(pool_a != NULL && pool_b != NULL && indirect_pool != NULL);
+
+	test_alloc_free(pool_a, pool_b);
+	test_fanout(pool_a, indirect_pool);
+	test_deep_copy(pool_a, pool_b);
+
+	assert(rte_mempool_in_use_count(pool_a) == 0);
+	assert(rte_mempool_in_use_count(pool_b) == 0);
+	assert(rte_mempool_in_use_count(indirect_pool) == 0);
+	rte_mempool_free(indirect_pool);
+	rte_mempool_free(pool_b);
+	rte_mempool_free(pool_a);
+	rte_eal_cleanup();
+	return 0;
+}
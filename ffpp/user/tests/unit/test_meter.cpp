@@ -0,0 +1,208 @@
+/*
+ * test_meter.cpp
+ *
+ * Police a burst of one flow with a small srTCM profile (green, marked yellow,
+ * dropped red), switch the flow to a large profile, and shape a burst with a
+ * trTCM profile and a small shaper queue.
+ */
+
+#include <cassert>
+#include <cstring>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_meter.h>
+#include <rte_udp.h>
+
+#include "ffpp/collections.h"
+#include "ffpp/memory.h"
+#include "ffpp/meter.h"
+
+static constexpr uint16_t nb_pkts = 64;
+static constexpr uint16_t frame_size = 64;
+static constexpr uint8_t yellow_dscp = 10;
+
+static void build_udp(struct rte_mbuf *m, bool is_ipv4)
+{
+	auto eth = reinterpret_cast<struct rte_ether_hdr *>(
+		rte_pktmbuf_append(m, frame_size));
+	assert(eth != NULL);
+	memset(eth, 0, frame_size);
+	if (!is_ipv4) {
+		eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_ARP);
+		return;
+	}
+	eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+	auto ip = reinterpret_cast<struct rte_ipv4_hdr *>(eth + 1);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->type_of_service = 0x01;
+	ip->total_length = rte_cpu_to_be_16(frame_size - RTE_ETHER_HDR_LEN);
+	ip->time_to_live = 64;
+	ip->next_proto_id = IPPROTO_UDP;
+	ip->src_addr = rte_cpu_to_be_32(RTE_IPV4(10, 0, 0, 1));
+	ip->dst_addr = rte_cpu_to_be_32(RTE_IPV4(10, 1, 0, 1));
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+	auto udp = reinterpret_cast<struct rte_udp_hdr *>(ip + 1);
+	udp->src_port = rte_cpu_to_be_16(1000);
+	udp->dst_port = rte_cpu_to_be_16(80);
+}
+
+// The last packet is not IPv4 and not metered.
+static void alloc_burst(struct rte_mempool *pool, struct rte_mbuf **pkts)
+{
+	assert(rte_pktmbuf_alloc_bulk(pool, pkts, nb_pkts) == 0);
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		build_udp(pkts[i], i != nb_pkts - 1);
+	}
+}
+
+static void test_police(struct rte_mempool *pool, struct ffpp_mvec *vec)
+{
+	struct rte_mbuf *pkts[nb_pkts];
+	alloc_burst(pool, pkts);
+	ffpp_mvec_set_mbufs(vec, pkts, nb_pkts);
+
+	struct ffpp_meter_config cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	strcpy(cfg.name, "test_police");
+	cfg.socket_id = rte_socket_id();
+	cfg.nb_parts = 1;
+	cfg.max_flows = 1024;
+	cfg.algo = FFPP_METER_SRTCM;
+	assert(ffpp_meter_create(&cfg) == NULL);
+	// 10 packets of committed and 10 of excess burst, nearly no refill.
+	cfg.nb_profiles = 2;
+	cfg.srtcm[0] = { 1, 10 * frame_size, 10 * frame_size };
+	cfg.srtcm[1] = { 1000 * 1000 * 1000, 1 << 20, 1 << 20 };
+	cfg.actions[RTE_COLOR_YELLOW] = FFPP_METER_MARK;
+	cfg.actions[RTE_COLOR_RED] = FFPP_METER_DROP;
+	cfg.dscp[RTE_COLOR_YELLOW] = yellow_dscp;
+	struct ffpp_meter *mtr = ffpp_meter_create(&cfg);
+	assert(mtr != NULL);
+
+	uint8_t colors[nb_pkts];
+	uint16_t nb_keep = ffpp_meter_police(mtr, 0, vec, colors);
+	assert(nb_keep == 10 + 10 + 1);
+	for (uint16_t i = 0; i < nb_keep; ++i) {
+		auto ip = rte_pktmbuf_mtod_offset(vec->head[i],
+						  struct rte_ipv4_hdr *,
+						  RTE_ETHER_HDR_LEN);
+		if (i < 10) {
+			assert(colors[i] == RTE_COLOR_GREEN);
+			assert(ip->type_of_service == 0x01);
+		} else if (i < 20) {
+			assert(colors[i] == RTE_COLOR_YELLOW);
+			assert(ip->type_of_service ==
+			       ((yellow_dscp << 2) | 0x01));
+			uint16_t cksum = ip->hdr_checksum;
+			ip->hdr_checksum = 0;
+			assert(rte_ipv4_cksum(ip) == cksum);
+		} else {
+			// The untracked packet keeps its position after the
+			// metered ones.
+			assert(colors[i] == RTE_COLOR_GREEN);
+			assert(vec->head[i] == pkts[nb_pkts - 1]);
+		}
+	}
+
+	struct ffpp_meter_stats stats;
+	ffpp_meter_get_stats(mtr, 0, &stats);
+	assert(stats.colors[RTE_COLOR_GREEN] == 10);
+	assert(stats.colors[RTE_COLOR_YELLOW] == 10);
+	assert(stats.colors[RTE_COLOR_RED] == nb_pkts - 21);
+	assert(stats.dropped == nb_pkts - 21);
+	assert(stats.untracked == 1);
+	assert(stats.nb_flows == 1);
+
+	struct ffpp_cls_5tuple key;
+	memset(&key, 0, sizeof(key));
+	assert(ffpp_cls_5tuple_of(pkts[0], &key) == 0);
+	assert(ffpp_meter_set_flow_profile(mtr, 0, &key, 2) == -EINVAL);
+	assert(ffpp_meter_set_flow_profile(mtr, 0, &key, 1) == 0);
+	assert(ffpp_meter_police(mtr, 0, vec, colors) == nb_pkts);
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		assert(colors[i] == RTE_COLOR_GREEN);
+	}
+
+	ffpp_meter_free(mtr);
+	rte_pktmbuf_free_bulk(pkts, nb_pkts);
+}
+
+static void test_shape(struct rte_mempool *pool, struct ffpp_mvec *vec)
+{
+	struct rte_mbuf *pkts[nb_pkts];
+	alloc_burst(pool, pkts);
+	ffpp_mvec_set_mbufs(vec, pkts, nb_pkts);
+
+	struct ffpp_meter_config cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	strcpy(cfg.name, "test_shape");
+	cfg.socket_id = rte_socket_id();
+	cfg.nb_parts = 1;
+	cfg.max_flows = 1024;
+	cfg.algo = FFPP_METER_TRTCM;
+	cfg.nb_profiles = 1;
+	// 100 packets per second, a burst of 10.5 packets passes at once.
+	cfg.trtcm[0] = { 100 * frame_size, 200 * frame_size,
+			 10 * frame_size + frame_size / 2, 20 * frame_size };
+	cfg.shaper_queue_size = 40;
+	struct ffpp_meter *mtr = ffpp_meter_create(&cfg);
+	assert(mtr != NULL);
+
+	uint16_t nb_keep = ffpp_meter_shape(mtr, 0, vec);
+	assert(nb_keep == 10 + 1);
+	assert(vec->len == nb_keep);
+	for (uint16_t i = 0; i < 10; ++i) {
+		assert(vec->head[i] == pkts[i]);
+	}
+	assert(vec->head[10] == pkts[nb_pkts - 1]);
+
+	struct ffpp_meter_stats stats;
+	ffpp_meter_get_stats(mtr, 0, &stats);
+	assert(stats.shaped == 40);
+	assert(stats.shaper_drops == nb_pkts - 1 - 10 - 40);
+	assert(stats.shaper_backlog == 40);
+
+	// The first delayed packet is due after 5 ms, then one every 10 ms.
+	struct rte_mbuf *out[nb_pkts];
+	assert(ffpp_meter_shaper_dequeue(mtr, 0, out, nb_pkts) == 0);
+	rte_delay_ms(500);
+	assert(ffpp_meter_shaper_dequeue(mtr, 0, out, 20) == 20);
+	for (uint16_t i = 0; i < 20; ++i) {
+		assert(out[i] == pkts[10 + i]);
+	}
+	ffpp_meter_get_stats(mtr, 0, &stats);
+	assert(stats.shaper_backlog == 20);
+
+	// The remaining delayed packets are freed with the meter.
+	ffpp_meter_free(mtr);
+	rte_pktmbuf_free_bulk(vec->head, nb_keep);
+	rte_pktmbuf_free_bulk(out, 20);
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	struct rte_mempool *pool =
+		ffpp_init_mempool("test_meter", 1023, RTE_MBUF_DEFAULT_BUF_SIZE,
+				  rte_socket_id());
+	assert(pool != NULL);
+	struct ffpp_mvec vec;
+	ffpp_mvec_init(&vec, nb_pkts);
+
+	test_police(pool, &vec);
+	assert(rte_mempool_in_use_count(pool) == 0);
+	test_shape(pool, &vec);
+	assert(rte_mempool_in_use_count(pool) == 0);
+
+	ffpp_mvec_free(&vec);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
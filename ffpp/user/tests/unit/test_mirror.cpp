@@ -0,0 +1,171 @@
+/*
+ * test_mirror.cpp
+ *
+ * Mirror a vector to targets with deterministic and random sampling, a flow
+ * filter, a rate limit and a small ring, and check that the original packets
+ * are not changed and all clones are returned.
+ */
+
+#include <cassert>
+#include <cstring>
+
+#include <rte_eal.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_ring.h>
+#include <rte_udp.h>
+
+#include "ffpp/collections.h"
+#include "ffpp/memory.h"
+#include "ffpp/mirror.h"
+
+static constexpr uint16_t nb_pkts = 100;
+static constexpr uint16_t nb_flows = 10;
+static constexpr uint16_t frame_size = 64;
+
+enum target_idx { T_EVERY_4TH, T_FLOW, T_RATE, T_SMALL_RING };
+
+static void build_udp(struct rte_mbuf *m, uint16_t i)
+{
+	auto eth = reinterpret_cast<struct rte_ether_hdr *>(
+		rte_pktmbuf_append(m, frame_size));
+	assert(eth != NULL);
+	memset(eth, 0, frame_size);
+	eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+	auto ip = reinterpret_cast<struct rte_ipv4_hdr *>(eth + 1);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->next_proto_id = IPPROTO_UDP;
+	ip->src_addr = rte_cpu_to_be_32(RTE_IPV4(10, 0, 0, i % nb_flows));
+	ip->dst_addr = rte_cpu_to_be_32(RTE_IPV4(10, 1, 0, 1));
+	auto udp = reinterpret_cast<struct rte_udp_hdr *>(ip + 1);
+	udp->src_port = rte_cpu_to_be_16(1000);
+	udp->dst_port = rte_cpu_to_be_16(80);
+}
+
+// Dequeue and free all clones of a ring, check that they share the data.
+static unsigned int drain(struct rte_ring *ring)
+{
+	struct rte_mbuf *clones[nb_pkts];
+	unsigned int n = rte_ring_dequeue_burst(
+		ring, reinterpret_cast<void **>(clones), nb_pkts, NULL);
+	for (unsigned int i = 0; i < n; ++i) {
+		assert(RTE_MBUF_CLONED(clones[i]));
+		assert(rte_pktmbuf_data_len(clones[i]) == frame_size);
+	}
+	rte_pktmbuf_free_bulk(clones, n);
+	return n;
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	struct rte_mempool *pool =
+		ffpp_init_mempool("test_mirror", 1023, RTE_MBUF_DEFAULT_BUF_SIZE,
+				  rte_socket_id());
+	assert(pool != NULL);
+	struct rte_mempool *clone_pool = rte_pktmbuf_pool_create(
+		"test_mirror_clones", 1023, 0, 0, 0, rte_socket_id());
+	assert(clone_pool != NULL);
+
+	struct rte_mbuf *pkts[nb_pkts];
+	assert(rte_pktmbuf_alloc_bulk(pool, pkts, nb_pkts) == 0);
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		build_udp(pkts[i], i);
+	}
+	struct ffpp_mvec vec;
+	ffpp_mvec_init(&vec, nb_pkts);
+	ffpp_mvec_set_mbufs(&vec, pkts, nb_pkts);
+
+	struct rte_ring *rings[FFPP_MIRROR_TARGETS_MAX];
+	const char *names[] = { "mirror_0", "mirror_1", "mirror_2",
+				"mirror_3" };
+	for (uint16_t i = 0; i < FFPP_MIRROR_TARGETS_MAX; ++i) {
+		unsigned int size = i == T_SMALL_RING ? 16 : 256;
+		rings[i] = rte_ring_create(names[i], size, rte_socket_id(),
+					   RING_F_SP_ENQ | RING_F_SC_DEQ);
+		assert(rings[i] != NULL);
+	}
+
+	struct ffpp_mirror_config cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.socket_id = rte_socket_id();
+	assert(ffpp_mirror_create(&cfg) == NULL);
+	cfg.clone_pool = clone_pool;
+	cfg.nb_targets = FFPP_MIRROR_TARGETS_MAX;
+	for (uint16_t i = 0; i < FFPP_MIRROR_TARGETS_MAX; ++i) {
+		cfg.targets[i].ring = rings[i];
+	}
+	cfg.targets[T_EVERY_4TH].sample_n = 4;
+	cfg.targets[T_FLOW].match_flow = true;
+	assert(ffpp_cls_5tuple_of(pkts[7], &cfg.targets[T_FLOW].flow) == 0);
+	// The padding of the flow is ignored.
+	memset(cfg.targets[T_FLOW].flow.pad, 0xff,
+	       sizeof(cfg.targets[T_FLOW].flow.pad));
+	cfg.targets[T_RATE].rate_pps = 1;
+	cfg.targets[T_RATE].rate_burst = 5;
+	struct ffpp_mirror *mir = ffpp_mirror_create(&cfg);
+	assert(mir != NULL);
+
+	uint16_t nb_mirrored = ffpp_mirror_process(mir, &vec);
+	assert(nb_mirrored == 25 + nb_pkts / nb_flows + 5 + 15);
+	// Each packet is referenced by its clones, the data is not changed.
+	assert(rte_mbuf_refcnt_read(pkts[0]) == 1 + 1 + 1 + 1);
+	assert(rte_mbuf_refcnt_read(pkts[7]) == 1 + 1 + 1);
+	assert(rte_mbuf_refcnt_read(pkts[99]) == 1);
+
+	struct ffpp_mirror_stats stats;
+	ffpp_mirror_get_stats(mir, T_EVERY_4TH, &stats);
+	assert(stats.mirrored == 25);
+	ffpp_mirror_get_stats(mir, T_FLOW, &stats);
+	assert(stats.mirrored == nb_pkts / nb_flows);
+	ffpp_mirror_get_stats(mir, T_RATE, &stats);
+	assert(stats.mirrored == 5);
+	assert(stats.drop_rate_limit == nb_pkts - 5);
+	ffpp_mirror_get_stats(mir, T_SMALL_RING, &stats);
+	// A ring of size 16 holds 15 objects.
+	assert(stats.mirrored == 15);
+	assert(stats.drop_ring_full == nb_pkts - 15);
+	assert(stats.drop_no_mbuf == 0);
+
+	assert(drain(rings[T_EVERY_4TH]) == 25);
+	assert(drain(rings[T_FLOW]) == nb_pkts / nb_flows);
+	assert(drain(rings[T_RATE]) == 5);
+	assert(drain(rings[T_SMALL_RING]) == 15);
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		assert(rte_mbuf_refcnt_read(pkts[i]) == 1);
+	}
+	assert(rte_mempool_in_use_count(clone_pool) == 0);
+	ffpp_mirror_free(mir);
+
+	// Random sampling of about half of the packets.
+	memset(&cfg.targets, 0, sizeof(cfg.targets));
+	cfg.nb_targets = 1;
+	cfg.targets[0].ring = rings[0];
+	cfg.targets[0].sampling = FFPP_MIRROR_SAMPLE_RANDOM;
+	cfg.targets[0].sample_n = 2;
+	mir = ffpp_mirror_create(&cfg);
+	assert(mir != NULL);
+	unsigned int nb_random = 0;
+	for (int round = 0; round < 10; ++round) {
+		ffpp_mirror_process(mir, &vec);
+		nb_random += drain(rings[0]);
+	}
+	assert(nb_random > 300 && nb_random < 700);
+	ffpp_mirror_free(mir);
+
+	for (uint16_t i = 0; i < FFPP_MIRROR_TARGETS_MAX; ++i) {
+		rte_ring_free(rings[i]);
+	}
+	rte_pktmbuf_free_bulk(pkts, nb_pkts);
+	ffpp_mvec_free(&vec);
+	assert(rte_mempool_in_use_count(pool) == 0);
+	assert(rte_mempool_in_use_count(clone_pool) == 0);
+	rte_mempool_free(clone_pool);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
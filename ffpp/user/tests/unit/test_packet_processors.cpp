@@ -0,0 +1,189 @@
+/*
+ * test_packet_processors.cpp
+ *
+ * Compare the default (SIMD) burst processors with the scalar ones and the
+ * fused chains, and check the incrementally updated checksums.
+ */
+
+#include <cassert>
+#include <cstring>
+
+#include <rte_eal.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_udp.h>
+
+#include "ffpp/chain.h"
+#include "ffpp/chain.hpp"
+#include "ffpp/collections.h"
+#include "ffpp/memory.h"
+#include "ffpp/packet_processors.h"
+
+static constexpr uint16_t nb_pkts = 67;
+static constexpr uint16_t frame_size = 128;
+
+static struct rte_ipv4_hdr *ipv4_hdr_of(struct rte_mbuf *m)
+{
+	auto eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+	uint16_t off = sizeof(struct rte_ether_hdr);
+	if (eth->ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_VLAN)) {
+		off += sizeof(struct rte_vlan_hdr);
+	}
+	return rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, off);
+}
+
+static void build_udp(struct rte_mbuf *m, uint16_t i)
+{
+	auto p = reinterpret_cast<uint8_t *>(rte_pktmbuf_append(m, frame_size));
+	assert(p != NULL);
+	for (uint16_t j = 0; j < frame_size; ++j) {
+		p[j] = i + j;
+	}
+	auto eth = reinterpret_cast<struct rte_ether_hdr *>(p);
+	eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+	auto ip = ipv4_hdr_of(m);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = rte_cpu_to_be_16(frame_size - RTE_ETHER_HDR_LEN);
+	ip->fragment_offset = 0;
+	// Some packets expire.
+	ip->time_to_live = i % 5;
+	ip->next_proto_id = IPPROTO_UDP;
+	ip->hdr_checksum = 0;
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+	auto udp = reinterpret_cast<struct rte_udp_hdr *>(ip + 1);
+	udp->dgram_len = rte_cpu_to_be_16(frame_size - RTE_ETHER_HDR_LEN -
+					  sizeof(struct rte_ipv4_hdr));
+	udp->dgram_cksum = 0;
+	udp->dgram_cksum = rte_ipv4_udptcp_cksum(ip, udp);
+}
+
+static void check_cksums(struct ffpp_mvec *vec, uint16_t len)
+{
+	for (uint16_t i = 0; i < len; ++i) {
+		auto ip = ipv4_hdr_of(vec->head[i]);
+		auto udp = reinterpret_cast<struct rte_udp_hdr *>(ip + 1);
+		uint16_t cksum = ip->hdr_checksum;
+		ip->hdr_checksum = 0;
+		assert(rte_ipv4_cksum(ip) == cksum);
+		ip->hdr_checksum = cksum;
+		cksum = udp->dgram_cksum;
+		udp->dgram_cksum = 0;
+		assert(rte_ipv4_udptcp_cksum(ip, udp) == cksum);
+		udp->dgram_cksum = cksum;
+	}
+}
+
+static void check_equal(struct ffpp_mvec *v1, struct ffpp_mvec *v2)
+{
+	assert(v1->len == v2->len);
+	for (uint16_t i = 0; i < v1->len; ++i) {
+		assert(v1->head[i]->data_len == v2->head[i]->data_len);
+		assert(memcmp(rte_pktmbuf_mtod(v1->head[i], void *),
+			      rte_pktmbuf_mtod(v2->head[i], void *),
+			      v1->head[i]->data_len) == 0);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	struct rte_mempool *pool =
+		ffpp_init_mempool("test_pp", 1023, RTE_MBUF_DEFAULT_BUF_SIZE,
+				  rte_socket_id());
+	assert(pool != NULL);
+
+	struct rte_mbuf *pkts[2][nb_pkts];
+	struct ffpp_mvec vec[2];
+	for (int k = 0; k < 2; ++k) {
+		assert(rte_pktmbuf_alloc_bulk(pool, pkts[k], nb_pkts) == 0);
+		for (uint16_t i = 0; i < nb_pkts; ++i) {
+			build_udp(pkts[k][i], i);
+		}
+		ffpp_mvec_init(&vec[k], nb_pkts);
+		ffpp_mvec_set_mbufs(&vec[k], pkts[k], nb_pkts);
+	}
+
+	struct rte_ether_addr src = { { 0x02, 0, 0, 0, 0, 0x01 } };
+	struct rte_ether_addr dst = { { 0x02, 0, 0, 0, 0, 0x02 } };
+	ffpp_pp_update_dl_dst(&vec[0], &dst);
+	auto eth = rte_pktmbuf_mtod(vec[0].head[0], struct rte_ether_hdr *);
+	assert(rte_is_same_ether_addr(&eth->d_addr, &dst));
+	ffpp_pp_rewrite_dl(&vec[0], &src, &dst);
+	ffpp_pp_rewrite_dl_scalar(&vec[1], &src, &dst);
+	check_equal(&vec[0], &vec[1]);
+	ffpp_pp_swap_dl(&vec[0]);
+	ffpp_pp_swap_dl_scalar(&vec[1]);
+	check_equal(&vec[0], &vec[1]);
+	assert(rte_is_same_ether_addr(&eth->s_addr, &dst));
+
+	assert(ffpp_pp_vlan_push(&vec[0], 42) == nb_pkts);
+	assert(ffpp_pp_vlan_push_scalar(&vec[1], 42) == nb_pkts);
+	check_equal(&vec[0], &vec[1]);
+	check_cksums(&vec[0], nb_pkts);
+
+	uint16_t nb_keep = ffpp_pp_dec_ttl(&vec[0]);
+	assert(ffpp_pp_dec_ttl_scalar(&vec[1]) == nb_keep);
+	// TTL 0 and 1 expire.
+	assert(nb_keep == nb_pkts - (nb_pkts + 4) / 5 - (nb_pkts + 3) / 5);
+	check_equal(&vec[0], &vec[1]);
+	check_cksums(&vec[0], nb_pkts);
+
+	ffpp_pp_mark_dscp(&vec[0], 46);
+	ffpp_pp_mark_dscp_scalar(&vec[1], 46);
+	check_equal(&vec[0], &vec[1]);
+	check_cksums(&vec[0], nb_pkts);
+
+	assert(ffpp_pp_vlan_pop(&vec[0]) == nb_pkts);
+	assert(ffpp_pp_vlan_pop_scalar(&vec[1]) == nb_pkts);
+	assert(vec[0].head[0]->vlan_tci == 42);
+	check_equal(&vec[0], &vec[1]);
+
+	struct ffpp_pp_nat nat = {
+		.src_addr = rte_cpu_to_be_32(RTE_IPV4(10, 0, 0, 1)),
+		.dst_addr = rte_cpu_to_be_32(RTE_IPV4(192, 168, 0, 1)),
+		.src_port = rte_cpu_to_be_16(1234),
+		.dst_port = rte_cpu_to_be_16(80),
+		.flags = FFPP_PP_NAT_SRC_ADDR | FFPP_PP_NAT_DST_ADDR |
+			 FFPP_PP_NAT_SRC_PORT | FFPP_PP_NAT_DST_PORT,
+	};
+	ffpp_pp_nat_rewrite(&vec[0], &nat);
+	assert(ipv4_hdr_of(vec[0].head[0])->dst_addr == nat.dst_addr);
+	check_cksums(&vec[0], nb_pkts);
+
+	// Fused chain, sequential chain and separate processors.
+	for (int k = 0; k < 2; ++k) {
+		for (uint16_t i = 0; i < nb_pkts; ++i) {
+			rte_pktmbuf_reset(pkts[k][i]);
+			build_udp(pkts[k][i], i);
+		}
+		ffpp_mvec_set_mbufs(&vec[k], pkts[k], nb_pkts);
+	}
+	struct ffpp_chain_mac_args mac_args = { src, dst };
+	nb_keep = ffpp_chain_l3fwd(&vec[0], &mac_args);
+	assert(ffpp_pp_dec_ttl_scalar(&vec[1]) == nb_keep);
+	vec[1].len = nb_keep;
+	ffpp_pp_rewrite_dl_scalar(&vec[1], &src, &dst);
+	vec[1].len = nb_pkts;
+	check_equal(&vec[0], &vec[1]);
+	check_cksums(&vec[0], nb_pkts);
+
+	ffpp::chain<ffpp::MarkDscp, ffpp::SwapMac, ffpp::Ipv4Cksum> c(
+		ffpp::MarkDscp(10), ffpp::SwapMac(), ffpp::Ipv4Cksum());
+	assert(c(&vec[0]) == nb_pkts);
+	assert(c.run_sequential(&vec[1]) == nb_pkts);
+	check_equal(&vec[0], &vec[1]);
+	check_cksums(&vec[0], nb_pkts);
+
+	for (int k = 0; k < 2; ++k) {
+		rte_pktmbuf_free_bulk(pkts[k], nb_pkts);
+		ffpp_mvec_free(&vec[k]);
+	}
+	assert(rte_mempool_in_use_count(pool) == 0);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
@@ -0,0 +1,76 @@
+/*
+ * test_pcap.cpp
+ *
+ * Test the mmap'd PCAP reader and the ring-based PCAP writer.
+ */
+
+#include <cassert>
+
+#include <rte_eal.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+#include "ffpp/memory.h"
+#include "ffpp/pcap.h"
+#include "ffpp/utils.h"
+
+static const char *test_pcap_path = "/ffpp/user/tests/data/udp_3pkts.pcap";
+static const char *test_capture_path = "/tmp/test_pcap_capture.pcap";
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	struct rte_mempool *pool = ffpp_init_mempool(
+		"test_pcap", 1023, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	assert(pool != NULL);
+
+	struct ffpp_pcap_reader reader;
+	int ret = ffpp_pcap_reader_open(&reader, test_pcap_path);
+	assert(ret == 0);
+	assert(reader.format == FFPP_PCAP_FORMAT_PCAP);
+
+	struct rte_mbuf *pkts[8];
+	uint64_t ts[8];
+	uint16_t nb = ffpp_pcap_reader_read_burst(&reader, pool, pkts, ts, 8);
+	assert(nb == 3);
+	assert(ffpp_pcap_reader_eof(&reader));
+	assert(ts[0] <= ts[1] && ts[1] <= ts[2]);
+	// Unused mbufs must go back to the pool.
+	assert(rte_mempool_in_use_count(pool) == 3);
+
+	// Capture the packets and read them back.
+	struct ffpp_pcap_writer writer;
+	ret = ffpp_pcap_writer_open(&writer, test_capture_path, 64, 0);
+	assert(ret == 0);
+	assert(ffpp_pcap_writer_enqueue(&writer, pkts, nb) == 3);
+	assert(ffpp_pcap_writer_drain(&writer) == 3);
+	ffpp_pcap_writer_close(&writer);
+	assert(writer.nb_written == 3);
+	assert(rte_mempool_in_use_count(pool) == 0);
+
+	struct ffpp_pcap_reader capture;
+	ret = ffpp_pcap_reader_open(&capture, test_capture_path);
+	assert(ret == 0);
+	struct rte_mbuf *pkts_captured[8];
+	ffpp_pcap_reader_rewind(&reader);
+	nb = ffpp_pcap_reader_read_burst(&reader, pool, pkts, NULL, 8);
+	assert(nb == 3);
+	nb = ffpp_pcap_reader_read_burst(&capture, pool, pkts_captured, NULL,
+					 8);
+	assert(nb == 3);
+	for (uint16_t i = 0; i < nb; ++i) {
+		assert(pkts[i]->pkt_len == pkts_captured[i]->pkt_len);
+		assert(mbuf_datacmp(pkts[i], pkts_captured[i]) == 0);
+	}
+	rte_pktmbuf_free_bulk(pkts, nb);
+	rte_pktmbuf_free_bulk(pkts_captured, nb);
+
+	ffpp_pcap_reader_close(&capture);
+	ffpp_pcap_reader_close(&reader);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
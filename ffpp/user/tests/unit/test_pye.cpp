@@ -0,0 +1,322 @@
+/*
+ * test_pye.cpp
+ *
+ * Process vectors of packets with the APU handlers in tests/data/test_pye.py:
+ * modify, truncate, extend and drop packets, and check the errors. Then
+ * process them with a pool of worker processes, with more packets than slots.
+ */
+
+// Python.h (included by pye.h) must be included before the system headers.
+#include "ffpp/pye.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <rte_eal.h>
+#include <rte_errno.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+#include "ffpp/collections.h"
+#include "ffpp/memory.h"
+
+static const char *test_py_path = "/ffpp/user/tests/data";
+
+// More than FFPP_PYE_BATCH_MAX, so the handler is called several times.
+static constexpr uint16_t nb_pkts = 300;
+static constexpr uint16_t offset = 42;
+static constexpr uint16_t payload_len = 20;
+
+static void build_pkts(struct rte_mempool *pool, struct ffpp_mvec *vec)
+{
+	struct rte_mbuf *pkts[nb_pkts];
+	assert(rte_pktmbuf_alloc_bulk(pool, pkts, nb_pkts) == 0);
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		auto data = reinterpret_cast<uint8_t *>(
+			rte_pktmbuf_append(pkts[i], offset + payload_len));
+		assert(data != NULL);
+		memset(data, 0xff, offset);
+		for (uint16_t j = 0; j < payload_len; ++j) {
+			data[offset + j] = static_cast<uint8_t>(i + j);
+		}
+		if (i % 3 == 0) {
+			memcpy(data + offset, "drop", 4);
+		}
+	}
+	// Shorter than the offset, it gets an empty view.
+	rte_pktmbuf_trim(pkts[nb_pkts - 1], payload_len + 1);
+	ffpp_mvec_set_mbufs(vec, pkts, nb_pkts);
+}
+
+static void test_errors(struct rte_mempool *pool, struct ffpp_mvec *vec)
+{
+	assert(ffpp_pye_set_apu_handler("test_pye", "apu_echo") == -EPERM);
+	assert(ffpp_pye_process_apu(vec, offset) == -ENOENT);
+	assert(ffpp_pye_init("test_pye", test_py_path) == 0);
+	assert(ffpp_pye_init("test_pye", test_py_path) == -EALREADY);
+	assert(ffpp_pye_process_apu(vec, offset) == 0);
+
+	build_pkts(pool, vec);
+	assert(ffpp_pye_process_apu(vec, offset) == -ENOENT);
+	assert(ffpp_pye_set_apu_handler("no_such_module", "f") == -ENOENT);
+	assert(ffpp_pye_set_apu_handler("test_pye", "no_such_func") ==
+	       -ENOENT);
+	assert(ffpp_pye_set_apu_handler("test_pye", "os") == -EINVAL);
+
+	// The packets stay unchanged if the handler fails.
+	assert(ffpp_pye_set_apu_handler("test_pye", "apu_raise") == 0);
+	assert(ffpp_pye_process_apu(vec, offset) == -EIO);
+	assert(vec->len == nb_pkts);
+	for (uint16_t i = 0; i < nb_pkts - 1; ++i) {
+		assert(rte_pktmbuf_data_len(vec->head[i]) ==
+		       offset + payload_len);
+	}
+	// The payloads must not be exported after the call.
+	assert(ffpp_pye_set_apu_handler("test_pye", "apu_keep_export") == 0);
+	assert(ffpp_pye_process_apu(vec, offset) == -EIO);
+	assert(vec->len == nb_pkts);
+}
+
+static void test_echo(struct ffpp_mvec *vec)
+{
+	struct rte_mbuf *pkts[nb_pkts];
+	memcpy(pkts, vec->head, sizeof(pkts));
+
+	assert(ffpp_pye_set_apu_handler("test_pye", "apu_echo") == 0);
+	uint16_t nb_kept = nb_pkts - (nb_pkts + 2) / 3;
+	assert(ffpp_pye_process_apu(vec, offset) == nb_kept);
+	assert(vec->len == nb_kept);
+	uint16_t k = 0;
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		if (i % 3 == 0) {
+			continue;
+		}
+		auto m = vec->head[k++];
+		assert(m == pkts[i]);
+		if (i == nb_pkts - 1) {
+			assert(rte_pktmbuf_data_len(m) == offset - 1);
+			continue;
+		}
+		auto data = rte_pktmbuf_mtod(m, uint8_t *);
+		assert(rte_pktmbuf_data_len(m) == offset + 8);
+		assert(rte_pktmbuf_pkt_len(m) == offset + 8);
+		assert(data[0] == 0xff && data[offset - 1] == 0xff);
+		assert(data[offset] == static_cast<uint8_t>(i + 1));
+		assert(data[offset + 1] == static_cast<uint8_t>(i + 1));
+	}
+}
+
+static void test_verdicts(struct ffpp_mvec *vec)
+{
+	struct rte_mbuf *pkts[nb_pkts];
+	uint16_t n = vec->len;
+	memcpy(pkts, vec->head, n * sizeof(pkts[0]));
+
+	assert(ffpp_pye_set_apu_handler("test_pye", "apu_verdicts") == 0);
+	assert(ffpp_pye_process_apu(vec, offset) == (n + 1) / 2);
+	for (uint16_t i = 0; i < vec->len; ++i) {
+		assert(vec->head[i] == pkts[2 * i]);
+	}
+}
+
+static void test_numpy(struct ffpp_mvec *vec)
+{
+	uint16_t n = vec->len;
+
+	assert(ffpp_pye_set_apu_handler("test_pye", "apu_numpy") == 0);
+	assert(ffpp_pye_process_apu(vec, offset) == n);
+	for (uint16_t i = 0; i < n; ++i) {
+		auto m = vec->head[i];
+		if (rte_pktmbuf_data_len(m) < offset) {
+			continue;
+		}
+		assert(rte_pktmbuf_data_len(m) == offset + 8 + 4);
+		auto idx = rte_pktmbuf_mtod_offset(m, uint8_t *, offset + 8);
+		assert(idx[0] == 0 && idx[1] == 0);
+		assert(idx[2] == (i >> 8) && idx[3] == (i & 0xff));
+	}
+}
+
+static struct ffpp_pye_pool *create_pool(const char *func_name,
+					 const cpu_set_t *cpuset = nullptr)
+{
+	struct ffpp_pye_pool_config cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	strcpy(cfg.name, "test_pye_pool");
+	cfg.socket_id = rte_socket_id();
+	cfg.nb_workers = 3;
+	cfg.nb_slots = 8;
+	cfg.batch_size = 16;
+	cfg.offset = offset;
+	cfg.module_name = "test_pye";
+	cfg.func_name = func_name;
+	cfg.cpuset = cpuset;
+
+	struct ffpp_pye_pool_config bad = cfg;
+	bad.nb_workers = 0;
+	assert(ffpp_pye_pool_create(&bad) == NULL && rte_errno == EINVAL);
+	bad = cfg;
+	bad.batch_size = FFPP_PYE_BATCH_MAX + 1;
+	assert(ffpp_pye_pool_create(&bad) == NULL && rte_errno == EINVAL);
+	bad = cfg;
+	bad.func_name = "no_such_func";
+	assert(ffpp_pye_pool_create(&bad) == NULL && rte_errno == ENOENT);
+	cpu_set_t empty;
+	CPU_ZERO(&empty);
+	bad = cfg;
+	bad.cpuset = &empty;
+	assert(ffpp_pye_pool_create(&bad) == NULL && rte_errno == EINVAL);
+
+	return ffpp_pye_pool_create(&cfg);
+}
+
+// Submit and collect until all packets of vec are collected in out.
+static void run_pool(struct ffpp_pye_pool *pool, struct ffpp_mvec *vec,
+		     struct ffpp_mvec *out)
+{
+	struct ffpp_pye_pool_stats stats;
+	do {
+		ffpp_pye_pool_submit(pool, vec);
+		ffpp_pye_pool_get_stats(pool, &stats);
+		assert(stats.outstanding <= 8);
+		ffpp_pye_pool_collect(pool, out);
+		ffpp_pye_pool_get_stats(pool, &stats);
+	} while (vec->len > 0 || stats.outstanding > 0);
+}
+
+static void test_pool(struct rte_mempool *pool, struct ffpp_mvec *vec,
+		      struct ffpp_mvec *out)
+{
+	struct rte_mbuf *pkts[nb_pkts];
+	build_pkts(pool, vec);
+	memcpy(pkts, vec->head, sizeof(pkts));
+
+	struct ffpp_pye_pool *p = create_pool("apu_pid");
+	assert(p != NULL);
+	pid_t pids[3];
+	for (uint16_t i = 0; i < 3; ++i) {
+		pids[i] = ffpp_pye_pool_get_worker_pid(p, i);
+		assert(pids[i] > 0 && pids[i] != getpid());
+	}
+	assert(ffpp_pye_pool_get_worker_pid(p, 3) == 0);
+
+	// All slots are outstanding, the other packets stay in vec.
+	assert(ffpp_pye_pool_submit(p, vec) == 8 * 16);
+	assert(vec->len == nb_pkts - 8 * 16);
+	run_pool(p, vec, out);
+
+	struct ffpp_pye_pool_stats stats;
+	ffpp_pye_pool_get_stats(p, &stats);
+	uint16_t nb_kept = nb_pkts - (nb_pkts + 2) / 3;
+	assert(stats.submitted == nb_pkts);
+	assert(stats.batches == (nb_pkts + 15) / 16);
+	assert(stats.kept == nb_kept && out->len == nb_kept);
+	assert(stats.dropped == nb_pkts - nb_kept && stats.failed == 0);
+
+	// The order is kept, each payload was replaced by one of the workers.
+	uint16_t k = 0;
+	for (uint16_t i = 0; i < nb_pkts; ++i) {
+		if (i % 3 == 0) {
+			continue;
+		}
+		auto m = out->head[k++];
+		assert(m == pkts[i]);
+		if (i == nb_pkts - 1) {
+			assert(rte_pktmbuf_data_len(m) == offset - 1);
+			continue;
+		}
+		assert(rte_pktmbuf_data_len(m) == offset + 4);
+		auto data = rte_pktmbuf_mtod_offset(m, uint8_t *, offset);
+		pid_t pid = (data[0] << 24) | (data[1] << 16) |
+			    (data[2] << 8) | data[3];
+		assert(pid == pids[0] || pid == pids[1] || pid == pids[2]);
+	}
+
+	// The batches of a dead worker fail, the others get its packets.
+	assert(kill(pids[0], SIGKILL) == 0);
+	while (ffpp_pye_pool_get_worker_pid(p, 0) != 0) {
+		ffpp_pye_pool_collect(p, out);
+	}
+	ffpp_mvec_set_mbufs(vec, out->head, out->len);
+	out->len = 0;
+	run_pool(p, vec, out);
+	ffpp_pye_pool_get_stats(p, &stats);
+	assert(stats.kept == 2 * nb_kept && out->len == nb_kept);
+	assert(stats.failed == 0);
+	for (uint16_t i = 0; i < nb_kept - 1; ++i) {
+		auto data = rte_pktmbuf_mtod_offset(out->head[i], uint8_t *,
+						    offset);
+		pid_t pid = (data[0] << 24) | (data[1] << 16) |
+			    (data[2] << 8) | data[3];
+		assert(pid == pids[1] || pid == pids[2]);
+	}
+
+	// The workers are stopped and reaped.
+	ffpp_pye_pool_free(p);
+	for (uint16_t i = 0; i < 3; ++i) {
+		assert(kill(pids[i], 0) == -1 && errno == ESRCH);
+	}
+
+	// The packets of failed batches are collected unchanged. The workers
+	// run on the given CPUs, not on the one of the lcore.
+	cpu_set_t cpus, worker_cpus;
+	assert(sched_getaffinity(0, sizeof(cpus), &cpus) == 0);
+	p = create_pool("apu_raise", &cpus);
+	assert(p != NULL);
+	assert(sched_getaffinity(ffpp_pye_pool_get_worker_pid(p, 0),
+				 sizeof(worker_cpus), &worker_cpus) == 0);
+	assert(CPU_EQUAL(&cpus, &worker_cpus));
+	ffpp_mvec_set_mbufs(vec, out->head, out->len);
+	out->len = 0;
+	run_pool(p, vec, out);
+	ffpp_pye_pool_get_stats(p, &stats);
+	assert(stats.failed == nb_kept && out->len == nb_kept);
+	assert(rte_pktmbuf_data_len(out->head[0]) == offset + 4);
+
+	// The packets of outstanding batches are freed with the pool.
+	ffpp_mvec_set_mbufs(vec, out->head, out->len);
+	out->len = 0;
+	assert(ffpp_pye_pool_submit(p, vec) == 8 * 16);
+	ffpp_pye_pool_free(p);
+	ffpp_mvec_free_mbufs(vec);
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	struct rte_mempool *pool =
+		ffpp_init_mempool("test_pye", 1023, RTE_MBUF_DEFAULT_BUF_SIZE,
+				  rte_socket_id());
+	assert(pool != NULL);
+	struct ffpp_mvec vec;
+	struct ffpp_mvec out;
+	ffpp_mvec_init(&vec, nb_pkts);
+	ffpp_mvec_init(&out, nb_pkts);
+
+	test_errors(pool, &vec);
+	test_echo(&vec);
+	test_verdicts(&vec);
+	test_numpy(&vec);
+
+	ffpp_mvec_free_mbufs(&vec);
+	assert(rte_mempool_in_use_count(pool) == 0);
+
+	test_pool(pool, &vec, &out);
+	assert(rte_mempool_in_use_count(pool) == 0);
+	ffpp_pye_cleanup();
+
+	ffpp_mvec_free(&vec);
+	ffpp_mvec_free(&out);
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
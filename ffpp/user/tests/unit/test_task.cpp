@@ -0,0 +1,123 @@
+/*
+ * test_task.cpp
+ *
+ * Test the worker runtime with two null ports in run-to-completion, pipeline
+ * and work-stealing mode.
+ */
+
+#include <cassert>
+#include <cstring>
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+#include "ffpp/collections.h"
+#include "ffpp/cycle_stats.h"
+#include "ffpp/device.h"
+#include "ffpp/memory.h"
+#include "ffpp/task.h"
+
+static uint16_t drop_half(struct ffpp_mvec *vec, void *arg)
+{
+	(void)arg;
+	return vec->len / 2;
+}
+
+static uint16_t keep_all(struct ffpp_mvec *vec, void *arg)
+{
+	(void)arg;
+	return vec->len;
+}
+
+static void run_and_check(struct ffpp_worker_config *cfg,
+			  struct rte_mempool *pool)
+{
+	struct ffpp_worker_runtime *rt = ffpp_workers_create(cfg);
+	assert(rt != NULL);
+	assert(ffpp_workers_launch(rt) == 0);
+	rte_delay_ms(100);
+	ffpp_workers_stop(rt);
+	ffpp_workers_wait(rt);
+
+	struct ffpp_worker_stats total;
+	ffpp_workers_get_stats(rt, &total);
+	ffpp_workers_print_stats(rt);
+	assert(total.rx_pkts > 0);
+	assert(total.nf_dropped > 0);
+	assert(total.rx_pkts == total.tx_pkts + total.tx_dropped +
+					total.nf_dropped + total.ring_dropped);
+	// All mbufs are either transmitted or freed after a graceful stop.
+	assert(rte_mempool_in_use_count(pool) == 0);
+
+	struct ffpp_cycle_stats *cs = ffpp_cycle_stats_attach();
+	assert(cs != NULL);
+	unsigned int lcore_id;
+	RTE_LCORE_FOREACH_WORKER(lcore_id)
+	{
+		struct ffpp_lcore_cycles snap;
+		ffpp_cycle_stats_read(cs, lcore_id, &snap);
+		assert(snap.active == 0);
+		assert(snap.busy_polls > 0);
+		assert(snap.proc_cycles > 0);
+	}
+	ffpp_workers_destroy(rt);
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+	assert(rte_lcore_count() >= 3);
+
+	struct rte_mempool *pool = ffpp_init_mempool(
+		"test_task", 8191, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	assert(pool != NULL);
+
+	for (uint16_t port_id = 0; port_id < 2; ++port_id) {
+		struct ffpp_dpdk_device_config dev_cfg;
+		memset(&dev_cfg, 0, sizeof(dev_cfg));
+		dev_cfg.port_id = port_id;
+		dev_cfg.pool = &pool;
+		dev_cfg.rx_queues = 2;
+		dev_cfg.tx_queues = 2;
+		dev_cfg.rx_descs = 512;
+		dev_cfg.tx_descs = 512;
+		dev_cfg.disable_offloads = 1;
+		ffpp_dpdk_init_device(&dev_cfg);
+	}
+
+	struct ffpp_worker_config cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.mode = FFPP_WORKER_MODE_RTC;
+	cfg.nb_ports = 2;
+	cfg.port_ids[0] = 0;
+	cfg.port_ids[1] = 1;
+	cfg.tx_port_map[0] = 1;
+	cfg.tx_port_map[1] = 0;
+	cfg.nb_rx_queues = 2;
+	cfg.nb_tx_queues = 2;
+	cfg.nb_stages = 2;
+	cfg.handlers[0] = keep_all;
+	cfg.handlers[1] = drop_half;
+
+	// Each worker needs its own TX queue.
+	cfg.nb_tx_queues = 1;
+	assert(ffpp_workers_create(&cfg) == NULL);
+	cfg.nb_tx_queues = 2;
+
+	run_and_check(&cfg, pool);
+
+	cfg.mode = FFPP_WORKER_MODE_PIPELINE;
+	run_and_check(&cfg, pool);
+
+	cfg.mode = FFPP_WORKER_MODE_STEAL;
+	run_and_check(&cfg, pool);
+
+	ffpp_dpdk_cleanup_devices();
+	rte_mempool_free(pool);
+	rte_eal_cleanup();
+	return 0;
+}
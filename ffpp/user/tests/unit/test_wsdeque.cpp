@@ -0,0 +1,151 @@
+/*
+ * test_wsdeque.cpp
+ *
+ * Check the LIFO order of the owner and the FIFO order of the thieves, then
+ * let the owner race two thieves and check that every item is taken once.
+ */
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <rte_eal.h>
+#include <rte_errno.h>
+#include <rte_lcore.h>
+
+#include "ffpp/wsdeque.h"
+
+static constexpr uint32_t deque_size = 64;
+static constexpr uint32_t nb_thieves = 2;
+static constexpr uint32_t nb_items = 1000000;
+
+// The items are the indexes + 1, so no item is NULL.
+static void *to_item(uintptr_t i)
+{
+	return (void *)(i + 1);
+}
+
+static uintptr_t to_index(void *item)
+{
+	return (uintptr_t)item - 1;
+}
+
+static void test_single(struct ffpp_wsdeque *dq)
+{
+	assert(ffpp_wsdeque_take(dq) == NULL);
+	assert(ffpp_wsdeque_steal(dq) == NULL);
+	assert(ffpp_wsdeque_count(dq) == 0);
+
+	for (uint32_t i = 0; i < deque_size; ++i) {
+		assert(ffpp_wsdeque_push(dq, to_item(i)) == 0);
+	}
+	assert(ffpp_wsdeque_push(dq, to_item(deque_size)) == -1);
+	assert(ffpp_wsdeque_count(dq) == deque_size);
+
+	// The owner takes the newest, thieves the oldest items.
+	for (uint32_t i = 0; i < deque_size / 2; ++i) {
+		assert(ffpp_wsdeque_take(dq) == to_item(deque_size - 1 - i));
+		assert(ffpp_wsdeque_steal(dq) == to_item(i));
+	}
+	assert(ffpp_wsdeque_count(dq) == 0);
+	assert(ffpp_wsdeque_take(dq) == NULL);
+	assert(ffpp_wsdeque_steal(dq) == NULL);
+
+	// The indexes wrap around the array.
+	for (uint32_t i = 0; i < deque_size * 3; ++i) {
+		assert(ffpp_wsdeque_push(dq, to_item(i)) == 0);
+		assert(ffpp_wsdeque_steal(dq) == to_item(i));
+	}
+	assert(ffpp_wsdeque_push(dq, to_item(0)) == 0);
+	assert(ffpp_wsdeque_take(dq) == to_item(0));
+	assert(ffpp_wsdeque_count(dq) == 0);
+}
+
+static void count_item(std::vector<uint32_t> &taken, void *item)
+{
+	assert(item != NULL && to_index(item) < nb_items);
+	__atomic_fetch_add(&taken[to_index(item)], 1, __ATOMIC_RELAXED);
+}
+
+static uint32_t nb_started = 0;
+
+static void steal(struct ffpp_wsdeque *dq, std::vector<uint32_t> &taken,
+		  const bool *done)
+{
+	void *item;
+
+	__atomic_fetch_add(&nb_started, 1, __ATOMIC_RELEASE);
+	while (!__atomic_load_n(done, __ATOMIC_ACQUIRE) ||
+	       ffpp_wsdeque_count(dq) > 0) {
+		item = ffpp_wsdeque_steal(dq);
+		if (item != NULL) {
+			count_item(taken, item);
+		}
+	}
+}
+
+static void test_race(struct ffpp_wsdeque *dq)
+{
+	std::vector<uint32_t> taken(nb_items, 0);
+	std::vector<std::thread> thieves;
+	bool done = false;
+	void *item;
+
+	for (uint32_t t = 0; t < nb_thieves; ++t) {
+		thieves.emplace_back(steal, dq, std::ref(taken), &done);
+	}
+	while (__atomic_load_n(&nb_started, __ATOMIC_ACQUIRE) < nb_thieves) {
+		std::this_thread::yield();
+	}
+	// The owner takes every third item back itself, and all items when the
+	// deque is full, so the last item is often raced for.
+	for (uint32_t i = 0; i < nb_items; ++i) {
+		while (ffpp_wsdeque_push(dq, to_item(i)) != 0) {
+			item = ffpp_wsdeque_take(dq);
+			if (item != NULL) {
+				count_item(taken, item);
+			}
+		}
+		if (i % 3 == 0) {
+			item = ffpp_wsdeque_take(dq);
+			if (item != NULL) {
+				count_item(taken, item);
+			}
+		}
+	}
+	while ((item = ffpp_wsdeque_take(dq)) != NULL) {
+		count_item(taken, item);
+	}
+	__atomic_store_n(&done, true, __ATOMIC_RELEASE);
+	for (auto &t : thieves) {
+		t.join();
+	}
+
+	assert(ffpp_wsdeque_count(dq) == 0);
+	for (uint32_t i = 0; i < nb_items; ++i) {
+		assert(taken[i] == 1);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (rte_eal_init(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+
+	assert(ffpp_wsdeque_create(0, rte_socket_id()) == NULL);
+	assert(rte_errno == EINVAL);
+	assert(ffpp_wsdeque_create(deque_size + 1, rte_socket_id()) == NULL);
+	assert(rte_errno == EINVAL);
+
+	struct ffpp_wsdeque *dq = ffpp_wsdeque_create(deque_size,
+						      rte_socket_id());
+	assert(dq != NULL);
+	test_single(dq);
+	test_race(dq);
+	ffpp_wsdeque_free(dq);
+
+	rte_eal_cleanup();
+	return 0;
+}
@@ -0,0 +1,131 @@
+#! /usr/bin/env python3
+# -*- coding: utf-8 -*-
+# vim:fenc=utf-8
+#
+
+"""
+About: Convert binary measurement logs of the ffpp logger (ffpp/logger.h) to
+       CSV or Parquet.
+
+       The file is self-describing, so no schema has to be given. read_log()
+       can also be used directly in the query functions of plotting.py.
+"""
+
+import argparse
+import csv
+import os
+import struct
+import sys
+
+MAGIC = b"FFPPLOG\x00"
+VERSION = 1
+NAME_LEN = 32
+
+# struct ffpp_log_file_hdr and struct ffpp_log_file_field, host byte order.
+FILE_HDR = struct.Struct("=8sHHHHQQ%ds" % NAME_LEN)
+FILE_FIELD = struct.Struct("=%dsHBB" % NAME_LEN)
+
+# enum ffpp_log_type
+TYPE_CODES = ["B", "H", "I", "Q", "i", "q", "f", "d"]
+
+
+def _cstr(raw):
+    return raw.split(b"\x00", 1)[0].decode("utf-8")
+
+
+def read_header(buf):
+    magic, version, hdr_len, record_size, nb_fields, nb_records, start_ns, name = (
+        FILE_HDR.unpack_from(buf, 0)
+    )
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("Not a ffpp log file (version %d)" % VERSION)
+    fields = []
+    for i in range(nb_fields):
+        fname, offset, ftype, _ = FILE_FIELD.unpack_from(
+            buf, FILE_HDR.size + i * FILE_FIELD.size
+        )
+        fields.append((_cstr(fname), offset, TYPE_CODES[ftype]))
+    # A log that was not closed has no record count and a zero-filled tail.
+    if nb_records == 0:
+        nb_records = (len(buf) - hdr_len) // record_size
+    return {
+        "name": _cstr(name),
+        "hdr_len": hdr_len,
+        "record_size": record_size,
+        "nb_records": nb_records,
+        "start_ns": start_ns,
+        "fields": fields,
+    }
+
+
+def _record_struct(hdr):
+    # Fields sorted by offset with explicit padding, unpacked in schema order.
+    fmt = "="
+    pos = 0
+    order = sorted(range(len(hdr["fields"])), key=lambda i: hdr["fields"][i][1])
+    for i in order:
+        _, offset, code = hdr["fields"][i]
+        fmt += "x" * (offset - pos) + code
+        pos = offset + struct.calcsize("=" + code)
+    fmt += "x" * (hdr["record_size"] - pos)
+    inverse = [order.index(i) for i in range(len(order))]
+    return struct.Struct(fmt), inverse
+
+
+def iter_records(path):
+    with open(path, "rb") as f:
+        buf = f.read()
+    hdr = read_header(buf)
+    rec, inverse = _record_struct(hdr)
+    end = hdr["hdr_len"] + hdr["nb_records"] * hdr["record_size"]
+    for values in rec.iter_unpack(buf[hdr["hdr_len"] : end]):
+        yield tuple(values[i] for i in inverse)
+
+
+def read_log(path):
+    """Read a log file into a pandas DataFrame."""
+    import pandas as pd
+
+    with open(path, "rb") as f:
+        hdr = read_header(f.read(FILE_HDR.size + 64 * FILE_FIELD.size))
+    columns = [name for name, _, _ in hdr["fields"]]
+    return pd.DataFrame.from_records(list(iter_records(path)), columns=columns)
+
+
+def to_csv(path, out):
+    with open(path, "rb") as f:
+        hdr = read_header(f.read(FILE_HDR.size + 64 * FILE_FIELD.size))
+    with open(out, "w", newline="") as f:
+        writer = csv.writer(f)
+        writer.writerow([name for name, _, _ in hdr["fields"]])
+        writer.writerows(iter_records(path))
+
+
+def to_parquet(path, out):
+    read_log(path).to_parquet(out, index=False)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("logs", nargs="+", help="Binary log files")
+    parser.add_argument(
+        "--format", choices=["csv", "parquet"], default="csv", help="Output format"
+    )
+    parser.add_argument(
+        "--output", help="Output directory, default: next to the log file"
+    )
+    args = parser.parse_args()
+
+    for path in args.logs:
+        base = os.path.splitext(os.path.basename(path))[0] + "." + args.format
+        out_dir = args.output if args.output else os.path.dirname(path)
+        out = os.path.join(out_dir, base)
+        if args.format == "csv":
+            to_csv(path, out)
+        else:
+            to_parquet(path, out)
+        print(out)
+
+
+if __name__ == "__main__":
+    sys.exit(main())